@@ -8,6 +8,18 @@
  *
  */
 
+/** CR0 emulation bit */
+#define CR0_EM 0x00000004UL
+
+/** CR0 monitor coprocessor bit */
+#define CR0_MP 0x00000002UL
+
+/** CR0 task switched bit */
+#define CR0_TS 0x00000008UL
+
+/** CR4 operating system FXSAVE/FXRSTOR support bit */
+#define CR4_OSFXSR 0x00000200UL
+
 /**
  * Test to see if CPU flag is changeable
  *
@@ -56,10 +68,14 @@ void get_cpuinfo ( struct cpuinfo_x86 *cpu ) {
 		&discard_2, &discard_3 );
 	if ( cpuid_level >= 0x00000001 ) {
 		cpuid ( 0x00000001, &discard_1, &discard_2,
-			&discard_3, &cpu->features );
+			&cpu->ext_features, &cpu->features );
 	} else {
 		DBG ( "CPUID cannot return capabilities\n" );
 	}
+	if ( cpuid_level >= 0x00000007 ) {
+		cpuid_count ( 0x00000007, 0, &discard_1, &cpu->ext7_features,
+			      &discard_2, &discard_3 );
+	}
 
 	/* Get 64-bit features, if present */
 	cpuid ( 0x80000000, &cpuid_extlevel, &discard_1,
@@ -71,3 +87,92 @@ void get_cpuinfo ( struct cpuinfo_x86 *cpu ) {
 		}
 	}
 }
+
+/** PSHUFB mask reversing all sixteen bytes of an SSE register */
+const uint8_t sse_bswap_mask[16] = {
+	15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0
+};
+
+/** SSE state saved by cpu_sse_enter() */
+static struct {
+	/** Original CR0 */
+	unsigned long cr0;
+	/** Original CR4 */
+	unsigned long cr4;
+	/** Original contents of %xmm0-%xmm7 */
+	uint8_t xmm[8][16];
+} sse_saved;
+
+/**
+ * Begin using SSE instructions
+ *
+ * The BIOS will not necessarily have enabled the use of the SSE
+ * registers, and our caller (such as a PXE NBP, or an operating
+ * system using the UNDI API) may have live data in the SSE registers
+ * or may be relying upon CR0.TS to trap their use.  Enable SSE and
+ * save the SSE registers, so that cpu_sse_leave() can restore the
+ * caller's state.  The caller must already have checked that the CPU
+ * supports SSE.
+ *
+ * Calls to cpu_sse_enter() and cpu_sse_leave() must be paired, and
+ * may not be nested.
+ */
+void cpu_sse_enter ( void ) {
+	unsigned long cr0;
+	unsigned long cr4;
+
+	__asm__ __volatile__ ( "movl %%cr0, %0" : "=r" ( cr0 ) );
+	sse_saved.cr0 = cr0;
+	if ( ( cr0 & ( CR0_EM | CR0_TS | CR0_MP ) ) != CR0_MP ) {
+		cr0 = ( ( cr0 & ~( CR0_EM | CR0_TS ) ) | CR0_MP );
+		__asm__ __volatile__ ( "movl %0, %%cr0" : : "r" ( cr0 ) );
+	}
+	__asm__ __volatile__ ( "movl %%cr4, %0" : "=r" ( cr4 ) );
+	sse_saved.cr4 = cr4;
+	if ( ! ( cr4 & CR4_OSFXSR ) ) {
+		cr4 |= CR4_OSFXSR;
+		__asm__ __volatile__ ( "movl %0, %%cr4" : : "r" ( cr4 ) );
+	}
+	__asm__ __volatile__ ( "movdqu %%xmm0, 0(%1)\n\t"
+			       "movdqu %%xmm1, 16(%1)\n\t"
+			       "movdqu %%xmm2, 32(%1)\n\t"
+			       "movdqu %%xmm3, 48(%1)\n\t"
+			       "movdqu %%xmm4, 64(%1)\n\t"
+			       "movdqu %%xmm5, 80(%1)\n\t"
+			       "movdqu %%xmm6, 96(%1)\n\t"
+			       "movdqu %%xmm7, 112(%1)\n\t"
+			       : "=m" ( sse_saved.xmm )
+			       : "r" ( sse_saved.xmm ) );
+}
+
+/**
+ * Finish using SSE instructions
+ *
+ * Restores the SSE registers, CR0 and CR4 as saved by
+ * cpu_sse_enter().
+ */
+void cpu_sse_leave ( void ) {
+	unsigned long cr0;
+	unsigned long cr4;
+
+	__asm__ __volatile__ ( "movdqu 0(%0), %%xmm0\n\t"
+			       "movdqu 16(%0), %%xmm1\n\t"
+			       "movdqu 32(%0), %%xmm2\n\t"
+			       "movdqu 48(%0), %%xmm3\n\t"
+			       "movdqu 64(%0), %%xmm4\n\t"
+			       "movdqu 80(%0), %%xmm5\n\t"
+			       "movdqu 96(%0), %%xmm6\n\t"
+			       "movdqu 112(%0), %%xmm7\n\t"
+			       : : "r" ( sse_saved.xmm ),
+				   "m" ( sse_saved.xmm ) );
+	__asm__ __volatile__ ( "movl %%cr4, %0" : "=r" ( cr4 ) );
+	if ( cr4 != sse_saved.cr4 ) {
+		__asm__ __volatile__ ( "movl %0, %%cr4"
+				       : : "r" ( sse_saved.cr4 ) );
+	}
+	__asm__ __volatile__ ( "movl %%cr0, %0" : "=r" ( cr0 ) );
+	if ( cr0 != sse_saved.cr0 ) {
+		__asm__ __volatile__ ( "movl %0, %%cr0"
+				       : : "r" ( sse_saved.cr0 ) );
+	}
+}
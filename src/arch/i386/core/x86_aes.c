@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <byteswap.h>
+#include <cpu.h>
+#include <gpxe/aes.h>
+
+/** @file
+ *
+ * AES using the AES-NI instructions
+ *
+ * The round keys are taken from the key schedule already constructed
+ * by AXTLS.  Blocks are processed four at a time where possible, since
+ * the AES instructions have a latency of several cycles but can be
+ * issued every cycle, so independent blocks (as in ECB mode, or CBC
+ * decryption) can be processed almost as quickly as a single block.
+ */
+
+/** AES-NI support status (negative if not yet known) */
+static int aes_ni = -1;
+
+/**
+ * Check for AES-NI support
+ *
+ * @ret supported	AES-NI instructions may be used
+ */
+static int aes_ni_supported ( void ) {
+	struct cpuinfo_x86 cpu;
+
+	/* Check for AES-NI (and SSE2) on first use */
+	if ( aes_ni < 0 ) {
+		get_cpuinfo ( &cpu );
+		aes_ni = ( ( cpu.features & ( 1 << X86_FEATURE_XMM2 ) ) &&
+			   ( cpu.ext_features & ( 1 << X86_FEATURE_AES ) ) );
+		DBG ( "AES using %s implementation\n",
+		      ( aes_ni ? "AES-NI" : "generic" ) );
+	}
+	return aes_ni;
+}
+
+/**
+ * Set key for AES-NI implementation
+ *
+ * @v aes_ctx		AES context, with AXTLS key schedule constructed
+ * @ret rc		Return status code
+ */
+int aes_arch_setkey ( struct aes_context *aes_ctx ) {
+	struct aes_arch_context *arch_ctx = &aes_ctx->arch_ctx;
+	AES_CTX *axtls_ctx = &aes_ctx->axtls_ctx;
+	unsigned int rounds = axtls_ctx->rounds;
+	uint32_t *round_key;
+	unsigned int i;
+	unsigned int j;
+
+	if ( ! aes_ni_supported() )
+		return -ENOTSUP;
+	if ( rounds > AES_ARCH_MAX_ROUNDS )
+		return -ENOTSUP;
+	arch_ctx->rounds = rounds;
+
+	/* Convert AXTLS (host-endian) key schedule to byte order */
+	for ( i = 0 ; i <= rounds ; i++ ) {
+		round_key = ( ( uint32_t * ) arch_ctx->encrypt[i] );
+		for ( j = 0 ; j < 4 ; j++ )
+			round_key[j] = htonl ( axtls_ctx->ks[ ( 4 * i ) + j ] );
+	}
+
+	/* Construct decryption round keys for the equivalent inverse
+	 * cipher: reverse order, with InvMixColumns applied to all but
+	 * the first and last.
+	 */
+	memcpy ( arch_ctx->decrypt[0], arch_ctx->encrypt[rounds],
+		 sizeof ( arch_ctx->decrypt[0] ) );
+	cpu_sse_enter();
+	for ( i = 1 ; i < rounds ; i++ ) {
+		__asm__ __volatile__ ( "movdqu (%1), %%xmm0\n\t"
+				       "aesimc %%xmm0, %%xmm0\n\t"
+				       "movdqu %%xmm0, (%0)\n\t"
+				       : : "r" ( arch_ctx->decrypt[i] ),
+				           "r" ( arch_ctx->encrypt[ rounds - i ] )
+				       : SSE_CLOBBERS "memory" );
+	}
+	cpu_sse_leave();
+	memcpy ( arch_ctx->decrypt[rounds], arch_ctx->encrypt[0],
+		 sizeof ( arch_ctx->decrypt[rounds] ) );
+
+	return 0;
+}
+
+/**
+ * Process four blocks using AES-NI
+ *
+ * @v _round		Round instruction ("aesenc" or "aesdec")
+ * @v _last		Last round instruction
+ * @v _keys		Round keys
+ * @v _rounds		Number of rounds
+ * @v _src		Input data
+ * @v _dst		Output data
+ */
+#define AES_NI_CRYPT4( _round, _last, _keys, _rounds, _src, _dst ) do {	\
+	const void *keys = (_keys);					\
+	unsigned int count = ( (_rounds) - 1 );				\
+	__asm__ __volatile__ ( "movdqu (%2), %%xmm4\n\t"		\
+			       "movdqu 0(%3), %%xmm0\n\t"		\
+			       "movdqu 16(%3), %%xmm1\n\t"		\
+			       "movdqu 32(%3), %%xmm2\n\t"		\
+			       "movdqu 48(%3), %%xmm3\n\t"		\
+			       "pxor %%xmm4, %%xmm0\n\t"		\
+			       "pxor %%xmm4, %%xmm1\n\t"		\
+			       "pxor %%xmm4, %%xmm2\n\t"		\
+			       "pxor %%xmm4, %%xmm3\n\t"		\
+			       "\n1:\n\t"				\
+			       "addl $16, %2\n\t"			\
+			       "movdqu (%2), %%xmm4\n\t"		\
+			       _round " %%xmm4, %%xmm0\n\t"		\
+			       _round " %%xmm4, %%xmm1\n\t"		\
+			       _round " %%xmm4, %%xmm2\n\t"		\
+			       _round " %%xmm4, %%xmm3\n\t"		\
+			       "decl %1\n\t"				\
+			       "jnz 1b\n\t"				\
+			       "movdqu 16(%2), %%xmm4\n\t"		\
+			       _last " %%xmm4, %%xmm0\n\t"		\
+			       _last " %%xmm4, %%xmm1\n\t"		\
+			       _last " %%xmm4, %%xmm2\n\t"		\
+			       _last " %%xmm4, %%xmm3\n\t"		\
+			       "movdqu %%xmm0, 0(%4)\n\t"		\
+			       "movdqu %%xmm1, 16(%4)\n\t"		\
+			       "movdqu %%xmm2, 32(%4)\n\t"		\
+			       "movdqu %%xmm3, 48(%4)\n\t"		\
+			       : "=m" ( *( ( uint8_t (*)[64] ) (_dst) ) ),\
+				 "+r" ( count ), "+r" ( keys )		\
+			       : "r" ( _src ), "r" ( _dst ),		\
+				 "m" ( *( ( const uint8_t (*)[64] ) (_src) ) )\
+			       : SSE_CLOBBERS "cc" );		\
+	} while ( 0 )
+
+/**
+ * Process a single block using AES-NI
+ *
+ * @v _round		Round instruction ("aesenc" or "aesdec")
+ * @v _last		Last round instruction
+ * @v _keys		Round keys
+ * @v _rounds		Number of rounds
+ * @v _src		Input data
+ * @v _dst		Output data
+ */
+#define AES_NI_CRYPT1( _round, _last, _keys, _rounds, _src, _dst ) do {	\
+	const void *keys = (_keys);					\
+	unsigned int count = ( (_rounds) - 1 );				\
+	__asm__ __volatile__ ( "movdqu (%2), %%xmm4\n\t"		\
+			       "movdqu (%3), %%xmm0\n\t"		\
+			       "pxor %%xmm4, %%xmm0\n\t"		\
+			       "\n1:\n\t"				\
+			       "addl $16, %2\n\t"			\
+			       "movdqu (%2), %%xmm4\n\t"		\
+			       _round " %%xmm4, %%xmm0\n\t"		\
+			       "decl %1\n\t"				\
+			       "jnz 1b\n\t"				\
+			       "movdqu 16(%2), %%xmm4\n\t"		\
+			       _last " %%xmm4, %%xmm0\n\t"		\
+			       "movdqu %%xmm0, (%4)\n\t"		\
+			       : "=m" ( *( ( uint8_t (*)[16] ) (_dst) ) ),\
+				 "+r" ( count ), "+r" ( keys )		\
+			       : "r" ( _src ), "r" ( _dst ),		\
+				 "m" ( *( ( const uint8_t (*)[16] ) (_src) ) )\
+			       : SSE_CLOBBERS "cc" );		\
+	} while ( 0 )
+
+/**
+ * Encrypt data using AES-NI
+ *
+ * @v aes_ctx		AES context
+ * @v src		Data to encrypt
+ * @v dst		Buffer for encrypted data
+ * @v len		Length of data
+ */
+void aes_arch_encrypt ( struct aes_context *aes_ctx, const void *src,
+			void *dst, size_t len ) {
+	struct aes_arch_context *arch_ctx = &aes_ctx->arch_ctx;
+
+	cpu_sse_enter();
+	for ( ; len >= ( 4 * AES_BLOCKSIZE ) ; len -= ( 4 * AES_BLOCKSIZE ) ) {
+		AES_NI_CRYPT4 ( "aesenc", "aesenclast", arch_ctx->encrypt,
+				arch_ctx->rounds, src, dst );
+		src += ( 4 * AES_BLOCKSIZE );
+		dst += ( 4 * AES_BLOCKSIZE );
+	}
+	for ( ; len ; len -= AES_BLOCKSIZE ) {
+		AES_NI_CRYPT1 ( "aesenc", "aesenclast", arch_ctx->encrypt,
+				arch_ctx->rounds, src, dst );
+		src += AES_BLOCKSIZE;
+		dst += AES_BLOCKSIZE;
+	}
+	cpu_sse_leave();
+}
+
+/**
+ * Decrypt data using AES-NI
+ *
+ * @v aes_ctx		AES context
+ * @v src		Data to decrypt
+ * @v dst		Buffer for decrypted data
+ * @v len		Length of data
+ */
+void aes_arch_decrypt ( struct aes_context *aes_ctx, const void *src,
+			void *dst, size_t len ) {
+	struct aes_arch_context *arch_ctx = &aes_ctx->arch_ctx;
+
+	cpu_sse_enter();
+	for ( ; len >= ( 4 * AES_BLOCKSIZE ) ; len -= ( 4 * AES_BLOCKSIZE ) ) {
+		AES_NI_CRYPT4 ( "aesdec", "aesdeclast", arch_ctx->decrypt,
+				arch_ctx->rounds, src, dst );
+		src += ( 4 * AES_BLOCKSIZE );
+		dst += ( 4 * AES_BLOCKSIZE );
+	}
+	for ( ; len ; len -= AES_BLOCKSIZE ) {
+		AES_NI_CRYPT1 ( "aesdec", "aesdeclast", arch_ctx->decrypt,
+				arch_ctx->rounds, src, dst );
+		src += AES_BLOCKSIZE;
+		dst += AES_BLOCKSIZE;
+	}
+	cpu_sse_leave();
+}
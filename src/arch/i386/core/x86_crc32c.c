@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <cpu.h>
+#include <gpxe/crc32c.h>
+
+/** @file
+ *
+ * CRC32C using the SSE4.2 crc32 instruction
+ *
+ */
+
+/** SSE4.2 support status (negative if not yet known) */
+static int crc32c_sse42 = -1;
+
+/**
+ * Calculate CRC32C checksum using the SSE4.2 crc32 instruction
+ *
+ * @v crc		Initial value
+ * @v data		Data to checksum
+ * @v len		Length of data
+ * @ret crc		CRC32C checksum
+ */
+static uint32_t crc32c_le_sse42 ( uint32_t crc, const void *data,
+				  size_t len ) {
+	const uint8_t *bytes = data;
+	const uint32_t *dwords;
+
+	/* Process leading bytes up to a dword boundary */
+	while ( len && ( ( ( intptr_t ) bytes ) & 3 ) ) {
+		__asm__ ( "crc32b %1, %0" : "+r" ( crc ) : "qm" ( *(bytes++) ));
+		len--;
+	}
+
+	/* Process a dword at a time */
+	dwords = ( ( const void * ) bytes );
+	for ( ; len >= 4 ; len -= 4 )
+		__asm__ ( "crc32l %1, %0" : "+r" ( crc ) : "rm" ( *(dwords++) ));
+
+	/* Process trailing bytes */
+	bytes = ( ( const void * ) dwords );
+	while ( len-- )
+		__asm__ ( "crc32b %1, %0" : "+r" ( crc ) : "qm" ( *(bytes++) ));
+
+	return crc;
+}
+
+/**
+ * Calculate 32-bit little-endian CRC32C checksum
+ *
+ * @v seed		Initial value
+ * @v data		Data to checksum
+ * @v len		Length of data
+ * @ret crc		CRC32C checksum
+ */
+uint32_t crc32c_le ( uint32_t seed, const void *data, size_t len ) {
+	struct cpuinfo_x86 cpu;
+
+	/* Check for SSE4.2 on first use */
+	if ( crc32c_sse42 < 0 ) {
+		get_cpuinfo ( &cpu );
+		crc32c_sse42 =
+			( ( cpu.ext_features & ( 1 << X86_FEATURE_SSE4_2 ) ) != 0 );
+		DBG ( "CRC32C using %s implementation\n",
+		      ( crc32c_sse42 ? "SSE4.2" : "generic" ) );
+	}
+
+	if ( crc32c_sse42 )
+		return crc32c_le_sse42 ( seed, data, len );
+	return crc32c_le_generic ( seed, data, len );
+}
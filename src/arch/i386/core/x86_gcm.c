@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <cpu.h>
+#include <gpxe/gcm.h>
+
+/** @file
+ *
+ * GHASH using the PCLMULQDQ instruction
+ *
+ * GHASH operates on bit-reflected values.  Each block is byte-swapped
+ * on loading, so that the carry-less product of two values may be
+ * formed with four PCLMULQDQ instructions; the 256-bit product is
+ * then shifted left by one bit to account for the bit reflection and
+ * reduced modulo x^128 + x^7 + x^2 + x + 1.  This is the method
+ * described in Intel's white paper "Intel Carry-Less Multiplication
+ * Instruction and its Usage for Computing the GCM Mode".
+ *
+ * Register usage:
+ *
+ *   %xmm0	Accumulated hash (byte-swapped)
+ *   %xmm1	Hash key (byte-swapped)
+ *   %xmm2	Byte-swapping mask
+ *   %xmm3-7	Temporaries
+ */
+
+/** PCLMULQDQ support status (negative if not yet known) */
+static int ghash_clmul = -1;
+
+/**
+ * Check for GHASH architecture-specific implementation
+ *
+ * @ret supported	Architecture-specific implementation may be used
+ */
+int gcm_arch_supported ( void ) {
+	struct cpuinfo_x86 cpu;
+
+	/* Check for PCLMULQDQ (and the SSE versions used alongside
+	 * it) on first use
+	 */
+	if ( ghash_clmul < 0 ) {
+		get_cpuinfo ( &cpu );
+		ghash_clmul =
+			( ( cpu.features & ( 1 << X86_FEATURE_XMM2 ) ) &&
+			  ( cpu.ext_features & ( 1 << X86_FEATURE_SSSE3 ) ) &&
+			  ( cpu.ext_features &
+			    ( 1 << X86_FEATURE_PCLMULQDQ ) ) );
+		DBG ( "GHASH using %s implementation\n",
+		      ( ghash_clmul ? "PCLMULQDQ" : "generic" ) );
+	}
+	return ghash_clmul;
+}
+
+/**
+ * Update GHASH with whole blocks using PCLMULQDQ
+ *
+ * @v hash		Accumulated hash
+ * @v key		Hash key
+ * @v data		Data
+ * @v blocks		Number of blocks
+ */
+void gcm_arch_ghash ( union gcm_block *hash, const union gcm_block *key,
+		      const void *data, size_t blocks ) {
+
+	if ( ! blocks )
+		return;
+
+	cpu_sse_enter();
+	__asm__ __volatile__ ( /* Load hash, key and mask */
+			       "movdqu %[mask], %%xmm2\n\t"
+			       "movdqu (%[hash]), %%xmm0\n\t"
+			       "pshufb %%xmm2, %%xmm0\n\t"
+			       "movdqu (%[key]), %%xmm1\n\t"
+			       "pshufb %%xmm2, %%xmm1\n\t"
+			       "\n1:\n\t"
+			       /* Add next block to hash */
+			       "movdqu (%[data]), %%xmm3\n\t"
+			       "pshufb %%xmm2, %%xmm3\n\t"
+			       "pxor %%xmm3, %%xmm0\n\t"
+			       /* Form 256-bit carry-less product in
+				* %xmm0:%xmm3
+				*/
+			       "movdqa %%xmm0, %%xmm3\n\t"
+			       "pclmulqdq $0x00, %%xmm1, %%xmm3\n\t"
+			       "movdqa %%xmm0, %%xmm4\n\t"
+			       "pclmulqdq $0x10, %%xmm1, %%xmm4\n\t"
+			       "movdqa %%xmm0, %%xmm5\n\t"
+			       "pclmulqdq $0x01, %%xmm1, %%xmm5\n\t"
+			       "pclmulqdq $0x11, %%xmm1, %%xmm0\n\t"
+			       "pxor %%xmm5, %%xmm4\n\t"
+			       "movdqa %%xmm4, %%xmm5\n\t"
+			       "pslldq $8, %%xmm5\n\t"
+			       "psrldq $8, %%xmm4\n\t"
+			       "pxor %%xmm5, %%xmm3\n\t"
+			       "pxor %%xmm4, %%xmm0\n\t"
+			       /* Shift product left by one bit */
+			       "movdqa %%xmm3, %%xmm5\n\t"
+			       "psrld $31, %%xmm5\n\t"
+			       "movdqa %%xmm0, %%xmm6\n\t"
+			       "psrld $31, %%xmm6\n\t"
+			       "pslld $1, %%xmm3\n\t"
+			       "pslld $1, %%xmm0\n\t"
+			       "movdqa %%xmm5, %%xmm7\n\t"
+			       "psrldq $12, %%xmm7\n\t"
+			       "pslldq $4, %%xmm6\n\t"
+			       "pslldq $4, %%xmm5\n\t"
+			       "por %%xmm5, %%xmm3\n\t"
+			       "por %%xmm6, %%xmm0\n\t"
+			       "por %%xmm7, %%xmm0\n\t"
+			       /* Reduce: first phase */
+			       "movdqa %%xmm3, %%xmm5\n\t"
+			       "pslld $31, %%xmm5\n\t"
+			       "movdqa %%xmm3, %%xmm6\n\t"
+			       "pslld $30, %%xmm6\n\t"
+			       "movdqa %%xmm3, %%xmm7\n\t"
+			       "pslld $25, %%xmm7\n\t"
+			       "pxor %%xmm6, %%xmm5\n\t"
+			       "pxor %%xmm7, %%xmm5\n\t"
+			       "movdqa %%xmm5, %%xmm6\n\t"
+			       "psrldq $4, %%xmm6\n\t"
+			       "pslldq $12, %%xmm5\n\t"
+			       "pxor %%xmm5, %%xmm3\n\t"
+			       /* Reduce: second phase */
+			       "movdqa %%xmm3, %%xmm4\n\t"
+			       "psrld $1, %%xmm4\n\t"
+			       "movdqa %%xmm3, %%xmm5\n\t"
+			       "psrld $2, %%xmm5\n\t"
+			       "movdqa %%xmm3, %%xmm7\n\t"
+			       "psrld $7, %%xmm7\n\t"
+			       "pxor %%xmm5, %%xmm4\n\t"
+			       "pxor %%xmm7, %%xmm4\n\t"
+			       "pxor %%xmm6, %%xmm4\n\t"
+			       "pxor %%xmm4, %%xmm3\n\t"
+			       "pxor %%xmm3, %%xmm0\n\t"
+			       /* Move to next block */
+			       "addl $16, %[data]\n\t"
+			       "decl %[blocks]\n\t"
+			       "jnz 1b\n\t"
+			       /* Store hash */
+			       "pshufb %%xmm2, %%xmm0\n\t"
+			       "movdqu %%xmm0, (%[hash])\n\t"
+			       : [data] "+r" ( data ), [blocks] "+r" ( blocks )
+			       : [hash] "r" ( hash ), [key] "r" ( key ),
+				 [mask] "m" ( sse_bswap_mask )
+			       : SSE_CLOBBERS "cc", "memory" );
+	cpu_sse_leave();
+}
@@ -0,0 +1,418 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <cpu.h>
+#include <gpxe/sha1.h>
+#include <gpxe/sha256.h>
+
+/** @file
+ *
+ * SHA-1 and SHA-256 using the SHA extensions
+ *
+ * Each function processes any number of consecutive blocks within a
+ * single block of inline assembly, so that the intermediate hash
+ * value remains in the SSE registers (in the order expected by the
+ * SHA instructions) for the whole of the data.  Only the eight SSE
+ * registers available in 32-bit mode are used.
+ */
+
+/** SHA-NI support status (negative if not yet known) */
+static int sha_ni = -1;
+
+/**
+ * Check for SHA-NI support
+ *
+ * @ret supported	SHA-NI instructions may be used
+ */
+static int sha_ni_supported ( void ) {
+	struct cpuinfo_x86 cpu;
+
+	/* Check for SHA-NI (and the SSE versions used alongside it)
+	 * on first use
+	 */
+	if ( sha_ni < 0 ) {
+		get_cpuinfo ( &cpu );
+		sha_ni = ( ( cpu.features & ( 1 << X86_FEATURE_XMM2 ) ) &&
+			   ( cpu.ext_features & ( 1 << X86_FEATURE_SSSE3 ) ) &&
+			   ( cpu.ext_features & ( 1 << X86_FEATURE_SSE4_1 ) ) &&
+			   ( cpu.ext7_features & ( 1 << X86_FEATURE_SHA ) ) );
+		DBG ( "SHA using %s implementation\n",
+		      ( sha_ni ? "SHA-NI" : "generic" ) );
+	}
+	return sha_ni;
+}
+
+/******************************************************************************
+ *
+ * SHA-1
+ *
+ ******************************************************************************
+ *
+ * Register usage:
+ *
+ *   %xmm0	ABCD
+ *   %xmm1	E (even-numbered groups of four rounds)
+ *   %xmm2	E (odd-numbered groups of four rounds)
+ *   %xmm3-6	Message schedule (four words each)
+ *   %xmm7	Byte-swapping mask
+ */
+
+/** Load four message words */
+#define SHA1_NI_LOAD( n, msg )						\
+	"movdqu " #n "*16(%[data]), " msg "\n\t"			\
+	"pshufb %%xmm7, " msg "\n\t"
+
+/** Perform four rounds */
+#define SHA1_NI_ROUNDS( msg, e, e_next, func )				\
+	"sha1nexte " msg ", " e "\n\t"					\
+	"movdqa %%xmm0, " e_next "\n\t"					\
+	"sha1rnds4 $" #func ", " e ", %%xmm0\n\t"
+
+/** Perform first four rounds */
+#define SHA1_NI_ROUNDS_FIRST( msg )					\
+	"paddd " msg ", %%xmm1\n\t"					\
+	"movdqa %%xmm0, %%xmm2\n\t"					\
+	"sha1rnds4 $0, %%xmm1, %%xmm0\n\t"
+
+/** Message schedule operations */
+#define SHA1_NI_MSG1( msg, dst ) "sha1msg1 " msg ", " dst "\n\t"
+#define SHA1_NI_MSG2( msg, dst ) "sha1msg2 " msg ", " dst "\n\t"
+#define SHA1_NI_XOR( msg, dst ) "pxor " msg ", " dst "\n\t"
+
+#define M0 "%%xmm3"
+#define M1 "%%xmm4"
+#define M2 "%%xmm5"
+#define M3 "%%xmm6"
+#define E0 "%%xmm1"
+#define E1 "%%xmm2"
+
+/**
+ * Check for SHA-1 architecture-specific implementation
+ *
+ * @ret supported	Architecture-specific implementation may be used
+ */
+int sha1_arch_supported ( void ) {
+	return sha_ni_supported();
+}
+
+/**
+ * Process SHA-1 blocks using SHA-NI
+ *
+ * @v hash		Intermediate hash value
+ * @v data		Data
+ * @v blocks		Number of blocks
+ */
+void sha1_arch_blocks ( uint32_t *hash, const void *data, size_t blocks ) {
+	uint8_t save_abcd[16];
+	uint8_t save_e[16];
+
+	if ( ! blocks )
+		return;
+
+	cpu_sse_enter();
+	__asm__ __volatile__ ( /* Load intermediate hash value */
+			       "movdqu (%[hash]), %%xmm0\n\t"
+			       "pshufd $0x1b, %%xmm0, %%xmm0\n\t"
+			       "pxor %%xmm1, %%xmm1\n\t"
+			       "pinsrd $3, 16(%[hash]), %%xmm1\n\t"
+			       "movdqu %[mask], %%xmm7\n\t"
+			       "\n1:\n\t"
+			       "movdqu %%xmm0, %[save_abcd]\n\t"
+			       "movdqu %%xmm1, %[save_e]\n\t"
+			       /* Rounds 0-15 */
+			       SHA1_NI_LOAD ( 0, M0 )
+			       SHA1_NI_ROUNDS_FIRST ( M0 )
+			       SHA1_NI_LOAD ( 1, M1 )
+			       SHA1_NI_ROUNDS ( M1, E1, E0, 0 )
+			       SHA1_NI_MSG1 ( M1, M0 )
+			       SHA1_NI_LOAD ( 2, M2 )
+			       SHA1_NI_ROUNDS ( M2, E0, E1, 0 )
+			       SHA1_NI_MSG1 ( M2, M1 )
+			       SHA1_NI_XOR ( M2, M0 )
+			       SHA1_NI_LOAD ( 3, M3 )
+			       SHA1_NI_ROUNDS ( M3, E1, E0, 0 )
+			       SHA1_NI_MSG2 ( M3, M0 )
+			       SHA1_NI_MSG1 ( M3, M2 )
+			       SHA1_NI_XOR ( M3, M1 )
+			       /* Rounds 16-67 */
+			       SHA1_NI_ROUNDS ( M0, E0, E1, 0 )
+			       SHA1_NI_MSG2 ( M0, M1 )
+			       SHA1_NI_MSG1 ( M0, M3 )
+			       SHA1_NI_XOR ( M0, M2 )
+			       SHA1_NI_ROUNDS ( M1, E1, E0, 1 )
+			       SHA1_NI_MSG2 ( M1, M2 )
+			       SHA1_NI_MSG1 ( M1, M0 )
+			       SHA1_NI_XOR ( M1, M3 )
+			       SHA1_NI_ROUNDS ( M2, E0, E1, 1 )
+			       SHA1_NI_MSG2 ( M2, M3 )
+			       SHA1_NI_MSG1 ( M2, M1 )
+			       SHA1_NI_XOR ( M2, M0 )
+			       SHA1_NI_ROUNDS ( M3, E1, E0, 1 )
+			       SHA1_NI_MSG2 ( M3, M0 )
+			       SHA1_NI_MSG1 ( M3, M2 )
+			       SHA1_NI_XOR ( M3, M1 )
+			       SHA1_NI_ROUNDS ( M0, E0, E1, 1 )
+			       SHA1_NI_MSG2 ( M0, M1 )
+			       SHA1_NI_MSG1 ( M0, M3 )
+			       SHA1_NI_XOR ( M0, M2 )
+			       SHA1_NI_ROUNDS ( M1, E1, E0, 1 )
+			       SHA1_NI_MSG2 ( M1, M2 )
+			       SHA1_NI_MSG1 ( M1, M0 )
+			       SHA1_NI_XOR ( M1, M3 )
+			       SHA1_NI_ROUNDS ( M2, E0, E1, 2 )
+			       SHA1_NI_MSG2 ( M2, M3 )
+			       SHA1_NI_MSG1 ( M2, M1 )
+			       SHA1_NI_XOR ( M2, M0 )
+			       SHA1_NI_ROUNDS ( M3, E1, E0, 2 )
+			       SHA1_NI_MSG2 ( M3, M0 )
+			       SHA1_NI_MSG1 ( M3, M2 )
+			       SHA1_NI_XOR ( M3, M1 )
+			       SHA1_NI_ROUNDS ( M0, E0, E1, 2 )
+			       SHA1_NI_MSG2 ( M0, M1 )
+			       SHA1_NI_MSG1 ( M0, M3 )
+			       SHA1_NI_XOR ( M0, M2 )
+			       SHA1_NI_ROUNDS ( M1, E1, E0, 2 )
+			       SHA1_NI_MSG2 ( M1, M2 )
+			       SHA1_NI_MSG1 ( M1, M0 )
+			       SHA1_NI_XOR ( M1, M3 )
+			       SHA1_NI_ROUNDS ( M2, E0, E1, 2 )
+			       SHA1_NI_MSG2 ( M2, M3 )
+			       SHA1_NI_MSG1 ( M2, M1 )
+			       SHA1_NI_XOR ( M2, M0 )
+			       SHA1_NI_ROUNDS ( M3, E1, E0, 3 )
+			       SHA1_NI_MSG2 ( M3, M0 )
+			       SHA1_NI_MSG1 ( M3, M2 )
+			       SHA1_NI_XOR ( M3, M1 )
+			       SHA1_NI_ROUNDS ( M0, E0, E1, 3 )
+			       SHA1_NI_MSG2 ( M0, M1 )
+			       SHA1_NI_MSG1 ( M0, M3 )
+			       SHA1_NI_XOR ( M0, M2 )
+			       /* Rounds 68-79 */
+			       SHA1_NI_ROUNDS ( M1, E1, E0, 3 )
+			       SHA1_NI_MSG2 ( M1, M2 )
+			       SHA1_NI_XOR ( M1, M3 )
+			       SHA1_NI_ROUNDS ( M2, E0, E1, 3 )
+			       SHA1_NI_MSG2 ( M2, M3 )
+			       SHA1_NI_ROUNDS ( M3, E1, E0, 3 )
+			       /* Add to intermediate hash value */
+			       "movdqu %[save_e], %%xmm3\n\t"
+			       "sha1nexte %%xmm3, %%xmm1\n\t"
+			       "movdqu %[save_abcd], %%xmm4\n\t"
+			       "paddd %%xmm4, %%xmm0\n\t"
+			       "addl $64, %[data]\n\t"
+			       "decl %[blocks]\n\t"
+			       "jnz 1b\n\t"
+			       /* Store intermediate hash value */
+			       "pshufd $0x1b, %%xmm0, %%xmm0\n\t"
+			       "movdqu %%xmm0, (%[hash])\n\t"
+			       "pextrd $3, %%xmm1, 16(%[hash])\n\t"
+			       : [data] "+r" ( data ), [blocks] "+r" ( blocks ),
+				 [save_abcd] "=m" ( save_abcd ),
+				 [save_e] "=m" ( save_e )
+			       : [hash] "r" ( hash ),
+				 [mask] "m" ( sse_bswap_mask )
+			       : SSE_CLOBBERS "cc", "memory" );
+	cpu_sse_leave();
+}
+
+#undef M0
+#undef M1
+#undef M2
+#undef M3
+#undef E0
+#undef E1
+
+/******************************************************************************
+ *
+ * SHA-256
+ *
+ ******************************************************************************
+ *
+ * Register usage:
+ *
+ *   %xmm0	Message words plus round constants (for sha256rnds2)
+ *   %xmm1	ABEF
+ *   %xmm2	CDGH
+ *   %xmm3-6	Message schedule (four words each)
+ *   %xmm7	Byte-swapping mask or temporary
+ */
+
+/** SHA-256 byte-swapping mask (reverses bytes within each word) */
+static const uint8_t sha256_ni_mask[16] = {
+	3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+};
+
+/** SHA-256 round constants */
+static const uint32_t sha256_ni_k[64] = {
+	0x428a2f98UL, 0x71374491UL, 0xb5c0fbcfUL, 0xe9b5dba5UL,
+	0x3956c25bUL, 0x59f111f1UL, 0x923f82a4UL, 0xab1c5ed5UL,
+	0xd807aa98UL, 0x12835b01UL, 0x243185beUL, 0x550c7dc3UL,
+	0x72be5d74UL, 0x80deb1feUL, 0x9bdc06a7UL, 0xc19bf174UL,
+	0xe49b69c1UL, 0xefbe4786UL, 0x0fc19dc6UL, 0x240ca1ccUL,
+	0x2de92c6fUL, 0x4a7484aaUL, 0x5cb0a9dcUL, 0x76f988daUL,
+	0x983e5152UL, 0xa831c66dUL, 0xb00327c8UL, 0xbf597fc7UL,
+	0xc6e00bf3UL, 0xd5a79147UL, 0x06ca6351UL, 0x14292967UL,
+	0x27b70a85UL, 0x2e1b2138UL, 0x4d2c6dfcUL, 0x53380d13UL,
+	0x650a7354UL, 0x766a0abbUL, 0x81c2c92eUL, 0x92722c85UL,
+	0xa2bfe8a1UL, 0xa81a664bUL, 0xc24b8b70UL, 0xc76c51a3UL,
+	0xd192e819UL, 0xd6990624UL, 0xf40e3585UL, 0x106aa070UL,
+	0x19a4c116UL, 0x1e376c08UL, 0x2748774cUL, 0x34b0bcb5UL,
+	0x391c0cb3UL, 0x4ed8aa4aUL, 0x5b9cca4fUL, 0x682e6ff3UL,
+	0x748f82eeUL, 0x78a5636fUL, 0x84c87814UL, 0x8cc70208UL,
+	0x90befffaUL, 0xa4506cebUL, 0xbef9a3f7UL, 0xc67178f2UL,
+};
+
+/** Load four message words */
+#define SHA256_NI_LOAD( n, msg )					\
+	"movdqu " #n "*16(%[data]), " msg "\n\t"			\
+	"pshufb %%xmm7, " msg "\n\t"
+
+/** Perform four rounds */
+#define SHA256_NI_ROUNDS( n, msg )					\
+	"movdqu " #n "*16(%[k]), %%xmm0\n\t"				\
+	"paddd " msg ", %%xmm0\n\t"					\
+	"sha256rnds2 %%xmm0, %%xmm1, %%xmm2\n\t"			\
+	"pshufd $0x0e, %%xmm0, %%xmm0\n\t"				\
+	"sha256rnds2 %%xmm0, %%xmm2, %%xmm1\n\t"
+
+/** Calculate next four message words (first stage) */
+#define SHA256_NI_MSG1( msg, prev )					\
+	"sha256msg1 " msg ", " prev "\n\t"
+
+/** Calculate next four message words (second stage) */
+#define SHA256_NI_MSG2( msg, prev, next )				\
+	"movdqa " msg ", %%xmm7\n\t"					\
+	"palignr $4, " prev ", %%xmm7\n\t"				\
+	"paddd %%xmm7, " next "\n\t"					\
+	"sha256msg2 " msg ", " next "\n\t"
+
+#define M0 "%%xmm3"
+#define M1 "%%xmm4"
+#define M2 "%%xmm5"
+#define M3 "%%xmm6"
+
+/**
+ * Check for SHA-256 architecture-specific implementation
+ *
+ * @ret supported	Architecture-specific implementation may be used
+ */
+int sha256_arch_supported ( void ) {
+	return sha_ni_supported();
+}
+
+/**
+ * Process SHA-256 blocks using SHA-NI
+ *
+ * @v hash		Intermediate hash value
+ * @v data		Data
+ * @v blocks		Number of blocks
+ */
+void sha256_arch_blocks ( uint32_t *hash, const void *data, size_t blocks ) {
+	uint8_t save_abef[16];
+	uint8_t save_cdgh[16];
+
+	if ( ! blocks )
+		return;
+
+	cpu_sse_enter();
+	__asm__ __volatile__ ( /* Load intermediate hash value */
+			       "movdqu 0(%[hash]), %%xmm7\n\t"
+			       "movdqu 16(%[hash]), %%xmm2\n\t"
+			       "pshufd $0xb1, %%xmm7, %%xmm7\n\t"
+			       "pshufd $0x1b, %%xmm2, %%xmm2\n\t"
+			       "movdqa %%xmm7, %%xmm1\n\t"
+			       "palignr $8, %%xmm2, %%xmm1\n\t"
+			       "pblendw $0xf0, %%xmm7, %%xmm2\n\t"
+			       "\n1:\n\t"
+			       "movdqu %%xmm1, %[save_abef]\n\t"
+			       "movdqu %%xmm2, %[save_cdgh]\n\t"
+			       "movdqu %[mask], %%xmm7\n\t"
+			       /* Rounds 0-15 */
+			       SHA256_NI_LOAD ( 0, M0 )
+			       SHA256_NI_ROUNDS ( 0, M0 )
+			       SHA256_NI_LOAD ( 1, M1 )
+			       SHA256_NI_ROUNDS ( 1, M1 )
+			       SHA256_NI_MSG1 ( M1, M0 )
+			       SHA256_NI_LOAD ( 2, M2 )
+			       SHA256_NI_ROUNDS ( 2, M2 )
+			       SHA256_NI_MSG1 ( M2, M1 )
+			       SHA256_NI_LOAD ( 3, M3 )
+			       SHA256_NI_ROUNDS ( 3, M3 )
+			       SHA256_NI_MSG2 ( M3, M2, M0 )
+			       SHA256_NI_MSG1 ( M3, M2 )
+			       /* Rounds 16-51 */
+			       SHA256_NI_ROUNDS ( 4, M0 )
+			       SHA256_NI_MSG2 ( M0, M3, M1 )
+			       SHA256_NI_MSG1 ( M0, M3 )
+			       SHA256_NI_ROUNDS ( 5, M1 )
+			       SHA256_NI_MSG2 ( M1, M0, M2 )
+			       SHA256_NI_MSG1 ( M1, M0 )
+			       SHA256_NI_ROUNDS ( 6, M2 )
+			       SHA256_NI_MSG2 ( M2, M1, M3 )
+			       SHA256_NI_MSG1 ( M2, M1 )
+			       SHA256_NI_ROUNDS ( 7, M3 )
+			       SHA256_NI_MSG2 ( M3, M2, M0 )
+			       SHA256_NI_MSG1 ( M3, M2 )
+			       SHA256_NI_ROUNDS ( 8, M0 )
+			       SHA256_NI_MSG2 ( M0, M3, M1 )
+			       SHA256_NI_MSG1 ( M0, M3 )
+			       SHA256_NI_ROUNDS ( 9, M1 )
+			       SHA256_NI_MSG2 ( M1, M0, M2 )
+			       SHA256_NI_MSG1 ( M1, M0 )
+			       SHA256_NI_ROUNDS ( 10, M2 )
+			       SHA256_NI_MSG2 ( M2, M1, M3 )
+			       SHA256_NI_MSG1 ( M2, M1 )
+			       SHA256_NI_ROUNDS ( 11, M3 )
+			       SHA256_NI_MSG2 ( M3, M2, M0 )
+			       SHA256_NI_MSG1 ( M3, M2 )
+			       SHA256_NI_ROUNDS ( 12, M0 )
+			       SHA256_NI_MSG2 ( M0, M3, M1 )
+			       SHA256_NI_MSG1 ( M0, M3 )
+			       /* Rounds 52-63 */
+			       SHA256_NI_ROUNDS ( 13, M1 )
+			       SHA256_NI_MSG2 ( M1, M0, M2 )
+			       SHA256_NI_ROUNDS ( 14, M2 )
+			       SHA256_NI_MSG2 ( M2, M1, M3 )
+			       SHA256_NI_ROUNDS ( 15, M3 )
+			       /* Add to intermediate hash value */
+			       "movdqu %[save_abef], %%xmm3\n\t"
+			       "paddd %%xmm3, %%xmm1\n\t"
+			       "movdqu %[save_cdgh], %%xmm4\n\t"
+			       "paddd %%xmm4, %%xmm2\n\t"
+			       "addl $64, %[data]\n\t"
+			       "decl %[blocks]\n\t"
+			       "jnz 1b\n\t"
+			       /* Store intermediate hash value */
+			       "pshufd $0x1b, %%xmm1, %%xmm1\n\t"
+			       "pshufd $0xb1, %%xmm2, %%xmm2\n\t"
+			       "movdqa %%xmm1, %%xmm7\n\t"
+			       "pblendw $0xf0, %%xmm2, %%xmm1\n\t"
+			       "palignr $8, %%xmm7, %%xmm2\n\t"
+			       "movdqu %%xmm1, 0(%[hash])\n\t"
+			       "movdqu %%xmm2, 16(%[hash])\n\t"
+			       : [data] "+r" ( data ), [blocks] "+r" ( blocks ),
+				 [save_abef] "=m" ( save_abef ),
+				 [save_cdgh] "=m" ( save_cdgh )
+			       : [hash] "r" ( hash ), [k] "r" ( sha256_ni_k ),
+				 [mask] "m" ( sha256_ni_mask )
+			       : SSE_CLOBBERS "cc", "memory" );
+	cpu_sse_leave();
+}
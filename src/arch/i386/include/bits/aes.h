@@ -0,0 +1,39 @@
+#ifndef _BITS_AES_H
+#define _BITS_AES_H
+
+/** @file
+ *
+ * i386-specific AES implementation
+ *
+ * The AES-NI instructions are used if the CPU supports them.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define __HAVE_ARCH_AES
+
+struct aes_context;
+
+/** Maximum number of AES rounds */
+#define AES_ARCH_MAX_ROUNDS 14
+
+/** i386-specific AES context */
+struct aes_arch_context {
+	/** Encryption round keys */
+	uint8_t encrypt[ AES_ARCH_MAX_ROUNDS + 1 ][16];
+	/** Decryption round keys (for the equivalent inverse cipher) */
+	uint8_t decrypt[ AES_ARCH_MAX_ROUNDS + 1 ][16];
+	/** Number of rounds */
+	unsigned int rounds;
+};
+
+extern int aes_arch_setkey ( struct aes_context *aes_ctx );
+extern void aes_arch_encrypt ( struct aes_context *aes_ctx, const void *src,
+			       void *dst, size_t len );
+extern void aes_arch_decrypt ( struct aes_context *aes_ctx, const void *src,
+			       void *dst, size_t len );
+
+#endif /* _BITS_AES_H */
@@ -1,6 +1,8 @@
 #ifndef I386_BITS_CPU_H
 #define I386_BITS_CPU_H
 
+#include <stdint.h>
+
 /* Intel-defined CPU features, CPUID level 0x00000001, word 0 */
 #define X86_FEATURE_FPU		0 /* Onboard FPU */
 #define X86_FEATURE_VME		1 /* Virtual Mode Extensions */
@@ -33,6 +35,16 @@
 #define X86_FEATURE_ACC		29 /* Automatic clock control */
 #define X86_FEATURE_IA64	30 /* IA-64 processor */
 
+/* Intel-defined CPU features, CPUID level 0x00000001, word 2 (ECX) */
+#define X86_FEATURE_PCLMULQDQ	1 /* Carry-less multiplication */
+#define X86_FEATURE_SSSE3	9 /* Supplemental SSE3 */
+#define X86_FEATURE_SSE4_1	19 /* SSE4.1 */
+#define X86_FEATURE_SSE4_2	20 /* SSE4.2 (including CRC32 instruction) */
+#define X86_FEATURE_AES		25 /* AES instructions */
+
+/* Intel-defined CPU features, CPUID level 0x00000007 (subleaf 0), EBX */
+#define X86_FEATURE_SHA		29 /* SHA extensions */
+
 /* AMD-defined CPU features, CPUID level 0x80000001, word 1 */
 /* Don't duplicate feature flags which are redundant with Intel! */
 #define X86_FEATURE_SYSCALL	11 /* SYSCALL/SYSRET */
@@ -45,8 +57,12 @@
 struct cpuinfo_x86 {
 	/** CPU features */
 	unsigned int features;
+	/** Extended CPU features (CPUID level 0x00000001, ECX) */
+	unsigned int ext_features;
 	/** 64-bit CPU features */
 	unsigned int amd_features;
+	/** Structured extended CPU features (CPUID level 0x00000007, EBX) */
+	unsigned int ext7_features;
 };
 
 /*
@@ -81,6 +97,37 @@ cpuid ( int op, unsigned int *eax, unsigned int *ebx,
 		: "0" ( op ) );
 }
 
+/*
+ * Generic CPUID function, with subleaf index
+ */
+static inline __attribute__ (( always_inline )) void
+cpuid_count ( int op, int count, unsigned int *eax, unsigned int *ebx,
+	      unsigned int *ecx, unsigned int *edx ) {
+	__asm__ ( "cpuid" :
+		  "=a" ( *eax ), "=b" ( *ebx ), "=c" ( *ecx ), "=d" ( *edx )
+		: "0" ( op ), "2" ( count ) );
+}
+
 extern void get_cpuinfo ( struct cpuinfo_x86 *cpu );
+extern void cpu_sse_enter ( void );
+extern void cpu_sse_leave ( void );
+
+/** SSE registers clobbered by code between cpu_sse_enter() and
+ * cpu_sse_leave()
+ *
+ * Compiled code uses the SSE registers only if the compiler has been
+ * told that SSE is available (which is not the case for a normal
+ * -march=i386 build, and in which case the compiler will refuse to
+ * accept them as clobbered).
+ */
+#ifdef __SSE__
+#define SSE_CLOBBERS "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", \
+	"xmm6", "xmm7",
+#else
+#define SSE_CLOBBERS
+#endif
+
+/** PSHUFB mask reversing all sixteen bytes of an SSE register */
+extern const uint8_t sse_bswap_mask[16];
 
 #endif /* I386_BITS_CPU_H */
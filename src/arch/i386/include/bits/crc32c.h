@@ -0,0 +1,17 @@
+#ifndef _BITS_CRC32C_H
+#define _BITS_CRC32C_H
+
+/** @file
+ *
+ * i386-specific CRC32C implementation
+ *
+ * The SSE4.2 crc32 instruction is used if the CPU supports it.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#define __HAVE_ARCH_CRC32C
+
+extern uint32_t crc32c_le ( uint32_t seed, const void *data, size_t len );
+
+#endif /* _BITS_CRC32C_H */
@@ -0,0 +1,25 @@
+#ifndef _BITS_GCM_H
+#define _BITS_GCM_H
+
+/** @file
+ *
+ * i386-specific GCM implementation
+ *
+ * The PCLMULQDQ instruction is used for GHASH if the CPU supports it.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define __HAVE_ARCH_GHASH
+
+union gcm_block;
+
+extern int gcm_arch_supported ( void );
+extern void gcm_arch_ghash ( union gcm_block *hash,
+			     const union gcm_block *key,
+			     const void *data, size_t blocks );
+
+#endif /* _BITS_GCM_H */
@@ -0,0 +1,26 @@
+#ifndef _BITS_SHA_H
+#define _BITS_SHA_H
+
+/** @file
+ *
+ * i386-specific SHA-1 and SHA-256 implementations
+ *
+ * The SHA extensions are used if the CPU supports them.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define __HAVE_ARCH_SHA1
+#define __HAVE_ARCH_SHA256
+
+extern int sha1_arch_supported ( void );
+extern void sha1_arch_blocks ( uint32_t *hash, const void *data,
+			       size_t blocks );
+extern int sha256_arch_supported ( void );
+extern void sha256_arch_blocks ( uint32_t *hash, const void *data,
+				 size_t blocks );
+
+#endif /* _BITS_SHA_H */
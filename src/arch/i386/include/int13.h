@@ -11,6 +11,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 
 #include <stdint.h>
 #include <gpxe/list.h>
+#include <gpxe/blockcache.h>
 #include <realmode.h>
 
 struct block_device;
@@ -71,6 +72,8 @@ struct int13_drive {
 
 	/** Underlying block device */
 	struct block_device *blockdev;
+	/** Block cache in front of the underlying block device */
+	struct block_cache cache;
 
 	/** BIOS in-use drive number (0x80-0xff) */
 	unsigned int drive;
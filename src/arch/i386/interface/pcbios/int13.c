@@ -137,7 +137,7 @@ static int int13_rw_sectors ( struct int13_drive *drive,
 					     uint64_t block,
 					     unsigned long count,
 					     userptr_t buffer ) ) {
-	struct block_device *blockdev = drive->blockdev;
+	struct block_device *blockdev = &drive->cache.blockdev;
 	unsigned int cylinder, head, sector;
 	unsigned long lba;
 	unsigned int count;
@@ -191,7 +191,7 @@ static int int13_rw_sectors ( struct int13_drive *drive,
 static int int13_read_sectors ( struct int13_drive *drive,
 				struct i386_all_regs *ix86 ) {
 	DBG ( "Read: " );
-	return int13_rw_sectors ( drive, ix86, drive->blockdev->op->read );
+	return int13_rw_sectors ( drive, ix86, drive->cache.blockdev.op->read );
 }
 
 /**
@@ -210,7 +210,7 @@ static int int13_read_sectors ( struct int13_drive *drive,
 static int int13_write_sectors ( struct int13_drive *drive,
 				 struct i386_all_regs *ix86 ) {
 	DBG ( "Write: " );
-	return int13_rw_sectors ( drive, ix86, drive->blockdev->op->write );
+	return int13_rw_sectors ( drive, ix86, drive->cache.blockdev.op->write );
 }
 
 /**
@@ -294,7 +294,7 @@ static int int13_extended_rw ( struct int13_drive *drive,
 					      uint64_t block,
 					      unsigned long count,
 					      userptr_t buffer ) ) {
-	struct block_device *blockdev = drive->blockdev;
+	struct block_device *blockdev = &drive->cache.blockdev;
 	struct int13_disk_address addr;
 	uint64_t lba;
 	unsigned long count;
@@ -329,7 +329,8 @@ static int int13_extended_rw ( struct int13_drive *drive,
 static int int13_extended_read ( struct int13_drive *drive,
 				 struct i386_all_regs *ix86 ) {
 	DBG ( "Extended read: " );
-	return int13_extended_rw ( drive, ix86, drive->blockdev->op->read );
+	return int13_extended_rw ( drive, ix86,
+				   drive->cache.blockdev.op->read );
 }
 
 /**
@@ -342,7 +343,8 @@ static int int13_extended_read ( struct int13_drive *drive,
 static int int13_extended_write ( struct int13_drive *drive,
 				  struct i386_all_regs *ix86 ) {
 	DBG ( "Extended write: " );
-	return int13_extended_rw ( drive, ix86, drive->blockdev->op->write );
+	return int13_extended_rw ( drive, ix86,
+				   drive->cache.blockdev.op->write );
 }
 
 /**
@@ -545,8 +547,8 @@ static void guess_int13_geometry ( struct int13_drive *drive ) {
 	/* Scan through partition table and modify guesses for heads
 	 * and sectors_per_track if we find any used partitions.
 	 */
-	if ( drive->blockdev->op->read ( drive->blockdev, 0, 1,
-				         virt_to_user ( &mbr ) ) == 0 ) {
+	if ( drive->cache.blockdev.op->read ( &drive->cache.blockdev, 0, 1,
+					      virt_to_user ( &mbr ) ) == 0 ) {
 		for ( i = 0 ; i < 4 ; i++ ) {
 			partition = &mbr.partitions[i];
 			if ( ! partition->type )
@@ -590,10 +592,17 @@ static void guess_int13_geometry ( struct int13_drive *drive ) {
  *
  * The underlying block device must be valid.  A drive number and
  * geometry will be assigned if left blank.
+ *
+ * All access to the underlying block device is made via a block
+ * cache, since BIOS clients tend to issue large numbers of small
+ * sequential reads.
  */
 void register_int13_drive ( struct int13_drive *drive ) {
 	uint8_t num_drives;
 
+	/* Interpose block cache */
+	init_block_cache ( &drive->cache, drive->blockdev );
+
 	/* Give drive a default geometry if none specified */
 	guess_int13_geometry ( drive );
 
@@ -638,6 +647,9 @@ void unregister_int13_drive ( struct int13_drive *drive ) {
 	/* Remove from list of emulated drives */
 	list_del ( &drive->list );
 
+	/* Discard block cache */
+	free_block_cache ( &drive->cache );
+
 	/* Should adjust BIOS drive count, but it's difficult to do so
 	 * reliably.
 	 */
@@ -0,0 +1,42 @@
+#ifndef _BITS_BIGINT_H
+#define _BITS_BIGINT_H
+
+/** @file
+ *
+ * x86-specific big integer multiplication kernel
+ *
+ * Big integer components are 32 bits wide on both i386 and x86_64,
+ * so the same 32x32->64 "mull" kernel is used for both.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+
+#define __HAVE_ARCH_BIGINT_MULADD
+
+/**
+ * Multiply and accumulate into a triple-component accumulator
+ *
+ * @v a			Multiplicand
+ * @v b			Multiplier
+ * @v c0		Accumulator low component
+ * @v c1		Accumulator middle component
+ * @v c2		Accumulator high component
+ *
+ * Calculates ( c2:c1:c0 ) += ( a * b ).
+ */
+#define bigint_muladd( a, b, c0, c1, c2 ) do {				\
+	uint32_t __lo;							\
+	uint32_t __hi;							\
+	__asm__ ( "mull %6\n\t"						\
+		  "addl %%eax, %0\n\t"					\
+		  "adcl %%edx, %1\n\t"					\
+		  "adcl $0, %2\n\t"					\
+		  : "+r" ( c0 ), "+r" ( c1 ), "+r" ( c2 ),		\
+		    "=a" ( __lo ), "=d" ( __hi )			\
+		  : "3" ( a ), "rm" ( b )				\
+		  : "cc" );						\
+	} while ( 0 )
+
+#endif /* _BITS_BIGINT_H */
@@ -0,0 +1,14 @@
+#ifndef _BITS_AES_H
+#define _BITS_AES_H
+
+/** @file
+ *
+ * x86_64-specific AES implementation
+ *
+ * No architecture-specific implementation is provided; the generic
+ * implementation will be used.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#endif /* _BITS_AES_H */
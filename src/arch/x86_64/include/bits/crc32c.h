@@ -0,0 +1,14 @@
+#ifndef _BITS_CRC32C_H
+#define _BITS_CRC32C_H
+
+/** @file
+ *
+ * x86_64-specific CRC32C implementation
+ *
+ * No architecture-specific implementation is provided; the generic
+ * implementation will be used.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#endif /* _BITS_CRC32C_H */
@@ -0,0 +1,14 @@
+#ifndef _BITS_SHA_H
+#define _BITS_SHA_H
+
+/** @file
+ *
+ * x86_64-specific SHA-1 and SHA-256 implementations
+ *
+ * No architecture-specific implementation is provided; the generic
+ * implementation will be used.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#endif /* _BITS_SHA_H */
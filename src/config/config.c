@@ -231,6 +231,12 @@ REQUIRE_OBJECT ( time_cmd );
 #ifdef DIGEST_CMD
 REQUIRE_OBJECT ( digest_cmd );
 #endif
+#ifdef MEMINFO_CMD
+REQUIRE_OBJECT ( meminfo_cmd );
+#endif
+#ifdef BENCH_CMD
+REQUIRE_OBJECT ( bench_cmd );
+#endif
 #ifdef PXE_CMD
 REQUIRE_OBJECT ( pxe_cmd );
 #endif
@@ -252,6 +258,9 @@ REQUIRE_OBJECT ( gdbidt );
 REQUIRE_OBJECT ( gdbudp );
 REQUIRE_OBJECT ( gdbstub_cmd );
 #endif
+#ifdef IB_LOOPBACK
+REQUIRE_OBJECT ( ibloop );
+#endif
 
 /*
  * Drag in objects that are always required, but not dragged in via
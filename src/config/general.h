@@ -34,6 +34,14 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #define BANNER_TIMEOUT	20	/* Tenths of a second for which the shell
 				   banner should appear */
 
+/*
+ * Memory configuration
+ *
+ */
+#define HEAP_SIZE	( 128 * 1024 )	/* Size of internal heap */
+#define HEAP_EXTEND_SIZE 0		/* External memory to add to the heap
+					   when it is exhausted (0=never) */
+
 /*
  * Network protocols
  *
@@ -41,6 +49,36 @@ FILE_LICENCE ( GPL2_OR_LATER );
 
 #define	NET_PROTO_IPV4		/* IPv4 protocol */
 
+/*
+ * IP over Infiniband configuration
+ *
+ * Queue depths must be powers of two.  Connected mode needs
+ * IPOIB_CM_NUM_RECV_WQES receive buffers of IPOIB_CM_MTU bytes for
+ * each peer that connects to us; enlarge HEAP_SIZE or set
+ * HEAP_EXTEND_SIZE accordingly.
+ *
+ */
+#define IPOIB_NUM_SEND_WQES	8	/* Send queue depth */
+#define IPOIB_NUM_RECV_WQES	8	/* Receive queue depth */
+#undef	IPOIB_CONNECTED_MODE		/* Use connected mode where possible */
+#define IPOIB_CM_MTU		65520	/* Connected mode MTU */
+#define IPOIB_CM_NUM_RECV_WQES	2	/* Connected mode receive queue depth
+					   per connection */
+#define IPOIB_CM_NUM_CQES	64	/* Connected mode completion queue
+					   depth, shared by all connections */
+
+/*
+ * Automatic boot configuration
+ *
+ * With AUTOBOOT_PARALLEL_DHCP, DHCP runs on all network devices at
+ * once instead of on each device in turn.  The first device to obtain
+ * a lease is used, unless AUTOBOOT_DHCP_IN_ORDER is defined, in which
+ * case a device is used only once all devices ahead of it have failed.
+ *
+ */
+#define	AUTOBOOT_PARALLEL_DHCP		/* Run DHCP on all devices at once */
+#undef	AUTOBOOT_DHCP_IN_ORDER		/* Prefer devices in order */
+
 /*
  * PXE support
  *
@@ -76,6 +114,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #define	CRYPTO_80211_WEP	/* WEP encryption (deprecated and insecure!) */
 #define	CRYPTO_80211_WPA	/* WPA Personal, authenticating with passphrase */
 #define	CRYPTO_80211_WPA2	/* Add support for stronger WPA cryptography */
+#undef	WPA_PMK_NVO		/* Save derived WPA keys to non-volatile storage */
 
 /*
  * Name resolution modules
@@ -119,8 +158,27 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #define LOGIN_CMD		/* Login command */
 #undef	TIME_CMD		/* Time commands */
 #undef	DIGEST_CMD		/* Image crypto digest commands */
+#undef	MEMINFO_CMD		/* Memory usage commands */
+#undef	BENCH_CMD		/* Cryptographic benchmark commands */
 //#undef	PXE_CMD			/* PXE commands */
 
+/*
+ * Trusted root certificates
+ *
+ * If TRUSTED_ROOTS is defined, the certificate chain presented by a
+ * TLS server (e.g. for https:// URIs) must lead to one of these
+ * certificates.  Each certificate is identified by the SHA-256
+ * fingerprint of its DER encoding, as shown by "openssl x509 -noout
+ * -fingerprint -sha256", written as a comma-separated list of bytes.
+ * The server's own certificate must also name the host in the URI,
+ * via a subjectAltName DNS entry (or, if it has none, its subject
+ * commonName); a leading "*." wildcard matches a single label.
+ * If TRUSTED_ROOTS is not defined, server certificates are not
+ * verified, and the server name is not checked.
+ *
+ */
+//#define TRUSTED_ROOTS 0x00, 0x01, ..., 0x1f	/* Trusted root fingerprints */
+
 /*
  * Error message tables to include
  *
@@ -144,6 +202,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #undef	GDBSERIAL		/* Remote GDB debugging over serial */
 #undef	GDBUDP			/* Remote GDB debugging over UDP
 				 * (both may be set) */
+#undef	IB_LOOPBACK		/* Software loopback Infiniband device */
 
 #include <config/local/general.h>
 
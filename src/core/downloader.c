@@ -20,6 +20,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
 #include <errno.h>
 #include <gpxe/xfer.h>
 #include <gpxe/open.h>
@@ -27,12 +28,18 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <gpxe/uaccess.h>
 #include <gpxe/umalloc.h>
 #include <gpxe/image.h>
+#include <gpxe/crypto.h>
 #include <gpxe/downloader.h>
 
 /** @file
  *
  * Image downloader
  *
+ * If the image has a digest algorithm set, the digest is accumulated
+ * as data arrives, so that it does not need to be calculated by
+ * reading back the whole image after the download completes.  Data
+ * arriving out of order is caught up on (by reading back only the
+ * affected portion of the image) when the download completes.
  */
 
 /** A downloader */
@@ -51,6 +58,11 @@ struct downloader {
 	size_t pos;
 	/** Image registration routine */
 	int ( * register_image ) ( struct image *image );
+
+	/** Digest context, or NULL */
+	void *digest_ctx;
+	/** Length of image data accumulated into digest */
+	size_t digest_pos;
 };
 
 /**
@@ -63,6 +75,7 @@ static void downloader_free ( struct refcnt *refcnt ) {
 		container_of ( refcnt, struct downloader, refcnt );
 
 	image_put ( downloader->image );
+	free ( downloader->digest_ctx );
 	free ( downloader );
 }
 
@@ -114,6 +127,80 @@ static int downloader_ensure_size ( struct downloader *downloader,
 	return 0;
 }
 
+/**
+ * Accumulate delivered data into image digest
+ *
+ * @v downloader	Downloader
+ * @v data		Data
+ * @v len		Length of data
+ *
+ * Must be called with the current buffer position set to the start
+ * of the delivered data.
+ */
+static void downloader_digest ( struct downloader *downloader,
+				const void *data, size_t len ) {
+	struct digest_algorithm *digest = downloader->image->digest;
+
+	if ( ! downloader->digest_ctx )
+		return;
+
+	if ( downloader->pos == downloader->digest_pos ) {
+		/* Data is in order: accumulate directly */
+		digest_update ( digest, downloader->digest_ctx, data, len );
+		downloader->digest_pos += len;
+	} else if ( downloader->pos < downloader->digest_pos ) {
+		/* Data overwrites part of the digest: start again
+		 * (from the image buffer) on completion.
+		 */
+		DBGC ( downloader, "Downloader %p restarting digest\n",
+		       downloader );
+		digest_init ( digest, downloader->digest_ctx );
+		downloader->digest_pos = 0;
+	}
+	/* Data beyond the current digest position will be caught up
+	 * on when the download completes.
+	 */
+}
+
+/**
+ * Complete image digest
+ *
+ * @v downloader	Downloader
+ * @ret rc		Return status code
+ */
+static int downloader_digest_final ( struct downloader *downloader ) {
+	struct image *image = downloader->image;
+	struct digest_algorithm *digest = image->digest;
+
+	if ( ! downloader->digest_ctx )
+		return 0;
+
+	/* Catch up on any data that could not be accumulated as it
+	 * arrived.
+	 */
+	if ( downloader->digest_pos < image->len ) {
+		DBGC ( downloader, "Downloader %p catching up digest from "
+		       "%zd to %zd\n", downloader, downloader->digest_pos,
+		       image->len );
+		image_digest_update ( image, digest, downloader->digest_ctx,
+				      downloader->digest_pos,
+				      ( image->len - downloader->digest_pos ) );
+	}
+	digest_final ( digest, downloader->digest_ctx, image->digest_out );
+	image->flags |= IMAGE_DIGEST;
+
+	/* Check against expected digest, if any */
+	if ( ( image->flags & IMAGE_DIGEST_EXPECTED ) &&
+	     ( memcmp ( image->digest_out, image->digest_expected,
+			digest->digestsize ) != 0 ) ) {
+		DBGC ( downloader, "Downloader %p %s digest mismatch\n",
+		       downloader, digest->name );
+		return -EACCES;
+	}
+
+	return 0;
+}
+
 /****************************************************************************
  *
  * Job control interface
@@ -197,6 +284,9 @@ static int downloader_xfer_deliver_iob ( struct xfer_interface *xfer,
 	copy_to_user ( downloader->image->data, downloader->pos,
 		       iobuf->data, len );
 
+	/* Accumulate digest */
+	downloader_digest ( downloader, iobuf->data, len );
+
 	/* Update current buffer position */
 	downloader->pos += len;
 
@@ -215,7 +305,9 @@ static void downloader_xfer_close ( struct xfer_interface *xfer, int rc ) {
 	struct downloader *downloader =
 		container_of ( xfer, struct downloader, xfer );
 
-	/* Register image if download was successful */
+	/* Complete digest and register image if download was successful */
+	if ( rc == 0 )
+		rc = downloader_digest_final ( downloader );
 	if ( rc == 0 )
 		rc = downloader->register_image ( downloader->image );
 
@@ -252,6 +344,10 @@ static struct xfer_interface_operations downloader_xfer_operations = {
  * Instantiates a downloader object to download the specified URI into
  * the specified image object.  If the download is successful, the
  * image registration routine @c register_image() will be called.
+ *
+ * If the image has a digest algorithm set, the image digest will be
+ * calculated during the download, and checked against the expected
+ * digest (if any).
  */
 int create_downloader ( struct job_interface *job, struct image *image,
 			int ( * register_image ) ( struct image *image ),
@@ -271,6 +367,15 @@ int create_downloader ( struct job_interface *job, struct image *image,
 		    &downloader->refcnt );
 	downloader->image = image_get ( image );
 	downloader->register_image = register_image;
+	image->flags &= ~IMAGE_DIGEST;
+	if ( image->digest ) {
+		downloader->digest_ctx = malloc ( image->digest->ctxsize );
+		if ( ! downloader->digest_ctx ) {
+			ref_put ( &downloader->refcnt );
+			return -ENOMEM;
+		}
+		digest_init ( image->digest, downloader->digest_ctx );
+	}
 	va_start ( args, type );
 
 	/* Instantiate child objects and attach to our interfaces */
@@ -28,6 +28,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <gpxe/list.h>
 #include <gpxe/umalloc.h>
 #include <gpxe/uri.h>
+#include <gpxe/crypto.h>
 #include <gpxe/image.h>
 
 /** @file
@@ -326,3 +327,54 @@ int register_and_autoexec_image ( struct image *image ) {
 
 	return 0;
 }
+
+/**
+ * Accumulate part of image into digest
+ *
+ * @v image		Image
+ * @v digest		Digest algorithm
+ * @v ctx		Digest context
+ * @v offset		Starting offset within image
+ * @v len		Length of data
+ */
+void image_digest_update ( struct image *image,
+			   struct digest_algorithm *digest, void *ctx,
+			   size_t offset, size_t len ) {
+	uint8_t buf[256];
+	size_t frag_len;
+
+	while ( len ) {
+		frag_len = len;
+		if ( frag_len > sizeof ( buf ) )
+			frag_len = sizeof ( buf );
+		copy_from_user ( buf, image->data, offset, frag_len );
+		digest_update ( digest, ctx, buf, frag_len );
+		offset += frag_len;
+		len -= frag_len;
+	}
+}
+
+/**
+ * Calculate image digest
+ *
+ * @v image		Image
+ * @v digest		Digest algorithm
+ * @v out		Buffer for digest output
+ *
+ * If the requested digest was calculated while the image was being
+ * downloaded, the stored value will be used rather than reading the
+ * image again.
+ */
+void image_digest ( struct image *image, struct digest_algorithm *digest,
+		    void *out ) {
+	uint8_t ctx[digest->ctxsize];
+
+	if ( ( image->flags & IMAGE_DIGEST ) && ( image->digest == digest ) ) {
+		memcpy ( out, image->digest_out, digest->digestsize );
+		return;
+	}
+
+	digest_init ( digest, ctx );
+	image_digest_update ( image, digest, ctx, 0, image->len );
+	digest_final ( digest, ctx, out );
+}
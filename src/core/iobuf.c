@@ -51,7 +51,8 @@ struct io_buffer * alloc_iob ( size_t len ) {
 		~( __alignof__( *iobuf ) - 1 );
 	
 	/* Allocate memory for buffer plus descriptor */
-	data = malloc_dma ( len + sizeof ( *iobuf ), IOB_ALIGN );
+	data = malloc_dma_caller ( len + sizeof ( *iobuf ), IOB_ALIGN,
+				   __builtin_return_address ( 0 ) );
 	if ( ! data )
 		return NULL;
 
@@ -25,7 +25,11 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <gpxe/io.h>
 #include <gpxe/list.h>
 #include <gpxe/init.h>
+#include <gpxe/iobuf.h>
+#include <gpxe/uaccess.h>
+#include <gpxe/umalloc.h>
 #include <gpxe/malloc.h>
+#include <config/general.h>
 
 /** @file
  *
@@ -75,29 +79,73 @@ static LIST_HEAD ( free_blocks );
 /** Total amount of free memory */
 size_t freemem;
 
-/**
- * Heap size
+/** The heap itself
  *
- * Currently fixed at 128kB.
+ * The size is set by HEAP_SIZE in config/general.h.
  */
-#define HEAP_SIZE ( 128 * 1024 )
-
-/** The heap itself */
 static char heap[HEAP_SIZE] __attribute__ (( aligned ( __alignof__(void *) )));
 
+/** Heap statistics */
+static struct heap_statistics heap_stats;
+
+/** Heap has been extended from external memory */
+static int heap_extended;
+
+/** A cached free memory block */
+struct cached_block {
+	/** Next cached block */
+	struct cached_block *next;
+};
+
+/** Define a size-class cache */
+#define MEMCACHE( _size, _align, _max ) \
+	{ .size = (_size), .align = (_align), .max = (_max) }
+
 /**
- * Allocate a memory block
+ * Size-class caches
+ *
+ * Every memory block whose rounded size falls within a size class is
+ * rounded up to the full size of that class.  Freed blocks are held
+ * on a per-class free list, up to a limit, so that the commonest
+ * allocations (I/O buffers, timers, connection structures) need not
+ * walk the free block list.
+ *
+ * A size class may have several caches, each holding only blocks of
+ * a given physical alignment.  Plain allocations use the cache with
+ * no alignment requirement, and so retain the heap's natural
+ * alignment; aligned allocations (such as I/O buffers) use the
+ * smallest cache whose alignment satisfies the request.
+ *
+ * Caches must be listed in order of increasing size, and within a
+ * size class in order of increasing alignment.
+ */
+struct memcache memcaches[NUM_MEMCACHES] = {
+	MEMCACHE ( 32, 1, 8 ),
+	MEMCACHE ( 64, 1, 8 ),
+	MEMCACHE ( 128, 1, 8 ),
+	MEMCACHE ( 128, IOB_ALIGN, 4 ),
+	MEMCACHE ( 192, 1, 8 ),
+	MEMCACHE ( 256, 1, 8 ),
+	MEMCACHE ( 256, IOB_ALIGN, 4 ),
+	MEMCACHE ( 384, 1, 4 ),
+	MEMCACHE ( 512, 1, 4 ),
+	MEMCACHE ( 512, IOB_ALIGN, 4 ),
+	MEMCACHE ( 768, 1, 4 ),
+	MEMCACHE ( 1024, 1, 4 ),
+	MEMCACHE ( 1536, 1, 4 ),
+	MEMCACHE ( 2048, 1, 4 ),
+	/* MTU-sized I/O buffers */
+	MEMCACHE ( 2048, IOB_ALIGN, 8 ),
+};
+
+/**
+ * Allocate a memory block from the heap
  *
  * @v size		Requested size
  * @v align		Physical alignment
  * @ret ptr		Memory block, or NULL
- *
- * Allocates a memory block @b physically aligned as requested.  No
- * guarantees are provided for the alignment of the virtual address.
- *
- * @c align must be a power of two.  @c size may not be zero.
  */
-void * alloc_memblock ( size_t size, size_t align ) {
+static void * heap_alloc ( size_t size, size_t align ) {
 	struct memory_block *block;
 	size_t align_mask;
 	size_t pre_size;
@@ -164,14 +212,12 @@ void * alloc_memblock ( size_t size, size_t align ) {
 }
 
 /**
- * Free a memory block
+ * Free a memory block to the heap
  *
- * @v ptr		Memory allocated by alloc_memblock(), or NULL
+ * @v ptr		Memory allocated by heap_alloc(), or NULL
  * @v size		Size of the memory
- *
- * If @c ptr is NULL, no action is taken.
  */
-void free_memblock ( void *ptr, size_t size ) {
+static void heap_free ( void *ptr, size_t size ) {
 	struct memory_block *freeing;
 	struct memory_block *block;
 	ssize_t gap_before;
@@ -231,26 +277,293 @@ void free_memblock ( void *ptr, size_t size ) {
 }
 
 /**
- * Reallocate memory
+ * Identify size class for a memory block
  *
- * @v old_ptr		Memory previously allocated by malloc(), or NULL
- * @v new_size		Requested size
- * @ret new_ptr		Allocated memory, or NULL
+ * @v size		Size of memory block
+ * @ret cache		First cache within size class, or NULL
  *
- * Allocates memory with no particular alignment requirement.  @c
- * new_ptr will be aligned to at least a multiple of sizeof(void*).
- * If @c old_ptr is non-NULL, then the contents of the newly allocated
- * memory will be the same as the contents of the previously allocated
- * memory, up to the minimum of the old and new sizes.  The old memory
- * will be freed.
+ * The size class depends only upon the size, so that
+ * alloc_memblock() and free_memblock() always agree on the rounded
+ * size of a block.
+ */
+static struct memcache * memcache_class ( size_t size ) {
+	struct memcache *cache;
+
+	if ( size > memcaches[ NUM_MEMCACHES - 1 ].size )
+		return NULL;
+	for ( cache = memcaches ; cache->size < size ; cache++ ) {}
+	return cache;
+}
+
+/**
+ * Identify size-class cache for an allocation
  *
- * If allocation fails the previously allocated block is left
- * untouched and NULL is returned.
+ * @v size		Requested size
+ * @v align		Physical alignment
+ * @ret cache		Size-class cache, or NULL
+ * @ret class		First cache within size class, or NULL
  *
- * Calling realloc() with a new size of zero is a valid way to free a
- * memory block.
+ * Returns the least-aligned cache within the size class that
+ * satisfies @c align.  If no cache within the size class is
+ * sufficiently aligned, @c cache will be NULL but @c class will still
+ * identify the size class.
  */
-void * realloc ( void *old_ptr, size_t new_size ) {
+static struct memcache * memcache_for_alloc ( size_t size, size_t align,
+					      struct memcache **class ) {
+	struct memcache *cache;
+
+	*class = memcache_class ( size );
+	if ( ! *class )
+		return NULL;
+	for ( cache = *class ; cache < &memcaches[NUM_MEMCACHES] ; cache++ ) {
+		if ( cache->size != (*class)->size )
+			break;
+		if ( cache->align >= align )
+			return cache;
+	}
+	return NULL;
+}
+
+/**
+ * Identify size-class cache for a freed memory block
+ *
+ * @v ptr		Memory block
+ * @v size		Size of memory block
+ * @ret cache		Size-class cache, or NULL
+ *
+ * Returns the most-aligned cache within the size class whose
+ * alignment is satisfied by the block's physical address.
+ */
+static struct memcache * memcache_for_free ( void *ptr, size_t size ) {
+	struct memcache *class;
+	struct memcache *cache;
+	struct memcache *found;
+	unsigned long phys = virt_to_phys ( ptr );
+
+	class = memcache_class ( size );
+	if ( ! class )
+		return NULL;
+	found = class;
+	for ( cache = class ; cache < &memcaches[NUM_MEMCACHES] ; cache++ ) {
+		if ( cache->size != class->size )
+			break;
+		if ( ( phys & ( cache->align - 1 ) ) == 0 )
+			found = cache;
+	}
+	return found;
+}
+
+/**
+ * Flush size-class caches
+ *
+ * Returns all cached free blocks to the heap, so that they may be
+ * coalesced with their neighbours.
+ */
+void mcache_flush ( void ) {
+	struct memcache *cache;
+	struct cached_block *block;
+
+	for ( cache = memcaches ; cache < &memcaches[NUM_MEMCACHES] ;
+	      cache++ ) {
+		while ( ( block = cache->free ) != NULL ) {
+			cache->free = block->next;
+			cache->count--;
+			freemem -= cache->size;
+			heap_free ( block, cache->size );
+		}
+	}
+}
+
+/**
+ * Extend heap from external memory
+ *
+ * @ret extended	Heap was extended
+ *
+ * If HEAP_EXTEND_SIZE is non-zero, the first heap exhaustion causes
+ * a block of that size to be allocated from external memory and added
+ * to the heap.  This is a one-way operation.
+ */
+static int heap_extend ( void ) {
+	userptr_t extension;
+
+	if ( ( HEAP_EXTEND_SIZE == 0 ) || heap_extended )
+		return 0;
+	heap_extended = 1;
+
+	extension = umalloc ( HEAP_EXTEND_SIZE );
+	if ( ! extension ) {
+		DBG ( "Could not extend heap by %#x\n", HEAP_EXTEND_SIZE );
+		return 0;
+	}
+	DBG ( "Extending heap by %#x at %#lx\n", HEAP_EXTEND_SIZE,
+	      user_to_phys ( extension, 0 ) );
+	mpopulate ( user_to_virt ( extension, 0 ), HEAP_EXTEND_SIZE );
+	return 1;
+}
+
+/**
+ * Record allocation failure
+ *
+ * @v size		Requested size
+ * @v caller		Caller address
+ */
+static void heap_failed ( size_t size, void *caller ) {
+	struct heap_failure *failure;
+	unsigned int i;
+
+	heap_stats.failures++;
+	for ( i = 0 ; i < HEAP_FAILURE_CALLERS ; i++ ) {
+		failure = &heap_stats.callers[i];
+		if ( ( failure->caller == caller ) || ! failure->count ) {
+			failure->caller = caller;
+			failure->count++;
+			if ( size > failure->size )
+				failure->size = size;
+			return;
+		}
+	}
+}
+
+/**
+ * Allocate a memory block on behalf of a caller
+ *
+ * @v size		Requested size
+ * @v align		Physical alignment
+ * @v caller		Caller address, used for failure statistics
+ * @ret ptr		Memory block, or NULL
+ */
+void * alloc_memblock_caller ( size_t size, size_t align, void *caller ) {
+	struct memcache *class;
+	struct memcache *cache;
+	struct cached_block *block;
+	void *ptr;
+
+	/* Satisfy from size-class cache, if possible.  Blocks within
+	 * a size class always occupy the full class size, so that
+	 * free_memblock() can identify the class from the size alone.
+	 */
+	cache = memcache_for_alloc ( size, align, &class );
+	if ( class )
+		size = class->size;
+	if ( cache ) {
+		cache->allocs++;
+		if ( align < cache->align )
+			align = cache->align;
+		if ( ( block = cache->free ) != NULL ) {
+			cache->free = block->next;
+			cache->count--;
+			cache->hits++;
+			freemem -= size;
+			ptr = block;
+			goto done;
+		}
+	}
+
+	/* Allocate from heap.  If this fails, reclaim any cached
+	 * blocks and try again.
+	 */
+	heap_stats.allocs++;
+	ptr = heap_alloc ( size, align );
+	if ( ( ! ptr ) && ( freemem >= size ) ) {
+		mcache_flush();
+		ptr = heap_alloc ( size, align );
+	}
+	if ( ( ! ptr ) && heap_extend() )
+		ptr = heap_alloc ( size, align );
+	if ( ! ptr ) {
+		heap_failed ( size, caller );
+		return NULL;
+	}
+
+ done:
+	/* Update high-water mark */
+	if ( ( heap_stats.total - freemem ) > heap_stats.max_used )
+		heap_stats.max_used = ( heap_stats.total - freemem );
+
+	return ptr;
+}
+
+/**
+ * Allocate a memory block
+ *
+ * @v size		Requested size
+ * @v align		Physical alignment
+ * @ret ptr		Memory block, or NULL
+ *
+ * Allocates a memory block @b physically aligned as requested.  No
+ * guarantees are provided for the alignment of the virtual address.
+ *
+ * @c align must be a power of two.  @c size may not be zero.
+ */
+void * alloc_memblock ( size_t size, size_t align ) {
+	return alloc_memblock_caller ( size, align,
+				       __builtin_return_address ( 0 ) );
+}
+
+/**
+ * Free a memory block
+ *
+ * @v ptr		Memory allocated by alloc_memblock(), or NULL
+ * @v size		Size of the memory
+ *
+ * If @c ptr is NULL, no action is taken.
+ */
+void free_memblock ( void *ptr, size_t size ) {
+	struct memcache *cache;
+	struct cached_block *block;
+
+	/* Allow for ptr==NULL */
+	if ( ! ptr )
+		return;
+
+	/* Return to size-class cache, if possible */
+	cache = memcache_for_free ( ptr, size );
+	if ( cache ) {
+		cache->frees++;
+		size = cache->size;
+		if ( cache->count < cache->max ) {
+			block = ptr;
+			block->next = cache->free;
+			cache->free = block;
+			cache->count++;
+			freemem += size;
+			return;
+		}
+	}
+
+	heap_stats.frees++;
+	heap_free ( ptr, size );
+}
+
+/**
+ * Get heap statistics
+ *
+ * @v stats		Heap statistics to fill in
+ */
+void mstats ( struct heap_statistics *stats ) {
+	struct memory_block *block;
+
+	memcpy ( stats, &heap_stats, sizeof ( *stats ) );
+	stats->free = freemem;
+	stats->blocks = 0;
+	stats->largest = 0;
+	list_for_each_entry ( block, &free_blocks, list ) {
+		stats->blocks++;
+		if ( block->size > stats->largest )
+			stats->largest = block->size;
+	}
+}
+
+/**
+ * Reallocate memory on behalf of a caller
+ *
+ * @v old_ptr		Memory previously allocated by malloc(), or NULL
+ * @v new_size		Requested size
+ * @v caller		Caller address, used for failure statistics
+ * @ret new_ptr		Allocated memory, or NULL
+ */
+static void * realloc_caller ( void *old_ptr, size_t new_size,
+			       void *caller ) {
 	struct autosized_block *old_block;
 	struct autosized_block *new_block;
 	size_t old_total_size;
@@ -264,7 +577,8 @@ void * realloc ( void *old_ptr, size_t new_size ) {
 	if ( new_size ) {
 		new_total_size = ( new_size +
 				   offsetof ( struct autosized_block, data ) );
-		new_block = alloc_memblock ( new_total_size, 1 );
+		new_block = alloc_memblock_caller ( new_total_size, 1,
+						    caller );
 		if ( ! new_block )
 			return NULL;
 		new_block->size = new_total_size;
@@ -290,6 +604,31 @@ void * realloc ( void *old_ptr, size_t new_size ) {
 	return new_ptr;
 }
 
+/**
+ * Reallocate memory
+ *
+ * @v old_ptr		Memory previously allocated by malloc(), or NULL
+ * @v new_size		Requested size
+ * @ret new_ptr		Allocated memory, or NULL
+ *
+ * Allocates memory with no particular alignment requirement.  @c
+ * new_ptr will be aligned to at least a multiple of sizeof(void*).
+ * If @c old_ptr is non-NULL, then the contents of the newly allocated
+ * memory will be the same as the contents of the previously allocated
+ * memory, up to the minimum of the old and new sizes.  The old memory
+ * will be freed.
+ *
+ * If allocation fails the previously allocated block is left
+ * untouched and NULL is returned.
+ *
+ * Calling realloc() with a new size of zero is a valid way to free a
+ * memory block.
+ */
+void * realloc ( void *old_ptr, size_t new_size ) {
+	return realloc_caller ( old_ptr, new_size,
+				__builtin_return_address ( 0 ) );
+}
+
 /**
  * Allocate memory
  *
@@ -300,7 +639,7 @@ void * realloc ( void *old_ptr, size_t new_size ) {
  * will be aligned to at least a multiple of sizeof(void*).
  */
 void * malloc ( size_t size ) {
-	return realloc ( NULL, size );
+	return realloc_caller ( NULL, size, __builtin_return_address ( 0 ) );
 }
 
 /**
@@ -331,7 +670,7 @@ void free ( void *ptr ) {
 void * zalloc ( size_t size ) {
 	void *data;
 
-	data = malloc ( size );
+	data = realloc_caller ( NULL, size, __builtin_return_address ( 0 ) );
 	if ( data )
 		memset ( data, 0, size );
 	return data;
@@ -349,10 +688,12 @@ void * zalloc ( size_t size ) {
  * @c start must be aligned to at least a multiple of sizeof(void*).
  */
 void mpopulate ( void *start, size_t len ) {
-	/* Prevent free_memblock() from rounding up len beyond the end
-	 * of what we were actually given...
+	/* Prevent heap_free() from rounding up len beyond the end of
+	 * what we were actually given...
 	 */
-	free_memblock ( start, ( len & ~( MIN_MEMBLOCK_SIZE - 1 ) ) );
+	len &= ~( MIN_MEMBLOCK_SIZE - 1 );
+	heap_free ( start, len );
+	heap_stats.total += len;
 }
 
 /**
@@ -261,3 +261,13 @@ void unregister_nvo ( struct nvo_block *nvo ) {
 	nvo->data = NULL;
 	DBGC ( nvo, "NVO %p unregistered\n", nvo );
 }
+
+/**
+ * Check for non-volatile stored options block
+ *
+ * @v settings		Settings block
+ * @ret is_nvo		Settings block is a non-volatile stored options block
+ */
+int is_nvo_settings ( struct settings *settings ) {
+	return ( settings->op == &nvo_settings_operations );
+}
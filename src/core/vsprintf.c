@@ -105,7 +105,8 @@ static char * format_hex ( char *end, unsigned long long num, int width,
  * Format a decimal number
  *
  * @v end		End of buffer to contain number
- * @v num		Number to format
+ * @v num		Magnitude of number to format
+ * @v negative		Number is negative
  * @v width		Minimum field width
  * @ret ptr		End of buffer
  *
@@ -115,15 +116,11 @@ static char * format_hex ( char *end, unsigned long long num, int width,
  * There must be enough space in the buffer to contain the largest
  * number that this function can format.
  */
-static char * format_decimal ( char *end, signed long num, int width ) {
+static char * format_decimal ( char *end, unsigned long num, int negative,
+			       int width ) {
 	char *ptr = end;
-	int negative = 0;
 
 	/* Generate the number */
-	if ( num < 0 ) {
-		negative = 1;
-		num = -num;
-	}
 	do {
 		*(--ptr) = '0' + ( num % 10 );
 		num /= 10;
@@ -250,7 +247,22 @@ size_t vcprintf ( struct printf_context *ctx, const char *fmt, va_list args ) {
 			} else {
 				decimal = va_arg ( args, signed int );
 			}
-			ptr = format_decimal ( ptr, decimal, width );
+			if ( decimal < 0 ) {
+				ptr = format_decimal ( ptr, -decimal, 1,
+						       width );
+			} else {
+				ptr = format_decimal ( ptr, decimal, 0,
+						       width );
+			}
+		} else if ( *fmt == 'u' ) {
+			unsigned long decimal;
+
+			if ( *length >= sizeof ( unsigned long ) ) {
+				decimal = va_arg ( args, unsigned long );
+			} else {
+				decimal = va_arg ( args, unsigned int );
+			}
+			ptr = format_decimal ( ptr, decimal, 0, width );
 		} else {
 			*(--ptr) = *fmt;
 		}
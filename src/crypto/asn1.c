@@ -20,6 +20,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
 #include <errno.h>
 #include <gpxe/asn1.h>
 
@@ -164,3 +165,35 @@ int asn1_skip ( struct asn1_cursor *cursor, unsigned int type ) {
 
 	return 0;
 }
+
+/**
+ * Shrink ASN.1 cursor to fit object
+ *
+ * @v cursor		ASN.1 object cursor
+ * @v type		Expected type
+ * @ret rc		Return status code
+ *
+ * The object cursor will be shrunk to contain only the current ASN.1
+ * object, including its tag and length.  This is useful when the
+ * encoded form of an object is required (e.g. to calculate a
+ * signature over it).  If any error occurs, the object cursor will be
+ * invalidated.
+ */
+int asn1_shrink ( struct asn1_cursor *cursor, unsigned int type ) {
+	struct asn1_cursor temp;
+	int len;
+
+	memcpy ( &temp, cursor, sizeof ( temp ) );
+	len = asn1_start ( &temp, type );
+	if ( len < 0 ) {
+		cursor->data = NULL;
+		cursor->len = 0;
+		return len;
+	}
+
+	cursor->len = ( ( temp.data - cursor->data ) + len );
+	DBGC ( cursor, "ASN1 %p shrunk to object type %02x (len %zx)\n",
+	       cursor, type, cursor->len );
+
+	return 0;
+}
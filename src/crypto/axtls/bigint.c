@@ -56,6 +56,23 @@
 #include "bigint.h"
 #include "crypto.h"
 
+#if defined(CONFIG_BIGINT_MONTGOMERY)
+#include <bits/bigint.h>
+
+#ifndef __HAVE_ARCH_BIGINT_MULADD
+/* (c2:c1:c0) += a*b */
+#define bigint_muladd(a, b, c0, c1, c2) do {                    \
+    long_comp _p = (long_comp)(a)*(b);                          \
+    long_comp _t = (long_comp)(c0) + (comp)_p;                  \
+    (c0) = (comp)_t;                                            \
+    _t = (long_comp)(c1) + (comp)(_p >> COMP_BIT_SIZE) +        \
+        (_t >> COMP_BIT_SIZE);                                  \
+    (c1) = (comp)_t;                                            \
+    (c2) += (comp)(_t >> COMP_BIT_SIZE);                        \
+} while (0)
+#endif
+#endif
+
 static bigint *bi_int_multiply(BI_CTX *ctx, bigint *bi, comp i);
 static bigint *bi_int_divide(BI_CTX *ctx, bigint *biR, comp denom);
 static bigint __malloc *alloc(BI_CTX *ctx, int size);
@@ -1092,7 +1109,7 @@ static int find_max_exp_index(bigint *biexp)
         }
 
         shift >>= 1;
-    } while (--i != 0);
+    } while (i-- != 0);
 
     return -1;      /* error - must have been a leading 0 */
 }
@@ -1358,6 +1375,197 @@ static void precompute_slide_window(BI_CTX *ctx, int window, bigint *g1)
 }
 #endif
 
+#if defined(CONFIG_BIGINT_MONTGOMERY)
+/*
+ * Montgomery multiplication r = a*b*R^-1 mod m of n-component values a, b
+ * (both less than m). The multiplication and the reduction are fused into a
+ * single pass over the columns of the product (Comba-style product scanning,
+ * the "FIPS" method of Koc, Acar and Kaliski), so the double-length product
+ * is never formed and no bigints are allocated. t is scratch space of n+1
+ * components. r may be the same as a or b.
+ */
+static void mont_multiply(comp *r, const comp *a, const comp *b, 
+        const comp *m, comp n0_dash, comp *t, int n)
+{
+    comp c0 = 0, c1 = 0, c2 = 0;
+    comp borrow = 0;
+    int i, j;
+
+    /* low half: work out the reduction multiples as we go */
+    for (i = 0; i < n; i++)
+    {
+        for (j = 0; j < i; j++)
+        {
+            bigint_muladd(a[j], b[i-j], c0, c1, c2);
+            bigint_muladd(t[j], m[i-j], c0, c1, c2);
+        }
+
+        bigint_muladd(a[i], b[0], c0, c1, c2);
+        t[i] = c0*n0_dash;
+        bigint_muladd(t[i], m[0], c0, c1, c2);  /* clears c0 */
+        c0 = c1;
+        c1 = c2;
+        c2 = 0;
+    }
+
+    /* high half: the multiples are overwritten by the result */
+    for (i = n; i < 2*n; i++)
+    {
+        for (j = i-n+1; j < n; j++)
+        {
+            bigint_muladd(a[j], b[i-j], c0, c1, c2);
+            bigint_muladd(t[j], m[i-j], c0, c1, c2);
+        }
+
+        t[i-n] = c0;
+        c0 = c1;
+        c1 = c2;
+        c2 = 0;
+    }
+
+    /* the result is less than 2m, so at most one subtraction is needed */
+    if (c0 == 0)
+    {
+        for (i = n-1; i >= 0 && t[i] == m[i]; i--);
+
+        if (i >= 0 && t[i] < m[i])
+        {
+            memcpy(r, t, n*COMP_BYTE_SIZE);
+            return;
+        }
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        long_comp tmp = (long_comp)t[i] - m[i] - borrow;
+        r[i] = (comp)tmp;                       /* downsize */
+        borrow = (comp)(tmp >> COMP_BIT_SIZE) & 1;
+    }
+}
+
+/*
+ * Choose the fixed window size for an exponent of a given length. Short
+ * (i.e. public) exponents are done a bit at a time, since the cost of
+ * building the table would outweigh any multiplications saved.
+ */
+static int mont_window_size(int num_bits)
+{
+    if (num_bits <= 24)
+        return 1;
+    else if (num_bits <= 80)
+        return 3;
+    else if (num_bits <= 240)
+        return 4;
+    else
+        return 5;
+}
+
+/*
+ * Extract window_size bits of an exponent, starting at bit offset.
+ */
+static int exp_window(bigint *biexp, int offset, int window_size, 
+        int max_index)
+{
+    int value = 0;
+    int i;
+
+    for (i = offset+window_size-1; i >= offset; i--)
+    {
+        value <<= 1;
+
+        if (i <= max_index && exp_bit_is_one(biexp, i))
+            value |= 1;
+    }
+
+    return value;
+}
+
+/*
+ * Fixed-window modular exponentiation using fused Montgomery
+ * multiplication on the raw components. Returns NULL if the table of
+ * powers cannot be allocated.
+ */
+static bigint *bi_mont_power(BI_CTX *ctx, bigint *bi, bigint *biexp)
+{
+    uint8_t mod_offset = ctx->mod_offset;
+    bigint *bim = ctx->bi_mod[mod_offset];
+    bigint *biRR = ctx->bi_RR_mod_m[mod_offset];
+    bigint *biR_mod_m = ctx->bi_R_mod_m[mod_offset];
+    comp n0_dash = ctx->N0_dash[mod_offset];
+    comp *m = bim->comps;
+    int n = bim->size;
+    int max_index = find_max_exp_index(biexp);
+    int window_size = mont_window_size(max_index+1);
+    int table_size = 1 << window_size;
+    comp *g, *acc, *t;
+    bigint *biR;
+    int i, j, value;
+
+    check(bi);
+    check(biexp);
+
+    /* Montgomery multiplication needs its inputs to be less than m */
+    if (bi_compare(bi, bim) >= 0)
+        bi = bi_mod(ctx, bi);
+
+    /* the table of powers, followed by the accumulator and scratch space */
+    g = (comp *)calloc((table_size+2)*n + 1, COMP_BYTE_SIZE);
+    if (g == NULL)
+    {
+        bi_free(ctx, bi);
+        bi_free(ctx, biexp);
+        return NULL;
+    }
+
+    acc = &g[table_size*n];
+    t = &acc[n];
+
+    /* g[1] = x*R mod m (using g[0] for R^2 mod m), g[0] = R mod m */
+    memcpy(acc, bi->comps, bi->size*COMP_BYTE_SIZE);
+    memcpy(g, biRR->comps, biRR->size*COMP_BYTE_SIZE);
+    mont_multiply(&g[n], acc, g, m, n0_dash, t, n);
+    memset(g, 0, n*COMP_BYTE_SIZE);
+    memcpy(g, biR_mod_m->comps, biR_mod_m->size*COMP_BYTE_SIZE);
+
+    for (i = 2; i < table_size; i++)
+    {
+        mont_multiply(&g[i*n], &g[(i-1)*n], &g[n], m, n0_dash, t, n);
+    }
+
+    /* start with the most significant (possibly partial) window */
+    i = ((max_index+window_size)/window_size - 1)*window_size;
+    value = exp_window(biexp, i, window_size, max_index);
+    memcpy(acc, &g[value*n], n*COMP_BYTE_SIZE);
+
+    while ((i -= window_size) >= 0)
+    {
+        for (j = 0; j < window_size; j++)
+        {
+            mont_multiply(acc, acc, acc, m, n0_dash, t, n);
+        }
+
+        value = exp_window(biexp, i, window_size, max_index);
+
+        if (value)
+        {
+            mont_multiply(acc, acc, &g[value*n], m, n0_dash, t, n);
+        }
+    }
+
+    /* convert back by multiplying by 1 */
+    memset(g, 0, n*COMP_BYTE_SIZE);
+    g[0] = 1;
+    mont_multiply(acc, acc, g, m, n0_dash, t, n);
+
+    biR = alloc(ctx, n);
+    memcpy(biR->comps, acc, n*COMP_BYTE_SIZE);
+    free(g);
+    bi_free(ctx, bi);
+    bi_free(ctx, biexp);
+    return trim(biR);
+}
+#endif
+
 /**
  * @brief Perform a modular exponentiation.
  *
@@ -1366,25 +1574,23 @@ static void precompute_slide_window(BI_CTX *ctx, int window, bigint *g1)
  * @param ctx [in]  The bigint session context.
  * @param bi  [in]  The bigint on which to perform the mod power operation.
  * @param biexp [in] The bigint exponent.
+ * @return The result, or NULL if memory could not be allocated.
  * @see bi_set_mod().
  */
 bigint *bi_mod_power(BI_CTX *ctx, bigint *bi, bigint *biexp)
 {
-    int i = find_max_exp_index(biexp), j, window_size = 1;
-    bigint *biR = int_to_bi(ctx, 1);
+    int i, j, window_size = 1;
+    bigint *biR;
 
 #if defined(CONFIG_BIGINT_MONTGOMERY)
-    uint8_t mod_offset = ctx->mod_offset;
     if (!ctx->use_classical)
     {
-        /* preconvert */
-        bi = bi_mont(ctx, 
-                bi_multiply(ctx, bi, ctx->bi_RR_mod_m[mod_offset]));    /* x' */
-        bi_free(ctx, biR);
-        biR = ctx->bi_R_mod_m[mod_offset];                              /* A */
+        return bi_mont_power(ctx, bi, biexp);
     }
 #endif
 
+    i = find_max_exp_index(biexp);
+    biR = int_to_bi(ctx, 1);
     check(bi);
     check(biexp);
 
@@ -1450,11 +1656,7 @@ bigint *bi_mod_power(BI_CTX *ctx, bigint *bi, bigint *biexp)
     free(ctx->g);
     bi_free(ctx, bi);
     bi_free(ctx, biexp);
-#if defined CONFIG_BIGINT_MONTGOMERY
-    return ctx->use_classical ? biR : bi_mont(ctx, biR); /* convert back */
-#else /* CONFIG_BIGINT_CLASSICAL or CONFIG_BIGINT_BARRETT */
     return biR;
-#endif
 }
 
 #ifdef CONFIG_SSL_CERT_VERIFICATION
@@ -1482,8 +1684,13 @@ bigint *bi_mod_power2(BI_CTX *ctx, bigint *bi, bigint *bim, bigint *biexp)
     tmp_biR = bi_mod_power(tmp_ctx, 
                 bi_clone(tmp_ctx, bi), 
                 bi_clone(tmp_ctx, biexp));
-    biR = bi_clone(ctx, tmp_biR);
-    bi_free(tmp_ctx, tmp_biR);
+    biR = NULL;
+    if (tmp_biR)
+    {
+        biR = bi_clone(ctx, tmp_biR);
+        bi_free(tmp_ctx, tmp_biR);
+    }
+
     bi_free_mod(tmp_ctx, BIGINT_M_OFFSET);
     bi_terminate(tmp_ctx);
 
@@ -56,6 +56,6 @@ static inline int fclose ( FILE *stream __unused ) {
 #define CONFIG_X509_MAX_CA_CERTS 1
 #define CONFIG_SSL_EXPIRY_TIME 24
 #define CONFIG_SSL_ENABLE_CLIENT 1
-#define CONFIG_BIGINT_CLASSICAL 1
+#define CONFIG_BIGINT_MONTGOMERY 1
 
 #endif 
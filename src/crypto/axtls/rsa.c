@@ -144,6 +144,8 @@ int RSA_decrypt(const RSA_CTX *ctx, const uint8_t *in_data,
 #else   /* always a decryption */
     decrypted_bi = RSA_private(ctx, dat_bi);
 #endif
+    if (decrypted_bi == NULL)
+        return -1;
 
     /* convert to a normal block */
     block = (uint8_t *)malloc(byte_size);
@@ -251,6 +253,7 @@ bigint *RSA_public(const RSA_CTX * c, bigint *bi_msg)
 /**
  * Use PKCS1.5 for encryption/signing.
  * see http://www.rsasecurity.com/rsalabs/node.asp?id=2125
+ * Returns the size of the encrypted data, or -1 on error.
  */
 int RSA_encrypt(const RSA_CTX *ctx, const uint8_t *in_data, uint16_t in_len, 
         uint8_t *out_data, int is_signing)
@@ -280,6 +283,8 @@ int RSA_encrypt(const RSA_CTX *ctx, const uint8_t *in_data, uint16_t in_len,
     dat_bi = bi_import(ctx->bi_ctx, out_data, byte_size);
     encrypt_bi = is_signing ? RSA_private(ctx, dat_bi) : 
         RSA_public(ctx, dat_bi);
+    if (encrypt_bi == NULL)
+        return -1;
     bi_export(ctx->bi_ctx, encrypt_bi, out_data, byte_size);
     return byte_size;
 }
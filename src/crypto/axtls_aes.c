@@ -23,6 +23,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <byteswap.h>
 #include <gpxe/crypto.h>
 #include <gpxe/cbc.h>
+#include <gpxe/gcm.h>
 #include <gpxe/aes.h>
 #include "crypto/axtls/crypto.h"
 
@@ -65,6 +66,9 @@ static int aes_setkey ( void *ctx, const void *key, size_t keylen ) {
 
 	aes_ctx->decrypting = 0;
 
+	/* Use architecture-specific implementation, if available */
+	aes_ctx->accelerated = ( aes_arch_setkey ( aes_ctx ) == 0 );
+
 	return 0;
 }
 
@@ -116,10 +120,18 @@ static void aes_encrypt ( void *ctx, const void *src, void *dst,
 			  size_t len ) {
 	struct aes_context *aes_ctx = ctx;
 
-	assert ( len == AES_BLOCKSIZE );
+	assert ( ( len % AES_BLOCKSIZE ) == 0 );
+	if ( aes_ctx->accelerated ) {
+		aes_arch_encrypt ( aes_ctx, src, dst, len );
+		return;
+	}
 	if ( aes_ctx->decrypting )
 		assert ( 0 );
-	aes_call_axtls ( &aes_ctx->axtls_ctx, src, dst, AES_encrypt );
+	for ( ; len ; len -= AES_BLOCKSIZE ) {
+		aes_call_axtls ( &aes_ctx->axtls_ctx, src, dst, AES_encrypt );
+		src += AES_BLOCKSIZE;
+		dst += AES_BLOCKSIZE;
+	}
 }
 
 /**
@@ -134,12 +146,20 @@ static void aes_decrypt ( void *ctx, const void *src, void *dst,
 			  size_t len ) {
 	struct aes_context *aes_ctx = ctx;
 
-	assert ( len == AES_BLOCKSIZE );
+	assert ( ( len % AES_BLOCKSIZE ) == 0 );
+	if ( aes_ctx->accelerated ) {
+		aes_arch_decrypt ( aes_ctx, src, dst, len );
+		return;
+	}
 	if ( ! aes_ctx->decrypting ) {
 		AES_convert_key ( &aes_ctx->axtls_ctx );
 		aes_ctx->decrypting = 1;
 	}
-	aes_call_axtls ( &aes_ctx->axtls_ctx, src, dst, AES_decrypt );
+	for ( ; len ; len -= AES_BLOCKSIZE ) {
+		aes_call_axtls ( &aes_ctx->axtls_ctx, src, dst, AES_decrypt );
+		src += AES_BLOCKSIZE;
+		dst += AES_BLOCKSIZE;
+	}
 }
 
 /** Basic AES algorithm */
@@ -156,3 +176,7 @@ struct cipher_algorithm aes_algorithm = {
 /* AES with cipher-block chaining */
 CBC_CIPHER ( aes_cbc, aes_cbc_algorithm,
 	     aes_algorithm, struct aes_context, AES_BLOCKSIZE );
+
+/* AES in Galois/Counter mode */
+GCM_CIPHER ( aes_gcm, aes_gcm_algorithm,
+	     aes_algorithm, struct aes_context );
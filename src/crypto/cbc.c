@@ -74,6 +74,19 @@ void cbc_encrypt ( void *ctx, const void *src, void *dst, size_t len,
 	}
 }
 
+/** Maximum length of data passed to the underlying cipher for decryption
+ *
+ * Unlike encryption, CBC decryption of each block does not depend on
+ * the result of decrypting the previous block, so several blocks can
+ * be passed to the underlying cipher at once.  This allows a cipher
+ * implementation to process independent blocks in parallel.
+ *
+ * In-place decryption requires a copy of the ciphertext on the stack,
+ * so this is kept to the four blocks that the AES-NI implementation
+ * processes at a time.
+ */
+#define CBC_DECRYPT_MAX_LEN 64
+
 /**
  * Decrypt data
  *
@@ -83,19 +96,43 @@ void cbc_encrypt ( void *ctx, const void *src, void *dst, size_t len,
  * @v len		Length of data
  * @v raw_cipher	Underlying cipher algorithm
  * @v cbc_ctx		CBC context
+ *
+ * The source and destination buffers may be identical, but must not
+ * otherwise overlap.
  */
 void cbc_decrypt ( void *ctx, const void *src, void *dst, size_t len,
 		   struct cipher_algorithm *raw_cipher, void *cbc_ctx ) {
 	size_t blocksize = raw_cipher->blocksize;
+	uint8_t saved[CBC_DECRYPT_MAX_LEN];
+	const void *prev;
+	size_t frag_len;
 
 	assert ( ( len % blocksize ) == 0 );
+	assert ( ( sizeof ( saved ) % blocksize ) == 0 );
 
 	while ( len ) {
-		cipher_decrypt ( raw_cipher, ctx, src, dst, blocksize );
+		frag_len = len;
+		if ( frag_len > sizeof ( saved ) )
+			frag_len = sizeof ( saved );
+
+		/* Preserve ciphertext if decrypting in place */
+		if ( src == dst ) {
+			memcpy ( saved, src, frag_len );
+			prev = saved;
+		} else {
+			prev = src;
+		}
+
+		/* Decrypt all blocks, then XOR each with the preceding
+		 * ciphertext block
+		 */
+		cipher_decrypt ( raw_cipher, ctx, src, dst, frag_len );
 		cbc_xor ( cbc_ctx, dst, blocksize );
-		memcpy ( cbc_ctx, src, blocksize );
-		dst += blocksize;
-		src += blocksize;
-		len -= blocksize;
+		cbc_xor ( prev, ( dst + blocksize ), ( frag_len - blocksize ) );
+		memcpy ( cbc_ctx, ( prev + frag_len - blocksize ), blocksize );
+
+		dst += frag_len;
+		src += frag_len;
+		len -= frag_len;
 	}
 }
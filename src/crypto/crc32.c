@@ -20,10 +20,47 @@
 
 FILE_LICENCE ( GPL2_OR_LATER );
 
+#include <stdint.h>
+#include <byteswap.h>
 #include <gpxe/crc32.h>
 
 #define CRCPOLY		0xedb88320
 
+/**
+ * Slice-by-8 lookup tables
+ *
+ * These are constructed on first use, so that they occupy space only
+ * in .bss.
+ */
+static u32 crc32_table[8][256];
+
+/** Slice-by-8 lookup tables have been constructed */
+static int crc32_table_ready;
+
+/**
+ * Construct slice-by-8 lookup tables
+ */
+static void crc32_init_table ( void )
+{
+	u32 crc;
+	int i, j;
+
+	for ( i = 0; i < 256; i++ ) {
+		crc = i;
+		for ( j = 0; j < 8; j++ )
+			crc = ( crc >> 1 ) ^ ( ( crc & 1 ) ? CRCPOLY : 0 );
+		crc32_table[0][i] = crc;
+	}
+	for ( i = 0; i < 256; i++ ) {
+		crc = crc32_table[0][i];
+		for ( j = 1; j < 8; j++ ) {
+			crc = ( crc >> 8 ) ^ crc32_table[0][crc & 0xff];
+			crc32_table[j][i] = crc;
+		}
+	}
+	crc32_table_ready = 1;
+}
+
 /**
  * Calculate 32-bit little-endian CRC checksum
  *
@@ -34,21 +71,46 @@ FILE_LICENCE ( GPL2_OR_LATER );
  * Usually @a seed is initially zero or all one bits, depending on the
  * protocol. To continue a CRC checksum over multiple calls, pass the
  * return value from one call as the @a seed parameter to the next.
+ *
+ * This uses the "slice-by-8" algorithm, processing eight bytes per
+ * iteration.
  */
 u32 crc32_le ( u32 seed, const void *data, size_t len )
 {
 	u32 crc = seed;
 	const u8 *src = data;
-	u32 mult;
-	int i;
-
-	while ( len-- ) {
-		crc ^= *src++;
-		for ( i = 0; i < 8; i++ ) {
-			mult = ( crc & 1 ) ? CRCPOLY : 0;
-			crc = ( crc >> 1 ) ^ mult;
-		}
+	const u32 *src32;
+	u32 low, high;
+
+	if ( ! crc32_table_ready )
+		crc32_init_table();
+
+	/* Process leading bytes up to a dword boundary */
+	while ( len && ( ( intptr_t ) src & 3 ) ) {
+		crc = ( crc >> 8 ) ^ crc32_table[0][( crc ^ *src++ ) & 0xff];
+		len--;
 	}
 
+	/* Process eight bytes at a time */
+	src32 = ( const void * ) src;
+	while ( len >= 8 ) {
+		low = crc ^ le32_to_cpu ( *src32++ );
+		high = le32_to_cpu ( *src32++ );
+		crc = ( crc32_table[7][low & 0xff] ^
+			crc32_table[6][( low >> 8 ) & 0xff] ^
+			crc32_table[5][( low >> 16 ) & 0xff] ^
+			crc32_table[4][low >> 24] ^
+			crc32_table[3][high & 0xff] ^
+			crc32_table[2][( high >> 8 ) & 0xff] ^
+			crc32_table[1][( high >> 16 ) & 0xff] ^
+			crc32_table[0][high >> 24] );
+		len -= 8;
+	}
+
+	/* Process trailing bytes */
+	src = ( const void * ) src32;
+	while ( len-- )
+		crc = ( crc >> 8 ) ^ crc32_table[0][( crc ^ *src++ ) & 0xff];
+
 	return crc;
 }
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <byteswap.h>
+#include <gpxe/crc32c.h>
+
+/** @file
+ *
+ * CRC32C (Castagnoli) checksum
+ *
+ * This is the CRC used by iSCSI header and data digests (RFC 3720).
+ * The generic implementation uses the "slice-by-8" algorithm, which
+ * processes eight bytes per iteration using eight 256-entry lookup
+ * tables.  The tables are constructed on first use, so that they
+ * occupy space only in .bss.
+ */
+
+/** CRC32C polynomial (bit-reversed) */
+#define CRC32C_POLY 0x82f63b78
+
+/** Slice-by-8 lookup tables */
+static uint32_t crc32c_table[8][256];
+
+/** Slice-by-8 lookup tables have been constructed */
+static int crc32c_table_ready;
+
+/**
+ * Construct slice-by-8 lookup tables
+ *
+ */
+static void crc32c_init_table ( void ) {
+	uint32_t crc;
+	unsigned int i;
+	unsigned int j;
+
+	for ( i = 0 ; i < 256 ; i++ ) {
+		crc = i;
+		for ( j = 0 ; j < 8 ; j++ )
+			crc = ( ( crc >> 1 ) ^ ( ( crc & 1 ) ? CRC32C_POLY : 0 ));
+		crc32c_table[0][i] = crc;
+	}
+	for ( i = 0 ; i < 256 ; i++ ) {
+		crc = crc32c_table[0][i];
+		for ( j = 1 ; j < 8 ; j++ ) {
+			crc = ( ( crc >> 8 ) ^ crc32c_table[0][ crc & 0xff ] );
+			crc32c_table[j][i] = crc;
+		}
+	}
+	crc32c_table_ready = 1;
+}
+
+/**
+ * Calculate 32-bit little-endian CRC32C checksum
+ *
+ * @v seed		Initial value
+ * @v data		Data to checksum
+ * @v len		Length of data
+ * @ret crc		CRC32C checksum
+ *
+ * As with crc32_le(), no pre- or post-inversion is performed; iSCSI
+ * digests use an initial value of 0xffffffff and invert the final
+ * result.  To continue a checksum over multiple calls, pass the
+ * return value from one call as the @a seed parameter to the next.
+ */
+uint32_t crc32c_le_generic ( uint32_t seed, const void *data, size_t len ) {
+	const uint8_t *bytes = data;
+	const uint32_t *dwords;
+	uint32_t crc = seed;
+	uint32_t low;
+	uint32_t high;
+
+	if ( ! crc32c_table_ready )
+		crc32c_init_table();
+
+	/* Process leading bytes up to a dword boundary */
+	while ( len && ( ( ( intptr_t ) bytes ) & 3 ) ) {
+		crc = ( ( crc >> 8 ) ^
+			crc32c_table[0][ ( crc ^ *(bytes++) ) & 0xff ] );
+		len--;
+	}
+
+	/* Process eight bytes at a time */
+	dwords = ( ( const void * ) bytes );
+	while ( len >= 8 ) {
+		low = ( crc ^ le32_to_cpu ( *(dwords++) ) );
+		high = le32_to_cpu ( *(dwords++) );
+		crc = ( crc32c_table[7][ low & 0xff ] ^
+			crc32c_table[6][ ( low >> 8 ) & 0xff ] ^
+			crc32c_table[5][ ( low >> 16 ) & 0xff ] ^
+			crc32c_table[4][ low >> 24 ] ^
+			crc32c_table[3][ high & 0xff ] ^
+			crc32c_table[2][ ( high >> 8 ) & 0xff ] ^
+			crc32c_table[1][ ( high >> 16 ) & 0xff ] ^
+			crc32c_table[0][ high >> 24 ] );
+		len -= 8;
+	}
+
+	/* Process trailing bytes */
+	bytes = ( ( const void * ) dwords );
+	while ( len-- ) {
+		crc = ( ( crc >> 8 ) ^
+			crc32c_table[0][ ( crc ^ *(bytes++) ) & 0xff ] );
+	}
+
+	return crc;
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <string.h>
+#include <gpxe/crypto.h>
+
+/** @file
+ *
+ * Digest algorithm lookup
+ *
+ */
+
+/**
+ * Find digest algorithm by name
+ *
+ * @v name		Algorithm name (e.g. "sha1")
+ * @ret digest		Digest algorithm, or NULL if not found
+ */
+struct digest_algorithm * find_digest ( const char *name ) {
+	struct digest_algorithm *digest;
+
+	for_each_table_entry ( digest, DIGEST_ALGORITHMS ) {
+		if ( strcmp ( digest->name, name ) == 0 )
+			return digest;
+	}
+	return NULL;
+}
+
+/**
+ * Find digest algorithm by digest size
+ *
+ * @v digestsize	Digest size
+ * @ret digest		Digest algorithm, or NULL if not found
+ *
+ * This allows the algorithm to be inferred from the length of an
+ * expected digest value.
+ */
+struct digest_algorithm * find_digest_by_size ( size_t digestsize ) {
+	struct digest_algorithm *digest;
+
+	for_each_table_entry ( digest, DIGEST_ALGORITHMS ) {
+		if ( digest->digestsize == digestsize )
+			return digest;
+	}
+	return NULL;
+}
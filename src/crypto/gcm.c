@@ -0,0 +1,427 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <byteswap.h>
+#include <gpxe/crypto.h>
+#include <gpxe/gcm.h>
+
+/** @file
+ *
+ * Galois/Counter Mode (GCM)
+ *
+ * The generic GHASH implementation uses Shoup's method with 4-bit
+ * tables (256 bytes per key).  The counter-mode keystream is
+ * generated several blocks at a time, so that an underlying cipher
+ * implementation which can process multiple blocks in parallel is
+ * able to do so.
+ */
+
+/** Number of keystream blocks to generate at once */
+#define GCM_STREAM_BLOCKS 8
+
+/** Reduction constants for the generic GHASH implementation
+ *
+ * Entry n is the reduction of the four bits shifted out by a 4-bit
+ * right shift with value n, in the top 16 bits of the hash.
+ */
+static const uint16_t gcm_reduce[16] = {
+	0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+	0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0,
+};
+
+/** An all-zeroes block */
+static const union gcm_block gcm_zero;
+
+/**
+ * Construct tables for generic GHASH implementation
+ *
+ * @v ctx		GCM context, with hash key set
+ */
+static void gcm_init_tables ( struct gcm_context *ctx ) {
+	uint64_t vh = be64_to_cpu ( ctx->key.qword[0] );
+	uint64_t vl = be64_to_cpu ( ctx->key.qword[1] );
+	uint32_t carry;
+	unsigned int i;
+	unsigned int j;
+
+	/* Entry 8 is H itself (bit order is reversed within GHASH) */
+	ctx->hh[0] = ctx->hl[0] = 0;
+	ctx->hh[8] = vh;
+	ctx->hl[8] = vl;
+
+	/* Entries 4, 2 and 1 are successive multiples of H by x */
+	for ( i = 4 ; i > 0 ; i >>= 1 ) {
+		carry = ( ( vl & 1 ) ? 0xe1000000UL : 0 );
+		vl = ( ( vh << 63 ) | ( vl >> 1 ) );
+		vh = ( ( vh >> 1 ) ^ ( ( ( uint64_t ) carry ) << 32 ) );
+		ctx->hh[i] = vh;
+		ctx->hl[i] = vl;
+	}
+
+	/* Remaining entries are sums of the above */
+	for ( i = 2 ; i <= 8 ; i <<= 1 ) {
+		for ( j = 1 ; j < i ; j++ ) {
+			ctx->hh[ i + j ] = ( ctx->hh[i] ^ ctx->hh[j] );
+			ctx->hl[ i + j ] = ( ctx->hl[i] ^ ctx->hl[j] );
+		}
+	}
+}
+
+/**
+ * Multiply accumulated hash by hash key using generic implementation
+ *
+ * @v ctx		GCM context
+ */
+static void gcm_multiply ( struct gcm_context *ctx ) {
+	const uint8_t *x = ctx->hash.byte;
+	uint64_t zh;
+	uint64_t zl;
+	unsigned int rem;
+	unsigned int nibble;
+	int i;
+
+	zh = zl = 0;
+	for ( i = ( sizeof ( ctx->hash ) - 1 ) ; i >= 0 ; i-- ) {
+
+		/* Low nibble */
+		nibble = ( x[i] & 0x0f );
+		rem = ( zl & 0x0f );
+		zl = ( ( zh << 60 ) | ( zl >> 4 ) );
+		zh = ( ( zh >> 4 ) ^ ( ( ( uint64_t ) gcm_reduce[rem] ) << 48 ) );
+		zh ^= ctx->hh[nibble];
+		zl ^= ctx->hl[nibble];
+
+		/* High nibble */
+		nibble = ( x[i] >> 4 );
+		rem = ( zl & 0x0f );
+		zl = ( ( zh << 60 ) | ( zl >> 4 ) );
+		zh = ( ( zh >> 4 ) ^ ( ( ( uint64_t ) gcm_reduce[rem] ) << 48 ) );
+		zh ^= ctx->hh[nibble];
+		zl ^= ctx->hl[nibble];
+	}
+
+	ctx->hash.qword[0] = cpu_to_be64 ( zh );
+	ctx->hash.qword[1] = cpu_to_be64 ( zl );
+}
+
+/**
+ * Update GHASH with whole blocks
+ *
+ * @v ctx		GCM context
+ * @v data		Data
+ * @v blocks		Number of blocks
+ */
+static void gcm_ghash_blocks ( struct gcm_context *ctx, const void *data,
+			       size_t blocks ) {
+	const uint8_t *bytes = data;
+	unsigned int i;
+
+	if ( ctx->accelerated ) {
+		gcm_arch_ghash ( &ctx->hash, &ctx->key, data, blocks );
+		return;
+	}
+
+	while ( blocks-- ) {
+		for ( i = 0 ; i < sizeof ( ctx->hash ) ; i++ )
+			ctx->hash.byte[i] ^= *(bytes++);
+		gcm_multiply ( ctx );
+	}
+}
+
+/**
+ * Update GHASH
+ *
+ * @v ctx		GCM context
+ * @v data		Data
+ * @v len		Length of data
+ * @v offset		Offset of data within current block
+ *
+ * Any trailing partial block is accumulated into the hash, but is not
+ * multiplied by the hash key until the block is completed (or padded
+ * by gcm_ghash_pad()).
+ */
+static void gcm_ghash ( struct gcm_context *ctx, const void *data,
+			size_t len, size_t offset ) {
+	const uint8_t *bytes = data;
+	size_t blocks;
+
+	/* Complete any partial block */
+	if ( offset ) {
+		while ( len && ( offset < sizeof ( ctx->hash ) ) ) {
+			ctx->hash.byte[offset++] ^= *(bytes++);
+			len--;
+		}
+		if ( offset < sizeof ( ctx->hash ) )
+			return;
+		gcm_ghash_blocks ( ctx, &gcm_zero, 1 );
+	}
+
+	/* Process whole blocks */
+	blocks = ( len / sizeof ( ctx->hash ) );
+	gcm_ghash_blocks ( ctx, bytes, blocks );
+	bytes += ( blocks * sizeof ( ctx->hash ) );
+	len -= ( blocks * sizeof ( ctx->hash ) );
+
+	/* Accumulate any trailing partial block */
+	for ( offset = 0 ; offset < len ; offset++ )
+		ctx->hash.byte[offset] ^= bytes[offset];
+}
+
+/**
+ * Pad GHASH input to a whole block
+ *
+ * @v ctx		GCM context
+ * @v len		Length of data hashed so far
+ */
+static void gcm_ghash_pad ( struct gcm_context *ctx, uint64_t len ) {
+
+	/* Partial block bytes are already accumulated into the hash */
+	if ( len % sizeof ( ctx->hash ) )
+		gcm_ghash_blocks ( ctx, &gcm_zero, 1 );
+}
+
+/**
+ * Set key
+ *
+ * @v ctx		GCM context
+ * @v key		Key
+ * @v keylen		Key length
+ * @v raw_cipher	Underlying cipher algorithm
+ * @v raw_ctx		Underlying cipher context
+ * @ret rc		Return status code
+ */
+int gcm_setkey ( struct gcm_context *ctx, const void *key, size_t keylen,
+		 struct cipher_algorithm *raw_cipher, void *raw_ctx ) {
+	int rc;
+
+	/* Sanity check */
+	if ( raw_cipher->blocksize != GCM_BLOCKSIZE )
+		return -ENOTSUP;
+
+	/* Set underlying cipher key */
+	if ( ( rc = cipher_setkey ( raw_cipher, raw_ctx, key, keylen ) ) != 0 )
+		return rc;
+
+	/* Hash key is the encryption of an all-zeroes block */
+	memset ( ctx, 0, sizeof ( *ctx ) );
+	cipher_encrypt ( raw_cipher, raw_ctx, &gcm_zero, &ctx->key,
+			 sizeof ( ctx->key ) );
+	gcm_init_tables ( ctx );
+
+	/* Use architecture-specific GHASH, if available */
+	ctx->accelerated = gcm_arch_supported();
+
+	return 0;
+}
+
+/**
+ * Set initialisation vector
+ *
+ * @v ctx		GCM context
+ * @v iv		Initialisation vector (GCM_IV_LEN bytes)
+ * @v raw_cipher	Underlying cipher algorithm
+ * @v raw_ctx		Underlying cipher context
+ *
+ * This also resets the accumulated hash, ready for a new message.
+ */
+void gcm_setiv ( struct gcm_context *ctx, const void *iv,
+		 struct cipher_algorithm *raw_cipher, void *raw_ctx ) {
+
+	/* Initial counter block is IV || 0^31 || 1 */
+	memcpy ( &ctx->ctr, iv, GCM_IV_LEN );
+	ctx->ctr.dword[3] = htonl ( 1 );
+	cipher_encrypt ( raw_cipher, raw_ctx, &ctx->ctr, &ctx->mask,
+			 sizeof ( ctx->mask ) );
+
+	/* Reset hash */
+	memset ( &ctx->hash, 0, sizeof ( ctx->hash ) );
+	ctx->add_len = 0;
+	ctx->data_len = 0;
+}
+
+/**
+ * Encrypt or decrypt data
+ *
+ * @v ctx		GCM context
+ * @v src		Data to process
+ * @v dst		Buffer for processed data
+ * @v len		Length of data
+ * @v raw_cipher	Underlying cipher algorithm
+ * @v raw_ctx		Underlying cipher context
+ * @v encrypting	Data is being encrypted
+ *
+ * @c dst may be the same as @c src.
+ */
+static void gcm_crypt ( struct gcm_context *ctx, const void *src,
+			void *dst, size_t len,
+			struct cipher_algorithm *raw_cipher, void *raw_ctx,
+			int encrypting ) {
+	union gcm_block stream[GCM_STREAM_BLOCKS];
+	const uint8_t *in = src;
+	uint8_t *out = dst;
+	const uint8_t *keystream;
+	size_t offset;
+	size_t frag_len;
+	unsigned int blocks;
+	unsigned int i;
+
+	/* Pad additional data before processing any encrypted data */
+	if ( len && ( ctx->data_len == 0 ) )
+		gcm_ghash_pad ( ctx, ctx->add_len );
+
+	while ( len ) {
+
+		offset = ( ctx->data_len % sizeof ( ctx->keystream ) );
+		if ( offset ) {
+			/* Use remainder of current keystream block */
+			keystream = &ctx->keystream.byte[offset];
+			frag_len = ( sizeof ( ctx->keystream ) - offset );
+		} else {
+			/* Generate keystream for as many blocks as
+			 * possible in a single call
+			 */
+			blocks = ( len / sizeof ( stream[0] ) );
+			if ( blocks > GCM_STREAM_BLOCKS )
+				blocks = GCM_STREAM_BLOCKS;
+			if ( ! blocks )
+				blocks = 1;
+			for ( i = 0 ; i < blocks ; i++ ) {
+				ctx->ctr.dword[3] =
+					htonl ( ntohl ( ctx->ctr.dword[3] ) + 1 );
+				memcpy ( &stream[i], &ctx->ctr,
+					 sizeof ( stream[i] ) );
+			}
+			cipher_encrypt ( raw_cipher, raw_ctx, stream, stream,
+					 ( blocks * sizeof ( stream[0] ) ) );
+			keystream = stream[0].byte;
+			frag_len = ( blocks * sizeof ( stream[0] ) );
+
+			/* Retain keystream for a trailing partial block */
+			if ( len < frag_len ) {
+				memcpy ( &ctx->keystream, &stream[0],
+					 sizeof ( ctx->keystream ) );
+			}
+		}
+		if ( frag_len > len )
+			frag_len = len;
+
+		/* Hash ciphertext and apply keystream */
+		offset = ( ctx->data_len % sizeof ( ctx->hash ) );
+		if ( ! encrypting )
+			gcm_ghash ( ctx, in, frag_len, offset );
+		for ( i = 0 ; i < frag_len ; i++ )
+			out[i] = ( in[i] ^ keystream[i] );
+		if ( encrypting )
+			gcm_ghash ( ctx, out, frag_len, offset );
+
+		ctx->data_len += frag_len;
+		in += frag_len;
+		out += frag_len;
+		len -= frag_len;
+	}
+}
+
+/**
+ * Authenticate additional data
+ *
+ * @v ctx		GCM context
+ * @v data		Additional data
+ * @v len		Length of additional data
+ */
+static void gcm_add ( struct gcm_context *ctx, const void *data,
+		      size_t len ) {
+
+	/* Additional data must precede encrypted data */
+	assert ( ctx->data_len == 0 );
+
+	gcm_ghash ( ctx, data, len, ( ctx->add_len % sizeof ( ctx->hash ) ) );
+	ctx->add_len += len;
+}
+
+/**
+ * Encrypt data
+ *
+ * @v ctx		GCM context
+ * @v src		Data to encrypt, or additional data
+ * @v dst		Buffer for encrypted data, or NULL
+ * @v len		Length of data
+ * @v raw_cipher	Underlying cipher algorithm
+ * @v raw_ctx		Underlying cipher context
+ */
+void gcm_encrypt ( struct gcm_context *ctx, const void *src, void *dst,
+		   size_t len, struct cipher_algorithm *raw_cipher,
+		   void *raw_ctx ) {
+
+	if ( dst ) {
+		gcm_crypt ( ctx, src, dst, len, raw_cipher, raw_ctx, 1 );
+	} else {
+		gcm_add ( ctx, src, len );
+	}
+}
+
+/**
+ * Decrypt data
+ *
+ * @v ctx		GCM context
+ * @v src		Data to decrypt, or additional data
+ * @v dst		Buffer for decrypted data, or NULL
+ * @v len		Length of data
+ * @v raw_cipher	Underlying cipher algorithm
+ * @v raw_ctx		Underlying cipher context
+ */
+void gcm_decrypt ( struct gcm_context *ctx, const void *src, void *dst,
+		   size_t len, struct cipher_algorithm *raw_cipher,
+		   void *raw_ctx ) {
+
+	if ( dst ) {
+		gcm_crypt ( ctx, src, dst, len, raw_cipher, raw_ctx, 0 );
+	} else {
+		gcm_add ( ctx, src, len );
+	}
+}
+
+/**
+ * Generate authentication tag
+ *
+ * @v ctx		GCM context
+ * @v auth		Buffer for authentication tag (GCM_AUTH_LEN bytes)
+ */
+void gcm_auth ( struct gcm_context *ctx, void *auth ) {
+	union gcm_block lengths;
+	uint8_t *tag = auth;
+	unsigned int i;
+
+	/* Pad final partial block */
+	gcm_ghash_pad ( ctx, ( ctx->data_len ?
+			       ctx->data_len : ctx->add_len ) );
+
+	/* Hash lengths (in bits) */
+	lengths.qword[0] = cpu_to_be64 ( ctx->add_len * 8 );
+	lengths.qword[1] = cpu_to_be64 ( ctx->data_len * 8 );
+	gcm_ghash_blocks ( ctx, &lengths, 1 );
+
+	/* Tag is the hash masked with the encrypted initial counter */
+	for ( i = 0 ; i < GCM_AUTH_LEN ; i++ )
+		tag[i] = ( ctx->hash.byte[i] ^ ctx->mask.byte[i] );
+}
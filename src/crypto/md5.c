@@ -223,7 +223,7 @@ static void md5_final(void *context, void *out)
 	memset(mctx, 0, sizeof(*mctx));
 }
 
-struct digest_algorithm md5_algorithm = {
+struct digest_algorithm md5_algorithm __digest_algorithm = {
 	.name		= "md5",
 	.ctxsize	= MD5_CTX_SIZE,
 	.blocksize	= ( MD5_BLOCK_WORDS * 4 ),
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <gpxe/x509.h>
+#include <config/general.h>
+
+/** @file
+ *
+ * Root certificate store
+ *
+ */
+
+#ifdef TRUSTED_ROOTS
+
+/** Fingerprints of trusted root certificates */
+static const uint8_t root_fingerprints[] = { TRUSTED_ROOTS };
+
+/** Root certificates */
+struct x509_root root_certificates = {
+	.count = ( sizeof ( root_fingerprints ) / X509_FINGERPRINT_LEN ),
+	.fingerprints = root_fingerprints,
+};
+
+#else
+
+/** Root certificates */
+struct x509_root root_certificates = {
+	.count = 0,
+};
+
+#endif
@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+/** @file
+ *
+ * SHA-1 algorithm (FIPS 180-3)
+ *
+ * The round function is fully unrolled, and the message schedule is
+ * held in a rolling sixteen-word window rather than being expanded to
+ * eighty words in advance.  An architecture-specific block function
+ * is used where available.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <byteswap.h>
+#include <gpxe/rotate.h>
+#include <gpxe/crypto.h>
+#include <gpxe/sha1.h>
+
+/** SHA-1 round constants */
+#define SHA1_K0 0x5a827999UL
+#define SHA1_K1 0x6ed9eba1UL
+#define SHA1_K2 0x8f1bbcdcUL
+#define SHA1_K3 0xca62c1d6UL
+
+/** SHA-1 round functions */
+#define SHA1_F0( b, c, d ) ( (d) ^ ( (b) & ( (c) ^ (d) ) ) )
+#define SHA1_F1( b, c, d ) ( (b) ^ (c) ^ (d) )
+#define SHA1_F2( b, c, d ) ( ( (b) & (c) ) | ( (d) & ( (b) | (c) ) ) )
+#define SHA1_F3( b, c, d ) ( (b) ^ (c) ^ (d) )
+
+/**
+ * Get message schedule word
+ *
+ * @v t			Round number (a compile-time constant)
+ * @ret w		Message schedule word W(t)
+ *
+ * The first sixteen words are the message block itself; subsequent
+ * words are calculated in place within the sixteen-word window.
+ */
+#define SHA1_W( t ) ( ( (t) < 16 ) ? w[(t)] :				\
+	( w[ (t) & 15 ] = rol32 ( ( w[ ( (t) + 13 ) & 15 ] ^		\
+				    w[ ( (t) + 8 ) & 15 ] ^		\
+				    w[ ( (t) + 2 ) & 15 ] ^		\
+				    w[ (t) & 15 ] ), 1 ) ) )
+
+/**
+ * Perform a single SHA-1 round
+ *
+ * The variables are renamed by the caller rather than being moved
+ * between rounds.
+ */
+#define SHA1_ROUND( a, b, c, d, e, f, k, t ) do {			\
+	e += ( rol32 ( a, 5 ) + f ( b, c, d ) + k + SHA1_W ( t ) );	\
+	b = rol32 ( b, 30 );						\
+	} while ( 0 )
+
+/** Perform five SHA-1 rounds, returning variables to their original roles */
+#define SHA1_ROUND5( f, k, t ) do {					\
+	SHA1_ROUND ( a, b, c, d, e, f, k, ( (t) + 0 ) );		\
+	SHA1_ROUND ( e, a, b, c, d, f, k, ( (t) + 1 ) );		\
+	SHA1_ROUND ( d, e, a, b, c, f, k, ( (t) + 2 ) );		\
+	SHA1_ROUND ( c, d, e, a, b, f, k, ( (t) + 3 ) );		\
+	SHA1_ROUND ( b, c, d, e, a, f, k, ( (t) + 4 ) );		\
+	} while ( 0 )
+
+/**
+ * Process SHA-1 blocks using generic implementation
+ *
+ * @v hash		Intermediate hash value
+ * @v data		Data
+ * @v blocks		Number of blocks
+ */
+static void sha1_generic_blocks ( uint32_t *hash, const void *data,
+				  size_t blocks ) {
+	const uint32_t *in = data;
+	uint32_t w[16];
+	uint32_t a, b, c, d, e;
+	unsigned int i;
+
+	for ( ; blocks ; blocks-- ) {
+		for ( i = 0 ; i < 16 ; i++ )
+			w[i] = be32_to_cpu ( *(in++) );
+		a = hash[0];
+		b = hash[1];
+		c = hash[2];
+		d = hash[3];
+		e = hash[4];
+		SHA1_ROUND5 ( SHA1_F0, SHA1_K0, 0 );
+		SHA1_ROUND5 ( SHA1_F0, SHA1_K0, 5 );
+		SHA1_ROUND5 ( SHA1_F0, SHA1_K0, 10 );
+		SHA1_ROUND5 ( SHA1_F0, SHA1_K0, 15 );
+		SHA1_ROUND5 ( SHA1_F1, SHA1_K1, 20 );
+		SHA1_ROUND5 ( SHA1_F1, SHA1_K1, 25 );
+		SHA1_ROUND5 ( SHA1_F1, SHA1_K1, 30 );
+		SHA1_ROUND5 ( SHA1_F1, SHA1_K1, 35 );
+		SHA1_ROUND5 ( SHA1_F2, SHA1_K2, 40 );
+		SHA1_ROUND5 ( SHA1_F2, SHA1_K2, 45 );
+		SHA1_ROUND5 ( SHA1_F2, SHA1_K2, 50 );
+		SHA1_ROUND5 ( SHA1_F2, SHA1_K2, 55 );
+		SHA1_ROUND5 ( SHA1_F3, SHA1_K3, 60 );
+		SHA1_ROUND5 ( SHA1_F3, SHA1_K3, 65 );
+		SHA1_ROUND5 ( SHA1_F3, SHA1_K3, 70 );
+		SHA1_ROUND5 ( SHA1_F3, SHA1_K3, 75 );
+		hash[0] += a;
+		hash[1] += b;
+		hash[2] += c;
+		hash[3] += d;
+		hash[4] += e;
+	}
+}
+
+/**
+ * Process SHA-1 blocks
+ *
+ * @v ctx		SHA-1 context
+ * @v data		Data
+ * @v blocks		Number of blocks
+ */
+static void sha1_blocks ( struct sha1_ctx *ctx, const void *data,
+			  size_t blocks ) {
+	if ( ctx->accelerated ) {
+		sha1_arch_blocks ( ctx->hash, data, blocks );
+	} else {
+		sha1_generic_blocks ( ctx->hash, data, blocks );
+	}
+}
+
+/**
+ * Initialise SHA-1 context
+ *
+ * @v context		SHA-1 context
+ */
+static void sha1_init ( void *context ) {
+	struct sha1_ctx *ctx = context;
+
+	ctx->hash[0] = 0x67452301UL;
+	ctx->hash[1] = 0xefcdab89UL;
+	ctx->hash[2] = 0x98badcfeUL;
+	ctx->hash[3] = 0x10325476UL;
+	ctx->hash[4] = 0xc3d2e1f0UL;
+	ctx->len = 0;
+	ctx->accelerated = sha1_arch_supported();
+}
+
+/**
+ * Accumulate data with SHA-1 algorithm
+ *
+ * @v context		SHA-1 context
+ * @v data		Data
+ * @v len		Length of data
+ */
+static void sha1_update ( void *context, const void *data, size_t len ) {
+	struct sha1_ctx *ctx = context;
+	size_t offset = ( ctx->len % SHA1_BLOCK_SIZE );
+	size_t frag_len;
+
+	ctx->len += len;
+
+	/* Complete any partial block */
+	if ( offset ) {
+		frag_len = ( SHA1_BLOCK_SIZE - offset );
+		if ( frag_len > len )
+			frag_len = len;
+		memcpy ( ( ctx->block.byte + offset ), data, frag_len );
+		data += frag_len;
+		len -= frag_len;
+		if ( ( offset + frag_len ) < SHA1_BLOCK_SIZE )
+			return;
+		sha1_blocks ( ctx, ctx->block.dword, 1 );
+	}
+
+	/* Process whole blocks directly from the caller's buffer */
+	if ( len >= SHA1_BLOCK_SIZE ) {
+		sha1_blocks ( ctx, data, ( len / SHA1_BLOCK_SIZE ) );
+		data += ( len & ~( SHA1_BLOCK_SIZE - 1 ) );
+		len &= ( SHA1_BLOCK_SIZE - 1 );
+	}
+
+	/* Save any trailing partial block */
+	memcpy ( ctx->block.byte, data, len );
+}
+
+/**
+ * Generate SHA-1 digest
+ *
+ * @v context		SHA-1 context
+ * @v out		Output buffer
+ */
+static void sha1_final ( void *context, void *out ) {
+	struct sha1_ctx *ctx = context;
+	size_t offset = ( ctx->len % SHA1_BLOCK_SIZE );
+	uint32_t *digest = out;
+	unsigned int i;
+
+	/* Append padding and length (in bits) */
+	ctx->block.byte[offset++] = 0x80;
+	if ( offset > ( SHA1_BLOCK_SIZE - 8 ) ) {
+		memset ( ( ctx->block.byte + offset ), 0,
+			 ( SHA1_BLOCK_SIZE - offset ) );
+		sha1_blocks ( ctx, ctx->block.dword, 1 );
+		offset = 0;
+	}
+	memset ( ( ctx->block.byte + offset ), 0,
+		 ( SHA1_BLOCK_SIZE - 8 - offset ) );
+	ctx->block.dword[14] = cpu_to_be32 ( ctx->len >> 29 );
+	ctx->block.dword[15] = cpu_to_be32 ( ctx->len << 3 );
+	sha1_blocks ( ctx, ctx->block.dword, 1 );
+
+	/* Construct digest */
+	for ( i = 0 ; i < ( sizeof ( ctx->hash ) /
+			    sizeof ( ctx->hash[0] ) ) ; i++ )
+		digest[i] = cpu_to_be32 ( ctx->hash[i] );
+	memset ( ctx, 0, sizeof ( *ctx ) );
+}
+
+/** SHA-1 algorithm */
+struct digest_algorithm sha1_algorithm __digest_algorithm = {
+	.name		= "sha1",
+	.ctxsize	= SHA1_CTX_SIZE,
+	.blocksize	= SHA1_BLOCK_SIZE,
+	.digestsize	= SHA1_DIGEST_SIZE,
+	.init		= sha1_init,
+	.update		= sha1_update,
+	.final		= sha1_final,
+};
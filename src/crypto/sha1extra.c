@@ -90,6 +90,11 @@ void prf_sha1 ( const void *key, size_t key_len, const char *label,
  * @ret block		SHA1_SIZE bytes of PBKDF2 data
  *
  * The operation of this function is described in RFC 2898.
+ *
+ * The HMAC key (the passphrase) is the same for every iteration, so
+ * the SHA-1 states after absorbing the inner and outer key pads are
+ * computed once and copied at the start of each HMAC.  This halves
+ * the number of SHA-1 block operations required.
  */
 static void pbkdf2_sha1_f ( const void *passphrase, size_t pass_len,
 			    const void *salt, size_t salt_len,
@@ -98,22 +103,43 @@ static void pbkdf2_sha1_f ( const void *passphrase, size_t pass_len,
 	u8 pass[pass_len];	/* modifiable passphrase */
 	u8 in[salt_len + 4];	/* input buffer to first round */
 	u8 last[SHA1_SIZE];	/* output of round N, input of N+1 */
+	u8 k_opad[SHA1_BLOCK_SIZE]; /* HMAC outer key pad */
+	u8 inner_ctx[SHA1_CTX_SIZE]; /* SHA1 state after inner key pad */
+	u8 outer_ctx[SHA1_CTX_SIZE]; /* SHA1 state after outer key pad */
 	u8 sha1_ctx[SHA1_CTX_SIZE];
 	u8 *next_in = in;	/* changed to `last' after first round */
 	int next_size = sizeof ( in );
 	int i, j;
 
-	blocknr = htonl ( blocknr );
-
 	memcpy ( pass, passphrase, pass_len );
 	memcpy ( in, salt, salt_len );
-	memcpy ( in + salt_len, &blocknr, 4 );
+	in[salt_len + 0] = ( blocknr >> 24 );
+	in[salt_len + 1] = ( blocknr >> 16 );
+	in[salt_len + 2] = ( blocknr >> 8 );
+	in[salt_len + 3] = ( blocknr >> 0 );
 	memset ( block, 0, SHA1_SIZE );
 
+	/* Precompute inner and outer hash states.  hmac_init() will
+	 * reduce an overlength passphrase to its digest, so the outer
+	 * pad is constructed afterwards.
+	 */
+	hmac_init ( &sha1_algorithm, inner_ctx, pass, &pass_len );
+	memset ( k_opad, 0, sizeof ( k_opad ) );
+	memcpy ( k_opad, pass, pass_len );
+	for ( j = 0; j < SHA1_BLOCK_SIZE; j++ ) {
+		k_opad[j] ^= 0x5c;
+	}
+	digest_init ( &sha1_algorithm, outer_ctx );
+	digest_update ( &sha1_algorithm, outer_ctx, k_opad,
+			sizeof ( k_opad ) );
+
 	for ( i = 0; i < iterations; i++ ) {
-		hmac_init ( &sha1_algorithm, sha1_ctx, pass, &pass_len );
-		hmac_update ( &sha1_algorithm, sha1_ctx, next_in, next_size );
-		hmac_final ( &sha1_algorithm, sha1_ctx, pass, &pass_len, last );
+		memcpy ( sha1_ctx, inner_ctx, sizeof ( sha1_ctx ) );
+		digest_update ( &sha1_algorithm, sha1_ctx, next_in, next_size );
+		digest_final ( &sha1_algorithm, sha1_ctx, last );
+		memcpy ( sha1_ctx, outer_ctx, sizeof ( sha1_ctx ) );
+		digest_update ( &sha1_algorithm, sha1_ctx, last, SHA1_SIZE );
+		digest_final ( &sha1_algorithm, sha1_ctx, last );
 
 		for ( j = 0; j < SHA1_SIZE; j++ ) {
 			block[j] ^= last[j];
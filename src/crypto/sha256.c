@@ -0,0 +1,269 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+/** @file
+ *
+ * SHA-256 algorithm (FIPS 180-3)
+ *
+ * The round function is fully unrolled, and the message schedule is
+ * held in a rolling sixteen-word window rather than being expanded to
+ * sixty-four words in advance.  An architecture-specific block
+ * function is used where available.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <byteswap.h>
+#include <gpxe/rotate.h>
+#include <gpxe/crypto.h>
+#include <gpxe/sha256.h>
+
+/** SHA-256 round constants */
+static const uint32_t sha256_k[64] = {
+	0x428a2f98UL, 0x71374491UL, 0xb5c0fbcfUL, 0xe9b5dba5UL,
+	0x3956c25bUL, 0x59f111f1UL, 0x923f82a4UL, 0xab1c5ed5UL,
+	0xd807aa98UL, 0x12835b01UL, 0x243185beUL, 0x550c7dc3UL,
+	0x72be5d74UL, 0x80deb1feUL, 0x9bdc06a7UL, 0xc19bf174UL,
+	0xe49b69c1UL, 0xefbe4786UL, 0x0fc19dc6UL, 0x240ca1ccUL,
+	0x2de92c6fUL, 0x4a7484aaUL, 0x5cb0a9dcUL, 0x76f988daUL,
+	0x983e5152UL, 0xa831c66dUL, 0xb00327c8UL, 0xbf597fc7UL,
+	0xc6e00bf3UL, 0xd5a79147UL, 0x06ca6351UL, 0x14292967UL,
+	0x27b70a85UL, 0x2e1b2138UL, 0x4d2c6dfcUL, 0x53380d13UL,
+	0x650a7354UL, 0x766a0abbUL, 0x81c2c92eUL, 0x92722c85UL,
+	0xa2bfe8a1UL, 0xa81a664bUL, 0xc24b8b70UL, 0xc76c51a3UL,
+	0xd192e819UL, 0xd6990624UL, 0xf40e3585UL, 0x106aa070UL,
+	0x19a4c116UL, 0x1e376c08UL, 0x2748774cUL, 0x34b0bcb5UL,
+	0x391c0cb3UL, 0x4ed8aa4aUL, 0x5b9cca4fUL, 0x682e6ff3UL,
+	0x748f82eeUL, 0x78a5636fUL, 0x84c87814UL, 0x8cc70208UL,
+	0x90befffaUL, 0xa4506cebUL, 0xbef9a3f7UL, 0xc67178f2UL,
+};
+
+/** SHA-256 functions */
+#define SHA256_CH( e, f, g ) ( (g) ^ ( (e) & ( (f) ^ (g) ) ) )
+#define SHA256_MAJ( a, b, c ) ( ( (a) & (b) ) | ( (c) & ( (a) | (b) ) ) )
+#define SHA256_S0( a ) \
+	( ror32 ( (a), 2 ) ^ ror32 ( (a), 13 ) ^ ror32 ( (a), 22 ) )
+#define SHA256_S1( e ) \
+	( ror32 ( (e), 6 ) ^ ror32 ( (e), 11 ) ^ ror32 ( (e), 25 ) )
+#define SHA256_s0( w ) \
+	( ror32 ( (w), 7 ) ^ ror32 ( (w), 18 ) ^ ( (w) >> 3 ) )
+#define SHA256_s1( w ) \
+	( ror32 ( (w), 17 ) ^ ror32 ( (w), 19 ) ^ ( (w) >> 10 ) )
+
+/**
+ * Get message schedule word
+ *
+ * @v t			Round number (a compile-time constant)
+ * @ret w		Message schedule word W(t)
+ *
+ * The first sixteen words are the message block itself; subsequent
+ * words are calculated in place within the sixteen-word window.
+ */
+#define SHA256_W( t ) ( ( (t) < 16 ) ? w[(t)] :				\
+	( w[ (t) & 15 ] += ( SHA256_s1 ( w[ ( (t) + 14 ) & 15 ] ) +	\
+			     w[ ( (t) + 9 ) & 15 ] +			\
+			     SHA256_s0 ( w[ ( (t) + 1 ) & 15 ] ) ) ) )
+
+/**
+ * Perform a single SHA-256 round
+ *
+ * The variables are renamed by the caller rather than being moved
+ * between rounds.
+ */
+#define SHA256_ROUND( a, b, c, d, e, f, g, h, t ) do {			\
+	h += ( SHA256_S1 ( e ) + SHA256_CH ( e, f, g ) +		\
+	       sha256_k[(t)] + SHA256_W ( t ) );			\
+	d += h;								\
+	h += ( SHA256_S0 ( a ) + SHA256_MAJ ( a, b, c ) );		\
+	} while ( 0 )
+
+/** Perform eight SHA-256 rounds, returning variables to original roles */
+#define SHA256_ROUND8( t ) do {						\
+	SHA256_ROUND ( a, b, c, d, e, f, g, h, ( (t) + 0 ) );		\
+	SHA256_ROUND ( h, a, b, c, d, e, f, g, ( (t) + 1 ) );		\
+	SHA256_ROUND ( g, h, a, b, c, d, e, f, ( (t) + 2 ) );		\
+	SHA256_ROUND ( f, g, h, a, b, c, d, e, ( (t) + 3 ) );		\
+	SHA256_ROUND ( e, f, g, h, a, b, c, d, ( (t) + 4 ) );		\
+	SHA256_ROUND ( d, e, f, g, h, a, b, c, ( (t) + 5 ) );		\
+	SHA256_ROUND ( c, d, e, f, g, h, a, b, ( (t) + 6 ) );		\
+	SHA256_ROUND ( b, c, d, e, f, g, h, a, ( (t) + 7 ) );		\
+	} while ( 0 )
+
+/**
+ * Process SHA-256 blocks using generic implementation
+ *
+ * @v hash		Intermediate hash value
+ * @v data		Data
+ * @v blocks		Number of blocks
+ */
+static void sha256_generic_blocks ( uint32_t *hash, const void *data,
+				    size_t blocks ) {
+	const uint32_t *in = data;
+	uint32_t w[16];
+	uint32_t a, b, c, d, e, f, g, h;
+	unsigned int i;
+
+	for ( ; blocks ; blocks-- ) {
+		for ( i = 0 ; i < 16 ; i++ )
+			w[i] = be32_to_cpu ( *(in++) );
+		a = hash[0];
+		b = hash[1];
+		c = hash[2];
+		d = hash[3];
+		e = hash[4];
+		f = hash[5];
+		g = hash[6];
+		h = hash[7];
+		SHA256_ROUND8 ( 0 );
+		SHA256_ROUND8 ( 8 );
+		SHA256_ROUND8 ( 16 );
+		SHA256_ROUND8 ( 24 );
+		SHA256_ROUND8 ( 32 );
+		SHA256_ROUND8 ( 40 );
+		SHA256_ROUND8 ( 48 );
+		SHA256_ROUND8 ( 56 );
+		hash[0] += a;
+		hash[1] += b;
+		hash[2] += c;
+		hash[3] += d;
+		hash[4] += e;
+		hash[5] += f;
+		hash[6] += g;
+		hash[7] += h;
+	}
+}
+
+/**
+ * Process SHA-256 blocks
+ *
+ * @v ctx		SHA-256 context
+ * @v data		Data
+ * @v blocks		Number of blocks
+ */
+static void sha256_blocks ( struct sha256_ctx *ctx, const void *data,
+			    size_t blocks ) {
+	if ( ctx->accelerated ) {
+		sha256_arch_blocks ( ctx->hash, data, blocks );
+	} else {
+		sha256_generic_blocks ( ctx->hash, data, blocks );
+	}
+}
+
+/**
+ * Initialise SHA-256 context
+ *
+ * @v context		SHA-256 context
+ */
+static void sha256_init ( void *context ) {
+	struct sha256_ctx *ctx = context;
+
+	ctx->hash[0] = 0x6a09e667UL;
+	ctx->hash[1] = 0xbb67ae85UL;
+	ctx->hash[2] = 0x3c6ef372UL;
+	ctx->hash[3] = 0xa54ff53aUL;
+	ctx->hash[4] = 0x510e527fUL;
+	ctx->hash[5] = 0x9b05688cUL;
+	ctx->hash[6] = 0x1f83d9abUL;
+	ctx->hash[7] = 0x5be0cd19UL;
+	ctx->len = 0;
+	ctx->accelerated = sha256_arch_supported();
+}
+
+/**
+ * Accumulate data with SHA-256 algorithm
+ *
+ * @v context		SHA-256 context
+ * @v data		Data
+ * @v len		Length of data
+ */
+static void sha256_update ( void *context, const void *data, size_t len ) {
+	struct sha256_ctx *ctx = context;
+	size_t offset = ( ctx->len % SHA256_BLOCK_SIZE );
+	size_t frag_len;
+
+	ctx->len += len;
+
+	/* Complete any partial block */
+	if ( offset ) {
+		frag_len = ( SHA256_BLOCK_SIZE - offset );
+		if ( frag_len > len )
+			frag_len = len;
+		memcpy ( ( ctx->block.byte + offset ), data, frag_len );
+		data += frag_len;
+		len -= frag_len;
+		if ( ( offset + frag_len ) < SHA256_BLOCK_SIZE )
+			return;
+		sha256_blocks ( ctx, ctx->block.dword, 1 );
+	}
+
+	/* Process whole blocks directly from the caller's buffer */
+	if ( len >= SHA256_BLOCK_SIZE ) {
+		sha256_blocks ( ctx, data, ( len / SHA256_BLOCK_SIZE ) );
+		data += ( len & ~( SHA256_BLOCK_SIZE - 1 ) );
+		len &= ( SHA256_BLOCK_SIZE - 1 );
+	}
+
+	/* Save any trailing partial block */
+	memcpy ( ctx->block.byte, data, len );
+}
+
+/**
+ * Generate SHA-256 digest
+ *
+ * @v context		SHA-256 context
+ * @v out		Output buffer
+ */
+static void sha256_final ( void *context, void *out ) {
+	struct sha256_ctx *ctx = context;
+	size_t offset = ( ctx->len % SHA256_BLOCK_SIZE );
+	uint32_t *digest = out;
+	unsigned int i;
+
+	/* Append padding and length (in bits) */
+	ctx->block.byte[offset++] = 0x80;
+	if ( offset > ( SHA256_BLOCK_SIZE - 8 ) ) {
+		memset ( ( ctx->block.byte + offset ), 0,
+			 ( SHA256_BLOCK_SIZE - offset ) );
+		sha256_blocks ( ctx, ctx->block.dword, 1 );
+		offset = 0;
+	}
+	memset ( ( ctx->block.byte + offset ), 0,
+		 ( SHA256_BLOCK_SIZE - 8 - offset ) );
+	ctx->block.dword[14] = cpu_to_be32 ( ctx->len >> 29 );
+	ctx->block.dword[15] = cpu_to_be32 ( ctx->len << 3 );
+	sha256_blocks ( ctx, ctx->block.dword, 1 );
+
+	/* Construct digest */
+	for ( i = 0 ; i < ( sizeof ( ctx->hash ) /
+			    sizeof ( ctx->hash[0] ) ) ; i++ )
+		digest[i] = cpu_to_be32 ( ctx->hash[i] );
+	memset ( ctx, 0, sizeof ( *ctx ) );
+}
+
+/** SHA-256 algorithm */
+struct digest_algorithm sha256_algorithm __digest_algorithm = {
+	.name		= "sha256",
+	.ctxsize	= SHA256_CTX_SIZE,
+	.blocksize	= SHA256_BLOCK_SIZE,
+	.digestsize	= SHA256_DIGEST_SIZE,
+	.init		= sha256_init,
+	.update		= sha256_update,
+	.final		= sha256_final,
+};
@@ -20,8 +20,13 @@ FILE_LICENCE ( GPL2_OR_LATER );
 
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <errno.h>
 #include <gpxe/asn1.h>
+#include <gpxe/crypto.h>
+#include <gpxe/sha1.h>
+#include <gpxe/sha256.h>
+#include <gpxe/rsa.h>
 #include <gpxe/x509.h>
 
 /** @file
@@ -30,112 +35,153 @@ FILE_LICENCE ( GPL2_OR_LATER );
  *
  * The structure of X.509v3 certificates is concisely documented in
  * RFC5280 section 4.1.  The structure of RSA public keys is
- * documented in RFC2313.
+ * documented in RFC2313.  Signatures use the EMSA-PKCS1-v1_5 encoding
+ * described in RFC3447 section 9.2.
+ *
+ * Certificate chains are validated against a set of trusted root
+ * certificates, identified by their SHA-256 fingerprints.  Issuer
+ * and subject names are compared in their encoded form, and validity
+ * periods are not checked (since we have no trustworthy source of the
+ * current time).  Server names are matched against the end entity's
+ * subjectAltName DNS names, or its subject common name if there is no
+ * subjectAltName, as described in RFC6125 section 6.4.
  */
 
+/** Explicit tag for the tbsCertificate "extensions" field */
+#define X509_EXTENSIONS_TAG 0xa3
+
+/** Implicit tag for the tbsCertificate "issuerUniqueID" field */
+#define X509_ISSUER_UNIQUE_ID_TAG 0x81
+
+/** Implicit tag for the tbsCertificate "subjectUniqueID" field */
+#define X509_SUBJECT_UNIQUE_ID_TAG 0x82
+
+/** Implicit tag for the GeneralName "dNSName" field */
+#define X509_DNS_NAME_TAG 0x82
+
 /** Object Identifier for "rsaEncryption" (1.2.840.113549.1.1.1) */
 static const uint8_t oid_rsa_encryption[] = { 0x2a, 0x86, 0x48, 0x86, 0xf7,
 					      0x0d, 0x01, 0x01, 0x01 };
 
-/**
- * Identify X.509 certificate public key
- *
- * @v certificate	Certificate
- * @v algorithm		Public key algorithm to fill in
- * @v pubkey		Public key value to fill in
- * @ret rc		Return status code
- */
-static int x509_public_key ( const struct asn1_cursor *certificate,
-			     struct asn1_cursor *algorithm,
-			     struct asn1_cursor *pubkey ) {
-	struct asn1_cursor cursor;
-	int rc;
+/** Object Identifier for "sha1WithRSAEncryption" (1.2.840.113549.1.1.5) */
+static const uint8_t oid_sha1_with_rsa_encryption[] =
+	{ 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x05 };
 
-	/* Locate subjectPublicKeyInfo */
-	memcpy ( &cursor, certificate, sizeof ( cursor ) );
-	rc = ( asn1_enter ( &cursor, ASN1_SEQUENCE ), /* Certificate */
-	       asn1_enter ( &cursor, ASN1_SEQUENCE ), /* tbsCertificate */
-	       asn1_skip ( &cursor, ASN1_EXPLICIT_TAG ), /* version */
-	       asn1_skip ( &cursor, ASN1_INTEGER ), /* serialNumber */
-	       asn1_skip ( &cursor, ASN1_SEQUENCE ), /* signature */
-	       asn1_skip ( &cursor, ASN1_SEQUENCE ), /* issuer */
-	       asn1_skip ( &cursor, ASN1_SEQUENCE ), /* validity */
-	       asn1_skip ( &cursor, ASN1_SEQUENCE ), /* name */
-	       asn1_enter ( &cursor, ASN1_SEQUENCE )/* subjectPublicKeyInfo*/);
-	if ( rc != 0 ) {
-		DBG ( "Cannot locate subjectPublicKeyInfo in:\n" );
-		DBG_HDA ( 0, certificate->data, certificate->len );
-		return rc;
-	}
+/** Object Identifier for "sha256WithRSAEncryption" (1.2.840.113549.1.1.11) */
+static const uint8_t oid_sha256_with_rsa_encryption[] =
+	{ 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x0b };
 
-	/* Locate algorithm */
-	memcpy ( algorithm, &cursor, sizeof ( *algorithm ) );
-	rc = ( asn1_enter ( algorithm, ASN1_SEQUENCE ) /* algorithm */ );
-	if ( rc != 0 ) {
-		DBG ( "Cannot locate algorithm in:\n" );
-		DBG_HDA ( 0, certificate->data, certificate->len );
-		return rc;
-	}
+/** Object Identifier for "basicConstraints" (2.5.29.19) */
+static const uint8_t oid_basic_constraints[] = { 0x55, 0x1d, 0x13 };
 
-	/* Locate subjectPublicKey */
-	memcpy ( pubkey, &cursor, sizeof ( *pubkey ) );
-	rc = ( asn1_skip ( pubkey, ASN1_SEQUENCE ), /* algorithm */
-	       asn1_enter ( pubkey, ASN1_BIT_STRING ) /* subjectPublicKey*/ );
-	if ( rc != 0 ) {
-		DBG ( "Cannot locate subjectPublicKey in:\n" );
-		DBG_HDA ( 0, certificate->data, certificate->len );
-		return rc;
-	}
+/** Object Identifier for "subjectAltName" (2.5.29.17) */
+static const uint8_t oid_subject_alt_name[] = { 0x55, 0x1d, 0x11 };
 
-	return 0;
+/** Object Identifier for "commonName" (2.5.4.3) */
+static const uint8_t oid_common_name[] = { 0x55, 0x04, 0x03 };
+
+/** DigestInfo prefix for SHA-1 */
+static const uint8_t sha1_digestinfo_prefix[] =
+	{ 0x30, 0x21, 0x30, 0x09, 0x06, 0x05, 0x2b, 0x0e, 0x03, 0x02, 0x1a,
+	  0x05, 0x00, 0x04, 0x14 };
+
+/** DigestInfo prefix for SHA-256 */
+static const uint8_t sha256_digestinfo_prefix[] =
+	{ 0x30, 0x31, 0x30, 0x0d, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01, 0x65,
+	  0x03, 0x04, 0x02, 0x01, 0x05, 0x00, 0x04, 0x20 };
+
+/** Supported signature algorithms */
+static struct x509_signature_algorithm x509_signature_algorithms[] = {
+	{
+		.name = "sha1WithRSAEncryption",
+		.oid = oid_sha1_with_rsa_encryption,
+		.oid_len = sizeof ( oid_sha1_with_rsa_encryption ),
+		.digest = &sha1_algorithm,
+		.prefix = sha1_digestinfo_prefix,
+		.prefix_len = sizeof ( sha1_digestinfo_prefix ),
+	},
+	{
+		.name = "sha256WithRSAEncryption",
+		.oid = oid_sha256_with_rsa_encryption,
+		.oid_len = sizeof ( oid_sha256_with_rsa_encryption ),
+		.digest = &sha256_algorithm,
+		.prefix = sha256_digestinfo_prefix,
+		.prefix_len = sizeof ( sha256_digestinfo_prefix ),
+	},
+};
+
+/** Validated certificate cache */
+static struct x509_cached_certificate x509_cache[X509_CACHE_SIZE];
+
+/** Next validated certificate cache entry to be replaced */
+static unsigned int x509_cache_next;
+
+/**
+ * Check whether or not ASN.1 object identifier matches
+ *
+ * @v oid		Object identifier cursor
+ * @v expected		Expected object identifier
+ * @v expected_len	Length of expected object identifier
+ * @ret match		Object identifiers match
+ */
+static int x509_oid_matches ( const struct asn1_cursor *oid,
+			      const void *expected, size_t expected_len ) {
+	return ( ( oid->len == expected_len ) &&
+		 ( memcmp ( oid->data, expected, expected_len ) == 0 ) );
 }
 
 /**
- * Identify X.509 certificate RSA modulus and public exponent
+ * Identify X.509 RSA public key
  *
- * @v certificate	Certificate
- * @v rsa		RSA public key to fill in
+ * @v spki		subjectPublicKeyInfo
+ * @v modulus		Modulus to fill in
+ * @v exponent		Public exponent to fill in
  * @ret rc		Return status code
- *
- * The caller is responsible for eventually calling
- * x509_free_rsa_public_key() to free the storage allocated to hold
- * the RSA modulus and exponent.
  */
-int x509_rsa_public_key ( const struct asn1_cursor *certificate,
-			  struct x509_rsa_public_key *rsa_pubkey ) {
+static int x509_parse_rsa_public_key ( const struct asn1_cursor *spki,
+				       struct asn1_cursor *modulus,
+				       struct asn1_cursor *exponent ) {
 	struct asn1_cursor algorithm;
 	struct asn1_cursor pubkey;
-	struct asn1_cursor modulus;
-	struct asn1_cursor exponent;
 	int rc;
 
-	/* First, extract the public key algorithm and key data */
-	if ( ( rc = x509_public_key ( certificate, &algorithm,
-				      &pubkey ) ) != 0 )
+	/* Locate algorithm */
+	memcpy ( &algorithm, spki, sizeof ( algorithm ) );
+	rc = ( asn1_enter ( &algorithm, ASN1_SEQUENCE ),/* subjectPublicKeyInfo*/
+	       asn1_enter ( &algorithm, ASN1_SEQUENCE ), /* algorithm */
+	       asn1_enter ( &algorithm, ASN1_OID ) /* algorithm */ );
+	if ( rc != 0 ) {
+		DBG ( "Cannot locate algorithm in:\n" );
+		DBG_HDA ( 0, spki->data, spki->len );
 		return rc;
+	}
 
 	/* Check that algorithm is RSA */
-	rc = ( asn1_enter ( &algorithm, ASN1_OID ) /* algorithm */ );
-	if ( rc != 0 ) {
-		DBG ( "Cannot locate algorithm:\n" );
-		DBG_HDA ( 0, certificate->data, certificate->len );
-	return rc;
-	}
-	if ( ( algorithm.len != sizeof ( oid_rsa_encryption ) ) ||
-	     ( memcmp ( algorithm.data, &oid_rsa_encryption,
-			sizeof ( oid_rsa_encryption ) ) != 0 ) ) {
+	if ( ! x509_oid_matches ( &algorithm, oid_rsa_encryption,
+				  sizeof ( oid_rsa_encryption ) ) ) {
 		DBG ( "algorithm is not rsaEncryption in:\n" );
-		DBG_HDA ( 0, certificate->data, certificate->len );
+		DBG_HDA ( 0, spki->data, spki->len );
 		return -ENOTSUP;
 	}
 
+	/* Locate subjectPublicKey */
+	memcpy ( &pubkey, spki, sizeof ( pubkey ) );
+	rc = ( asn1_enter ( &pubkey, ASN1_SEQUENCE ),/* subjectPublicKeyInfo*/
+	       asn1_skip ( &pubkey, ASN1_SEQUENCE ), /* algorithm */
+	       asn1_enter ( &pubkey, ASN1_BIT_STRING ) /* subjectPublicKey*/ );
+	if ( rc != 0 ) {
+		DBG ( "Cannot locate subjectPublicKey in:\n" );
+		DBG_HDA ( 0, spki->data, spki->len );
+		return rc;
+	}
+
 	/* Check that public key is a byte string, i.e. that the
 	 * "unused bits" byte contains zero.
 	 */
 	if ( ( pubkey.len < 1 ) ||
 	     ( ( *( uint8_t * ) pubkey.data ) != 0 ) ) {
 		DBG ( "subjectPublicKey is not a byte string in:\n" );
-		DBG_HDA ( 0, certificate->data, certificate->len );
+		DBG_HDA ( 0, spki->data, spki->len );
 		return -ENOTSUP;
 	}
 	pubkey.data++;
@@ -145,34 +191,49 @@ int x509_rsa_public_key ( const struct asn1_cursor *certificate,
 	rc = ( asn1_enter ( &pubkey, ASN1_SEQUENCE ) /* RSAPublicKey */ );
 	if ( rc != 0 ) {
 		DBG ( "Cannot locate RSAPublicKey in:\n" );
-		DBG_HDA ( 0, certificate->data, certificate->len );
+		DBG_HDA ( 0, spki->data, spki->len );
 		return -ENOTSUP;
 	}
-	memcpy ( &modulus, &pubkey, sizeof ( modulus ) );
-	rc = ( asn1_enter ( &modulus, ASN1_INTEGER ) /* modulus */ );
+	memcpy ( modulus, &pubkey, sizeof ( *modulus ) );
+	rc = ( asn1_enter ( modulus, ASN1_INTEGER ) /* modulus */ );
 	if ( rc != 0 ) {
 		DBG ( "Cannot locate modulus in:\n" );
-		DBG_HDA ( 0, certificate->data, certificate->len );
+		DBG_HDA ( 0, spki->data, spki->len );
 		return -ENOTSUP;
 	}
-	memcpy ( &exponent, &pubkey, sizeof ( exponent ) );
-	rc = ( asn1_skip ( &exponent, ASN1_INTEGER ), /* modulus */
-	       asn1_enter ( &exponent, ASN1_INTEGER ) /* publicExponent */ );
+	memcpy ( exponent, &pubkey, sizeof ( *exponent ) );
+	rc = ( asn1_skip ( exponent, ASN1_INTEGER ), /* modulus */
+	       asn1_enter ( exponent, ASN1_INTEGER ) /* publicExponent */ );
 	if ( rc != 0 ) {
 		DBG ( "Cannot locate publicExponent in:\n" );
-		DBG_HDA ( 0, certificate->data, certificate->len );
+		DBG_HDA ( 0, spki->data, spki->len );
 		return -ENOTSUP;
 	}
 
+	return 0;
+}
+
+/**
+ * Copy out X.509 RSA public key
+ *
+ * @v modulus		Modulus
+ * @v exponent		Public exponent
+ * @v rsa_pubkey	RSA public key to fill in
+ * @ret rc		Return status code
+ */
+static int x509_copy_rsa_public_key ( const struct asn1_cursor *modulus,
+				      const struct asn1_cursor *exponent,
+				      struct x509_rsa_public_key *rsa_pubkey ){
+
 	/* Allocate space and copy out modulus and exponent */
-	rsa_pubkey->modulus = malloc ( modulus.len + exponent.len );
+	rsa_pubkey->modulus = malloc ( modulus->len + exponent->len );
 	if ( ! rsa_pubkey->modulus )
 		return -ENOMEM;
-	rsa_pubkey->exponent = ( rsa_pubkey->modulus + modulus.len );
-	memcpy ( rsa_pubkey->modulus, modulus.data, modulus.len );
-	rsa_pubkey->modulus_len = modulus.len;
-	memcpy ( rsa_pubkey->exponent, exponent.data, exponent.len );
-	rsa_pubkey->exponent_len = exponent.len;
+	rsa_pubkey->exponent = ( rsa_pubkey->modulus + modulus->len );
+	memcpy ( rsa_pubkey->modulus, modulus->data, modulus->len );
+	rsa_pubkey->modulus_len = modulus->len;
+	memcpy ( rsa_pubkey->exponent, exponent->data, exponent->len );
+	rsa_pubkey->exponent_len = exponent->len;
 
 	DBG2 ( "RSA modulus:\n" );
 	DBG2_HDA ( 0, rsa_pubkey->modulus, rsa_pubkey->modulus_len );
@@ -181,3 +242,647 @@ int x509_rsa_public_key ( const struct asn1_cursor *certificate,
 
 	return 0;
 }
+
+/**
+ * Parse X.509 certificate extensions
+ *
+ * @v cert		X.509 certificate
+ * @v raw		Extensions field
+ * @ret rc		Return status code
+ *
+ * Only the basicConstraints and subjectAltName extensions are
+ * interpreted; all other extensions are ignored.
+ */
+static int x509_parse_extensions ( struct x509_certificate *cert,
+				   const struct asn1_cursor *raw ) {
+	struct asn1_cursor cursor;
+	struct asn1_cursor extension;
+	struct asn1_cursor oid;
+	int rc;
+
+	/* Enter extensions list */
+	memcpy ( &cursor, raw, sizeof ( cursor ) );
+	rc = ( asn1_enter ( &cursor, X509_EXTENSIONS_TAG ), /* extensions */
+	       asn1_enter ( &cursor, ASN1_SEQUENCE ) /* Extensions */ );
+	if ( rc != 0 ) {
+		DBG ( "Cannot locate extensions in:\n" );
+		DBG_HDA ( 0, cert->raw.data, cert->raw.len );
+		return rc;
+	}
+
+	while ( cursor.len ) {
+
+		/* Identify extension */
+		memcpy ( &oid, &cursor, sizeof ( oid ) );
+		rc = ( asn1_enter ( &oid, ASN1_SEQUENCE ), /* Extension */
+		       asn1_enter ( &oid, ASN1_OID ) /* extnID */ );
+		if ( rc != 0 ) {
+			DBG ( "Cannot locate extnID in:\n" );
+			DBG_HDA ( 0, cert->raw.data, cert->raw.len );
+			return rc;
+		}
+
+		/* Extract cA flag from basicConstraints */
+		if ( x509_oid_matches ( &oid, oid_basic_constraints,
+					sizeof ( oid_basic_constraints ) ) ) {
+			memcpy ( &extension, &cursor, sizeof ( extension ) );
+			asn1_enter ( &extension, ASN1_SEQUENCE ); /* Extension */
+			asn1_skip ( &extension, ASN1_OID ); /* extnID */
+			if ( asn1_type ( &extension ) == ASN1_BOOLEAN )
+				asn1_skip ( &extension, ASN1_BOOLEAN );
+			rc = ( asn1_enter ( &extension, ASN1_OCTET_STRING ),
+			       asn1_enter ( &extension, ASN1_SEQUENCE ) );
+			if ( rc != 0 ) {
+				DBG ( "Invalid basicConstraints in:\n" );
+				DBG_HDA ( 0, cert->raw.data, cert->raw.len );
+				return rc;
+			}
+			if ( ( asn1_type ( &extension ) == ASN1_BOOLEAN ) &&
+			     ( asn1_enter ( &extension, ASN1_BOOLEAN ) == 0 )&&
+			     ( extension.len == 1 ) ) {
+				cert->ca = *( ( uint8_t * ) extension.data );
+			}
+		}
+
+		/* Locate subjectAltName names */
+		if ( x509_oid_matches ( &oid, oid_subject_alt_name,
+					sizeof ( oid_subject_alt_name ) ) ) {
+			memcpy ( &extension, &cursor, sizeof ( extension ) );
+			asn1_enter ( &extension, ASN1_SEQUENCE ); /* Extension */
+			asn1_skip ( &extension, ASN1_OID ); /* extnID */
+			if ( asn1_type ( &extension ) == ASN1_BOOLEAN )
+				asn1_skip ( &extension, ASN1_BOOLEAN );
+			rc = ( asn1_enter ( &extension, ASN1_OCTET_STRING ),
+			       asn1_enter ( &extension, ASN1_SEQUENCE ) );
+			if ( rc != 0 ) {
+				DBG ( "Invalid subjectAltName in:\n" );
+				DBG_HDA ( 0, cert->raw.data, cert->raw.len );
+				return rc;
+			}
+			memcpy ( &cert->alt_names, &extension,
+				 sizeof ( cert->alt_names ) );
+		}
+
+		/* Move to next extension.  This cannot fail, since
+		 * the extension has already been entered successfully;
+		 * the cursor is left empty after the final extension.
+		 */
+		asn1_skip ( &cursor, ASN1_SEQUENCE );
+	}
+
+	return 0;
+}
+
+/**
+ * Parse X.509 certificate
+ *
+ * @v cert		X.509 certificate to fill in
+ * @v raw		Encoded certificate
+ * @ret rc		Return status code
+ *
+ * The signature algorithm is left as NULL if it is not supported, in
+ * which case the certificate may still be used as a source of a
+ * public key but its signature cannot be checked.
+ */
+int x509_parse ( struct x509_certificate *cert,
+		 const struct asn1_cursor *raw ) {
+	struct x509_signature_algorithm *algorithm;
+	struct asn1_cursor cursor;
+	struct asn1_cursor oid;
+	struct asn1_cursor spki;
+	unsigned int i;
+	int rc;
+
+	memset ( cert, 0, sizeof ( *cert ) );
+	memcpy ( &cert->raw, raw, sizeof ( cert->raw ) );
+
+	/* Locate tbsCertificate */
+	memcpy ( &cursor, raw, sizeof ( cursor ) );
+	rc = ( asn1_enter ( &cursor, ASN1_SEQUENCE ) /* Certificate */ );
+	memcpy ( &cert->tbs, &cursor, sizeof ( cert->tbs ) );
+	if ( ( rc != 0 ) ||
+	     ( ( rc = asn1_shrink ( &cert->tbs, ASN1_SEQUENCE ) ) != 0 ) ) {
+		DBG ( "Cannot locate tbsCertificate in:\n" );
+		DBG_HDA ( 0, raw->data, raw->len );
+		return rc;
+	}
+
+	/* Identify signatureAlgorithm */
+	memcpy ( &oid, &cursor, sizeof ( oid ) );
+	rc = ( asn1_skip ( &oid, ASN1_SEQUENCE ), /* tbsCertificate */
+	       asn1_enter ( &oid, ASN1_SEQUENCE ), /* signatureAlgorithm */
+	       asn1_enter ( &oid, ASN1_OID ) /* algorithm */ );
+	if ( rc != 0 ) {
+		DBG ( "Cannot locate signatureAlgorithm in:\n" );
+		DBG_HDA ( 0, raw->data, raw->len );
+		return rc;
+	}
+	for ( i = 0 ; i < ( sizeof ( x509_signature_algorithms ) /
+			    sizeof ( x509_signature_algorithms[0] ) ) ; i++ ) {
+		algorithm = &x509_signature_algorithms[i];
+		if ( x509_oid_matches ( &oid, algorithm->oid,
+					algorithm->oid_len ) )
+			cert->signature_algorithm = algorithm;
+	}
+
+	/* Locate signatureValue, which must be a byte string */
+	memcpy ( &cert->signature, &cursor, sizeof ( cert->signature ) );
+	rc = ( asn1_skip ( &cert->signature, ASN1_SEQUENCE ), /* tbsCert.. */
+	       asn1_skip ( &cert->signature, ASN1_SEQUENCE ), /* signatureAl.. */
+	       asn1_enter ( &cert->signature, ASN1_BIT_STRING ) /*signatureV..*/);
+	if ( ( rc != 0 ) || ( cert->signature.len < 1 ) ||
+	     ( *( ( uint8_t * ) cert->signature.data ) != 0 ) ) {
+		DBG ( "Cannot locate signatureValue in:\n" );
+		DBG_HDA ( 0, raw->data, raw->len );
+		return ( rc ? rc : -ENOTSUP );
+	}
+	cert->signature.data++;
+	cert->signature.len--;
+
+	/* Enter tbsCertificate, skipping the optional version.  Any
+	 * error will invalidate the cursor, and so will be caught
+	 * below.
+	 */
+	asn1_enter ( &cursor, ASN1_SEQUENCE ); /* tbsCertificate */
+	if ( asn1_type ( &cursor ) == ASN1_EXPLICIT_TAG )
+		asn1_skip ( &cursor, ASN1_EXPLICIT_TAG ); /* version */
+	asn1_skip ( &cursor, ASN1_INTEGER ); /* serialNumber */
+	asn1_skip ( &cursor, ASN1_SEQUENCE ); /* signature */
+
+	/* Locate issuer and subject */
+	memcpy ( &cert->issuer, &cursor, sizeof ( cert->issuer ) );
+	asn1_shrink ( &cert->issuer, ASN1_SEQUENCE ); /* issuer */
+	asn1_skip ( &cursor, ASN1_SEQUENCE ); /* issuer */
+	asn1_skip ( &cursor, ASN1_SEQUENCE ); /* validity */
+	memcpy ( &cert->subject, &cursor, sizeof ( cert->subject ) );
+	asn1_shrink ( &cert->subject, ASN1_SEQUENCE ); /* subject */
+	rc = asn1_skip ( &cursor, ASN1_SEQUENCE ); /* subject */
+	if ( ( rc != 0 ) || ( cert->issuer.len == 0 ) ) {
+		DBG ( "Cannot locate issuer and subject in:\n" );
+		DBG_HDA ( 0, raw->data, raw->len );
+		return -EINVAL;
+	}
+
+	/* Locate public key */
+	memcpy ( &spki, &cursor, sizeof ( spki ) );
+	if ( ( rc = x509_parse_rsa_public_key ( &spki, &cert->modulus,
+						&cert->exponent ) ) != 0 )
+		return rc;
+
+	/* Parse extensions, if present */
+	if ( asn1_skip ( &cursor, ASN1_SEQUENCE ) != 0 )
+		return 0;
+	if ( asn1_type ( &cursor ) == X509_ISSUER_UNIQUE_ID_TAG )
+		asn1_skip ( &cursor, X509_ISSUER_UNIQUE_ID_TAG );
+	if ( asn1_type ( &cursor ) == X509_SUBJECT_UNIQUE_ID_TAG )
+		asn1_skip ( &cursor, X509_SUBJECT_UNIQUE_ID_TAG );
+	if ( asn1_type ( &cursor ) == X509_EXTENSIONS_TAG ) {
+		if ( ( rc = x509_parse_extensions ( cert, &cursor ) ) != 0 )
+			return rc;
+	}
+
+	return 0;
+}
+
+/**
+ * Identify X.509 certificate RSA modulus and public exponent
+ *
+ * @v certificate	Certificate
+ * @v rsa		RSA public key to fill in
+ * @ret rc		Return status code
+ *
+ * The caller is responsible for eventually calling
+ * x509_free_rsa_public_key() to free the storage allocated to hold
+ * the RSA modulus and exponent.
+ */
+int x509_rsa_public_key ( const struct asn1_cursor *certificate,
+			  struct x509_rsa_public_key *rsa_pubkey ) {
+	struct x509_certificate cert;
+	int rc;
+
+	if ( ( rc = x509_parse ( &cert, certificate ) ) != 0 )
+		return rc;
+
+	return x509_copy_rsa_public_key ( &cert.modulus, &cert.exponent,
+					  rsa_pubkey );
+}
+
+/**
+ * Check whether or not DNS name matches server name
+ *
+ * @v pattern		DNS name from certificate
+ * @v name		Server name
+ * @ret match		Names match
+ *
+ * Names are compared without regard to case.  A wildcard is permitted
+ * only as the whole of the leftmost label, and matches exactly one
+ * label.
+ */
+static int x509_dns_name_matches ( const struct asn1_cursor *pattern,
+				   const char *name ) {
+	const char *data = pattern->data;
+	size_t len = pattern->len;
+	const char *dot;
+
+	/* Handle wildcard */
+	if ( ( len > 2 ) && ( data[0] == '*' ) && ( data[1] == '.' ) ) {
+		dot = strchr ( name, '.' );
+		if ( ( ! dot ) || ( dot == name ) )
+			return 0;
+		name = dot;
+		data++;
+		len--;
+	}
+
+	/* Compare remainder of name */
+	for ( ; len ; data++, len--, name++ ) {
+		if ( ( ! *name ) || ( tolower ( *data ) != tolower ( *name ) ) )
+			return 0;
+	}
+	return ( *name == '\0' );
+}
+
+/**
+ * Check whether or not certificate subject common name matches
+ *
+ * @v cert		X.509 certificate
+ * @v name		Server name
+ * @ret match		A common name matches
+ */
+static int x509_common_name_matches ( struct x509_certificate *cert,
+				      const char *name ) {
+	struct asn1_cursor cursor;
+	struct asn1_cursor attribute;
+	struct asn1_cursor oid;
+
+	/* Enter subject name */
+	memcpy ( &cursor, &cert->subject, sizeof ( cursor ) );
+	asn1_enter ( &cursor, ASN1_SEQUENCE ); /* Name */
+
+	while ( cursor.len ) {
+
+		/* Identify first attribute of relative distinguished
+		 * name.  Multi-valued names are not used in practice
+		 * for common names.
+		 */
+		memcpy ( &attribute, &cursor, sizeof ( attribute ) );
+		asn1_enter ( &attribute, ASN1_SET ); /* RelativeDistingu.. */
+		asn1_enter ( &attribute, ASN1_SEQUENCE ); /* AttributeType.. */
+		memcpy ( &oid, &attribute, sizeof ( oid ) );
+		asn1_enter ( &oid, ASN1_OID ); /* type */
+
+		/* Compare any common name value */
+		if ( x509_oid_matches ( &oid, oid_common_name,
+					sizeof ( oid_common_name ) ) ) {
+			asn1_skip ( &attribute, ASN1_OID ); /* type */
+			if ( ( asn1_enter ( &attribute,
+					    asn1_type ( &attribute ) ) == 0 ) &&
+			     x509_dns_name_matches ( &attribute, name ) )
+				return 1;
+		}
+
+		/* Move to next relative distinguished name */
+		if ( asn1_skip ( &cursor, ASN1_SET ) != 0 )
+			break;
+	}
+
+	return 0;
+}
+
+/**
+ * Check X.509 certificate server name
+ *
+ * @v certificate	Certificate
+ * @v name		Server name
+ * @ret rc		Return status code
+ *
+ * If the certificate has a subjectAltName extension, then the name
+ * must match one of its DNS names.  Otherwise, the name must match
+ * the subject common name.
+ */
+int x509_check_name ( const struct asn1_cursor *certificate,
+		      const char *name ) {
+	struct x509_certificate cert;
+	struct asn1_cursor cursor;
+	struct asn1_cursor dns_name;
+	int rc;
+
+	if ( ( rc = x509_parse ( &cert, certificate ) ) != 0 )
+		return rc;
+
+	/* Check subjectAltName DNS names, if present */
+	if ( cert.alt_names.data ) {
+		memcpy ( &cursor, &cert.alt_names, sizeof ( cursor ) );
+		while ( cursor.len ) {
+			if ( asn1_type ( &cursor ) == X509_DNS_NAME_TAG ) {
+				memcpy ( &dns_name, &cursor,
+					 sizeof ( dns_name ) );
+				if ( ( asn1_enter ( &dns_name,
+						    X509_DNS_NAME_TAG ) == 0 ) &&
+				     x509_dns_name_matches ( &dns_name, name ) )
+					return 0;
+			}
+			if ( asn1_skip ( &cursor, asn1_type ( &cursor ) ) != 0 )
+				break;
+		}
+	} else if ( x509_common_name_matches ( &cert, name ) ) {
+		return 0;
+	}
+
+	DBG ( "X509 certificate does not match name \"%s\"\n", name );
+	return -EACCES;
+}
+
+/**
+ * Check X.509 certificate signature
+ *
+ * @v cert		X.509 certificate
+ * @v issuer		Issuing X.509 certificate
+ * @ret rc		Return status code
+ */
+static int x509_check_signature ( struct x509_certificate *cert,
+				  struct x509_certificate *issuer ) {
+	struct x509_signature_algorithm *algorithm =
+		cert->signature_algorithm;
+	struct digest_algorithm *digest;
+	const uint8_t *modulus = issuer->modulus.data;
+	size_t modulus_len = issuer->modulus.len;
+	RSA_CTX *rsa_ctx;
+	bigint *bi;
+	uint8_t *decrypted;
+	uint8_t *expected;
+	size_t pad_len;
+	int rc;
+
+	/* Check that we support the signature algorithm */
+	if ( ! algorithm ) {
+		DBG ( "Unsupported signature algorithm in:\n" );
+		DBG_HDA ( 0, cert->raw.data, cert->raw.len );
+		return -ENOTSUP;
+	}
+	digest = algorithm->digest;
+
+	/* Strip leading zeroes from the modulus, and check that the
+	 * signature is the same length
+	 */
+	while ( modulus_len && ( *modulus == 0 ) ) {
+		modulus++;
+		modulus_len--;
+	}
+	if ( ( cert->signature.len != modulus_len ) ||
+	     ( modulus_len < ( algorithm->prefix_len + digest->digestsize +
+			       11 /* minimum padding */ ) ) ) {
+		DBG ( "Signature length %zd invalid for %zd-byte modulus\n",
+		      cert->signature.len, modulus_len );
+		return -EACCES;
+	}
+	pad_len = ( modulus_len - algorithm->prefix_len -
+		    digest->digestsize - 3 );
+
+	/* Allocate buffers */
+	decrypted = malloc ( 2 * modulus_len );
+	if ( ! decrypted )
+		return -ENOMEM;
+	expected = ( decrypted + modulus_len );
+
+	/* Construct expected encoded message */
+	{
+		uint8_t ctx[digest->ctxsize];
+		uint8_t *digest_out;
+
+		expected[0] = 0x00;
+		expected[1] = 0x01;
+		memset ( &expected[2], 0xff, pad_len );
+		expected[ 2 + pad_len ] = 0x00;
+		memcpy ( &expected[ 3 + pad_len ], algorithm->prefix,
+			 algorithm->prefix_len );
+		digest_out = &expected[ 3 + pad_len + algorithm->prefix_len ];
+		digest_init ( digest, ctx );
+		digest_update ( digest, ctx, cert->tbs.data, cert->tbs.len );
+		digest_final ( digest, ctx, digest_out );
+	}
+
+	/* Recover encoded message from signature */
+	RSA_pub_key_new ( &rsa_ctx, issuer->modulus.data, issuer->modulus.len,
+			  issuer->exponent.data, issuer->exponent.len );
+	bi = bi_import ( rsa_ctx->bi_ctx, cert->signature.data,
+			 cert->signature.len );
+	bi = RSA_public ( rsa_ctx, bi );
+	if ( ! bi ) {
+		RSA_free ( rsa_ctx );
+		rc = -ENOMEM;
+		goto done;
+	}
+	bi_export ( rsa_ctx->bi_ctx, bi, decrypted, modulus_len );
+	RSA_free ( rsa_ctx );
+
+	/* Compare */
+	if ( memcmp ( decrypted, expected, modulus_len ) != 0 ) {
+		DBG ( "%s signature verification failed\n", algorithm->name );
+		DBG2_HDA ( 0, decrypted, modulus_len );
+		rc = -EACCES;
+		goto done;
+	}
+
+	rc = 0;
+ done:
+	free ( decrypted );
+	return rc;
+}
+
+/**
+ * Calculate X.509 certificate fingerprint
+ *
+ * @v raw		Encoded certificate
+ * @v fingerprint	Fingerprint to fill in
+ */
+static void x509_fingerprint ( const struct asn1_cursor *raw,
+			       uint8_t *fingerprint ) {
+	uint8_t ctx[SHA256_CTX_SIZE];
+
+	digest_init ( &sha256_algorithm, ctx );
+	digest_update ( &sha256_algorithm, ctx, raw->data, raw->len );
+	digest_final ( &sha256_algorithm, ctx, fingerprint );
+}
+
+/**
+ * Check whether or not certificate is a trusted root certificate
+ *
+ * @v root		Root certificate set
+ * @v fingerprint	Certificate fingerprint
+ * @ret is_root		Certificate is a trusted root certificate
+ */
+static int x509_is_root ( struct x509_root *root,
+			  const uint8_t *fingerprint ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < root->count ; i++ ) {
+		if ( memcmp ( &root->fingerprints[ i * X509_FINGERPRINT_LEN ],
+			      fingerprint, X509_FINGERPRINT_LEN ) == 0 )
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * Find certificate in validated certificate cache
+ *
+ * @v root		Root certificate set
+ * @v fingerprint	Certificate fingerprint
+ * @ret cached		Cached certificate, or NULL
+ */
+static struct x509_cached_certificate *
+x509_find_cached ( struct x509_root *root, const uint8_t *fingerprint ) {
+	struct x509_cached_certificate *cached;
+	unsigned int i;
+
+	for ( i = 0 ; i < X509_CACHE_SIZE ; i++ ) {
+		cached = &x509_cache[i];
+		if ( ( cached->root == root ) &&
+		     ( memcmp ( cached->fingerprint, fingerprint,
+				sizeof ( cached->fingerprint ) ) == 0 ) )
+			return cached;
+	}
+	return NULL;
+}
+
+/**
+ * Discard cached certificate
+ *
+ * @v cached		Cached certificate
+ */
+static void x509_discard_cached ( struct x509_cached_certificate *cached ) {
+
+	x509_free_rsa_public_key ( &cached->rsa );
+	memset ( cached, 0, sizeof ( *cached ) );
+}
+
+/**
+ * Add certificate to validated certificate cache
+ *
+ * @v root		Root certificate set
+ * @v fingerprint	Certificate fingerprint
+ * @v cert		Validated X.509 certificate
+ *
+ * The oldest entry is evicted if necessary.  Failure to cache a
+ * certificate is not an error.
+ */
+static void x509_add_cached ( struct x509_root *root,
+			      const uint8_t *fingerprint,
+			      struct x509_certificate *cert ) {
+	struct x509_cached_certificate *cached;
+
+	cached = &x509_cache[x509_cache_next];
+	x509_cache_next = ( ( x509_cache_next + 1 ) % X509_CACHE_SIZE );
+	x509_discard_cached ( cached );
+	if ( x509_copy_rsa_public_key ( &cert->modulus, &cert->exponent,
+					&cached->rsa ) != 0 )
+		return;
+	memcpy ( cached->fingerprint, fingerprint,
+		 sizeof ( cached->fingerprint ) );
+	cached->root = root;
+}
+
+/**
+ * Flush validated certificate cache
+ *
+ */
+void x509_flush_cache ( void ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < X509_CACHE_SIZE ; i++ )
+		x509_discard_cached ( &x509_cache[i] );
+}
+
+/**
+ * Validate X.509 certificate chain
+ *
+ * @v chain		Encoded certificates, starting with the end entity
+ * @v count		Number of certificates
+ * @v root		Root certificate set
+ * @v rsa_pubkey	RSA public key of end entity to fill in
+ * @ret rc		Return status code
+ *
+ * Each certificate must be signed by the next certificate in the
+ * chain, until a trusted root certificate or a previously validated
+ * certificate is reached.  Intermediate certificates must be marked
+ * as CA certificates.
+ *
+ * Certificates which pass validation are added to the validated
+ * certificate cache, so that a repeated connection presenting the
+ * same end entity certificate requires neither parsing nor signature
+ * checking.
+ *
+ * The caller is responsible for eventually calling
+ * x509_free_rsa_public_key() to free the storage allocated to hold
+ * the RSA modulus and exponent.
+ */
+int x509_validate_chain ( const struct asn1_cursor *chain,
+			  unsigned int count, struct x509_root *root,
+			  struct x509_rsa_public_key *rsa_pubkey ) {
+	uint8_t fingerprints[count][X509_FINGERPRINT_LEN];
+	struct x509_cached_certificate *cached = NULL;
+	struct asn1_cursor modulus;
+	struct asn1_cursor exponent;
+	struct x509_certificate issuer;
+	struct x509_certificate cert;
+	unsigned int anchor;
+	unsigned int i;
+	int rc;
+
+	/* Find the first certificate that is already trusted */
+	for ( anchor = 0 ; anchor < count ; anchor++ ) {
+		x509_fingerprint ( &chain[anchor], fingerprints[anchor] );
+		cached = x509_find_cached ( root, fingerprints[anchor] );
+		if ( cached || x509_is_root ( root, fingerprints[anchor] ) )
+			break;
+	}
+	if ( anchor == count ) {
+		DBG ( "X509 chain of %d certificates has no trusted root\n",
+		      count );
+		return -EACCES;
+	}
+	DBG ( "X509 chain trusted from %s certificate %d\n",
+	      ( cached ? "cached" : "root" ), anchor );
+
+	/* Use cached public key if end entity was already validated */
+	if ( cached && ( anchor == 0 ) ) {
+		modulus.data = cached->rsa.modulus;
+		modulus.len = cached->rsa.modulus_len;
+		exponent.data = cached->rsa.exponent;
+		exponent.len = cached->rsa.exponent_len;
+		return x509_copy_rsa_public_key ( &modulus, &exponent,
+						  rsa_pubkey );
+	}
+
+	/* Validate each certificate against its issuer */
+	if ( ( rc = x509_parse ( &issuer, &chain[anchor] ) ) != 0 )
+		return rc;
+	for ( i = anchor ; i > 0 ; i-- ) {
+		if ( ( rc = x509_parse ( &cert, &chain[ i - 1 ] ) ) != 0 )
+			return rc;
+
+		/* Trusted roots need not be marked as CA certificates */
+		if ( ! ( issuer.ca || ( ( i == anchor ) && ! cached ) ) ) {
+			DBG ( "X509 certificate %d is not a CA\n", i );
+			return -EACCES;
+		}
+
+		/* Check issuer name and signature */
+		if ( ( cert.issuer.len != issuer.subject.len ) ||
+		     ( memcmp ( cert.issuer.data, issuer.subject.data,
+				issuer.subject.len ) != 0 ) ) {
+			DBG ( "X509 certificate %d not issued by certificate "
+			      "%d\n", ( i - 1 ), i );
+			return -EACCES;
+		}
+		if ( ( rc = x509_check_signature ( &cert, &issuer ) ) != 0 )
+			return rc;
+
+		x509_add_cached ( root, fingerprints[ i - 1 ], &cert );
+		memcpy ( &issuer, &cert, sizeof ( issuer ) );
+	}
+
+	return x509_copy_rsa_public_key ( &issuer.modulus, &issuer.exponent,
+					  rsa_pubkey );
+}
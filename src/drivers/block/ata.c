@@ -19,6 +19,7 @@
 FILE_LICENCE ( GPL2_OR_LATER );
 
 #include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include <errno.h>
@@ -58,8 +59,10 @@ ata_command ( struct ata_device *ata, struct ata_command *command ) {
 	/* Flag command as in-progress */
 	command->rc = -EINPROGRESS;
 
-	/* Issue ATA command */
-	if ( ( rc = ata->command ( ata, command ) ) != 0 ) {
+	/* Issue ATA command, waiting for a free slot if necessary */
+	while ( ( rc = ata->command ( ata, command ) ) == BLOCKDEV_FULL )
+		step();
+	if ( rc != 0 ) {
 		/* Something went wrong with the issuing mechanism */
 		DBG ( "ATA could not issue command: %s\n", strerror ( rc ) );
 		return rc;
@@ -77,57 +80,78 @@ ata_command ( struct ata_device *ata, struct ata_command *command ) {
 	return 0;
 }
 
+/** An ATA command issued on behalf of a block I/O request */
+struct ata_block_command {
+	/** ATA command */
+	struct ata_command command;
+	/** Block I/O request */
+	struct block_request *request;
+};
+
 /**
- * Read block from ATA device
+ * Handle completion of ATA command issued for a block I/O request
  *
- * @v blockdev		Block device
- * @v block		LBA block number
- * @v count		Block count
- * @v buffer		Data buffer
- * @ret rc		Return status code
+ * @v command		ATA command
  */
-static int ata_read ( struct block_device *blockdev, uint64_t block,
-		      unsigned long count, userptr_t buffer ) {
-	struct ata_device *ata = block_to_ata ( blockdev );
-	struct ata_command command;
+static void ata_block_command_done ( struct ata_command *command ) {
+	struct ata_block_command *blkcmd =
+		container_of ( command, struct ata_block_command, command );
+	struct block_request *request = blkcmd->request;
+	int rc = command->rc;
 
-	memset ( &command, 0, sizeof ( command ) );
-	command.cb.lba.native = block;
-	command.cb.count.native = count;
-	command.cb.device = ( ata->device | ATA_DEV_OBSOLETE | ATA_DEV_LBA );
-	command.cb.lba48 = ata->lba48;
-	if ( ! ata->lba48 )
-		command.cb.device |= command.cb.lba.bytes.low_prev;
-	command.cb.cmd_stat = ( ata->lba48 ? ATA_CMD_READ_EXT : ATA_CMD_READ );
-	command.data_in = buffer;
-	return ata_command ( ata, &command );
+	if ( rc != 0 )
+		DBG ( "ATA command failed: %s\n", strerror ( rc ) );
+	free ( blkcmd );
+	block_request_done ( request, rc );
 }
 
 /**
- * Write block to ATA device
+ * Submit block I/O request to ATA device
  *
  * @v blockdev		Block device
- * @v block		LBA block number
- * @v count		Block count
- * @v buffer		Data buffer
+ * @v request		Block I/O request
  * @ret rc		Return status code
  */
-static int ata_write ( struct block_device *blockdev, uint64_t block,
-		       unsigned long count, userptr_t buffer ) {
+static int ata_submit ( struct block_device *blockdev,
+			struct block_request *request ) {
 	struct ata_device *ata = block_to_ata ( blockdev );
-	struct ata_command command;
-	
-	memset ( &command, 0, sizeof ( command ) );
-	command.cb.lba.native = block;
-	command.cb.count.native = count;
-	command.cb.device = ( ata->device | ATA_DEV_OBSOLETE | ATA_DEV_LBA );
-	command.cb.lba48 = ata->lba48;
+	struct ata_block_command *blkcmd;
+	struct ata_command *command;
+	int rc;
+
+	/* Allocate and construct command */
+	blkcmd = zalloc ( sizeof ( *blkcmd ) );
+	if ( ! blkcmd )
+		return -ENOMEM;
+	blkcmd->request = request;
+	command = &blkcmd->command;
+	command->cb.lba.native = request->block;
+	command->cb.count.native = request->count;
+	command->cb.device = ( ata->device | ATA_DEV_OBSOLETE | ATA_DEV_LBA );
+	command->cb.lba48 = ata->lba48;
 	if ( ! ata->lba48 )
-		command.cb.device |= command.cb.lba.bytes.low_prev;
-	command.cb.cmd_stat = ( ata->lba48 ?
-				ATA_CMD_WRITE_EXT : ATA_CMD_WRITE );
-	command.data_out = buffer;
-	return ata_command ( ata, &command );
+		command->cb.device |= command->cb.lba.bytes.low_prev;
+	if ( request->write ) {
+		command->cb.cmd_stat = ( ata->lba48 ?
+					 ATA_CMD_WRITE_EXT : ATA_CMD_WRITE );
+		command->data_out = request->buffer;
+	} else {
+		command->cb.cmd_stat = ( ata->lba48 ?
+					 ATA_CMD_READ_EXT : ATA_CMD_READ );
+		command->data_in = request->buffer;
+	}
+	command->rc = -EINPROGRESS;
+	command->done = ata_block_command_done;
+
+	/* Issue command.  If the backing device is busy, the block
+	 * device queue will resubmit the request later.
+	 */
+	if ( ( rc = ata->command ( ata, command ) ) != 0 ) {
+		free ( blkcmd );
+		return rc;
+	}
+
+	return 0;
 }
 
 /**
@@ -165,8 +189,9 @@ static int ata_identify ( struct block_device *blockdev ) {
 }
 
 static struct block_device_operations ata_operations = {
-	.read	= ata_read,
-	.write	= ata_write
+	.read	= block_sync_read,
+	.write	= block_sync_write,
+	.submit	= ata_submit,
 };
 
 /**
@@ -183,6 +208,6 @@ static struct block_device_operations ata_operations = {
  */
 int init_atadev ( struct ata_device *ata ) {
 	/** Fill in read and write methods, and get device capacity */
-	ata->blockdev.op = &ata_operations;
+	blockdev_init ( &ata->blockdev, &ata_operations );
 	return ata_identify ( &ata->blockdev );
 }
@@ -0,0 +1,375 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <gpxe/list.h>
+#include <gpxe/umalloc.h>
+#include <gpxe/blockdev.h>
+#include <gpxe/blockcache.h>
+
+/** @file
+ *
+ * Block device cache
+ *
+ * A block cache sits in front of a (typically network-attached) block
+ * device and absorbs the small, mostly sequential reads issued by
+ * real-mode boot loaders.  Reads are satisfied from fixed-size cache
+ * lines held in external memory and replaced in least-recently-used
+ * order.  A miss fetches whole cache lines, and sequential access
+ * progressively widens a read-ahead window so that several lines can
+ * be fetched with a single underlying read.
+ *
+ * Writes are passed straight through to the underlying device, and
+ * any cached copy of the written blocks is updated to match.
+ */
+
+static inline __attribute__ (( always_inline )) struct block_cache *
+block_to_cache ( struct block_device *blockdev ) {
+	return container_of ( blockdev, struct block_cache, blockdev );
+}
+
+/**
+ * Find cache line
+ *
+ * @v cache		Block cache
+ * @v block		First block number of cache line
+ * @ret line		Cache line, or NULL if not cached
+ */
+static struct block_cache_line * block_cache_find ( struct block_cache *cache,
+						    uint64_t block ) {
+	struct block_cache_line *line;
+
+	list_for_each_entry ( line, &cache->lru, list ) {
+		if ( line->count && ( line->block == block ) )
+			return line;
+	}
+	return NULL;
+}
+
+/**
+ * Fetch cache lines from underlying device
+ *
+ * @v cache		Block cache
+ * @v block		First block number of first cache line
+ * @v needed		Number of cache lines required by the current read
+ * @v ahead		Number of additional cache lines to read ahead
+ * @ret rc		Return status code
+ *
+ * The least recently used cache lines are replaced.  Fetching stops
+ * early at the end of the device or at any line that is already
+ * cached.
+ */
+static int block_cache_fetch ( struct block_cache *cache, uint64_t block,
+			       unsigned int needed, unsigned int ahead ) {
+	struct block_device *backing = cache->backing;
+	struct block_cache_line *line;
+	unsigned int lines = ( needed + ahead );
+	unsigned long count;
+	unsigned long line_count;
+	userptr_t buffer;
+	unsigned int i;
+	int rc;
+
+	/* Limit to contiguous uncached lines within the device */
+	if ( lines > BLOCK_CACHE_MAX_FETCH )
+		lines = BLOCK_CACHE_MAX_FETCH;
+	for ( i = 1 ; i < lines ; i++ ) {
+		if ( ( block + ( i * cache->line_blocks ) ) >= backing->blocks )
+			break;
+		if ( block_cache_find ( cache,
+					( block + ( i * cache->line_blocks ) ) ) )
+			break;
+	}
+	lines = i;
+	count = ( lines * cache->line_blocks );
+	if ( count > ( backing->blocks - block ) )
+		count = ( backing->blocks - block );
+
+	/* Read single lines directly into the victim line; use the
+	 * staging area for anything larger.
+	 */
+	if ( lines == 1 ) {
+		line = list_entry ( cache->lru.prev, struct block_cache_line,
+				    list );
+		line->count = 0;
+		buffer = userptr_add ( cache->data, line->offset );
+	} else {
+		buffer = cache->staging;
+	}
+	DBGC2 ( cache, "BLOCKCACHE %p fetching %d line(s) [%llx,%llx)\n",
+		cache, lines, ( ( unsigned long long ) block ),
+		( ( unsigned long long ) ( block + count ) ) );
+	if ( ( rc = backing->op->read ( backing, block, count,
+					buffer ) ) != 0 )
+		return rc;
+
+	/* Populate cache lines */
+	for ( i = 0 ; i < lines ; i++ ) {
+		line = list_entry ( cache->lru.prev, struct block_cache_line,
+				    list );
+		line_count = count;
+		if ( line_count > cache->line_blocks )
+			line_count = cache->line_blocks;
+		if ( lines > 1 ) {
+			memcpy_user ( cache->data, line->offset,
+				      cache->staging,
+				      ( i * BLOCK_CACHE_LINE_LEN ),
+				      ( line_count * backing->blksize ) );
+		}
+		line->block = ( block + ( i * cache->line_blocks ) );
+		line->count = line_count;
+		list_del ( &line->list );
+		list_add ( &line->list, &cache->lru );
+		count -= line_count;
+	}
+	if ( lines > needed )
+		cache->prefetched += ( lines - needed );
+
+	return 0;
+}
+
+/**
+ * Read block
+ *
+ * @v blockdev		Block device
+ * @v block		Block number
+ * @v count		Block count
+ * @v buffer		Data buffer
+ * @ret rc		Return status code
+ */
+static int block_cache_read ( struct block_device *blockdev, uint64_t block,
+			      unsigned long count, userptr_t buffer ) {
+	struct block_cache *cache = block_to_cache ( blockdev );
+	struct block_device *backing = cache->backing;
+	struct block_cache_line *line;
+	uint64_t line_block;
+	unsigned long skip;
+	unsigned long frag;
+	unsigned int needed;
+	size_t offset = 0;
+	int sequential;
+	int missed = 0;
+	int rc;
+
+	/* Pass through if cache is disabled or request is out of range */
+	if ( ( ! cache->data ) || ( block >= backing->blocks ) ||
+	     ( count > ( backing->blocks - block ) ) )
+		return backing->op->read ( backing, block, count, buffer );
+
+	/* Track sequential access */
+	sequential = ( block == cache->next_block );
+	cache->next_block = ( block + count );
+	if ( ! sequential )
+		cache->readahead = 0;
+
+	while ( count ) {
+
+		/* Find cache line, fetching it if necessary */
+		line_block = ( block & ~( ( uint64_t ) cache->line_blocks - 1 ));
+		skip = ( block - line_block );
+		line = block_cache_find ( cache, line_block );
+		if ( ! line ) {
+			needed = ( ( skip + count + cache->line_blocks - 1 ) /
+				   cache->line_blocks );
+			rc = block_cache_fetch ( cache, line_block, needed,
+						 cache->readahead );
+			if ( rc != 0 ) {
+				DBGC ( cache, "BLOCKCACHE %p could not fetch "
+				       "%llx: %s\n", cache,
+				       ( ( unsigned long long ) line_block ),
+				       strerror ( rc ) );
+				return rc;
+			}
+			if ( sequential ) {
+				cache->readahead = ( cache->readahead ?
+						     ( cache->readahead * 2 ) :
+						     1 );
+				if ( cache->readahead >=
+				     BLOCK_CACHE_MAX_FETCH )
+					cache->readahead =
+						( BLOCK_CACHE_MAX_FETCH - 1 );
+			}
+			missed = 1;
+			line = block_cache_find ( cache, line_block );
+			assert ( line != NULL );
+		}
+
+		/* Copy out data and mark line as most recently used */
+		assert ( skip < line->count );
+		frag = ( line->count - skip );
+		if ( frag > count )
+			frag = count;
+		memcpy_user ( buffer, offset, cache->data,
+			      ( line->offset + ( skip * backing->blksize ) ),
+			      ( frag * backing->blksize ) );
+		list_del ( &line->list );
+		list_add ( &line->list, &cache->lru );
+
+		block += frag;
+		count -= frag;
+		offset += ( frag * backing->blksize );
+	}
+
+	if ( missed ) {
+		cache->misses++;
+	} else {
+		cache->hits++;
+	}
+	return 0;
+}
+
+/**
+ * Write block
+ *
+ * @v blockdev		Block device
+ * @v block		Block number
+ * @v count		Block count
+ * @v buffer		Data buffer
+ * @ret rc		Return status code
+ *
+ * Writes go straight through to the underlying device.  Cached copies
+ * of the written blocks are updated if the write succeeds, and
+ * discarded if it fails.
+ */
+static int block_cache_write ( struct block_device *blockdev, uint64_t block,
+			       unsigned long count, userptr_t buffer ) {
+	struct block_cache *cache = block_to_cache ( blockdev );
+	struct block_device *backing = cache->backing;
+	struct block_cache_line *line;
+	uint64_t start;
+	uint64_t end;
+	unsigned int i;
+	int rc;
+
+	rc = backing->op->write ( backing, block, count, buffer );
+	cache->writes++;
+	if ( ! cache->data )
+		return rc;
+
+	for ( i = 0 ; i < BLOCK_CACHE_LINES ; i++ ) {
+		line = &cache->lines[i];
+		if ( ! line->count )
+			continue;
+		start = ( ( block > line->block ) ? block : line->block );
+		end = ( ( ( block + count ) < ( line->block + line->count ) ) ?
+			( block + count ) : ( line->block + line->count ) );
+		if ( start >= end )
+			continue;
+		if ( rc == 0 ) {
+			memcpy_user ( cache->data,
+				      ( line->offset + ( ( start - line->block )
+							 * backing->blksize ) ),
+				      buffer,
+				      ( ( start - block ) * backing->blksize ),
+				      ( ( end - start ) * backing->blksize ) );
+		} else {
+			line->count = 0;
+			list_del ( &line->list );
+			list_add_tail ( &line->list, &cache->lru );
+		}
+	}
+
+	return rc;
+}
+
+/** Block cache operations */
+static struct block_device_operations block_cache_operations = {
+	.read	= block_cache_read,
+	.write	= block_cache_write,
+};
+
+/**
+ * Initialise block cache
+ *
+ * @v cache		Block cache
+ * @v backing		Underlying block device
+ *
+ * If the block size is unsuitable or no external memory is
+ * available, the cache will pass all requests straight through to
+ * the underlying device.
+ */
+void init_block_cache ( struct block_cache *cache,
+			struct block_device *backing ) {
+	struct block_cache_line *line;
+	size_t blksize = backing->blksize;
+	unsigned long line_blocks;
+	unsigned int i;
+
+	memset ( cache, 0, sizeof ( *cache ) );
+	blockdev_init ( &cache->blockdev, &block_cache_operations );
+	cache->blockdev.blksize = blksize;
+	cache->blockdev.blocks = backing->blocks;
+	cache->backing = backing;
+	INIT_LIST_HEAD ( &cache->lru );
+
+	/* Cache lines must hold a power-of-two number of blocks */
+	line_blocks = ( blksize ? ( BLOCK_CACHE_LINE_LEN / blksize ) : 0 );
+	if ( ( line_blocks == 0 ) ||
+	     ( ( line_blocks * blksize ) != BLOCK_CACHE_LINE_LEN ) ||
+	     ( line_blocks & ( line_blocks - 1 ) ) ) {
+		DBGC ( cache, "BLOCKCACHE %p cannot cache blksize %zd\n",
+		       cache, blksize );
+		return;
+	}
+	cache->line_blocks = line_blocks;
+
+	/* Allocate cache data and staging area */
+	cache->data = umalloc ( BLOCK_CACHE_LINES * BLOCK_CACHE_LINE_LEN );
+	cache->staging = umalloc ( BLOCK_CACHE_MAX_FETCH *
+				   BLOCK_CACHE_LINE_LEN );
+	if ( ! ( cache->data && cache->staging ) ) {
+		DBGC ( cache, "BLOCKCACHE %p could not allocate cache\n",
+		       cache );
+		ufree ( cache->data );
+		ufree ( cache->staging );
+		cache->data = UNULL;
+		cache->staging = UNULL;
+		return;
+	}
+
+	/* Populate LRU list with unused lines */
+	for ( i = 0 ; i < BLOCK_CACHE_LINES ; i++ ) {
+		line = &cache->lines[i];
+		line->offset = ( i * BLOCK_CACHE_LINE_LEN );
+		list_add_tail ( &line->list, &cache->lru );
+	}
+
+	DBGC ( cache, "BLOCKCACHE %p caching %p with %d lines of %ld blocks\n",
+	       cache, backing, BLOCK_CACHE_LINES, line_blocks );
+}
+
+/**
+ * Free block cache
+ *
+ * @v cache		Block cache
+ */
+void free_block_cache ( struct block_cache *cache ) {
+
+	DBGC ( cache, "BLOCKCACHE %p %ld hits, %ld misses, %ld lines "
+	       "prefetched, %ld writes\n", cache, cache->hits, cache->misses,
+	       cache->prefetched, cache->writes );
+
+	ufree ( cache->data );
+	ufree ( cache->staging );
+	cache->data = UNULL;
+	cache->staging = UNULL;
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <gpxe/list.h>
+#include <gpxe/process.h>
+#include <gpxe/blockdev.h>
+
+/** @file
+ *
+ * Block device request queues
+ *
+ * Block I/O requests are submitted to a block device's request queue
+ * and passed on to the device for as long as the device will accept
+ * them, so that a device backed by a network protocol may have
+ * several requests in flight at once.  Requests that the device
+ * cannot yet accept remain queued until an earlier request completes.
+ *
+ */
+
+/**
+ * Pass queued requests to block device
+ *
+ * @v blockdev		Block device
+ */
+static void block_submit_queue ( struct block_device *blockdev ) {
+	struct block_request *request;
+	int rc;
+
+	/* Avoid recursion via requests that complete immediately */
+	if ( blockdev->submitting )
+		return;
+	blockdev->submitting = 1;
+
+	while ( ! list_empty ( &blockdev->queue ) ) {
+		request = list_entry ( blockdev->queue.next,
+				       struct block_request, list );
+		list_del ( &request->list );
+		rc = blockdev->op->submit ( blockdev, request );
+		if ( rc == BLOCKDEV_FULL ) {
+			/* Device is full; retry on next completion */
+			list_add ( &request->list, &blockdev->queue );
+			break;
+		}
+		if ( rc != 0 )
+			block_request_done ( request, rc );
+	}
+
+	blockdev->submitting = 0;
+}
+
+/**
+ * Submit block I/O request
+ *
+ * @v blockdev		Block device
+ * @v request		Block I/O request
+ *
+ * The caller must fill in the request's direction, block range,
+ * buffer and (optional) completion handler.  The request structure
+ * and data buffer must remain valid until the request has completed;
+ * the caller may use block_request_in_progress() to poll for
+ * completion.
+ */
+void block_submit ( struct block_device *blockdev,
+		    struct block_request *request ) {
+	int rc;
+
+	request->blockdev = blockdev;
+	request->rc = -EINPROGRESS;
+
+	/* Service synchronously if device has no request interface */
+	if ( ! blockdev->op->submit ) {
+		rc = ( request->write ? blockdev->op->write :
+		       blockdev->op->read ) ( blockdev, request->block,
+					       request->count,
+					       request->buffer );
+		block_request_done ( request, rc );
+		return;
+	}
+
+	list_add_tail ( &request->list, &blockdev->queue );
+	block_submit_queue ( blockdev );
+}
+
+/**
+ * Mark block I/O request as complete
+ *
+ * @v request		Block I/O request
+ * @v rc		Return status code
+ *
+ * Called by the block device when a request completes.  Any requests
+ * still waiting in the device's queue will be submitted.
+ */
+void block_request_done ( struct block_request *request, int rc ) {
+	struct block_device *blockdev = request->blockdev;
+
+	if ( rc != 0 ) {
+		DBGC ( blockdev, "BLOCKDEV %p %s %llx+%ld failed: %s\n",
+		       blockdev, ( request->write ? "write" : "read" ),
+		       ( ( unsigned long long ) request->block ),
+		       request->count, strerror ( rc ) );
+	}
+
+	/* Record completion and notify owner.  The owner may free or
+	 * reuse the request.
+	 */
+	request->rc = rc;
+	if ( request->done )
+		request->done ( request );
+
+	/* Refill device from queue */
+	if ( blockdev->op->submit )
+		block_submit_queue ( blockdev );
+}
+
+/**
+ * Check if block I/O request is still in progress
+ *
+ * @v request		Block I/O request
+ * @ret in_progress	Request is still in progress
+ */
+int block_request_in_progress ( struct block_request *request ) {
+	return ( request->rc == -EINPROGRESS );
+}
+
+/**
+ * Read or write blocks synchronously
+ *
+ * @v blockdev		Block device
+ * @v write		Request is a write
+ * @v block		Block number
+ * @v count		Block count
+ * @v buffer		Data buffer
+ * @ret rc		Return status code
+ */
+static int block_sync ( struct block_device *blockdev, int write,
+			uint64_t block, unsigned long count,
+			userptr_t buffer ) {
+	struct block_request request;
+
+	memset ( &request, 0, sizeof ( request ) );
+	request.write = write;
+	request.block = block;
+	request.count = count;
+	request.buffer = buffer;
+	block_submit ( blockdev, &request );
+	while ( block_request_in_progress ( &request ) )
+		step();
+	return request.rc;
+}
+
+/**
+ * Read blocks synchronously
+ *
+ * @v blockdev		Block device
+ * @v block		Block number
+ * @v count		Block count
+ * @v buffer		Data buffer
+ * @ret rc		Return status code
+ *
+ * This is a thin wrapper around block_submit(), for use as the read()
+ * method of a block device that implements submit().
+ */
+int block_sync_read ( struct block_device *blockdev, uint64_t block,
+		      unsigned long count, userptr_t buffer ) {
+	return block_sync ( blockdev, 0, block, count, buffer );
+}
+
+/**
+ * Write blocks synchronously
+ *
+ * @v blockdev		Block device
+ * @v block		Block number
+ * @v count		Block count
+ * @v buffer		Data buffer
+ * @ret rc		Return status code
+ *
+ * This is a thin wrapper around block_submit(), for use as the
+ * write() method of a block device that implements submit().
+ */
+int block_sync_write ( struct block_device *blockdev, uint64_t block,
+		       unsigned long count, userptr_t buffer ) {
+	return block_sync ( blockdev, 1, block, count, buffer );
+}
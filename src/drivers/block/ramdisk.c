@@ -77,9 +77,30 @@ static int ramdisk_write ( struct block_device *blockdev, uint64_t block,
 	return 0;
 }
 
+/**
+ * Submit block I/O request
+ *
+ * @v blockdev		Block device
+ * @v request		Block I/O request
+ * @ret rc		Return status code
+ *
+ * RAM disk requests complete immediately, so any number of requests
+ * may be outstanding.
+ */
+static int ramdisk_submit ( struct block_device *blockdev,
+			    struct block_request *request ) {
+	int rc;
+
+	rc = ( request->write ? ramdisk_write : ramdisk_read )
+		( blockdev, request->block, request->count, request->buffer );
+	block_request_done ( request, rc );
+	return 0;
+}
+
 static struct block_device_operations ramdisk_operations = {
 	.read	= ramdisk_read,
-	.write	= ramdisk_write
+	.write	= ramdisk_write,
+	.submit	= ramdisk_submit,
 };
 
 int init_ramdisk ( struct ramdisk *ramdisk, userptr_t data, size_t len,
@@ -89,7 +110,7 @@ int init_ramdisk ( struct ramdisk *ramdisk, userptr_t data, size_t len,
 		blksize = 512;
 
 	ramdisk->data = data;
-	ramdisk->blockdev.op = &ramdisk_operations;
+	blockdev_init ( &ramdisk->blockdev, &ramdisk_operations );
 	ramdisk->blockdev.blksize = blksize;
 	ramdisk->blockdev.blocks = ( len / blksize );
 
@@ -23,6 +23,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <string.h>
 #include <byteswap.h>
 #include <errno.h>
+#include <assert.h>
 #include <gpxe/blockdev.h>
 #include <gpxe/process.h>
 #include <gpxe/scsi.h>
@@ -58,14 +59,34 @@ int scsi_detached_command ( struct scsi_device *scsi __unused,
 }
 
 /**
- * Issue SCSI command
+ * Check if SCSI command is still in progress
+ *
+ * @v command		SCSI command
+ * @ret in_progress	Command is still in progress
+ */
+int scsi_command_in_progress ( struct scsi_command *command ) {
+	return ( command->rc == -EINPROGRESS );
+}
+
+/**
+ * Start issuing SCSI command
  *
  * @v scsi		SCSI device
  * @v command		SCSI command
  * @ret rc		Return status code
+ *
+ * The command is issued without waiting for it to complete; the
+ * caller must either use scsi_command_in_progress() or supply a
+ * completion handler (scsi_command::done) to determine when the
+ * command has completed, and scsi_command_result() to obtain the
+ * overall result.  The command structure (and any data buffers) must
+ * remain valid until the command has completed.
+ *
+ * If the backing device cannot accept any more outstanding commands,
+ * BLOCKDEV_FULL is returned and the command is not issued.
  */
-static int scsi_command ( struct scsi_device *scsi,
-			  struct scsi_command *command ) {
+int scsi_command_start ( struct scsi_device *scsi,
+			 struct scsi_command *command ) {
 	int rc;
 
 	DBGC2 ( scsi, "SCSI %p " SCSI_CDB_FORMAT "\n",
@@ -78,16 +99,34 @@ static int scsi_command ( struct scsi_device *scsi,
 	command->rc = -EINPROGRESS;
 
 	/* Issue SCSI command */
-	if ( ( rc = scsi->command ( scsi, command ) ) != 0 ) {
+	if ( ( rc = scsi->command ( scsi, command ) ) == BLOCKDEV_FULL ) {
+		DBGC2 ( scsi, "SCSI %p device full\n", scsi );
+		return rc;
+	}
+	if ( rc != 0 ) {
 		/* Something went wrong with the issuing mechanism */
 		DBGC ( scsi, "SCSI %p " SCSI_CDB_FORMAT " err %s\n",
 		       scsi, SCSI_CDB_DATA ( command->cdb ), strerror ( rc ) );
+		command->rc = rc;
 		return rc;
 	}
 
-	/* Wait for command to complete */
-	while ( command->rc == -EINPROGRESS )
-		step();
+	return 0;
+}
+
+/**
+ * Get result of completed SCSI command
+ *
+ * @v scsi		SCSI device
+ * @v command		SCSI command
+ * @ret rc		Return status code
+ */
+int scsi_command_result ( struct scsi_device *scsi,
+			  struct scsi_command *command ) {
+	int rc;
+
+	assert ( ! scsi_command_in_progress ( command ) );
+
 	if ( ( rc = command->rc ) != 0 ) {
 		/* Something went wrong with the command execution */
 		DBGC ( scsi, "SCSI %p " SCSI_CDB_FORMAT " err %s\n",
@@ -107,103 +146,167 @@ static int scsi_command ( struct scsi_device *scsi,
 }
 
 /**
- * Read block from SCSI device using READ (10)
+ * Issue SCSI command
  *
- * @v blockdev		Block device
- * @v block		LBA block number
- * @v count		Block count
- * @v buffer		Data buffer
+ * @v scsi		SCSI device
+ * @v command		SCSI command
  * @ret rc		Return status code
  */
-static int scsi_read_10 ( struct block_device *blockdev, uint64_t block,
-			  unsigned long count, userptr_t buffer ) {
-	struct scsi_device *scsi = block_to_scsi ( blockdev );
+static int scsi_command ( struct scsi_device *scsi,
+			  struct scsi_command *command ) {
+	int rc;
+
+	/* Issue SCSI command, waiting for a free slot if necessary */
+	while ( ( rc = scsi_command_start ( scsi, command ) ) ==
+		BLOCKDEV_FULL ) {
+		step();
+	}
+	if ( rc != 0 )
+		return rc;
+
+	/* Wait for command to complete */
+	while ( scsi_command_in_progress ( command ) )
+		step();
+
+	return scsi_command_result ( scsi, command );
+}
+
+/** A SCSI command issued on behalf of a block I/O request */
+struct scsi_block_command {
+	/** SCSI command */
 	struct scsi_command command;
-	struct scsi_cdb_read_10 *cdb = &command.cdb.read10;
+	/** SCSI device */
+	struct scsi_device *scsi;
+	/** Block I/O request */
+	struct block_request *request;
+};
 
-	/* Issue READ (10) */
-	memset ( &command, 0, sizeof ( command ) );
-	cdb->opcode = SCSI_OPCODE_READ_10;
-	cdb->lba = cpu_to_be32 ( block );
-	cdb->len = cpu_to_be16 ( count );
-	command.data_in = buffer;
-	command.data_in_len = ( count * blockdev->blksize );
-	return scsi_command ( scsi, &command );
+/**
+ * Fill in READ (10) or WRITE (10) command
+ *
+ * @v command		SCSI command
+ * @v request		Block I/O request
+ */
+static void scsi_rw_10 ( struct scsi_command *command,
+			 struct block_request *request ) {
+	struct scsi_cdb_read_10 *read = &command->cdb.read10;
+	struct scsi_cdb_write_10 *write = &command->cdb.write10;
+
+	if ( request->write ) {
+		write->opcode = SCSI_OPCODE_WRITE_10;
+		write->lba = cpu_to_be32 ( request->block );
+		write->len = cpu_to_be16 ( request->count );
+	} else {
+		read->opcode = SCSI_OPCODE_READ_10;
+		read->lba = cpu_to_be32 ( request->block );
+		read->len = cpu_to_be16 ( request->count );
+	}
 }
 
 /**
- * Read block from SCSI device using READ (16)
+ * Fill in READ (16) or WRITE (16) command
  *
- * @v blockdev		Block device
- * @v block		LBA block number
- * @v count		Block count
- * @v buffer		Data buffer
- * @ret rc		Return status code
+ * @v command		SCSI command
+ * @v request		Block I/O request
  */
-static int scsi_read_16 ( struct block_device *blockdev, uint64_t block,
-			  unsigned long count, userptr_t buffer ) {
-	struct scsi_device *scsi = block_to_scsi ( blockdev );
-	struct scsi_command command;
-	struct scsi_cdb_read_16 *cdb = &command.cdb.read16;
+static void scsi_rw_16 ( struct scsi_command *command,
+			 struct block_request *request ) {
+	struct scsi_cdb_read_16 *read = &command->cdb.read16;
+	struct scsi_cdb_write_16 *write = &command->cdb.write16;
+
+	if ( request->write ) {
+		write->opcode = SCSI_OPCODE_WRITE_16;
+		write->lba = cpu_to_be64 ( request->block );
+		write->len = cpu_to_be32 ( request->count );
+	} else {
+		read->opcode = SCSI_OPCODE_READ_16;
+		read->lba = cpu_to_be64 ( request->block );
+		read->len = cpu_to_be32 ( request->count );
+	}
+}
 
-	/* Issue READ (16) */
-	memset ( &command, 0, sizeof ( command ) );
-	cdb->opcode = SCSI_OPCODE_READ_16;
-	cdb->lba = cpu_to_be64 ( block );
-	cdb->len = cpu_to_be32 ( count );
-	command.data_in = buffer;
-	command.data_in_len = ( count * blockdev->blksize );
-	return scsi_command ( scsi, &command );
+/**
+ * Handle completion of SCSI command issued for a block I/O request
+ *
+ * @v command		SCSI command
+ */
+static void scsi_block_command_done ( struct scsi_command *command ) {
+	struct scsi_block_command *blkcmd =
+		container_of ( command, struct scsi_block_command, command );
+	struct block_request *request = blkcmd->request;
+	int rc;
+
+	rc = scsi_command_result ( blkcmd->scsi, command );
+	free ( blkcmd );
+	block_request_done ( request, rc );
 }
 
 /**
- * Write block to SCSI device using WRITE (10)
+ * Submit block I/O request to SCSI device
  *
  * @v blockdev		Block device
- * @v block		LBA block number
- * @v count		Block count
- * @v buffer		Data buffer
+ * @v request		Block I/O request
+ * @v fill		Method for filling in READ/WRITE CDB
  * @ret rc		Return status code
  */
-static int scsi_write_10 ( struct block_device *blockdev, uint64_t block,
-			   unsigned long count, userptr_t buffer ) {
+static int scsi_submit ( struct block_device *blockdev,
+			 struct block_request *request,
+			 void ( * fill ) ( struct scsi_command *command,
+					   struct block_request *request ) ) {
 	struct scsi_device *scsi = block_to_scsi ( blockdev );
-	struct scsi_command command;
-	struct scsi_cdb_write_10 *cdb = &command.cdb.write10;
+	struct scsi_block_command *blkcmd;
+	size_t len = ( request->count * blockdev->blksize );
+	int rc;
 
-	/* Issue WRITE (10) */
-	memset ( &command, 0, sizeof ( command ) );
-	cdb->opcode = SCSI_OPCODE_WRITE_10;
-	cdb->lba = cpu_to_be32 ( block );
-	cdb->len = cpu_to_be16 ( count );
-	command.data_out = buffer;
-	command.data_out_len = ( count * blockdev->blksize );
-	return scsi_command ( scsi, &command );
+	/* Allocate and construct command */
+	blkcmd = zalloc ( sizeof ( *blkcmd ) );
+	if ( ! blkcmd )
+		return -ENOMEM;
+	blkcmd->scsi = scsi;
+	blkcmd->request = request;
+	fill ( &blkcmd->command, request );
+	if ( request->write ) {
+		blkcmd->command.data_out = request->buffer;
+		blkcmd->command.data_out_len = len;
+	} else {
+		blkcmd->command.data_in = request->buffer;
+		blkcmd->command.data_in_len = len;
+	}
+	blkcmd->command.done = scsi_block_command_done;
+
+	/* Issue command.  If the backing device is full, the block
+	 * device queue will resubmit the request later.
+	 */
+	if ( ( rc = scsi_command_start ( scsi, &blkcmd->command ) ) != 0 ) {
+		free ( blkcmd );
+		return rc;
+	}
+
+	return 0;
 }
 
 /**
- * Write block to SCSI device using WRITE (16)
+ * Submit block I/O request using READ/WRITE (10)
  *
  * @v blockdev		Block device
- * @v block		LBA block number
- * @v count		Block count
- * @v buffer		Data buffer
+ * @v request		Block I/O request
  * @ret rc		Return status code
  */
-static int scsi_write_16 ( struct block_device *blockdev, uint64_t block,
-			   unsigned long count, userptr_t buffer ) {
-	struct scsi_device *scsi = block_to_scsi ( blockdev );
-	struct scsi_command command;
-	struct scsi_cdb_write_16 *cdb = &command.cdb.write16;
+static int scsi_submit_10 ( struct block_device *blockdev,
+			    struct block_request *request ) {
+	return scsi_submit ( blockdev, request, scsi_rw_10 );
+}
 
-	/* Issue WRITE (16) */
-	memset ( &command, 0, sizeof ( command ) );
-	cdb->opcode = SCSI_OPCODE_WRITE_16;
-	cdb->lba = cpu_to_be64 ( block );
-	cdb->len = cpu_to_be32 ( count );
-	command.data_out = buffer;
-	command.data_out_len = ( count * blockdev->blksize );
-	return scsi_command ( scsi, &command );
+/**
+ * Submit block I/O request using READ/WRITE (16)
+ *
+ * @v blockdev		Block device
+ * @v request		Block I/O request
+ * @ret rc		Return status code
+ */
+static int scsi_submit_16 ( struct block_device *blockdev,
+			    struct block_request *request ) {
+	return scsi_submit ( blockdev, request, scsi_rw_16 );
 }
 
 /**
@@ -266,13 +369,15 @@ static int scsi_read_capacity_16 ( struct block_device *blockdev ) {
 }
 
 static struct block_device_operations scsi_operations_16 = {
-	.read	= scsi_read_16,
-	.write	= scsi_write_16,
+	.read	= block_sync_read,
+	.write	= block_sync_write,
+	.submit	= scsi_submit_16,
 };
 
 static struct block_device_operations scsi_operations_10 = {
-	.read	= scsi_read_10,
-	.write	= scsi_write_10,
+	.read	= block_sync_read,
+	.write	= block_sync_write,
+	.submit	= scsi_submit_10,
 };
 
 /**
@@ -306,7 +411,7 @@ int init_scsidev ( struct scsi_device *scsi ) {
 	}
 
 	/* Try READ CAPACITY (10), which is a mandatory command, first. */
-	scsi->blockdev.op = &scsi_operations_10;
+	blockdev_init ( &scsi->blockdev, &scsi_operations_10 );
 	if ( ( rc = scsi_read_capacity_10 ( &scsi->blockdev ) ) != 0 ) {
 		DBGC ( scsi, "SCSI %p could not READ CAPACITY (10): %s\n",
 		       scsi, strerror ( rc ) );
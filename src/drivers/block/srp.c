@@ -36,6 +36,8 @@ FILE_LICENCE ( BSD2 );
 #include <gpxe/scsi.h>
 #include <gpxe/xfer.h>
 #include <gpxe/features.h>
+#include <gpxe/settings.h>
+#include <gpxe/dhcp.h>
 #include <gpxe/ib_srp.h>
 #include <gpxe/srp.h>
 
@@ -51,19 +53,71 @@ FEATURE ( FEATURE_PROTOCOL, "SRP", DHCP_EB_FEATURE_SRP, 1 );
 /** Tag to be used for next SRP IU */
 static unsigned int srp_tag = 0;
 
+/** SRP maximum outstanding commands setting */
+struct setting srp_max_cmds_setting __setting = {
+	.name = "srp-max-cmds",
+	.description = "SRP maximum outstanding commands",
+	.tag = DHCP_EB_SRP_MAX_CMDS,
+	.type = &setting_type_uint8,
+};
+
 static void srp_login ( struct srp_device *srp );
-static void srp_cmd ( struct srp_device *srp );
+static void srp_cmd ( struct srp_device *srp, struct srp_task *task );
 
 /**
  * Mark SRP SCSI command as complete
  *
  * @v srp		SRP device
+ * @v task		SRP command slot
  * @v rc		Status code
  */
-static void srp_scsi_done ( struct srp_device *srp, int rc ) {
-	if ( srp->command )
-		srp->command->rc = rc;
-	srp->command = NULL;
+static void srp_scsi_done ( struct srp_device *srp __unused,
+			    struct srp_task *task, int rc ) {
+	struct scsi_command *command = task->command;
+
+	/* Free slot before completing, since the completion handler
+	 * may issue a new command.
+	 */
+	task->command = NULL;
+	task->sent = 0;
+	scsi_command_done ( command, rc );
+}
+
+/**
+ * Fail all outstanding SRP SCSI commands
+ *
+ * @v srp		SRP device
+ * @v rc		Status code
+ */
+static void srp_scsi_fail_all ( struct srp_device *srp, int rc ) {
+	struct srp_task *task;
+	unsigned int i;
+
+	for ( i = 0 ; i < SRP_MAX_OUTSTANDING ; i++ ) {
+		task = &srp->tasks[i];
+		if ( task->command )
+			srp_scsi_done ( srp, task, rc );
+	}
+}
+
+/**
+ * Send as many pending SRP commands as the request limit allows
+ *
+ * @v srp		SRP device
+ */
+static void srp_send_pending ( struct srp_device *srp ) {
+	struct srp_task *task;
+	unsigned int i;
+
+	for ( i = 0 ; i < SRP_MAX_OUTSTANDING ; i++ ) {
+		if ( srp->request_limit <= 0 )
+			return;
+		if ( ! ( srp->state & SRP_STATE_LOGGED_IN ) )
+			return;
+		task = &srp->tasks[i];
+		if ( task->command && ! task->sent )
+			srp_cmd ( srp, task );
+	}
 }
 
 /**
@@ -74,15 +128,22 @@ static void srp_scsi_done ( struct srp_device *srp, int rc ) {
  */
 static void srp_fail ( struct srp_device *srp, int rc ) {
 
+	unsigned int i;
+
 	/* Close underlying socket */
 	xfer_close ( &srp->socket, rc );
 
-	/* Clear session state */
+	/* Clear session state.  Any commands already sent will need
+	 * to be resent in the new session.
+	 */
 	srp->state = 0;
+	srp->request_limit = 0;
+	for ( i = 0 ; i < SRP_MAX_OUTSTANDING ; i++ )
+		srp->tasks[i].sent = 0;
 
 	/* If we have reached the retry limit, report the failure */
 	if ( srp->retry_count >= SRP_MAX_RETRIES ) {
-		srp_scsi_done ( srp, rc );
+		srp_scsi_fail_all ( srp, rc );
 		return;
 	}
 
@@ -171,7 +232,10 @@ static int srp_login_rsp ( struct srp_device *srp, struct io_buffer *iobuf ) {
 		goto out;
 	}
 
-	DBGC ( srp, "SRP %p logged in\n", srp );
+	/* Record initial request limit */
+	srp->request_limit = ntohl ( login_rsp->request_limit_delta );
+	DBGC ( srp, "SRP %p logged in with request limit %d\n",
+	       srp, srp->request_limit );
 
 	/* Mark as logged in */
 	srp->state |= SRP_STATE_LOGGED_IN;
@@ -179,8 +243,8 @@ static int srp_login_rsp ( struct srp_device *srp, struct io_buffer *iobuf ) {
 	/* Reset error counter */
 	srp->retry_count = 0;
 
-	/* Issue pending command */
-	srp_cmd ( srp );
+	/* Issue pending commands */
+	srp_send_pending ( srp );
 
 	rc = 0;
  out:
@@ -225,8 +289,13 @@ static int srp_login_rej ( struct srp_device *srp, struct io_buffer *iobuf ) {
  * Transmit SRP SCSI command
  *
  * @v srp		SRP device
+ * @v task		SRP command slot
+ *
+ * The command slot index is carried in the first half of the tag,
+ * allowing the response to be matched to its command.
  */
-static void srp_cmd ( struct srp_device *srp ) {
+static void srp_cmd ( struct srp_device *srp, struct srp_task *task ) {
+	struct scsi_command *command = task->command;
 	struct io_buffer *iobuf;
 	struct srp_cmd *cmd;
 	struct srp_memory_descriptor *data_out;
@@ -234,6 +303,7 @@ static void srp_cmd ( struct srp_device *srp ) {
 	int rc;
 
 	assert ( srp->state & SRP_STATE_LOGGED_IN );
+	assert ( srp->request_limit > 0 );
 
 	/* Allocate I/O buffer */
 	iobuf = xfer_alloc_iob ( &srp->socket, SRP_MAX_I_T_IU_LEN );
@@ -246,28 +316,34 @@ static void srp_cmd ( struct srp_device *srp ) {
 	cmd = iob_put ( iobuf, sizeof ( *cmd ) );
 	memset ( cmd, 0, sizeof ( *cmd ) );
 	cmd->type = SRP_CMD;
-	cmd->tag.dwords[1] = htonl ( ++srp_tag );
+	task->tag = ++srp_tag;
+	cmd->tag.dwords[0] = htonl ( task - srp->tasks );
+	cmd->tag.dwords[1] = htonl ( task->tag );
 	cmd->lun = srp->lun;
-	memcpy ( &cmd->cdb, &srp->command->cdb, sizeof ( cmd->cdb ) );
+	memcpy ( &cmd->cdb, &command->cdb, sizeof ( cmd->cdb ) );
 
-	/* Construct data-out descriptor, if present */
-	if ( srp->command->data_out ) {
+	/* Construct data-out descriptor, if present.  The whole
+	 * buffer is described by a single direct descriptor, however
+	 * large, so that the target can transfer it with one RDMA
+	 * operation.
+	 */
+	if ( command->data_out ) {
 		cmd->data_buffer_formats |= SRP_CMD_DO_FMT_DIRECT;
 		data_out = iob_put ( iobuf, sizeof ( *data_out ) );
 		data_out->address =
-		    cpu_to_be64 ( user_to_phys ( srp->command->data_out, 0 ) );
+		    cpu_to_be64 ( user_to_phys ( command->data_out, 0 ) );
 		data_out->handle = ntohl ( srp->memory_handle );
-		data_out->len = ntohl ( srp->command->data_out_len );
+		data_out->len = ntohl ( command->data_out_len );
 	}
 
 	/* Construct data-in descriptor, if present */
-	if ( srp->command->data_in ) {
+	if ( command->data_in ) {
 		cmd->data_buffer_formats |= SRP_CMD_DI_FMT_DIRECT;
 		data_in = iob_put ( iobuf, sizeof ( *data_in ) );
 		data_in->address =
-		     cpu_to_be64 ( user_to_phys ( srp->command->data_in, 0 ) );
+		     cpu_to_be64 ( user_to_phys ( command->data_in, 0 ) );
 		data_in->handle = ntohl ( srp->memory_handle );
-		data_in->len = ntohl ( srp->command->data_in_len );
+		data_in->len = ntohl ( command->data_in_len );
 	}
 
 	DBGC2 ( srp, "SRP %p TX SCSI command tag %08x%08x\n", srp,
@@ -281,6 +357,10 @@ static void srp_cmd ( struct srp_device *srp ) {
 		goto err;
 	}
 
+	/* Consume one request credit */
+	task->sent = 1;
+	srp->request_limit--;
+
 	return;
 
  err:
@@ -296,6 +376,8 @@ static void srp_cmd ( struct srp_device *srp ) {
  */
 static int srp_rsp ( struct srp_device *srp, struct io_buffer *iobuf ) {
 	struct srp_rsp *rsp = iobuf->data;
+	struct srp_task *task;
+	unsigned int index;
 	int rc;
 
 	DBGC2 ( srp, "SRP %p RX SCSI response tag %08x%08x\n", srp,
@@ -309,6 +391,22 @@ static int srp_rsp ( struct srp_device *srp, struct io_buffer *iobuf ) {
 		goto out;
 	}
 
+	/* Return request credits granted by the target */
+	srp->request_limit += ( ( int32_t ) ntohl ( rsp->request_limit_delta ) );
+
+	/* Identify command */
+	index = ntohl ( rsp->tag.dwords[0] );
+	task = &srp->tasks[ index % SRP_MAX_OUTSTANDING ];
+	if ( ( index >= SRP_MAX_OUTSTANDING ) || ( ! task->command ) ||
+	     ( ! task->sent ) ||
+	     ( ntohl ( rsp->tag.dwords[1] ) != task->tag ) ) {
+		DBGC ( srp, "SRP %p RX SCSI response with unknown tag "
+		       "%08x%08x\n", srp, ntohl ( rsp->tag.dwords[0] ),
+		       ntohl ( rsp->tag.dwords[1] ) );
+		rc = 0;
+		goto out;
+	}
+
 	/* Report SCSI errors */
 	if ( rsp->status != 0 ) {
 		DBGC ( srp, "SRP %p response status %02x\n",
@@ -331,10 +429,13 @@ static int srp_rsp ( struct srp_device *srp, struct io_buffer *iobuf ) {
 			      ? "under" : "over" ),
 		       ntohl ( rsp->data_in_residual_count ) );
 	}
-	srp->command->status = rsp->status;
+	task->command->status = rsp->status;
 
 	/* Mark SCSI command as complete */
-	srp_scsi_done ( srp, 0 );
+	srp_scsi_done ( srp, task, 0 );
+
+	/* Send any commands that were waiting for request credit */
+	srp_send_pending ( srp );
 
 	rc = 0;
  out:
@@ -441,20 +542,27 @@ static int srp_command ( struct scsi_device *scsi,
 			 struct scsi_command *command ) {
 	struct srp_device *srp =
 		container_of ( scsi->backend, struct srp_device, refcnt );
-
-	/* Store SCSI command */
-	if ( srp->command ) {
-		DBGC ( srp, "SRP %p cannot handle concurrent SCSI commands\n",
-		       srp );
-		return -EBUSY;
+	struct srp_task *task;
+	unsigned int i;
+
+	/* Find a free command slot */
+	for ( i = 0 ; i < srp->max_outstanding ; i++ ) {
+		task = &srp->tasks[i];
+		if ( ! task->command )
+			break;
 	}
-	srp->command = command;
+	if ( i == srp->max_outstanding ) {
+		DBGC2 ( srp, "SRP %p command slots full\n", srp );
+		return BLOCKDEV_FULL;
+	}
+	task->command = command;
+	task->sent = 0;
 
 	/* Log in or issue command as appropriate */
 	if ( ! ( srp->state & SRP_STATE_SOCKET_OPEN ) ) {
 		srp_login ( srp );
 	} else if ( srp->state & SRP_STATE_LOGGED_IN ) {
-		srp_cmd ( srp );
+		srp_send_pending ( srp );
 	} else {
 		/* Still waiting for login; do nothing */
 	}
@@ -471,6 +579,7 @@ static int srp_command ( struct scsi_device *scsi,
 int srp_attach ( struct scsi_device *scsi, const char *root_path ) {
 	struct srp_transport_type *transport;
 	struct srp_device *srp;
+	unsigned long max_cmds;
 	int rc;
 
 	/* Hard-code an IB SRP back-end for now */
@@ -486,6 +595,16 @@ int srp_attach ( struct scsi_device *scsi, const char *root_path ) {
 	srp->transport = transport;
 	DBGC ( srp, "SRP %p using %s\n", srp, root_path );
 
+	/* Determine maximum number of outstanding commands */
+	if ( fetch_uint_setting ( NULL, &srp_max_cmds_setting,
+				  &max_cmds ) < 0 )
+		max_cmds = SRP_DEFAULT_MAX_OUTSTANDING;
+	if ( max_cmds < 1 )
+		max_cmds = 1;
+	if ( max_cmds > SRP_MAX_OUTSTANDING )
+		max_cmds = SRP_MAX_OUTSTANDING;
+	srp->max_outstanding = max_cmds;
+
 	/* Parse root path */
 	if ( ( rc = transport->parse_root_path ( srp, root_path ) ) != 0 ) {
 		DBGC ( srp, "SRP %p could not parse root path: %s\n",
@@ -514,10 +633,11 @@ void srp_detach ( struct scsi_device *scsi ) {
 	struct srp_device *srp =
 		container_of ( scsi->backend, struct srp_device, refcnt );
 
-	/* Close socket */
+	/* Close socket and fail any outstanding commands */
+	scsi->command = scsi_detached_command;
 	xfer_nullify ( &srp->socket );
 	xfer_close ( &srp->socket, 0 );
-	scsi->command = scsi_detached_command;
+	srp_scsi_fail_all ( srp, -ENODEV );
 	ref_put ( scsi->backend );
 	scsi->backend = NULL;
 }
@@ -0,0 +1,1096 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <byteswap.h>
+#include <gpxe/device.h>
+#include <gpxe/iobuf.h>
+#include <gpxe/timer.h>
+#include <gpxe/infiniband.h>
+#include <gpxe/ib_mad.h>
+
+/**
+ * @file
+ *
+ * Software loopback Infiniband device
+ *
+ * This emulates a two-port HCA entirely in memory.  Both ports are
+ * connected to an emulated switch, which also hosts a minimal subnet
+ * manager (which brings up each port via its subnet management
+ * agent) and a minimal subnet administrator (which answers path
+ * record and multicast member record queries).  Packets are copied
+ * directly from a send work queue entry to the destination's receive
+ * work queue entry, so the Infiniband core, the management
+ * interfaces, IPoIB and the connection manager can all be exercised
+ * and benchmarked without Infiniband hardware.
+ *
+ */
+
+/** Number of ports */
+#define IBLOOP_NUM_PORTS 2
+
+/** Subnet manager LID */
+#define IBLOOP_SM_LID 0x0001
+
+/** LID assigned to the first port */
+#define IBLOOP_PORT_LID_BASE 0x0002
+
+/** First multicast LID */
+#define IBLOOP_MCAST_LID_BASE 0xc000
+
+/** Number of multicast groups */
+#define IBLOOP_NUM_MCAST_GROUPS 8
+
+/** Queue key assigned to all multicast groups */
+#define IBLOOP_MCAST_QKEY 0x00000b1bUL
+
+/** First QPN assigned to non-management queue pairs */
+#define IBLOOP_QPN_BASE 0x100
+
+/** Subnet manager sweep interval */
+#define IBLOOP_SM_SWEEP_INTERVAL ( TICKS_PER_SEC / 4 )
+
+/** MAD response method flag */
+#define IBLOOP_MAD_METHOD_RESPONSE 0x80
+
+/** Subnet manager TID magic signature */
+#define IBLOOP_SM_TID_MAGIC \
+	( ( 'S' << 24 ) | ( 'M' << 16 ) | ( 'L' << 8 ) | 'B' )
+
+/** A loopback completion queue entry */
+struct ibloop_completion {
+	/** Queue pair number */
+	unsigned long qpn;
+	/** "Is a send completion" flag */
+	int is_send;
+	/** Work queue entry index */
+	unsigned int wqe_idx;
+	/** Received length (including GRH, if applicable) */
+	size_t len;
+	/** Source address vector (for received datagrams) */
+	struct ib_address_vector av;
+	/** Completion status code */
+	int rc;
+};
+
+/** A loopback completion queue */
+struct ibloop_completion_queue {
+	/** Producer index
+	 *
+	 * The consumer index is the completion queue's next_idx.
+	 */
+	unsigned long prod;
+	/** Completion queue entries */
+	struct ibloop_completion cqe[0];
+};
+
+/** A loopback queue pair */
+struct ibloop_queue_pair {
+	/** Index of next send work queue entry to be transmitted */
+	unsigned long send_idx;
+	/** Index of next receive work queue entry to be consumed */
+	unsigned long recv_idx;
+	/** Address vectors of posted send work queue entries */
+	struct ib_address_vector av[0];
+};
+
+/** A loopback multicast group */
+struct ibloop_mcast_group {
+	/** Multicast GID, or zero if unused */
+	struct ib_gid mgid;
+	/** Multicast LID */
+	unsigned int mlid;
+};
+
+/** A loopback HCA */
+struct ibloop {
+	/** Generic device */
+	struct device dev;
+	/** Infiniband devices */
+	struct ib_device *ibdev[IBLOOP_NUM_PORTS];
+	/** Time of last subnet manager sweep, per port */
+	unsigned long sm_sweep[IBLOOP_NUM_PORTS];
+	/** Subnet manager transaction ID */
+	unsigned long sm_tid;
+	/** Multicast groups */
+	struct ibloop_mcast_group groups[IBLOOP_NUM_MCAST_GROUPS];
+	/** Next completion queue number */
+	unsigned long next_cqn;
+	/** Next queue pair number */
+	unsigned long next_qpn;
+};
+
+/** The loopback HCA */
+static struct ibloop ibloop;
+
+/** GID prefix assigned by the subnet manager */
+static const uint8_t ibloop_gid_prefix[8] = {
+	0xfe, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+/***************************************************************************
+ *
+ * Emulated fabric
+ *
+ ***************************************************************************
+ */
+
+/**
+ * Find port by LID
+ *
+ * @v ibloop		Loopback HCA
+ * @v lid		LID
+ * @ret ibdev		Infiniband device, or NULL
+ */
+static struct ib_device * ibloop_find_lid ( struct ibloop *ibloop,
+					    unsigned int lid ) {
+	struct ib_device *ibdev;
+	unsigned int i;
+
+	for ( i = 0 ; i < IBLOOP_NUM_PORTS ; i++ ) {
+		ibdev = ibloop->ibdev[i];
+		if ( ibdev->open_count && ( ibdev->lid == lid ) )
+			return ibdev;
+	}
+	return NULL;
+}
+
+/**
+ * Find port by GID
+ *
+ * @v ibloop		Loopback HCA
+ * @v gid		GID
+ * @ret ibdev		Infiniband device, or NULL
+ */
+static struct ib_device * ibloop_find_gid ( struct ibloop *ibloop,
+					    struct ib_gid *gid ) {
+	struct ib_device *ibdev;
+	unsigned int i;
+
+	for ( i = 0 ; i < IBLOOP_NUM_PORTS ; i++ ) {
+		ibdev = ibloop->ibdev[i];
+		if ( ibdev->open_count &&
+		     ( memcmp ( &ibdev->gid, gid, sizeof ( *gid ) ) == 0 ) )
+			return ibdev;
+	}
+	return NULL;
+}
+
+/**
+ * Find multicast group
+ *
+ * @v ibloop		Loopback HCA
+ * @v mgid		Multicast GID, or NULL to search by LID
+ * @v mlid		Multicast LID (if not searching by GID)
+ * @v create		Create group if not found
+ * @ret group		Multicast group, or NULL
+ */
+static struct ibloop_mcast_group *
+ibloop_find_group ( struct ibloop *ibloop, struct ib_gid *mgid,
+		    unsigned int mlid, int create ) {
+	static struct ib_gid empty;
+	struct ibloop_mcast_group *group;
+	unsigned int i;
+
+	for ( i = 0 ; i < IBLOOP_NUM_MCAST_GROUPS ; i++ ) {
+		group = &ibloop->groups[i];
+		if ( memcmp ( &group->mgid, &empty,
+			      sizeof ( group->mgid ) ) == 0 ) {
+			if ( ! create )
+				break;
+			memcpy ( &group->mgid, mgid, sizeof ( group->mgid ) );
+			group->mlid = ( IBLOOP_MCAST_LID_BASE + i );
+			return group;
+		}
+		if ( mgid ? ( memcmp ( &group->mgid, mgid,
+				       sizeof ( group->mgid ) ) == 0 ) :
+		     ( group->mlid == mlid ) )
+			return group;
+	}
+	return NULL;
+}
+
+/**
+ * Check for space in completion queue
+ *
+ * @v cq		Completion queue
+ * @ret has_space	Completion queue has space for a further entry
+ */
+static int ibloop_cq_has_space ( struct ib_completion_queue *cq ) {
+	struct ibloop_completion_queue *ibloop_cq = ib_cq_get_drvdata ( cq );
+
+	return ( ( ibloop_cq->prod - cq->next_idx ) < cq->num_cqes );
+}
+
+/**
+ * Add completion queue entry
+ *
+ * @v cq		Completion queue
+ * @ret cqe		Completion queue entry
+ *
+ * The caller must already have checked that space is available.
+ */
+static struct ibloop_completion *
+ibloop_cq_add ( struct ib_completion_queue *cq ) {
+	struct ibloop_completion_queue *ibloop_cq = ib_cq_get_drvdata ( cq );
+	struct ibloop_completion *cqe;
+
+	assert ( ibloop_cq_has_space ( cq ) );
+	cqe = &ibloop_cq->cqe[ ibloop_cq->prod++ % cq->num_cqes ];
+	memset ( cqe, 0, sizeof ( *cqe ) );
+	return cqe;
+}
+
+/**
+ * Deliver packet to receive work queue
+ *
+ * @v ibdev		Destination Infiniband device
+ * @v qp		Destination queue pair
+ * @v src		Source address vector, as seen by the destination
+ * @v sgid		Source GID
+ * @v dgid		Destination GID
+ * @v data		Packet payload
+ * @v len		Length of packet payload
+ * @ret rc		Return status code
+ *
+ * Returns -ENOBUFS if the destination has no receive work queue
+ * entry (or completion queue entry) available.
+ */
+static int ibloop_deliver ( struct ib_device *ibdev,
+			    struct ib_queue_pair *qp,
+			    struct ib_address_vector *src,
+			    struct ib_gid *sgid, struct ib_gid *dgid,
+			    const void *data, size_t len ) {
+	struct ibloop *ibloop = ib_get_drvdata ( ibdev );
+	struct ibloop_queue_pair *ibloop_qp = ib_qp_get_drvdata ( qp );
+	struct ib_work_queue *wq = &qp->recv;
+	struct ibloop_completion *cqe;
+	struct ib_global_route_header *grh;
+	struct io_buffer *iobuf;
+	unsigned int wqe_idx;
+	size_t grh_len;
+
+	/* Check for an available receive work queue entry */
+	if ( ( ibloop_qp->recv_idx == wq->next_idx ) ||
+	     ( ! ibloop_cq_has_space ( wq->cq ) ) ) {
+		DBGC2 ( ibloop, "IBLOOP %p QPN %#lx RX overrun\n",
+			ibloop, qp->qpn );
+		return -ENOBUFS;
+	}
+	wqe_idx = ( ibloop_qp->recv_idx & ( wq->num_wqes - 1 ) );
+	iobuf = wq->iobufs[wqe_idx];
+	assert ( iobuf != NULL );
+
+	/* Datagram queue pairs receive a GRH before the payload */
+	grh_len = ( ( qp->type == IB_QPT_RC ) ? 0 : sizeof ( *grh ) );
+	if ( ( grh_len + len ) > iob_tailroom ( iobuf ) ) {
+		DBGC ( ibloop, "IBLOOP %p QPN %#lx RX packet too large "
+		       "(%zd bytes)\n", ibloop, qp->qpn, len );
+		return -EINVAL;
+	}
+
+	/* Copy in packet */
+	if ( grh_len ) {
+		grh = iobuf->data;
+		memset ( grh, 0, sizeof ( *grh ) );
+		grh->ipver__tclass__flowlabel =
+			htonl ( IB_GRH_IPVER_IPv6 << 28 );
+		grh->paylen = htons ( len );
+		grh->nxthdr = IB_GRH_NXTHDR_IBA;
+		grh->hoplmt = 0xff;
+		if ( sgid )
+			memcpy ( &grh->sgid, sgid, sizeof ( grh->sgid ) );
+		if ( dgid )
+			memcpy ( &grh->dgid, dgid, sizeof ( grh->dgid ) );
+	}
+	memcpy ( ( iobuf->data + grh_len ), data, len );
+
+	/* Generate completion */
+	cqe = ibloop_cq_add ( wq->cq );
+	cqe->qpn = qp->qpn;
+	cqe->wqe_idx = wqe_idx;
+	cqe->len = ( grh_len + len );
+	memcpy ( &cqe->av, src, sizeof ( cqe->av ) );
+	ibloop_qp->recv_idx++;
+
+	return 0;
+}
+
+/**
+ * Handle subnet administration request
+ *
+ * @v ibloop		Loopback HCA
+ * @v ibdev		Requesting Infiniband device
+ * @v mad		Request MAD, to be modified into the response
+ */
+static void ibloop_sa ( struct ibloop *ibloop, struct ib_device *ibdev,
+		       union ib_mad *mad ) {
+	struct ib_mad_sa *sa = &mad->sa;
+	struct ib_path_record *path_record = &sa->sa_data.path_record;
+	struct ib_mc_member_record *mc_member_record =
+		&sa->sa_data.mc_member_record;
+	struct ibloop_mcast_group *group;
+	struct ib_device *dest;
+	struct ib_gid gid;
+	unsigned int dlid;
+
+	switch ( ntohs ( sa->mad_hdr.attr_id ) ) {
+
+	case IB_SA_ATTR_PATH_REC:
+		if ( sa->mad_hdr.method != IB_MGMT_METHOD_GET )
+			break;
+		memcpy ( &gid, &path_record->dgid, sizeof ( gid ) );
+		if ( gid.u.bytes[0] == 0xff ) {
+			group = ibloop_find_group ( ibloop, &gid, 0, 0 );
+			dlid = ( group ? group->mlid : 0 );
+		} else {
+			dest = ibloop_find_gid ( ibloop, &gid );
+			dlid = ( dest ? dest->lid : 0 );
+		}
+		if ( ! dlid ) {
+			sa->mad_hdr.status =
+				htons ( IB_MGMT_STATUS_INVALID_VALUE );
+		} else {
+			path_record->dlid = htons ( dlid );
+			path_record->slid = htons ( ibdev->lid );
+			path_record->reserved__sl = 0;
+			path_record->mtu_selector__mtu = IB_MTU_2048;
+			path_record->rate_selector__rate = IB_RATE_40;
+		}
+		sa->mad_hdr.method = IB_MGMT_METHOD_GET_RESP;
+		return;
+
+	case IB_SA_ATTR_MC_MEMBER_REC:
+		if ( sa->mad_hdr.method == IB_MGMT_METHOD_DELETE ) {
+			/* Groups are never destroyed */
+			sa->mad_hdr.method = IB_SA_METHOD_DELETE_RESP;
+			return;
+		}
+		if ( sa->mad_hdr.method != IB_MGMT_METHOD_SET )
+			break;
+		memcpy ( &gid, &mc_member_record->mgid, sizeof ( gid ) );
+		group = ibloop_find_group ( ibloop, &gid, 0, 1 );
+		if ( ! group ) {
+			sa->mad_hdr.status =
+				htons ( IB_MGMT_STATUS_INVALID_VALUE );
+		} else {
+			mc_member_record->qkey = htonl ( IBLOOP_MCAST_QKEY );
+			mc_member_record->mlid = htons ( group->mlid );
+			mc_member_record->mtu_selector__mtu = IB_MTU_2048;
+			mc_member_record->pkey = htons ( ibdev->pkey );
+			mc_member_record->rate_selector__rate = IB_RATE_40;
+		}
+		sa->mad_hdr.method = IB_MGMT_METHOD_GET_RESP;
+		return;
+
+	default:
+		break;
+	}
+
+	DBGC ( ibloop, "IBLOOP %p SA unsupported method %02x attribute "
+	       "%04x\n", ibloop, sa->mad_hdr.method,
+	       ntohs ( sa->mad_hdr.attr_id ) );
+	sa->mad_hdr.status = htons ( IB_MGMT_STATUS_UNSUPPORTED_METHOD_ATTR );
+	sa->mad_hdr.method = IB_MGMT_METHOD_GET_RESP;
+}
+
+/**
+ * Receive packet at emulated subnet manager
+ *
+ * @v ibloop		Loopback HCA
+ * @v ibdev		Sending Infiniband device
+ * @v qp		Sending queue pair
+ * @v data		Packet payload
+ * @v len		Length of packet payload
+ *
+ * Responses from subnet management agents are discarded.  Requests
+ * to the subnet administrator are answered via the sending port's
+ * general services interface.
+ */
+static void ibloop_sm_rx ( struct ibloop *ibloop, struct ib_device *ibdev,
+			   struct ib_queue_pair *qp, const void *data,
+			   size_t len ) {
+	union ib_mad mad;
+	struct ib_queue_pair *gsi;
+	struct ib_address_vector src;
+
+	/* Ignore anything other than a request to the SA */
+	if ( ( qp->type != IB_QPT_GSI ) || ( len != sizeof ( mad ) ) )
+		return;
+	memcpy ( &mad, data, sizeof ( mad ) );
+	if ( ( mad.hdr.mgmt_class != IB_MGMT_CLASS_SUBN_ADM ) ||
+	     ( mad.hdr.method & IBLOOP_MAD_METHOD_RESPONSE ) )
+		return;
+
+	/* Construct response */
+	ibloop_sa ( ibloop, ibdev, &mad );
+
+	/* Send response.  Failures are ignored; the requester will
+	 * retry.
+	 */
+	gsi = ib_find_qp_qpn ( ibdev, IB_QPN_GSI );
+	if ( ! gsi )
+		return;
+	memset ( &src, 0, sizeof ( src ) );
+	src.qpn = IB_QPN_GSI;
+	src.lid = IBLOOP_SM_LID;
+	ibloop_deliver ( ibdev, gsi, &src, NULL, &ibdev->gid,
+			 &mad, sizeof ( mad ) );
+}
+
+/**
+ * Perform subnet manager sweep of port
+ *
+ * @v ibdev		Infiniband device
+ *
+ * Ports awaiting configuration are assigned a LID and brought to the
+ * ACTIVE state by sending a directed-route Set(PortInfo) to the
+ * port's subnet management agent.
+ */
+static void ibloop_sm_sweep ( struct ib_device *ibdev ) {
+	struct ibloop *ibloop = ib_get_drvdata ( ibdev );
+	unsigned long *sweep = &ibloop->sm_sweep[ ibdev->port - 1 ];
+	union ib_mad mad;
+	struct ib_mad_smp *smp = &mad.smp;
+	struct ib_port_info *port_info = &smp->smp_data.port_info;
+	struct ib_address_vector src;
+	struct ib_queue_pair *smi;
+
+	/* Do nothing unless port is awaiting configuration */
+	if ( ibdev->port_state != IB_PORT_STATE_INIT )
+		return;
+	if ( ( currticks() - *sweep ) < IBLOOP_SM_SWEEP_INTERVAL )
+		return;
+	*sweep = currticks();
+	smi = ib_find_qp_qpn ( ibdev, IB_QPN_SMI );
+	if ( ! smi )
+		return;
+
+	/* Construct Set(PortInfo) */
+	memset ( &mad, 0, sizeof ( mad ) );
+	smp->mad_hdr.base_version = IB_MGMT_BASE_VERSION;
+	smp->mad_hdr.mgmt_class = IB_MGMT_CLASS_SUBN_DIRECTED_ROUTE;
+	smp->mad_hdr.class_version = IB_SMP_CLASS_VERSION;
+	smp->mad_hdr.method = IB_MGMT_METHOD_SET;
+	smp->mad_hdr.tid[0] = htonl ( IBLOOP_SM_TID_MAGIC );
+	smp->mad_hdr.tid[1] = htonl ( ++ibloop->sm_tid );
+	smp->mad_hdr.attr_id = htons ( IB_SMP_ATTR_PORT_INFO );
+	smp->mad_hdr.class_specific.smp.hop_pointer = 1;
+	smp->mad_hdr.class_specific.smp.hop_count = 1;
+	smp->initial_path.hops[1] = ibdev->port;
+	memcpy ( port_info->gid_prefix, ibloop_gid_prefix,
+		 sizeof ( port_info->gid_prefix ) );
+	port_info->lid = htons ( IBLOOP_PORT_LID_BASE + ibdev->port - 1 );
+	port_info->mastersm_lid = htons ( IBLOOP_SM_LID );
+	port_info->link_width_enabled = IB_LINK_WIDTH_4X;
+	port_info->link_speed_supported__port_state = IB_PORT_STATE_ACTIVE;
+	port_info->link_speed_active__link_speed_enabled = IB_LINK_SPEED_QDR;
+	port_info->neighbour_mtu__mastersm_sl = ( IB_MTU_2048 << 4 );
+
+	/* Send to subnet management agent */
+	memset ( &src, 0, sizeof ( src ) );
+	src.qpn = IB_QPN_SMI;
+	src.lid = IB_LID_NONE;
+	DBGC ( ibloop, "IBLOOP %p SM configuring port %d\n",
+	       ibloop, ibdev->port );
+	ibloop_deliver ( ibdev, smi, &src, NULL, NULL, &mad, sizeof ( mad ) );
+}
+
+/**
+ * Transmit packet
+ *
+ * @v ibdev		Infiniband device
+ * @v qp		Queue pair
+ * @v av		Address vector
+ * @v iobuf		I/O buffer
+ * @ret rc		Return status code
+ *
+ * Returns -ENOBUFS if the packet should be retried later.
+ * Undeliverable datagrams are silently discarded, as they would be by
+ * a real fabric.
+ */
+static int ibloop_transmit_one ( struct ib_device *ibdev,
+				 struct ib_queue_pair *qp,
+				 struct ib_address_vector *av,
+				 struct io_buffer *iobuf ) {
+	struct ibloop *ibloop = ib_get_drvdata ( ibdev );
+	struct ibloop_mcast_group *group;
+	struct ib_address_vector src;
+	struct ib_multicast_gid *mgid;
+	struct ib_device *dest;
+	struct ib_queue_pair *dest_qp;
+	unsigned int i;
+	int rc;
+
+	/* Construct source address vector as seen by destination */
+	memset ( &src, 0, sizeof ( src ) );
+	src.qpn = qp->ext_qpn;
+	src.lid = ibdev->lid;
+	src.sl = av->sl;
+	src.gid_present = av->gid_present;
+	memcpy ( &src.gid, &ibdev->gid, sizeof ( src.gid ) );
+
+	/* Packets for the subnet manager */
+	if ( ( av->lid == IBLOOP_SM_LID ) ||
+	     ( ( qp->type == IB_QPT_SMI ) && ( av->lid == IB_LID_NONE ) ) ) {
+		ibloop_sm_rx ( ibloop, ibdev, qp, iobuf->data,
+			       iob_len ( iobuf ) );
+		return 0;
+	}
+
+	/* Multicast packets */
+	if ( IB_LID_MULTICAST ( av->lid ) ) {
+		group = ibloop_find_group ( ibloop, NULL, av->lid, 0 );
+		if ( ! group )
+			return 0;
+		for ( i = 0 ; i < IBLOOP_NUM_PORTS ; i++ ) {
+			dest = ibloop->ibdev[i];
+			if ( ! ib_link_ok ( dest ) )
+				continue;
+			list_for_each_entry ( dest_qp, &dest->qps, list ) {
+				if ( dest_qp == qp )
+					continue;
+				list_for_each_entry ( mgid, &dest_qp->mgids,
+						      list ) {
+					if ( memcmp ( &mgid->gid, &group->mgid,
+						      sizeof ( mgid->gid ) ) )
+						continue;
+					ibloop_deliver ( dest, dest_qp, &src,
+							 &ibdev->gid,
+							 &group->mgid,
+							 iobuf->data,
+							 iob_len ( iobuf ) );
+					break;
+				}
+			}
+		}
+		return 0;
+	}
+
+	/* Unicast packets */
+	dest = ibloop_find_lid ( ibloop, av->lid );
+	dest_qp = ( dest ? ib_find_qp_qpn ( dest, av->qpn ) : NULL );
+	if ( ! dest_qp ) {
+		DBGC2 ( ibloop, "IBLOOP %p QPN %#lx no destination %04x:%lx\n",
+			ibloop, qp->qpn, av->lid, av->qpn );
+		return ( ( qp->type == IB_QPT_RC ) ? -EHOSTUNREACH : 0 );
+	}
+	if ( ( dest_qp->type == IB_QPT_UD ) && ( av->qkey != dest_qp->qkey ) ) {
+		DBGC2 ( ibloop, "IBLOOP %p QPN %#lx bad qkey %lx for QPN "
+			"%#lx\n", ibloop, qp->qpn, av->qkey, dest_qp->qpn );
+		return 0;
+	}
+	rc = ibloop_deliver ( dest, dest_qp, &src, &ibdev->gid, &dest->gid,
+			      iobuf->data, iob_len ( iobuf ) );
+	if ( qp->type != IB_QPT_RC )
+		return 0;
+	return rc;
+}
+
+/**
+ * Transmit pending packets
+ *
+ * @v ibdev		Infiniband device
+ *
+ * Reliable connected queue pairs whose destination has no receive
+ * work queue entry available are stalled until one is posted, as with
+ * an RNR retry on a real fabric.
+ */
+static void ibloop_transmit ( struct ib_device *ibdev ) {
+	struct ib_queue_pair *qp;
+	struct ibloop_queue_pair *ibloop_qp;
+	struct ib_work_queue *wq;
+	struct ibloop_completion *cqe;
+	unsigned int wqe_idx;
+	int rc;
+
+	list_for_each_entry ( qp, &ibdev->qps, list ) {
+		ibloop_qp = ib_qp_get_drvdata ( qp );
+		wq = &qp->send;
+		while ( ( ibloop_qp->send_idx != wq->next_idx ) &&
+			ibloop_cq_has_space ( wq->cq ) ) {
+			wqe_idx = ( ibloop_qp->send_idx &
+				    ( wq->num_wqes - 1 ) );
+			rc = ibloop_transmit_one ( ibdev, qp,
+						   &ibloop_qp->av[wqe_idx],
+						   wq->iobufs[wqe_idx] );
+			if ( rc == -ENOBUFS )
+				break;
+			cqe = ibloop_cq_add ( wq->cq );
+			cqe->qpn = qp->qpn;
+			cqe->is_send = 1;
+			cqe->wqe_idx = wqe_idx;
+			cqe->rc = rc;
+			ibloop_qp->send_idx++;
+		}
+	}
+}
+
+/***************************************************************************
+ *
+ * Infiniband device operations
+ *
+ ***************************************************************************
+ */
+
+/**
+ * Create completion queue
+ *
+ * @v ibdev		Infiniband device
+ * @v cq		Completion queue
+ * @ret rc		Return status code
+ */
+static int ibloop_create_cq ( struct ib_device *ibdev,
+			      struct ib_completion_queue *cq ) {
+	struct ibloop *ibloop = ib_get_drvdata ( ibdev );
+	struct ibloop_completion_queue *ibloop_cq;
+
+	ibloop_cq = zalloc ( sizeof ( *ibloop_cq ) +
+			     ( cq->num_cqes * sizeof ( ibloop_cq->cqe[0] ) ) );
+	if ( ! ibloop_cq )
+		return -ENOMEM;
+	cq->cqn = ibloop->next_cqn++;
+	ib_cq_set_drvdata ( cq, ibloop_cq );
+	return 0;
+}
+
+/**
+ * Destroy completion queue
+ *
+ * @v ibdev		Infiniband device
+ * @v cq		Completion queue
+ */
+static void ibloop_destroy_cq ( struct ib_device *ibdev __unused,
+				struct ib_completion_queue *cq ) {
+	struct ibloop_completion_queue *ibloop_cq = ib_cq_get_drvdata ( cq );
+
+	free ( ibloop_cq );
+	ib_cq_set_drvdata ( cq, NULL );
+}
+
+/**
+ * Create queue pair
+ *
+ * @v ibdev		Infiniband device
+ * @v qp		Queue pair
+ * @ret rc		Return status code
+ */
+static int ibloop_create_qp ( struct ib_device *ibdev,
+			      struct ib_queue_pair *qp ) {
+	struct ibloop *ibloop = ib_get_drvdata ( ibdev );
+	struct ibloop_queue_pair *ibloop_qp;
+
+	/* Work queue sizes must be powers of two */
+	if ( ( qp->send.num_wqes & ( qp->send.num_wqes - 1 ) ) ||
+	     ( qp->recv.num_wqes & ( qp->recv.num_wqes - 1 ) ) ) {
+		DBGC ( ibloop, "IBLOOP %p invalid queue sizes %d/%d\n",
+		       ibloop, qp->send.num_wqes, qp->recv.num_wqes );
+		return -EINVAL;
+	}
+
+	ibloop_qp = zalloc ( sizeof ( *ibloop_qp ) +
+			     ( qp->send.num_wqes * sizeof ( ibloop_qp->av[0] )));
+	if ( ! ibloop_qp )
+		return -ENOMEM;
+
+	switch ( qp->type ) {
+	case IB_QPT_SMI:
+		qp->qpn = IB_QPN_SMI;
+		break;
+	case IB_QPT_GSI:
+		qp->qpn = IB_QPN_GSI;
+		break;
+	default:
+		qp->qpn = ibloop->next_qpn++;
+		break;
+	}
+	ib_qp_set_drvdata ( qp, ibloop_qp );
+	return 0;
+}
+
+/**
+ * Modify queue pair
+ *
+ * @v ibdev		Infiniband device
+ * @v qp		Queue pair
+ * @ret rc		Return status code
+ */
+static int ibloop_modify_qp ( struct ib_device *ibdev __unused,
+			      struct ib_queue_pair *qp __unused ) {
+	/* Queue key and address vector are read directly from qp */
+	return 0;
+}
+
+/**
+ * Destroy queue pair
+ *
+ * @v ibdev		Infiniband device
+ * @v qp		Queue pair
+ */
+static void ibloop_destroy_qp ( struct ib_device *ibdev __unused,
+				struct ib_queue_pair *qp ) {
+	struct ibloop_queue_pair *ibloop_qp = ib_qp_get_drvdata ( qp );
+
+	/* Any completions still queued for this queue pair will be
+	 * ignored when polled, since the work queue will no longer
+	 * exist.  Outstanding I/O buffers are completed by the core.
+	 */
+	free ( ibloop_qp );
+	ib_qp_set_drvdata ( qp, NULL );
+}
+
+/**
+ * Post send work queue entry
+ *
+ * @v ibdev		Infiniband device
+ * @v qp		Queue pair
+ * @v av		Address vector
+ * @v iobuf		I/O buffer
+ * @ret rc		Return status code
+ */
+static int ibloop_post_send ( struct ib_device *ibdev __unused,
+			      struct ib_queue_pair *qp,
+			      struct ib_address_vector *av,
+			      struct io_buffer *iobuf ) {
+	struct ibloop_queue_pair *ibloop_qp = ib_qp_get_drvdata ( qp );
+	struct ib_work_queue *wq = &qp->send;
+	unsigned int wqe_idx;
+
+	/* Packets are transmitted when the event queue is polled */
+	wqe_idx = ( wq->next_idx & ( wq->num_wqes - 1 ) );
+	assert ( wq->iobufs[wqe_idx] == NULL );
+	wq->iobufs[wqe_idx] = iobuf;
+	memcpy ( &ibloop_qp->av[wqe_idx], av, sizeof ( ibloop_qp->av[0] ) );
+	wq->next_idx++;
+	return 0;
+}
+
+/**
+ * Post receive work queue entry
+ *
+ * @v ibdev		Infiniband device
+ * @v qp		Queue pair
+ * @v iobuf		I/O buffer
+ * @ret rc		Return status code
+ */
+static int ibloop_post_recv ( struct ib_device *ibdev __unused,
+			      struct ib_queue_pair *qp,
+			      struct io_buffer *iobuf ) {
+	struct ib_work_queue *wq = &qp->recv;
+	unsigned int wqe_idx;
+
+	wqe_idx = ( wq->next_idx & ( wq->num_wqes - 1 ) );
+	assert ( wq->iobufs[wqe_idx] == NULL );
+	wq->iobufs[wqe_idx] = iobuf;
+	wq->next_idx++;
+	return 0;
+}
+
+/**
+ * Poll completion queue
+ *
+ * @v ibdev		Infiniband device
+ * @v cq		Completion queue
+ */
+static void ibloop_poll_cq ( struct ib_device *ibdev,
+			     struct ib_completion_queue *cq ) {
+	struct ibloop *ibloop = ib_get_drvdata ( ibdev );
+	struct ibloop_completion_queue *ibloop_cq = ib_cq_get_drvdata ( cq );
+	struct ibloop_completion *cqe;
+	struct ib_address_vector recv_av;
+	struct ib_address_vector *av;
+	struct ib_work_queue *wq;
+	struct ib_queue_pair *qp;
+	struct io_buffer *iobuf;
+	size_t grh_len;
+
+	while ( cq->next_idx != ibloop_cq->prod ) {
+		cqe = &ibloop_cq->cqe[ cq->next_idx++ % cq->num_cqes ];
+
+		/* Identify work queue and I/O buffer */
+		wq = ib_find_wq ( cq, cqe->qpn, cqe->is_send );
+		if ( ! wq ) {
+			DBGC ( ibloop, "IBLOOP %p CQN %#lx unknown %s QPN "
+			       "%#lx\n", ibloop, cq->cqn,
+			       ( cqe->is_send ? "send" : "recv" ), cqe->qpn );
+			continue;
+		}
+		qp = wq->qp;
+		iobuf = wq->iobufs[cqe->wqe_idx];
+		assert ( iobuf != NULL );
+		wq->iobufs[cqe->wqe_idx] = NULL;
+
+		if ( cqe->is_send ) {
+			/* Hand off to completion handler */
+			ib_complete_send ( ibdev, qp, iobuf, cqe->rc );
+		} else {
+			/* Set received length and strip GRH */
+			iob_put ( iobuf, cqe->len );
+			if ( qp->type == IB_QPT_RC ) {
+				av = &qp->av;
+			} else {
+				grh_len = sizeof ( struct ib_global_route_header );
+				iob_pull ( iobuf, grh_len );
+				memcpy ( &recv_av, &cqe->av, sizeof ( recv_av ) );
+				av = &recv_av;
+			}
+			/* Hand off to completion handler */
+			ib_complete_recv ( ibdev, qp, av, iobuf, cqe->rc );
+		}
+	}
+}
+
+/**
+ * Poll event queue
+ *
+ * @v ibdev		Infiniband device
+ *
+ * The emulated fabric does its work here: the subnet manager sweeps
+ * the port and any posted send work queue entries are transmitted.
+ */
+static void ibloop_poll_eq ( struct ib_device *ibdev ) {
+
+	if ( ! ibdev->open_count )
+		return;
+	ibloop_sm_sweep ( ibdev );
+	ibloop_transmit ( ibdev );
+}
+
+/**
+ * Open port
+ *
+ * @v ibdev		Infiniband device
+ * @ret rc		Return status code
+ */
+static int ibloop_open ( struct ib_device *ibdev ) {
+	struct ibloop *ibloop = ib_get_drvdata ( ibdev );
+
+	/* Link comes up immediately; wait for subnet manager */
+	ibloop->sm_sweep[ ibdev->port - 1 ] =
+		( currticks() - IBLOOP_SM_SWEEP_INTERVAL );
+	ibdev->port_state = IB_PORT_STATE_INIT;
+	ibdev->link_width_active = IB_LINK_WIDTH_4X;
+	ibdev->link_speed_active = IB_LINK_SPEED_QDR;
+	ib_link_state_changed ( ibdev );
+	return 0;
+}
+
+/**
+ * Close port
+ *
+ * @v ibdev		Infiniband device
+ */
+static void ibloop_close ( struct ib_device *ibdev ) {
+
+	ibdev->port_state = IB_PORT_STATE_DOWN;
+	ibdev->lid = IB_LID_NONE;
+}
+
+/**
+ * Attach to multicast group
+ *
+ * @v ibdev		Infiniband device
+ * @v qp		Queue pair
+ * @v gid		Multicast GID
+ * @ret rc		Return status code
+ */
+static int ibloop_mcast_attach ( struct ib_device *ibdev __unused,
+				 struct ib_queue_pair *qp __unused,
+				 struct ib_gid *gid __unused ) {
+	/* Delivery uses the queue pair's multicast GID list */
+	return 0;
+}
+
+/**
+ * Detach from multicast group
+ *
+ * @v ibdev		Infiniband device
+ * @v qp		Queue pair
+ * @v gid		Multicast GID
+ */
+static void ibloop_mcast_detach ( struct ib_device *ibdev __unused,
+				  struct ib_queue_pair *qp __unused,
+				  struct ib_gid *gid __unused ) {
+	/* Nothing to do */
+}
+
+/**
+ * Set port information
+ *
+ * @v ibdev		Infiniband device
+ * @v mad		Set port information MAD
+ * @ret rc		Return status code
+ */
+static int ibloop_set_port_info ( struct ib_device *ibdev,
+				  union ib_mad *mad ) {
+	struct ibloop *ibloop = ib_get_drvdata ( ibdev );
+	struct ib_port_info *port_info = &mad->smp.smp_data.port_info;
+	unsigned int port_state;
+
+	/* Set new port state */
+	port_state = ( port_info->link_speed_supported__port_state & 0xf );
+	if ( port_state ) {
+		DBGC ( ibloop, "IBLOOP %p port %d state %d LID %04x\n",
+		       ibloop, ibdev->port, port_state, ibdev->lid );
+		ibdev->port_state = port_state;
+	}
+
+	/* Notify Infiniband core of link state change */
+	ib_link_state_changed ( ibdev );
+
+	return 0;
+}
+
+/**
+ * Set partition key table
+ *
+ * @v ibdev		Infiniband device
+ * @v mad		Set partition key table MAD
+ * @ret rc		Return status code
+ */
+static int ibloop_set_pkey_table ( struct ib_device *ibdev __unused,
+				   union ib_mad *mad __unused ) {
+	/* Nothing to do */
+	return 0;
+}
+
+/** Loopback Infiniband operations */
+static struct ib_device_operations ibloop_ib_operations = {
+	.create_cq	= ibloop_create_cq,
+	.destroy_cq	= ibloop_destroy_cq,
+	.create_qp	= ibloop_create_qp,
+	.modify_qp	= ibloop_modify_qp,
+	.destroy_qp	= ibloop_destroy_qp,
+	.post_send	= ibloop_post_send,
+	.post_recv	= ibloop_post_recv,
+	.poll_cq	= ibloop_poll_cq,
+	.poll_eq	= ibloop_poll_eq,
+	.open		= ibloop_open,
+	.close		= ibloop_close,
+	.mcast_attach	= ibloop_mcast_attach,
+	.mcast_detach	= ibloop_mcast_detach,
+	.set_port_info	= ibloop_set_port_info,
+	.set_pkey_table	= ibloop_set_pkey_table,
+};
+
+/***************************************************************************
+ *
+ * Root device
+ *
+ ***************************************************************************
+ */
+
+/**
+ * Probe loopback HCA
+ *
+ * @v rootdev		Root device
+ * @ret rc		Return status code
+ */
+static int ibloop_probe ( struct root_device *rootdev ) {
+	struct ib_device *ibdev;
+	unsigned int i;
+	int rc;
+
+	/* Add to device hierarchy */
+	memset ( &ibloop, 0, sizeof ( ibloop ) );
+	strncpy ( ibloop.dev.name, "ibloop", ( sizeof ( ibloop.dev.name ) - 1 ));
+	ibloop.dev.parent = &rootdev->dev;
+	list_add ( &ibloop.dev.siblings, &rootdev->dev.children );
+	INIT_LIST_HEAD ( &ibloop.dev.children );
+	ibloop.next_cqn = 1;
+	ibloop.next_qpn = IBLOOP_QPN_BASE;
+
+	/* Allocate Infiniband devices */
+	for ( i = 0 ; i < IBLOOP_NUM_PORTS ; i++ ) {
+		ibdev = alloc_ibdev ( 0 );
+		if ( ! ibdev ) {
+			rc = -ENOMEM;
+			goto err_alloc_ibdev;
+		}
+		ibloop.ibdev[i] = ibdev;
+		ibdev->op = &ibloop_ib_operations;
+		ibdev->dev = &ibloop.dev;
+		ibdev->port = ( i + 1 );
+		ibdev->link_width_supported = IB_LINK_WIDTH_4X;
+		ibdev->link_width_enabled = IB_LINK_WIDTH_4X;
+		ibdev->link_speed_supported = IB_LINK_SPEED_QDR;
+		ibdev->link_speed_enabled = IB_LINK_SPEED_QDR;
+		ibdev->gid.u.bytes[8] = 0x02;
+		ibdev->gid.u.bytes[10] = 'g';
+		ibdev->gid.u.bytes[11] = 'P';
+		ibdev->gid.u.bytes[12] = 'X';
+		ibdev->gid.u.bytes[13] = 'E';
+		ibdev->gid.u.bytes[15] = ibdev->port;
+		ib_set_drvdata ( ibdev, &ibloop );
+	}
+
+	/* Register Infiniband devices */
+	for ( i = 0 ; i < IBLOOP_NUM_PORTS ; i++ ) {
+		if ( ( rc = register_ibdev ( ibloop.ibdev[i] ) ) != 0 ) {
+			DBGC ( &ibloop, "IBLOOP %p could not register IB "
+			       "device: %s\n", &ibloop, strerror ( rc ) );
+			goto err_register_ibdev;
+		}
+	}
+
+	return 0;
+
+	i = IBLOOP_NUM_PORTS;
+ err_register_ibdev:
+	for ( i-- ; ( signed int ) i >= 0 ; i-- )
+		unregister_ibdev ( ibloop.ibdev[i] );
+	i = IBLOOP_NUM_PORTS;
+ err_alloc_ibdev:
+	for ( i-- ; ( signed int ) i >= 0 ; i-- )
+		ibdev_put ( ibloop.ibdev[i] );
+	list_del ( &ibloop.dev.siblings );
+	return rc;
+}
+
+/**
+ * Remove loopback HCA
+ *
+ * @v rootdev		Root device
+ */
+static void ibloop_remove ( struct root_device *rootdev __unused ) {
+	int i;
+
+	for ( i = ( IBLOOP_NUM_PORTS - 1 ) ; i >= 0 ; i-- )
+		unregister_ibdev ( ibloop.ibdev[i] );
+	for ( i = ( IBLOOP_NUM_PORTS - 1 ) ; i >= 0 ; i-- )
+		ibdev_put ( ibloop.ibdev[i] );
+	list_del ( &ibloop.dev.siblings );
+}
+
+/** Loopback HCA root device driver */
+static struct root_driver ibloop_root_driver = {
+	.probe = ibloop_probe,
+	.remove = ibloop_remove,
+};
+
+/** Loopback HCA root device */
+struct root_device ibloop_root_device __root_device = {
+	.dev = { .name = "ibloop" },
+	.driver = &ibloop_root_driver,
+};
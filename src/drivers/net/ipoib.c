@@ -22,6 +22,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
+#include <stdlib.h>
 #include <byteswap.h>
 #include <errno.h>
 #include <gpxe/errortab.h>
@@ -31,21 +32,34 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <gpxe/infiniband.h>
 #include <gpxe/ib_pathrec.h>
 #include <gpxe/ib_mcast.h>
+#include <gpxe/ib_cm.h>
 #include <gpxe/ipoib.h>
+#include <config/general.h>
 
 /** @file
  *
  * IP over Infiniband
  */
 
-/** Number of IPoIB send work queue entries */
-#define IPOIB_NUM_SEND_WQES 2
+/** Number of IPoIB completion entries */
+#define IPOIB_NUM_CQES ( IPOIB_NUM_SEND_WQES + IPOIB_NUM_RECV_WQES )
 
-/** Number of IPoIB receive work queue entries */
-#define IPOIB_NUM_RECV_WQES 4
+/** IPoIB connected mode is enabled */
+#ifdef IPOIB_CONNECTED_MODE
+#define IPOIB_CM 1
+#else
+#define IPOIB_CM 0
+#endif
 
-/** Number of IPoIB completion entries */
-#define IPOIB_NUM_CQES 8
+/** IPoIB connected mode service ID base
+ *
+ * Defined in RFC 4755.  The receiver's datagram-mode QPN forms the
+ * low 24 bits of the service ID.
+ */
+#define IPOIB_CM_SERVICE_ID 0x01000000UL
+
+/** IPoIB connected mode receive buffer length */
+#define IPOIB_CM_RECV_LEN ( IPOIB_HLEN + IPOIB_CM_MTU )
 
 /** An IPoIB device */
 struct ipoib_device {
@@ -67,6 +81,59 @@ struct ipoib_device {
 	int broadcast_joined;
 	/** IPv4 broadcast multicast group membership */
 	struct ib_mc_membership broadcast_membership;
+
+	/** Connected mode completion queue */
+	struct ib_completion_queue *cm_cq;
+	/** Connected mode listener */
+	struct ib_listener *cm_listener;
+	/** Connected mode transmit connections */
+	struct list_head cm_tx;
+	/** Connected mode receive connections */
+	struct list_head cm_rx;
+	/** Connected mode completion queue entries in use */
+	unsigned int cm_cqes;
+};
+
+/** IPoIB connected mode connection request and reply private data
+ *
+ * Defined in RFC 4755.
+ */
+struct ipoib_cm_data {
+	/** Datagram-mode QPN */
+	uint32_t qpn;
+	/** Receive MTU (including the IPoIB header) */
+	uint32_t mtu;
+} __attribute__ (( packed ));
+
+/** An IPoIB connected mode connection
+ *
+ * Each connection carries traffic in one direction only: we open a
+ * transmit connection to each peer that we send to, and each peer
+ * that sends to us opens a receive connection to our listener.
+ */
+struct ipoib_cm {
+	/** IPoIB device */
+	struct ipoib_device *ipoib;
+	/** List of connections */
+	struct list_head list;
+	/** Peer MAC address */
+	struct ipoib_mac mac;
+	/** Queue pair */
+	struct ib_queue_pair *qp;
+	/** Infiniband connection */
+	struct ib_connection *conn;
+	/** Number of connected mode completion queue entries used */
+	unsigned int cqes;
+	/** Maximum packet length accepted by peer */
+	size_t mtu;
+	/** Connection status
+	 *
+	 * This is -EINPROGRESS until a transmit connection has been
+	 * established.  Transmit connections that fail are retained
+	 * with a non-zero status, so that traffic to the peer stays
+	 * in datagram mode.
+	 */
+	int rc;
 };
 
 /** Broadcast IPoIB address */
@@ -100,25 +167,52 @@ struct errortab ipoib_errors[] __errortab = {
  * and abuse the spare two bytes within the link-layer header to
  * communicate these MAC addresses between the link-layer code and the
  * netdevice driver.
+ *
+ * The cache is a hash table indexed by MAC address.  Each entry's key
+ * is one more than its index within the table, so that looking up a
+ * peer by key needs no search.
  */
 struct ipoib_peer {
-	/** Key */
+	/** Key, or zero if the entry is unused */
 	uint8_t key;
 	/** MAC address */
 	struct ipoib_mac mac;
+	/** Time of last use */
+	unsigned long used;
 };
 
 /** Number of IPoIB peer cache entries
  *
- * Must be a power of two.
+ * Must be a power of two, and no greater than 255 (the highest
+ * available key).
  */
-#define IPOIB_NUM_CACHED_PEERS 4
+#define IPOIB_NUM_CACHED_PEERS 64
+
+/** Number of IPoIB peer cache entries examined for each MAC address */
+#define IPOIB_PEER_PROBES 8
 
 /** IPoIB peer address cache */
 static struct ipoib_peer ipoib_peer_cache[IPOIB_NUM_CACHED_PEERS];
 
-/** Oldest IPoIB peer cache entry index */
-static unsigned int ipoib_peer_cache_idx = 1;
+/** IPoIB peer cache usage counter */
+static unsigned long ipoib_peer_cache_clock;
+
+/**
+ * Calculate peer cache hash of MAC address
+ *
+ * @v mac		Peer MAC address
+ * @ret hash		Index of first peer cache entry to examine
+ */
+static unsigned int ipoib_peer_hash ( const struct ipoib_mac *mac ) {
+	const uint8_t *bytes = ( ( const uint8_t * ) mac );
+	unsigned int hash = 0;
+	unsigned int i;
+
+	for ( i = 0 ; i < sizeof ( *mac ) ; i++ )
+		hash = ( ( hash * 31 ) + bytes[i] );
+	return ( ( hash ^ ( hash >> 16 ) ) &
+		 ( IPOIB_NUM_CACHED_PEERS - 1 ) );
+}
 
 /**
  * Look up cached peer by key
@@ -128,10 +222,9 @@ static unsigned int ipoib_peer_cache_idx = 1;
  */
 static struct ipoib_peer * ipoib_lookup_peer_by_key ( unsigned int key ) {
 	struct ipoib_peer *peer;
-	unsigned int i;
 
-	for ( i = 0 ; i < IPOIB_NUM_CACHED_PEERS ; i++ ) {
-		peer = &ipoib_peer_cache[i];
+	if ( ( key != 0 ) && ( key <= IPOIB_NUM_CACHED_PEERS ) ) {
+		peer = &ipoib_peer_cache[ key - 1 ];
 		if ( peer->key == key )
 			return peer;
 	}
@@ -148,28 +241,38 @@ static struct ipoib_peer * ipoib_lookup_peer_by_key ( unsigned int key ) {
  *
  * @v mac		Peer MAC address
  * @ret peer		Peer cache entry
+ *
+ * If the MAC address is not already cached, it replaces the least
+ * recently used of the entries that it may occupy.
  */
 static struct ipoib_peer * ipoib_cache_peer ( const struct ipoib_mac *mac ) {
+	struct ipoib_peer *victim = NULL;
 	struct ipoib_peer *peer;
-	unsigned int key;
+	unsigned int hash = ipoib_peer_hash ( mac );
 	unsigned int i;
 
 	/* Look for existing cache entry */
-	for ( i = 0 ; i < IPOIB_NUM_CACHED_PEERS ; i++ ) {
-		peer = &ipoib_peer_cache[i];
-		if ( memcmp ( &peer->mac, mac, sizeof ( peer->mac ) ) == 0 )
+	for ( i = 0 ; i < IPOIB_PEER_PROBES ; i++ ) {
+		peer = &ipoib_peer_cache[ ( hash + i ) &
+					  ( IPOIB_NUM_CACHED_PEERS - 1 ) ];
+		if ( peer->key &&
+		     ( memcmp ( &peer->mac, mac, sizeof ( peer->mac ) ) == 0 )){
+			peer->used = ++ipoib_peer_cache_clock;
 			return peer;
+		}
+		if ( ( ! victim ) || ( peer->used < victim->used ) )
+			victim = peer;
 	}
 
-	/* No entry found: create a new one */
-	key = ipoib_peer_cache_idx++;
-	peer = &ipoib_peer_cache[ key % IPOIB_NUM_CACHED_PEERS ];
+	/* No entry found: replace the least recently used entry */
+	peer = victim;
 	if ( peer->key )
 		DBG ( "IPoIB peer %x evicted from cache\n", peer->key );
 
 	memset ( peer, 0, sizeof ( *peer ) );
-	peer->key = key;
+	peer->key = ( ( peer - ipoib_peer_cache ) + 1 );
 	memcpy ( &peer->mac, mac, sizeof ( peer->mac ) );
+	peer->used = ++ipoib_peer_cache_clock;
 	DBG ( "IPoIB peer %x has MAC %s\n",
 	      peer->key, ipoib_ntoa ( &peer->mac ) );
 	return peer;
@@ -345,10 +448,13 @@ static struct ipoib_eth_addr_handler ipoib_eth_addr_handlers[] = {
  */
 static int ipoib_eth_addr ( const void *ll_addr, void *eth_addr ) {
 	const struct ipoib_mac *ipoib_addr = ll_addr;
-	const struct ib_gid_half *guid = &ipoib_addr->gid.u.half[1];
+	struct ib_gid_half guid_copy;
+	const struct ib_gid_half *guid = &guid_copy;
 	struct ipoib_eth_addr_handler *handler;
 	unsigned int i;
 
+	memcpy ( &guid_copy, &ipoib_addr->gid.u.half[1], sizeof ( guid_copy ) );
+
 	for ( i = 0 ; i < ( sizeof ( ipoib_eth_addr_handlers ) /
 			    sizeof ( ipoib_eth_addr_handlers[0] ) ) ; i++ ) {
 		handler = &ipoib_eth_addr_handlers[i];
@@ -389,10 +495,446 @@ struct net_device * alloc_ipoibdev ( size_t priv_size ) {
 		netdev->ll_protocol = &ipoib_protocol;
 		netdev->ll_broadcast = ( uint8_t * ) &ipoib_broadcast;
 		netdev->max_pkt_len = IB_MAX_PAYLOAD_SIZE;
+		netdev->mtu = ( IB_MAX_PAYLOAD_SIZE - IPOIB_HLEN );
 	}
 	return netdev;
 }
 
+/****************************************************************************
+ *
+ * IPoIB connected mode
+ *
+ ****************************************************************************
+ */
+
+/**
+ * Construct IPoIB connected mode service ID
+ *
+ * @v qpn		Receiver's datagram-mode QPN
+ * @v service_id	Service ID to fill in
+ */
+static void ipoib_cm_service_id ( unsigned long qpn,
+				  struct ib_gid_half *service_id ) {
+	service_id->u.dwords[0] = 0;
+	service_id->u.dwords[1] =
+		htonl ( IPOIB_CM_SERVICE_ID | ( qpn & IB_QPN_MASK ) );
+}
+
+/**
+ * Construct IPoIB connected mode private data
+ *
+ * @v ipoib		IPoIB device
+ * @v data		Private data to fill in
+ */
+static void ipoib_cm_data ( struct ipoib_device *ipoib,
+			    struct ipoib_cm_data *data ) {
+	data->qpn = htonl ( ipoib->qp->qpn );
+	data->mtu = htonl ( IPOIB_CM_RECV_LEN );
+}
+
+/**
+ * Allocate IPoIB connected mode connection
+ *
+ * @v ipoib		IPoIB device
+ * @v mac		Peer MAC address
+ * @v num_send_wqes	Number of send work queue entries
+ * @v num_recv_wqes	Number of receive work queue entries
+ * @v list		List of connections to add to
+ * @ret cm		Connection, or NULL
+ */
+static struct ipoib_cm * ipoib_cm_alloc ( struct ipoib_device *ipoib,
+					  const struct ipoib_mac *mac,
+					  unsigned int num_send_wqes,
+					  unsigned int num_recv_wqes,
+					  struct list_head *list ) {
+	struct ib_device *ibdev = ipoib->ibdev;
+	unsigned int cqes = ( num_send_wqes + num_recv_wqes );
+	struct ipoib_cm *cm;
+
+	/* Check for space on the shared completion queue */
+	if ( ( ipoib->cm_cqes + cqes ) > IPOIB_CM_NUM_CQES ) {
+		DBGC ( ipoib, "IPoIB %p has too many connections\n", ipoib );
+		return NULL;
+	}
+
+	/* Allocate and initialise structure */
+	cm = zalloc ( sizeof ( *cm ) );
+	if ( ! cm )
+		return NULL;
+	cm->ipoib = ipoib;
+	memcpy ( &cm->mac, mac, sizeof ( cm->mac ) );
+	cm->cqes = cqes;
+
+	/* Allocate queue pair */
+	cm->qp = ib_create_qp ( ibdev, IB_QPT_RC, num_send_wqes, ipoib->cm_cq,
+				num_recv_wqes, ipoib->cm_cq );
+	if ( ! cm->qp ) {
+		DBGC ( ipoib, "IPoIB %p could not allocate connected mode "
+		       "queue pair\n", ipoib );
+		free ( cm );
+		return NULL;
+	}
+	ib_qp_set_ownerdata ( cm->qp, cm );
+
+	ipoib->cm_cqes += cqes;
+	list_add ( &cm->list, list );
+	return cm;
+}
+
+/**
+ * Free IPoIB connected mode connection
+ *
+ * @v cm		Connection
+ */
+static void ipoib_cm_free ( struct ipoib_cm *cm ) {
+	struct ipoib_device *ipoib = cm->ipoib;
+	struct ib_device *ibdev = ipoib->ibdev;
+
+	list_del ( &cm->list );
+	if ( cm->conn )
+		ib_destroy_conn ( ibdev, cm->qp, cm->conn );
+	ib_destroy_qp ( ibdev, cm->qp );
+	ipoib->cm_cqes -= cm->cqes;
+	free ( cm );
+}
+
+/**
+ * Handle IPoIB connection status change
+ *
+ * @v ibdev		Infiniband device
+ * @v qp		Queue pair
+ * @v conn		Connection
+ * @v rc		Connection status code
+ * @v private_data	Private data, if available
+ * @v private_data_len	Length of private data
+ */
+static void ipoib_cm_changed ( struct ib_device *ibdev __unused,
+			       struct ib_queue_pair *qp,
+			       struct ib_connection *conn, int rc,
+			       void *private_data, size_t private_data_len ) {
+	struct ipoib_cm *cm = ib_qp_get_ownerdata ( qp );
+	struct ipoib_device *ipoib = cm->ipoib;
+	struct ipoib_cm_data *data = private_data;
+
+	/* Receive connections need no further action once established */
+	if ( conn->listener ) {
+		if ( rc != 0 ) {
+			DBGC ( ipoib, "IPoIB %p connection from %s closed: "
+			       "%s\n", ipoib, ipoib_ntoa ( &cm->mac ),
+			       strerror ( rc ) );
+			ipoib_cm_free ( cm );
+		}
+		return;
+	}
+
+	/* A transmit connection closed by the peer may be reopened */
+	if ( rc == -ECONNRESET ) {
+		DBGC ( ipoib, "IPoIB %p connection to %s closed by peer\n",
+		       ipoib, ipoib_ntoa ( &cm->mac ) );
+		ipoib_cm_free ( cm );
+		return;
+	}
+
+	/* Record connection status */
+	cm->rc = rc;
+	if ( rc != 0 ) {
+		DBGC ( ipoib, "IPoIB %p could not connect to %s: %s\n",
+		       ipoib, ipoib_ntoa ( &cm->mac ), strerror ( rc ) );
+		return;
+	}
+
+	/* Record peer's MTU */
+	cm->mtu = IPOIB_CM_RECV_LEN;
+	if ( ( private_data_len >= sizeof ( *data ) ) &&
+	     ( ntohl ( data->mtu ) < cm->mtu ) ) {
+		cm->mtu = ntohl ( data->mtu );
+	}
+	DBGC ( ipoib, "IPoIB %p connected to %s with MTU %zd\n",
+	       ipoib, ipoib_ntoa ( &cm->mac ), cm->mtu );
+}
+
+/** IPoIB connected mode connection operations */
+static struct ib_connection_operations ipoib_cm_conn_op = {
+	.changed = ipoib_cm_changed,
+};
+
+/**
+ * Accept IPoIB connected mode connection
+ *
+ * @v ibdev		Infiniband device
+ * @v listener		Connection listener
+ * @v conn		New connection
+ * @v private_data	Connection request private data
+ * @v private_data_len	Length of connection request private data
+ * @ret qp		Queue pair for connection, or NULL to reject
+ */
+static struct ib_queue_pair *
+ipoib_cm_accept ( struct ib_device *ibdev, struct ib_listener *listener,
+		  struct ib_connection *conn, void *private_data,
+		  size_t private_data_len ) {
+	struct ipoib_device *ipoib = ib_listener_get_ownerdata ( listener );
+	struct ipoib_cm_data *data = private_data;
+	struct ipoib_mac mac;
+	struct ipoib_cm *cm;
+
+	/* Record peer's datagram-mode QPN.  The peer's GID will be
+	 * available from the queue pair's address vector.
+	 */
+	if ( private_data_len < sizeof ( *data ) )
+		return NULL;
+	memset ( &mac, 0, sizeof ( mac ) );
+	mac.flags__qpn = htonl ( ntohl ( data->qpn ) & IB_QPN_MASK );
+
+	/* Allocate connection */
+	cm = ipoib_cm_alloc ( ipoib, &mac, 1, IPOIB_CM_NUM_RECV_WQES,
+			      &ipoib->cm_rx );
+	if ( ! cm )
+		return NULL;
+	cm->conn = conn;
+
+	/* Fill receive ring */
+	cm->qp->recv.len = IPOIB_CM_RECV_LEN;
+	ib_refill_recv ( ibdev, cm->qp );
+
+	DBGC ( ipoib, "IPoIB %p accepted connection from QPN %lx\n",
+	       ipoib, ( ntohl ( mac.flags__qpn ) & IB_QPN_MASK ) );
+	return cm->qp;
+}
+
+/** IPoIB connected mode listener operations */
+static struct ib_listener_operations ipoib_cm_listener_op = {
+	.accept = ipoib_cm_accept,
+};
+
+/**
+ * Open IPoIB connected mode connection to peer
+ *
+ * @v ipoib		IPoIB device
+ * @v mac		Peer MAC address
+ * @ret cm		Connection, or NULL
+ */
+static struct ipoib_cm * ipoib_cm_connect ( struct ipoib_device *ipoib,
+					    const struct ipoib_mac *mac ) {
+	struct ipoib_cm_data data;
+	struct ib_gid_half service_id;
+	struct ib_gid gid;
+	struct ipoib_cm *cm;
+
+	/* Allocate connection */
+	cm = ipoib_cm_alloc ( ipoib, mac, IPOIB_NUM_SEND_WQES, 1,
+			      &ipoib->cm_tx );
+	if ( ! cm )
+		return NULL;
+	cm->rc = -EINPROGRESS;
+
+	/* Connect to peer's connected mode service */
+	ipoib_cm_service_id ( ntohl ( mac->flags__qpn ), &service_id );
+	ipoib_cm_data ( ipoib, &data );
+	memcpy ( &gid, &mac->gid, sizeof ( gid ) );
+	cm->conn = ib_create_conn ( ipoib->ibdev, cm->qp, &gid, &service_id,
+				    &data, sizeof ( data ),
+				    &ipoib_cm_conn_op );
+	if ( ! cm->conn ) {
+		DBGC ( ipoib, "IPoIB %p could not connect to %s\n",
+		       ipoib, ipoib_ntoa ( mac ) );
+		ipoib_cm_free ( cm );
+		return NULL;
+	}
+
+	return cm;
+}
+
+/**
+ * Transmit packet via IPoIB connected mode
+ *
+ * @v ipoib		IPoIB device
+ * @v mac		Destination MAC address
+ * @v iobuf		I/O buffer
+ * @ret rc		Return status code
+ *
+ * Returns -ENOTCONN if the packet should be sent in datagram mode
+ * instead.  This is the case while a connection is being established.
+ */
+static int ipoib_cm_transmit ( struct ipoib_device *ipoib,
+			       const struct ipoib_mac *mac,
+			       struct io_buffer *iobuf ) {
+	struct ipoib_cm *cm;
+
+	/* Use datagram mode unless peer supports connected mode */
+	if ( ! ( mac->flags__qpn & htonl ( IPOIB_MAC_FLAG_RC ) ) )
+		return -ENOTCONN;
+
+	/* Identify connection, opening one if necessary */
+	list_for_each_entry ( cm, &ipoib->cm_tx, list ) {
+		if ( memcmp ( &cm->mac, mac, sizeof ( cm->mac ) ) == 0 )
+			goto found;
+	}
+	cm = ipoib_cm_connect ( ipoib, mac );
+	if ( ! cm )
+		return -ENOTCONN;
+ found:
+
+	/* Use datagram mode until connected */
+	if ( ( cm->rc != 0 ) || ( iob_len ( iobuf ) > cm->mtu ) )
+		return -ENOTCONN;
+
+	return ib_post_send ( ipoib->ibdev, cm->qp, NULL, iobuf );
+}
+
+/**
+ * Handle IPoIB connected mode send completion
+ *
+ * @v ibdev		Infiniband device
+ * @v qp		Queue pair
+ * @v iobuf		I/O buffer
+ * @v rc		Completion status code
+ */
+static void ipoib_cm_complete_send ( struct ib_device *ibdev __unused,
+				     struct ib_queue_pair *qp,
+				     struct io_buffer *iobuf, int rc ) {
+	struct ipoib_cm *cm = ib_qp_get_ownerdata ( qp );
+
+	/* A failed send leaves the queue pair unusable; revert to
+	 * datagram mode for this peer.
+	 */
+	if ( ( rc != 0 ) && ( cm->rc == 0 ) )
+		cm->rc = rc;
+
+	netdev_tx_complete_err ( cm->ipoib->netdev, iobuf, rc );
+}
+
+/**
+ * Handle IPoIB connected mode receive completion
+ *
+ * @v ibdev		Infiniband device
+ * @v qp		Queue pair
+ * @v av		Address vector, or NULL
+ * @v iobuf		I/O buffer
+ * @v rc		Completion status code
+ */
+static void ipoib_cm_complete_recv ( struct ib_device *ibdev __unused,
+				     struct ib_queue_pair *qp,
+				     struct ib_address_vector *av __unused,
+				     struct io_buffer *iobuf, int rc ) {
+	struct ipoib_cm *cm = ib_qp_get_ownerdata ( qp );
+	struct ipoib_device *ipoib = cm->ipoib;
+	struct net_device *netdev = ipoib->netdev;
+	struct ipoib_hdr *ipoib_hdr;
+	struct ipoib_mac ll_src;
+	struct ipoib_peer *src;
+
+	if ( rc != 0 ) {
+		netdev_rx_err ( netdev, iobuf, rc );
+		return;
+	}
+
+	/* Sanity check */
+	if ( iob_len ( iobuf ) < sizeof ( struct ipoib_hdr ) ) {
+		DBGC ( ipoib, "IPoIB %p received connected mode packet too "
+		       "short to contain IPoIB header\n", ipoib );
+		DBGC_HD ( ipoib, iobuf->data, iob_len ( iobuf ) );
+		netdev_rx_err ( netdev, iobuf, -EIO );
+		return;
+	}
+	ipoib_hdr = iobuf->data;
+
+	/* Source address is the peer's datagram-mode address */
+	ll_src.flags__qpn = cm->mac.flags__qpn;
+	memcpy ( &ll_src.gid, &qp->av.gid, sizeof ( ll_src.gid ) );
+	src = ipoib_cache_peer ( &ll_src );
+	ipoib_hdr->u.peer.src = src->key;
+
+	/* Hand off to network layer */
+	netdev_rx ( netdev, iobuf );
+}
+
+/** IPoIB connected mode completion operations */
+static struct ib_completion_queue_operations ipoib_cm_cq_op = {
+	.complete_send = ipoib_cm_complete_send,
+	.complete_recv = ipoib_cm_complete_recv,
+};
+
+/**
+ * Close all IPoIB connected mode connections
+ *
+ * @v ipoib		IPoIB device
+ */
+static void ipoib_cm_disconnect_all ( struct ipoib_device *ipoib ) {
+	struct ipoib_cm *cm;
+	struct ipoib_cm *tmp;
+
+	list_for_each_entry_safe ( cm, tmp, &ipoib->cm_tx, list )
+		ipoib_cm_free ( cm );
+	list_for_each_entry_safe ( cm, tmp, &ipoib->cm_rx, list )
+		ipoib_cm_free ( cm );
+}
+
+/**
+ * Open IPoIB connected mode
+ *
+ * @v ipoib		IPoIB device
+ * @ret rc		Return status code
+ */
+static int ipoib_cm_open ( struct ipoib_device *ipoib ) {
+	struct ib_device *ibdev = ipoib->ibdev;
+	struct ipoib_mac *mac =
+		( ( struct ipoib_mac * ) ipoib->netdev->ll_addr );
+	struct ipoib_cm_data data;
+	struct ib_gid_half service_id;
+	int rc;
+
+	/* Allocate completion queue */
+	ipoib->cm_cq = ib_create_cq ( ibdev, IPOIB_CM_NUM_CQES,
+				      &ipoib_cm_cq_op );
+	if ( ! ipoib->cm_cq ) {
+		DBGC ( ipoib, "IPoIB %p could not allocate connected mode "
+		       "completion queue\n", ipoib );
+		rc = -ENOMEM;
+		goto err_create_cq;
+	}
+
+	/* Listen for incoming connections */
+	ipoib_cm_service_id ( ipoib->qp->qpn, &service_id );
+	ipoib_cm_data ( ipoib, &data );
+	ipoib->cm_listener = ib_create_listener ( ibdev, &service_id,
+						  &data, sizeof ( data ),
+						  &ipoib_cm_listener_op,
+						  &ipoib_cm_conn_op );
+	if ( ! ipoib->cm_listener ) {
+		DBGC ( ipoib, "IPoIB %p could not create connected mode "
+		       "listener\n", ipoib );
+		rc = -ENOMEM;
+		goto err_create_listener;
+	}
+	ib_listener_set_ownerdata ( ipoib->cm_listener, ipoib );
+
+	/* Advertise support for connected mode */
+	mac->flags__qpn |= htonl ( IPOIB_MAC_FLAG_RC );
+
+	return 0;
+
+	ib_destroy_listener ( ibdev, ipoib->cm_listener );
+ err_create_listener:
+	ib_destroy_cq ( ibdev, ipoib->cm_cq );
+	ipoib->cm_cq = NULL;
+ err_create_cq:
+	return rc;
+}
+
+/**
+ * Close IPoIB connected mode
+ *
+ * @v ipoib		IPoIB device
+ */
+static void ipoib_cm_close ( struct ipoib_device *ipoib ) {
+	struct ib_device *ibdev = ipoib->ibdev;
+
+	ib_destroy_listener ( ibdev, ipoib->cm_listener );
+	ipoib_cm_disconnect_all ( ipoib );
+	ib_destroy_cq ( ibdev, ipoib->cm_cq );
+	ipoib->cm_cq = NULL;
+}
+
 /****************************************************************************
  *
  * IPoIB network device
@@ -435,6 +977,20 @@ static int ipoib_transmit ( struct net_device *netdev,
 		return -ENXIO;
 	ipoib_hdr->u.reserved = 0;
 
+	/* Use connected mode if possible */
+	if ( IPOIB_CM &&
+	     ( ( rc = ipoib_cm_transmit ( ipoib, &dest->mac,
+					  iobuf ) ) != -ENOTCONN ) ) {
+		return rc;
+	}
+
+	/* Datagram mode is limited to a single packet */
+	if ( iob_len ( iobuf ) > IB_MAX_PAYLOAD_SIZE ) {
+		DBGC ( ipoib, "IPoIB %p packet too long for datagram mode "
+		       "(%zd bytes)\n", ipoib, iob_len ( iobuf ) );
+		return -EMSGSIZE;
+	}
+
 	/* Construct address vector */
 	memset ( &av, 0, sizeof ( av ) );
 	av.qpn = ( ntohl ( dest->mac.flags__qpn ) & IB_QPN_MASK );
@@ -566,11 +1122,12 @@ void ipoib_join_complete ( struct ib_device *ibdev __unused,
  * @ret rc		Return status code
  */
 static int ipoib_join_broadcast_group ( struct ipoib_device *ipoib ) {
+	struct ib_gid gid;
 	int rc;
 
+	memcpy ( &gid, &ipoib->broadcast.gid, sizeof ( gid ) );
 	if ( ( rc = ib_mcast_join ( ipoib->ibdev, ipoib->qp,
-				    &ipoib->broadcast_membership,
-				    &ipoib->broadcast.gid,
+				    &ipoib->broadcast_membership, &gid,
 				    ipoib_join_complete ) ) != 0 ) {
 		DBGC ( ipoib, "IPoIB %p could not join broadcast group: %s\n",
 		       ipoib, strerror ( rc ) );
@@ -638,6 +1195,10 @@ static int ipoib_open ( struct net_device *netdev ) {
 	/* Update MAC address with QPN */
 	mac->flags__qpn = htonl ( ipoib->qp->qpn );
 
+	/* Open connected mode */
+	if ( IPOIB_CM && ( ( rc = ipoib_cm_open ( ipoib ) ) != 0 ) )
+		goto err_cm_open;
+
 	/* Fill receive rings */
 	ib_refill_recv ( ibdev, ipoib->qp );
 
@@ -646,6 +1207,9 @@ static int ipoib_open ( struct net_device *netdev ) {
 
 	return 0;
 
+	if ( IPOIB_CM )
+		ipoib_cm_close ( ipoib );
+ err_cm_open:
 	ib_destroy_qp ( ibdev, ipoib->qp );
  err_create_qp:
 	ib_destroy_cq ( ibdev, ipoib->cq );
@@ -668,6 +1232,10 @@ static void ipoib_close ( struct net_device *netdev ) {
 	/* Leave broadcast group */
 	ipoib_leave_broadcast_group ( ipoib );
 
+	/* Close connected mode */
+	if ( IPOIB_CM )
+		ipoib_cm_close ( ipoib );
+
 	/* Remove QPN from MAC address */
 	mac->flags__qpn = 0;
 
@@ -702,6 +1270,10 @@ void ipoib_link_state_changed ( struct ib_device *ibdev ) {
 	/* Leave existing broadcast group */
 	ipoib_leave_broadcast_group ( ipoib );
 
+	/* Drop connections, which may have been invalidated */
+	if ( IPOIB_CM )
+		ipoib_cm_disconnect_all ( ipoib );
+
 	/* Update MAC address based on potentially-new GID prefix */
 	memcpy ( &mac->gid.u.half[0], &ibdev->gid.u.half[0],
 		 sizeof ( mac->gid.u.half[0] ) );
@@ -746,6 +1318,15 @@ int ipoib_probe ( struct ib_device *ibdev ) {
 	memset ( ipoib, 0, sizeof ( *ipoib ) );
 	ipoib->netdev = netdev;
 	ipoib->ibdev = ibdev;
+	INIT_LIST_HEAD ( &ipoib->cm_tx );
+	INIT_LIST_HEAD ( &ipoib->cm_rx );
+
+	/* Connected mode allows larger packets to be received.  The
+	 * maximum packet length is left unchanged, since packets to
+	 * peers without a connection must still fit in a datagram.
+	 */
+	if ( IPOIB_CM )
+		netdev->mtu = IPOIB_CM_MTU;
 
 	/* Extract hardware address */
 	memcpy ( netdev->hw_addr, &ibdev->gid.u.half[1],
@@ -23,6 +23,51 @@ struct nic nic;
 
 static int legacy_registered = 0;
 
+/** Number of pre-allocated receive buffers */
+#define LEGACY_NUM_RX_IOBS 4
+
+/** Maximum number of packets to retrieve in a single poll */
+#define LEGACY_RX_QUOTA 8
+
+/** Pre-allocated receive buffers
+ *
+ * Legacy drivers copy received data into nic->packet, so we keep a
+ * small pool of buffers ready for them.  A buffer is only consumed
+ * when the driver actually reports a packet; an empty poll costs
+ * nothing more than the driver's own status check.
+ */
+static struct io_buffer *legacy_rx_iobs[LEGACY_NUM_RX_IOBS];
+
+/** Number of buffers currently in the receive pool */
+static unsigned int legacy_rx_fill;
+
+/**
+ * Refill receive buffer pool
+ *
+ */
+static void legacy_refill_rx ( void ) {
+	struct io_buffer *iobuf;
+
+	while ( legacy_rx_fill < LEGACY_NUM_RX_IOBS ) {
+		iobuf = alloc_iob ( ETH_FRAME_LEN );
+		if ( ! iobuf ) {
+			/* Wait for next refill */
+			break;
+		}
+		legacy_rx_iobs[legacy_rx_fill++] = iobuf;
+	}
+}
+
+/**
+ * Empty receive buffer pool
+ *
+ */
+static void legacy_empty_rx ( void ) {
+
+	while ( legacy_rx_fill )
+		free_iob ( legacy_rx_iobs[--legacy_rx_fill] );
+}
+
 static int legacy_transmit ( struct net_device *netdev, struct io_buffer *iobuf ) {
 	struct nic *nic = netdev->priv;
 	struct ethhdr *ethhdr;
@@ -41,28 +86,42 @@ static int legacy_transmit ( struct net_device *netdev, struct io_buffer *iobuf
 static void legacy_poll ( struct net_device *netdev ) {
 	struct nic *nic = netdev->priv;
 	struct io_buffer *iobuf;
+	unsigned int quota;
 
-	iobuf = alloc_iob ( ETH_FRAME_LEN );
-	if ( ! iobuf )
-		return;
-
-	nic->packet = iobuf->data;
-	if ( nic->nic_op->poll ( nic, 1 ) ) {
+	/* Retrieve as many packets as the driver has ready, up to
+	 * the quota, handing each one up in its pool buffer.
+	 */
+	for ( quota = LEGACY_RX_QUOTA ; quota ; quota-- ) {
+		if ( ! legacy_rx_fill ) {
+			legacy_refill_rx();
+			if ( ! legacy_rx_fill )
+				return;
+		}
+		iobuf = legacy_rx_iobs[legacy_rx_fill - 1];
+		nic->packet = iobuf->data;
+		if ( ! nic->nic_op->poll ( nic, 1 ) )
+			break;
 		DBG ( "Received %d bytes\n", nic->packetlen );
+		legacy_rx_fill--;
 		iob_put ( iobuf, nic->packetlen );
 		netdev_rx ( netdev, iobuf );
-	} else {
-		free_iob ( iobuf );
 	}
+
+	/* Replace any consumed buffers */
+	legacy_refill_rx();
 }
 
 static int legacy_open ( struct net_device *netdev __unused ) {
-	/* Nothing to do */
+	/* Pre-allocate receive buffers; a shortfall here is not
+	 * fatal, since the pool is refilled on every poll.
+	 */
+	legacy_refill_rx();
 	return 0;
 }
 
 static void legacy_close ( struct net_device *netdev __unused ) {
-	/* Nothing to do */
+	/* Release receive buffers */
+	legacy_empty_rx();
 }
 
 static void legacy_irq ( struct net_device *netdev __unused, int enable ) {
@@ -50,11 +50,11 @@ FILE_LICENCE ( GPL2_ONLY );
  *
  * Receive
  *
- * Receives are posted to the NIC's receive ring.  The NIC fills a
- * DMAable receive_completion ring with completion notifications.
- * myri10ge_net_poll() polls for these receive notifications, posts
- * replacement receive buffers to the NIC, and passes received frames
- * to netdev_rx().
+ * Receives are posted to the NIC's receive ring in groups of eight.
+ * The NIC fills a DMAable receive_completion ring with completion
+ * notifications.  myri10ge_net_poll() polls for these receive
+ * notifications, passes received frames to netdev_rx(), and then
+ * posts replacement receive buffers to the NIC a group at a time.
  *
  * NonVolatile Storage
  *
@@ -110,12 +110,20 @@ static int	myri10ge_net_transmit ( struct net_device*, struct io_buffer* );
  * Constants
  ****************************************************************/
 
-/* Maximum ring indices, used to wrap ring indices.  These must be 2**N-1. */
+/* Maximum ring indices, used to wrap ring indices.  These must be 2**N-1.
+   The rings actually used are the smaller of these and the rings
+   reported by the firmware.  The receive completion ring must be at
+   least as large as the receive ring. */
 
-#define MYRI10GE_TRANSMIT_WRAP                  1U
-#define MYRI10GE_RECEIVE_WRAP                   7U
+#define MYRI10GE_TRANSMIT_WRAP                  31U
+#define MYRI10GE_RECEIVE_WRAP                   31U
 #define MYRI10GE_RECEIVE_COMPLETION_WRAP        31U
 
+/* Receive buffers are allocated and posted in groups of this many, as
+   the firmware prefers.  This must divide the receive ring size. */
+
+#define MYRI10GE_RECEIVE_BATCH                  8U
+
 /****************************************************************
  * Driver internal data types.
  ****************************************************************/
@@ -159,6 +167,7 @@ struct myri10ge_private
 
 	mcp_kreq_ether_send_t	*transmit_ring;	/* in NIC SRAM */
 	uint32                   transmit_ring_wrap;
+	uint32                   transmit_limit;
 	uint32                   transmits_posted;
 	uint32                   transmits_done;
 	struct io_buffer	*transmit_iob[1 + MYRI10GE_TRANSMIT_WRAP];
@@ -169,10 +178,22 @@ struct myri10ge_private
 
 	mcp_kreq_ether_recv_t	*receive_post_ring;	/* in NIC SRAM */
 	unsigned int             receive_post_ring_wrap;
+	unsigned int             receive_limit;
 	unsigned int             receives_posted;
 	unsigned int             receives_done;
 	struct io_buffer	*receive_iob[1 + MYRI10GE_RECEIVE_WRAP];
 
+	/*
+	 * Ring occupancy and drop statistics, reported when the
+	 * device is closed.
+	 */
+
+	unsigned int             transmit_max_occupancy;
+	unsigned int             transmit_ring_full;
+	unsigned int             receive_min_occupancy;
+	unsigned int             receive_alloc_failures;
+	uint32                   receive_nic_drops;
+
 	/* Address for writing commands to the firmware.
 	   BEWARE: the value must be written 32 bits at a time. */
 
@@ -204,6 +225,16 @@ struct myri10ge_private
 	       ( priv ) ->receives_done, ( priv ) -> receives_posted,	\
 	       __FUNCTION__ )
 
+/* Print ring occupancy and drop statistics when debugging. */
+
+#define DBG_RING_STATS( priv )						\
+	DBG ( "tx max %d full %d rx min %d nobuf %d drop %d\n",	\
+	      ( priv ) -> transmit_max_occupancy,			\
+	      ( priv ) -> transmit_ring_full,				\
+	      ( priv ) -> receive_min_occupancy,			\
+	      ( priv ) -> receive_alloc_failures,			\
+	      ( priv ) -> receive_nic_drops )
+
 /*
  * Return a pointer to the driver private data for a network device.
  *
@@ -241,33 +272,72 @@ static inline struct pci_device *myri10ge_pcidev ( struct net_device *netdev )
 }
 
 /*
- * Pass a receive buffer to the NIC to be filled.
+ * Replenish the NIC's receive ring.
  *
- * @v priv	The network device to receive the buffer.
- * @v iob	The I/O buffer to fill.
+ * @v priv	The network device to receive the buffers.
+ * @ret rc	0 on success, else an error code.
  *
- * Receive buffers are filled in FIFO order.
+ * Receive buffers are filled in FIFO order.  Buffers are allocated
+ * and posted MYRI10GE_RECEIVE_BATCH at a time, and the first
+ * descriptor of each group is made valid only after the rest of the
+ * group has been written, so the firmware always sees a whole group.
  */
-static void myri10ge_post_receive ( struct myri10ge_private *priv,
-				    struct io_buffer *iob )
+static int myri10ge_refill_receives ( struct myri10ge_private *priv )
 {
+	struct io_buffer	*iob[MYRI10GE_RECEIVE_BATCH];
 	unsigned int		 receives_posted;
+	unsigned int		 i;
 	mcp_kreq_ether_recv_t	*request;
+	uint32			 first_addr_low;
+
+	while ( ( priv->receives_posted - priv->receives_done
+		  + MYRI10GE_RECEIVE_BATCH ) <= ( priv->receive_limit + 1 ) ) {
+
+		/* Allocate a whole group of buffers, reserving 2 extra
+		   bytes at the start of packets, since the firmware
+		   always skips the first 2 bytes of the buffer so TCP
+		   headers will be aligned. */
+
+		for ( i=0; i<MYRI10GE_RECEIVE_BATCH; i++ ) {
+			iob[i] = alloc_iob ( MXGEFW_PAD + ETH_FRAME_LEN );
+			if ( !iob[i] ) {
+				DBG ( "NO RX BUF\n" );
+				while ( i-- )
+					free_iob ( iob[i] );
+				priv->receive_alloc_failures++;
+				return -ENOMEM;
+			}
+			iob_reserve ( iob[i], MXGEFW_PAD );
+		}
 
-	/* Record the posted I/O buffer, to be passed to netdev_rx() on
-	   receive. */
-
-	receives_posted = priv->receives_posted;
-	priv->receive_iob[receives_posted & MYRI10GE_RECEIVE_WRAP] = iob;
+		/* Record the posted I/O buffers, to be passed to
+		   netdev_rx() on receive, and write the descriptors with
+		   the first one marked invalid. */
+
+		receives_posted = priv->receives_posted;
+		for ( i=0; i<MYRI10GE_RECEIVE_BATCH; i++ ) {
+			priv->receive_iob[( receives_posted + i )
+					  & MYRI10GE_RECEIVE_WRAP] = iob[i];
+			request = &priv->receive_post_ring
+				[( receives_posted + i )
+				 & priv->receive_post_ring_wrap];
+			request->addr_high = 0;
+			request->addr_low = ( i ? htonl ( virt_to_bus
+							  ( iob[i]->data ) )
+					      : 0xFFFFFFFF );
+		}
+		wmb();
 
-	/* Post the receive. */
+		/* Validate the group by writing its first descriptor. */
 
-	request = &priv->receive_post_ring[receives_posted
-					   & priv->receive_post_ring_wrap];
-	request->addr_high = 0;
-	wmb();
-	request->addr_low = htonl ( virt_to_bus ( iob->data ) );
-	priv->receives_posted = ++receives_posted;
+		first_addr_low = htonl ( virt_to_bus ( iob[0]->data ) );
+		priv->receive_post_ring[receives_posted
+					& priv->receive_post_ring_wrap]
+			.addr_low = first_addr_low;
+		wmb();
+		priv->receives_posted = receives_posted + MYRI10GE_RECEIVE_BATCH;
+	}
+	return 0;
 }
 
 /*
@@ -394,6 +464,8 @@ static void myri10ge_interrupt_handler ( struct net_device *netdev )
 
 	if ( irq_data->stats_updated ) {
 
+		uint32 nic_drops;
+
 		/* Update the link status. */
 
 		DBG2 ( "stats " );
@@ -402,7 +474,16 @@ static void myri10ge_interrupt_handler ( struct net_device *netdev )
 		else
 			netdev_link_down ( netdev );
 
-		/* Ignore all error counters from the NIC. */
+		/* Record frames the NIC dropped for lack of a receive
+		   buffer as receive errors.  Ignore all other error
+		   counters from the NIC. */
+
+		nic_drops = ( ntohl ( irq_data->dropped_no_small_buffer )
+			      + ntohl ( irq_data->dropped_no_big_buffer ) );
+		while ( priv->receive_nic_drops != nic_drops ) {
+			netdev_rx_err ( netdev, NULL, -ENOBUFS );
+			++priv->receive_nic_drops;
+		}
 	}
 
 	/* Wait for the interrupt to be deasserted, as indicated by
@@ -915,6 +996,7 @@ static void myri10ge_net_close ( struct net_device *netdev )
 	   the NIC. */
 
 	myri10ge_command ( priv, MXGEFW_CMD_RESET, data );
+	DBG_RING_STATS ( priv );
 
 	/* Free receive buffers that were never filled. */
 
@@ -975,7 +1057,6 @@ static int myri10ge_net_open ( struct net_device *netdev )
 {
 	const char		*dbg;	/* printed upon error return */
 	int			 rc;
-	struct io_buffer	*iob;
 	struct myri10ge_private *priv;
 	uint32			 data[3];
 	struct pci_device	*pci_dev;
@@ -1046,8 +1127,9 @@ static int myri10ge_net_open ( struct net_device *netdev )
 	TRY ( CMD_GET_, IRQ_DEASSERT, _OFFSET );
 	priv->irq_deassert = membase + data[0];
 
-	/* Disable interrupt coalescing, which is inappropriate for the
-	   minimal buffering we provide. */
+	/* Disable interrupt coalescing.  Receives are found by polling
+	   the completion ring, but send completions are reported only
+	   through the interrupt data, and we want those promptly. */
 
 	TRY ( CMD_GET_, INTR_COAL, _DELAY_OFFSET );
 	* ( ( uint32 * ) ( membase + data[0] ) ) = 0;
@@ -1084,18 +1166,27 @@ static int myri10ge_net_open ( struct net_device *netdev )
 		dbg = "TX_RING";
 		goto abort_with_dma;
 	}
+	priv->transmit_limit = priv->transmit_ring_wrap;
+	if ( priv->transmit_limit > MYRI10GE_TRANSMIT_WRAP )
+		priv->transmit_limit = MYRI10GE_TRANSMIT_WRAP;
 
 	/* Compute receive ring sizes. */
 
 	data[0] = 0;		/* slice 0 */
 	TRY ( CMD_GET_ , RX_RING , _SIZE );
 	priv->receive_post_ring_wrap = data[0] / sizeof ( mcp_dma_addr_t ) - 1;
-	if ( priv->receive_post_ring_wrap
-	     & ( priv->receive_post_ring_wrap + 1 ) ) {
+	if ( ( priv->receive_post_ring_wrap
+	       & ( priv->receive_post_ring_wrap + 1 ) )
+	     || ( priv->receive_post_ring_wrap + 1 < MYRI10GE_RECEIVE_BATCH ) ) {
 		rc = -EPROTO;
 		dbg = "RX_RING";
 		goto abort_with_dma;
 	}
+	priv->receive_limit = priv->receive_post_ring_wrap;
+	if ( priv->receive_limit > MYRI10GE_RECEIVE_WRAP )
+		priv->receive_limit = MYRI10GE_RECEIVE_WRAP;
+	DBG2 ( "rings tx %d rx %d\n", priv->transmit_limit + 1,
+	       priv->receive_limit + 1 );
 
 	/* Get NIC transmit ring address. */
 
@@ -1130,27 +1221,24 @@ static int myri10ge_net_open ( struct net_device *netdev )
 	data[2] = sizeof ( priv->dma->irq_data );
 	TRY ( CMD_SET_, STATS_DMA_V2, );
 
-	/* Post receives. */
-
-	while ( priv->receives_posted <= MYRI10GE_RECEIVE_WRAP ) {
+	/* Post receives.  Run with a partially filled ring if memory
+	   is short, but insist on at least one group of buffers. */
 
-		/* Reserve 2 extra bytes at the start of packets, since
-		   the firmware always skips the first 2 bytes of the buffer
-		   so TCP headers will be aligned. */
-
-		iob = alloc_iob ( MXGEFW_PAD + ETH_FRAME_LEN );
-		if ( !iob ) {
-			rc = -ENOMEM;
-			dbg = "alloc_iob";
-			goto abort_with_receives_posted;
-		}
-		iob_reserve ( iob, MXGEFW_PAD );
-		myri10ge_post_receive ( priv, iob );
+	myri10ge_refill_receives ( priv );
+	if ( priv->receives_posted == 0 ) {
+		rc = -ENOMEM;
+		dbg = "alloc_iob";
+		goto abort_with_dma;
 	}
+	priv->receive_min_occupancy = priv->receives_posted;
 
 	/* Bring up the link. */
 
-	TRY ( CMD_, ETHERNET_UP, );
+	rc = myri10ge_command ( priv, MXGEFW_CMD_ETHERNET_UP, data );
+	if ( rc ) {
+		dbg = "ETHERNET_UP";
+		goto abort_with_receives_posted;
+	}
 
 	DBG2_RINGS ( priv );
 	return 0;
@@ -1180,11 +1268,11 @@ abort_with_nothing:
 static void myri10ge_net_poll ( struct net_device *netdev )
 {
 	struct io_buffer		*iob;
-	struct io_buffer		*replacement;
 	struct myri10ge_dma_buffers	*dma;
 	struct myri10ge_private		*priv;
 	unsigned int			 length;
 	unsigned int			 orig_receives_posted;
+	unsigned int			 occupancy;
 
 	DBGP ( "myri10ge_net_poll\n" );
 	priv = myri10ge_priv ( netdev );
@@ -1210,20 +1298,6 @@ static void myri10ge_net_poll ( struct net_device *netdev )
 		if ( length == 0 )
 			break;
 
-		/* Allocate a replacement buffer.  If none is available,
-		   stop passing up packets until a buffer is available.
-
-		   Reserve 2 extra bytes at the start of packets, since
-		   the firmware always skips the first 2 bytes of the buffer
-		   so TCP headers will be aligned. */
-
-		replacement = alloc_iob ( MXGEFW_PAD + ETH_FRAME_LEN );
-		if ( !replacement ) {
-			DBG ( "NO RX BUF\n" );
-			break;
-		}
-		iob_reserve ( replacement, MXGEFW_PAD );
-
 		/* Pass up the received frame. */
 
 		iob = priv->receive_iob[priv->receives_done
@@ -1239,12 +1313,18 @@ static void myri10ge_net_poll ( struct net_device *netdev )
 			.length = 0;
 		wmb();
 
-		/* Replace the passed-up I/O buffer. */
-
-		myri10ge_post_receive ( priv, replacement );
 		++priv->receives_done;
 		DBG2_RINGS ( priv );
 	}
+
+	/* Record the lowest ring occupancy seen, then replace the
+	   passed-up I/O buffers.  If memory is short, the ring is left
+	   partially filled and refilled on a later poll. */
+
+	occupancy = priv->receives_posted - priv->receives_done;
+	if ( occupancy < priv->receive_min_occupancy )
+		priv->receive_min_occupancy = occupancy;
+	myri10ge_refill_receives ( priv );
 }
 
 /*
@@ -1271,8 +1351,9 @@ static int myri10ge_net_transmit ( struct net_device *netdev,
 
 	transmits_posted = priv->transmits_posted;
 	if ( transmits_posted - priv->transmits_done
-	     > MYRI10GE_TRANSMIT_WRAP ) {
+	     > priv->transmit_limit ) {
 		DBG ( "TX ring full\n" );
+		priv->transmit_ring_full++;
 		return -ENOBUFS;
 	}
 
@@ -1319,6 +1400,11 @@ static int myri10ge_net_transmit ( struct net_device *netdev,
 	/* Mark the slot as consumed and return. */
 
 	priv->transmits_posted = ++transmits_posted;
+	if ( transmits_posted - priv->transmits_done
+	     > priv->transmit_max_occupancy ) {
+		priv->transmit_max_occupancy
+			= transmits_posted - priv->transmits_done;
+	}
 	DBG2_RINGS ( priv );
 	return 0;
 }
@@ -0,0 +1,534 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <gpxe/command.h>
+#include <gpxe/crypto.h>
+#include <gpxe/profile.h>
+#include <gpxe/aes.h>
+#include <gpxe/gcm.h>
+#include <gpxe/md5.h>
+#include <gpxe/sha1.h>
+#include <gpxe/sha256.h>
+#include <gpxe/rsa.h>
+#include <gpxe/iobuf.h>
+#include <gpxe/net80211.h>
+
+/** @file
+ *
+ * Cryptographic benchmark commands
+ *
+ */
+
+/** Length of data processed per benchmark iteration */
+#define BENCH_LEN 4096
+
+/** Number of benchmark iterations */
+#define BENCH_ITERATIONS 64
+
+/** A cipher to be benchmarked */
+struct cipher_bench {
+	/** Cipher algorithm */
+	struct cipher_algorithm *cipher;
+	/** Key length */
+	size_t keylen;
+	/** Force use of generic implementation, or NULL
+	 *
+	 * If present, the generic implementation is also measured.
+	 */
+	void ( * force_generic ) ( void *ctx );
+};
+
+/**
+ * Force use of generic AES implementation
+ *
+ * @v ctx		Cipher context, beginning with an AES context
+ */
+static void cipher_bench_aes_generic ( void *ctx ) {
+	aes_force_generic ( ctx );
+}
+
+/** Ciphers to be benchmarked */
+static struct cipher_bench cipher_benches[] = {
+	{ &aes_algorithm, ( 128 / 8 ), cipher_bench_aes_generic },
+	{ &aes_cbc_algorithm, ( 128 / 8 ), cipher_bench_aes_generic },
+	{ &aes_cbc_algorithm, ( 256 / 8 ), cipher_bench_aes_generic },
+	{ &aes_gcm_algorithm, ( 128 / 8 ), gcm_force_generic },
+};
+
+/**
+ * Measure cipher
+ *
+ * @v bench		Cipher to benchmark
+ * @v generic		Force use of generic implementation
+ * @v decrypt		Measure decryption rather than encryption
+ * @v ctx		Cipher context
+ * @v data		Data buffer
+ * @ret ticks		Ticks per iteration
+ */
+static unsigned long cipher_bench_cycle ( struct cipher_bench *bench,
+					  int generic, int decrypt,
+					  void *ctx, void *data ) {
+	static const uint8_t key[32];
+	static const uint8_t iv[16];
+	struct cipher_algorithm *cipher = bench->cipher;
+	union profiler profiler;
+	unsigned long total = 0;
+	unsigned int i;
+
+	cipher_setkey ( cipher, ctx, key, bench->keylen );
+	if ( generic )
+		bench->force_generic ( ctx );
+	cipher_setiv ( cipher, ctx, iv );
+	for ( i = 0 ; i < BENCH_ITERATIONS ; i++ ) {
+		profile ( &profiler );
+		if ( decrypt ) {
+			cipher_decrypt ( cipher, ctx, data, data, BENCH_LEN );
+		} else {
+			cipher_encrypt ( cipher, ctx, data, data, BENCH_LEN );
+		}
+		total += profile ( &profiler );
+	}
+	return ( total / BENCH_ITERATIONS );
+}
+
+/**
+ * The "cipherbench" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Exit code
+ */
+static int cipherbench_exec ( int argc, char **argv ) {
+	struct cipher_bench *bench;
+	struct cipher_algorithm *cipher;
+	void *data;
+	void *ctx;
+	unsigned int i;
+	int decrypt;
+
+	if ( argc != 1 ) {
+		printf ( "Usage:\n"
+			 "  %s\n"
+			 "\n"
+			 "Measure cipher performance\n",
+			 argv[0] );
+		return 1;
+	}
+
+	data = zalloc ( BENCH_LEN );
+	if ( ! data ) {
+		printf ( "Could not allocate buffer\n" );
+		return 1;
+	}
+
+	printf ( "CPU ticks per %d bytes (generic implementation):\n",
+		 BENCH_LEN );
+	for ( i = 0 ; i < ( sizeof ( cipher_benches ) /
+			    sizeof ( cipher_benches[0] ) ) ; i++ ) {
+		bench = &cipher_benches[i];
+		cipher = bench->cipher;
+		ctx = malloc ( cipher->ctxsize );
+		if ( ! ctx ) {
+			printf ( "Could not allocate context\n" );
+			break;
+		}
+		for ( decrypt = 0 ; decrypt <= 1 ; decrypt++ ) {
+			printf ( "  %s-%zd %s: %ld", cipher->name,
+				 ( bench->keylen * 8 ),
+				 ( decrypt ? "decrypt" : "encrypt" ),
+				 cipher_bench_cycle ( bench, 0, decrypt,
+						      ctx, data ) );
+			if ( bench->force_generic ) {
+				printf ( " (%ld)",
+					 cipher_bench_cycle ( bench, 1, decrypt,
+							      ctx, data ) );
+			}
+			printf ( "\n" );
+		}
+		free ( ctx );
+	}
+
+	free ( data );
+	return 0;
+}
+
+/** A digest to be benchmarked */
+struct digest_bench {
+	/** Digest algorithm */
+	struct digest_algorithm *digest;
+	/** Force use of generic implementation
+	 *
+	 * If present, the generic implementation is also measured.
+	 */
+	void ( * force_generic ) ( void *ctx );
+};
+
+/** Digests to be benchmarked */
+static struct digest_bench digest_benches[] = {
+	{ &md5_algorithm, NULL },
+	{ &sha1_algorithm, sha1_force_generic },
+	{ &sha256_algorithm, sha256_force_generic },
+};
+
+/**
+ * Measure digest
+ *
+ * @v bench		Digest to benchmark
+ * @v generic		Force use of generic implementation
+ * @v ctx		Digest context
+ * @v data		Data buffer
+ * @ret ticks		Ticks per iteration
+ */
+static unsigned long digest_bench_cycle ( struct digest_bench *bench,
+					  int generic, void *ctx,
+					  void *data ) {
+	struct digest_algorithm *digest = bench->digest;
+	uint8_t out[digest->digestsize];
+	union profiler profiler;
+	unsigned long total = 0;
+	unsigned int i;
+
+	for ( i = 0 ; i < BENCH_ITERATIONS ; i++ ) {
+		profile ( &profiler );
+		digest_init ( digest, ctx );
+		if ( generic )
+			bench->force_generic ( ctx );
+		digest_update ( digest, ctx, data, BENCH_LEN );
+		digest_final ( digest, ctx, out );
+		total += profile ( &profiler );
+	}
+	return ( total / BENCH_ITERATIONS );
+}
+
+/**
+ * The "digestbench" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Exit code
+ */
+static int digestbench_exec ( int argc, char **argv ) {
+	struct digest_bench *bench;
+	struct digest_algorithm *digest;
+	void *data;
+	void *ctx;
+	unsigned int i;
+
+	if ( argc != 1 ) {
+		printf ( "Usage:\n"
+			 "  %s\n"
+			 "\n"
+			 "Measure digest performance\n",
+			 argv[0] );
+		return 1;
+	}
+
+	data = zalloc ( BENCH_LEN );
+	if ( ! data ) {
+		printf ( "Could not allocate buffer\n" );
+		return 1;
+	}
+
+	printf ( "CPU ticks per %d bytes (generic implementation):\n",
+		 BENCH_LEN );
+	for ( i = 0 ; i < ( sizeof ( digest_benches ) /
+			    sizeof ( digest_benches[0] ) ) ; i++ ) {
+		bench = &digest_benches[i];
+		digest = bench->digest;
+		ctx = malloc ( digest->ctxsize );
+		if ( ! ctx ) {
+			printf ( "Could not allocate context\n" );
+			break;
+		}
+		printf ( "  %s: %ld", digest->name,
+			 digest_bench_cycle ( bench, 0, ctx, data ) );
+		if ( bench->force_generic ) {
+			printf ( " (%ld)",
+				 digest_bench_cycle ( bench, 1, ctx, data ) );
+		}
+		printf ( "\n" );
+		free ( ctx );
+	}
+
+	free ( data );
+	return 0;
+}
+
+/** RSA modulus length used for benchmarking */
+#define RSA_BENCH_LEN ( 2048 / 8 )
+
+/** Number of RSA benchmark iterations */
+#define RSA_BENCH_ITERATIONS 16
+
+/**
+ * Measure RSA public key operation
+ *
+ * @v rsa		RSA context
+ * @v classical		Use classical rather than Montgomery reduction
+ * @v verify		Measure signature verification rather than encryption
+ * @v data		Data buffer
+ * @ret ticks		Ticks per iteration
+ */
+static unsigned long rsa_bench_cycle ( RSA_CTX *rsa, int classical,
+				       int verify, void *data ) {
+	static const uint8_t secret[48];
+	uint8_t out[RSA_BENCH_LEN];
+	union profiler profiler;
+	unsigned long total = 0;
+	unsigned int i;
+
+	rsa->bi_ctx->use_classical = classical;
+	for ( i = 0 ; i < RSA_BENCH_ITERATIONS ; i++ ) {
+		profile ( &profiler );
+		if ( verify ) {
+			RSA_decrypt ( rsa, data, out, 0 );
+		} else {
+			RSA_encrypt ( rsa, secret, sizeof ( secret ), out, 0 );
+		}
+		total += profile ( &profiler );
+	}
+	rsa->bi_ctx->use_classical = 0;
+	return ( total / RSA_BENCH_ITERATIONS );
+}
+
+/**
+ * The "rsabench" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Exit code
+ */
+static int rsabench_exec ( int argc, char **argv ) {
+	static const uint8_t exponent[] = { 0x01, 0x00, 0x01 };
+	uint8_t modulus[RSA_BENCH_LEN];
+	uint8_t data[RSA_BENCH_LEN];
+	RSA_CTX *rsa;
+	int verify;
+
+	if ( argc != 1 ) {
+		printf ( "Usage:\n"
+			 "  %s\n"
+			 "\n"
+			 "Measure RSA public key operation performance\n",
+			 argv[0] );
+		return 1;
+	}
+
+	/* Any odd modulus of the right length will do for timing
+	 * purposes.  The "signature" is arbitrary data less than the
+	 * modulus.
+	 */
+	memset ( modulus, 0xa5, sizeof ( modulus ) );
+	modulus[0] = 0xc5;
+	memset ( data, 0x5a, sizeof ( data ) );
+
+	RSA_pub_key_new ( &rsa, modulus, sizeof ( modulus ),
+			  exponent, sizeof ( exponent ) );
+
+	printf ( "CPU ticks per operation (classical reduction):\n" );
+	for ( verify = 0 ; verify <= 1 ; verify++ ) {
+		printf ( "  rsa-%d %s: %ld", ( RSA_BENCH_LEN * 8 ),
+			 ( verify ? "verify" : "encrypt" ),
+			 rsa_bench_cycle ( rsa, 0, verify, data ) );
+		printf ( " (%ld)\n",
+			 rsa_bench_cycle ( rsa, 1, verify, data ) );
+	}
+
+	RSA_free ( rsa );
+	return 0;
+}
+
+/** Length of 802.11 frame payload used for benchmarking */
+#define WLAN_BENCH_LEN 1500
+
+/** 802.11 cryptosystem names, indexed by algorithm */
+static const char *wlan_bench_names[] = {
+	[NET80211_CRYPT_WEP] = "wep",
+	[NET80211_CRYPT_TKIP] = "tkip",
+	[NET80211_CRYPT_CCMP] = "ccmp",
+};
+
+/** 802.11 cryptosystem key lengths, indexed by algorithm
+ *
+ * The TKIP key includes both Michael keys; since both are zero, the
+ * frames sent may be received by a second instance of the same
+ * cryptosystem.
+ */
+static const int wlan_bench_keylens[] = {
+	[NET80211_CRYPT_WEP] = 13,
+	[NET80211_CRYPT_TKIP] = 32,
+	[NET80211_CRYPT_CCMP] = 16,
+};
+
+/**
+ * Instantiate 802.11 cryptosystem
+ *
+ * @v template		Cryptosystem
+ * @ret crypto		Cryptosystem instance, or NULL
+ */
+static struct net80211_crypto *
+wlan_bench_crypto ( struct net80211_crypto *template ) {
+	static const uint8_t key[32];
+	struct net80211_crypto *crypto;
+
+	crypto = zalloc ( sizeof ( *crypto ) + template->priv_len );
+	if ( ! crypto )
+		return NULL;
+	memcpy ( crypto, template, sizeof ( *crypto ) );
+	crypto->priv = ( ( void * ) crypto + sizeof ( *crypto ) );
+	if ( crypto->init ( crypto, key,
+			    wlan_bench_keylens[template->algorithm],
+			    NULL ) != 0 ) {
+		free ( crypto );
+		return NULL;
+	}
+	return crypto;
+}
+
+/**
+ * Measure 802.11 cryptosystem
+ *
+ * @v template		Cryptosystem
+ * @v iob		Plaintext frame
+ * @v encrypt_ticks	Ticks per encrypted frame to fill in
+ * @v decrypt_ticks	Ticks per decrypted frame to fill in
+ * @ret rc		Return status code
+ *
+ * Each encrypted frame is immediately received by a second instance
+ * of the cryptosystem, so that sequence counters remain in step.
+ */
+static int wlan_bench_cycle ( struct net80211_crypto *template,
+			      struct io_buffer *iob,
+			      unsigned long *encrypt_ticks,
+			      unsigned long *decrypt_ticks ) {
+	struct net80211_crypto *tx;
+	struct net80211_crypto *rx;
+	struct io_buffer *eiob;
+	struct io_buffer *diob;
+	union profiler profiler;
+	unsigned int i;
+	int rc = -1;
+
+	*encrypt_ticks = *decrypt_ticks = 0;
+	tx = wlan_bench_crypto ( template );
+	rx = wlan_bench_crypto ( template );
+	if ( ! ( tx && rx ) )
+		goto done;
+
+	for ( i = 0 ; i < BENCH_ITERATIONS ; i++ ) {
+		profile ( &profiler );
+		eiob = tx->encrypt ( tx, iob );
+		*encrypt_ticks += profile ( &profiler );
+		if ( ! eiob )
+			goto done;
+		profile ( &profiler );
+		diob = rx->decrypt ( rx, eiob );
+		*decrypt_ticks += profile ( &profiler );
+		free_iob ( eiob );
+		if ( ! diob )
+			goto done;
+		free_iob ( diob );
+	}
+	*encrypt_ticks /= BENCH_ITERATIONS;
+	*decrypt_ticks /= BENCH_ITERATIONS;
+	rc = 0;
+
+ done:
+	free ( tx );
+	free ( rx );
+	return rc;
+}
+
+/**
+ * The "wlanbench" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Exit code
+ */
+static int wlanbench_exec ( int argc, char **argv ) {
+	struct net80211_crypto *template;
+	struct ieee80211_frame *hdr;
+	struct io_buffer *iob;
+	unsigned long encrypt_ticks;
+	unsigned long decrypt_ticks;
+
+	if ( argc != 1 ) {
+		printf ( "Usage:\n"
+			 "  %s\n"
+			 "\n"
+			 "Measure 802.11 encryption performance\n",
+			 argv[0] );
+		return 1;
+	}
+
+	/* Construct a data frame sent towards the AP */
+	iob = alloc_iob ( IEEE80211_TYP_FRAME_HEADER_LEN + WLAN_BENCH_LEN );
+	if ( ! iob ) {
+		printf ( "Could not allocate buffer\n" );
+		return 1;
+	}
+	hdr = iob_put ( iob, IEEE80211_TYP_FRAME_HEADER_LEN );
+	memset ( hdr, 0, IEEE80211_TYP_FRAME_HEADER_LEN );
+	hdr->fc = ( IEEE80211_THIS_VERSION | IEEE80211_TYPE_DATA |
+		    IEEE80211_STYPE_DATA | IEEE80211_FC_TODS );
+	memset ( iob_put ( iob, WLAN_BENCH_LEN ), 0, WLAN_BENCH_LEN );
+
+	printf ( "CPU ticks per %d-byte frame:\n", WLAN_BENCH_LEN );
+	for_each_table_entry ( template, NET80211_CRYPTOS ) {
+		if ( wlan_bench_cycle ( template, iob, &encrypt_ticks,
+					&decrypt_ticks ) != 0 ) {
+			printf ( "  %s: FAILED\n",
+				 wlan_bench_names[template->algorithm] );
+			continue;
+		}
+		printf ( "  %s encrypt: %ld\n  %s decrypt: %ld\n",
+			 wlan_bench_names[template->algorithm], encrypt_ticks,
+			 wlan_bench_names[template->algorithm], decrypt_ticks );
+	}
+
+	free_iob ( iob );
+	return 0;
+}
+
+/** Cryptographic benchmark commands */
+struct command bench_commands[] __command = {
+	{
+		.name = "cipherbench",
+		.exec = cipherbench_exec,
+	},
+	{
+		.name = "digestbench",
+		.exec = digestbench_exec,
+	},
+	{
+		.name = "rsabench",
+		.exec = rsabench_exec,
+	},
+	{
+		.name = "wlanbench",
+		.exec = wlanbench_exec,
+	},
+};
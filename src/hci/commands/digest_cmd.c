@@ -22,9 +22,11 @@
 #include <gpxe/command.h>
 #include <gpxe/image.h>
 #include <gpxe/crypto.h>
+#include <gpxe/base16.h>
 
 #include <gpxe/md5.h>
 #include <gpxe/sha1.h>
+#include <gpxe/sha256.h>
 
 /**
  * "digest" command syntax message
@@ -51,12 +53,7 @@ static int digest_exec ( int argc, char **argv,
 			 struct digest_algorithm *digest ) {
 	const char *image_name;
 	struct image *image;
-	uint8_t digest_ctx[digest->ctxsize];
 	uint8_t digest_out[digest->digestsize];
-	uint8_t buf[128];
-	size_t offset;
-	size_t len;
-	size_t frag_len;
 	int i;
 	unsigned j;
 
@@ -76,21 +73,9 @@ static int digest_exec ( int argc, char **argv,
 			printf ( "No such image: %s\n", image_name );
 			continue;
 		}
-		offset = 0;
-		len = image->len;
-
-		/* calculate digest */
-		digest_init ( digest, digest_ctx );
-		while ( len ) {
-			frag_len = len;
-			if ( frag_len > sizeof ( buf ) )
-				frag_len = sizeof ( buf );
-			copy_from_user ( buf, image->data, offset, frag_len );
-			digest_update ( digest, digest_ctx, buf, frag_len );
-			len -= frag_len;
-			offset += frag_len;
-		}
-		digest_final ( digest, digest_ctx, digest_out );
+
+		/* calculate digest (or reuse digest from download) */
+		image_digest ( image, digest, digest_out );
 
 		for ( j = 0 ; j < sizeof ( digest_out ) ; j++ )
 			printf ( "%02x", digest_out[j] );
@@ -109,6 +94,87 @@ static int sha1sum_exec ( int argc, char **argv ) {
 	return digest_exec ( argc, argv, &sha1_algorithm );
 }
 
+static int sha256sum_exec ( int argc, char **argv ) {
+	return digest_exec ( argc, argv, &sha256_algorithm );
+}
+
+/**
+ * "imgverify" command syntax message
+ *
+ * @v argv		Argument list
+ */
+static void imgverify_syntax ( char **argv ) {
+	printf ( "Usage:\n"
+		 "  %s <image name> <digest>\n"
+		 "\n"
+		 "Verify the digest of an image\n",
+		 argv[0] );
+}
+
+/**
+ * The "imgverify" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Exit code
+ *
+ * The digest algorithm is inferred from the length of the expected
+ * digest, preferring the algorithm (if any) used while downloading
+ * the image.
+ */
+static int imgverify_exec ( int argc, char **argv ) {
+	const char *image_name;
+	const char *expected;
+	struct image *image;
+	struct digest_algorithm *digest;
+	int len;
+
+	if ( argc != 3 ) {
+		imgverify_syntax ( argv );
+		return 1;
+	}
+	image_name = argv[1];
+	expected = argv[2];
+
+	image = find_image ( image_name );
+	if ( ! image ) {
+		printf ( "No such image: %s\n", image_name );
+		return 1;
+	}
+
+	{
+		uint8_t raw[ base16_decoded_max_len ( expected ) ];
+
+		len = base16_decode ( expected, raw );
+		if ( len < 0 ) {
+			printf ( "Invalid digest \"%s\"\n", expected );
+			return 1;
+		}
+		digest = image->digest;
+		if ( ( ! digest ) || ( digest->digestsize != ( size_t ) len ) )
+			digest = find_digest_by_size ( len );
+		if ( ! digest ) {
+			printf ( "No digest algorithm for \"%s\"\n",
+				 expected );
+			return 1;
+		}
+
+		{
+			uint8_t digest_out[digest->digestsize];
+
+			image_digest ( image, digest, digest_out );
+			if ( memcmp ( digest_out, raw, len ) != 0 ) {
+				printf ( "%s: %s digest mismatch\n",
+					 image->name, digest->name );
+				return 1;
+			}
+		}
+	}
+
+	printf ( "%s: %s digest ok\n", image->name, digest->name );
+	return 0;
+}
+
 struct command md5sum_command __command = {
 	.name = "md5sum",
 	.exec = md5sum_exec,
@@ -118,3 +184,13 @@ struct command sha1sum_command __command = {
 	.name = "sha1sum",
 	.exec = sha1sum_exec,
 };
+
+struct command sha256sum_command __command = {
+	.name = "sha256sum",
+	.exec = sha256sum_exec,
+};
+
+struct command imgverify_command __command = {
+	.name = "imgverify",
+	.exec = imgverify_exec,
+};
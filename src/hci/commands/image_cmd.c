@@ -21,10 +21,13 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <errno.h>
 #include <libgen.h>
 #include <getopt.h>
 #include <gpxe/image.h>
+#include <gpxe/crypto.h>
+#include <gpxe/base16.h>
 #include <gpxe/command.h>
 #include <usr/imgmgmt.h>
 
@@ -74,6 +77,64 @@ static int imgfill_cmdline ( struct image *image, unsigned int nargs,
 	}
 }
 
+/**
+ * Fill in image digest
+ *
+ * @v image		Image
+ * @v name		Digest algorithm name, or NULL
+ * @v expected		Expected digest (in hex), or NULL
+ * @ret rc		Return status code
+ *
+ * If no algorithm name is specified, the algorithm is inferred from
+ * the length of the expected digest.
+ */
+static int imgfill_digest ( struct image *image, const char *name,
+			    const char *expected ) {
+	uint8_t raw[ base16_decoded_max_len ( expected ? expected : "" ) ];
+	struct digest_algorithm *digest = NULL;
+	int len = 0;
+
+	/* Decode expected digest, if any */
+	if ( expected ) {
+		len = base16_decode ( expected, raw );
+		if ( len < 0 ) {
+			printf ( "Invalid digest \"%s\"\n", expected );
+			return len;
+		}
+	}
+
+	/* Identify digest algorithm */
+	if ( name ) {
+		digest = find_digest ( name );
+		if ( ! digest ) {
+			printf ( "Unsupported digest \"%s\"\n", name );
+			return -ENOTSUP;
+		}
+	} else if ( expected ) {
+		digest = find_digest_by_size ( len );
+		if ( ! digest ) {
+			printf ( "No digest algorithm for \"%s\"\n",
+				 expected );
+			return -ENOTSUP;
+		}
+	}
+	image->digest = digest;
+
+	/* Record expected digest */
+	if ( expected ) {
+		if ( ( ( size_t ) len != digest->digestsize ) ||
+		     ( ( size_t ) len > sizeof ( image->digest_expected ) ) ) {
+			printf ( "Wrong length for %s digest\n",
+				 digest->name );
+			return -EINVAL;
+		}
+		memcpy ( image->digest_expected, raw, len );
+		image->flags |= IMAGE_DIGEST_EXPECTED;
+	}
+
+	return 0;
+}
+
 /**
  * "imgfetch"/"module"/"kernel" command syntax message
  *
@@ -87,7 +148,8 @@ static void imgfetch_core_syntax ( char **argv, enum image_action action ) {
 	};
 
 	printf ( "Usage:\n"
-		 "  %s [-n|--name <name>] filename [arguments...]\n"
+		 "  %s [-n|--name <name>] [-d|--digest <algorithm>]\n"
+		 "      [-e|--expect <digest>] filename [arguments...]\n"
 		 "\n"
 		 "%s executable/loadable image\n",
 		 argv[0], actions[action] );
@@ -108,23 +170,35 @@ static int imgfetch_core_exec ( struct image_type *image_type,
 	static struct option longopts[] = {
 		{ "help", 0, NULL, 'h' },
 		{ "name", required_argument, NULL, 'n' },
+		{ "digest", required_argument, NULL, 'd' },
+		{ "expect", required_argument, NULL, 'e' },
 		{ NULL, 0, NULL, 0 },
 	};
 	struct image *image;
 	const char *name = NULL;
+	const char *digest = NULL;
+	const char *expected = NULL;
 	char *filename;
 	int ( * image_register ) ( struct image *image );
 	int c;
 	int rc;
 
 	/* Parse options */
-	while ( ( c = getopt_long ( argc, argv, "hn:",
+	while ( ( c = getopt_long ( argc, argv, "hn:d:e:",
 				    longopts, NULL ) ) >= 0 ) {
 		switch ( c ) {
 		case 'n':
 			/* Set image name */
 			name = optarg;
 			break;
+		case 'd':
+			/* Set digest algorithm */
+			digest = optarg;
+			break;
+		case 'e':
+			/* Set expected digest */
+			expected = optarg;
+			break;
 		case 'h':
 			/* Display help text */
 		default:
@@ -159,6 +233,13 @@ static int imgfetch_core_exec ( struct image_type *image_type,
 	/* Set image type (if specified) */
 	image->type = image_type;
 
+	/* Set digest algorithm and expected digest (if specified) */
+	if ( ( digest || expected ) &&
+	     ( ( rc = imgfill_digest ( image, digest, expected ) ) != 0 ) ) {
+		image_put ( image );
+		return rc;
+	}
+
 	/* Fill in command line */
 	if ( ( rc = imgfill_cmdline ( image, ( argc - optind ),
 				      &argv[optind] ) ) != 0 )
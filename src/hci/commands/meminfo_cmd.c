@@ -0,0 +1,72 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdio.h>
+#include <string.h>
+#include <gpxe/command.h>
+#include <gpxe/malloc.h>
+
+/** @file
+ *
+ * Memory usage commands
+ *
+ */
+
+static int meminfo_exec ( int argc, char **argv ) {
+	struct heap_statistics stats;
+	struct heap_failure *failure;
+	struct memcache *cache;
+	unsigned int i;
+
+	if ( argc != 1 ) {
+		printf ( "Usage:\n"
+			 "  %s\n"
+			 "\n"
+			 "Show memory usage\n",
+			 argv[0] );
+		return 1;
+	}
+
+	mstats ( &stats );
+	printf ( "Heap:     %zu bytes\n", stats.total );
+	printf ( "Free:     %zu bytes in %u blocks (largest %zu)\n",
+		 stats.free, stats.blocks, stats.largest );
+	printf ( "Peak:     %zu bytes used\n", stats.max_used );
+	printf ( "Failures: %lu of %lu allocations\n",
+		 stats.failures, stats.allocs );
+	for ( i = 0 ; i < HEAP_FAILURE_CALLERS ; i++ ) {
+		failure = &stats.callers[i];
+		if ( ! failure->count )
+			break;
+		printf ( "  %p: %u failures (largest %zu bytes)\n",
+			 failure->caller, failure->count, failure->size );
+	}
+	for ( i = 0 ; i < NUM_MEMCACHES ; i++ ) {
+		cache = &memcaches[i];
+		printf ( "Cache %4zu/%4zu: %lu allocs, %lu hits, %u cached\n",
+			 cache->size, cache->align, cache->allocs,
+			 cache->hits, cache->count );
+	}
+
+	return 0;
+}
+
+struct command meminfo_command __command = {
+	.name = "meminfo",
+	.exec = meminfo_exec,
+};
@@ -3,12 +3,16 @@
 
 FILE_LICENCE ( GPL2_OR_LATER );
 
+#include <stddef.h>
+#include <errno.h>
+
 struct cipher_algorithm;
 
 /** Basic AES blocksize */
 #define AES_BLOCKSIZE 16
 
 #include "crypto/axtls/crypto.h"
+#include <bits/aes.h>
 
 /** AES context */
 struct aes_context {
@@ -16,13 +20,78 @@ struct aes_context {
 	AES_CTX axtls_ctx;
 	/** Cipher is being used for decrypting */
 	int decrypting;
+	/** Architecture-specific implementation is in use */
+	int accelerated;
+#ifdef __HAVE_ARCH_AES
+	/** Architecture-specific context */
+	struct aes_arch_context arch_ctx;
+#endif
 };
 
 /** AES context size */
 #define AES_CTX_SIZE sizeof ( struct aes_context )
 
+#ifndef __HAVE_ARCH_AES
+
+/**
+ * Set key for architecture-specific AES implementation
+ *
+ * @v aes_ctx		AES context, with AXTLS key schedule constructed
+ * @ret rc		Return status code
+ */
+static inline __attribute__ (( always_inline )) int
+aes_arch_setkey ( struct aes_context *aes_ctx __unused ) {
+	return -ENOTSUP;
+}
+
+/**
+ * Encrypt data using architecture-specific AES implementation
+ *
+ * @v aes_ctx		AES context
+ * @v src		Data to encrypt
+ * @v dst		Buffer for encrypted data
+ * @v len		Length of data
+ */
+static inline __attribute__ (( always_inline )) void
+aes_arch_encrypt ( struct aes_context *aes_ctx __unused,
+		   const void *src __unused, void *dst __unused,
+		   size_t len __unused ) {
+	/* Never called */
+}
+
+/**
+ * Decrypt data using architecture-specific AES implementation
+ *
+ * @v aes_ctx		AES context
+ * @v src		Data to decrypt
+ * @v dst		Buffer for decrypted data
+ * @v len		Length of data
+ */
+static inline __attribute__ (( always_inline )) void
+aes_arch_decrypt ( struct aes_context *aes_ctx __unused,
+		   const void *src __unused, void *dst __unused,
+		   size_t len __unused ) {
+	/* Never called */
+}
+
+#endif /* __HAVE_ARCH_AES */
+
+/**
+ * Force use of the generic AES implementation
+ *
+ * @v aes_ctx		AES context, with key already set
+ *
+ * This is intended for use only by self-tests and benchmarks, which
+ * need to compare the generic and architecture-specific
+ * implementations.
+ */
+static inline void aes_force_generic ( struct aes_context *aes_ctx ) {
+	aes_ctx->accelerated = 0;
+}
+
 extern struct cipher_algorithm aes_algorithm;
 extern struct cipher_algorithm aes_cbc_algorithm;
+extern struct cipher_algorithm aes_gcm_algorithm;
 
 int aes_wrap ( const void *kek, const void *src, void *dest, int nblk );
 int aes_unwrap ( const void *kek, const void *src, void *dest, int nblk );
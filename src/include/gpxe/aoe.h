@@ -101,6 +101,34 @@ struct aoehdr {
 #define AOE_ERR_CONFIG_EXISTS	4 /**< Config string present */
 #define AOE_ERR_BAD_VERSION	5 /**< Unsupported version */
 
+/** Maximum number of concurrently outstanding AoE ATA subcommands */
+#define AOE_MAX_OUTSTANDING 8
+
+struct aoe_session;
+
+/** An outstanding AoE ATA subcommand
+ *
+ * Each ATA command is split into subcommands of at most
+ * aoe_session::max_count sectors, each carried in a single AoE
+ * packet with its own tag and retransmission timer.
+ */
+struct aoe_subcommand {
+	/** AoE session */
+	struct aoe_session *aoe;
+	/** Tag for most recent transmission */
+	uint32_t tag;
+	/** Starting LBA */
+	uint64_t lba;
+	/** Subcommand is outstanding */
+	int busy;
+	/** Sector count */
+	unsigned int count;
+	/** Byte offset within command's data buffer */
+	size_t offset;
+	/** Retransmission timer */
+	struct retry_timer timer;
+};
+
 /** An AoE session */
 struct aoe_session {
 	/** Reference counter */
@@ -128,20 +156,34 @@ struct aoe_session {
 	struct ata_command *command;
 	/** Overall status of current ATA command */
 	unsigned int status;
-	/** Byte offset within command's data buffer */
+	/** Byte offset within command's data buffer of next subcommand */
 	unsigned int command_offset;
+	/** At least one subcommand of the current command has been issued */
+	int command_issued;
 	/** Return status code for command */
 	int rc;
 
-	/** Retransmission timer */
+	/** Maximum number of sectors per subcommand */
+	unsigned int max_count;
+	/** Maximum number of outstanding subcommands */
+	unsigned int window;
+	/** Outstanding subcommands */
+	struct aoe_subcommand subcmds[AOE_MAX_OUTSTANDING];
+
+	/** Retransmission timer for config command */
 	struct retry_timer timer;
 };
 
 #define AOE_STATUS_ERR_MASK	0x0f /**< Error portion of status code */ 
 #define AOE_STATUS_PENDING	0x80 /**< Command pending */
 
-/** Maximum number of sectors per packet */
-#define AOE_MAX_COUNT 2
+/** Maximum number of sectors per packet
+ *
+ * This is the limit imposed by the 8-bit sector count field; the
+ * actual limit is usually set by the network device's maximum packet
+ * length.
+ */
+#define AOE_MAX_COUNT 255
 
 extern void aoe_detach ( struct ata_device *ata );
 extern int aoe_attach ( struct ata_device *ata, struct net_device *netdev,
@@ -9,12 +9,18 @@
 
 FILE_LICENCE ( GPL2_OR_LATER );
 
+#include <stdint.h>
+#include <stddef.h>
+
+#define ASN1_END 0x00
+#define ASN1_BOOLEAN 0x01
 #define ASN1_INTEGER 0x02
 #define ASN1_BIT_STRING 0x03
 #define ASN1_OCTET_STRING 0x04
 #define ASN1_NULL 0x05
 #define ASN1_OID 0x06
 #define ASN1_SEQUENCE 0x30
+#define ASN1_SET 0x31
 #define ASN1_IP_ADDRESS 0x40
 #define ASN1_EXPLICIT_TAG 0xa0
 
@@ -28,7 +34,19 @@ struct asn1_cursor {
 	size_t len;
 };
 
+/**
+ * Extract ASN.1 type
+ *
+ * @v cursor		ASN.1 object cursor
+ * @ret type		Type of next object, or ASN1_END if none
+ */
+static inline unsigned int asn1_type ( const struct asn1_cursor *cursor ) {
+	return ( cursor->len ? *( ( const uint8_t * ) cursor->data ) :
+		 ASN1_END );
+}
+
 extern int asn1_enter ( struct asn1_cursor *cursor, unsigned int type );
 extern int asn1_skip ( struct asn1_cursor *cursor, unsigned int type );
+extern int asn1_shrink ( struct asn1_cursor *cursor, unsigned int type );
 
 #endif /* _GPXE_ASN1_H */
@@ -156,8 +156,33 @@ struct ata_command {
 	userptr_t data_in;
 	/** Command status code */
 	int rc;
+	/**
+	 * Handle command completion
+	 *
+	 * @v command		ATA command
+	 *
+	 * This method may be NULL.
+	 */
+	void ( * done ) ( struct ata_command *command );
 };
 
+/**
+ * Mark ATA command as complete
+ *
+ * @v command		ATA command
+ * @v rc		Return status code
+ *
+ * Called by the backing device once the command has completed.  The
+ * backing device must not touch the command after calling this
+ * function, and must be prepared to accept a new command from within
+ * the completion handler.
+ */
+static inline void ata_command_done ( struct ata_command *command, int rc ) {
+	command->rc = rc;
+	if ( command->done )
+		command->done ( command );
+}
+
 /**
  * Structure returned by ATA IDENTIFY command
  *
@@ -197,6 +222,11 @@ struct ata_device {
 	 * @v ata		ATA device
 	 * @v command		ATA command
 	 * @ret rc		Return status code
+	 *
+	 * Note that a successful return status code indicates only
+	 * that the ATA command was issued.  If the backing device
+	 * cannot accept another outstanding command, it must return
+	 * BLOCKDEV_FULL.
 	 */
 	int ( * command ) ( struct ata_device *ata,
 			    struct ata_command *command );
@@ -0,0 +1,76 @@
+#ifndef _GPXE_BLOCKCACHE_H
+#define _GPXE_BLOCKCACHE_H
+
+/**
+ * @file
+ *
+ * Block device cache
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <gpxe/list.h>
+#include <gpxe/uaccess.h>
+#include <gpxe/blockdev.h>
+
+/** Length of a block cache line (in bytes) */
+#define BLOCK_CACHE_LINE_LEN 32768
+
+/** Number of lines in a block cache */
+#define BLOCK_CACHE_LINES 64
+
+/** Maximum number of lines fetched by a single underlying read */
+#define BLOCK_CACHE_MAX_FETCH 8
+
+/** A block cache line */
+struct block_cache_line {
+	/** List of lines, most recently used first */
+	struct list_head list;
+	/** First block number */
+	uint64_t block;
+	/** Number of valid blocks (zero if line is unused) */
+	unsigned long count;
+	/** Offset of line data within cache data */
+	size_t offset;
+};
+
+/** A block cache */
+struct block_cache {
+	/** Block device presenting the cached view */
+	struct block_device blockdev;
+	/** Underlying block device */
+	struct block_device *backing;
+
+	/** Cache data (or UNULL if cache is disabled) */
+	userptr_t data;
+	/** Staging area for multi-line fetches */
+	userptr_t staging;
+	/** Number of blocks per cache line (a power of two) */
+	unsigned long line_blocks;
+	/** Cache lines */
+	struct block_cache_line lines[BLOCK_CACHE_LINES];
+	/** List of cache lines, most recently used first */
+	struct list_head lru;
+
+	/** Block following the end of the most recent read */
+	uint64_t next_block;
+	/** Current read-ahead window (in cache lines) */
+	unsigned int readahead;
+
+	/** Number of reads satisfied from the cache */
+	unsigned long hits;
+	/** Number of reads requiring an underlying read */
+	unsigned long misses;
+	/** Number of cache lines fetched ahead of use */
+	unsigned long prefetched;
+	/** Number of writes */
+	unsigned long writes;
+};
+
+extern void init_block_cache ( struct block_cache *cache,
+			       struct block_device *backing );
+extern void free_block_cache ( struct block_cache *cache );
+
+#endif /* _GPXE_BLOCKCACHE_H */
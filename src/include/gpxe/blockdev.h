@@ -10,10 +10,38 @@
 
 FILE_LICENCE ( GPL2_OR_LATER );
 
+#include <stdint.h>
+#include <gpxe/list.h>
 #include <gpxe/uaccess.h>
 
 struct block_device;
 
+/** A block I/O request */
+struct block_request {
+	/** List of requests awaiting submission to the device */
+	struct list_head list;
+	/** Block device */
+	struct block_device *blockdev;
+	/** Request is a write (rather than a read) */
+	int write;
+	/** Starting block number */
+	uint64_t block;
+	/** Block count */
+	unsigned long count;
+	/** Data buffer */
+	userptr_t buffer;
+	/**
+	 * Handle request completion
+	 *
+	 * @v request	Block I/O request
+	 *
+	 * This method may be NULL.  It may submit further requests.
+	 */
+	void ( * done ) ( struct block_request *request );
+	/** Status code (-EINPROGRESS until the request completes) */
+	int rc;
+};
+
 /** Block device operations */
 struct block_device_operations {
 	/**
@@ -38,8 +66,37 @@ struct block_device_operations {
 	 */
 	int ( * write ) ( struct block_device *blockdev, uint64_t block,
 			  unsigned long count, userptr_t buffer );
+	/**
+	 * Submit block I/O request
+	 *
+	 * @v blockdev	Block device
+	 * @v request	Block I/O request
+	 * @ret rc	Return status code
+	 *
+	 * This method may be NULL, in which case requests will be
+	 * serviced synchronously via the read() and write() methods.
+	 *
+	 * A successful return status code indicates only that the
+	 * request was accepted; the device must eventually call
+	 * block_request_done().  If the device cannot accept any
+	 * more outstanding requests, it must return BLOCKDEV_FULL;
+	 * the request will be resubmitted once an earlier request
+	 * has completed.
+	 */
+	int ( * submit ) ( struct block_device *blockdev,
+			   struct block_request *request );
 };
 
+/** Device cannot accept any more outstanding requests
+ *
+ * Returned by a block device's submit() method, and by the command()
+ * method of a SCSI or ATA device's backing device.  This is positive
+ * so that it cannot be confused with an error; error numbers
+ * incorporate the file in which they arise, so there is no single
+ * value of -ENOBUFS that every device could return.
+ */
+#define BLOCKDEV_FULL 1
+
 /** A block device */
 struct block_device {
 	/** Block device operations */
@@ -48,6 +105,31 @@ struct block_device {
 	size_t blksize;
 	/** Total number of blocks */
 	uint64_t blocks;
+	/** Requests awaiting submission to the device */
+	struct list_head queue;
+	/** Queue is currently being submitted to the device */
+	int submitting;
 };
 
+/**
+ * Initialise block device
+ *
+ * @v blockdev		Block device
+ * @v op		Block device operations
+ */
+static inline void blockdev_init ( struct block_device *blockdev,
+				   struct block_device_operations *op ) {
+	blockdev->op = op;
+	INIT_LIST_HEAD ( &blockdev->queue );
+}
+
+extern void block_submit ( struct block_device *blockdev,
+			   struct block_request *request );
+extern void block_request_done ( struct block_request *request, int rc );
+extern int block_request_in_progress ( struct block_request *request );
+extern int block_sync_read ( struct block_device *blockdev, uint64_t block,
+			     unsigned long count, userptr_t buffer );
+extern int block_sync_write ( struct block_device *blockdev, uint64_t block,
+			      unsigned long count, userptr_t buffer );
+
 #endif /* _GPXE_BLOCKDEV_H */
@@ -0,0 +1,35 @@
+#ifndef _GPXE_CRC32C_H
+#define _GPXE_CRC32C_H
+
+/** @file
+ *
+ * CRC32C (Castagnoli) checksum
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <bits/crc32c.h>
+
+extern uint32_t crc32c_le_generic ( uint32_t seed, const void *data,
+				    size_t len );
+
+#ifndef __HAVE_ARCH_CRC32C
+
+/**
+ * Calculate 32-bit little-endian CRC32C checksum
+ *
+ * @v seed		Initial value
+ * @v data		Data to checksum
+ * @v len		Length of data
+ * @ret crc		CRC32C checksum
+ */
+static inline __attribute__ (( always_inline )) uint32_t
+crc32c_le ( uint32_t seed, const void *data, size_t len ) {
+	return crc32c_le_generic ( seed, data, len );
+}
+
+#endif /* __HAVE_ARCH_CRC32C */
+
+#endif /* _GPXE_CRC32C_H */
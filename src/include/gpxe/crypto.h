@@ -11,6 +11,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 
 #include <stdint.h>
 #include <stddef.h>
+#include <gpxe/tables.h>
 
 /** A message digest algorithm */
 struct digest_algorithm {
@@ -44,6 +45,17 @@ struct digest_algorithm {
 	void ( * final ) ( void *ctx, void *out );
 };
 
+/** Digest algorithm table
+ *
+ * Only algorithms which are already linked in for some other reason
+ * will appear in this table.
+ */
+#define DIGEST_ALGORITHMS \
+	__table ( struct digest_algorithm, "digest_algorithms" )
+
+/** Declare a digest algorithm */
+#define __digest_algorithm __table_entry ( DIGEST_ALGORITHMS, 01 )
+
 /** A cipher algorithm */
 struct cipher_algorithm {
 	/** Algorithm name */
@@ -52,6 +64,12 @@ struct cipher_algorithm {
 	size_t ctxsize;
 	/** Block size */
 	size_t blocksize;
+	/** Authentication tag size
+	 *
+	 * This is zero for ciphers which do not provide
+	 * authenticated encryption.
+	 */
+	size_t authsize;
 	/** Set key
 	 *
 	 * @v ctx		Context
@@ -74,6 +92,11 @@ struct cipher_algorithm {
 	 * @v len		Length of data
 	 *
 	 * @v len is guaranteed to be a multiple of @c blocksize.
+	 *
+	 * For an authenticated encryption cipher, @c dst may be NULL,
+	 * in which case @c src is additional data to be authenticated
+	 * but not encrypted.  All additional data must precede the
+	 * data to be encrypted.
 	 */
 	void ( * encrypt ) ( void *ctx, const void *src, void *dst,
 			     size_t len );
@@ -85,9 +108,21 @@ struct cipher_algorithm {
 	 * @v len		Length of data
 	 *
 	 * @v len is guaranteed to be a multiple of @c blocksize.
+	 *
+	 * For an authenticated encryption cipher, @c dst may be NULL,
+	 * as for encrypt().
 	 */
 	void ( * decrypt ) ( void *ctx, const void *src, void *dst,
 			     size_t len );
+	/** Generate authentication tag
+	 *
+	 * @v ctx		Context
+	 * @v auth		Buffer for authentication tag
+	 *
+	 * This is present only for authenticated encryption ciphers.
+	 * The tag covers all data processed since the IV was set.
+	 */
+	void ( * auth ) ( void *ctx, void *auth );
 };
 
 /** A public key algorithm */
@@ -143,10 +178,22 @@ static inline void cipher_decrypt ( struct cipher_algorithm *cipher,
 	cipher_decrypt ( (cipher), (ctx), (src), (dst), (len) );	\
 	} while ( 0 )
 
+static inline void cipher_auth ( struct cipher_algorithm *cipher,
+				 void *ctx, void *auth ) {
+	cipher->auth ( ctx, auth );
+}
+
 static inline int is_stream_cipher ( struct cipher_algorithm *cipher ) {
 	return ( cipher->blocksize == 1 );
 }
 
+static inline int is_auth_cipher ( struct cipher_algorithm *cipher ) {
+	return ( cipher->authsize != 0 );
+}
+
+extern struct digest_algorithm * find_digest ( const char *name );
+extern struct digest_algorithm * find_digest_by_size ( size_t digestsize );
+
 extern struct digest_algorithm digest_null;
 extern struct cipher_algorithm cipher_null;
 extern struct pubkey_algorithm pubkey_null;
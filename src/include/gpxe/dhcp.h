@@ -237,6 +237,14 @@ struct dhcp_client_id {
 /** User class identifier */
 #define DHCP_USER_CLASS_ID 77
 
+/** Rapid Commit
+ *
+ * This option has no data.  A client includes it in a DHCPDISCOVER
+ * to indicate that it will accept an immediate DHCPACK (as defined
+ * in RFC 4039), and a server includes it in such a DHCPACK.
+ */
+#define DHCP_RAPID_COMMIT 80
+
 /** Client system architecture */
 #define DHCP_CLIENT_ARCHITECTURE 93
 
@@ -395,6 +403,55 @@ struct dhcp_netdev_desc {
  */
 #define DHCP_EB_SCRIPTLET DHCP_ENCAP_OPT ( DHCP_EB_ENCAP, 0xc2 )
 
+/** Send iSCSI unsolicited data
+ *
+ * If set to zero, gPXE will request InitialR2T=Yes and
+ * ImmediateData=No during iSCSI login, and so will never send write
+ * data until solicited by the target.
+ */
+#define DHCP_EB_ISCSI_IMMEDIATE_DATA DHCP_ENCAP_OPT ( DHCP_EB_ENCAP, 0xc3 )
+
+/** iSCSI maximum receive data segment length
+ *
+ * This is the MaxRecvDataSegmentLength that gPXE will declare during
+ * iSCSI login.
+ */
+#define DHCP_EB_ISCSI_MAX_RECV_LEN DHCP_ENCAP_OPT ( DHCP_EB_ENCAP, 0xc4 )
+
+/** iSCSI maximum outstanding R2Ts
+ *
+ * This is the MaxOutstandingR2T that gPXE will offer during iSCSI
+ * login.
+ */
+#define DHCP_EB_ISCSI_MAX_R2T DHCP_ENCAP_OPT ( DHCP_EB_ENCAP, 0xc5 )
+
+/** Require iSCSI digests
+ *
+ * If set to a non-zero value, gPXE will require CRC32C header and
+ * data digests during iSCSI login.  Otherwise, gPXE will prefer not
+ * to use digests but will accept them if the target insists.
+ */
+#define DHCP_EB_ISCSI_DIGESTS DHCP_ENCAP_OPT ( DHCP_EB_ENCAP, 0xc6 )
+
+/** SRP maximum outstanding commands
+ *
+ * This is the maximum number of SRP_CMD IUs that gPXE will have
+ * outstanding at any one time, subject to the request limit granted
+ * by the target.
+ */
+#define DHCP_EB_SRP_MAX_CMDS DHCP_ENCAP_OPT ( DHCP_EB_ENCAP, 0xc7 )
+
+/** Cached WPA pairwise master key
+ *
+ * This holds the PMK most recently derived from a WPA passphrase,
+ * along with a check value identifying the ESSID and passphrase from
+ * which it was derived, so that the expensive derivation can be
+ * avoided on subsequent boots.  It is expected that this option's
+ * value will be held in non-volatile storage, rather than transmitted
+ * as part of a DHCP packet.
+ */
+#define DHCP_EB_WPA_PMK DHCP_ENCAP_OPT ( DHCP_EB_ENCAP, 0xc8 )
+
 /** gPXE version number */
 #define DHCP_EB_VERSION DHCP_ENCAP_OPT ( DHCP_EB_ENCAP, 0xeb )
 
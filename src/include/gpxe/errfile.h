@@ -133,6 +133,8 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #define ERRFILE_linda		     ( ERRFILE_DRIVER | 0x00730000 )
 #define ERRFILE_ata		     ( ERRFILE_DRIVER | 0x00740000 )
 #define ERRFILE_srp		     ( ERRFILE_DRIVER | 0x00750000 )
+#define ERRFILE_blockdev	     ( ERRFILE_DRIVER | 0x00760000 )
+#define ERRFILE_ibloop		     ( ERRFILE_DRIVER | 0x00770000 )
 
 #define ERRFILE_aoe			( ERRFILE_NET | 0x00000000 )
 #define ERRFILE_arp			( ERRFILE_NET | 0x00010000 )
@@ -211,6 +213,9 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #define ERRFILE_login_ui	      ( ERRFILE_OTHER | 0x00170000 )
 #define ERRFILE_ib_srpboot	      ( ERRFILE_OTHER | 0x00180000 )
 #define ERRFILE_iwmgmt		      ( ERRFILE_OTHER | 0x00190000 )
+#define ERRFILE_gcm		      ( ERRFILE_OTHER | 0x001a0000 )
+#define ERRFILE_tls_test	      ( ERRFILE_OTHER | 0x001b0000 )
+#define ERRFILE_myri10ge_test	      ( ERRFILE_OTHER | 0x001c0000 )
 
 /** @} */
 
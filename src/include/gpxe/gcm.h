@@ -0,0 +1,161 @@
+#ifndef _GPXE_GCM_H
+#define _GPXE_GCM_H
+
+/** @file
+ *
+ * Galois/Counter Mode (GCM)
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <gpxe/crypto.h>
+
+/** GCM block size
+ *
+ * GCM is defined only for ciphers with a 128-bit block size.
+ */
+#define GCM_BLOCKSIZE 16
+
+/** GCM initialisation vector length
+ *
+ * Only the recommended 96-bit IV length is supported.
+ */
+#define GCM_IV_LEN 12
+
+/** GCM authentication tag length */
+#define GCM_AUTH_LEN 16
+
+/** A GCM block */
+union gcm_block {
+	/** Raw bytes */
+	uint8_t byte[GCM_BLOCKSIZE];
+	/** Dwords */
+	uint32_t dword[ GCM_BLOCKSIZE / 4 ];
+	/** Qwords */
+	uint64_t qword[ GCM_BLOCKSIZE / 8 ];
+};
+
+/** GCM context */
+struct gcm_context {
+	/** Hash key (H) */
+	union gcm_block key;
+	/** Accumulated hash (X) */
+	union gcm_block hash;
+	/** Counter block (Y) */
+	union gcm_block ctr;
+	/** Encrypted initial counter block, used to mask the tag */
+	union gcm_block mask;
+	/** Keystream for the current partial block */
+	union gcm_block keystream;
+	/** Length of additional data */
+	uint64_t add_len;
+	/** Length of encrypted data */
+	uint64_t data_len;
+	/** Multiples of hash key (high halves), for generic GHASH */
+	uint64_t hh[16];
+	/** Multiples of hash key (low halves), for generic GHASH */
+	uint64_t hl[16];
+	/** Architecture-specific GHASH may be used */
+	int accelerated;
+};
+
+#include <bits/gcm.h>
+
+#ifndef __HAVE_ARCH_GHASH
+
+static inline int gcm_arch_supported ( void ) {
+	return 0;
+}
+
+static inline void gcm_arch_ghash ( union gcm_block *hash __unused,
+				    const union gcm_block *key __unused,
+				    const void *data __unused,
+				    size_t blocks __unused ) {
+	/* Never called */
+}
+
+#endif /* __HAVE_ARCH_GHASH */
+
+/**
+ * Force use of generic GHASH implementation
+ *
+ * @v ctx		GCM cipher context
+ *
+ * Must be called after setting the key.  This is intended for use by
+ * self-tests and benchmarks.  The GCM context is the first member of
+ * any cipher context created using GCM_CIPHER().
+ */
+static inline void gcm_force_generic ( void *ctx ) {
+	struct gcm_context *gcm_ctx = ctx;
+
+	gcm_ctx->accelerated = 0;
+}
+
+extern int gcm_setkey ( struct gcm_context *ctx, const void *key,
+			size_t keylen, struct cipher_algorithm *raw_cipher,
+			void *raw_ctx );
+extern void gcm_setiv ( struct gcm_context *ctx, const void *iv,
+			struct cipher_algorithm *raw_cipher, void *raw_ctx );
+extern void gcm_encrypt ( struct gcm_context *ctx, const void *src,
+			  void *dst, size_t len,
+			  struct cipher_algorithm *raw_cipher, void *raw_ctx );
+extern void gcm_decrypt ( struct gcm_context *ctx, const void *src,
+			  void *dst, size_t len,
+			  struct cipher_algorithm *raw_cipher, void *raw_ctx );
+extern void gcm_auth ( struct gcm_context *ctx, void *auth );
+
+/**
+ * Create a Galois/Counter mode of behaviour of an existing cipher
+ *
+ * @v _gcm_name		Name for the new GCM cipher
+ * @v _gcm_cipher	New cipher algorithm
+ * @v _raw_cipher	Underlying cipher algorithm
+ * @v _raw_context	Context structure for the underlying cipher
+ */
+#define GCM_CIPHER( _gcm_name, _gcm_cipher, _raw_cipher, _raw_context )	\
+struct _gcm_name ## _context {						\
+	struct gcm_context gcm_ctx;					\
+	_raw_context raw_ctx;						\
+};									\
+static int _gcm_name ## _setkey ( void *ctx, const void *key,		\
+				  size_t keylen ) {			\
+	struct _gcm_name ## _context * _gcm_name ## _ctx = ctx;		\
+	return gcm_setkey ( &_gcm_name ## _ctx->gcm_ctx, key, keylen,	\
+			    &_raw_cipher, &_gcm_name ## _ctx->raw_ctx );\
+}									\
+static void _gcm_name ## _setiv ( void *ctx, const void *iv ) {		\
+	struct _gcm_name ## _context * _gcm_name ## _ctx = ctx;		\
+	gcm_setiv ( &_gcm_name ## _ctx->gcm_ctx, iv,			\
+		    &_raw_cipher, &_gcm_name ## _ctx->raw_ctx );	\
+}									\
+static void _gcm_name ## _encrypt ( void *ctx, const void *src,		\
+				    void *dst, size_t len ) {		\
+	struct _gcm_name ## _context * _gcm_name ## _ctx = ctx;		\
+	gcm_encrypt ( &_gcm_name ## _ctx->gcm_ctx, src, dst, len,	\
+		      &_raw_cipher, &_gcm_name ## _ctx->raw_ctx );	\
+}									\
+static void _gcm_name ## _decrypt ( void *ctx, const void *src,		\
+				    void *dst, size_t len ) {		\
+	struct _gcm_name ## _context * _gcm_name ## _ctx = ctx;		\
+	gcm_decrypt ( &_gcm_name ## _ctx->gcm_ctx, src, dst, len,	\
+		      &_raw_cipher, &_gcm_name ## _ctx->raw_ctx );	\
+}									\
+static void _gcm_name ## _auth ( void *ctx, void *auth ) {		\
+	struct _gcm_name ## _context * _gcm_name ## _ctx = ctx;		\
+	gcm_auth ( &_gcm_name ## _ctx->gcm_ctx, auth );			\
+}									\
+struct cipher_algorithm _gcm_cipher = {					\
+	.name		= #_gcm_name,					\
+	.ctxsize	= sizeof ( struct _gcm_name ## _context ),	\
+	.blocksize	= 1,						\
+	.authsize	= GCM_AUTH_LEN,					\
+	.setkey		= _gcm_name ## _setkey,				\
+	.setiv		= _gcm_name ## _setiv,				\
+	.encrypt	= _gcm_name ## _encrypt,			\
+	.decrypt	= _gcm_name ## _decrypt,			\
+	.auth		= _gcm_name ## _auth,				\
+};
+
+#endif /* _GPXE_GCM_H */
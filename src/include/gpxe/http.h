@@ -18,6 +18,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 extern int http_open_filter ( struct xfer_interface *xfer, struct uri *uri,
 			      unsigned int default_port,
 			      int ( * filter ) ( struct xfer_interface *,
+						 const char *,
 						 struct xfer_interface ** ) );
 
 #endif /* _GPXE_HTTP_H */
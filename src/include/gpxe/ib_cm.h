@@ -14,6 +14,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 
 struct ib_mad_transaction;
 struct ib_connection;
+struct ib_listener;
 
 /** Infiniband connection operations */
 struct ib_connection_operations {
@@ -53,13 +54,82 @@ struct ib_connection {
 	struct ib_path *path;
 	/** Connection request management transaction */
 	struct ib_mad_transaction *madx;
+	/** Listener which accepted the connection, if any */
+	struct ib_listener *listener;
 
-	/** Length of connection request private data */
+	/** Length of connection request (or reply) private data */
 	size_t private_data_len;
-	/** Connection request private data */
+	/** Connection request (or, for accepted connections, reply)
+	 * private data
+	 */
 	uint8_t private_data[0];
 };
 
+/** Infiniband connection listener operations */
+struct ib_listener_operations {
+	/** Accept incoming connection
+	 *
+	 * @v ibdev		Infiniband device
+	 * @v listener		Connection listener
+	 * @v conn		New connection
+	 * @v private_data	Connection request private data
+	 * @v private_data_len	Length of connection request private data
+	 * @ret qp		Queue pair for connection, or NULL to reject
+	 *
+	 * The queue pair's address vector and starting PSN will be
+	 * filled in from the connection request before the queue
+	 * pair is modified.  Subsequent changes of connection status
+	 * are reported via the listener's connection operations.
+	 */
+	struct ib_queue_pair * ( * accept ) ( struct ib_device *ibdev,
+					      struct ib_listener *listener,
+					      struct ib_connection *conn,
+					      void *private_data,
+					      size_t private_data_len );
+};
+
+/** An Infiniband connection listener */
+struct ib_listener {
+	/** Infiniband device */
+	struct ib_device *ibdev;
+	/** Service ID */
+	struct ib_gid_half service_id;
+	/** Listener operations */
+	struct ib_listener_operations *op;
+	/** Operations for accepted connections */
+	struct ib_connection_operations *conn_op;
+	/** List of listeners */
+	struct list_head list;
+	/** Owner private data */
+	void *owner_priv;
+	/** Length of connection reply private data */
+	size_t private_data_len;
+	/** Connection reply private data */
+	uint8_t private_data[0];
+};
+
+/**
+ * Set Infiniband connection listener owner-private data
+ *
+ * @v listener		Connection listener
+ * @v priv		Private data
+ */
+static inline __always_inline void
+ib_listener_set_ownerdata ( struct ib_listener *listener, void *priv ) {
+	listener->owner_priv = priv;
+}
+
+/**
+ * Get Infiniband connection listener owner-private data
+ *
+ * @v listener		Connection listener
+ * @ret priv		Private data
+ */
+static inline __always_inline void *
+ib_listener_get_ownerdata ( struct ib_listener *listener ) {
+	return listener->owner_priv;
+}
+
 extern struct ib_connection *
 ib_create_conn ( struct ib_device *ibdev, struct ib_queue_pair *qp,
 		 struct ib_gid *dgid, struct ib_gid_half *service_id,
@@ -68,5 +138,12 @@ ib_create_conn ( struct ib_device *ibdev, struct ib_queue_pair *qp,
 extern void ib_destroy_conn ( struct ib_device *ibdev,
 			      struct ib_queue_pair *qp,
 			      struct ib_connection *conn );
+extern struct ib_listener *
+ib_create_listener ( struct ib_device *ibdev, struct ib_gid_half *service_id,
+		     void *rep_private_data, size_t rep_private_data_len,
+		     struct ib_listener_operations *op,
+		     struct ib_connection_operations *conn_op );
+extern void ib_destroy_listener ( struct ib_device *ibdev,
+				  struct ib_listener *listener );
 
 #endif /* _GPXE_IB_CM_H */
@@ -298,7 +298,7 @@ union ib_sa_data {
 #define IB_CM_ATTR_READY_TO_USE			0x0014
 #define IB_CM_ATTR_DISCONNECT_REQUEST		0x0015
 #define IB_CM_ATTR_DISCONNECT_REPLY		0x0016
-#define IB_CM_ATTR_SERVICE_ID_RES_REQ		0x0016
+#define IB_CM_ATTR_SERVICE_ID_RES_REQ		0x0017
 #define IB_CM_ATTR_SERVICE_ID_RES_REQ_RESP	0x0018
 #define IB_CM_ATTR_LOAD_ALTERNATE_PATH		0x0019
 #define IB_CM_ATTR_ALTERNATE_PATH_RESPONSE	0x001a
@@ -451,6 +451,34 @@ struct ib_cm_ready_to_use {
 	uint8_t private_data[224];
 } __attribute__ (( packed ));
 
+/** A communication management disconnection request
+ *
+ * Defined in section 12.6.10 of the IBA.
+ */
+struct ib_cm_disconnect_request {
+	/** Local communication ID */
+	uint32_t local_id;
+	/** Remote communication ID */
+	uint32_t remote_id;
+	/** Remote QPN */
+	uint32_t remote_qpn;
+	/** Private data */
+	uint8_t private_data[220];
+} __attribute__ (( packed ));
+
+/** A communication management disconnection reply
+ *
+ * Defined in section 12.6.11 of the IBA.
+ */
+struct ib_cm_disconnect_reply {
+	/** Local communication ID */
+	uint32_t local_id;
+	/** Remote communication ID */
+	uint32_t remote_id;
+	/** Private data */
+	uint8_t private_data[224];
+} __attribute__ (( packed ));
+
 /** A communication management attribute */
 union ib_cm_data {
 	struct ib_cm_common common;
@@ -458,6 +486,8 @@ union ib_cm_data {
 	struct ib_cm_connect_reject connect_reject;
 	struct ib_cm_connect_reply connect_reply;
 	struct ib_cm_ready_to_use ready_to_use;
+	struct ib_cm_disconnect_request disconnect_request;
+	struct ib_cm_disconnect_reply disconnect_reply;
 	uint8_t bytes[232];
 } __attribute__ (( packed ));
 
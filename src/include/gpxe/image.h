@@ -17,6 +17,10 @@ FILE_LICENCE ( GPL2_OR_LATER );
 
 struct uri;
 struct image_type;
+struct digest_algorithm;
+
+/** Maximum length of an image digest (large enough for SHA-256) */
+#define IMAGE_DIGEST_MAX_LEN 32
 
 /** An executable or loadable image */
 struct image {
@@ -40,6 +44,17 @@ struct image {
 	/** Length of raw file image */
 	size_t len;
 
+	/** Digest algorithm
+	 *
+	 * If set before the image is downloaded, the digest of the
+	 * raw file image will be calculated as the data arrives.
+	 */
+	struct digest_algorithm *digest;
+	/** Digest of raw file image (valid if IMAGE_DIGEST is set) */
+	uint8_t digest_out[IMAGE_DIGEST_MAX_LEN];
+	/** Expected digest (valid if IMAGE_DIGEST_EXPECTED is set) */
+	uint8_t digest_expected[IMAGE_DIGEST_MAX_LEN];
+
 	/** Image type, if known */
 	struct image_type *type;
 	/** Image type private data */
@@ -68,6 +83,12 @@ struct image {
 /** Image is loaded */
 #define IMAGE_LOADED 0x0001
 
+/** Image digest has been calculated */
+#define IMAGE_DIGEST 0x0002
+
+/** Image has an expected digest */
+#define IMAGE_DIGEST_EXPECTED 0x0004
+
 /** An executable or loadable image type */
 struct image_type {
 	/** Name of this image type */
@@ -158,6 +179,11 @@ extern int image_autoload ( struct image *image );
 extern int image_exec ( struct image *image );
 extern int register_and_autoload_image ( struct image *image );
 extern int register_and_autoexec_image ( struct image *image );
+extern void image_digest_update ( struct image *image,
+				  struct digest_algorithm *digest, void *ctx,
+				  size_t offset, size_t len );
+extern void image_digest ( struct image *image,
+			   struct digest_algorithm *digest, void *out );
 
 /**
  * Increment reference count on an image
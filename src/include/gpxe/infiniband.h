@@ -114,6 +114,14 @@ struct ib_work_queue {
 	 * array index.
 	 */
 	unsigned long next_idx;
+	/** Receive buffer length
+	 *
+	 * This is used only for receive work queues, and defaults to
+	 * IB_MAX_PAYLOAD_SIZE.  Queue pairs carrying messages larger
+	 * than a single packet (e.g. RC queue pairs) may increase it
+	 * before filling the receive queue.
+	 */
+	size_t len;
 	/** I/O buffers assigned to work queue */
 	struct io_buffer **iobufs;
 	/** Driver private data */
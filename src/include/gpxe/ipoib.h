@@ -25,6 +25,9 @@ struct ipoib_mac {
 	struct ib_gid gid;
 } __attribute__ (( packed ));
 
+/** IPoIB MAC address flag indicating support for connected mode */
+#define IPOIB_MAC_FLAG_RC 0x80000000UL
+
 /** IPoIB link-layer header length */
 #define IPOIB_HLEN 4
 
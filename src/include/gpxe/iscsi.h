@@ -113,8 +113,10 @@ struct iscsi_bhs_common_response {
 	uint32_t statsn;
 	/** Expected command sequence number */
 	uint32_t expcmdsn;
+	/** Maximum command sequence number */
+	uint32_t maxcmdsn;
 	/** Fields specific to the PDU type */
-	uint8_t other_d[16];
+	uint8_t other_d[12];
 };
 
 /**
@@ -474,10 +476,14 @@ enum iscsi_tx_state {
 	ISCSI_TX_BHS,
 	/** Sending the additional header segment */
 	ISCSI_TX_AHS,
+	/** Sending the header digest */
+	ISCSI_TX_HEADER_DIGEST,
 	/** Sending the data segment */
 	ISCSI_TX_DATA,
 	/** Sending the data segment padding */
 	ISCSI_TX_DATA_PADDING,
+	/** Sending the data digest */
+	ISCSI_TX_DATA_DIGEST,
 };
 
 /** State of an iSCSI RX engine */
@@ -486,12 +492,120 @@ enum iscsi_rx_state {
 	ISCSI_RX_BHS = 0,
 	/** Receiving the additional header segment */
 	ISCSI_RX_AHS,
+	/** Receiving the header digest */
+	ISCSI_RX_HEADER_DIGEST,
 	/** Receiving the data segment */
 	ISCSI_RX_DATA,
 	/** Receiving the data segment padding */
 	ISCSI_RX_DATA_PADDING,
+	/** Receiving the data digest */
+	ISCSI_RX_DATA_DIGEST,
 };
 
+/** iSCSI header digest (CRC32C) is in use */
+#define ISCSI_DIGEST_HEADER 0x01
+
+/** iSCSI data digest (CRC32C) is in use */
+#define ISCSI_DIGEST_DATA 0x02
+
+/** Maximum number of concurrently outstanding iSCSI tasks
+ *
+ * Must be a power of two, since the low-order bits of each initiator
+ * task tag are used to index into the task table.
+ */
+#define ISCSI_MAX_TASKS 8
+
+/** Construct initiator task tag from sequence number and task index */
+#define ISCSI_TAG( seq, index ) ( ( (seq) * ISCSI_MAX_TASKS ) | (index) )
+
+/** Extract task index from initiator task tag */
+#define ISCSI_TAG_INDEX( itt ) ( (itt) & ( ISCSI_MAX_TASKS - 1 ) )
+
+/** Reserved target transfer tag (used for unsolicited data-out) */
+#define ISCSI_TAG_RESERVED 0xffffffffUL
+
+/** Maximum number of queued data-out transfers per task
+ *
+ * Must be a power of two.  One transfer is reserved for the initial
+ * unsolicited data-out sequence, leaving the remainder for
+ * outstanding R2Ts.
+ */
+#define ISCSI_MAX_TRANSFERS 8
+
+/** Maximum value of MaxOutstandingR2T that we support */
+#define ISCSI_MAX_OUTSTANDING_R2T ( ISCSI_MAX_TRANSFERS - 1 )
+
+/** Default value of MaxOutstandingR2T that we offer */
+#define ISCSI_DEFAULT_MAX_OUTSTANDING_R2T 4
+
+/** Default value of MaxRecvDataSegmentLength that we declare */
+#define ISCSI_DEFAULT_MAX_RECV_LEN 262144
+
+/** Minimum permitted value of MaxRecvDataSegmentLength */
+#define ISCSI_MIN_DATA_SEGMENT_LEN 512
+
+/** Maximum permitted value of MaxRecvDataSegmentLength */
+#define ISCSI_MAX_DATA_SEGMENT_LEN 0xffffff
+
+/** Value of MaxRecvDataSegmentLength assumed if not declared */
+#define ISCSI_RFC_MAX_RECV_LEN 8192
+
+/** Value of FirstBurstLength that we offer */
+#define ISCSI_FIRST_BURST_LEN 65536
+
+/** Value of MaxBurstLength that we offer */
+#define ISCSI_MAX_BURST_LEN 262144
+
+/** Maximum length of a transmitted data segment fragment
+ *
+ * Data segments may be up to the target's MaxRecvDataSegmentLength
+ * in size, which is far too large to allocate as a single I/O buffer
+ * from our small heap.
+ */
+#define ISCSI_TX_FRAG_LEN 2048
+
+/** An iSCSI data-out transfer
+ *
+ * This describes a sequence of data-out PDUs, either solicited by an
+ * R2T or sent unsolicited immediately after the SCSI command.
+ */
+struct iscsi_transfer {
+	/** Target transfer tag */
+	uint32_t ttt;
+	/** Offset within the data-out buffer */
+	uint32_t offset;
+	/** Length of the transfer */
+	uint32_t len;
+};
+
+/** An iSCSI task
+ *
+ * Each outstanding SCSI command occupies one entry in the session's
+ * task table, indexed by the low-order bits of its initiator task
+ * tag.
+ */
+struct iscsi_task {
+	/** SCSI command, or NULL if this task table entry is free */
+	struct scsi_command *command;
+	/** Initiator task tag */
+	uint32_t itt;
+	/** Task flags
+	 *
+	 * This is the bitwise-OR of zero or more ISCSI_TASK_XXX
+	 * constants.
+	 */
+	unsigned int flags;
+	/** Queued data-out transfers */
+	struct iscsi_transfer transfers[ISCSI_MAX_TRANSFERS];
+	/** Data-out transfer producer counter */
+	unsigned int transfer_prod;
+	/** Data-out transfer consumer counter */
+	unsigned int transfer_cons;
+};
+
+/** iSCSI task needs to send its SCSI command PDU */
+#define ISCSI_TASK_SEND_COMMAND 0x0001
+
 /** An iSCSI session */
 struct iscsi_session {
 	/** Reference counter */
@@ -542,46 +656,50 @@ struct iscsi_session {
 	/** CHAP response (used for both initiator and target auth) */
 	struct chap_response chap;
 
+	/** Use immediate data (as negotiated) */
+	int immediate_data;
+	/** Wait for an R2T before sending any data-out (as negotiated) */
+	int initial_r2t;
+	/** Maximum data segment length that the target will accept */
+	size_t max_send_len;
+	/** Maximum length of unsolicited data (as negotiated) */
+	size_t first_burst_len;
+	/** Digests in use (as negotiated)
+	 *
+	 * This is the bitwise-OR of zero or more ISCSI_DIGEST_XXX
+	 * constants.  Digests take effect only once the session
+	 * reaches the full feature phase.
+	 */
+	unsigned int digests;
+
 	/** Target session identifying handle
 	 *
 	 * This is assigned by the target when we first log in, and
 	 * must be reused on subsequent login attempts.
 	 */
 	uint16_t tsih;
-	/** Initiator task tag
+	/** Initiator task tag sequence number
 	 *
-	 * This is the tag of the current command.  It is incremented
-	 * whenever a new command is started.
+	 * This is incremented whenever a fresh initiator task tag is
+	 * required, either for a login request or for a new command.
 	 */
 	uint32_t itt;
-	/** Target transfer tag
-	 *
-	 * This is the tag attached to a sequence of data-out PDUs in
-	 * response to an R2T.
-	 */
-	uint32_t ttt;
-	/**
-	 * Transfer offset
-	 *
-	 * This is the offset for an in-progress sequence of data-out
-	 * PDUs in response to an R2T.
-	 */
-	uint32_t transfer_offset;
-	/**
-	 * Transfer length
-	 *
-	 * This is the length for an in-progress sequence of data-out
-	 * PDUs in response to an R2T.
-	 */
-	uint32_t transfer_len;
 	/** Command sequence number
 	 *
-	 * This is the sequence number of the current command, used to
-	 * fill out the CmdSN field in iSCSI request PDUs.  It is
-	 * updated with the value of the ExpCmdSN field whenever we
-	 * receive an iSCSI response PDU containing such a field.
+	 * This is the sequence number to be used for the next
+	 * command, used to fill out the CmdSN field in iSCSI request
+	 * PDUs.  It is initialised from the ExpCmdSN field of the
+	 * login response, and incremented whenever we send a
+	 * (non-immediate) SCSI command PDU.
 	 */
 	uint32_t cmdsn;
+	/** Maximum command sequence number
+	 *
+	 * This is the most recent value of the MaxCmdSN field in an
+	 * iSCSI response PDU.  We may not send a command with a CmdSN
+	 * beyond this value.
+	 */
+	uint32_t max_cmdsn;
 	/** Status sequence number
 	 *
 	 * This is the most recent status sequence number present in
@@ -591,8 +709,26 @@ struct iscsi_session {
 	 */
 	uint32_t statsn;
 	
+	/** Task table */
+	struct iscsi_task tasks[ISCSI_MAX_TASKS];
+
 	/** Basic header segment for current TX PDU */
 	union iscsi_bhs tx_bhs;
+	/** Task to which the current TX PDU belongs (if any) */
+	struct iscsi_task *tx_task;
+	/** Current data-out transfer */
+	struct iscsi_transfer tx_transfer;
+	/** Digests in use for current TX PDU */
+	unsigned int tx_digests;
+	/** Running CRC32C for current TX PDU data segment */
+	uint32_t tx_crc;
+	/** Offset within current TX PDU data segment
+	 *
+	 * Data-out segments are sent in fragments of at most
+	 * ISCSI_TX_FRAG_LEN bytes.  This is non-zero while a data
+	 * segment has been only partially sent.
+	 */
+	size_t tx_offset;
 	/** State of the TX engine */
 	enum iscsi_tx_state tx_state;
 	/** TX process */
@@ -608,12 +744,21 @@ struct iscsi_session {
 	size_t rx_len;
 	/** Buffer for received data (not always used) */
 	void *rx_buffer;
-
-	/** Current SCSI command
+	/** Digests in use for current RX PDU */
+	unsigned int rx_digests;
+	/** Running CRC32C for current RX PDU header or data segment */
+	uint32_t rx_crc;
+	/** Received digest */
+	uint32_t rx_digest;
+	/** Task completed by current RX PDU (if any)
 	 *
-	 * Set to NULL when command is complete.
+	 * Completion is deferred until the whole PDU (including any
+	 * data digest) has been received and verified.
 	 */
-	struct scsi_command *command;
+	struct iscsi_task *rx_task;
+	/** Return status code for task completed by current RX PDU */
+	int rx_task_rc;
+
 	/** Instant return code
 	 *
 	 * Set to a non-zero value if all requests should return
@@ -19,11 +19,74 @@ FILE_LICENCE ( GPL2_OR_LATER );
  */
 #include <stdlib.h>
 
+/** A size-class memory cache */
+struct memcache {
+	/** Block size */
+	size_t size;
+	/** Physical alignment of cached blocks */
+	size_t align;
+	/** Maximum number of cached free blocks */
+	unsigned int max;
+	/** Cached free blocks */
+	struct cached_block *free;
+	/** Number of cached free blocks */
+	unsigned int count;
+	/** Number of allocations within this size class */
+	unsigned long allocs;
+	/** Number of allocations satisfied from the cache */
+	unsigned long hits;
+	/** Number of frees within this size class */
+	unsigned long frees;
+};
+
+/** Number of size-class caches */
+#define NUM_MEMCACHES 15
+
+/** Number of distinct callers tracked for allocation failures */
+#define HEAP_FAILURE_CALLERS 8
+
+/** Allocation failures attributed to a single caller */
+struct heap_failure {
+	/** Caller address */
+	void *caller;
+	/** Number of failed allocations */
+	unsigned int count;
+	/** Largest failed allocation size */
+	size_t size;
+};
+
+/** Heap statistics */
+struct heap_statistics {
+	/** Total size of heap */
+	size_t total;
+	/** High-water mark of allocated memory */
+	size_t max_used;
+	/** Total free memory (including cached blocks) */
+	size_t free;
+	/** Size of largest free block on the heap */
+	size_t largest;
+	/** Number of free blocks on the heap */
+	unsigned int blocks;
+	/** Number of allocations made from the heap */
+	unsigned long allocs;
+	/** Number of blocks freed to the heap */
+	unsigned long frees;
+	/** Number of failed allocations */
+	unsigned long failures;
+	/** Failed allocations by caller */
+	struct heap_failure callers[HEAP_FAILURE_CALLERS];
+};
+
 extern size_t freemem;
+extern struct memcache memcaches[NUM_MEMCACHES];
 
 extern void * __malloc alloc_memblock ( size_t size, size_t align );
+extern void * __malloc alloc_memblock_caller ( size_t size, size_t align,
+					       void *caller );
 extern void free_memblock ( void *ptr, size_t size );
 extern void mpopulate ( void *start, size_t len );
+extern void mcache_flush ( void );
+extern void mstats ( struct heap_statistics *stats );
 extern void mdumpfree ( void );
 
 /**
@@ -41,6 +104,24 @@ static inline void * __malloc malloc_dma ( size_t size, size_t phys_align ) {
 	return alloc_memblock ( size, phys_align );
 }
 
+/**
+ * Allocate memory for DMA on behalf of a caller
+ *
+ * @v size		Requested size
+ * @v align		Physical alignment
+ * @v caller		Caller address, used for failure statistics
+ * @ret ptr		Memory, or NULL
+ *
+ * As for malloc_dma(), but any allocation failure is attributed to
+ * @c caller.  Wrappers such as alloc_iob() use this so that failures
+ * are reported against their own callers rather than the wrapper.
+ */
+static inline void * __malloc malloc_dma_caller ( size_t size,
+						  size_t phys_align,
+						  void *caller ) {
+	return alloc_memblock_caller ( size, phys_align, caller );
+}
+
 /**
  * Free memory allocated with malloc_dma()
  *
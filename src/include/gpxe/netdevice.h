@@ -307,9 +307,18 @@ struct net_device {
 	int link_rc;
 	/** Maximum packet length
 	 *
-	 * This length includes any link-layer headers.
+	 * This length includes any link-layer headers.  Packets of
+	 * this length can always be transmitted.
 	 */
 	size_t max_pkt_len;
+	/** Maximum transmission unit
+	 *
+	 * This is the largest network-layer packet which the device
+	 * can receive, excluding any link-layer headers.  It may
+	 * exceed the maximum packet length, if (for example) larger
+	 * packets can be exchanged only with some peers.
+	 */
+	size_t mtu;
 	/** TX packet queue */
 	struct list_head tx_queue;
 	/** RX packet queue */
@@ -51,5 +51,6 @@ extern void nvo_init ( struct nvo_block *nvo, struct nvs_device *nvs,
 		       struct nvo_fragment *fragments, struct refcnt *refcnt );
 extern int register_nvo ( struct nvo_block *nvo, struct settings *parent );
 extern void unregister_nvo ( struct nvo_block *nvo );
+extern int is_nvo_settings ( struct settings *settings );
 
 #endif /* _GPXE_NVO_H */
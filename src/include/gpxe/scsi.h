@@ -238,8 +238,34 @@ struct scsi_command {
 	uint8_t sense_response;
 	/** Command status code */
 	int rc;
+	/**
+	 * Handle command completion
+	 *
+	 * @v command		SCSI command
+	 *
+	 * This method may be NULL.
+	 */
+	void ( * done ) ( struct scsi_command *command );
 };
 
+/**
+ * Mark SCSI command as complete
+ *
+ * @v command		SCSI command
+ * @v rc		Return status code
+ *
+ * Called by the backing device once the command has completed.  The
+ * backing device must not touch the command after calling this
+ * function, and must be prepared to accept a new command from within
+ * the completion handler.
+ */
+static inline void scsi_command_done ( struct scsi_command *command,
+				       int rc ) {
+	command->rc = rc;
+	if ( command->done )
+		command->done ( command );
+}
+
 /** A SCSI LUN
  *
  * This is a four-level LUN as specified by SAM-2, in big-endian
@@ -266,6 +292,11 @@ struct scsi_device {
 	 * command completes and whether, for example, the device
 	 * returned CHECK CONDITION or some other non-success status
 	 * code.
+	 *
+	 * The backing device may accept further commands before this
+	 * command completes.  If it cannot accept any more
+	 * outstanding commands, it must return BLOCKDEV_FULL; the
+	 * caller may then retry once an earlier command has completed.
 	 */
 	int ( * command ) ( struct scsi_device *scsi,
 			    struct scsi_command *command );
@@ -275,6 +306,11 @@ struct scsi_device {
 
 extern int scsi_detached_command ( struct scsi_device *scsi,
 				   struct scsi_command *command );
+extern int scsi_command_in_progress ( struct scsi_command *command );
+extern int scsi_command_start ( struct scsi_device *scsi,
+				struct scsi_command *command );
+extern int scsi_command_result ( struct scsi_device *scsi,
+				 struct scsi_command *command );
 extern int init_scsidev ( struct scsi_device *scsi );
 extern int scsi_parse_lun ( const char *lun_string, struct scsi_lun *lun );
 
@@ -3,12 +3,63 @@
 
 FILE_LICENCE ( GPL2_OR_LATER );
 
+#include <stdint.h>
 #include "crypto/axtls/crypto.h"
 
 struct digest_algorithm;
 
-#define SHA1_CTX_SIZE sizeof ( SHA1_CTX )
-#define SHA1_DIGEST_SIZE SHA1_SIZE
+/** SHA-1 digest size */
+#define SHA1_DIGEST_SIZE 20
+
+/** SHA-1 block size */
+#define SHA1_BLOCK_SIZE 64
+
+/** SHA-1 context */
+struct sha1_ctx {
+	/** Intermediate hash value */
+	uint32_t hash[5];
+	/** Partial block */
+	union {
+		uint32_t dword[ SHA1_BLOCK_SIZE / 4 ];
+		uint8_t byte[SHA1_BLOCK_SIZE];
+	} block;
+	/** Total length of data processed */
+	uint64_t len;
+	/** Architecture-specific block function may be used */
+	int accelerated;
+};
+
+#define SHA1_CTX_SIZE sizeof ( struct sha1_ctx )
+
+#include <bits/sha.h>
+
+#ifndef __HAVE_ARCH_SHA1
+
+static inline int sha1_arch_supported ( void ) {
+	return 0;
+}
+
+static inline void sha1_arch_blocks ( uint32_t *hash __unused,
+				      const void *data __unused,
+				      size_t blocks __unused ) {
+	/* Never called */
+}
+
+#endif /* __HAVE_ARCH_SHA1 */
+
+/**
+ * Force use of generic SHA-1 implementation
+ *
+ * @v ctx		SHA-1 context
+ *
+ * Must be called after initialising the context.  This is intended
+ * for use by self-tests and benchmarks.
+ */
+static inline void sha1_force_generic ( void *ctx ) {
+	struct sha1_ctx *sha1_ctx = ctx;
+
+	sha1_ctx->accelerated = 0;
+}
 
 extern struct digest_algorithm sha1_algorithm;
 
@@ -0,0 +1,71 @@
+#ifndef _GPXE_SHA256_H
+#define _GPXE_SHA256_H
+
+/** @file
+ *
+ * SHA-256 algorithm
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+
+struct digest_algorithm;
+
+/** SHA-256 digest size */
+#define SHA256_DIGEST_SIZE 32
+
+/** SHA-256 block size */
+#define SHA256_BLOCK_SIZE 64
+
+/** SHA-256 context */
+struct sha256_ctx {
+	/** Intermediate hash value */
+	uint32_t hash[8];
+	/** Partial block */
+	union {
+		uint32_t dword[ SHA256_BLOCK_SIZE / 4 ];
+		uint8_t byte[SHA256_BLOCK_SIZE];
+	} block;
+	/** Total length of data processed */
+	uint64_t len;
+	/** Architecture-specific block function may be used */
+	int accelerated;
+};
+
+#define SHA256_CTX_SIZE sizeof ( struct sha256_ctx )
+
+#include <bits/sha.h>
+
+#ifndef __HAVE_ARCH_SHA256
+
+static inline int sha256_arch_supported ( void ) {
+	return 0;
+}
+
+static inline void sha256_arch_blocks ( uint32_t *hash __unused,
+					const void *data __unused,
+					size_t blocks __unused ) {
+	/* Never called */
+}
+
+#endif /* __HAVE_ARCH_SHA256 */
+
+/**
+ * Force use of generic SHA-256 implementation
+ *
+ * @v ctx		SHA-256 context
+ *
+ * Must be called after initialising the context.  This is intended
+ * for use by self-tests and benchmarks.
+ */
+static inline void sha256_force_generic ( void *ctx ) {
+	struct sha256_ctx *sha256_ctx = ctx;
+
+	sha256_ctx->accelerated = 0;
+}
+
+extern struct digest_algorithm sha256_algorithm;
+
+#endif /* _GPXE_SHA256_H */
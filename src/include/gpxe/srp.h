@@ -786,6 +786,27 @@ struct srp_aer_rsp {
 
 struct srp_device;
 
+/** Maximum number of concurrently outstanding SRP commands */
+#define SRP_MAX_OUTSTANDING 16
+
+/** Default maximum number of concurrently outstanding SRP commands
+ *
+ * This may be overridden via the "srp-max-cmds" setting.  The number
+ * of commands actually outstanding is also limited by the request
+ * limit granted by the target.
+ */
+#define SRP_DEFAULT_MAX_OUTSTANDING 8
+
+/** An SRP command slot */
+struct srp_task {
+	/** SCSI command, or NULL if slot is free */
+	struct scsi_command *command;
+	/** Tag of most recently sent SRP_CMD IU */
+	uint32_t tag;
+	/** SRP_CMD IU has been sent in the current session */
+	int sent;
+};
+
 /** An SRP transport type */
 struct srp_transport_type {
 	/** Length of transport private data */
@@ -828,8 +849,16 @@ struct srp_device {
 	unsigned int state;
 	/** Retry counter */
 	unsigned int retry_count;
-	/** Current SCSI command */
-	struct scsi_command *command;
+	/** Request limit
+	 *
+	 * This is the number of further SRP_CMD IUs that the target
+	 * has granted us permission to send.
+	 */
+	int32_t request_limit;
+	/** Maximum number of outstanding commands */
+	unsigned int max_outstanding;
+	/** Command slots */
+	struct srp_task tasks[SRP_MAX_OUTSTANDING];
 
 	/** Underlying data transfer interface */
 	struct xfer_interface socket;
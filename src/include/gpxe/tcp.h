@@ -289,6 +289,16 @@ struct tcp_options {
 //#define TCP_MAX_WINDOW_SIZE	( 65536 - 4 )
 #define TCP_MAX_WINDOW_SIZE	4096
 
+/**
+ * Receive window limit
+ *
+ * The receive window is allowed to grow beyond TCP_MAX_WINDOW_SIZE
+ * to hold two full-sized segments, if the link MTU is large enough to
+ * require this, but can never exceed the largest dword-aligned value
+ * which fits in the 16-bit window field.
+ */
+#define TCP_WINDOW_LIMIT	( 65536 - 4 )
+
 /**
  * Path MTU
  *
@@ -298,15 +308,18 @@ struct tcp_options {
 #define TCP_PATH_MTU 1460
 
 /**
- * Advertised TCP MSS
+ * Default advertised TCP MSS
  *
- * We currently hardcode this to a reasonable value and hope that the
- * sender uses path MTU discovery.  The alternative is breaking the
- * abstraction layer so that we can find out the MTU from the IP layer
- * (which would have to find out from the net device layer).
+ * The advertised MSS is normally derived from the MTU of the network
+ * device used to reach the peer.  This value is used if the MTU
+ * cannot be determined, and we hope that the sender uses path MTU
+ * discovery.
  */
 #define TCP_MSS 1460
 
+/** Maximum TCP MSS which can be advertised */
+#define TCP_MAX_MSS 0xffff
+
 /** TCP maximum segment lifetime
  *
  * Currently set to 2 minutes, as per RFC 793.
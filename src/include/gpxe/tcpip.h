@@ -98,6 +98,15 @@ struct tcpip_net_protocol {
 		       struct sockaddr_tcpip *st_dest,
 		       struct net_device *netdev,
 		       uint16_t *trans_csum );
+	/**
+	 * Determine maximum transmission unit
+	 *
+	 * @v st_dest		Destination address
+	 * @ret mtu		Maximum transport-layer packet length, or 0
+	 *
+	 * This method may be omitted if the MTU cannot be determined.
+	 */
+	size_t ( * mtu ) ( struct sockaddr_tcpip *st_dest );
 };
 
 /** TCP/IP transport-layer protocol table */
@@ -121,6 +130,7 @@ extern int tcpip_tx ( struct io_buffer *iobuf, struct tcpip_protocol *tcpip,
 		      struct sockaddr_tcpip *st_dest,
 		      struct net_device *netdev,
 		      uint16_t *trans_csum );
+extern size_t tcpip_mtu ( struct sockaddr_tcpip *st_dest );
 extern uint16_t tcpip_continue_chksum ( uint16_t partial,
 					const void *data, size_t len );
 extern uint16_t tcpip_chksum ( const void *data, size_t len );
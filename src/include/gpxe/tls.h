@@ -16,7 +16,9 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <gpxe/crypto.h>
 #include <gpxe/md5.h>
 #include <gpxe/sha1.h>
+#include <gpxe/sha256.h>
 #include <gpxe/x509.h>
+#include <gpxe/profile.h>
 
 /** A TLS header */
 struct tls_header {
@@ -40,6 +42,9 @@ struct tls_header {
 /** TLS version 1.1 */
 #define TLS_VERSION_TLS_1_1 0x0302
 
+/** TLS version 1.2 */
+#define TLS_VERSION_TLS_1_2 0x0303
+
 /** Change cipher content type */
 #define TLS_TYPE_CHANGE_CIPHER 20
 
@@ -73,6 +78,16 @@ struct tls_header {
 #define TLS_RSA_WITH_NULL_SHA 0x0002
 #define TLS_RSA_WITH_AES_128_CBC_SHA 0x002f
 #define TLS_RSA_WITH_AES_256_CBC_SHA 0x0035
+#define TLS_RSA_WITH_AES_128_GCM_SHA256 0x009c
+
+/** Length of implicit part of authenticated encryption nonce */
+#define TLS_FIXED_IV_LEN 4
+
+/** Maximum length of a TLS session ID */
+#define TLS_SESSION_ID_MAX_LEN 32
+
+/** Number of entries in the TLS session cache */
+#define TLS_SESSION_CACHE_SIZE 4
 
 /** TLS RX state machine state */
 enum tls_rx_state {
@@ -110,8 +125,26 @@ struct tls_cipherspec {
 	void *cipher_next_ctx;
 	/** MAC secret */
 	void *mac_secret;
+	/** Implicit part of nonce (authenticated encryption only) */
+	uint8_t fixed_iv[TLS_FIXED_IV_LEN];
 };
 
+/** TLS authenticated encryption nonce */
+struct tls_auth_nonce {
+	/** Implicit part, from key block */
+	uint8_t fixed[TLS_FIXED_IV_LEN];
+	/** Explicit part, sent with each record */
+	uint64_t record;
+} __attribute__ (( packed ));
+
+/** TLS authenticated encryption additional data */
+struct tls_auth_header {
+	/** Sequence number */
+	uint64_t seq;
+	/** TLS header (with plaintext length) */
+	struct tls_header tlshdr;
+} __attribute__ (( packed ));
+
 /** TLS pre-master secret */
 struct tls_pre_master_secret {
 	/** TLS version */
@@ -128,11 +161,42 @@ struct tls_client_random {
 	uint8_t random[28];
 } __attribute__ (( packed ));
 
+/** A cached TLS session
+ *
+ * A session which completed a full handshake, and which may be
+ * resumed by a later connection to the same server.
+ */
+struct tls_cached_session {
+	/** Server name, or NULL if this entry is unused */
+	char *name;
+	/** Session ID */
+	uint8_t id[TLS_SESSION_ID_MAX_LEN];
+	/** Length of session ID */
+	size_t id_len;
+	/** Master secret */
+	uint8_t master_secret[48];
+};
+
 /** A TLS session */
 struct tls_session {
 	/** Reference counter */
 	struct refcnt refcnt;
 
+	/** Server name, or NULL */
+	char *name;
+	/** Session ID */
+	uint8_t session_id[TLS_SESSION_ID_MAX_LEN];
+	/** Length of session ID */
+	size_t session_id_len;
+	/** Session is being resumed from the session cache */
+	int resumed;
+
+	/** Protocol version
+	 *
+	 * This is a TLS_VERSION_XXX constant, in host byte order
+	 */
+	uint16_t version;
+
 	/** Plaintext stream */
 	struct xfer_filter_half plainstream;
 	/** Ciphertext stream */
@@ -158,9 +222,13 @@ struct tls_session {
 	uint8_t handshake_md5_ctx[MD5_CTX_SIZE];
 	/** SHA1 context for handshake verification */
 	uint8_t handshake_sha1_ctx[SHA1_CTX_SIZE];
+	/** SHA256 context for handshake verification (TLSv1.2) */
+	uint8_t handshake_sha256_ctx[SHA256_CTX_SIZE];
 
 	/** Hack: server RSA public key */
 	struct x509_rsa_public_key rsa;
+	/** Handshake profiler (for debug timing information) */
+	union profiler profiler;
 
 	/** TX sequence number */
 	uint64_t tx_seq;
@@ -178,10 +246,10 @@ struct tls_session {
 	/** Current received record header */
 	struct tls_header rx_header;
 	/** Current received raw data buffer */
-	void *rx_data;
+	struct io_buffer *rx_data;
 };
 
-extern int add_tls ( struct xfer_interface *xfer,
+extern int add_tls ( struct xfer_interface *xfer, const char *name,
 		     struct xfer_interface **next );
 
 #endif /* _GPXE_TLS_H */
@@ -10,8 +10,18 @@
 FILE_LICENCE ( GPL2_OR_LATER );
 
 #include <stdint.h>
+#include <stdlib.h>
+#include <gpxe/asn1.h>
+#include <gpxe/sha256.h>
 
-struct asn1_cursor;
+/** Maximum number of certificates in a chain */
+#define X509_MAX_CHAIN 8
+
+/** Length of certificate fingerprints (SHA-256) */
+#define X509_FINGERPRINT_LEN SHA256_DIGEST_SIZE
+
+/** Number of entries in the validated certificate cache */
+#define X509_CACHE_SIZE 8
 
 /** An X.509 RSA public key */
 struct x509_rsa_public_key {
@@ -25,6 +35,74 @@ struct x509_rsa_public_key {
 	size_t exponent_len;
 };
 
+/** An X.509 signature algorithm */
+struct x509_signature_algorithm {
+	/** Name */
+	const char *name;
+	/** Object identifier */
+	const void *oid;
+	/** Length of object identifier */
+	size_t oid_len;
+	/** Digest algorithm */
+	struct digest_algorithm *digest;
+	/** Encoded DigestInfo prefix (preceding the digest value) */
+	const void *prefix;
+	/** Length of DigestInfo prefix */
+	size_t prefix_len;
+};
+
+/** A parsed X.509 certificate
+ *
+ * All cursors point into the encoded certificate, which must remain
+ * valid for as long as the parsed certificate is in use.
+ */
+struct x509_certificate {
+	/** Encoded certificate */
+	struct asn1_cursor raw;
+	/** Encoded tbsCertificate (the signed portion) */
+	struct asn1_cursor tbs;
+	/** Encoded issuer name */
+	struct asn1_cursor issuer;
+	/** Encoded subject name */
+	struct asn1_cursor subject;
+	/** RSA modulus */
+	struct asn1_cursor modulus;
+	/** RSA public exponent */
+	struct asn1_cursor exponent;
+	/** Signature algorithm */
+	struct x509_signature_algorithm *signature_algorithm;
+	/** Signature value */
+	struct asn1_cursor signature;
+	/** Certificate may be used to sign other certificates */
+	int ca;
+	/** Encoded subjectAltName names, if present
+	 *
+	 * This is the body of the GeneralNames sequence, or has a
+	 * NULL data pointer if there is no subjectAltName extension.
+	 */
+	struct asn1_cursor alt_names;
+};
+
+/** A set of trusted root certificates */
+struct x509_root {
+	/** Number of trusted certificates */
+	unsigned int count;
+	/** SHA-256 fingerprints of trusted certificates */
+	const uint8_t *fingerprints;
+};
+
+/** An entry in the validated certificate cache */
+struct x509_cached_certificate {
+	/** Certificate fingerprint */
+	uint8_t fingerprint[X509_FINGERPRINT_LEN];
+	/** Root certificate set against which the certificate was
+	 * validated, or NULL if this entry is unused
+	 */
+	struct x509_root *root;
+	/** Certificate RSA public key */
+	struct x509_rsa_public_key rsa;
+};
+
 /**
  * Free X.509 RSA public key
  *
@@ -35,7 +113,17 @@ x509_free_rsa_public_key ( struct x509_rsa_public_key *rsa_pubkey ) {
 	free ( rsa_pubkey->modulus );
 }
 
+extern struct x509_root root_certificates;
+
 extern int x509_rsa_public_key ( const struct asn1_cursor *certificate,
 				 struct x509_rsa_public_key *rsa_pubkey );
+extern int x509_parse ( struct x509_certificate *cert,
+			const struct asn1_cursor *raw );
+extern int x509_validate_chain ( const struct asn1_cursor *chain,
+				 unsigned int count, struct x509_root *root,
+				 struct x509_rsa_public_key *rsa_pubkey );
+extern int x509_check_name ( const struct asn1_cursor *certificate,
+			     const char *name );
+extern void x509_flush_cache ( void );
 
 #endif /* _GPXE_X509_H */
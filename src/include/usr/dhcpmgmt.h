@@ -12,6 +12,8 @@ FILE_LICENCE ( GPL2_OR_LATER );
 struct net_device;
 
 extern int dhcp ( struct net_device *netdev );
+extern int dhcp_any ( struct net_device *preferred, int in_order,
+		      struct net_device **netdev, int *failed );
 extern int pxebs ( struct net_device *netdev, unsigned int pxe_type );
 
 #endif /* _USR_DHCPMGMT_H */
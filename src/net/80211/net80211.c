@@ -786,6 +786,7 @@ struct net80211_device * net80211_alloc ( size_t priv_size )
 	netdev->ll_protocol = &net80211_ll_protocol;
 	netdev->ll_broadcast = net80211_ll_broadcast;
 	netdev->max_pkt_len = IEEE80211_MAX_DATA_LEN;
+	netdev->mtu = ETH_MAX_MTU;
 	netdev_init ( netdev, &net80211_netdev_ops );
 
 	dev = netdev->priv;
@@ -168,143 +168,124 @@ static int ccmp_init ( struct net80211_crypto *crypto, const void *key,
 }
 
 
-/**
- * Encrypt or decrypt data stream using AES in Counter mode
- *
- * @v ctx	CCMP cryptosystem context
- * @v nonce	Nonce value, 13 bytes
- * @v srcv	Data to encrypt or decrypt
- * @v len	Number of bytes pointed to by @a src
- * @v msrcv	MIC value to encrypt or decrypt (may be NULL)
- * @ret destv	Encrypted or decrypted data
- * @ret mdestv	Encrypted or decrypted MIC value
+/** Number of counter blocks to encrypt at once
  *
- * This assumes CCMP parameters of L=2 and M=8. The algorithm is
- * defined in RFC 3610.
+ * Passing several counter blocks to the cipher in a single call
+ * allows a pipelined implementation (such as AES-NI) to process them
+ * in parallel.
  */
-static void ccmp_ctr_xor ( struct ccmp_ctx *ctx, const void *nonce,
-			   const void *srcv, void *destv, int len,
-			   const void *msrcv, void *mdestv )
-{
-	u8 A[16], S[16];
-	u16 ctr;
-	int i;
-	const u8 *src = srcv, *msrc = msrcv;
-	u8 *dest = destv, *mdest = mdestv;
-
-	A[0] = 0x01;		/* flags, L' = L - 1 = 1, other bits rsvd */
-	memcpy ( A + 1, nonce, CCMP_NONCE_LEN );
-
-	if ( msrcv ) {
-		A[14] = A[15] = 0;
-
-		cipher_encrypt ( &aes_algorithm, ctx->aes_ctx, A, S, 16 );
-
-		for ( i = 0; i < 8; i++ ) {
-			*mdest++ = *msrc++ ^ S[i];
-		}
-	}
-
-	for ( ctr = 1 ;; ctr++ ) {
-		A[14] = ctr >> 8;
-		A[15] = ctr & 0xFF;
-
-		cipher_encrypt ( &aes_algorithm, ctx->aes_ctx, A, S, 16 );
-
-		for ( i = 0; i < len && i < 16; i++ )
-			*dest++ = *src++ ^ S[i];
-
-		if ( len <= 16 )
-			break;	/* we're done */
-
-		len -= 16;
-	}
-}
-
+#define CCMP_CTR_BLOCKS	4
 
 /**
- * Advance one block in CBC-MAC calculation
- *
- * @v aes_ctx	AES encryption context with key set
- * @v B		Cleartext block to incorporate (16 bytes)
- * @v X		Previous ciphertext block (16 bytes)
- * @ret B	Clobbered
- * @ret X	New ciphertext block (16 bytes)
- *
- * This function does X := E[key] ( X ^ B ).
- */
-static void ccmp_feed_cbc_mac ( void *aes_ctx, u8 *B, u8 *X )
-{
-	int i;
-	for ( i = 0; i < 16; i++ )
-		B[i] ^= X[i];
-	cipher_encrypt ( &aes_algorithm, aes_ctx, B, X, 16 );
-}
-
-
-/**
- * Calculate MIC on plaintext data using CBC-MAC
+ * Encrypt or decrypt data and calculate MIC in a single pass
  *
  * @v ctx	CCMP cryptosystem context
  * @v nonce	Nonce value, 13 bytes
- * @v data	Data to calculate MIC over
- * @v datalen	Length of @a data
- * @v aad	Additional authentication data, for MIC but not encryption
- * @ret mic	MIC value (unencrypted), 8 bytes
+ * @v aad	Additional authentication data
+ * @v srcv	Data to encrypt or decrypt
+ * @v destv	Buffer for encrypted or decrypted data
+ * @v len	Length of data
+ * @v decrypt	If TRUE, @a srcv is ciphertext rather than plaintext
+ * @ret micv	Encrypted MIC value, 8 bytes
+ *
+ * This assumes CCMP parameters of L=2 and M=8. The algorithm is
+ * defined in RFC 3610; counter mode encryption and the CBC-MAC over
+ * the plaintext are performed together, so that each block of data
+ * is touched only once.  The keystream is generated several blocks
+ * at a time, with counter block zero (used to encrypt the MIC) being
+ * generated along with the first data blocks.
  *
- * @a aadlen is assumed to be 22 bytes long, as it always is for
+ * @a aad is assumed to be 22 bytes long, as it always is for
  * 802.11 use when transmitting non-QoS, not-between-APs frames (the
- * only type we deal with).
+ * only type we deal with).  @a srcv and @a destv may be identical.
  */
-static void ccmp_cbc_mac ( struct ccmp_ctx *ctx, const void *nonce,
-			   const void *data, u16 datalen,
-			   const void *aad, void *mic )
+static void ccmp_crypt ( struct ccmp_ctx *ctx, const void *nonce,
+			 const void *aad, const void *srcv, void *destv,
+			 size_t len, int decrypt, void *micv )
 {
-	u8 X[16], B[16];
+	u8 A[CCMP_CTR_BLOCKS][16], S[CCMP_CTR_BLOCKS][16];
+	u8 X[16], S0[CCMP_MIC_LEN];
+	const u8 *src = srcv, *aadb = aad;
+	u8 *dest = destv, *mic = micv;
+	unsigned int nblk, blk;
+	size_t frag;
+	u16 ctr = 0;
+	u8 p;
+	int i;
 
-	/* Zeroth block: flags, nonce, length */
+	/* CBC-MAC zeroth block: flags, nonce, length */
 
 	/* Rsv AAD - M'-  - L'-
 	 *  0   1  0 1 1  0 0 1   for an 8-byte MAC and 2-byte message length
 	 */
-	B[0] = 0x59;
-	memcpy ( B + 1, nonce, CCMP_NONCE_LEN );
-	B[14] = datalen >> 8;
-	B[15] = datalen & 0xFF;
-
-	cipher_encrypt ( &aes_algorithm, ctx->aes_ctx, B, X, 16 );
+	X[0] = 0x59;
+	memcpy ( X + 1, nonce, CCMP_NONCE_LEN );
+	X[14] = len >> 8;
+	X[15] = len & 0xFF;
+	cipher_encrypt ( &aes_algorithm, ctx->aes_ctx, X, X, 16 );
 
 	/* First block: AAD length field and 14 bytes of AAD */
-	B[0] = 0;
-	B[1] = CCMP_AAD_LEN;
-	memcpy ( B + 2, aad, 14 );
-
-	ccmp_feed_cbc_mac ( ctx->aes_ctx, B, X );
+	X[1] ^= CCMP_AAD_LEN;
+	for ( i = 0; i < 14; i++ )
+		X[2 + i] ^= aadb[i];
+	cipher_encrypt ( &aes_algorithm, ctx->aes_ctx, X, X, 16 );
 
 	/* Second block: Remaining 8 bytes of AAD, 8 bytes zero pad */
-	memcpy ( B, aad + 14, 8 );
-	memset ( B + 8, 0, 8 );
-
-	ccmp_feed_cbc_mac ( ctx->aes_ctx, B, X );
-
-	/* Message blocks */
-	while ( datalen ) {
-		if ( datalen >= 16 ) {
-			memcpy ( B, data, 16 );
-			datalen -= 16;
-		} else {
-			memcpy ( B, data, datalen );
-			memset ( B + datalen, 0, 16 - datalen );
-			datalen = 0;
-		}
-
-		ccmp_feed_cbc_mac ( ctx->aes_ctx, B, X );
-
-		data += 16;
+	for ( i = 0; i < 8; i++ )
+		X[i] ^= aadb[14 + i];
+	cipher_encrypt ( &aes_algorithm, ctx->aes_ctx, X, X, 16 );
+
+	/* Counter blocks: flags, nonce, counter */
+	for ( blk = 0; blk < CCMP_CTR_BLOCKS; blk++ ) {
+		A[blk][0] = 0x01; /* flags, L' = L - 1 = 1, other bits rsvd */
+		memcpy ( A[blk] + 1, nonce, CCMP_NONCE_LEN );
 	}
 
-	/* Get MIC from final value of X */
-	memcpy ( mic, X, 8 );
+	do {
+		/* Generate keystream for up to CCMP_CTR_BLOCKS blocks */
+		nblk = ( ( len + 15 ) / 16 ) + ( ctr == 0 );
+		if ( nblk > CCMP_CTR_BLOCKS )
+			nblk = CCMP_CTR_BLOCKS;
+		for ( blk = 0; blk < nblk; blk++ ) {
+			A[blk][14] = ( ctr + blk ) >> 8;
+			A[blk][15] = ( ctr + blk ) & 0xFF;
+		}
+		cipher_encrypt ( &aes_algorithm, ctx->aes_ctx, A, S,
+				 nblk * 16 );
+
+		for ( blk = 0; blk < nblk; blk++, ctr++ ) {
+			/* Counter block zero is used only for the MIC */
+			if ( ctr == 0 ) {
+				memcpy ( S0, S[0], sizeof ( S0 ) );
+				continue;
+			}
+
+			/* Encrypt or decrypt, and feed plaintext
+			 * (implicitly zero-padded) into CBC-MAC
+			 */
+			frag = ( ( len < 16 ) ? len : 16 );
+			for ( i = 0; i < ( int ) frag; i++ ) {
+				if ( decrypt ) {
+					p = src[i] ^ S[blk][i];
+					dest[i] = p;
+				} else {
+					p = src[i];
+					dest[i] = p ^ S[blk][i];
+				}
+				X[i] ^= p;
+			}
+			cipher_encrypt ( &aes_algorithm, ctx->aes_ctx, X, X,
+					 16 );
+
+			src += frag;
+			dest += frag;
+			len -= frag;
+		}
+	} while ( len );
+
+	/* Encrypt MIC from final value of X */
+	for ( i = 0; i < CCMP_MIC_LEN; i++ )
+		mic[i] = X[i] ^ S0[i];
 }
 
 
@@ -326,8 +307,9 @@ struct io_buffer * ccmp_encrypt ( struct net80211_crypto *crypto,
 	struct ccmp_head head;
 	struct ccmp_nonce nonce;
 	struct ccmp_aad aad;
-	u8 mic[8], tx_pn[6];
+	u8 tx_pn[6];
 	void *edata, *emic;
+	int i;
 
 	ctx->tx_seq++;
 	u64_to_pn ( ctx->tx_seq, tx_pn, PN_LSB );
@@ -343,8 +325,10 @@ struct io_buffer * ccmp_encrypt ( struct net80211_crypto *crypto,
 	hdr->fc |= IEEE80211_FC_PROTECTED;
 
 	/* Fill in packet number and extended IV */
-	memcpy ( head.pn_lo, tx_pn, 2 );
-	memcpy ( head.pn_hi, tx_pn + 2, 4 );
+	head.pn_lo[0] = tx_pn[0];
+	head.pn_lo[1] = tx_pn[1];
+	for ( i = 0; i < 4; i++ )
+		head.pn_hi[i] = tx_pn[2 + i];
 	head.kid = 0x20;	/* have Extended IV, key ID 0 */
 	head._rsvd = 0;
 	memcpy ( iob_put ( eiob, sizeof ( head ) ), &head, sizeof ( head ) );
@@ -359,15 +343,11 @@ struct io_buffer * ccmp_encrypt ( struct net80211_crypto *crypto,
 	memcpy ( aad.a1, hdr->addr1, 3 * ETH_ALEN ); /* all 3 at once */
 	aad.seq = hdr->seq & CCMP_AAD_SEQ_MASK;
 
-	/* Calculate MIC over the data */
-	ccmp_cbc_mac ( ctx, &nonce, iob->data + hdrlen, datalen, &aad, mic );
-
-	/* Copy and encrypt data and MIC */
+	/* Copy and encrypt data, and calculate encrypted MIC */
 	edata = iob_put ( eiob, datalen );
 	emic = iob_put ( eiob, CCMP_MIC_LEN );
-	ccmp_ctr_xor ( ctx, &nonce,
-		       iob->data + hdrlen, edata, datalen,
-		       mic, emic );
+	ccmp_crypt ( ctx, &nonce, &aad, iob->data + hdrlen, edata, datalen,
+		     0, emic );
 
 	/* Done! */
 	DBGC2 ( ctx, "WPA-CCMP %p: encrypted packet %p -> %p\n", ctx,
@@ -394,7 +374,8 @@ static struct io_buffer * ccmp_decrypt ( struct net80211_crypto *crypto,
 	struct ccmp_head *head;
 	struct ccmp_nonce nonce;
 	struct ccmp_aad aad;
-	u8 rx_pn[6], their_mic[8], our_mic[8];
+	u8 rx_pn[6], our_mic[CCMP_MIC_LEN];
+	int i;
 
 	iob = alloc_iob ( hdrlen + datalen );
 	if ( ! iob )
@@ -407,8 +388,10 @@ static struct io_buffer * ccmp_decrypt ( struct net80211_crypto *crypto,
 
 	/* Check and update RX packet number */
 	head = eiob->data + hdrlen;
-	memcpy ( rx_pn, head->pn_lo, 2 );
-	memcpy ( rx_pn + 2, head->pn_hi, 4 );
+	rx_pn[0] = head->pn_lo[0];
+	rx_pn[1] = head->pn_lo[1];
+	for ( i = 0; i < 4; i++ )
+		rx_pn[2 + i] = head->pn_hi[i];
 
 	if ( pn_to_u64 ( rx_pn ) <= ctx->rx_seq ) {
 		DBGC ( ctx, "WPA-CCMP %p: packet received out of order "
@@ -431,16 +414,13 @@ static struct io_buffer * ccmp_decrypt ( struct net80211_crypto *crypto,
 	memcpy ( aad.a1, hdr->addr1, 3 * ETH_ALEN ); /* all 3 at once */
 	aad.seq = hdr->seq & CCMP_AAD_SEQ_MASK;
 
-	/* Copy-decrypt data and MIC */
-	ccmp_ctr_xor ( ctx, &nonce, eiob->data + hdrlen + sizeof ( *head ),
-		       iob_put ( iob, datalen ), datalen,
-		       eiob->tail - CCMP_MIC_LEN, their_mic );
+	/* Copy-decrypt data, and calculate encrypted MIC */
+	ccmp_crypt ( ctx, &nonce, &aad, eiob->data + hdrlen + sizeof ( *head ),
+		     iob_put ( iob, datalen ), datalen, 1, our_mic );
 
 	/* Check MIC */
-	ccmp_cbc_mac ( ctx, &nonce, iob->data + hdrlen, datalen, &aad,
-		       our_mic );
-
-	if ( memcmp ( their_mic, our_mic, CCMP_MIC_LEN ) != 0 ) {
+	if ( memcmp ( eiob->tail - CCMP_MIC_LEN, our_mic,
+		      CCMP_MIC_LEN ) != 0 ) {
 		DBGC2 ( ctx, "WPA-CCMP %p: MIC failure\n", ctx );
 		free_iob ( iob );
 		return NULL;
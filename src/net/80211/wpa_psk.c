@@ -20,7 +20,13 @@ FILE_LICENCE ( GPL2_OR_LATER );
 
 #include <gpxe/net80211.h>
 #include <gpxe/sha1.h>
+#include <gpxe/crypto.h>
+#include <gpxe/settings.h>
+#include <gpxe/dhcp.h>
+#include <gpxe/nvo.h>
 #include <gpxe/wpa.h>
+#include <config/general.h>
+#include <string.h>
 #include <errno.h>
 
 /** @file
@@ -28,6 +34,173 @@ FILE_LICENCE ( GPL2_OR_LATER );
  * Frontend for WPA using a pre-shared key.
  */
 
+/** Number of entries in the PMK cache */
+#define WPA_PSK_CACHE_SIZE 4
+
+/** Maximum length of a WPA passphrase */
+#define WPA_PSK_MAX_PASSPHRASE 64
+
+/**
+ * A pairwise master key held in non-volatile storage
+ *
+ * Only the ESSID is recorded alongside the PMK.  Nothing derived
+ * cheaply from the passphrase is ever stored, so a stored PMK may
+ * turn out to be stale if the passphrase has since been changed; this
+ * shows up as a failed 4-way handshake, after which the PMK is derived
+ * afresh.
+ */
+struct wpa_psk_pmk {
+	/** ESSID for which the PMK was derived */
+	char essid[IEEE80211_MAX_SSID_LEN + 1];
+	/** Pairwise master key */
+	u8 pmk[WPA_PMK_LEN];
+} __attribute__ (( packed ));
+
+/** A cached pairwise master key */
+struct wpa_psk_cache_entry {
+	/** ESSID for which the PMK was derived */
+	char essid[IEEE80211_MAX_SSID_LEN + 1];
+	/** Passphrase from which the PMK was derived */
+	char passphrase[WPA_PSK_MAX_PASSPHRASE + 1];
+	/** Pairwise master key */
+	u8 pmk[WPA_PMK_LEN];
+};
+
+/** WPA-PSK handshaker context */
+struct wpa_psk_ctx {
+	/** WPA common context; must be first */
+	struct wpa_common_ctx wpa;
+	/** PMK was taken from non-volatile storage and is unconfirmed */
+	int pmk_stored;
+};
+
+/** Cache of recently derived PMKs */
+static struct wpa_psk_cache_entry wpa_psk_cache[WPA_PSK_CACHE_SIZE];
+
+/** Number of valid entries in the PMK cache */
+static unsigned int wpa_psk_cache_count;
+
+/** Next PMK cache entry to be replaced */
+static unsigned int wpa_psk_cache_next;
+
+/** Stored PMK most recently rejected by an access point */
+static struct wpa_psk_pmk wpa_psk_rejected;
+
+/** Cached WPA pairwise master key setting */
+struct setting wpa_psk_pmk_setting __setting = {
+	.name = "wpa-pmk",
+	.description = "Cached WPA pairwise master key",
+	.tag = DHCP_EB_WPA_PMK,
+	.type = &setting_type_hex,
+};
+
+/**
+ * Find PMK in cache
+ *
+ * @v essid	ESSID
+ * @v passphrase Passphrase
+ * @ret pmk	Pairwise master key to fill in
+ * @ret rc	Return status code
+ */
+static int wpa_psk_find_cached_pmk ( const char *essid,
+				     const char *passphrase, u8 *pmk )
+{
+	struct wpa_psk_cache_entry *cached;
+	unsigned int i;
+
+	for ( i = 0; i < wpa_psk_cache_count; i++ ) {
+		cached = &wpa_psk_cache[i];
+		if ( ( strcmp ( cached->essid, essid ) == 0 ) &&
+		     ( strcmp ( cached->passphrase, passphrase ) == 0 ) ) {
+			memcpy ( pmk, cached->pmk, WPA_PMK_LEN );
+			return 0;
+		}
+	}
+
+	return -ENOENT;
+}
+
+/**
+ * Find PMK in non-volatile storage
+ *
+ * @v dev	802.11 device
+ * @ret pmk	Pairwise master key to fill in
+ * @ret rc	Return status code
+ *
+ * A stored PMK that has already been rejected by an access point is
+ * ignored.
+ */
+static int wpa_psk_find_stored_pmk ( struct net80211_device *dev, u8 *pmk )
+{
+	struct wpa_psk_pmk stored;
+
+	memset ( &stored, 0, sizeof ( stored ) );
+	if ( ( fetch_setting ( netdev_settings ( dev->netdev ),
+			       &wpa_psk_pmk_setting, &stored,
+			       sizeof ( stored ) ) == sizeof ( stored ) ) &&
+	     ( strncmp ( stored.essid, dev->essid,
+			 sizeof ( stored.essid ) ) == 0 ) &&
+	     ( memcmp ( &stored, &wpa_psk_rejected,
+			sizeof ( stored ) ) != 0 ) ) {
+		memcpy ( pmk, stored.pmk, WPA_PMK_LEN );
+		return 0;
+	}
+
+	return -ENOENT;
+}
+
+/**
+ * Record newly derived PMK
+ *
+ * @v dev	802.11 device
+ * @v passphrase Passphrase
+ * @v pmk	Pairwise master key
+ *
+ * The PMK is added to the in-memory cache, replacing the oldest entry
+ * if necessary.  If WPA_PMK_NVO is enabled, the PMK and ESSID are also
+ * saved to the device's non-volatile stored options (if any).
+ */
+static void wpa_psk_save_pmk ( struct net80211_device *dev,
+			       const char *passphrase, const u8 *pmk )
+{
+	struct wpa_psk_cache_entry *cached;
+
+	cached = &wpa_psk_cache[wpa_psk_cache_next];
+	memset ( cached, 0, sizeof ( *cached ) );
+	strncpy ( cached->essid, dev->essid, sizeof ( cached->essid ) - 1 );
+	strncpy ( cached->passphrase, passphrase,
+		  sizeof ( cached->passphrase ) - 1 );
+	memcpy ( cached->pmk, pmk, WPA_PMK_LEN );
+	wpa_psk_cache_next = ( ( wpa_psk_cache_next + 1 ) %
+			       WPA_PSK_CACHE_SIZE );
+	if ( wpa_psk_cache_count < WPA_PSK_CACHE_SIZE )
+		wpa_psk_cache_count++;
+
+#ifdef WPA_PMK_NVO
+	{
+		struct settings *settings = netdev_settings ( dev->netdev );
+		struct settings *child;
+		struct wpa_psk_pmk stored;
+
+		memset ( &stored, 0, sizeof ( stored ) );
+		strncpy ( stored.essid, dev->essid,
+			  sizeof ( stored.essid ) - 1 );
+		memcpy ( stored.pmk, pmk, WPA_PMK_LEN );
+
+		list_for_each_entry ( child, &settings->children, siblings ) {
+			if ( is_nvo_settings ( child ) &&
+			     ( store_setting ( child, &wpa_psk_pmk_setting,
+					       &stored,
+					       sizeof ( stored ) ) == 0 ) ) {
+				DBGC ( dev, "802.11 %p saved PMK to %s\n",
+				       dev, settings_name ( child ) );
+				break;
+			}
+		}
+	}
+#endif
+}
+
 /**
  * Initialise WPA-PSK state
  *
@@ -47,14 +220,15 @@ static int wpa_psk_init ( struct net80211_device *dev )
  */
 static int wpa_psk_start ( struct net80211_device *dev )
 {
-	char passphrase[64+1];
+	char passphrase[WPA_PSK_MAX_PASSPHRASE + 1];
 	u8 pmk[WPA_PMK_LEN];
 	int len;
-	struct wpa_common_ctx *ctx = dev->handshaker->priv;
+	struct wpa_psk_ctx *psk = dev->handshaker->priv;
+	struct wpa_common_ctx *ctx = &psk->wpa;
 
 	len = fetch_string_setting ( netdev_settings ( dev->netdev ),
 				     &net80211_key_setting, passphrase,
-				     64 + 1 );
+				     sizeof ( passphrase ) );
 
 	if ( len <= 0 ) {
 		DBGC ( ctx, "WPA-PSK %p: no passphrase provided!\n", ctx );
@@ -62,11 +236,21 @@ static int wpa_psk_start ( struct net80211_device *dev )
 		return -EACCES;
 	}
 
-	pbkdf2_sha1 ( passphrase, len, dev->essid, strlen ( dev->essid ),
-		      4096, pmk, WPA_PMK_LEN );
-
-	DBGC ( ctx, "WPA-PSK %p: derived PMK from passphrase `%s':\n", ctx,
-	       passphrase );
+	/* Deriving the PMK requires 8192 HMAC-SHA1 operations, so
+	 * reuse a previously derived PMK if possible.
+	 */
+	if ( wpa_psk_find_cached_pmk ( dev->essid, passphrase, pmk ) == 0 ) {
+		DBGC ( ctx, "WPA-PSK %p: using cached PMK:\n", ctx );
+	} else if ( wpa_psk_find_stored_pmk ( dev, pmk ) == 0 ) {
+		DBGC ( ctx, "WPA-PSK %p: using stored PMK:\n", ctx );
+		psk->pmk_stored = 1;
+	} else {
+		pbkdf2_sha1 ( passphrase, len, dev->essid,
+			      strlen ( dev->essid ), 4096, pmk, WPA_PMK_LEN );
+		wpa_psk_save_pmk ( dev, passphrase, pmk );
+		DBGC ( ctx, "WPA-PSK %p: derived PMK from passphrase `%s':\n",
+		       ctx, passphrase );
+	}
 	DBGC_HD ( ctx, pmk, WPA_PMK_LEN );
 
 	return wpa_start ( dev, ctx, pmk, WPA_PMK_LEN );
@@ -80,10 +264,13 @@ static int wpa_psk_start ( struct net80211_device *dev )
  */
 static int wpa_psk_step ( struct net80211_device *dev )
 {
-	struct wpa_common_ctx *ctx = dev->handshaker->priv;
+	struct wpa_psk_ctx *psk = dev->handshaker->priv;
+	struct wpa_common_ctx *ctx = &psk->wpa;
 
 	switch ( ctx->state ) {
 	case WPA_SUCCESS:
+		/* Any stored PMK has now been confirmed */
+		psk->pmk_stored = 0;
 		return 1;
 	case WPA_FAILURE:
 		return -EACCES;
@@ -110,6 +297,21 @@ static int wpa_psk_no_change_key ( struct net80211_device *dev __unused )
  */
 static void wpa_psk_stop ( struct net80211_device *dev )
 {
+	struct wpa_psk_ctx *psk = dev->handshaker->priv;
+
+	/* A stored PMK that did not complete the 4-way handshake is
+	 * probably stale; skip it next time so that the PMK is derived
+	 * afresh from the passphrase.
+	 */
+	if ( psk->pmk_stored ) {
+		DBGC ( dev, "802.11 %p discarding rejected stored PMK\n",
+		       dev );
+		memset ( &wpa_psk_rejected, 0, sizeof ( wpa_psk_rejected ) );
+		strncpy ( wpa_psk_rejected.essid, dev->essid,
+			  sizeof ( wpa_psk_rejected.essid ) - 1 );
+		memcpy ( wpa_psk_rejected.pmk, psk->wpa.pmk, WPA_PMK_LEN );
+	}
+
 	wpa_stop ( dev );
 }
 
@@ -121,5 +323,5 @@ struct net80211_handshaker wpa_psk_handshaker __net80211_handshaker = {
 	.step = wpa_psk_step,
 	.change_key = wpa_psk_no_change_key,
 	.stop = wpa_psk_stop,
-	.priv_len = sizeof ( struct wpa_common_ctx ),
+	.priv_len = sizeof ( struct wpa_psk_ctx ),
 };
@@ -291,20 +291,25 @@ static void tkip_mix_2 ( struct tkip_dir_ctx *dctx, struct tkip_tk *tk,
 /**
  * Update Michael message integrity code based on next 32-bit word of data
  *
- * @v V		Michael code state (two 32-bit words)
+ * @v l		Michael code state, left half
+ * @v r		Michael code state, right half
  * @v word	Next 32-bit word of data
+ *
+ * This is always inlined, so that the state is held in registers
+ * throughout the calculation.
  */
-static void tkip_feed_michael ( u32 *V, u32 word )
+static inline __attribute__ (( always_inline )) void
+tkip_feed_michael ( u32 *l, u32 *r, u32 word )
 {
-	V[0] ^= word;
-	V[1] ^= rol32 ( V[0], 17 );
-	V[0] += V[1];
-	V[1] ^= ( ( V[0] & 0xFF00FF00 ) >> 8 ) | ( ( V[0] & 0x00FF00FF ) << 8 );
-	V[0] += V[1];
-	V[1] ^= rol32 ( V[0], 3 );
-	V[0] += V[1];
-	V[1] ^= ror32 ( V[0], 2 );
-	V[0] += V[1];
+	*l ^= word;
+	*r ^= rol32 ( *l, 17 );
+	*l += *r;
+	*r ^= ( ( *l & 0xFF00FF00 ) >> 8 ) | ( ( *l & 0x00FF00FF ) << 8 );
+	*l += *r;
+	*r ^= rol32 ( *l, 3 );
+	*l += *r;
+	*r ^= ror32 ( *l, 2 );
+	*l += *r;
 }
 
 /**
@@ -320,48 +325,50 @@ static void tkip_feed_michael ( u32 *V, u32 word )
 static void tkip_michael ( const void *key, const void *da, const void *sa,
 			   const void *data, size_t len, void *mic )
 {
-	u32 V[2];		/* V[0] = "l", V[1] = "r" in 802.11 */
+	u32 l, r;		/* "l" and "r" in 802.11 */
 	union {
 		u8 byte[12];
 		u32 word[3];
 	} cap;
-	const u8 *ptr = data;
-	const u8 *end = ptr + len;
+	const u32 *key32 = key;
+	const u8 *da8 = da, *sa8 = sa;
+	const u32 *ptr32 = data;
+	const u8 *ptr;
+	u32 *mic32 = mic;
 	int i;
 
-	memcpy ( V, key, sizeof ( V ) );
-	V[0] = le32_to_cpu ( V[0] );
-	V[1] = le32_to_cpu ( V[1] );
+	l = le32_to_cpu ( key32[0] );
+	r = le32_to_cpu ( key32[1] );
 
 	/* Feed in header (we assume non-QoS, so Priority = 0) */
-	memcpy ( &cap.byte[0], da, ETH_ALEN );
-	memcpy ( &cap.byte[6], sa, ETH_ALEN );
-	tkip_feed_michael ( V, le32_to_cpu ( cap.word[0] ) );
-	tkip_feed_michael ( V, le32_to_cpu ( cap.word[1] ) );
-	tkip_feed_michael ( V, le32_to_cpu ( cap.word[2] ) );
-	tkip_feed_michael ( V, 0 );
+	for ( i = 0; i < ETH_ALEN; i++ ) {
+		cap.byte[i] = da8[i];
+		cap.byte[ETH_ALEN + i] = sa8[i];
+	}
+	tkip_feed_michael ( &l, &r, le32_to_cpu ( cap.word[0] ) );
+	tkip_feed_michael ( &l, &r, le32_to_cpu ( cap.word[1] ) );
+	tkip_feed_michael ( &l, &r, le32_to_cpu ( cap.word[2] ) );
+	tkip_feed_michael ( &l, &r, 0 );
 
 	/* Feed in data */
-	while ( ptr + 4 <= end ) {
-		tkip_feed_michael ( V, le32_to_cpu ( *( u32 * ) ptr ) );
-		ptr += 4;
-	}
+	for ( ; len >= 4; len -= 4 )
+		tkip_feed_michael ( &l, &r, le32_to_cpu ( *ptr32++ ) );
 
 	/* Add unaligned part and padding */
-	for ( i = 0; ptr < end; i++ )
+	ptr = ( const void * ) ptr32;
+	for ( i = 0; len; i++, len-- )
 		cap.byte[i] = *ptr++;
 	cap.byte[i++] = 0x5a;
 	for ( ; i < 8; i++ )
 		cap.byte[i] = 0;
 
 	/* Feed in padding */
-	tkip_feed_michael ( V, le32_to_cpu ( cap.word[0] ) );
-	tkip_feed_michael ( V, le32_to_cpu ( cap.word[1] ) );
+	tkip_feed_michael ( &l, &r, le32_to_cpu ( cap.word[0] ) );
+	tkip_feed_michael ( &l, &r, le32_to_cpu ( cap.word[1] ) );
 
 	/* Output MIC */
-	V[0] = cpu_to_le32 ( V[0] );
-	V[1] = cpu_to_le32 ( V[1] );
-	memcpy ( mic, V, sizeof ( V ) );
+	mic32[0] = cpu_to_le32 ( l );
+	mic32[1] = cpu_to_le32 ( r );
 }
 
 /**
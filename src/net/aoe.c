@@ -64,39 +64,76 @@ static void aoe_free ( struct refcnt *refcnt ) {
  * @v rc		Return status code
  */
 static void aoe_done ( struct aoe_session *aoe, int rc ) {
+	struct ata_command *command = aoe->command;
+	struct aoe_subcommand *subcmd;
+	unsigned int i;
 
-	/* Record overall command status */
-	if ( aoe->command ) {
-		aoe->command->cb.cmd_stat = aoe->status;
-		aoe->command->rc = rc;
-		aoe->command = NULL;
-	}
-
-	/* Stop retransmission timer */
+	/* Stop retransmission timers and abandon any outstanding
+	 * subcommands; late responses will no longer match a tag.
+	 */
 	stop_timer ( &aoe->timer );
+	for ( i = 0 ; i < AOE_MAX_OUTSTANDING ; i++ ) {
+		subcmd = &aoe->subcmds[i];
+		stop_timer ( &subcmd->timer );
+		subcmd->busy = 0;
+	}
 
 	/* Mark operation as complete */
 	aoe->rc = rc;
+
+	/* Record overall command status.  Do this last, since the
+	 * completion handler may issue a new command.
+	 */
+	if ( command ) {
+		aoe->command = NULL;
+		command->cb.cmd_stat = aoe->status;
+		ata_command_done ( command, rc );
+	}
+}
+
+/**
+ * Create AoE command packet
+ *
+ * @v aoe		AoE session
+ * @v aoecmdlen		Length of AoE command
+ * @v data_out_len	Length of data payload
+ * @ret iobuf		I/O buffer, or NULL
+ */
+static struct io_buffer * aoe_alloc_iob ( struct aoe_session *aoe,
+					  size_t aoecmdlen,
+					  size_t data_out_len ) {
+	struct io_buffer *iobuf;
+	struct aoehdr *aoehdr;
+
+	iobuf = alloc_iob ( ETH_HLEN + sizeof ( *aoehdr ) +
+			    aoecmdlen + data_out_len );
+	if ( ! iobuf )
+		return NULL;
+	iob_reserve ( iobuf, ETH_HLEN );
+	aoehdr = iob_put ( iobuf, sizeof ( *aoehdr ) );
+	memset ( aoehdr, 0, ( sizeof ( *aoehdr ) + aoecmdlen ) );
+
+	/* Fill AoE header */
+	aoehdr->ver_flags = AOE_VERSION;
+	aoehdr->major = htons ( aoe->major );
+	aoehdr->minor = aoe->minor;
+	aoehdr->command = aoe->aoe_cmd_type;
+	aoehdr->tag = htonl ( ++aoe->tag );
+
+	return iobuf;
 }
 
 /**
- * Send AoE command
+ * Send AoE config command
  *
  * @v aoe		AoE session
  * @ret rc		Return status code
  *
- * This transmits an AoE command packet.  It does not wait for a
+ * This transmits an AoE config query packet.  It does not wait for a
  * response.
  */
 static int aoe_send_command ( struct aoe_session *aoe ) {
-	struct ata_command *command = aoe->command;
 	struct io_buffer *iobuf;
-	struct aoehdr *aoehdr;
-	union aoecmd *aoecmd;
-	struct aoeata *aoeata;
-	unsigned int count;
-	unsigned int data_out_len;
-	unsigned int aoecmdlen;
 
 	/* Fail immediately if we have no netdev to send on */
 	if ( ! aoe->netdev ) {
@@ -104,86 +141,129 @@ static int aoe_send_command ( struct aoe_session *aoe ) {
 		return -ENETUNREACH;
 	}
 
-	/* If we are transmitting anything that requires a response,
-         * start the retransmission timer.  Do this before attempting
-         * to allocate the I/O buffer, in case allocation itself
-         * fails.
-         */
+	/* Start the retransmission timer.  Do this before attempting
+	 * to allocate the I/O buffer, in case allocation itself
+	 * fails.
+	 */
 	start_timer ( &aoe->timer );
 
-	/* Calculate count and data_out_len for this subcommand */
-	switch ( aoe->aoe_cmd_type ) {
-	case AOE_CMD_ATA:
-		count = command->cb.count.native;
-		if ( count > AOE_MAX_COUNT )
-			count = AOE_MAX_COUNT;
-		data_out_len = ( command->data_out ?
-				 ( count * ATA_SECTOR_SIZE ) : 0 );
-		aoecmdlen = sizeof ( aoecmd->ata );
-		break;
-	case AOE_CMD_CONFIG:
-		count = 0;
-		data_out_len = 0;
-		aoecmdlen = sizeof ( aoecmd->cfg );
-		break;
-	default:
-		return -ENOTSUP;
-	}
-
 	/* Create outgoing I/O buffer */
-	iobuf = alloc_iob ( ETH_HLEN + sizeof ( *aoehdr ) +
-			    aoecmdlen + data_out_len );
-
+	iobuf = aoe_alloc_iob ( aoe, sizeof ( struct aoecfg ), 0 );
 	if ( ! iobuf )
 		return -ENOMEM;
-	iob_reserve ( iobuf, ETH_HLEN );
-	aoehdr = iob_put ( iobuf, sizeof ( *aoehdr ) );
-	aoecmd = iob_put ( iobuf, aoecmdlen );
-	memset ( aoehdr, 0, ( sizeof ( *aoehdr ) + aoecmdlen ) );
+	iob_put ( iobuf, sizeof ( struct aoecfg ) );
 
-	/* Fill AoE header */
-	aoehdr->ver_flags = AOE_VERSION;
-	aoehdr->major = htons ( aoe->major );
-	aoehdr->minor = aoe->minor;
-	aoehdr->command = aoe->aoe_cmd_type;
-	aoehdr->tag = htonl ( ++aoe->tag );
+	/* Send packet */
+	return net_tx ( iobuf, aoe->netdev, &aoe_protocol, aoe->target );
+}
 
-	/* Fill AoE payload */
-	switch ( aoe->aoe_cmd_type ) {
-	case AOE_CMD_ATA:
-		/* Fill AoE command */
-		aoeata = &aoecmd->ata;
-		linker_assert ( AOE_FL_DEV_HEAD	== ATA_DEV_SLAVE,
-				__fix_ata_h__ );
-		aoeata->aflags = ( ( command->cb.lba48 ? AOE_FL_EXTENDED : 0 )|
-				   ( command->cb.device & ATA_DEV_SLAVE ) |
-				   ( data_out_len ? AOE_FL_WRITE : 0 ) );
-		aoeata->err_feat = command->cb.err_feat.bytes.cur;
-		aoeata->count = count;
-		aoeata->cmd_stat = command->cb.cmd_stat;
-		aoeata->lba.u64 = cpu_to_le64 ( command->cb.lba.native );
-		if ( ! command->cb.lba48 )
-			aoeata->lba.bytes[3] |=
-				( command->cb.device & ATA_DEV_MASK );
-
-		/* Fill data payload */
-		copy_from_user ( iob_put ( iobuf, data_out_len ),
-				 command->data_out, aoe->command_offset,
-				 data_out_len );
-		break;
-	case AOE_CMD_CONFIG:
-		/* Nothing to do */
-		break;
-	default:
-		assert ( 0 );
+/**
+ * Send AoE ATA subcommand
+ *
+ * @v subcmd		AoE subcommand
+ * @ret rc		Return status code
+ *
+ * This transmits (or retransmits) an AoE ATA command packet for a
+ * single subcommand.  It does not wait for a response.
+ */
+static int aoe_send_subcommand ( struct aoe_subcommand *subcmd ) {
+	struct aoe_session *aoe = subcmd->aoe;
+	struct ata_command *command = aoe->command;
+	struct io_buffer *iobuf;
+	struct aoeata *aoeata;
+	unsigned int data_out_len;
+
+	/* Fail immediately if we have no netdev to send on */
+	if ( ! aoe->netdev ) {
+		aoe_done ( aoe, -ENETUNREACH );
+		return -ENETUNREACH;
 	}
 
+	/* Start the retransmission timer.  Do this before attempting
+	 * to allocate the I/O buffer, in case allocation itself
+	 * fails.
+	 */
+	start_timer ( &subcmd->timer );
+
+	/* Create outgoing I/O buffer */
+	data_out_len = ( command->data_out ?
+			 ( subcmd->count * ATA_SECTOR_SIZE ) : 0 );
+	iobuf = aoe_alloc_iob ( aoe, sizeof ( *aoeata ), data_out_len );
+	if ( ! iobuf )
+		return -ENOMEM;
+	aoeata = iob_put ( iobuf, sizeof ( *aoeata ) );
+	subcmd->tag = aoe->tag;
+
+	/* Fill AoE command */
+	linker_assert ( AOE_FL_DEV_HEAD	== ATA_DEV_SLAVE, __fix_ata_h__ );
+	aoeata->aflags = ( ( command->cb.lba48 ? AOE_FL_EXTENDED : 0 ) |
+			   ( command->cb.device & ATA_DEV_SLAVE ) |
+			   ( data_out_len ? AOE_FL_WRITE : 0 ) );
+	aoeata->err_feat = command->cb.err_feat.bytes.cur;
+	aoeata->count = subcmd->count;
+	aoeata->cmd_stat = command->cb.cmd_stat;
+	aoeata->lba.u64 = cpu_to_le64 ( subcmd->lba );
+	if ( ! command->cb.lba48 )
+		aoeata->lba.bytes[3] |= ( command->cb.device & ATA_DEV_MASK );
+
+	/* Fill data payload */
+	copy_from_user ( iob_put ( iobuf, data_out_len ), command->data_out,
+			 subcmd->offset, data_out_len );
+
 	/* Send packet */
 	return net_tx ( iobuf, aoe->netdev, &aoe_protocol, aoe->target );
 }
 
 /**
- * Handle AoE retry timer expiry
+ * Issue as many ATA subcommands as the window allows
+ *
+ * @v aoe		AoE session
+ */
+static void aoe_issue_subcommands ( struct aoe_session *aoe ) {
+	struct ata_command *command = aoe->command;
+	struct aoe_subcommand *subcmd;
+	unsigned int count;
+	unsigned int i;
+
+	for ( i = 0 ; i < aoe->window ; i++ ) {
+
+		/* Stop when the whole command has been issued.  A
+		 * command with no data (and hence a zero sector
+		 * count) is issued as a single subcommand.
+		 */
+		if ( aoe->command_issued && ! command->cb.count.native )
+			return;
+
+		/* Skip busy slots */
+		subcmd = &aoe->subcmds[i];
+		if ( subcmd->busy )
+			continue;
+
+		/* Carve off the next portion of the command */
+		count = command->cb.count.native;
+		if ( count > aoe->max_count )
+			count = aoe->max_count;
+		subcmd->busy = 1;
+		subcmd->lba = command->cb.lba.native;
+		subcmd->count = count;
+		subcmd->offset = aoe->command_offset;
+		command->cb.lba.native += count;
+		command->cb.count.native -= count;
+		aoe->command_offset += ( count * ATA_SECTOR_SIZE );
+		aoe->command_issued = 1;
+
+		aoe_send_subcommand ( subcmd );
+
+		/* Sending may have failed (and completed) the whole
+		 * command
+		 */
+		if ( aoe->command != command )
+			return;
+	}
+}
+
+/**
+ * Handle AoE config retry timer expiry
  *
  * @v timer		AoE retry timer
  * @v fail		Failure indicator
@@ -199,20 +279,57 @@ static void aoe_timer_expired ( struct retry_timer *timer, int fail ) {
 	}
 }
 
+/**
+ * Handle AoE subcommand retry timer expiry
+ *
+ * @v timer		AoE subcommand retry timer
+ * @v fail		Failure indicator
+ */
+static void aoe_subcommand_expired ( struct retry_timer *timer, int fail ) {
+	struct aoe_subcommand *subcmd =
+		container_of ( timer, struct aoe_subcommand, timer );
+	struct aoe_session *aoe = subcmd->aoe;
+
+	if ( fail ) {
+		aoe_done ( aoe, -ETIMEDOUT );
+	} else {
+		DBGC ( aoe, "AoE %p retransmitting LBA %llx+%d\n", aoe,
+		       ( unsigned long long ) subcmd->lba, subcmd->count );
+		aoe_send_subcommand ( subcmd );
+	}
+}
+
 /**
  * Handle AoE configuration command response
  *
  * @v aoe		AoE session
+ * @v aoecfg		AoE config command
+ * @v len		Length of AoE config command
  * @v ll_source		Link-layer source address
  * @ret rc		Return status code
  */
-static int aoe_rx_cfg ( struct aoe_session *aoe, const void *ll_source ) {
+static int aoe_rx_cfg ( struct aoe_session *aoe, struct aoecfg *aoecfg,
+			size_t len, const void *ll_source ) {
+	unsigned int bufcnt;
 
 	/* Record target MAC address */
 	memcpy ( aoe->target, ll_source, sizeof ( aoe->target ) );
 	DBGC ( aoe, "AoE %p target MAC address %s\n",
 	       aoe, eth_ntoa ( aoe->target ) );
 
+	/* Limit subcommand size and window to what the target can
+	 * accept, if it tells us.
+	 */
+	if ( len >= sizeof ( *aoecfg ) ) {
+		if ( aoecfg->scnt && ( aoecfg->scnt < aoe->max_count ) )
+			aoe->max_count = aoecfg->scnt;
+		bufcnt = ntohs ( aoecfg->bufcnt );
+		if ( bufcnt && ( bufcnt < aoe->window ) )
+			aoe->window = bufcnt;
+	}
+	DBGC ( aoe, "AoE %p using %d sectors per packet, window %d\n",
+	       aoe, aoe->max_count, aoe->window );
+
 	/* Mark config request as complete */
 	aoe_done ( aoe, 0 );
 
@@ -222,17 +339,18 @@ static int aoe_rx_cfg ( struct aoe_session *aoe, const void *ll_source ) {
 /**
  * Handle AoE ATA command response
  *
- * @v aoe		AoE session
+ * @v subcmd		AoE subcommand
  * @v aoeata		AoE ATA command
  * @v len		Length of AoE ATA command
  * @ret rc		Return status code
  */
-static int aoe_rx_ata ( struct aoe_session *aoe, struct aoeata *aoeata,
-			size_t len ) {
+static int aoe_rx_ata ( struct aoe_subcommand *subcmd,
+			struct aoeata *aoeata, size_t len ) {
+	struct aoe_session *aoe = subcmd->aoe;
 	struct ata_command *command = aoe->command;
 	unsigned int rx_data_len;
-	unsigned int count;
 	unsigned int data_len;
+	unsigned int i;
 
 	/* Sanity check */
 	if ( len < sizeof ( *aoeata ) ) {
@@ -240,12 +358,7 @@ static int aoe_rx_ata ( struct aoe_session *aoe, struct aoeata *aoeata,
 		return -EINVAL;
 	}
 	rx_data_len = ( len - sizeof ( *aoeata ) );
-
-	/* Calculate count and data_len for this subcommand */
-	count = command->cb.count.native;
-	if ( count > AOE_MAX_COUNT )
-		count = AOE_MAX_COUNT;
-	data_len = count * ATA_SECTOR_SIZE;
+	data_len = ( subcmd->count * ATA_SECTOR_SIZE );
 
 	/* Merge into overall ATA status */
 	aoe->status |= aoeata->cmd_stat;
@@ -254,28 +367,52 @@ static int aoe_rx_ata ( struct aoe_session *aoe, struct aoeata *aoeata,
 	if ( command->data_in ) {
 		if ( rx_data_len > data_len )
 			rx_data_len = data_len;
-		copy_to_user ( command->data_in, aoe->command_offset,
+		copy_to_user ( command->data_in, subcmd->offset,
 			       aoeata->data, rx_data_len );
 	}
 
-	/* Update ATA command and offset */
-	aoe->command_offset += data_len;
-	command->cb.lba.native += count;
-	command->cb.count.native -= count;
+	/* Free subcommand slot */
+	stop_timer ( &subcmd->timer );
+	subcmd->busy = 0;
 
-	/* Check for operation complete */
-	if ( ! command->cb.count.native ) {
-		aoe_done ( aoe, 0 );
+	/* Issue further subcommands, if any remain */
+	if ( command->cb.count.native ) {
+		aoe_issue_subcommands ( aoe );
 		return 0;
 	}
 
-	/* Transmit next portion of request */
-	stop_timer ( &aoe->timer );
-	aoe_send_command ( aoe );
+	/* Check for operation complete */
+	for ( i = 0 ; i < aoe->window ; i++ ) {
+		if ( aoe->subcmds[i].busy )
+			return 0;
+	}
+	aoe_done ( aoe, 0 );
 
 	return 0;
 }
 
+/**
+ * Find outstanding AoE subcommand by tag
+ *
+ * @v aoe		AoE session
+ * @v tag		Tag
+ * @ret subcmd		AoE subcommand, or NULL
+ */
+static struct aoe_subcommand * aoe_find_subcommand ( struct aoe_session *aoe,
+						     uint32_t tag ) {
+	struct aoe_subcommand *subcmd;
+	unsigned int i;
+
+	if ( ! aoe->command )
+		return NULL;
+	for ( i = 0 ; i < aoe->window ; i++ ) {
+		subcmd = &aoe->subcmds[i];
+		if ( subcmd->busy && ( subcmd->tag == tag ) )
+			return subcmd;
+	}
+	return NULL;
+}
+
 /**
  * Process incoming AoE packets
  *
@@ -290,6 +427,8 @@ static int aoe_rx ( struct io_buffer *iobuf,
 		    const void *ll_source ) {
 	struct aoehdr *aoehdr = iobuf->data;
 	struct aoe_session *aoe;
+	struct aoe_subcommand *subcmd;
+	uint32_t tag;
 	int rc = 0;
 
 	/* Sanity checks */
@@ -308,23 +447,35 @@ static int aoe_rx ( struct io_buffer *iobuf,
 	iob_pull ( iobuf, sizeof ( *aoehdr ) );
 
 	/* Demultiplex amongst active AoE sessions */
+	tag = ntohl ( aoehdr->tag );
 	list_for_each_entry ( aoe, &aoe_sessions, list ) {
 		if ( ntohs ( aoehdr->major ) != aoe->major )
 			continue;
 		if ( aoehdr->minor != aoe->minor )
 			continue;
-		if ( ntohl ( aoehdr->tag ) != aoe->tag )
+		if ( aoehdr->command != aoe->aoe_cmd_type )
 			continue;
-		if ( aoehdr->ver_flags & AOE_FL_ERROR ) {
-			aoe_done ( aoe, -EIO );
-			break;
-		}
 		switch ( aoehdr->command ) {
 		case AOE_CMD_ATA:
-			rc = aoe_rx_ata ( aoe, iobuf->data, iob_len ( iobuf ));
+			subcmd = aoe_find_subcommand ( aoe, tag );
+			if ( ! subcmd )
+				break;
+			if ( aoehdr->ver_flags & AOE_FL_ERROR ) {
+				aoe_done ( aoe, -EIO );
+				break;
+			}
+			rc = aoe_rx_ata ( subcmd, iobuf->data,
+					  iob_len ( iobuf ) );
 			break;
 		case AOE_CMD_CONFIG:
-			rc = aoe_rx_cfg ( aoe, ll_source );
+			if ( tag != aoe->tag )
+				break;
+			if ( aoehdr->ver_flags & AOE_FL_ERROR ) {
+				aoe_done ( aoe, -EIO );
+				break;
+			}
+			rc = aoe_rx_cfg ( aoe, iobuf->data, iob_len ( iobuf ),
+					  ll_source );
 			break;
 		default:
 			DBGC ( aoe, "AoE %p ignoring command %02x\n",
@@ -358,12 +509,19 @@ static int aoe_command ( struct ata_device *ata,
 	struct aoe_session *aoe =
 		container_of ( ata->backend, struct aoe_session, refcnt );
 
+	/* Only one ATA command may be in progress at a time; its
+	 * subcommands are pipelined.
+	 */
+	if ( aoe->command )
+		return BLOCKDEV_FULL;
+
 	aoe->command = command;
 	aoe->status = 0;
 	aoe->command_offset = 0;
+	aoe->command_issued = 0;
 	aoe->aoe_cmd_type = AOE_CMD_ATA;
 
-	aoe_send_command ( aoe );
+	aoe_issue_subcommands ( aoe );
 
 	return 0;
 }
@@ -399,8 +557,11 @@ static int aoe_detached_command ( struct ata_device *ata __unused,
 void aoe_detach ( struct ata_device *ata ) {
 	struct aoe_session *aoe =
 		container_of ( ata->backend, struct aoe_session, refcnt );
+	unsigned int i;
 
 	stop_timer ( &aoe->timer );
+	for ( i = 0 ; i < AOE_MAX_OUTSTANDING ; i++ )
+		stop_timer ( &aoe->subcmds[i].timer );
 	ata->command = aoe_detached_command;
 	list_del ( &aoe->list );
 	ref_put ( ata->backend );
@@ -432,6 +593,7 @@ static int aoe_parse_root_path ( struct aoe_session *aoe,
 int aoe_attach ( struct ata_device *ata, struct net_device *netdev,
 		 const char *root_path ) {
 	struct aoe_session *aoe;
+	unsigned int i;
 	int rc;
 
 	/* Allocate and initialise structure */
@@ -443,6 +605,22 @@ int aoe_attach ( struct ata_device *ata, struct net_device *netdev,
 	memcpy ( aoe->target, netdev->ll_broadcast, sizeof ( aoe->target ) );
 	aoe->tag = AOE_TAG_MAGIC;
 	aoe->timer.expired = aoe_timer_expired;
+	for ( i = 0 ; i < AOE_MAX_OUTSTANDING ; i++ ) {
+		aoe->subcmds[i].aoe = aoe;
+		aoe->subcmds[i].timer.expired = aoe_subcommand_expired;
+	}
+
+	/* Size subcommands to fit the network device's maximum
+	 * packet length; the target may reduce this further.
+	 */
+	aoe->max_count = ( ( netdev->max_pkt_len - ETH_HLEN -
+			     sizeof ( struct aoehdr ) -
+			     sizeof ( struct aoeata ) ) / ATA_SECTOR_SIZE );
+	if ( aoe->max_count > AOE_MAX_COUNT )
+		aoe->max_count = AOE_MAX_COUNT;
+	if ( aoe->max_count < 1 )
+		aoe->max_count = 1;
+	aoe->window = AOE_MAX_OUTSTANDING;
 
 	/* Parse root path */
 	if ( ( rc = aoe_parse_root_path ( aoe, root_path ) ) != 0 )
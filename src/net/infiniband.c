@@ -203,6 +203,7 @@ struct ib_queue_pair * ib_create_qp ( struct ib_device *ibdev,
 	list_add ( &qp->recv.list, &recv_cq->work_queues );
 	qp->recv.psn = ( random() & 0xffffffUL );
 	qp->recv.num_wqes = num_recv_wqes;
+	qp->recv.len = IB_MAX_PAYLOAD_SIZE;
 	qp->recv.iobufs = ( ( ( void * ) qp ) + sizeof ( *qp ) +
 			    ( num_send_wqes * sizeof ( qp->send.iobufs[0] ) ));
 	INIT_LIST_HEAD ( &qp->mgids );
@@ -432,7 +433,7 @@ int ib_post_recv ( struct ib_device *ibdev, struct ib_queue_pair *qp,
 	int rc;
 
 	/* Check packet length */
-	if ( iob_tailroom ( iobuf ) < IB_MAX_PAYLOAD_SIZE ) {
+	if ( iob_tailroom ( iobuf ) < qp->recv.len ) {
 		DBGC ( ibdev, "IBDEV %p QPN %#lx wrong RX buffer size (%zd)\n",
 		       ibdev, qp->qpn, iob_tailroom ( iobuf ) );
 		return -EINVAL;
@@ -510,7 +511,7 @@ void ib_refill_recv ( struct ib_device *ibdev, struct ib_queue_pair *qp ) {
 	while ( qp->recv.fill < qp->recv.num_wqes ) {
 
 		/* Allocate I/O buffer */
-		iobuf = alloc_iob ( IB_MAX_PAYLOAD_SIZE );
+		iobuf = alloc_iob ( qp->recv.len );
 		if ( ! iobuf ) {
 			/* Non-fatal; we will refill on next attempt */
 			return;
@@ -39,6 +39,27 @@ FILE_LICENCE ( GPL2_OR_LATER );
 /** List of connections */
 static LIST_HEAD ( ib_cm_conns );
 
+/** List of connection listeners */
+static LIST_HEAD ( ib_cm_listeners );
+
+/**
+ * Identify connection by local communication ID
+ *
+ * @v ibdev		Infiniband device
+ * @v local_id		Local communication ID
+ * @ret conn		Connection, or NULL
+ */
+static struct ib_connection * ib_cm_find_conn ( struct ib_device *ibdev,
+						uint32_t local_id ) {
+	struct ib_connection *conn;
+
+	list_for_each_entry ( conn, &ib_cm_conns, list ) {
+		if ( ( conn->ibdev == ibdev ) && ( conn->local_id == local_id ) )
+			return conn;
+	}
+	return NULL;
+}
+
 /**
  * Send "ready to use" response
  *
@@ -112,16 +133,6 @@ static void ib_cm_connect_rep ( struct ib_device *ibdev,
 	      ntohl ( connect_rep->remote_id ) );
 }
 
-/** Communication management agents */
-struct ib_mad_agent ib_cm_agent[] __ib_mad_agent = {
-	{
-		.mgmt_class = IB_MGMT_CLASS_CM,
-		.class_version = IB_CM_CLASS_VERSION,
-		.attr_id = htons ( IB_CM_ATTR_CONNECT_REPLY ),
-		.handle = ib_cm_connect_rep,
-	},
-};
-
 /**
  * Convert connection rejection reason to return status code
  *
@@ -141,6 +152,383 @@ static int ib_cm_rejection_reason_to_rc ( uint16_t reason ) {
 	}
 }
 
+/**
+ * Send connection reply
+ *
+ * @v ibdev		Infiniband device
+ * @v mi		Management interface
+ * @v conn		Connection
+ * @v req		Connection request
+ * @v av		Address vector
+ * @ret rc		Return status code
+ */
+static int ib_cm_send_rep ( struct ib_device *ibdev,
+			    struct ib_mad_interface *mi,
+			    struct ib_connection *conn, union ib_mad *req,
+			    struct ib_address_vector *av ) {
+	struct ib_queue_pair *qp = conn->qp;
+	union ib_mad mad;
+	struct ib_cm_connect_reply *connect_rep =
+		&mad.cm.cm_data.connect_reply;
+	struct ib_gid_half local_ca;
+	size_t private_data_len;
+	int rc;
+
+	/* Construct connection reply, reusing the request's TID */
+	memset ( &mad, 0, sizeof ( mad ) );
+	memcpy ( &mad.hdr.tid, &req->hdr.tid, sizeof ( mad.hdr.tid ) );
+	mad.hdr.mgmt_class = IB_MGMT_CLASS_CM;
+	mad.hdr.class_version = IB_CM_CLASS_VERSION;
+	mad.hdr.method = IB_MGMT_METHOD_SEND;
+	mad.hdr.attr_id = htons ( IB_CM_ATTR_CONNECT_REPLY );
+	connect_rep->local_id = htonl ( conn->local_id );
+	connect_rep->remote_id = htonl ( conn->remote_id );
+	connect_rep->local_qpn = htonl ( qp->qpn << 8 );
+	connect_rep->starting_psn = htonl ( qp->recv.psn << 8 );
+	connect_rep->target_ack_delay__failover_accepted__ee_flow_ctrl =
+		( ( 0x14 << 3 ) | ( 1 << 0 ) );
+	connect_rep->rnr_retry__srq = ( 0x07 << 5 );
+	ib_get_hca_info ( ibdev, &local_ca );
+	memcpy ( &connect_rep->local_ca, &local_ca,
+		 sizeof ( connect_rep->local_ca ) );
+	private_data_len = conn->private_data_len;
+	if ( private_data_len > sizeof ( connect_rep->private_data ) )
+		private_data_len = sizeof ( connect_rep->private_data );
+	memcpy ( &connect_rep->private_data, &conn->private_data,
+		 private_data_len );
+	if ( ( rc = ib_mi_send ( ibdev, mi, &mad, av ) ) != 0 ) {
+		DBGC ( conn, "CM %p could not send REP: %s\n",
+		       conn, strerror ( rc ) );
+		return rc;
+	}
+
+	return 0;
+}
+
+/**
+ * Send connection rejection
+ *
+ * @v ibdev		Infiniband device
+ * @v mi		Management interface
+ * @v req		Connection request
+ * @v reason		Rejection reason
+ * @v av		Address vector
+ */
+static void ib_cm_send_rej ( struct ib_device *ibdev,
+			     struct ib_mad_interface *mi, union ib_mad *req,
+			     unsigned int reason,
+			     struct ib_address_vector *av ) {
+	struct ib_cm_connect_request *connect_req =
+		&req->cm.cm_data.connect_request;
+	union ib_mad mad;
+	struct ib_cm_connect_reject *connect_rej =
+		&mad.cm.cm_data.connect_reject;
+	int rc;
+
+	/* Construct connection rejection, reusing the request's TID */
+	memset ( &mad, 0, sizeof ( mad ) );
+	memcpy ( &mad.hdr.tid, &req->hdr.tid, sizeof ( mad.hdr.tid ) );
+	mad.hdr.mgmt_class = IB_MGMT_CLASS_CM;
+	mad.hdr.class_version = IB_CM_CLASS_VERSION;
+	mad.hdr.method = IB_MGMT_METHOD_SEND;
+	mad.hdr.attr_id = htons ( IB_CM_ATTR_CONNECT_REJECT );
+	connect_rej->remote_id = connect_req->local_id;
+	connect_rej->reason = htons ( reason );
+	if ( ( rc = ib_mi_send ( ibdev, mi, &mad, av ) ) != 0 ) {
+		DBG ( "CM could not send REJ: %s\n", strerror ( rc ) );
+		return;
+	}
+}
+
+/**
+ * Identify connection listener
+ *
+ * @v ibdev		Infiniband device
+ * @v service_id	Service ID
+ * @ret listener	Connection listener, or NULL
+ */
+static struct ib_listener *
+ib_cm_find_listener ( struct ib_device *ibdev,
+		      struct ib_gid_half *service_id ) {
+	struct ib_listener *listener;
+
+	list_for_each_entry ( listener, &ib_cm_listeners, list ) {
+		if ( ( listener->ibdev == ibdev ) &&
+		     ( memcmp ( &listener->service_id, service_id,
+				sizeof ( listener->service_id ) ) == 0 ) )
+			return listener;
+	}
+	return NULL;
+}
+
+/**
+ * Handle connection requests
+ *
+ * @v ibdev		Infiniband device
+ * @v mi		Management interface
+ * @v mad		Received MAD
+ * @v av		Source address vector
+ */
+static void ib_cm_connect_req ( struct ib_device *ibdev,
+				struct ib_mad_interface *mi,
+				union ib_mad *mad,
+				struct ib_address_vector *av ) {
+	struct ib_cm_connect_request *connect_req =
+		&mad->cm.cm_data.connect_request;
+	struct ib_cm_path *path = &connect_req->primary;
+	uint32_t remote_id = ntohl ( connect_req->local_id );
+	struct ib_gid_half service_id;
+	struct ib_listener *listener;
+	struct ib_connection *conn;
+	struct ib_queue_pair *qp;
+	unsigned int service_type;
+	int rc;
+
+	/* Resend reply if the peer has retransmitted its request */
+	list_for_each_entry ( conn, &ib_cm_conns, list ) {
+		if ( ( conn->ibdev != ibdev ) || ( ! conn->listener ) ||
+		     ( conn->remote_id != remote_id ) )
+			continue;
+		DBGC ( conn, "CM %p received duplicate REQ\n", conn );
+		ib_cm_send_rep ( ibdev, mi, conn, mad, av );
+		return;
+	}
+
+	/* Identify listener */
+	memcpy ( &service_id, &connect_req->service_id,
+		 sizeof ( service_id ) );
+	listener = ib_cm_find_listener ( ibdev, &service_id );
+	if ( ! listener ) {
+		DBG ( "CM no listener for service %08x:%08x\n",
+		      ntohl ( service_id.u.dwords[0] ),
+		      ntohl ( service_id.u.dwords[1] ) );
+		ib_cm_send_rej ( ibdev, mi, mad, IB_CM_REJECT_BAD_SERVICE_ID,
+				 av );
+		return;
+	}
+
+	/* Only reliable connections are supported */
+	service_type = ( ( ntohl ( connect_req->
+	    remote_eecn__remote_timeout__service_type__ee_flow_ctrl ) >> 1 )
+			 & 0x03 );
+	if ( service_type != IB_CM_TRANSPORT_RC ) {
+		DBG ( "CM unsupported transport type %d\n", service_type );
+		ib_cm_send_rej ( ibdev, mi, mad, IB_CM_REJECT_CONSUMER, av );
+		return;
+	}
+
+	/* Allocate and initialise connection */
+	conn = zalloc ( sizeof ( *conn ) + listener->private_data_len );
+	if ( ! conn ) {
+		/* Non-fatal; the peer will retry */
+		return;
+	}
+	conn->ibdev = ibdev;
+	conn->local_id = random();
+	conn->remote_id = remote_id;
+	memcpy ( &conn->service_id, &listener->service_id,
+		 sizeof ( conn->service_id ) );
+	conn->op = listener->conn_op;
+	conn->listener = listener;
+	conn->private_data_len = listener->private_data_len;
+	memcpy ( &conn->private_data, &listener->private_data,
+		 listener->private_data_len );
+	list_add ( &conn->list, &ib_cm_conns );
+
+	/* Obtain queue pair from listener */
+	qp = listener->op->accept ( ibdev, listener, conn,
+				    &connect_req->private_data,
+				    sizeof ( connect_req->private_data ) );
+	if ( ! qp ) {
+		DBGC ( conn, "CM %p rejected by listener %p\n",
+		       conn, listener );
+		ib_cm_send_rej ( ibdev, mi, mad, IB_CM_REJECT_CONSUMER, av );
+		list_del ( &conn->list );
+		free ( conn );
+		return;
+	}
+	conn->qp = qp;
+
+	/* Set up queue pair peer path */
+	memset ( &qp->av, 0, sizeof ( qp->av ) );
+	qp->av.qpn = ( ntohl ( connect_req->local_qpn__responder_resources )
+		       >> 8 );
+	qp->av.lid = ntohs ( path->local_lid );
+	qp->av.rate = ( ntohl ( path->flow_label__rate ) & 0x3f );
+	qp->av.sl = ( path->sl__subnet_local >> 4 );
+	qp->av.gid_present = ( ! ( path->sl__subnet_local & 0x08 ) );
+	memcpy ( &qp->av.gid, &path->local_gid, sizeof ( qp->av.gid ) );
+	qp->send.psn = ( ntohl ( connect_req->
+				 starting_psn__local_timeout__retry_count )
+			 >> 8 );
+	DBGC ( conn, "CM %p accepting connection from QPN %lx PSN %x\n",
+	       conn, qp->av.qpn, qp->send.psn );
+
+	/* Modify queue pair */
+	if ( ( rc = ib_modify_qp ( ibdev, qp ) ) != 0 ) {
+		DBGC ( conn, "CM %p could not modify queue pair: %s\n",
+		       conn, strerror ( rc ) );
+		ib_cm_send_rej ( ibdev, mi, mad, IB_CM_REJECT_CONSUMER, av );
+		conn->op->changed ( ibdev, qp, conn, rc, NULL, 0 );
+		return;
+	}
+
+	/* Send reply.  Treat errors as non-fatal, since the peer will
+	 * retransmit its request.
+	 */
+	ib_cm_send_rep ( ibdev, mi, conn, mad, av );
+}
+
+/**
+ * Handle "ready to use" messages
+ *
+ * @v ibdev		Infiniband device
+ * @v mi		Management interface
+ * @v mad		Received MAD
+ * @v av		Source address vector
+ */
+static void ib_cm_ready_to_use ( struct ib_device *ibdev,
+				 struct ib_mad_interface *mi __unused,
+				 union ib_mad *mad,
+				 struct ib_address_vector *av __unused ) {
+	struct ib_cm_ready_to_use *ready = &mad->cm.cm_data.ready_to_use;
+	struct ib_connection *conn;
+
+	/* Identify connection */
+	conn = ib_cm_find_conn ( ibdev, ntohl ( ready->remote_id ) );
+	if ( ( ! conn ) || ( ! conn->listener ) ) {
+		DBG ( "CM unidentified connection %08x\n",
+		      ntohl ( ready->remote_id ) );
+		return;
+	}
+
+	/* Hand off to the upper completion handler */
+	DBGC ( conn, "CM %p ready to use\n", conn );
+	conn->op->changed ( ibdev, conn->qp, conn, 0, &ready->private_data,
+			    sizeof ( ready->private_data ) );
+}
+
+/**
+ * Handle disconnection requests
+ *
+ * @v ibdev		Infiniband device
+ * @v mi		Management interface
+ * @v mad		Received MAD
+ * @v av		Source address vector
+ */
+static void ib_cm_disconnect_req ( struct ib_device *ibdev,
+				   struct ib_mad_interface *mi,
+				   union ib_mad *mad,
+				   struct ib_address_vector *av ) {
+	struct ib_cm_disconnect_request *disconnect_req =
+		&mad->cm.cm_data.disconnect_request;
+	union ib_mad reply;
+	struct ib_cm_disconnect_reply *disconnect_rep =
+		&reply.cm.cm_data.disconnect_reply;
+	struct ib_connection *conn;
+	int rc;
+
+	/* Send disconnection reply.  Do this even for connections we
+	 * do not recognise, since the request may be a retransmission
+	 * for a connection that we have already torn down.
+	 */
+	memset ( &reply, 0, sizeof ( reply ) );
+	memcpy ( &reply.hdr.tid, &mad->hdr.tid, sizeof ( reply.hdr.tid ) );
+	reply.hdr.mgmt_class = IB_MGMT_CLASS_CM;
+	reply.hdr.class_version = IB_CM_CLASS_VERSION;
+	reply.hdr.method = IB_MGMT_METHOD_SEND;
+	reply.hdr.attr_id = htons ( IB_CM_ATTR_DISCONNECT_REPLY );
+	disconnect_rep->local_id = disconnect_req->remote_id;
+	disconnect_rep->remote_id = disconnect_req->local_id;
+	if ( ( rc = ib_mi_send ( ibdev, mi, &reply, av ) ) != 0 ) {
+		DBG ( "CM could not send DREP: %s\n", strerror ( rc ) );
+		/* Continue; the peer will retransmit its request */
+	}
+
+	/* Identify connection */
+	conn = ib_cm_find_conn ( ibdev, ntohl ( disconnect_req->remote_id ) );
+	if ( ! conn ) {
+		DBG ( "CM unidentified connection %08x\n",
+		      ntohl ( disconnect_req->remote_id ) );
+		return;
+	}
+
+	/* Hand off to the upper completion handler */
+	DBGC ( conn, "CM %p disconnected by peer\n", conn );
+	conn->op->changed ( ibdev, conn->qp, conn, -ECONNRESET,
+			    &disconnect_req->private_data,
+			    sizeof ( disconnect_req->private_data ) );
+}
+
+/**
+ * Handle connection rejections outside of a connection request
+ *
+ * @v ibdev		Infiniband device
+ * @v mi		Management interface
+ * @v mad		Received MAD
+ * @v av		Source address vector
+ *
+ * A peer may reject a connection after we have replied to its
+ * connection request (e.g. if our reply arrives too late).
+ */
+static void ib_cm_connect_rej ( struct ib_device *ibdev,
+				struct ib_mad_interface *mi __unused,
+				union ib_mad *mad,
+				struct ib_address_vector *av __unused ) {
+	struct ib_cm_connect_reject *connect_rej =
+		&mad->cm.cm_data.connect_reject;
+	struct ib_connection *conn;
+	int rc;
+
+	/* Identify connection */
+	conn = ib_cm_find_conn ( ibdev, ntohl ( connect_rej->remote_id ) );
+	if ( ! conn ) {
+		DBG ( "CM unidentified connection %08x\n",
+		      ntohl ( connect_rej->remote_id ) );
+		return;
+	}
+
+	/* Hand off to the upper completion handler */
+	DBGC ( conn, "CM %p connection rejected (reason %d)\n",
+	       conn, ntohs ( connect_rej->reason ) );
+	rc = ib_cm_rejection_reason_to_rc ( connect_rej->reason );
+	conn->op->changed ( ibdev, conn->qp, conn, rc, NULL, 0 );
+}
+
+/** Communication management agents */
+struct ib_mad_agent ib_cm_agent[] __ib_mad_agent = {
+	{
+		.mgmt_class = IB_MGMT_CLASS_CM,
+		.class_version = IB_CM_CLASS_VERSION,
+		.attr_id = htons ( IB_CM_ATTR_CONNECT_REQUEST ),
+		.handle = ib_cm_connect_req,
+	},
+	{
+		.mgmt_class = IB_MGMT_CLASS_CM,
+		.class_version = IB_CM_CLASS_VERSION,
+		.attr_id = htons ( IB_CM_ATTR_CONNECT_REJECT ),
+		.handle = ib_cm_connect_rej,
+	},
+	{
+		.mgmt_class = IB_MGMT_CLASS_CM,
+		.class_version = IB_CM_CLASS_VERSION,
+		.attr_id = htons ( IB_CM_ATTR_CONNECT_REPLY ),
+		.handle = ib_cm_connect_rep,
+	},
+	{
+		.mgmt_class = IB_MGMT_CLASS_CM,
+		.class_version = IB_CM_CLASS_VERSION,
+		.attr_id = htons ( IB_CM_ATTR_READY_TO_USE ),
+		.handle = ib_cm_ready_to_use,
+	},
+	{
+		.mgmt_class = IB_MGMT_CLASS_CM,
+		.class_version = IB_CM_CLASS_VERSION,
+		.attr_id = htons ( IB_CM_ATTR_DISCONNECT_REQUEST ),
+		.handle = ib_cm_disconnect_req,
+	},
+};
+
 /**
  * Handle connection request transaction completion
  *
@@ -254,6 +642,7 @@ static void ib_cm_path_complete ( struct ib_device *ibdev,
 	union ib_mad mad;
 	struct ib_cm_connect_request *connect_req =
 		&mad.cm.cm_data.connect_request;
+	struct ib_gid_half local_ca;
 	size_t private_data_len;
 
 	/* Report failures */
@@ -276,7 +665,9 @@ static void ib_cm_path_complete ( struct ib_device *ibdev,
 	connect_req->local_id = htonl ( conn->local_id );
 	memcpy ( &connect_req->service_id, &conn->service_id,
 		 sizeof ( connect_req->service_id ) );
-	ib_get_hca_info ( ibdev, &connect_req->local_ca );
+	ib_get_hca_info ( ibdev, &local_ca );
+	memcpy ( &connect_req->local_ca, &local_ca,
+		 sizeof ( connect_req->local_ca ) );
 	connect_req->local_qpn__responder_resources =
 		htonl ( ( qp->qpn << 8 ) | 1 );
 	connect_req->local_eecn__initiator_depth = htonl ( ( 0 << 8 ) | 1 );
@@ -411,3 +802,58 @@ void ib_destroy_conn ( struct ib_device *ibdev,
 		ib_destroy_path ( ibdev, conn->path );
 	free ( conn );
 }
+
+/**
+ * Create connection listener
+ *
+ * @v ibdev		Infiniband device
+ * @v service_id	Service ID
+ * @v private_data	Connection reply private data
+ * @v private_data_len	Length of connection reply private data
+ * @v op		Listener operations
+ * @v conn_op		Operations for accepted connections
+ * @ret listener	Connection listener
+ */
+struct ib_listener *
+ib_create_listener ( struct ib_device *ibdev, struct ib_gid_half *service_id,
+		     void *private_data, size_t private_data_len,
+		     struct ib_listener_operations *op,
+		     struct ib_connection_operations *conn_op ) {
+	struct ib_listener *listener;
+
+	/* Allocate and initialise listener */
+	listener = zalloc ( sizeof ( *listener ) + private_data_len );
+	if ( ! listener )
+		return NULL;
+	listener->ibdev = ibdev;
+	memcpy ( &listener->service_id, service_id,
+		 sizeof ( listener->service_id ) );
+	listener->op = op;
+	listener->conn_op = conn_op;
+	listener->private_data_len = private_data_len;
+	memcpy ( &listener->private_data, private_data, private_data_len );
+
+	/* Add to list of listeners */
+	list_add ( &listener->list, &ib_cm_listeners );
+
+	DBGC ( listener, "CM %p listening on IBDEV %p service %08x:%08x\n",
+	       listener, ibdev, ntohl ( service_id->u.dwords[0] ),
+	       ntohl ( service_id->u.dwords[1] ) );
+
+	return listener;
+}
+
+/**
+ * Destroy connection listener
+ *
+ * @v ibdev		Infiniband device
+ * @v listener		Connection listener
+ *
+ * Connections already accepted by the listener are not affected.
+ */
+void ib_destroy_listener ( struct ib_device *ibdev __unused,
+			   struct ib_listener *listener ) {
+
+	list_del ( &listener->list );
+	free ( listener );
+}
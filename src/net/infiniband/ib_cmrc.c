@@ -51,19 +51,20 @@ FILE_LICENCE ( BSD2 );
  *
  * This is a policy decision.
  */
-#define IB_CMRC_NUM_SEND_WQES 4
+#define IB_CMRC_NUM_SEND_WQES 16
 
 /** CMRC number of receive WQEs
  *
- * This is a policy decision.
+ * This is a policy decision.  It should be large enough to hold one
+ * response for every outstanding SRP command.
  */
-#define IB_CMRC_NUM_RECV_WQES 2
+#define IB_CMRC_NUM_RECV_WQES 16
 
 /** CMRC number of completion queue entries
  *
  * This is a policy decision
  */
-#define IB_CMRC_NUM_CQES 8
+#define IB_CMRC_NUM_CQES 32
 
 /** An Infiniband Communication-Managed Reliable Connection */
 struct ib_cmrc_connection {
@@ -371,6 +371,26 @@ static int ipv4_tx ( struct io_buffer *iobuf,
 	return rc;
 }
 
+/**
+ * Determine IPv4 maximum transmission unit
+ *
+ * @v st_dest		Destination address
+ * @ret mtu		Maximum transport-layer packet length, or 0 if unknown
+ */
+static size_t ipv4_mtu ( struct sockaddr_tcpip *st_dest ) {
+	struct sockaddr_in *sin_dest = ( ( struct sockaddr_in * ) st_dest );
+	struct in_addr next_hop = sin_dest->sin_addr;
+	struct ipv4_miniroute *miniroute;
+	size_t mtu;
+
+	if ( ! ( miniroute = ipv4_route ( &next_hop ) ) )
+		return 0;
+	mtu = miniroute->netdev->mtu;
+	if ( mtu <= sizeof ( struct iphdr ) )
+		return 0;
+	return ( mtu - sizeof ( struct iphdr ) );
+}
+
 /**
  * Process incoming packets
  *
@@ -537,6 +557,7 @@ struct tcpip_net_protocol ipv4_tcpip_protocol __tcpip_net_protocol = {
 	.name = "IPv4",
 	.sa_family = AF_INET,
 	.tx = ipv4_tx,
+	.mtu = ipv4_mtu,
 };
 
 /** IPv4 ARP protocol */
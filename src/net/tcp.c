@@ -79,6 +79,10 @@ struct tcp_connection {
 	uint32_t ts_recent;
 	/** Timestamps enabled */
 	int timestamps;
+	/** Advertised maximum segment size */
+	size_t mss;
+	/** Maximum receive window */
+	uint32_t max_rcv_win;
 
 	/** Transmit queue */
 	struct list_head queue;
@@ -217,6 +221,7 @@ static int tcp_open ( struct xfer_interface *xfer, struct sockaddr *peer,
 	struct sockaddr_tcpip *st_local = ( struct sockaddr_tcpip * ) local;
 	struct tcp_connection *tcp;
 	unsigned int bind_port;
+	size_t mtu;
 	int rc;
 
 	/* Allocate and initialise structure */
@@ -233,6 +238,22 @@ static int tcp_open ( struct xfer_interface *xfer, struct sockaddr *peer,
 	tcp->timer.expired = tcp_expired;
 	memcpy ( &tcp->peer, st_peer, sizeof ( tcp->peer ) );
 
+	/* Size the advertised MSS and receive window to suit the
+	 * network device used to reach the peer.
+	 */
+	mtu = tcpip_mtu ( &tcp->peer );
+	tcp->mss = ( ( mtu > sizeof ( struct tcp_header ) ) ?
+		     ( mtu - sizeof ( struct tcp_header ) ) : TCP_MSS );
+	if ( tcp->mss > TCP_MAX_MSS )
+		tcp->mss = TCP_MAX_MSS;
+	tcp->max_rcv_win = ( 2 * tcp->mss );
+	if ( tcp->max_rcv_win < TCP_MAX_WINDOW_SIZE )
+		tcp->max_rcv_win = TCP_MAX_WINDOW_SIZE;
+	if ( tcp->max_rcv_win > TCP_WINDOW_LIMIT )
+		tcp->max_rcv_win = TCP_WINDOW_LIMIT;
+	DBGC ( tcp, "TCP %p using MSS %zd window %d\n",
+	       tcp, tcp->mss, tcp->max_rcv_win );
+
 	/* Bind to local port */
 	bind_port = ( st_local ? st_local->st_port : 0 );
 	if ( ( rc = tcp_bind ( tcp, bind_port ) ) != 0 )
@@ -451,8 +472,8 @@ static int tcp_xmit ( struct tcp_connection *tcp, int force_send ) {
 
 	/* Expand receive window if possible */
 	max_rcv_win = ( ( freemem * 3 ) / 4 );
-	if ( max_rcv_win > TCP_MAX_WINDOW_SIZE )
-		max_rcv_win = TCP_MAX_WINDOW_SIZE;
+	if ( max_rcv_win > tcp->max_rcv_win )
+		max_rcv_win = tcp->max_rcv_win;
 	app_win = xfer_window ( &tcp->xfer );
 	if ( max_rcv_win > app_win )
 		max_rcv_win = app_win;
@@ -466,7 +487,7 @@ static int tcp_xmit ( struct tcp_connection *tcp, int force_send ) {
 		mssopt = iob_push ( iobuf, sizeof ( *mssopt ) );
 		mssopt->kind = TCP_OPTION_MSS;
 		mssopt->length = sizeof ( *mssopt );
-		mssopt->mss = htons ( TCP_MSS );
+		mssopt->mss = htons ( tcp->mss );
 	}
 	if ( ( flags & TCP_SYN ) || tcp->timestamps ) {
 		tsopt = iob_push ( iobuf, sizeof ( *tsopt ) );
@@ -533,6 +533,7 @@ static struct xfer_interface_operations http_xfer_operations = {
 int http_open_filter ( struct xfer_interface *xfer, struct uri *uri,
 		       unsigned int default_port,
 		       int ( * filter ) ( struct xfer_interface *xfer,
+					  const char *name,
 					  struct xfer_interface **next ) ) {
 	struct http_request *http;
 	struct sockaddr_tcpip server;
@@ -558,7 +559,7 @@ int http_open_filter ( struct xfer_interface *xfer, struct uri *uri,
 	server.st_port = htons ( uri_port ( http->uri, default_port ) );
 	socket = &http->socket;
 	if ( filter ) {
-		if ( ( rc = filter ( socket, &socket ) ) != 0 )
+		if ( ( rc = filter ( socket, uri->host, &socket ) ) != 0 )
 			goto err;
 	}
 	if ( ( rc = xfer_open_named_socket ( socket, SOCK_STREAM,
@@ -37,6 +37,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <gpxe/features.h>
 #include <gpxe/base16.h>
 #include <gpxe/base64.h>
+#include <gpxe/crc32c.h>
 #include <gpxe/iscsi.h>
 
 /** @file
@@ -50,6 +51,8 @@ FEATURE ( FEATURE_PROTOCOL, "iSCSI", DHCP_EB_FEATURE_ISCSI, 1 );
 /* Disambiguate the various error causes */
 #define EACCES_INCORRECT_TARGET_USERNAME ( EACCES | EUNIQ_01 )
 #define EACCES_INCORRECT_TARGET_PASSWORD ( EACCES | EUNIQ_02 )
+#define EIO_HEADER_DIGEST ( EIO | EUNIQ_01 )
+#define EIO_DATA_DIGEST ( EIO | EUNIQ_02 )
 #define ENOTSUP_INITIATOR_STATUS ( ENOTSUP | EUNIQ_01 )
 #define ENOTSUP_OPCODE ( ENOTSUP | EUNIQ_02 )
 #define ENOTSUP_DISCOVERY ( ENOTSUP | EUNIQ_03 )
@@ -59,6 +62,9 @@ FEATURE ( FEATURE_PROTOCOL, "iSCSI", DHCP_EB_FEATURE_ISCSI, 1 );
 #define EPROTO_INVALID_CHAP_IDENTIFIER ( EPROTO | EUNIQ_02 )
 #define EPROTO_INVALID_LARGE_BINARY ( EPROTO | EUNIQ_03 )
 #define EPROTO_INVALID_CHAP_RESPONSE ( EPROTO | EUNIQ_04 )
+#define EPROTO_INVALID_ITT ( EPROTO | EUNIQ_05 )
+#define EPROTO_INVALID_KEY_VALUE ( EPROTO | EUNIQ_06 )
+#define EPROTO_TOO_MANY_R2TS ( EPROTO | EUNIQ_07 )
 
 /** iSCSI initiator name (explicitly specified) */
 static char *iscsi_explicit_initiator_iqn;
@@ -78,9 +84,22 @@ static char *iscsi_target_username;
 /** iSCSI target password */
 static char *iscsi_target_password;
 
+/** Send unsolicited data (ImmediateData=Yes, InitialR2T=No) */
+static int iscsi_immediate_data = 1;
+
+/** iSCSI MaxRecvDataSegmentLength to declare */
+static unsigned long iscsi_max_recv_len = ISCSI_DEFAULT_MAX_RECV_LEN;
+
+/** iSCSI MaxOutstandingR2T to offer */
+static unsigned long iscsi_max_r2t = ISCSI_DEFAULT_MAX_OUTSTANDING_R2T;
+
+/** Require iSCSI header and data digests */
+static int iscsi_digests_required;
+
 static void iscsi_start_tx ( struct iscsi_session *iscsi );
 static void iscsi_start_login ( struct iscsi_session *iscsi );
 static void iscsi_start_data_out ( struct iscsi_session *iscsi,
+				   struct iscsi_task *task,
 				   unsigned int datasn );
 
 /**
@@ -145,6 +164,15 @@ static int iscsi_open_connection ( struct iscsi_session *iscsi ) {
 	if ( iscsi->target_username )
 		iscsi->status |= ISCSI_STATUS_AUTH_REVERSE_REQUIRED;
 
+	/* Assume the most conservative operational parameters until
+	 * we have negotiated otherwise.
+	 */
+	iscsi->immediate_data = 0;
+	iscsi->initial_r2t = 1;
+	iscsi->max_send_len = ISCSI_RFC_MAX_RECV_LEN;
+	iscsi->first_burst_len = ISCSI_FIRST_BURST_LEN;
+	iscsi->digests = 0;
+
 	/* Assign fresh initiator task tag */
 	iscsi->itt++;
 
@@ -164,6 +192,8 @@ static int iscsi_open_connection ( struct iscsi_session *iscsi ) {
  * ready to attempt a fresh login.
  */
 static void iscsi_close_connection ( struct iscsi_session *iscsi, int rc ) {
+	struct iscsi_task *task;
+	unsigned int i;
 
 	/* Close all data transfer interfaces */
 	xfer_close ( &iscsi->socket, rc );
@@ -175,6 +205,19 @@ static void iscsi_close_connection ( struct iscsi_session *iscsi, int rc ) {
 	iscsi->tx_state = ISCSI_TX_IDLE;
 	iscsi->rx_state = ISCSI_RX_BHS;
 	iscsi->rx_offset = 0;
+	iscsi->tx_task = NULL;
+	iscsi->rx_task = NULL;
+
+	/* Any outstanding commands must be reissued on the next
+	 * connection.  We use DefaultTime2Retain=0, so the target
+	 * will not have retained any state for them.
+	 */
+	for ( i = 0 ; i < ISCSI_MAX_TASKS ; i++ ) {
+		task = &iscsi->tasks[i];
+		if ( task->command )
+			task->flags = ISCSI_TASK_SEND_COMMAND;
+		task->transfer_prod = task->transfer_cons = 0;
+	}
 
 	/* Free any temporary dynamically allocated memory */
 	chap_finish ( &iscsi->chap );
@@ -182,25 +225,115 @@ static void iscsi_close_connection ( struct iscsi_session *iscsi, int rc ) {
 }
 
 /**
- * Mark iSCSI SCSI operation as complete
+ * Mark iSCSI task as complete
  *
  * @v iscsi		iSCSI session
+ * @v task		iSCSI task
  * @v rc		Return status code
  *
- * Note that iscsi_scsi_done() will not close the connection, and must
- * therefore be called only when the internal state machines are in an
- * appropriate state, otherwise bad things may happen on the next call
- * to iscsi_issue().  The general rule is to call iscsi_scsi_done()
- * only at the end of receiving a PDU; at this point the TX and RX
- * engines should both be idle.
+ * The task table entry is freed for reuse.  If the TX engine is part
+ * way through transmitting a PDU belonging to this task, the
+ * remainder of that PDU will be padded out without reference to the
+ * (now completed) SCSI command.
  */
-static void iscsi_scsi_done ( struct iscsi_session *iscsi, int rc ) {
+static void iscsi_task_done ( struct iscsi_session *iscsi,
+			      struct iscsi_task *task, int rc ) {
+	struct scsi_command *command = task->command;
 
-	assert ( iscsi->tx_state == ISCSI_TX_IDLE );
-	assert ( iscsi->command != NULL );
+	assert ( command != NULL );
+
+	DBGC2 ( iscsi, "iSCSI %p ITT %#x complete: %s\n",
+		iscsi, task->itt, strerror ( rc ) );
+	if ( iscsi->tx_task == task )
+		iscsi->tx_task = NULL;
+	task->command = NULL;
+	task->flags = 0;
+
+	/* Complete command last, since the completion handler may
+	 * issue a new command.
+	 */
+	scsi_command_done ( command, rc );
+}
+
+/**
+ * Mark iSCSI task as completed by the current RX PDU
+ *
+ * @v iscsi		iSCSI session
+ * @v task		iSCSI task
+ * @v rc		Return status code
+ *
+ * The task will be completed once the whole PDU has been received,
+ * so that a data digest error can still fail the task.
+ */
+static void iscsi_rx_task_done ( struct iscsi_session *iscsi,
+				 struct iscsi_task *task, int rc ) {
+	iscsi->rx_task = task;
+	iscsi->rx_task_rc = rc;
+}
+
+/**
+ * Fail all outstanding iSCSI tasks
+ *
+ * @v iscsi		iSCSI session
+ * @v rc		Return status code
+ */
+static void iscsi_fail_tasks ( struct iscsi_session *iscsi, int rc ) {
+	struct iscsi_task *task;
+	unsigned int i;
+
+	for ( i = 0 ; i < ISCSI_MAX_TASKS ; i++ ) {
+		task = &iscsi->tasks[i];
+		if ( task->command )
+			iscsi_task_done ( iscsi, task, rc );
+	}
+}
+
+/**
+ * Queue iSCSI data-out transfer
+ *
+ * @v iscsi		iSCSI session
+ * @v task		iSCSI task
+ * @v ttt		Target transfer tag
+ * @v offset		Offset within data-out buffer
+ * @v len		Length of transfer
+ * @ret rc		Return status code
+ */
+static int iscsi_queue_transfer ( struct iscsi_session *iscsi,
+				  struct iscsi_task *task, uint32_t ttt,
+				  uint32_t offset, uint32_t len ) {
+	struct iscsi_transfer *transfer;
+
+	if ( ( task->transfer_prod - task->transfer_cons ) >=
+	     ISCSI_MAX_TRANSFERS ) {
+		DBGC ( iscsi, "iSCSI %p ITT %#x has too many outstanding "
+		       "R2Ts\n", iscsi, task->itt );
+		return -EPROTO_TOO_MANY_R2TS;
+	}
+	transfer = &task->transfers[ task->transfer_prod++ %
+				     ISCSI_MAX_TRANSFERS ];
+	transfer->ttt = ttt;
+	transfer->offset = offset;
+	transfer->len = len;
+	return 0;
+}
 
-	iscsi->command->rc = rc;
-	iscsi->command = NULL;
+/**
+ * Identify iSCSI task by initiator task tag
+ *
+ * @v iscsi		iSCSI session
+ * @v itt		Initiator task tag
+ * @ret task		iSCSI task, or NULL if not found
+ */
+static struct iscsi_task * iscsi_find_task ( struct iscsi_session *iscsi,
+					     uint32_t itt ) {
+	struct iscsi_task *task = &iscsi->tasks[ ISCSI_TAG_INDEX ( itt ) ];
+
+	if ( ( task->command == NULL ) || ( task->itt != itt ) ) {
+		DBGC ( iscsi, "iSCSI %p received PDU for unknown ITT %#x\n",
+		       iscsi, itt );
+		return NULL;
+	}
+	return task;
 }
 
 /****************************************************************************
@@ -213,40 +346,199 @@ static void iscsi_scsi_done ( struct iscsi_session *iscsi, int rc ) {
  * Build iSCSI SCSI command BHS
  *
  * @v iscsi		iSCSI session
+ * @v task		iSCSI task
  *
  * We don't currently support bidirectional commands (i.e. with both
  * Data-In and Data-Out segments); these would require providing code
  * to generate an AHS, and there doesn't seem to be any need for it at
  * the moment.
  */
-static void iscsi_start_command ( struct iscsi_session *iscsi ) {
+static void iscsi_start_command ( struct iscsi_session *iscsi,
+				  struct iscsi_task *task ) {
 	struct iscsi_bhs_scsi_command *command = &iscsi->tx_bhs.scsi_command;
+	struct scsi_command *scsi_command = task->command;
+	size_t unsolicited_len = 0;
+	size_t immediate_len = 0;
 
-	assert ( ! ( iscsi->command->data_in && iscsi->command->data_out ) );
+	assert ( ! ( scsi_command->data_in && scsi_command->data_out ) );
+
+	/* Determine how much write data we may send without waiting
+	 * for an R2T, and how much of that may be sent as immediate
+	 * data within the command PDU itself.
+	 */
+	if ( scsi_command->data_out ) {
+		unsolicited_len = scsi_command->data_out_len;
+		if ( unsolicited_len > iscsi->first_burst_len )
+			unsolicited_len = iscsi->first_burst_len;
+		if ( iscsi->immediate_data ) {
+			immediate_len = unsolicited_len;
+			if ( immediate_len > iscsi->max_send_len )
+				immediate_len = iscsi->max_send_len;
+		}
+		if ( iscsi->initial_r2t )
+			unsolicited_len = immediate_len;
+	}
 
 	/* Construct BHS and initiate transmission */
 	iscsi_start_tx ( iscsi );
+	iscsi->tx_task = task;
+	task->flags &= ~ISCSI_TASK_SEND_COMMAND;
 	command->opcode = ISCSI_OPCODE_SCSI_COMMAND;
-	command->flags = ( ISCSI_FLAG_FINAL |
-			   ISCSI_COMMAND_ATTR_SIMPLE );
-	if ( iscsi->command->data_in )
+	command->flags = ISCSI_COMMAND_ATTR_SIMPLE;
+	if ( unsolicited_len == immediate_len )
+		command->flags |= ISCSI_FLAG_FINAL;
+	if ( scsi_command->data_in )
 		command->flags |= ISCSI_COMMAND_FLAG_READ;
-	if ( iscsi->command->data_out )
+	if ( scsi_command->data_out )
 		command->flags |= ISCSI_COMMAND_FLAG_WRITE;
-	/* lengths left as zero */
+	ISCSI_SET_LENGTHS ( command->lengths, 0, immediate_len );
 	command->lun = iscsi->lun;
-	command->itt = htonl ( ++iscsi->itt );
-	command->exp_len = htonl ( iscsi->command->data_in_len |
-				   iscsi->command->data_out_len );
-	command->cmdsn = htonl ( iscsi->cmdsn );
+	command->itt = htonl ( task->itt );
+	command->exp_len = htonl ( scsi_command->data_in_len |
+				   scsi_command->data_out_len );
+	command->cmdsn = htonl ( iscsi->cmdsn++ );
 	command->expstatsn = htonl ( iscsi->statsn + 1 );
-	memcpy ( &command->cdb, &iscsi->command->cdb, sizeof ( command->cdb ));
-	DBGC2 ( iscsi, "iSCSI %p start " SCSI_CDB_FORMAT " %s %#zx\n",
-		iscsi, SCSI_CDB_DATA ( command->cdb ),
-		( iscsi->command->data_in ? "in" : "out" ),
-		( iscsi->command->data_in ?
-		  iscsi->command->data_in_len :
-		  iscsi->command->data_out_len ) );
+	memcpy ( &command->cdb, &scsi_command->cdb, sizeof ( command->cdb ) );
+	DBGC2 ( iscsi, "iSCSI %p ITT %#x CmdSN %#x start " SCSI_CDB_FORMAT
+		" %s %#zx\n", iscsi, task->itt, ntohl ( command->cmdsn ),
+		SCSI_CDB_DATA ( command->cdb ),
+		( scsi_command->data_in ? "in" : "out" ),
+		( scsi_command->data_in ?
+		  scsi_command->data_in_len : scsi_command->data_out_len ) );
+
+	/* Queue any unsolicited data-out PDUs to follow the command */
+	if ( unsolicited_len > immediate_len ) {
+		iscsi_queue_transfer ( iscsi, task, ISCSI_TAG_RESERVED,
+				       immediate_len,
+				       ( unsolicited_len - immediate_len ) );
+	}
+}
+
+/**
+ * Send iSCSI data segment from SCSI command data-out buffer
+ *
+ * @v iscsi		iSCSI session
+ * @v offset		Offset within data-out buffer
+ * @v len		Length of data segment
+ * @ret rc		Return status code
+ *
+ * Sends the next fragment of the data segment, starting at
+ * iscsi::tx_offset.  iscsi::tx_offset is returned to zero once the
+ * whole data segment has been sent.
+ */
+static int iscsi_tx_data_out_buffer ( struct iscsi_session *iscsi,
+				      unsigned long offset, size_t len ) {
+	struct iscsi_task *task = iscsi->tx_task;
+	struct io_buffer *iobuf;
+	uint32_t crc = iscsi->tx_crc;
+	size_t window;
+	size_t frag_len;
+	int rc;
+
+	/* Limit fragment to available window and maximum length */
+	offset += iscsi->tx_offset;
+	frag_len = ( len - iscsi->tx_offset );
+	if ( frag_len > ISCSI_TX_FRAG_LEN )
+		frag_len = ISCSI_TX_FRAG_LEN;
+	window = xfer_window ( &iscsi->socket );
+	if ( frag_len > window )
+		frag_len = window;
+
+	iobuf = xfer_alloc_iob ( &iscsi->socket, frag_len );
+	if ( ! iobuf )
+		return -ENOMEM;
+
+	/* If the task has already completed, we must still complete
+	 * the PDU in order to keep the stream in sync.
+	 */
+	if ( task ) {
+		assert ( task->command->data_out );
+		assert ( ( offset + frag_len ) <=
+			 task->command->data_out_len );
+		copy_from_user ( iob_put ( iobuf, frag_len ),
+				 task->command->data_out, offset, frag_len );
+	} else {
+		memset ( iob_put ( iobuf, frag_len ), 0, frag_len );
+	}
+
+	/* Update data digest as the data goes past */
+	if ( iscsi->tx_digests & ISCSI_DIGEST_DATA )
+		crc = crc32c_le ( crc, iobuf->data, frag_len );
+
+	if ( ( rc = xfer_deliver_iob ( &iscsi->socket, iobuf ) ) != 0 )
+		return rc;
+	iscsi->tx_crc = crc;
+	iscsi->tx_offset += frag_len;
+	if ( iscsi->tx_offset == len )
+		iscsi->tx_offset = 0;
+	return 0;
+}
+
+/**
+ * Send iSCSI SCSI command immediate data segment
+ *
+ * @v iscsi		iSCSI session
+ * @ret rc		Return status code
+ */
+static int iscsi_tx_scsi_command ( struct iscsi_session *iscsi ) {
+	struct iscsi_bhs_scsi_command *command = &iscsi->tx_bhs.scsi_command;
+	size_t len = ISCSI_DATA_LEN ( command->lengths );
+
+	if ( ! len )
+		return 0;
+	return iscsi_tx_data_out_buffer ( iscsi, 0, len );
+}
+
+/**
+ * Start transmitting next PDU for outstanding tasks, if any
+ *
+ * @v iscsi		iSCSI session
+ * @ret started		A new PDU has been started
+ *
+ * Data-out sequences take priority over new commands, since the
+ * target is already waiting for them.  New commands are
+ * issued in the order in which they were submitted, as far as the
+ * target's CmdSN window permits.
+ */
+static int iscsi_start_next ( struct iscsi_session *iscsi ) {
+	struct iscsi_task *task;
+	struct iscsi_task *next = NULL;
+	unsigned int i;
+
+	/* Do nothing until we have reached the full feature phase */
+	if ( ( iscsi->status & ISCSI_STATUS_PHASE_MASK ) !=
+	     ISCSI_STATUS_FULL_FEATURE_PHASE )
+		return 0;
+
+	/* Send any queued data-out sequence */
+	for ( i = 0 ; i < ISCSI_MAX_TASKS ; i++ ) {
+		task = &iscsi->tasks[i];
+		if ( task->transfer_prod != task->transfer_cons ) {
+			memcpy ( &iscsi->tx_transfer,
+				 &task->transfers[ task->transfer_cons++ %
+						   ISCSI_MAX_TRANSFERS ],
+				 sizeof ( iscsi->tx_transfer ) );
+			iscsi_start_data_out ( iscsi, task, 0 );
+			return 1;
+		}
+	}
+
+	/* Check that the target will accept another command */
+	if ( ( int32_t ) ( iscsi->cmdsn - iscsi->max_cmdsn ) > 0 )
+		return 0;
+
+	/* Send oldest queued command, if any */
+	for ( i = 0 ; i < ISCSI_MAX_TASKS ; i++ ) {
+		task = &iscsi->tasks[i];
+		if ( ! ( task->flags & ISCSI_TASK_SEND_COMMAND ) )
+			continue;
+		if ( ( ! next ) || ( ( int32_t ) ( task->itt - next->itt ) < 0 ))
+			next = task;
+	}
+	if ( ! next )
+		return 0;
+	iscsi_start_command ( iscsi, next );
+	return 1;
 }
 
 /**
@@ -263,12 +555,18 @@ static int iscsi_rx_scsi_response ( struct iscsi_session *iscsi,
 				    size_t remaining ) {
 	struct iscsi_bhs_scsi_response *response
 		= &iscsi->rx_bhs.scsi_response;
+	struct iscsi_task *task;
 	int sense_offset;
 
+	/* Identify task */
+	task = iscsi_find_task ( iscsi, ntohl ( response->itt ) );
+	if ( ! task )
+		return -EPROTO_INVALID_ITT;
+
 	/* Capture the sense response code as it floats past, if present */
 	sense_offset = ISCSI_SENSE_RESPONSE_CODE_OFFSET - iscsi->rx_offset;
-	if ( ( sense_offset >= 0 ) && len ) {
-		iscsi->command->sense_response =
+	if ( ( sense_offset >= 0 ) && ( ( size_t ) sense_offset < len ) ) {
+		task->command->sense_response =
 			* ( ( char * ) data + sense_offset );
 	}
 
@@ -277,14 +575,12 @@ static int iscsi_rx_scsi_response ( struct iscsi_session *iscsi,
 		return 0;
 	
 	/* Record SCSI status code */
-	iscsi->command->status = response->status;
-
-	/* Check for errors */
-	if ( response->response != ISCSI_RESPONSE_COMMAND_COMPLETE )
-		return -EIO;
+	task->command->status = response->status;
 
-	/* Mark as completed */
-	iscsi_scsi_done ( iscsi, 0 );
+	/* Mark as completed, failing the command on any iSCSI error */
+	iscsi_rx_task_done ( iscsi, task,
+			     ( ( response->response ==
+				 ISCSI_RESPONSE_COMMAND_COMPLETE ) ? 0 : -EIO ) );
 	return 0;
 }
 
@@ -301,14 +597,19 @@ static int iscsi_rx_data_in ( struct iscsi_session *iscsi,
 			      const void *data, size_t len,
 			      size_t remaining ) {
 	struct iscsi_bhs_data_in *data_in = &iscsi->rx_bhs.data_in;
+	struct iscsi_task *task;
 	unsigned long offset;
 
+	/* Identify task */
+	task = iscsi_find_task ( iscsi, ntohl ( data_in->itt ) );
+	if ( ! task )
+		return -EPROTO_INVALID_ITT;
+
 	/* Copy data to data-in buffer */
 	offset = ntohl ( data_in->offset ) + iscsi->rx_offset;
-	assert ( iscsi->command != NULL );
-	assert ( iscsi->command->data_in );
-	assert ( ( offset + len ) <= iscsi->command->data_in_len );
-	copy_to_user ( iscsi->command->data_in, offset, data, len );
+	assert ( task->command->data_in );
+	assert ( ( offset + len ) <= task->command->data_in_len );
+	copy_to_user ( task->command->data_in, offset, data, len );
 
 	/* Wait for whole SCSI response to arrive */
 	if ( remaining )
@@ -316,11 +617,11 @@ static int iscsi_rx_data_in ( struct iscsi_session *iscsi,
 
 	/* Mark as completed if status is present */
 	if ( data_in->flags & ISCSI_DATA_FLAG_STATUS ) {
-		assert ( ( offset + len ) == iscsi->command->data_in_len );
+		assert ( ( offset + len ) == task->command->data_in_len );
 		assert ( data_in->flags & ISCSI_FLAG_FINAL );
-		iscsi->command->status = data_in->status;
+		task->command->status = data_in->status;
 		/* iSCSI cannot return an error status via a data-in */
-		iscsi_scsi_done ( iscsi, 0 );
+		iscsi_rx_task_done ( iscsi, task, 0 );
 	}
 
 	return 0;
@@ -339,53 +640,60 @@ static int iscsi_rx_r2t ( struct iscsi_session *iscsi,
 			  const void *data __unused, size_t len __unused,
 			  size_t remaining __unused ) {
 	struct iscsi_bhs_r2t *r2t = &iscsi->rx_bhs.r2t;
+	struct iscsi_task *task;
 
-	/* Record transfer parameters and trigger first data-out */
-	iscsi->ttt = ntohl ( r2t->ttt );
-	iscsi->transfer_offset = ntohl ( r2t->offset );
-	iscsi->transfer_len = ntohl ( r2t->len );
-	iscsi_start_data_out ( iscsi, 0 );
+	/* Identify task */
+	task = iscsi_find_task ( iscsi, ntohl ( r2t->itt ) );
+	if ( ! task )
+		return -EPROTO_INVALID_ITT;
 
-	return 0;
+	/* Queue transfer.  The TX engine may currently be busy with
+	 * a PDU for this or a different task.
+	 */
+	return iscsi_queue_transfer ( iscsi, task, ntohl ( r2t->ttt ),
+				      ntohl ( r2t->offset ),
+				      ntohl ( r2t->len ) );
 }
 
 /**
  * Build iSCSI data-out BHS
  *
  * @v iscsi		iSCSI session
+ * @v task		iSCSI task
  * @v datasn		Data sequence number within the transfer
  *
  */
 static void iscsi_start_data_out ( struct iscsi_session *iscsi,
+				   struct iscsi_task *task,
 				   unsigned int datasn ) {
 	struct iscsi_bhs_data_out *data_out = &iscsi->tx_bhs.data_out;
+	struct iscsi_transfer *transfer = &iscsi->tx_transfer;
 	unsigned long offset;
 	unsigned long remaining;
 	unsigned long len;
 
-	/* We always send 512-byte Data-Out PDUs; this removes the
-	 * need to worry about the target's MaxRecvDataSegmentLength.
-	 */
-	offset = datasn * 512;
-	remaining = iscsi->transfer_len - offset;
+	/* Send the largest Data-Out PDUs that the target will accept */
+	offset = datasn * iscsi->max_send_len;
+	remaining = transfer->len - offset;
 	len = remaining;
-	if ( len > 512 )
-		len = 512;
+	if ( len > iscsi->max_send_len )
+		len = iscsi->max_send_len;
 
 	/* Construct BHS and initiate transmission */
 	iscsi_start_tx ( iscsi );
+	iscsi->tx_task = task;
 	data_out->opcode = ISCSI_OPCODE_DATA_OUT;
 	if ( len == remaining )
 		data_out->flags = ( ISCSI_FLAG_FINAL );
 	ISCSI_SET_LENGTHS ( data_out->lengths, 0, len );
 	data_out->lun = iscsi->lun;
-	data_out->itt = htonl ( iscsi->itt );
-	data_out->ttt = htonl ( iscsi->ttt );
+	data_out->itt = htonl ( task->itt );
+	data_out->ttt = htonl ( transfer->ttt );
 	data_out->expstatsn = htonl ( iscsi->statsn + 1 );
 	data_out->datasn = htonl ( datasn );
-	data_out->offset = htonl ( iscsi->transfer_offset + offset );
-	DBGC ( iscsi, "iSCSI %p start data out DataSN %#x len %#lx\n",
-	       iscsi, datasn, len );
+	data_out->offset = htonl ( transfer->offset + offset );
+	DBGC ( iscsi, "iSCSI %p ITT %#x start data out DataSN %#x len %#lx\n",
+	       iscsi, task->itt, datasn, len );
 }
 
 /**
@@ -396,12 +704,15 @@ static void iscsi_start_data_out ( struct iscsi_session *iscsi,
  */
 static void iscsi_data_out_done ( struct iscsi_session *iscsi ) {
 	struct iscsi_bhs_data_out *data_out = &iscsi->tx_bhs.data_out;
+	struct iscsi_task *task = iscsi->tx_task;
 
-	/* If we haven't reached the end of the sequence, start
-	 * sending the next data-out PDU.
+	/* If we haven't reached the end of the sequence (and the task
+	 * is still outstanding), start sending the next data-out PDU.
 	 */
-	if ( ! ( data_out->flags & ISCSI_FLAG_FINAL ) )
-		iscsi_start_data_out ( iscsi, ntohl ( data_out->datasn ) + 1 );
+	if ( task && ! ( data_out->flags & ISCSI_FLAG_FINAL ) ) {
+		iscsi_start_data_out ( iscsi, task,
+				       ( ntohl ( data_out->datasn ) + 1 ) );
+	}
 }
 
 /**
@@ -412,25 +723,9 @@ static void iscsi_data_out_done ( struct iscsi_session *iscsi ) {
  */
 static int iscsi_tx_data_out ( struct iscsi_session *iscsi ) {
 	struct iscsi_bhs_data_out *data_out = &iscsi->tx_bhs.data_out;
-	struct io_buffer *iobuf;
-	unsigned long offset;
-	size_t len;
-
-	offset = ntohl ( data_out->offset );
-	len = ISCSI_DATA_LEN ( data_out->lengths );
-
-	assert ( iscsi->command != NULL );
-	assert ( iscsi->command->data_out );
-	assert ( ( offset + len ) <= iscsi->command->data_out_len );
-
-	iobuf = xfer_alloc_iob ( &iscsi->socket, len );
-	if ( ! iobuf )
-		return -ENOMEM;
-	
-	copy_from_user ( iob_put ( iobuf, len ),
-			 iscsi->command->data_out, offset, len );
 
-	return xfer_deliver_iob ( &iscsi->socket, iobuf );
+	return iscsi_tx_data_out_buffer ( iscsi, ntohl ( data_out->offset ),
+					  ISCSI_DATA_LEN ( data_out->lengths ));
 }
 
 /****************************************************************************
@@ -447,24 +742,28 @@ static int iscsi_tx_data_out ( struct iscsi_session *iscsi ) {
  * These are the initial set of strings sent in the first login
  * request PDU.  We want the following settings:
  *
- *     HeaderDigest=None
- *     DataDigest=None
+ *     HeaderDigest=None,CRC32C [6]
+ *     DataDigest=None,CRC32C [6]
  *     MaxConnections is irrelevant; we make only one connection anyway [4]
- *     InitialR2T=Yes [1]
- *     ImmediateData is irrelevant; we never send immediate data [4]
- *     MaxRecvDataSegmentLength=8192 (default; we don't care) [3]
+ *     InitialR2T=No [1]
+ *     ImmediateData=Yes [1]
+ *     MaxRecvDataSegmentLength=262144 [5]
  *     MaxBurstLength=262144 (default; we don't care) [3]
- *     FirstBurstLength=262144 (default; we don't care)
+ *     FirstBurstLength=65536 (default) [1][3]
  *     DefaultTime2Wait=0 [2]
  *     DefaultTime2Retain=0 [2]
- *     MaxOutstandingR2T=1
+ *     MaxOutstandingR2T=4 [5]
  *     DataPDUInOrder=Yes
  *     DataSequenceInOrder=Yes
  *     ErrorRecoveryLevel=0
  *
- * [1] InitialR2T has an OR resolution function, so the target may
- * force us to use it.  We therefore simplify our logic by always
- * using it.
+ * [1] These allow us to send write data without waiting for an R2T
+ * round trip.  InitialR2T has an OR resolution function and
+ * ImmediateData an AND resolution function, so the target may force
+ * us to wait for R2Ts anyway.  Both may be disabled via the
+ * "iscsi-immediate-data" setting.  FirstBurstLength limits the amount
+ * of unsolicited data that we send for each command; it has a minimum
+ * resolution function, so the target may reduce it.
  *
  * [2] These ensure that we can safely start a new task once we have
  * reconnected after a failure, without having to manually tidy up
@@ -479,11 +778,19 @@ static int iscsi_tx_data_out ( struct iscsi_session *iscsi ) {
  * these parameters, but some targets (notably a QNAP TS-639Pro) fail
  * unless they are supplied, so we explicitly specify the default
  * values.
+ *
+ * [5] These may be overridden via the "iscsi-max-recv-len" and
+ * "iscsi-max-r2t" settings.
+ *
+ * [6] We prefer not to use digests, but will use them if the target
+ * requires them.  Digests can be made mandatory (i.e. CRC32C only)
+ * via the "iscsi-digests" setting.
  */
 static int iscsi_build_login_request_strings ( struct iscsi_session *iscsi,
 					       void *data, size_t len ) {
 	unsigned int used = 0;
 	const char *auth_method;
+	const char *digests;
 
 	if ( iscsi->status & ISCSI_STATUS_STRINGS_SECURITY ) {
 		/* Default to allowing no authentication */
@@ -529,21 +836,28 @@ static int iscsi_build_login_request_strings ( struct iscsi_session *iscsi,
 	}
 
 	if ( iscsi->status & ISCSI_STATUS_STRINGS_OPERATIONAL ) {
+		digests = ( iscsi_digests_required ? "CRC32C" : "None,CRC32C" );
 		used += ssnprintf ( data + used, len - used,
-				    "HeaderDigest=None%c"
-				    "DataDigest=None%c"
+				    "HeaderDigest=%s%c"
+				    "DataDigest=%s%c"
 				    "MaxConnections=1%c"
-				    "InitialR2T=Yes%c"
-				    "ImmediateData=No%c"
-				    "MaxRecvDataSegmentLength=8192%c"
-				    "MaxBurstLength=262144%c"
+				    "InitialR2T=%s%c"
+				    "ImmediateData=%s%c"
+				    "MaxRecvDataSegmentLength=%ld%c"
+				    "MaxBurstLength=%d%c"
+				    "FirstBurstLength=%d%c"
 				    "DefaultTime2Wait=0%c"
 				    "DefaultTime2Retain=0%c"
-				    "MaxOutstandingR2T=1%c"
+				    "MaxOutstandingR2T=%ld%c"
 				    "DataPDUInOrder=Yes%c"
 				    "DataSequenceInOrder=Yes%c"
 				    "ErrorRecoveryLevel=0%c",
-				    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 );
+				    digests, 0, digests, 0, 0,
+				    ( iscsi_immediate_data ? "No" : "Yes" ), 0,
+				    ( iscsi_immediate_data ? "Yes" : "No" ), 0,
+				    iscsi_max_recv_len, 0, ISCSI_MAX_BURST_LEN, 0,
+				    ISCSI_FIRST_BURST_LEN, 0, 0, 0,
+				    iscsi_max_r2t, 0, 0, 0, 0 );
 	}
 
 	return used;
@@ -890,6 +1204,158 @@ static int iscsi_handle_chap_r_value ( struct iscsi_session *iscsi,
 	return 0;
 }
 
+/**
+ * Parse iSCSI numerical text value
+ *
+ * @v iscsi		iSCSI session
+ * @v value		Text value
+ * @v min		Minimum permitted value
+ * @v max		Maximum permitted value
+ * @ret number		Numerical value, or negative error
+ */
+static long iscsi_parse_numerical_value ( struct iscsi_session *iscsi,
+					  const char *value,
+					  unsigned long min,
+					  unsigned long max ) {
+	unsigned long number;
+	char *endp;
+
+	number = strtoul ( value, &endp, 0 );
+	if ( ( *endp != '\0' ) || ( number < min ) || ( number > max ) ) {
+		DBGC ( iscsi, "iSCSI %p invalid numerical value \"%s\"\n",
+		       iscsi, value );
+		return -EPROTO_INVALID_KEY_VALUE;
+	}
+	return number;
+}
+
+/**
+ * Handle iSCSI HeaderDigest or DataDigest text value
+ *
+ * @v iscsi		iSCSI session
+ * @v value		Digest value
+ * @v digest		Digest (ISCSI_DIGEST_XXX)
+ * @ret rc		Return status code
+ */
+static int iscsi_handle_digest_value ( struct iscsi_session *iscsi,
+				       const char *value,
+				       unsigned int digest ) {
+
+	if ( strcmp ( value, "CRC32C" ) == 0 ) {
+		iscsi->digests |= digest;
+		return 0;
+	}
+	if ( ( strcmp ( value, "None" ) == 0 ) && ! iscsi_digests_required ) {
+		iscsi->digests &= ~digest;
+		return 0;
+	}
+	DBGC ( iscsi, "iSCSI %p unacceptable digest \"%s\"\n",
+	       iscsi, value );
+	return -EPROTO_INVALID_KEY_VALUE;
+}
+
+/**
+ * Handle iSCSI HeaderDigest text value
+ *
+ * @v iscsi		iSCSI session
+ * @v value		HeaderDigest value
+ * @ret rc		Return status code
+ */
+static int iscsi_handle_headerdigest_value ( struct iscsi_session *iscsi,
+					     const char *value ) {
+	return iscsi_handle_digest_value ( iscsi, value, ISCSI_DIGEST_HEADER );
+}
+
+/**
+ * Handle iSCSI DataDigest text value
+ *
+ * @v iscsi		iSCSI session
+ * @v value		DataDigest value
+ * @ret rc		Return status code
+ */
+static int iscsi_handle_datadigest_value ( struct iscsi_session *iscsi,
+					   const char *value ) {
+	return iscsi_handle_digest_value ( iscsi, value, ISCSI_DIGEST_DATA );
+}
+
+/**
+ * Handle iSCSI InitialR2T text value
+ *
+ * @v iscsi		iSCSI session
+ * @v value		InitialR2T value
+ * @ret rc		Return status code
+ */
+static int iscsi_handle_initialr2t_value ( struct iscsi_session *iscsi,
+					   const char *value ) {
+
+	/* InitialR2T has an OR resolution function */
+	iscsi->initial_r2t = ( ( ! iscsi_immediate_data ) ||
+			       ( strcmp ( value, "No" ) != 0 ) );
+	return 0;
+}
+
+/**
+ * Handle iSCSI ImmediateData text value
+ *
+ * @v iscsi		iSCSI session
+ * @v value		ImmediateData value
+ * @ret rc		Return status code
+ */
+static int iscsi_handle_immediatedata_value ( struct iscsi_session *iscsi,
+					      const char *value ) {
+
+	/* ImmediateData has an AND resolution function */
+	iscsi->immediate_data = ( iscsi_immediate_data &&
+				  ( strcmp ( value, "Yes" ) == 0 ) );
+	return 0;
+}
+
+/**
+ * Handle iSCSI MaxRecvDataSegmentLength text value
+ *
+ * @v iscsi		iSCSI session
+ * @v value		MaxRecvDataSegmentLength value
+ * @ret rc		Return status code
+ *
+ * This is a declarative value: it specifies the largest data segment
+ * that the target is prepared to receive from us.
+ */
+static int
+iscsi_handle_maxrecvdatasegmentlength_value ( struct iscsi_session *iscsi,
+					      const char *value ) {
+	long len;
+
+	len = iscsi_parse_numerical_value ( iscsi, value,
+					    ISCSI_MIN_DATA_SEGMENT_LEN,
+					    ISCSI_MAX_DATA_SEGMENT_LEN );
+	if ( len < 0 )
+		return len;
+	iscsi->max_send_len = len;
+	return 0;
+}
+
+/**
+ * Handle iSCSI FirstBurstLength text value
+ *
+ * @v iscsi		iSCSI session
+ * @v value		FirstBurstLength value
+ * @ret rc		Return status code
+ */
+static int iscsi_handle_firstburstlength_value ( struct iscsi_session *iscsi,
+						 const char *value ) {
+	long len;
+
+	/* FirstBurstLength has a minimum resolution function */
+	len = iscsi_parse_numerical_value ( iscsi, value,
+					    ISCSI_MIN_DATA_SEGMENT_LEN,
+					    ISCSI_MAX_DATA_SEGMENT_LEN );
+	if ( len < 0 )
+		return len;
+	if ( ( unsigned long ) len < iscsi->first_burst_len )
+		iscsi->first_burst_len = len;
+	return 0;
+}
+
 /** An iSCSI text string that we want to handle */
 struct iscsi_string_type {
 	/** String key
@@ -916,6 +1382,13 @@ static struct iscsi_string_type iscsi_string_types[] = {
 	{ "CHAP_C=", iscsi_handle_chap_c_value },
 	{ "CHAP_N=", iscsi_handle_chap_n_value },
 	{ "CHAP_R=", iscsi_handle_chap_r_value },
+	{ "HeaderDigest=", iscsi_handle_headerdigest_value },
+	{ "DataDigest=", iscsi_handle_datadigest_value },
+	{ "InitialR2T=", iscsi_handle_initialr2t_value },
+	{ "ImmediateData=", iscsi_handle_immediatedata_value },
+	{ "MaxRecvDataSegmentLength=",
+	  iscsi_handle_maxrecvdatasegmentlength_value },
+	{ "FirstBurstLength=", iscsi_handle_firstburstlength_value },
 	{ NULL, NULL }
 };
 
@@ -1131,9 +1604,20 @@ static int iscsi_rx_login_response ( struct iscsi_session *iscsi,
 
 	/* Record TSIH for future reference */
 	iscsi->tsih = ntohl ( response->tsih );
-	
-	/* Send the actual SCSI command */
-	iscsi_start_command ( iscsi );
+
+	/* Any queued SCSI commands will now be sent by the TX process */
+	DBGC ( iscsi, "iSCSI %p entered full feature phase with CmdSN %#x "
+	       "MaxCmdSN %#x\n", iscsi, iscsi->cmdsn, iscsi->max_cmdsn );
+	DBGC ( iscsi, "iSCSI %p using %s%sInitialR2T=%s ImmediateData=%s "
+	       "FirstBurstLength=%zd target MaxRecvDataSegmentLength=%zd\n",
+	       iscsi,
+	       ( ( iscsi->digests & ISCSI_DIGEST_HEADER ) ?
+		 "HeaderDigest=CRC32C " : "" ),
+	       ( ( iscsi->digests & ISCSI_DIGEST_DATA ) ?
+		 "DataDigest=CRC32C " : "" ),
+	       ( iscsi->initial_r2t ? "Yes" : "No" ),
+	       ( iscsi->immediate_data ? "Yes" : "No" ),
+	       iscsi->first_burst_len, iscsi->max_send_len );
 
 	return 0;
 }
@@ -1144,6 +1628,22 @@ static int iscsi_rx_login_response ( struct iscsi_session *iscsi,
  *
  */
 
+/**
+ * Get digests in use for a new PDU
+ *
+ * @v iscsi		iSCSI session
+ * @ret digests		Digests in use (ISCSI_DIGEST_XXX)
+ *
+ * Negotiated digests come into effect only after the login phase has
+ * completed.
+ */
+static unsigned int iscsi_active_digests ( struct iscsi_session *iscsi ) {
+	if ( ( iscsi->status & ISCSI_STATUS_PHASE_MASK ) !=
+	     ISCSI_STATUS_FULL_FEATURE_PHASE )
+		return 0;
+	return iscsi->digests;
+}
+
 /**
  * Start up a new TX PDU
  *
@@ -1157,6 +1657,10 @@ static void iscsi_start_tx ( struct iscsi_session *iscsi ) {
 	
 	/* Initialise TX BHS */
 	memset ( &iscsi->tx_bhs, 0, sizeof ( iscsi->tx_bhs ) );
+	iscsi->tx_task = NULL;
+	iscsi->tx_digests = iscsi_active_digests ( iscsi );
+	iscsi->tx_crc = 0xffffffffUL;
+	iscsi->tx_offset = 0;
 
 	/* Flag TX engine to start transmitting */
 	iscsi->tx_state = ISCSI_TX_BHS;
@@ -1183,6 +1687,57 @@ static int iscsi_tx_bhs ( struct iscsi_session *iscsi ) {
 				  sizeof ( iscsi->tx_bhs ) );
 }
 
+/**
+ * Transmit header digest of an iSCSI PDU
+ *
+ * @v iscsi		iSCSI session
+ * @ret rc		Return status code
+ */
+static int iscsi_tx_header_digest ( struct iscsi_session *iscsi ) {
+	uint32_t digest;
+
+	if ( ! ( iscsi->tx_digests & ISCSI_DIGEST_HEADER ) )
+		return 0;
+
+	digest = cpu_to_le32 ( ~crc32c_le ( 0xffffffffUL, &iscsi->tx_bhs,
+					    sizeof ( iscsi->tx_bhs ) ) );
+	return xfer_deliver_raw ( &iscsi->socket, &digest, sizeof ( digest ) );
+}
+
+/**
+ * Get length of data digest for current TX PDU
+ *
+ * @v iscsi		iSCSI session
+ * @ret len		Length of data digest
+ */
+static size_t iscsi_tx_data_digest_len ( struct iscsi_session *iscsi ) {
+	struct iscsi_bhs_common *common = &iscsi->tx_bhs.common;
+
+	if ( ( iscsi->tx_digests & ISCSI_DIGEST_DATA ) &&
+	     ISCSI_DATA_LEN ( common->lengths ) )
+		return sizeof ( uint32_t );
+	return 0;
+}
+
+/**
+ * Transmit data digest of an iSCSI PDU
+ *
+ * @v iscsi		iSCSI session
+ * @ret rc		Return status code
+ *
+ * The digest has been accumulated as the data segment and padding
+ * were transmitted.
+ */
+static int iscsi_tx_data_digest ( struct iscsi_session *iscsi ) {
+	uint32_t digest;
+
+	if ( ! iscsi_tx_data_digest_len ( iscsi ) )
+		return 0;
+
+	digest = cpu_to_le32 ( ~iscsi->tx_crc );
+	return xfer_deliver_raw ( &iscsi->socket, &digest, sizeof ( digest ) );
+}
+
 /**
  * Transmit data segment of an iSCSI PDU
  *
@@ -1196,6 +1751,8 @@ static int iscsi_tx_data ( struct iscsi_session *iscsi ) {
 	struct iscsi_bhs_common *common = &iscsi->tx_bhs.common;
 
 	switch ( common->opcode & ISCSI_OPCODE_MASK ) {
+	case ISCSI_OPCODE_SCSI_COMMAND:
+		return iscsi_tx_scsi_command ( iscsi );
 	case ISCSI_OPCODE_DATA_OUT:
 		return iscsi_tx_data_out ( iscsi );
 	case ISCSI_OPCODE_LOGIN_REQUEST:
@@ -1219,12 +1776,17 @@ static int iscsi_tx_data_padding ( struct iscsi_session *iscsi ) {
 	static const char pad[] = { '\0', '\0', '\0' };
 	struct iscsi_bhs_common *common = &iscsi->tx_bhs.common;
 	size_t pad_len;
+	int rc;
 	
 	pad_len = ISCSI_DATA_PAD_LEN ( common->lengths );
 	if ( ! pad_len )
 		return 0;
 
-	return xfer_deliver_raw ( &iscsi->socket, pad, pad_len );
+	if ( ( rc = xfer_deliver_raw ( &iscsi->socket, pad, pad_len ) ) != 0 )
+		return rc;
+	if ( iscsi->tx_digests & ISCSI_DIGEST_DATA )
+		iscsi->tx_crc = crc32c_le ( iscsi->tx_crc, pad, pad_len );
+	return 0;
 }
 
 /**
@@ -1242,8 +1804,10 @@ static void iscsi_tx_done ( struct iscsi_session *iscsi ) {
 	switch ( common->opcode & ISCSI_OPCODE_MASK ) {
 	case ISCSI_OPCODE_DATA_OUT:
 		iscsi_data_out_done ( iscsi );
+		break;
 	case ISCSI_OPCODE_LOGIN_REQUEST:
 		iscsi_login_request_done ( iscsi );
+		break;
 	default:
 		/* No action */
 		break;
@@ -1272,7 +1836,9 @@ static void iscsi_tx_step ( struct process *process ) {
 	while ( 1 ) {
 		switch ( iscsi->tx_state ) {
 		case ISCSI_TX_IDLE:
-			/* Stop processing */
+			/* Start next PDU, if any; otherwise stop processing */
+			if ( iscsi_start_next ( iscsi ) )
+				continue;
 			return;
 		case ISCSI_TX_BHS:
 			tx = iscsi_tx_bhs;
@@ -1282,6 +1848,12 @@ static void iscsi_tx_step ( struct process *process ) {
 		case ISCSI_TX_AHS:
 			tx = iscsi_tx_nothing;
 			tx_len = 0;
+			next_state = ISCSI_TX_HEADER_DIGEST;
+			break;
+		case ISCSI_TX_HEADER_DIGEST:
+			tx = iscsi_tx_header_digest;
+			tx_len = ( ( iscsi->tx_digests & ISCSI_DIGEST_HEADER ) ?
+				   sizeof ( uint32_t ) : 0 );
 			next_state = ISCSI_TX_DATA;
 			break;
 		case ISCSI_TX_DATA:
@@ -1292,6 +1864,11 @@ static void iscsi_tx_step ( struct process *process ) {
 		case ISCSI_TX_DATA_PADDING:
 			tx = iscsi_tx_data_padding;
 			tx_len = ISCSI_DATA_PAD_LEN ( common->lengths );
+			next_state = ISCSI_TX_DATA_DIGEST;
+			break;
+		case ISCSI_TX_DATA_DIGEST:
+			tx = iscsi_tx_data_digest;
+			tx_len = iscsi_tx_data_digest_len ( iscsi );
 			next_state = ISCSI_TX_IDLE;
 			break;
 		default:
@@ -1312,6 +1889,12 @@ static void iscsi_tx_step ( struct process *process ) {
 			return;
 		}
 
+		/* Remain in the same state until all fragments of the
+		 * data segment have been sent
+		 */
+		if ( iscsi->tx_offset )
+			continue;
+
 		/* Move to next state */
 		iscsi->tx_state = next_state;
 		if ( next_state == ISCSI_TX_IDLE )
@@ -1360,6 +1943,40 @@ static int iscsi_rx_discard ( struct iscsi_session *iscsi __unused,
 	return 0;
 }
 
+/**
+ * Receive header or data digest of an iSCSI PDU
+ *
+ * @v iscsi		iSCSI session
+ * @v data		Received data
+ * @v len		Length of received data
+ * @v remaining		Data remaining after this data
+ * @ret rc		Return status code
+ *
+ * The expected digest has been accumulated as the header or data
+ * segment was received.
+ */
+static int iscsi_rx_digest ( struct iscsi_session *iscsi, const void *data,
+			     size_t len, size_t remaining ) {
+	uint32_t expected;
+
+	memcpy ( ( ( ( void * ) &iscsi->rx_digest ) + iscsi->rx_offset ),
+		 data, len );
+	if ( remaining )
+		return 0;
+
+	expected = ~iscsi->rx_crc;
+	if ( le32_to_cpu ( iscsi->rx_digest ) != expected ) {
+		DBGC ( iscsi, "iSCSI %p %s digest mismatch (got %08x, "
+		       "expected %08x)\n", iscsi,
+		       ( ( iscsi->rx_state == ISCSI_RX_HEADER_DIGEST ) ?
+			 "header" : "data" ),
+		       le32_to_cpu ( iscsi->rx_digest ), expected );
+		return ( ( iscsi->rx_state == ISCSI_RX_HEADER_DIGEST ) ?
+			 -EIO_HEADER_DIGEST : -EIO_DATA_DIGEST );
+	}
+	return 0;
+}
+
 /**
  * Receive data segment of an iSCSI PDU
  *
@@ -1376,12 +1993,31 @@ static int iscsi_rx_data ( struct iscsi_session *iscsi, const void *data,
 			   size_t len, size_t remaining ) {
 	struct iscsi_bhs_common_response *response
 		= &iscsi->rx_bhs.common_response;
+	unsigned int opcode = ( response->opcode & ISCSI_OPCODE_MASK );
+	uint32_t expcmdsn = ntohl ( response->expcmdsn );
+	uint32_t maxcmdsn = ntohl ( response->maxcmdsn );
+
+	/* Update CmdSN window.  During login, the target dictates our
+	 * CmdSN; thereafter we ignore any MaxCmdSN that is out of
+	 * date or that would imply a negative window (RFC 3720
+	 * section 3.2.2.1).
+	 */
+	if ( opcode == ISCSI_OPCODE_LOGIN_RESPONSE ) {
+		iscsi->cmdsn = expcmdsn;
+		iscsi->max_cmdsn = maxcmdsn;
+	} else if ( ( ( int32_t ) ( maxcmdsn - expcmdsn ) >= -1 ) &&
+		    ( ( int32_t ) ( maxcmdsn - iscsi->max_cmdsn ) > 0 ) ) {
+		iscsi->max_cmdsn = maxcmdsn;
+	}
 
-	/* Update cmdsn and statsn */
-	iscsi->cmdsn = ntohl ( response->expcmdsn );
-	iscsi->statsn = ntohl ( response->statsn );
+	/* Update StatSN, if this PDU carries status */
+	if ( ( opcode != ISCSI_OPCODE_R2T ) &&
+	     ( ( opcode != ISCSI_OPCODE_DATA_IN ) ||
+	       ( response->flags & ISCSI_DATA_FLAG_STATUS ) ) ) {
+		iscsi->statsn = ntohl ( response->statsn );
+	}
 
-	switch ( response->opcode & ISCSI_OPCODE_MASK ) {
+	switch ( opcode ) {
 	case ISCSI_OPCODE_LOGIN_RESPONSE:
 		return iscsi_rx_login_response ( iscsi, data, len, remaining );
 	case ISCSI_OPCODE_SCSI_RESPONSE:
@@ -1413,6 +2049,10 @@ static int iscsi_rx_data ( struct iscsi_session *iscsi, const void *data,
  * portion as it arrives.  The data processing routine therefore
  * always has a full copy of the BHS available, even for portions of
  * the data in different packets to the BHS.
+ *
+ * If digests are in use, the CRC32C for the header and data segments
+ * is accumulated as each fragment arrives, so that no extra pass
+ * over the data is required.
  */
 static int iscsi_socket_deliver_raw ( struct xfer_interface *socket,
 				      const void *data, size_t len ) {
@@ -1422,6 +2062,7 @@ static int iscsi_socket_deliver_raw ( struct xfer_interface *socket,
 	int ( * rx ) ( struct iscsi_session *iscsi, const void *data,
 		       size_t len, size_t remaining );
 	enum iscsi_rx_state next_state;
+	unsigned int digest;
 	size_t frag_len;
 	size_t remaining;
 	int rc;
@@ -1431,21 +2072,50 @@ static int iscsi_socket_deliver_raw ( struct xfer_interface *socket,
 		case ISCSI_RX_BHS:
 			rx = iscsi_rx_bhs;
 			iscsi->rx_len = sizeof ( iscsi->rx_bhs );
+			digest = ISCSI_DIGEST_HEADER;
 			next_state = ISCSI_RX_AHS;			
+			if ( iscsi->rx_offset == 0 ) {
+				iscsi->rx_digests =
+					iscsi_active_digests ( iscsi );
+				iscsi->rx_crc = 0xffffffffUL;
+				iscsi->rx_task = NULL;
+			}
 			break;
 		case ISCSI_RX_AHS:
 			rx = iscsi_rx_discard;
 			iscsi->rx_len = 4 * ISCSI_AHS_LEN ( common->lengths );
+			digest = ISCSI_DIGEST_HEADER;
+			next_state = ISCSI_RX_HEADER_DIGEST;
+			break;
+		case ISCSI_RX_HEADER_DIGEST:
+			rx = iscsi_rx_digest;
+			iscsi->rx_len = ( ( iscsi->rx_digests &
+					    ISCSI_DIGEST_HEADER ) ?
+					  sizeof ( iscsi->rx_digest ) : 0 );
+			digest = 0;
 			next_state = ISCSI_RX_DATA;
 			break;
 		case ISCSI_RX_DATA:
 			rx = iscsi_rx_data;
 			iscsi->rx_len = ISCSI_DATA_LEN ( common->lengths );
+			digest = ISCSI_DIGEST_DATA;
 			next_state = ISCSI_RX_DATA_PADDING;
+			if ( iscsi->rx_offset == 0 )
+				iscsi->rx_crc = 0xffffffffUL;
 			break;
 		case ISCSI_RX_DATA_PADDING:
 			rx = iscsi_rx_discard;
 			iscsi->rx_len = ISCSI_DATA_PAD_LEN ( common->lengths );
+			digest = ISCSI_DIGEST_DATA;
+			next_state = ISCSI_RX_DATA_DIGEST;
+			break;
+		case ISCSI_RX_DATA_DIGEST:
+			rx = iscsi_rx_digest;
+			iscsi->rx_len = ( ( ( iscsi->rx_digests &
+					      ISCSI_DIGEST_DATA ) &&
+					    ISCSI_DATA_LEN ( common->lengths ) ) ?
+					  sizeof ( iscsi->rx_digest ) : 0 );
+			digest = 0;
 			next_state = ISCSI_RX_BHS;
 			break;
 		default:
@@ -1457,11 +2127,15 @@ static int iscsi_socket_deliver_raw ( struct xfer_interface *socket,
 		if ( frag_len > len )
 			frag_len = len;
 		remaining = iscsi->rx_len - iscsi->rx_offset - frag_len;
+		if ( iscsi->rx_digests & digest ) {
+			iscsi->rx_crc = crc32c_le ( iscsi->rx_crc, data,
+						    frag_len );
+		}
 		if ( ( rc = rx ( iscsi, data, frag_len, remaining ) ) != 0 ) {
 			DBGC ( iscsi, "iSCSI %p could not process received "
 			       "data: %s\n", iscsi, strerror ( rc ) );
 			iscsi_close_connection ( iscsi, rc );
-			iscsi_scsi_done ( iscsi, rc );
+			iscsi_fail_tasks ( iscsi, rc );
 			return rc;
 		}
 
@@ -1475,6 +2149,13 @@ static int iscsi_socket_deliver_raw ( struct xfer_interface *socket,
 		if ( iscsi->rx_offset != iscsi->rx_len )
 			return 0;
 
+		/* Complete any task finished by a now-verified PDU */
+		if ( ( next_state == ISCSI_RX_BHS ) && iscsi->rx_task ) {
+			iscsi_task_done ( iscsi, iscsi->rx_task,
+					  iscsi->rx_task_rc );
+			iscsi->rx_task = NULL;
+		}
+
 		iscsi->rx_state = next_state;
 		iscsi->rx_offset = 0;
 	}
@@ -1507,12 +2188,12 @@ static void iscsi_socket_close ( struct xfer_interface *socket, int rc ) {
 		if ( ( rc = iscsi_open_connection ( iscsi ) ) != 0 ) {
 			DBGC ( iscsi, "iSCSI %p could not reconnect: %s\n",
 			       iscsi, strerror ( rc ) );
-			iscsi_scsi_done ( iscsi, rc );
+			iscsi_fail_tasks ( iscsi, rc );
 		}
 	} else {
 		DBGC ( iscsi, "iSCSI %p retry count exceeded\n", iscsi );
 		iscsi->instant_rc = rc;
-		iscsi_scsi_done ( iscsi, rc );
+		iscsi_fail_tasks ( iscsi, rc );
 	}
 }
 
@@ -1572,26 +2253,45 @@ static struct xfer_interface_operations iscsi_socket_operations = {
  * @v scsi		SCSI device
  * @v command		SCSI command
  * @ret rc		Return status code
+ *
+ * The command is placed in the task table and will be transmitted by
+ * the TX process once the session has reached the full feature phase
+ * and the target's CmdSN window permits.  Up to ISCSI_MAX_TASKS
+ * commands may be outstanding at any one time.
  */
 static int iscsi_command ( struct scsi_device *scsi,
 			   struct scsi_command *command ) {
 	struct iscsi_session *iscsi =
 		container_of ( scsi->backend, struct iscsi_session, refcnt );
+	struct iscsi_task *task;
+	unsigned int i;
 	int rc;
 
 	/* Abort immediately if we have a recorded permanent failure */
 	if ( iscsi->instant_rc )
 		return iscsi->instant_rc;
 
-	/* Record SCSI command */
-	iscsi->command = command;
+	/* Find a free task table entry */
+	for ( i = 0 ; i < ISCSI_MAX_TASKS ; i++ ) {
+		task = &iscsi->tasks[i];
+		if ( ! task->command )
+			break;
+	}
+	if ( i == ISCSI_MAX_TASKS ) {
+		DBGC2 ( iscsi, "iSCSI %p task table full\n", iscsi );
+		return BLOCKDEV_FULL;
+	}
 
-	/* Issue command or open connection as appropriate */
-	if ( iscsi->status ) {
-		iscsi_start_command ( iscsi );
-	} else {
+	/* Record SCSI command and assign fresh initiator task tag */
+	task->command = command;
+	task->itt = ISCSI_TAG ( ++iscsi->itt, i );
+	task->flags = ISCSI_TASK_SEND_COMMAND;
+
+	/* Open connection if necessary */
+	if ( ! iscsi->status ) {
 		if ( ( rc = iscsi_open_connection ( iscsi ) ) != 0 ) {
-			iscsi->command = NULL;
+			task->command = NULL;
+			task->flags = 0;
 			return rc;
 		}
 	}
@@ -1608,10 +2308,11 @@ void iscsi_detach ( struct scsi_device *scsi ) {
 	struct iscsi_session *iscsi =
 		container_of ( scsi->backend, struct iscsi_session, refcnt );
 
+	scsi->command = scsi_detached_command;
 	xfer_nullify ( &iscsi->socket );
 	iscsi_close_connection ( iscsi, 0 );
+	iscsi_fail_tasks ( iscsi, -ENODEV );
 	process_del ( &iscsi->process );
-	scsi->command = scsi_detached_command;
 	ref_put ( scsi->backend );
 	scsi->backend = NULL;
 }
@@ -1829,6 +2530,38 @@ struct setting reverse_password_setting __setting = {
 	.type = &setting_type_string,
 };
 
+/** iSCSI immediate data setting */
+struct setting iscsi_immediate_data_setting __setting = {
+	.name = "iscsi-immediate-data",
+	.description = "Send iSCSI unsolicited data",
+	.tag = DHCP_EB_ISCSI_IMMEDIATE_DATA,
+	.type = &setting_type_int8,
+};
+
+/** iSCSI maximum receive data segment length setting */
+struct setting iscsi_max_recv_len_setting __setting = {
+	.name = "iscsi-max-recv-len",
+	.description = "iSCSI maximum receive data segment length",
+	.tag = DHCP_EB_ISCSI_MAX_RECV_LEN,
+	.type = &setting_type_uint32,
+};
+
+/** iSCSI maximum outstanding R2Ts setting */
+struct setting iscsi_max_r2t_setting __setting = {
+	.name = "iscsi-max-r2t",
+	.description = "iSCSI maximum outstanding R2Ts",
+	.tag = DHCP_EB_ISCSI_MAX_R2T,
+	.type = &setting_type_uint8,
+};
+
+/** iSCSI digests setting */
+struct setting iscsi_digests_setting __setting = {
+	.name = "iscsi-digests",
+	.description = "Require iSCSI CRC32C digests",
+	.tag = DHCP_EB_ISCSI_DIGESTS,
+	.type = &setting_type_int8,
+};
+
 /** An iSCSI string setting */
 struct iscsi_string_setting {
 	/** Setting */
@@ -1912,6 +2645,44 @@ static int apply_iscsi_string_setting ( struct iscsi_string_setting *setting ){
 	return 0;
 }
 
+/**
+ * Apply iSCSI operational parameter settings
+ *
+ * Missing settings are not errors; they leave the defaults in
+ * place.  Out-of-range values are clamped to what we support.
+ */
+static void apply_iscsi_operational_settings ( void ) {
+	long immediate_data;
+	unsigned long max_recv_len;
+	unsigned long max_r2t;
+
+	if ( fetch_int_setting ( NULL, &iscsi_immediate_data_setting,
+				 &immediate_data ) < 0 )
+		immediate_data = 1;
+	iscsi_immediate_data = ( immediate_data != 0 );
+
+	if ( fetch_uint_setting ( NULL, &iscsi_max_recv_len_setting,
+				  &max_recv_len ) < 0 )
+		max_recv_len = ISCSI_DEFAULT_MAX_RECV_LEN;
+	if ( max_recv_len < ISCSI_MIN_DATA_SEGMENT_LEN )
+		max_recv_len = ISCSI_MIN_DATA_SEGMENT_LEN;
+	if ( max_recv_len > ISCSI_MAX_DATA_SEGMENT_LEN )
+		max_recv_len = ISCSI_MAX_DATA_SEGMENT_LEN;
+	iscsi_max_recv_len = max_recv_len;
+
+	if ( fetch_uint_setting ( NULL, &iscsi_max_r2t_setting,
+				  &max_r2t ) < 0 )
+		max_r2t = ISCSI_DEFAULT_MAX_OUTSTANDING_R2T;
+	if ( max_r2t < 1 )
+		max_r2t = 1;
+	if ( max_r2t > ISCSI_MAX_OUTSTANDING_R2T )
+		max_r2t = ISCSI_MAX_OUTSTANDING_R2T;
+	iscsi_max_r2t = max_r2t;
+
+	iscsi_digests_required =
+		( fetch_intz_setting ( NULL, &iscsi_digests_setting ) != 0 );
+}
+
 /**
  * Apply iSCSI settings
  *
@@ -1922,6 +2693,8 @@ static int apply_iscsi_settings ( void ) {
 	unsigned int i;
 	int rc;
 
+	apply_iscsi_operational_settings();
+
 	for ( i = 0 ; i < ( sizeof ( iscsi_string_settings ) /
 			    sizeof ( iscsi_string_settings[0] ) ) ; i++ ) {
 		setting = &iscsi_string_settings[i];
@@ -79,6 +79,23 @@ int tcpip_tx ( struct io_buffer *iobuf, struct tcpip_protocol *tcpip_protocol,
 	return -EAFNOSUPPORT;
 }
 
+/**
+ * Determine maximum transmission unit
+ *
+ * @v st_dest		Destination address
+ * @ret mtu		Maximum transport-layer packet length, or 0 if unknown
+ */
+size_t tcpip_mtu ( struct sockaddr_tcpip *st_dest ) {
+	struct tcpip_net_protocol *tcpip_net;
+
+	for_each_table_entry ( tcpip_net, TCPIP_NET_PROTOCOLS ) {
+		if ( ( tcpip_net->sa_family == st_dest->st_family ) &&
+		     tcpip_net->mtu )
+			return tcpip_net->mtu ( st_dest );
+	}
+	return 0;
+}
+
 /**
  * Calculate continued TCP/IP checkum
  *
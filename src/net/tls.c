@@ -30,10 +30,13 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <string.h>
 #include <errno.h>
 #include <byteswap.h>
+#include <gpxe/iobuf.h>
 #include <gpxe/hmac.h>
 #include <gpxe/md5.h>
 #include <gpxe/sha1.h>
+#include <gpxe/sha256.h>
 #include <gpxe/aes.h>
+#include <gpxe/gcm.h>
 #include <gpxe/rsa.h>
 #include <gpxe/xfer.h>
 #include <gpxe/open.h>
@@ -46,6 +49,7 @@ static int tls_send_plaintext ( struct tls_session *tls, unsigned int type,
 				const void *data, size_t len );
 static void tls_clear_cipher ( struct tls_session *tls,
 			       struct tls_cipherspec *cipherspec );
+static void tls_uncache_session ( struct tls_session *tls );
 
 /******************************************************************************
  *
@@ -89,7 +93,8 @@ static void free_tls ( struct refcnt *refcnt ) {
 	tls_clear_cipher ( tls, &tls->rx_cipherspec );
 	tls_clear_cipher ( tls, &tls->rx_cipherspec_pending );
 	x509_free_rsa_public_key ( &tls->rsa );
-	free ( tls->rx_data );
+	free_iob ( tls->rx_data );
+	free ( tls->name );
 
 	/* Free TLS structure itself */
 	free ( tls );	
@@ -103,6 +108,10 @@ static void free_tls ( struct refcnt *refcnt ) {
  */
 static void tls_close ( struct tls_session *tls, int rc ) {
 
+	/* Do not attempt to resume a session that ended in failure */
+	if ( rc != 0 )
+		tls_uncache_session ( tls );
+
 	/* Remove process */
 	process_del ( &tls->process );
 	
@@ -241,6 +250,14 @@ static void tls_prf ( struct tls_session *tls, void *secret, size_t secret_len,
 
 	va_start ( seeds, out_len );
 
+	/* TLSv1.2 uses a single SHA256 hash over the whole secret */
+	if ( tls->version >= TLS_VERSION_TLS_1_2 ) {
+		tls_p_hash_va ( tls, &sha256_algorithm, secret, secret_len,
+				out, out_len, seeds );
+		va_end ( seeds );
+		return;
+	}
+
 	/* Split secret into two, with an overlap of up to one byte */
 	subsecret_len = ( ( secret_len + 1 ) / 2 );
 	md5_secret = secret;
@@ -325,9 +342,11 @@ static void tls_generate_master_secret ( struct tls_session *tls ) {
 static int tls_generate_keys ( struct tls_session *tls ) {
 	struct tls_cipherspec *tx_cipherspec = &tls->tx_cipherspec_pending;
 	struct tls_cipherspec *rx_cipherspec = &tls->rx_cipherspec_pending;
+	struct cipher_algorithm *cipher = tx_cipherspec->cipher;
 	size_t hash_size = tx_cipherspec->digest->digestsize;
 	size_t key_size = tx_cipherspec->key_len;
-	size_t iv_size = tx_cipherspec->cipher->blocksize;
+	size_t iv_size = ( is_auth_cipher ( cipher ) ?
+			   TLS_FIXED_IV_LEN : cipher->blocksize );
 	size_t total = ( 2 * ( hash_size + key_size + iv_size ) );
 	uint8_t key_block[total];
 	uint8_t *key;
@@ -378,14 +397,24 @@ static int tls_generate_keys ( struct tls_session *tls ) {
 	DBGC_HD ( tls, key, key_size );
 	key += key_size;
 
-	/* TX initialisation vector */
-	cipher_setiv ( tx_cipherspec->cipher, tx_cipherspec->cipher_ctx, key );
+	/* TX initialisation vector.  For an authenticated encryption
+	 * cipher, this is the implicit part of each record's nonce.
+	 */
+	if ( is_auth_cipher ( cipher ) ) {
+		memcpy ( tx_cipherspec->fixed_iv, key, iv_size );
+	} else {
+		cipher_setiv ( cipher, tx_cipherspec->cipher_ctx, key );
+	}
 	DBGC ( tls, "TLS %p TX IV:\n", tls );
 	DBGC_HD ( tls, key, iv_size );
 	key += iv_size;
 
 	/* RX initialisation vector */
-	cipher_setiv ( rx_cipherspec->cipher, rx_cipherspec->cipher_ctx, key );
+	if ( is_auth_cipher ( cipher ) ) {
+		memcpy ( rx_cipherspec->fixed_iv, key, iv_size );
+	} else {
+		cipher_setiv ( cipher, rx_cipherspec->cipher_ctx, key );
+	}
 	DBGC ( tls, "TLS %p RX IV:\n", tls );
 	DBGC_HD ( tls, key, iv_size );
 	key += iv_size;
@@ -395,6 +424,133 @@ static int tls_generate_keys ( struct tls_session *tls ) {
 	return 0;
 }
 
+/******************************************************************************
+ *
+ * Session cache
+ *
+ ******************************************************************************
+ */
+
+/** TLS session cache */
+static struct tls_cached_session tls_session_cache[TLS_SESSION_CACHE_SIZE];
+
+/** Next TLS session cache entry to be replaced */
+static unsigned int tls_session_cache_next;
+
+/**
+ * Find cached session for server
+ *
+ * @v name		Server name
+ * @ret cached		Cached session, or NULL
+ */
+static struct tls_cached_session * tls_find_cached_session ( const char *name ) {
+	struct tls_cached_session *cached;
+	unsigned int i;
+
+	for ( i = 0 ; i < TLS_SESSION_CACHE_SIZE ; i++ ) {
+		cached = &tls_session_cache[i];
+		if ( cached->name && ( strcmp ( cached->name, name ) == 0 ) )
+			return cached;
+	}
+	return NULL;
+}
+
+/**
+ * Discard cached session
+ *
+ * @v cached		Cached session
+ */
+static void tls_discard_cached_session ( struct tls_cached_session *cached ) {
+
+	free ( cached->name );
+	memset ( cached, 0, sizeof ( *cached ) );
+}
+
+/**
+ * Prepare to resume cached session
+ *
+ * @v tls		TLS session
+ *
+ * If a session with this server is present in the session cache, its
+ * session ID will be offered in the Client Hello.  The server may
+ * still choose to perform a full handshake.
+ */
+static void tls_resume_session ( struct tls_session *tls ) {
+	struct tls_cached_session *cached;
+
+	if ( ! tls->name )
+		return;
+	cached = tls_find_cached_session ( tls->name );
+	if ( ! cached )
+		return;
+
+	DBGC ( tls, "TLS %p attempting to resume session with %s\n",
+	       tls, tls->name );
+	memcpy ( tls->session_id, cached->id, cached->id_len );
+	tls->session_id_len = cached->id_len;
+	memcpy ( tls->master_secret, cached->master_secret,
+		 sizeof ( tls->master_secret ) );
+}
+
+/**
+ * Add session to session cache
+ *
+ * @v tls		TLS session
+ *
+ * The session must have completed a full handshake.  Any existing
+ * entry for this server is replaced; otherwise the oldest entry is
+ * evicted.
+ */
+static void tls_cache_session ( struct tls_session *tls ) {
+	struct tls_cached_session *cached;
+	char *name;
+
+	/* Do nothing unless the server allows the session to be resumed */
+	if ( ! ( tls->name && tls->session_id_len ) )
+		return;
+
+	name = strdup ( tls->name );
+	if ( ! name )
+		return;
+
+	cached = tls_find_cached_session ( tls->name );
+	if ( ! cached ) {
+		cached = &tls_session_cache[tls_session_cache_next];
+		tls_session_cache_next = ( ( tls_session_cache_next + 1 ) %
+					   TLS_SESSION_CACHE_SIZE );
+	}
+	tls_discard_cached_session ( cached );
+	cached->name = name;
+	memcpy ( cached->id, tls->session_id, tls->session_id_len );
+	cached->id_len = tls->session_id_len;
+	memcpy ( cached->master_secret, tls->master_secret,
+		 sizeof ( cached->master_secret ) );
+	DBGC ( tls, "TLS %p cached session with %s\n", tls, tls->name );
+}
+
+/**
+ * Remove session from session cache
+ *
+ * @v tls		TLS session
+ */
+static void tls_uncache_session ( struct tls_session *tls ) {
+	struct tls_cached_session *cached;
+
+	if ( ! tls->name )
+		return;
+	cached = tls_find_cached_session ( tls->name );
+	if ( ! cached )
+		return;
+	if ( ( cached->id_len != tls->session_id_len ) ||
+	     ( memcmp ( cached->id, tls->session_id,
+			tls->session_id_len ) != 0 ) )
+		return;
+
+	DBGC ( tls, "TLS %p discarding cached session with %s\n",
+	       tls, tls->name );
+	tls_discard_cached_session ( cached );
+}
+
 /******************************************************************************
  *
  * Cipher suite management
@@ -492,12 +648,24 @@ static int tls_select_cipher ( struct tls_session *tls,
 		cipher = &aes_cbc_algorithm;
 		digest = &sha1_algorithm;
 		break;
+	case htons ( TLS_RSA_WITH_AES_128_GCM_SHA256 ):
+		key_len = ( 128 / 8 );
+		cipher = &aes_gcm_algorithm;
+		break;
 	default:
 		DBGC ( tls, "TLS %p does not support cipher %04x\n",
 		       tls, ntohs ( cipher_suite ) );
 		return -ENOTSUP;
 	}
 
+	/* Authenticated encryption suites exist only in TLSv1.2 */
+	if ( is_auth_cipher ( cipher ) &&
+	     ( tls->version < TLS_VERSION_TLS_1_2 ) ) {
+		DBGC ( tls, "TLS %p cannot use cipher %04x with version "
+		       "%04x\n", tls, ntohs ( cipher_suite ), tls->version );
+		return -ENOTSUP;
+	}
+
 	/* Set ciphers */
 	if ( ( rc = tls_set_cipher ( tls, &tls->tx_cipherspec_pending, pubkey,
 				     cipher, digest, key_len ) ) != 0 )
@@ -524,11 +692,14 @@ static int tls_change_cipher ( struct tls_session *tls,
 			       struct tls_cipherspec *pending,
 			       struct tls_cipherspec *active ) {
 
-	/* Sanity check */
+	/* Sanity check.  Authenticated encryption ciphers need no
+	 * separate MAC digest.
+	 */
 	if ( /* FIXME (when pubkey is not hard-coded to RSA):
 	      * ( pending->pubkey == &pubkey_null ) || */
 	     ( pending->cipher == &cipher_null ) ||
-	     ( pending->digest == &digest_null ) ) {
+	     ( ( pending->digest == &digest_null ) &&
+	       ! is_auth_cipher ( pending->cipher ) ) ) {
 		DBGC ( tls, "TLS %p refusing to use null cipher\n", tls );
 		return -ENOTSUP;
 	}
@@ -557,6 +728,8 @@ static void tls_add_handshake ( struct tls_session *tls,
 
 	digest_update ( &md5_algorithm, tls->handshake_md5_ctx, data, len );
 	digest_update ( &sha1_algorithm, tls->handshake_sha1_ctx, data, len );
+	digest_update ( &sha256_algorithm, tls->handshake_sha256_ctx,
+			data, len );
 }
 
 /**
@@ -564,22 +737,34 @@ static void tls_add_handshake ( struct tls_session *tls,
  *
  * @v tls		TLS session
  * @v out		Output buffer
+ * @ret len		Length of hash
  *
- * Calculates the MD5+SHA1 digest over all handshake messages seen so
- * far.
+ * Calculates the MD5+SHA1 digest (or, for TLSv1.2, the SHA256
+ * digest) over all handshake messages seen so far.  The output
+ * buffer must have space for an MD5+SHA1 digest.
  */
-static void tls_verify_handshake ( struct tls_session *tls, void *out ) {
+static size_t tls_verify_handshake ( struct tls_session *tls, void *out ) {
 	struct digest_algorithm *md5 = &md5_algorithm;
 	struct digest_algorithm *sha1 = &sha1_algorithm;
+	struct digest_algorithm *sha256 = &sha256_algorithm;
 	uint8_t md5_ctx[md5->ctxsize];
 	uint8_t sha1_ctx[sha1->ctxsize];
+	uint8_t sha256_ctx[sha256->ctxsize];
 	void *md5_digest = out;
 	void *sha1_digest = ( out + md5->digestsize );
 
+	if ( tls->version >= TLS_VERSION_TLS_1_2 ) {
+		memcpy ( sha256_ctx, tls->handshake_sha256_ctx,
+			 sizeof ( sha256_ctx ) );
+		digest_final ( sha256, sha256_ctx, out );
+		return sha256->digestsize;
+	}
+
 	memcpy ( md5_ctx, tls->handshake_md5_ctx, sizeof ( md5_ctx ) );
 	memcpy ( sha1_ctx, tls->handshake_sha1_ctx, sizeof ( sha1_ctx ) );
 	digest_final ( md5, md5_ctx, md5_digest );
 	digest_final ( sha1, sha1_ctx, sha1_digest );
+	return ( md5->digestsize + sha1->digestsize );
 }
 
 /******************************************************************************
@@ -619,8 +804,9 @@ static int tls_send_client_hello ( struct tls_session *tls ) {
 		uint16_t version;
 		uint8_t random[32];
 		uint8_t session_id_len;
+		uint8_t session_id[tls->session_id_len];
 		uint16_t cipher_suite_len;
-		uint16_t cipher_suites[2];
+		uint16_t cipher_suites[3];
 		uint8_t compression_methods_len;
 		uint8_t compression_methods[1];
 	} __attribute__ (( packed )) hello;
@@ -629,11 +815,14 @@ static int tls_send_client_hello ( struct tls_session *tls ) {
 	hello.type_length = ( cpu_to_le32 ( TLS_CLIENT_HELLO ) |
 			      htonl ( sizeof ( hello ) -
 				      sizeof ( hello.type_length ) ) );
-	hello.version = htons ( TLS_VERSION_TLS_1_0 );
+	hello.version = htons ( TLS_VERSION_TLS_1_2 );
 	memcpy ( &hello.random, &tls->client_random, sizeof ( hello.random ) );
+	hello.session_id_len = sizeof ( hello.session_id );
+	memcpy ( hello.session_id, tls->session_id, sizeof ( hello.session_id ) );
 	hello.cipher_suite_len = htons ( sizeof ( hello.cipher_suites ) );
-	hello.cipher_suites[0] = htons ( TLS_RSA_WITH_AES_128_CBC_SHA );
-	hello.cipher_suites[1] = htons ( TLS_RSA_WITH_AES_256_CBC_SHA );
+	hello.cipher_suites[0] = htons ( TLS_RSA_WITH_AES_128_GCM_SHA256 );
+	hello.cipher_suites[1] = htons ( TLS_RSA_WITH_AES_128_CBC_SHA );
+	hello.cipher_suites[2] = htons ( TLS_RSA_WITH_AES_256_CBC_SHA );
 	hello.compression_methods_len = sizeof ( hello.compression_methods );
 
 	return tls_send_handshake ( tls, &hello, sizeof ( hello ) );
@@ -647,6 +836,7 @@ static int tls_send_client_hello ( struct tls_session *tls ) {
  */
 static int tls_send_client_key_exchange ( struct tls_session *tls ) {
 	/* FIXME: Hack alert */
+	union profiler profiler;
 	RSA_CTX *rsa_ctx;
 	RSA_pub_key_new ( &rsa_ctx, tls->rsa.modulus, tls->rsa.modulus_len,
 			  tls->rsa.exponent, tls->rsa.exponent_len );
@@ -664,15 +854,22 @@ static int tls_send_client_key_exchange ( struct tls_session *tls ) {
 		= htons ( sizeof ( key_xchg.encrypted_pre_master_secret ) );
 
 	/* FIXME: Hack alert */
+	profile ( &profiler );
 	DBGC ( tls, "RSA encrypting plaintext, modulus, exponent:\n" );
 	DBGC_HD ( tls, &tls->pre_master_secret,
 		  sizeof ( tls->pre_master_secret ) );
 	DBGC_HD ( tls, tls->rsa.modulus, tls->rsa.modulus_len );
 	DBGC_HD ( tls, tls->rsa.exponent, tls->rsa.exponent_len );
-	RSA_encrypt ( rsa_ctx, ( const uint8_t * ) &tls->pre_master_secret,
-		      sizeof ( tls->pre_master_secret ),
-		      key_xchg.encrypted_pre_master_secret, 0 );
-	DBGC ( tls, "RSA encrypt done.  Ciphertext:\n" );
+	if ( RSA_encrypt ( rsa_ctx,
+			   ( const uint8_t * ) &tls->pre_master_secret,
+			   sizeof ( tls->pre_master_secret ),
+			   key_xchg.encrypted_pre_master_secret, 0 ) < 0 ) {
+		DBGC ( tls, "TLS %p could not RSA encrypt\n", tls );
+		RSA_free ( rsa_ctx );
+		return -ENOMEM;
+	}
+	DBGC ( tls, "RSA encrypt done in %ld ticks.  Ciphertext:\n",
+	       profile ( &profiler ) );
 	DBGC_HD ( tls, &key_xchg.encrypted_pre_master_secret,
 		  sizeof ( key_xchg.encrypted_pre_master_secret ) );
 	RSA_free ( rsa_ctx );
@@ -705,15 +902,16 @@ static int tls_send_finished ( struct tls_session *tls ) {
 		uint8_t verify_data[12];
 	} __attribute__ (( packed )) finished;
 	uint8_t digest[MD5_DIGEST_SIZE + SHA1_DIGEST_SIZE];
+	size_t digest_len;
 
 	memset ( &finished, 0, sizeof ( finished ) );
 	finished.type_length = ( cpu_to_le32 ( TLS_FINISHED ) |
 				 htonl ( sizeof ( finished ) -
 					 sizeof ( finished.type_length ) ) );
-	tls_verify_handshake ( tls, digest );
+	digest_len = tls_verify_handshake ( tls, digest );
 	tls_prf_label ( tls, &tls->master_secret, sizeof ( tls->master_secret ),
 			finished.verify_data, sizeof ( finished.verify_data ),
-			"client finished", digest, sizeof ( digest ) );
+			"client finished", digest, digest_len );
 
 	return tls_send_handshake ( tls, &finished, sizeof ( finished ) );
 }
@@ -809,22 +1007,28 @@ static int tls_new_server_hello ( struct tls_session *tls,
 		char next[0];
 	} __attribute__ (( packed )) *hello_b = ( void * ) &hello_a->next;
 	void *end = hello_b->next;
+	uint16_t version;
 	int rc;
 
 	/* Sanity check */
-	if ( end != ( data + len ) ) {
+	if ( ( end != ( data + len ) ) ||
+	     ( hello_a->session_id_len > sizeof ( tls->session_id ) ) ) {
 		DBGC ( tls, "TLS %p received overlength Server Hello\n", tls );
 		DBGC_HD ( tls, data, len );
 		return -EINVAL;
 	}
 
 	/* Check protocol version */
-	if ( ntohs ( hello_a->version ) < TLS_VERSION_TLS_1_0 ) {
+	version = ntohs ( hello_a->version );
+	if ( ( version < TLS_VERSION_TLS_1_0 ) ||
+	     ( version > TLS_VERSION_TLS_1_2 ) ) {
 		DBGC ( tls, "TLS %p does not support protocol version %d.%d\n",
-		       tls, ( ntohs ( hello_a->version ) >> 8 ),
-		       ( ntohs ( hello_a->version ) & 0xff ) );
+		       tls, ( version >> 8 ), ( version & 0xff ) );
 		return -ENOTSUP;
 	}
+	tls->version = version;
+	DBGC ( tls, "TLS %p using protocol version %d.%d\n",
+	       tls, ( version >> 8 ), ( version & 0xff ) );
 
 	/* Copy out server random bytes */
 	memcpy ( &tls->server_random, &hello_a->random,
@@ -834,8 +1038,24 @@ static int tls_new_server_hello ( struct tls_session *tls,
 	if ( ( rc = tls_select_cipher ( tls, hello_b->cipher_suite ) ) != 0 )
 		return rc;
 
-	/* Generate secrets */
-	tls_generate_master_secret ( tls );
+	/* Resume the cached session if the server echoed its session
+	 * ID, otherwise record the new session ID and generate a
+	 * fresh master secret.
+	 */
+	if ( hello_a->session_id_len &&
+	     ( hello_a->session_id_len == tls->session_id_len ) &&
+	     ( memcmp ( hello_b->session_id, tls->session_id,
+			tls->session_id_len ) == 0 ) ) {
+		DBGC ( tls, "TLS %p resuming session\n", tls );
+		tls->resumed = 1;
+	} else {
+		memcpy ( tls->session_id, hello_b->session_id,
+			 hello_a->session_id_len );
+		tls->session_id_len = hello_a->session_id_len;
+		tls_generate_master_secret ( tls );
+	}
+
+	/* Generate keys */
 	if ( ( rc = tls_generate_keys ( tls ) ) != 0 )
 		return rc;
 
@@ -863,7 +1083,10 @@ static int tls_new_certificate ( struct tls_session *tls,
 		  ( ( void * ) certificate->certificates );
 	size_t elements_len = tls_uint24 ( certificate->length );
 	void *end = ( certificate->certificates + elements_len );
-	struct asn1_cursor cursor;
+	struct asn1_cursor chain[X509_MAX_CHAIN];
+	struct asn1_cursor *cursor;
+	unsigned int count = 0;
+	union profiler profiler;
 	int rc;
 
 	/* Sanity check */
@@ -874,30 +1097,63 @@ static int tls_new_certificate ( struct tls_session *tls,
 		return -EINVAL;
 	}
 
-	/* Traverse certificate chain */
-	do {
-		cursor.data = element->certificate;
-		cursor.len = tls_uint24 ( element->length );
-		if ( ( cursor.data + cursor.len ) > end ) {
+	/* Collect certificate chain, starting with the server's own
+	 * certificate.  Any certificates beyond X509_MAX_CHAIN are
+	 * ignored; the chain must reach a trusted certificate before
+	 * that point.
+	 */
+	while ( ( ( void * ) element != end ) && ( count < X509_MAX_CHAIN ) ) {
+		cursor = &chain[count];
+		if ( ( ( void * ) element->certificate > end ) ||
+		     ( tls_uint24 ( element->length ) >
+		       ( size_t ) ( end - ( void * ) element->certificate ) ) ){
 			DBGC ( tls, "TLS %p received corrupt Server "
 			       "Certificate\n", tls );
 			DBGC_HD ( tls, data, len );
 			return -EINVAL;
 		}
+		cursor->data = element->certificate;
+		cursor->len = tls_uint24 ( element->length );
+		element = ( cursor->data + cursor->len );
+		count++;
+	}
+	if ( ! count ) {
+		DBGC ( tls, "TLS %p received empty Server Certificate\n",
+		       tls );
+		return -EINVAL;
+	}
 
-		// HACK
-		if ( ( rc = x509_rsa_public_key ( &cursor,
-						  &tls->rsa ) ) != 0 ) {
-			DBGC ( tls, "TLS %p cannot determine RSA public key: "
-			       "%s\n", tls, strerror ( rc ) );
-			return rc;
+	/* Validate chain and extract the server's RSA public key */
+	x509_free_rsa_public_key ( &tls->rsa );
+	memset ( &tls->rsa, 0, sizeof ( tls->rsa ) );
+	profile ( &profiler );
+	if ( root_certificates.count ) {
+		/* The server's own certificate must match its name */
+		if ( ! tls->name ) {
+			DBGC ( tls, "TLS %p cannot verify server certificate "
+			       "without a server name\n", tls );
+			return -EACCES;
 		}
-		return 0;
-
-		element = ( cursor.data + cursor.len );
-	} while ( element != end );
+		rc = x509_check_name ( &chain[0], tls->name );
+		if ( rc == 0 ) {
+			rc = x509_validate_chain ( chain, count,
+						   &root_certificates,
+						   &tls->rsa );
+		}
+	} else {
+		DBGC ( tls, "TLS %p not verifying server certificate (no "
+		       "trusted roots)\n", tls );
+		rc = x509_rsa_public_key ( &chain[0], &tls->rsa );
+	}
+	if ( rc != 0 ) {
+		DBGC ( tls, "TLS %p cannot validate server certificate "
+		       "chain: %s\n", tls, strerror ( rc ) );
+		return rc;
+	}
+	DBGC ( tls, "TLS %p processed %d-certificate chain in %ld ticks\n",
+	       tls, count, profile ( &profiler ) );
 
-	return -EINVAL;
+	return 0;
 }
 
 /**
@@ -924,7 +1180,7 @@ static int tls_new_server_hello_done ( struct tls_session *tls,
 	}
 
 	/* Check that we are ready to send the Client Key Exchange */
-	if ( tls->tx_state != TLS_TX_NONE ) {
+	if ( ( tls->tx_state != TLS_TX_NONE ) || tls->resumed ) {
 		DBGC ( tls, "TLS %p received Server Hello Done while in "
 		       "TX state %d\n", tls, tls->tx_state );
 		return -EIO;
@@ -946,11 +1202,53 @@ static int tls_new_server_hello_done ( struct tls_session *tls,
  */
 static int tls_new_finished ( struct tls_session *tls,
 			      void *data, size_t len ) {
+	struct {
+		uint8_t verify_data[12];
+		char next[0];
+	} __attribute__ (( packed )) *finished = data;
+	void *end = finished->next;
+	uint8_t digest[MD5_DIGEST_SIZE + SHA1_DIGEST_SIZE];
+	size_t digest_len;
+	uint8_t verify_data[ sizeof ( finished->verify_data ) ];
+
+	/* Sanity check */
+	if ( end != ( data + len ) ) {
+		DBGC ( tls, "TLS %p received overlength Finished\n", tls );
+		DBGC_HD ( tls, data, len );
+		return -EINVAL;
+	}
+
+	/* Verify data.  This record has not yet been added to the
+	 * handshake digest.
+	 */
+	digest_len = tls_verify_handshake ( tls, digest );
+	tls_prf_label ( tls, &tls->master_secret, sizeof ( tls->master_secret ),
+			verify_data, sizeof ( verify_data ),
+			"server finished", digest, digest_len );
+	if ( memcmp ( verify_data, finished->verify_data,
+		      sizeof ( verify_data ) ) != 0 ) {
+		DBGC ( tls, "TLS %p verification failed\n", tls );
+		return -EPERM;
+	}
+
+	if ( tls->resumed ) {
+		/* Server speaks first when resuming a session; we
+		 * must now send our own Change Cipher and Finished.
+		 */
+		if ( tls->tx_state != TLS_TX_NONE ) {
+			DBGC ( tls, "TLS %p received Finished while in "
+			       "TX state %d\n", tls, tls->tx_state );
+			return -EIO;
+		}
+		tls->tx_state = TLS_TX_CHANGE_CIPHER;
+	} else {
+		/* Full handshake is complete */
+		DBGC ( tls, "TLS %p completed full handshake in %ld ticks\n",
+		       tls, profile ( &tls->profiler ) );
+		tls_cache_session ( tls );
+		tls->tx_state = TLS_TX_DATA;
+	}
 
-	/* FIXME: Handle this properly */
-	tls->tx_state = TLS_TX_DATA;
-	( void ) data;
-	( void ) len;
 	return 0;
 }
 
@@ -1030,29 +1328,42 @@ static int tls_new_handshake ( struct tls_session *tls,
  *
  * @v tls		TLS session
  * @v type		Record type
- * @v data		Plaintext record
- * @v len		Length of plaintext record
+ * @v iobuf		I/O buffer containing plaintext record
  * @ret rc		Return status code
+ *
+ * Application data records are handed on to the plaintext stream
+ * without further copying; this function takes ownership of the I/O
+ * buffer in all cases.
  */
 static int tls_new_record ( struct tls_session *tls,
-			    unsigned int type, void *data, size_t len ) {
+			    unsigned int type, struct io_buffer *iobuf ) {
+	void *data = iobuf->data;
+	size_t len = iob_len ( iobuf );
+	int rc;
 
 	switch ( type ) {
 	case TLS_TYPE_CHANGE_CIPHER:
-		return tls_new_change_cipher ( tls, data, len );
+		rc = tls_new_change_cipher ( tls, data, len );
+		break;
 	case TLS_TYPE_ALERT:
-		return tls_new_alert ( tls, data, len );
+		rc = tls_new_alert ( tls, data, len );
+		break;
 	case TLS_TYPE_HANDSHAKE:
-		return tls_new_handshake ( tls, data, len );
+		rc = tls_new_handshake ( tls, data, len );
+		break;
 	case TLS_TYPE_DATA:
-		return xfer_deliver_raw ( &tls->plainstream.xfer, data, len );
+		return xfer_deliver_iob ( &tls->plainstream.xfer, iobuf );
 	default:
 		/* RFC4346 says that we should just ignore unknown
 		 * record types.
 		 */
 		DBGC ( tls, "TLS %p ignoring record type %d\n", tls, type );
-		return 0;
+		rc = 0;
+		break;
 	}
+
+	free_iob ( iobuf );
+	return rc;
 }
 
 /******************************************************************************
@@ -1148,8 +1459,12 @@ static void * tls_assemble_block ( struct tls_session *tls,
 	void *mac;
 	void *padding;
 
-	/* FIXME: TLSv1.1 has an explicit IV */
-	iv_len = 0;
+	/* TLSv1.1 and later have an explicit IV.  Since the cipher
+	 * context continues to chain across records, any random block
+	 * prepended to the record will serve.
+	 */
+	if ( tls->version < TLS_VERSION_TLS_1_1 )
+		iv_len = 0;
 
 	/* Calculate block-ciphered struct length */
 	padding_len = ( ( blocksize - 1 ) & -( iv_len + len + mac_len + 1 ) );
@@ -1165,7 +1480,7 @@ static void * tls_assemble_block ( struct tls_session *tls,
 	padding = ( mac + mac_len );
 
 	/* Fill in block-ciphered struct */
-	memset ( iv, 0, iv_len );
+	tls_generate_random ( iv, iv_len );
 	memcpy ( content, data, len );
 	memcpy ( mac, digest, mac_len );
 	memset ( padding, padding_len, ( padding_len + 1 ) );
@@ -1173,6 +1488,81 @@ static void * tls_assemble_block ( struct tls_session *tls,
 	return plaintext;
 }
 
+/**
+ * Send plaintext record using authenticated encryption cipher
+ *
+ * @v tls		TLS session
+ * @v plaintext_tlshdr	Plaintext record header
+ * @v data		Plaintext record
+ * @v len		Length of plaintext record
+ * @ret rc		Return status code
+ *
+ * The record is encrypted directly into the transmit I/O buffer.
+ * Since each record has its own nonce, the cipher context need not be
+ * preserved across a failed transmission.
+ */
+static int tls_send_auth_plaintext ( struct tls_session *tls,
+				     struct tls_header *plaintext_tlshdr,
+				     const void *data, size_t len ) {
+	struct tls_cipherspec *cipherspec = &tls->tx_cipherspec;
+	struct cipher_algorithm *cipher = cipherspec->cipher;
+	void *cipher_ctx = cipherspec->cipher_ctx;
+	struct tls_auth_nonce nonce;
+	struct tls_auth_header authhdr;
+	struct io_buffer *ciphertext;
+	struct tls_header *tlshdr;
+	size_t record_len;
+	int rc;
+
+	/* Allocate ciphertext */
+	record_len = ( sizeof ( nonce.record ) + len + cipher->authsize );
+	ciphertext = xfer_alloc_iob ( &tls->cipherstream.xfer,
+				      ( sizeof ( *tlshdr ) + record_len ) );
+	if ( ! ciphertext ) {
+		DBGC ( tls, "TLS %p could not allocate %zd bytes for "
+		       "ciphertext\n", tls, ( sizeof ( *tlshdr ) + record_len ));
+		return -ENOMEM;
+	}
+
+	/* Construct header and explicit nonce.  The sequence number
+	 * is unique for each record, and so serves as the nonce.
+	 */
+	tlshdr = iob_put ( ciphertext, sizeof ( *tlshdr ) );
+	tlshdr->type = plaintext_tlshdr->type;
+	tlshdr->version = plaintext_tlshdr->version;
+	tlshdr->length = htons ( record_len );
+	memcpy ( nonce.fixed, cipherspec->fixed_iv, sizeof ( nonce.fixed ) );
+	nonce.record = cpu_to_be64 ( tls->tx_seq );
+	memcpy ( iob_put ( ciphertext, sizeof ( nonce.record ) ),
+		 &nonce.record, sizeof ( nonce.record ) );
+
+	/* Encrypt and authenticate */
+	authhdr.seq = cpu_to_be64 ( tls->tx_seq );
+	authhdr.tlshdr.type = plaintext_tlshdr->type;
+	authhdr.tlshdr.version = plaintext_tlshdr->version;
+	authhdr.tlshdr.length = plaintext_tlshdr->length;
+	cipher_setiv ( cipher, cipher_ctx, &nonce );
+	cipher_encrypt ( cipher, cipher_ctx, &authhdr, NULL,
+			 sizeof ( authhdr ) );
+	cipher_encrypt ( cipher, cipher_ctx, data,
+			 iob_put ( ciphertext, len ), len );
+	cipher_auth ( cipher, cipher_ctx,
+		      iob_put ( ciphertext, cipher->authsize ) );
+
+	/* Send ciphertext */
+	if ( ( rc = xfer_deliver_iob ( &tls->cipherstream.xfer,
+				       ciphertext ) ) != 0 ) {
+		DBGC ( tls, "TLS %p could not deliver ciphertext: %s\n",
+		       tls, strerror ( rc ) );
+		return rc;
+	}
+
+	/* Update TX state machine to next record */
+	tls->tx_seq += 1;
+
+	return 0;
+}
+
 /**
  * Send plaintext record
  *
@@ -1197,9 +1587,15 @@ static int tls_send_plaintext ( struct tls_session *tls, unsigned int type,
 
 	/* Construct header */
 	plaintext_tlshdr.type = type;
-	plaintext_tlshdr.version = htons ( TLS_VERSION_TLS_1_0 );
+	plaintext_tlshdr.version = htons ( tls->version );
 	plaintext_tlshdr.length = htons ( len );
 
+	/* Authenticated encryption ciphers need no separate MAC */
+	if ( is_auth_cipher ( cipherspec->cipher ) ) {
+		return tls_send_auth_plaintext ( tls, &plaintext_tlshdr,
+						 data, len );
+	}
+
 	/* Calculate MAC */
 	tls_hmac ( tls, cipherspec, tls->tx_seq, &plaintext_tlshdr,
 		   data, len, mac );
@@ -1236,7 +1632,7 @@ static int tls_send_plaintext ( struct tls_session *tls, unsigned int type,
 	/* Assemble ciphertext */
 	tlshdr = iob_put ( ciphertext, sizeof ( *tlshdr ) );
 	tlshdr->type = type;
-	tlshdr->version = htons ( TLS_VERSION_TLS_1_0 );
+	tlshdr->version = htons ( tls->version );
 	tlshdr->length = htons ( plaintext_len );
 	memcpy ( cipherspec->cipher_next_ctx, cipherspec->cipher_ctx,
 		 cipherspec->cipher->ctxsize );
@@ -1340,8 +1736,12 @@ static int tls_split_block ( struct tls_session *tls,
 	}
 	iv_len = tls->rx_cipherspec.cipher->blocksize;
 
-	/* FIXME: TLSv1.1 uses an explicit IV */
-	iv_len = 0;
+	/* TLSv1.1 and later use an explicit IV.  Decrypting with the
+	 * chained cipher context produces a garbage first block, which
+	 * is discarded; the remainder of the record is unaffected.
+	 */
+	if ( tls->version < TLS_VERSION_TLS_1_1 )
+		iv_len = 0;
 
 	mac_len = tls->rx_cipherspec.digest->digestsize;
 	padding_len = *( ( uint8_t * ) ( plaintext + plaintext_len - 1 ) );
@@ -1373,20 +1773,93 @@ static int tls_split_block ( struct tls_session *tls,
 	return 0;
 }
 
+/**
+ * Receive new ciphertext record using authenticated encryption cipher
+ *
+ * @v tls		TLS session
+ * @v tlshdr		Record header
+ * @v iobuf		I/O buffer containing ciphertext record
+ * @ret rc		Return status code
+ *
+ * The record is decrypted in place.  This function takes ownership
+ * of the I/O buffer.
+ */
+static int tls_new_auth_ciphertext ( struct tls_session *tls,
+				     struct tls_header *tlshdr,
+				     struct io_buffer *iobuf ) {
+	struct tls_cipherspec *cipherspec = &tls->rx_cipherspec;
+	struct cipher_algorithm *cipher = cipherspec->cipher;
+	void *cipher_ctx = cipherspec->cipher_ctx;
+	void *ciphertext = iobuf->data;
+	size_t record_len = iob_len ( iobuf );
+	struct tls_auth_nonce nonce;
+	struct tls_auth_header authhdr;
+	uint8_t verify_auth[cipher->authsize];
+	void *data;
+	size_t len;
+	void *auth;
+	int rc;
+
+	/* Decompose record into explicit nonce, data and tag */
+	if ( record_len < ( sizeof ( nonce.record ) + cipher->authsize ) ) {
+		DBGC ( tls, "TLS %p received underlength record\n", tls );
+		DBGC_HD ( tls, ciphertext, record_len );
+		rc = -EINVAL;
+		goto err;
+	}
+	len = ( record_len - sizeof ( nonce.record ) - cipher->authsize );
+	data = ( ciphertext + sizeof ( nonce.record ) );
+	auth = ( data + len );
+	memcpy ( nonce.fixed, cipherspec->fixed_iv, sizeof ( nonce.fixed ) );
+	memcpy ( &nonce.record, ciphertext, sizeof ( nonce.record ) );
+
+	/* Decrypt (in place) and verify the record */
+	authhdr.seq = cpu_to_be64 ( tls->rx_seq );
+	authhdr.tlshdr.type = tlshdr->type;
+	authhdr.tlshdr.version = tlshdr->version;
+	authhdr.tlshdr.length = htons ( len );
+	cipher_setiv ( cipher, cipher_ctx, &nonce );
+	cipher_decrypt ( cipher, cipher_ctx, &authhdr, NULL,
+			 sizeof ( authhdr ) );
+	cipher_decrypt ( cipher, cipher_ctx, data, data, len );
+	cipher_auth ( cipher, cipher_ctx, verify_auth );
+	if ( memcmp ( auth, verify_auth, sizeof ( verify_auth ) ) != 0 ) {
+		DBGC ( tls, "TLS %p failed authentication\n", tls );
+		rc = -EACCES;
+		goto err;
+	}
+
+	DBGC2 ( tls, "Received plaintext data:\n" );
+	DBGC2_HD ( tls, data, len );
+
+	/* Strip explicit nonce and tag, and process plaintext record */
+	iob_pull ( iobuf, sizeof ( nonce.record ) );
+	iob_unput ( iobuf, cipher->authsize );
+	return tls_new_record ( tls, tlshdr->type, iobuf );
+
+ err:
+	free_iob ( iobuf );
+	return rc;
+}
+
 /**
  * Receive new ciphertext record
  *
  * @v tls		TLS session
  * @v tlshdr		Record header
- * @v ciphertext	Ciphertext record
+ * @v iobuf		I/O buffer containing ciphertext record
  * @ret rc		Return status code
+ *
+ * The record is decrypted in place.  This function takes ownership
+ * of the I/O buffer.
  */
 static int tls_new_ciphertext ( struct tls_session *tls,
-				struct tls_header *tlshdr, void *ciphertext ) {
+				struct tls_header *tlshdr,
+				struct io_buffer *iobuf ) {
 	struct tls_header plaintext_tlshdr;
 	struct tls_cipherspec *cipherspec = &tls->rx_cipherspec;
-	size_t record_len = ntohs ( tlshdr->length );
-	void *plaintext = NULL;
+	void *plaintext = iobuf->data;
+	size_t record_len = iob_len ( iobuf );
 	void *data;
 	size_t len;
 	void *mac;
@@ -1394,28 +1867,23 @@ static int tls_new_ciphertext ( struct tls_session *tls,
 	uint8_t verify_mac[mac_len];
 	int rc;
 
-	/* Allocate buffer for plaintext */
-	plaintext = malloc ( record_len );
-	if ( ! plaintext ) {
-		DBGC ( tls, "TLS %p could not allocate %zd bytes for "
-		       "decryption buffer\n", tls, record_len );
-		rc = -ENOMEM;
-		goto done;
-	}
+	/* Authenticated encryption ciphers need no separate MAC */
+	if ( is_auth_cipher ( cipherspec->cipher ) )
+		return tls_new_auth_ciphertext ( tls, tlshdr, iobuf );
 
-	/* Decrypt the record */
+	/* Decrypt the record in place */
 	cipher_decrypt ( cipherspec->cipher, cipherspec->cipher_ctx,
-			 ciphertext, plaintext, record_len );
+			 plaintext, plaintext, record_len );
 
 	/* Split record into content and MAC */
 	if ( is_stream_cipher ( cipherspec->cipher ) ) {
 		if ( ( rc = tls_split_stream ( tls, plaintext, record_len,
 					       &data, &len, &mac ) ) != 0 )
-			goto done;
+			goto err;
 	} else {
 		if ( ( rc = tls_split_block ( tls, plaintext, record_len,
 					      &data, &len, &mac ) ) != 0 )
-			goto done;
+			goto err;
 	}
 
 	/* Verify MAC */
@@ -1427,19 +1895,22 @@ static int tls_new_ciphertext ( struct tls_session *tls,
 	if ( memcmp ( mac, verify_mac, mac_len ) != 0 ) {
 		DBGC ( tls, "TLS %p failed MAC verification\n", tls );
 		DBGC_HD ( tls, plaintext, record_len );
-		goto done;
+		rc = -EACCES;
+		goto err;
 	}
 
 	DBGC2 ( tls, "Received plaintext data:\n" );
 	DBGC2_HD ( tls, data, len );
 
-	/* Process plaintext record */
-	if ( ( rc = tls_new_record ( tls, tlshdr->type, data, len ) ) != 0 )
-		goto done;
+	/* Strip explicit IV, MAC and padding, and process plaintext
+	 * record
+	 */
+	iob_pull ( iobuf, ( data - plaintext ) );
+	iob_unput ( iobuf, ( iob_len ( iobuf ) - len ) );
+	return tls_new_record ( tls, tlshdr->type, iobuf );
 
-	rc = 0;
- done:
-	free ( plaintext );
+ err:
+	free_iob ( iobuf );
 	return rc;
 }
 
@@ -1539,14 +2010,18 @@ static void tls_cipherstream_close ( struct xfer_interface *xfer, int rc ) {
 static int tls_newdata_process_header ( struct tls_session *tls ) {
 	size_t data_len = ntohs ( tls->rx_header.length );
 
-	/* Allocate data buffer now that we know the length */
+	/* Allocate data buffer now that we know the length.  The
+	 * record will be decrypted in place within this buffer, which
+	 * is then passed to the plaintext stream.
+	 */
 	assert ( tls->rx_data == NULL );
-	tls->rx_data = malloc ( data_len );
+	tls->rx_data = alloc_iob ( data_len );
 	if ( ! tls->rx_data ) {
 		DBGC ( tls, "TLS %p could not allocate %zd bytes "
 		       "for receive buffer\n", tls, data_len );
 		return -ENOMEM;
 	}
+	iob_put ( tls->rx_data, data_len );
 
 	/* Move to data state */
 	tls->rx_state = TLS_RX_DATA;
@@ -1565,16 +2040,12 @@ static int tls_newdata_process_data ( struct tls_session *tls ) {
 
 	/* Process record */
 	if ( ( rc = tls_new_ciphertext ( tls, &tls->rx_header,
-					 tls->rx_data ) ) != 0 )
+					 iob_disown ( tls->rx_data ) ) ) != 0 )
 		return rc;
 
 	/* Increment RX sequence number */
 	tls->rx_seq += 1;
 
-	/* Free data buffer */
-	free ( tls->rx_data );
-	tls->rx_data = NULL;
-
 	/* Return to header state */
 	tls->rx_state = TLS_RX_HEADER;
 
@@ -1608,8 +2079,8 @@ static int tls_cipherstream_deliver_raw ( struct xfer_interface *xfer,
 			process = tls_newdata_process_header;
 			break;
 		case TLS_RX_DATA:
-			buf = tls->rx_data;
-			buf_len = ntohs ( tls->rx_header.length );
+			buf = tls->rx_data->data;
+			buf_len = iob_len ( tls->rx_data );
 			process = tls_newdata_process_data;
 			break;
 		default:
@@ -1676,6 +2147,7 @@ static void tls_step ( struct process *process ) {
 		break;
 	case TLS_TX_CLIENT_HELLO:
 		/* Send Client Hello */
+		profile ( &tls->profiler );
 		if ( ( rc = tls_send_client_hello ( tls ) ) != 0 ) {
 			DBGC ( tls, "TLS %p could not send Client Hello: %s\n",
 			       tls, strerror ( rc ) );
@@ -1716,7 +2188,16 @@ static void tls_step ( struct process *process ) {
 			       tls, strerror ( rc ) );
 			goto err;
 		}
-		tls->tx_state = TLS_TX_NONE;
+		/* A resumed handshake is complete once we have sent
+		 * our Finished; a full handshake awaits the server's.
+		 */
+		if ( tls->resumed ) {
+			DBGC ( tls, "TLS %p resumed session in %ld ticks\n",
+			       tls, profile ( &tls->profiler ) );
+			tls->tx_state = TLS_TX_DATA;
+		} else {
+			tls->tx_state = TLS_TX_NONE;
+		}
 		break;
 	case TLS_TX_DATA:
 		/* Nothing to do */
@@ -1738,7 +2219,20 @@ static void tls_step ( struct process *process ) {
  ******************************************************************************
  */
 
-int add_tls ( struct xfer_interface *xfer, struct xfer_interface **next ) {
+/**
+ * Add TLS filter to data transfer interface
+ *
+ * @v xfer		Plaintext data transfer interface
+ * @v name		Server name, or NULL
+ * @ret next		Ciphertext data transfer interface
+ * @ret rc		Return status code
+ *
+ * The server name is used to look up a previous session with the
+ * same server, which may be resumed without repeating the public-key
+ * key exchange.
+ */
+int add_tls ( struct xfer_interface *xfer, const char *name,
+	      struct xfer_interface **next ) {
 	struct tls_session *tls;
 
 	/* Allocate and initialise TLS structure */
@@ -1747,6 +2241,13 @@ int add_tls ( struct xfer_interface *xfer, struct xfer_interface **next ) {
 		return -ENOMEM;
 	memset ( tls, 0, sizeof ( *tls ) );
 	tls->refcnt.free = free_tls;
+	if ( name ) {
+		tls->name = strdup ( name );
+		if ( ! tls->name ) {
+			free ( tls );
+			return -ENOMEM;
+		}
+	}
 	filter_init ( &tls->plainstream, &tls_plainstream_operations,
 		      &tls->cipherstream, &tls_cipherstream_operations,
 		      &tls->refcnt );
@@ -1757,11 +2258,14 @@ int add_tls ( struct xfer_interface *xfer, struct xfer_interface **next ) {
 	tls->client_random.gmt_unix_time = 0;
 	tls_generate_random ( &tls->client_random.random,
 			      ( sizeof ( tls->client_random.random ) ) );
-	tls->pre_master_secret.version = htons ( TLS_VERSION_TLS_1_0 );
+	tls->version = TLS_VERSION_TLS_1_0;
+	tls->pre_master_secret.version = htons ( TLS_VERSION_TLS_1_2 );
 	tls_generate_random ( &tls->pre_master_secret.random,
 			      ( sizeof ( tls->pre_master_secret.random ) ) );
 	digest_init ( &md5_algorithm, tls->handshake_md5_ctx );
 	digest_init ( &sha1_algorithm, tls->handshake_sha1_ctx );
+	digest_init ( &sha256_algorithm, tls->handshake_sha256_ctx );
+	tls_resume_session ( tls );
 	tls->tx_state = TLS_TX_CLIENT_HELLO;
 	process_init ( &tls->process, tls_step, &tls->refcnt );
 
@@ -79,6 +79,7 @@ static uint8_t dhcp_request_options_data[] = {
 	DHCP_CLIENT_NDI, DHCP_ARCH_CLIENT_NDI,
 	DHCP_VENDOR_CLASS_ID, DHCP_ARCH_VENDOR_CLASS_ID,
 	DHCP_USER_CLASS_ID, DHCP_STRING ( 'g', 'P', 'X', 'E' ),
+	DHCP_RAPID_COMMIT, 0,
 	DHCP_PARAMETER_REQUEST_LIST,
 	DHCP_OPTION ( DHCP_SUBNET_MASK, DHCP_ROUTERS, DHCP_DNS_SERVERS,
 		      DHCP_LOG_SERVERS, DHCP_HOST_NAME, DHCP_DOMAIN_NAME,
@@ -202,6 +203,8 @@ static struct dhcp_session_state dhcp_state_discover;
 static struct dhcp_session_state dhcp_state_request;
 static struct dhcp_session_state dhcp_state_proxy;
 static struct dhcp_session_state dhcp_state_pxebs;
+static void dhcp_ack ( struct dhcp_session *dhcp,
+		       struct dhcp_packet *dhcppkt );
 
 /** DHCP offer is valid for IP lease */
 #define DHCP_OFFER_IP	1
@@ -228,6 +231,15 @@ struct dhcp_offer {
 
 	/** Whether to ignore PXE DHCP extensions */
 	uint8_t no_pxedhcp;
+
+	/** Whether offer includes a boot filename */
+	uint8_t has_filename;
+
+	/** Relay agent address, or 0.0.0.0 */
+	struct in_addr giaddr;
+
+	/** Rapid Commit DHCPACK for this offer; NULL if none */
+	struct dhcp_packet *ack;
 };
 
 /** Maximum number of DHCP offers to queue */
@@ -280,6 +292,8 @@ static void dhcp_free ( struct refcnt *refcnt ) {
 	for ( i = 0 ; i < DHCP_MAX_OFFERS ; i++ ) {
 		if ( dhcp->offers[i].pxe )
 			dhcppkt_put ( dhcp->offers[i].pxe );
+		if ( dhcp->offers[i].ack )
+			dhcppkt_put ( dhcp->offers[i].ack );
 	}
 
 	netdev_put ( dhcp->netdev );
@@ -354,6 +368,67 @@ static struct dhcp_offer * dhcp_next_offer ( struct dhcp_session *dhcp,
 	return best;
 }
 
+/** A network segment known to have no ProxyDHCP server */
+struct dhcp_no_proxy {
+	/** DHCP server */
+	struct in_addr server;
+	/** Relay agent address, or 0.0.0.0 */
+	struct in_addr giaddr;
+};
+
+/** Number of network segments to remember as having no ProxyDHCP */
+#define DHCP_NO_PROXY_CACHE 4
+
+/** Network segments known to have no ProxyDHCP server */
+static struct dhcp_no_proxy dhcp_no_proxy[DHCP_NO_PROXY_CACHE];
+
+/** Next entry to replace in the no-ProxyDHCP cache */
+static unsigned int dhcp_no_proxy_next;
+
+/**
+ * Find no-ProxyDHCP cache entry for a DHCP offer
+ *
+ * @v offer		DHCP offer
+ * @ret no_proxy	No-ProxyDHCP cache entry, or NULL
+ *
+ * A network segment is identified by the DHCP server that serves it
+ * and the relay agent (if any) via which the server is reached.
+ */
+static struct dhcp_no_proxy * dhcp_find_no_proxy ( struct dhcp_offer *offer ) {
+	struct dhcp_no_proxy *no_proxy;
+	unsigned int i;
+
+	for ( i = 0 ; i < DHCP_NO_PROXY_CACHE ; i++ ) {
+		no_proxy = &dhcp_no_proxy[i];
+		if ( no_proxy->server.s_addr &&
+		     ( no_proxy->server.s_addr == offer->server.s_addr ) &&
+		     ( no_proxy->giaddr.s_addr == offer->giaddr.s_addr ) )
+			return no_proxy;
+	}
+	return NULL;
+}
+
+/**
+ * Record presence or absence of ProxyDHCP on a DHCP offer's segment
+ *
+ * @v offer		DHCP offer
+ * @v present		ProxyDHCP server is present
+ */
+static void dhcp_record_proxy ( struct dhcp_offer *offer, int present ) {
+	struct dhcp_no_proxy *no_proxy;
+
+	no_proxy = dhcp_find_no_proxy ( offer );
+	if ( present ) {
+		if ( no_proxy )
+			memset ( no_proxy, 0, sizeof ( *no_proxy ) );
+	} else if ( ! no_proxy ) {
+		no_proxy = &dhcp_no_proxy[dhcp_no_proxy_next++ %
+					  DHCP_NO_PROXY_CACHE];
+		no_proxy->server = offer->server;
+		no_proxy->giaddr = offer->giaddr;
+	}
+}
+
 /****************************************************************************
  *
  * DHCP state machine
@@ -398,6 +473,7 @@ static void dhcp_rx_offer ( struct dhcp_session *dhcp,
 	int has_pxeclient;
 	int pxeopts_len;
 	int has_pxeopts;
+	int is_rapid_ack;
 	uint8_t discovery_control;
 	struct dhcp_offer *offer;
 	int i;
@@ -427,9 +503,30 @@ static void dhcp_rx_offer ( struct dhcp_session *dhcp,
 		return;
 	}
 
+	/* Discard anything left in the slot by an earlier, rejected
+	 * packet before filling it in
+	 */
 	offer = &dhcp->offers[i];
+	if ( offer->ack )
+		dhcppkt_put ( offer->ack );
+	if ( offer->pxe )
+		dhcppkt_put ( offer->pxe );
+	memset ( offer, 0, sizeof ( *offer ) );
 	offer->server = server_id;
 	offer->ip = dhcppkt->dhcphdr->yiaddr;
+	offer->giaddr = dhcppkt->dhcphdr->giaddr;
+
+	/* Identify Rapid Commit DHCPACK, which acts as an offer that
+	 * needs no DHCPREQUEST
+	 */
+	is_rapid_ack = ( ( msgtype == DHCPACK ) &&
+			 ( dhcppkt_fetch ( dhcppkt, DHCP_RAPID_COMMIT,
+					   NULL, 0 ) >= 0 ) );
+	if ( is_rapid_ack ) {
+		DBGC ( dhcp, " rapid" );
+		offer->ack = dhcppkt_get ( dhcppkt );
+		msgtype = DHCPOFFER;
+	}
 
 	/* Identify "PXEClient" vendor class */
 	vci_len = dhcppkt_fetch ( dhcppkt, DHCP_VENDOR_CLASS_ID,
@@ -471,8 +568,6 @@ static void dhcp_rx_offer ( struct dhcp_session *dhcp,
 
 	if ( has_pxeclient && has_pxeopts ) {
 		/* Save reference to packet for future use */
-		if ( offer->pxe )
-			dhcppkt_put ( offer->pxe );
 		offer->pxe = dhcppkt_get ( dhcppkt );
 	}
 
@@ -487,6 +582,12 @@ static void dhcp_rx_offer ( struct dhcp_session *dhcp,
 			sizeof ( offer->no_pxedhcp ) );
 	if ( offer->no_pxedhcp )
 		DBGC ( dhcp, " nopxe" );
+
+	/* Identify boot filename */
+	offer->has_filename =
+		( dhcppkt_fetch ( dhcppkt, DHCP_BOOTFILE_NAME, NULL, 0 ) > 0 );
+	if ( offer->has_filename )
+		DBGC ( dhcp, " file" );
 	DBGC ( dhcp, "\n" );
 
 	/* Determine roles this offer can fill */
@@ -497,6 +598,47 @@ static void dhcp_rx_offer ( struct dhcp_session *dhcp,
 
 	if ( has_pxeclient && ( msgtype == DHCPOFFER ) )
 		offer->valid |= DHCP_OFFER_PXE;
+
+	/* A Rapid Commit DHCPACK that cannot supply an address is of
+	 * no use as an ACK
+	 */
+	if ( offer->ack && ! ( offer->valid & DHCP_OFFER_IP ) ) {
+		dhcppkt_put ( offer->ack );
+		offer->ack = NULL;
+	}
+}
+
+/**
+ * Leave DHCP discovery state
+ *
+ * @v dhcp		DHCP session
+ *
+ * If the chosen offer arrived as a Rapid Commit DHCPACK, the lease is
+ * already ours and no DHCPREQUEST is needed.
+ */
+static void dhcp_discovery_done ( struct dhcp_session *dhcp ) {
+	struct dhcp_offer *ip_offer = dhcp_next_offer ( dhcp, DHCP_OFFER_IP );
+	unsigned long elapsed = ( currticks() - dhcp->start );
+
+	/* Remember whether or not this segment has a ProxyDHCP server */
+	if ( dhcp_next_offer ( dhcp, DHCP_OFFER_PXE ) ) {
+		dhcp_record_proxy ( ip_offer, 1 );
+	} else if ( elapsed > PROXYDHCP_MAX_TIMEOUT ) {
+		dhcp_record_proxy ( ip_offer, 0 );
+	}
+
+	/* Use Rapid Commit DHCPACK, if we have one */
+	if ( ip_offer->ack ) {
+		DBGC ( dhcp, "DHCP %p using rapid commit DHCPACK from %s\n",
+		       dhcp, inet_ntoa ( ip_offer->server ) );
+		stop_timer ( &dhcp->timer );
+		dhcp->current_offer = ip_offer;
+		dhcp_ack ( dhcp, ip_offer->ack );
+		return;
+	}
+
+	/* Transition to DHCPREQUEST */
+	dhcp_set_state ( dhcp, &dhcp_state_request );
 }
 
 /**
@@ -518,10 +660,12 @@ static void dhcp_discovery_rx ( struct dhcp_session *dhcp,
 	dhcp_rx_offer ( dhcp, dhcppkt, peer, msgtype, server_id );
 
 	/* We can exit the discovery state when we have a valid
-	 * DHCPOFFER, and either:
+	 * DHCPOFFER (or Rapid Commit DHCPACK), and either:
 	 *
 	 *  o  The DHCPOFFER instructs us to ignore ProxyDHCPOFFERs, or
+	 *  o  The DHCPOFFER already provides a boot filename, or
 	 *  o  We have a valid ProxyDHCPOFFER, or
+	 *  o  We have previously found no ProxyDHCP on this segment, or
 	 *  o  We have allowed sufficient time for ProxyDHCPOFFERs.
 	 */
 
@@ -530,15 +674,15 @@ static void dhcp_discovery_rx ( struct dhcp_session *dhcp,
 	if ( ! ip_offer )
 		return;
 
-	/* If we can't yet transition to DHCPREQUEST, do nothing */
+	/* If we can't yet leave the discovery state, do nothing */
 	elapsed = ( currticks() - dhcp->start );
-	if ( ! ( ip_offer->no_pxedhcp ||
+	if ( ! ( ip_offer->no_pxedhcp || ip_offer->has_filename ||
 		 dhcp_next_offer ( dhcp, DHCP_OFFER_PXE ) ||
+		 dhcp_find_no_proxy ( ip_offer ) ||
 		 ( elapsed > PROXYDHCP_MAX_TIMEOUT ) ) )
 		return;
 
-	/* Transition to DHCPREQUEST */
-	dhcp_set_state ( dhcp, &dhcp_state_request );
+	dhcp_discovery_done ( dhcp );
 }
 
 /**
@@ -552,7 +696,7 @@ static void dhcp_discovery_expired ( struct dhcp_session *dhcp ) {
 	/* Give up waiting for ProxyDHCP before we reach the failure point */
 	if ( dhcp_next_offer ( dhcp, DHCP_OFFER_IP ) &&
 	     ( elapsed > PROXYDHCP_MAX_TIMEOUT ) ) {
-		dhcp_set_state ( dhcp, &dhcp_state_request );
+		dhcp_discovery_done ( dhcp );
 		return;
 	}
 
@@ -621,9 +765,6 @@ static void dhcp_request_rx ( struct dhcp_session *dhcp,
 			      struct sockaddr_in *peer, uint8_t msgtype,
 			      struct in_addr server_id ) {
 	struct in_addr ip;
-	struct settings *parent;
-	int rc;
-	struct dhcp_offer *pxe_offer;
 
 	if ( msgtype == DHCPOFFER ) {
 		dhcp_rx_offer ( dhcp, dhcppkt, peer, msgtype, server_id );
@@ -656,8 +797,23 @@ static void dhcp_request_rx ( struct dhcp_session *dhcp,
 	if ( server_id.s_addr != dhcp->current_offer->server.s_addr )
 		return;
 
+	dhcp_ack ( dhcp, dhcppkt );
+}
+
+/**
+ * Handle acknowledged DHCP lease
+ *
+ * @v dhcp		DHCP session
+ * @v dhcppkt		DHCPACK packet for the current offer
+ */
+static void dhcp_ack ( struct dhcp_session *dhcp,
+		       struct dhcp_packet *dhcppkt ) {
+	struct settings *parent;
+	struct dhcp_offer *pxe_offer;
+	int rc;
+
 	/* Record assigned address */
-	dhcp->local.sin_addr = ip;
+	dhcp->local.sin_addr = dhcppkt->dhcphdr->yiaddr;
 
 	/* Register settings */
 	parent = netdev_settings ( dhcp->netdev );
@@ -670,6 +826,8 @@ static void dhcp_request_rx ( struct dhcp_session *dhcp,
 
 	/* Locate best source of PXE settings */
 	pxe_offer = dhcp_next_offer ( dhcp, DHCP_OFFER_PXE );
+	if ( pxe_offer )
+		dhcp_record_proxy ( dhcp->current_offer, 1 );
 
 	if ( ( ! pxe_offer ) || /* No PXE available */
 	     /* IP offer instructs us to ignore PXE */
@@ -1129,6 +1287,16 @@ int dhcp_create_request ( struct dhcp_packet *dhcppkt,
 	/* Set client IP address */
 	dhcppkt->dhcphdr->ciaddr = ciaddr;
 
+	/* Rapid Commit is meaningful only within a DHCPDISCOVER */
+	if ( msgtype != DHCPDISCOVER ) {
+		if ( ( rc = dhcppkt_store ( dhcppkt, DHCP_RAPID_COMMIT,
+					    NULL, 0 ) ) != 0 ) {
+			DBG ( "DHCP could not clear rapid commit option: %s\n",
+			      strerror ( rc ) );
+			return rc;
+		}
+	}
+
 	/* Add options to identify the feature list */
 	dhcp_features = table_start ( DHCP_FEATURES );
 	dhcp_features_len = table_num_entries ( DHCP_FEATURES );
@@ -0,0 +1,149 @@
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <assert.h>
+#include <gpxe/crypto.h>
+#include <gpxe/aes.h>
+
+/*
+ * AES known-answer tests
+ *
+ * Checks the FIPS-197 single-block vectors and the NIST SP 800-38A
+ * CBC vectors against both the accelerated (if present) and generic
+ * AES implementations.  Each CBC vector is decrypted both into a
+ * separate buffer and in place.
+ *
+ */
+
+struct aes_test_vector {
+	const char *name;
+	struct cipher_algorithm *cipher;
+	uint8_t key[32];
+	size_t keylen;
+	uint8_t iv[16];
+	uint8_t plaintext[64];
+	uint8_t ciphertext[64];
+	size_t len;
+};
+
+#define AES_TEST_SP800_38A_PLAINTEXT					\
+	{ 0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96,		\
+	  0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,		\
+	  0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c,		\
+	  0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,		\
+	  0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11,		\
+	  0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,		\
+	  0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17,		\
+	  0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10 }
+
+#define AES_TEST_SP800_38A_IV						\
+	{ 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,		\
+	  0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f }
+
+static struct aes_test_vector aes_test_vectors[] = {
+	{ "FIPS-197 AES-128", &aes_algorithm,
+	  { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+	    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f }, 16,
+	  { 0 },
+	  { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+	    0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff },
+	  { 0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+	    0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a }, 16 },
+	{ "FIPS-197 AES-256", &aes_algorithm,
+	  { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+	    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+	    0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+	    0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f }, 32,
+	  { 0 },
+	  { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+	    0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff },
+	  { 0x8e, 0xa2, 0xb7, 0xca, 0x51, 0x67, 0x45, 0xbf,
+	    0xea, 0xfc, 0x49, 0x90, 0x4b, 0x49, 0x60, 0x89 }, 16 },
+	{ "SP800-38A CBC-AES128", &aes_cbc_algorithm,
+	  { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+	    0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c }, 16,
+	  AES_TEST_SP800_38A_IV, AES_TEST_SP800_38A_PLAINTEXT,
+	  { 0x76, 0x49, 0xab, 0xac, 0x81, 0x19, 0xb2, 0x46,
+	    0xce, 0xe9, 0x8e, 0x9b, 0x12, 0xe9, 0x19, 0x7d,
+	    0x50, 0x86, 0xcb, 0x9b, 0x50, 0x72, 0x19, 0xee,
+	    0x95, 0xdb, 0x11, 0x3a, 0x91, 0x76, 0x78, 0xb2,
+	    0x73, 0xbe, 0xd6, 0xb8, 0xe3, 0xc1, 0x74, 0x3b,
+	    0x71, 0x16, 0xe6, 0x9e, 0x22, 0x22, 0x95, 0x16,
+	    0x3f, 0xf1, 0xca, 0xa1, 0x68, 0x1f, 0xac, 0x09,
+	    0x12, 0x0e, 0xca, 0x30, 0x75, 0x86, 0xe1, 0xa7 }, 64 },
+	{ "SP800-38A CBC-AES256", &aes_cbc_algorithm,
+	  { 0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe,
+	    0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d, 0x77, 0x81,
+	    0x1f, 0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7,
+	    0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4 }, 32,
+	  AES_TEST_SP800_38A_IV, AES_TEST_SP800_38A_PLAINTEXT,
+	  { 0xf5, 0x8c, 0x4c, 0x04, 0xd6, 0xe5, 0xf1, 0xba,
+	    0x77, 0x9e, 0xab, 0xfb, 0x5f, 0x7b, 0xfb, 0xd6,
+	    0x9c, 0xfc, 0x4e, 0x96, 0x7e, 0xdb, 0x80, 0x8d,
+	    0x67, 0x9f, 0x77, 0x7b, 0xc6, 0x70, 0x2c, 0x7d,
+	    0x39, 0xf2, 0x33, 0x69, 0xa9, 0xd9, 0xba, 0xcf,
+	    0xa5, 0x30, 0xe2, 0x63, 0x04, 0x23, 0x14, 0x61,
+	    0xb2, 0xeb, 0x05, 0xe2, 0xc3, 0x9b, 0xe9, 0xfc,
+	    0xda, 0x6c, 0x19, 0x07, 0x8c, 0x6a, 0x9d, 0x1b }, 64 },
+};
+
+/* The raw AES context is the first member of every AES-based context */
+static void aes_test_setkey ( struct aes_test_vector *vector, void *ctx,
+			      int generic ) {
+	cipher_setkey ( vector->cipher, ctx, vector->key, vector->keylen );
+	if ( generic )
+		aes_force_generic ( ctx );
+	cipher_setiv ( vector->cipher, ctx, vector->iv );
+}
+
+static int aes_test_run ( struct aes_test_vector *vector, int generic ) {
+	uint8_t ctx[vector->cipher->ctxsize];
+	uint8_t buf[sizeof ( vector->plaintext )];
+	int ok = 1;
+
+	/* Encrypt */
+	aes_test_setkey ( vector, ctx, generic );
+	cipher_encrypt ( vector->cipher, ctx, vector->plaintext, buf,
+			 vector->len );
+	if ( memcmp ( buf, vector->ciphertext, vector->len ) != 0 )
+		ok = 0;
+
+	/* Decrypt into separate buffer */
+	aes_test_setkey ( vector, ctx, generic );
+	cipher_decrypt ( vector->cipher, ctx, vector->ciphertext, buf,
+			 vector->len );
+	if ( memcmp ( buf, vector->plaintext, vector->len ) != 0 )
+		ok = 0;
+
+	/* Decrypt in place */
+	aes_test_setkey ( vector, ctx, generic );
+	memcpy ( buf, vector->ciphertext, vector->len );
+	cipher_decrypt ( vector->cipher, ctx, buf, buf, vector->len );
+	if ( memcmp ( buf, vector->plaintext, vector->len ) != 0 )
+		ok = 0;
+
+	return ok;
+}
+
+void aes_test ( void ) {
+	struct aes_test_vector *vector;
+	struct aes_context aes_ctx;
+	int fast;
+	int generic;
+	unsigned int i;
+
+	cipher_setkey ( &aes_algorithm, &aes_ctx, aes_test_vectors[0].key,
+			aes_test_vectors[0].keylen );
+	printf ( "AES using %s implementation\n",
+		 ( aes_ctx.accelerated ? "accelerated" : "generic" ) );
+
+	for ( i = 0 ; i < ( sizeof ( aes_test_vectors ) /
+			    sizeof ( aes_test_vectors[0] ) ) ; i++ ) {
+		vector = &aes_test_vectors[i];
+		fast = aes_test_run ( vector, 0 );
+		generic = aes_test_run ( vector, 1 );
+		printf ( "%s: %s/%s\n", vector->name,
+			 ( fast ? "ok" : "FAILED" ),
+			 ( generic ? "ok" : "FAILED" ) );
+	}
+}
@@ -0,0 +1,181 @@
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <gpxe/umalloc.h>
+#include <gpxe/ramdisk.h>
+#include <gpxe/blockcache.h>
+#include <gpxe/profile.h>
+
+/*
+ * Block cache trace replay
+ *
+ * Replays a synthetic INT 13 access trace against a RAM disk, first
+ * directly and then via a block cache, and reports the number of
+ * requests reaching the underlying device (each of which would be a
+ * network round trip for a SAN device).  The data returned via the
+ * cache is checked against the data returned directly.
+ *
+ */
+
+#define BLOCKCACHE_TEST_BLOCKS 8192
+
+#define BLOCKCACHE_TEST_BLKSIZE 512
+
+struct blockcache_test_access {
+	unsigned long block;
+	unsigned long count;
+	unsigned int repeat;
+	int write;
+};
+
+/** Synthetic trace modelled on a DOS-era loader followed by ntldr */
+static struct blockcache_test_access blockcache_test_trace[] = {
+	/* MBR, boot sector and FAT, re-read repeatedly */
+	{ 0, 1, 4, 0 },
+	{ 63, 1, 4, 0 },
+	{ 64, 8, 16, 0 },
+	/* Loader read a sector at a time */
+	{ 1024, 1, 512, 0 },
+	/* Directory lookups scattered across the disk */
+	{ 300, 1, 1, 0 },
+	{ 5000, 2, 1, 0 },
+	{ 300, 1, 1, 0 },
+	{ 7000, 1, 1, 0 },
+	/* Registry hive written back */
+	{ 1200, 4, 8, 1 },
+	/* Driver files read in 4kB chunks */
+	{ 2048, 8, 256, 0 },
+	/* FAT re-read after writes */
+	{ 64, 8, 4, 0 },
+	{ 1200, 4, 8, 0 },
+};
+
+struct blockcache_test_disk {
+	struct ramdisk ramdisk;
+	struct block_device blockdev;
+	unsigned long reads;
+	unsigned long writes;
+};
+
+static struct blockcache_test_disk blockcache_test_disk;
+
+static int blockcache_test_read ( struct block_device *blockdev,
+				  uint64_t block, unsigned long count,
+				  userptr_t buffer ) {
+	struct blockcache_test_disk *disk =
+		container_of ( blockdev, struct blockcache_test_disk,
+			       blockdev );
+
+	disk->reads++;
+	return disk->ramdisk.blockdev.op->read ( &disk->ramdisk.blockdev,
+						 block, count, buffer );
+}
+
+static int blockcache_test_write ( struct block_device *blockdev,
+				   uint64_t block, unsigned long count,
+				   userptr_t buffer ) {
+	struct blockcache_test_disk *disk =
+		container_of ( blockdev, struct blockcache_test_disk,
+			       blockdev );
+
+	disk->writes++;
+	return disk->ramdisk.blockdev.op->write ( &disk->ramdisk.blockdev,
+						  block, count, buffer );
+}
+
+static struct block_device_operations blockcache_test_operations = {
+	.read	= blockcache_test_read,
+	.write	= blockcache_test_write,
+};
+
+static int blockcache_test_replay ( struct block_device *blockdev,
+				    struct block_device *reference ) {
+	static uint8_t buf[ 8 * BLOCKCACHE_TEST_BLKSIZE ];
+	static uint8_t expected[ 8 * BLOCKCACHE_TEST_BLKSIZE ];
+	struct blockcache_test_access *access;
+	unsigned long block;
+	unsigned int i;
+	unsigned int j;
+	int errors = 0;
+
+	for ( i = 0 ; i < ( sizeof ( blockcache_test_trace ) /
+			    sizeof ( blockcache_test_trace[0] ) ) ; i++ ) {
+		access = &blockcache_test_trace[i];
+		for ( j = 0 ; j < access->repeat ; j++ ) {
+			block = ( access->block + ( j * access->count ) );
+			if ( access->write ) {
+				memset ( buf, ( block + i ), sizeof ( buf ) );
+				blockdev->op->write ( blockdev, block,
+						      access->count,
+						      virt_to_user ( buf ) );
+				continue;
+			}
+			blockdev->op->read ( blockdev, block, access->count,
+					     virt_to_user ( buf ) );
+			if ( ! reference )
+				continue;
+			reference->op->read ( reference, block, access->count,
+					      virt_to_user ( expected ) );
+			if ( memcmp ( buf, expected, ( access->count *
+						       BLOCKCACHE_TEST_BLKSIZE ))
+			     != 0 )
+				errors++;
+		}
+	}
+	return errors;
+}
+
+void blockcache_test ( void ) {
+	struct blockcache_test_disk *disk = &blockcache_test_disk;
+	struct block_cache cache;
+	union profiler profiler;
+	userptr_t data;
+	unsigned long ticks;
+	unsigned int i;
+	int errors;
+
+	data = umalloc ( BLOCKCACHE_TEST_BLOCKS * BLOCKCACHE_TEST_BLKSIZE );
+	if ( ! data ) {
+		printf ( "Could not allocate RAM disk\n" );
+		return;
+	}
+	for ( i = 0 ; i < BLOCKCACHE_TEST_BLOCKS ; i++ ) {
+		memset_user ( data, ( i * BLOCKCACHE_TEST_BLKSIZE ), i,
+			      BLOCKCACHE_TEST_BLKSIZE );
+	}
+	init_ramdisk ( &disk->ramdisk, data,
+		       ( BLOCKCACHE_TEST_BLOCKS * BLOCKCACHE_TEST_BLKSIZE ),
+		       BLOCKCACHE_TEST_BLKSIZE );
+	disk->blockdev.op = &blockcache_test_operations;
+	disk->blockdev.blksize = disk->ramdisk.blockdev.blksize;
+	disk->blockdev.blocks = disk->ramdisk.blockdev.blocks;
+
+	/* Replay trace without cache */
+	disk->reads = disk->writes = 0;
+	profile ( &profiler );
+	blockcache_test_replay ( &disk->blockdev, NULL );
+	ticks = profile ( &profiler );
+	printf ( "Uncached: %ld reads, %ld writes, %ld ticks\n",
+		 disk->reads, disk->writes, ticks );
+
+	/* Replay trace via cache */
+	init_block_cache ( &cache, &disk->blockdev );
+	disk->reads = disk->writes = 0;
+	profile ( &profiler );
+	blockcache_test_replay ( &cache.blockdev, NULL );
+	ticks = profile ( &profiler );
+	printf ( "Cached:   %ld reads, %ld writes, %ld ticks\n",
+		 disk->reads, disk->writes, ticks );
+	printf ( "Cache: %ld hits, %ld misses, %ld lines prefetched, "
+		 "%ld writes\n", cache.hits, cache.misses, cache.prefetched,
+		 cache.writes );
+
+	/* Replay again, checking data against the uncached device */
+	errors = blockcache_test_replay ( &cache.blockdev,
+					  &disk->ramdisk.blockdev );
+	printf ( "Data check: %s (%d mismatches)\n",
+		 ( errors ? "FAILED" : "ok" ), errors );
+
+	free_block_cache ( &cache );
+	ufree ( data );
+}
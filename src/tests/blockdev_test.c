@@ -0,0 +1,122 @@
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <gpxe/blockdev.h>
+
+/*
+ * Block device request queue tests
+ *
+ * Submits more requests than a device can hold outstanding, and
+ * checks that the excess requests wait in the queue (rather than
+ * failing) and are passed to the device in order as earlier requests
+ * complete.
+ *
+ */
+
+#define BLOCKDEV_TEST_DEPTH 4
+
+#define BLOCKDEV_TEST_COUNT 10
+
+struct blockdev_test_device {
+	struct block_device blockdev;
+	struct block_request *outstanding[BLOCKDEV_TEST_DEPTH];
+	unsigned int count;
+	unsigned int max_count;
+	unsigned int submitted;
+	int in_order;
+};
+
+static struct blockdev_test_device blockdev_test_device;
+
+static int blockdev_test_submit ( struct block_device *blockdev,
+				  struct block_request *request ) {
+	struct blockdev_test_device *dev =
+		container_of ( blockdev, struct blockdev_test_device,
+			       blockdev );
+
+	if ( dev->count == BLOCKDEV_TEST_DEPTH )
+		return BLOCKDEV_FULL;
+	if ( request->block != dev->submitted )
+		dev->in_order = 0;
+	dev->outstanding[dev->count++] = request;
+	if ( dev->count > dev->max_count )
+		dev->max_count = dev->count;
+	dev->submitted++;
+	return 0;
+}
+
+static struct block_device_operations blockdev_test_operations = {
+	.read	= block_sync_read,
+	.write	= block_sync_write,
+	.submit	= blockdev_test_submit,
+};
+
+static unsigned int blockdev_test_done_count;
+
+static void blockdev_test_done ( struct block_request *request __unused ) {
+	blockdev_test_done_count++;
+}
+
+/**
+ * Complete oldest outstanding request
+ *
+ * @v dev		Test device
+ */
+static void blockdev_test_complete ( struct blockdev_test_device *dev ) {
+	struct block_request *request = dev->outstanding[0];
+
+	memmove ( &dev->outstanding[0], &dev->outstanding[1],
+		  ( --dev->count * sizeof ( dev->outstanding[0] ) ) );
+	block_request_done ( request, 0 );
+}
+
+void blockdev_test ( void ) {
+	struct blockdev_test_device *dev = &blockdev_test_device;
+	struct block_request requests[BLOCKDEV_TEST_COUNT];
+	unsigned int waiting;
+	unsigned int failed;
+	unsigned int i;
+	int ok;
+
+	memset ( dev, 0, sizeof ( *dev ) );
+	dev->in_order = 1;
+	blockdev_init ( &dev->blockdev, &blockdev_test_operations );
+	blockdev_test_done_count = 0;
+
+	/* Fill device past its depth */
+	memset ( requests, 0, sizeof ( requests ) );
+	for ( i = 0 ; i < BLOCKDEV_TEST_COUNT ; i++ ) {
+		requests[i].block = i;
+		requests[i].count = 1;
+		requests[i].done = blockdev_test_done;
+		block_submit ( &dev->blockdev, &requests[i] );
+	}
+	waiting = failed = 0;
+	for ( i = 0 ; i < BLOCKDEV_TEST_COUNT ; i++ ) {
+		if ( block_request_in_progress ( &requests[i] ) ) {
+			waiting++;
+		} else {
+			failed++;
+		}
+	}
+	ok = ( ( dev->count == BLOCKDEV_TEST_DEPTH ) &&
+	       ( waiting == BLOCKDEV_TEST_COUNT ) && ( failed == 0 ) );
+	printf ( "Block queue fill: %d outstanding, %d waiting, %d failed: "
+		 "%s\n", dev->count, ( waiting - dev->count ), failed,
+		 ( ok ? "ok" : "FAILED" ) );
+
+	/* Drain device, refilling from the queue */
+	while ( dev->count )
+		blockdev_test_complete ( dev );
+	ok = ( ( blockdev_test_done_count == BLOCKDEV_TEST_COUNT ) &&
+	       ( dev->submitted == BLOCKDEV_TEST_COUNT ) &&
+	       ( dev->max_count == BLOCKDEV_TEST_DEPTH ) && dev->in_order &&
+	       list_empty ( &dev->blockdev.queue ) );
+	for ( i = 0 ; i < BLOCKDEV_TEST_COUNT ; i++ ) {
+		if ( requests[i].rc != 0 )
+			ok = 0;
+	}
+	printf ( "Block queue drain: %d of %d completed: %s\n",
+		 blockdev_test_done_count, BLOCKDEV_TEST_COUNT,
+		 ( ok ? "ok" : "FAILED" ) );
+}
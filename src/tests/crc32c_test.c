@@ -0,0 +1,87 @@
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <gpxe/crc32c.h>
+#include <gpxe/profile.h>
+
+/*
+ * CRC32C self-test and micro-benchmark
+ *
+ * Checks the accelerated and generic CRC32C implementations against
+ * the test vectors from RFC 3720 appendix B.4, then measures the cost
+ * of digesting a maximum-sized iSCSI data segment with each.
+ *
+ */
+
+#define CRC32C_TEST_LEN 8192
+
+#define CRC32C_TEST_ITERATIONS 64
+
+struct crc32c_test_vector {
+	const char *name;
+	uint8_t data[32];
+	size_t len;
+	uint32_t crc;
+};
+
+static struct crc32c_test_vector crc32c_test_vectors[] = {
+	{ "32 bytes of zeroes", { 0 }, 32, 0x8a9136aa },
+	{ "32 bytes of ones",
+	  { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff }, 32, 0x62a8ab43 },
+	{ "32 incrementing bytes",
+	  { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+	    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+	    0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+	    0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f }, 32, 0x46dd794e },
+	{ "32 decrementing bytes",
+	  { 0x1f, 0x1e, 0x1d, 0x1c, 0x1b, 0x1a, 0x19, 0x18,
+	    0x17, 0x16, 0x15, 0x14, 0x13, 0x12, 0x11, 0x10,
+	    0x0f, 0x0e, 0x0d, 0x0c, 0x0b, 0x0a, 0x09, 0x08,
+	    0x07, 0x06, 0x05, 0x04, 0x03, 0x02, 0x01, 0x00 }, 32, 0x113fdb5c },
+	{ "\"123456789\"", "123456789", 9, 0xe3069283 },
+};
+
+static uint8_t crc32c_test_buf[CRC32C_TEST_LEN];
+
+static unsigned long crc32c_test_cycle ( uint32_t ( * crc ) ( uint32_t seed,
+							   const void *data,
+							   size_t len ) ) {
+	union profiler profiler;
+	unsigned long total = 0;
+	unsigned int i;
+
+	for ( i = 0 ; i < CRC32C_TEST_ITERATIONS ; i++ ) {
+		profile ( &profiler );
+		crc ( 0xffffffffUL, crc32c_test_buf, sizeof ( crc32c_test_buf ) );
+		total += profile ( &profiler );
+	}
+	return ( total / CRC32C_TEST_ITERATIONS );
+}
+
+void crc32c_test ( void ) {
+	struct crc32c_test_vector *vector;
+	uint32_t fast;
+	uint32_t generic;
+	unsigned int i;
+
+	for ( i = 0 ; i < ( sizeof ( crc32c_test_vectors ) /
+			    sizeof ( crc32c_test_vectors[0] ) ) ; i++ ) {
+		vector = &crc32c_test_vectors[i];
+		fast = ~crc32c_le ( 0xffffffffUL, vector->data, vector->len );
+		generic = ~crc32c_le_generic ( 0xffffffffUL, vector->data,
+					       vector->len );
+		printf ( "CRC32C %s: %08x/%08x %s\n", vector->name, fast,
+			 generic, ( ( ( fast == vector->crc ) &&
+				      ( generic == vector->crc ) ) ?
+				    "ok" : "FAILED" ) );
+	}
+
+	for ( i = 0 ; i < sizeof ( crc32c_test_buf ) ; i++ )
+		crc32c_test_buf[i] = i;
+	printf ( "CRC32C %d bytes: %ld ticks (generic %ld ticks)\n",
+		 CRC32C_TEST_LEN, crc32c_test_cycle ( crc32c_le ),
+		 crc32c_test_cycle ( crc32c_le_generic ) );
+}
@@ -0,0 +1,177 @@
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <gpxe/crypto.h>
+#include <gpxe/aes.h>
+#include <gpxe/gcm.h>
+
+/*
+ * AES-GCM known-answer tests
+ *
+ * Checks test cases 1-4 and 16 from the GCM specification (as used
+ * by NIST's GCM validation) against both the accelerated (if present)
+ * and generic GHASH implementations.  Data is encrypted in fragments
+ * which do not align with the block size, and decrypted in place.
+ *
+ */
+
+struct gcm_test_vector {
+	const char *name;
+	uint8_t key[32];
+	size_t keylen;
+	uint8_t iv[GCM_IV_LEN];
+	uint8_t additional[20];
+	size_t additional_len;
+	uint8_t plaintext[64];
+	uint8_t ciphertext[64];
+	size_t len;
+	uint8_t tag[GCM_AUTH_LEN];
+};
+
+#define GCM_TEST_KEY							\
+	0xfe, 0xff, 0xe9, 0x92, 0x86, 0x65, 0x73, 0x1c,			\
+	0x6d, 0x6a, 0x8f, 0x94, 0x67, 0x30, 0x83, 0x08
+
+#define GCM_TEST_IV							\
+	{ 0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce, 0xdb, 0xad,		\
+	  0xde, 0xca, 0xf8, 0x88 }
+
+#define GCM_TEST_ADDITIONAL						\
+	{ 0xfe, 0xed, 0xfa, 0xce, 0xde, 0xad, 0xbe, 0xef,		\
+	  0xfe, 0xed, 0xfa, 0xce, 0xde, 0xad, 0xbe, 0xef,		\
+	  0xab, 0xad, 0xda, 0xd2 }, 20
+
+#define GCM_TEST_PLAINTEXT						\
+	{ 0xd9, 0x31, 0x32, 0x25, 0xf8, 0x84, 0x06, 0xe5,		\
+	  0xa5, 0x59, 0x09, 0xc5, 0xaf, 0xf5, 0x26, 0x9a,		\
+	  0x86, 0xa7, 0xa9, 0x53, 0x15, 0x34, 0xf7, 0xda,		\
+	  0x2e, 0x4c, 0x30, 0x3d, 0x8a, 0x31, 0x8a, 0x72,		\
+	  0x1c, 0x3c, 0x0c, 0x95, 0x95, 0x68, 0x09, 0x53,		\
+	  0x2f, 0xcf, 0x0e, 0x24, 0x49, 0xa6, 0xb5, 0x25,		\
+	  0xb1, 0x6a, 0xed, 0xf5, 0xaa, 0x0d, 0xe6, 0x57,		\
+	  0xba, 0x63, 0x7b, 0x39, 0x1a, 0xaf, 0xd2, 0x55 }
+
+static struct gcm_test_vector gcm_test_vectors[] = {
+	{ "GCM test case 1", { 0 }, 16, { 0 }, { 0 }, 0, { 0 }, { 0 }, 0,
+	  { 0x58, 0xe2, 0xfc, 0xce, 0xfa, 0x7e, 0x30, 0x61,
+	    0x36, 0x7f, 0x1d, 0x57, 0xa4, 0xe7, 0x45, 0x5a } },
+	{ "GCM test case 2", { 0 }, 16, { 0 }, { 0 }, 0, { 0 },
+	  { 0x03, 0x88, 0xda, 0xce, 0x60, 0xb6, 0xa3, 0x92,
+	    0xf3, 0x28, 0xc2, 0xb9, 0x71, 0xb2, 0xfe, 0x78 }, 16,
+	  { 0xab, 0x6e, 0x47, 0xd4, 0x2c, 0xec, 0x13, 0xbd,
+	    0xf5, 0x3a, 0x67, 0xb2, 0x12, 0x57, 0xbd, 0xdf } },
+	{ "GCM test case 3", { GCM_TEST_KEY }, 16, GCM_TEST_IV, { 0 }, 0,
+	  GCM_TEST_PLAINTEXT,
+	  { 0x42, 0x83, 0x1e, 0xc2, 0x21, 0x77, 0x74, 0x24,
+	    0x4b, 0x72, 0x21, 0xb7, 0x84, 0xd0, 0xd4, 0x9c,
+	    0xe3, 0xaa, 0x21, 0x2f, 0x2c, 0x02, 0xa4, 0xe0,
+	    0x35, 0xc1, 0x7e, 0x23, 0x29, 0xac, 0xa1, 0x2e,
+	    0x21, 0xd5, 0x14, 0xb2, 0x54, 0x66, 0x93, 0x1c,
+	    0x7d, 0x8f, 0x6a, 0x5a, 0xac, 0x84, 0xaa, 0x05,
+	    0x1b, 0xa3, 0x0b, 0x39, 0x6a, 0x0a, 0xac, 0x97,
+	    0x3d, 0x58, 0xe0, 0x91, 0x47, 0x3f, 0x59, 0x85 }, 64,
+	  { 0x4d, 0x5c, 0x2a, 0xf3, 0x27, 0xcd, 0x64, 0xa6,
+	    0x2c, 0xf3, 0x5a, 0xbd, 0x2b, 0xa6, 0xfa, 0xb4 } },
+	{ "GCM test case 4", { GCM_TEST_KEY }, 16, GCM_TEST_IV,
+	  GCM_TEST_ADDITIONAL, GCM_TEST_PLAINTEXT,
+	  { 0x42, 0x83, 0x1e, 0xc2, 0x21, 0x77, 0x74, 0x24,
+	    0x4b, 0x72, 0x21, 0xb7, 0x84, 0xd0, 0xd4, 0x9c,
+	    0xe3, 0xaa, 0x21, 0x2f, 0x2c, 0x02, 0xa4, 0xe0,
+	    0x35, 0xc1, 0x7e, 0x23, 0x29, 0xac, 0xa1, 0x2e,
+	    0x21, 0xd5, 0x14, 0xb2, 0x54, 0x66, 0x93, 0x1c,
+	    0x7d, 0x8f, 0x6a, 0x5a, 0xac, 0x84, 0xaa, 0x05,
+	    0x1b, 0xa3, 0x0b, 0x39, 0x6a, 0x0a, 0xac, 0x97,
+	    0x3d, 0x58, 0xe0, 0x91 }, 60,
+	  { 0x5b, 0xc9, 0x4f, 0xbc, 0x32, 0x21, 0xa5, 0xdb,
+	    0x94, 0xfa, 0xe9, 0x5a, 0xe7, 0x12, 0x1a, 0x47 } },
+	{ "GCM test case 16", { GCM_TEST_KEY, GCM_TEST_KEY }, 32, GCM_TEST_IV,
+	  GCM_TEST_ADDITIONAL, GCM_TEST_PLAINTEXT,
+	  { 0x52, 0x2d, 0xc1, 0xf0, 0x99, 0x56, 0x7d, 0x07,
+	    0xf4, 0x7f, 0x37, 0xa3, 0x2a, 0x84, 0x42, 0x7d,
+	    0x64, 0x3a, 0x8c, 0xdc, 0xbf, 0xe5, 0xc0, 0xc9,
+	    0x75, 0x98, 0xa2, 0xbd, 0x25, 0x55, 0xd1, 0xaa,
+	    0x8c, 0xb0, 0x8e, 0x48, 0x59, 0x0d, 0xbb, 0x3d,
+	    0xa7, 0xb0, 0x8b, 0x10, 0x56, 0x82, 0x88, 0x38,
+	    0xc5, 0xf6, 0x1e, 0x63, 0x93, 0xba, 0x7a, 0x0a,
+	    0xbc, 0xc9, 0xf6, 0x62 }, 60,
+	  { 0x76, 0xfc, 0x6e, 0xce, 0x0f, 0x4e, 0x17, 0x68,
+	    0xcd, 0xdf, 0x88, 0x53, 0xbb, 0x2d, 0x55, 0x1b } },
+};
+
+/* Lengths of the leading fragments used when encrypting */
+static size_t gcm_test_frags[] = { 1, 17, 3 };
+
+static void gcm_test_setkey ( struct gcm_test_vector *vector, void *ctx,
+			      int generic ) {
+	struct cipher_algorithm *cipher = &aes_gcm_algorithm;
+	size_t add_len = vector->additional_len;
+
+	cipher_setkey ( cipher, ctx, vector->key, vector->keylen );
+	if ( generic )
+		gcm_force_generic ( ctx );
+	cipher_setiv ( cipher, ctx, vector->iv );
+	if ( add_len ) {
+		cipher_encrypt ( cipher, ctx, vector->additional, NULL, 1 );
+		cipher_encrypt ( cipher, ctx, &vector->additional[1], NULL,
+				 ( add_len - 1 ) );
+	}
+}
+
+static int gcm_test_run ( struct gcm_test_vector *vector, int generic ) {
+	struct cipher_algorithm *cipher = &aes_gcm_algorithm;
+	uint8_t ctx[cipher->ctxsize];
+	uint8_t buf[sizeof ( vector->plaintext )];
+	uint8_t tag[GCM_AUTH_LEN];
+	size_t offset = 0;
+	size_t frag_len;
+	unsigned int i;
+	int ok = 1;
+
+	/* Encrypt in fragments */
+	gcm_test_setkey ( vector, ctx, generic );
+	for ( i = 0 ; offset < vector->len ; i++ ) {
+		frag_len = ( vector->len - offset );
+		if ( ( i < ( sizeof ( gcm_test_frags ) /
+			     sizeof ( gcm_test_frags[0] ) ) ) &&
+		     ( frag_len > gcm_test_frags[i] ) )
+			frag_len = gcm_test_frags[i];
+		cipher_encrypt ( cipher, ctx, &vector->plaintext[offset],
+				 &buf[offset], frag_len );
+		offset += frag_len;
+	}
+	cipher_auth ( cipher, ctx, tag );
+	if ( ( memcmp ( buf, vector->ciphertext, vector->len ) != 0 ) ||
+	     ( memcmp ( tag, vector->tag, sizeof ( tag ) ) != 0 ) )
+		ok = 0;
+
+	/* Decrypt in place */
+	gcm_test_setkey ( vector, ctx, generic );
+	memcpy ( buf, vector->ciphertext, vector->len );
+	cipher_decrypt ( cipher, ctx, buf, buf, vector->len );
+	cipher_auth ( cipher, ctx, tag );
+	if ( ( memcmp ( buf, vector->plaintext, vector->len ) != 0 ) ||
+	     ( memcmp ( tag, vector->tag, sizeof ( tag ) ) != 0 ) )
+		ok = 0;
+
+	return ok;
+}
+
+void gcm_test ( void ) {
+	struct gcm_test_vector *vector;
+	int fast;
+	int generic;
+	unsigned int i;
+
+	printf ( "GHASH using %s implementation\n",
+		 ( gcm_arch_supported() ? "accelerated" : "generic" ) );
+
+	for ( i = 0 ; i < ( sizeof ( gcm_test_vectors ) /
+			    sizeof ( gcm_test_vectors[0] ) ) ; i++ ) {
+		vector = &gcm_test_vectors[i];
+		fast = gcm_test_run ( vector, 0 );
+		generic = gcm_test_run ( vector, 1 );
+		printf ( "%s: %s/%s\n", vector->name,
+			 ( fast ? "ok" : "FAILED" ),
+			 ( generic ? "ok" : "FAILED" ) );
+	}
+}
@@ -0,0 +1,200 @@
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <gpxe/iobuf.h>
+#include <gpxe/infiniband.h>
+#include <gpxe/profile.h>
+
+/*
+ * Software loopback Infiniband device benchmark
+ *
+ * Opens both ports of the loopback HCA, waits for the emulated subnet
+ * manager to bring them up, and then measures the cost of passing
+ * datagrams from a UD queue pair on one port to a UD queue pair on
+ * the other at several send queue depths.  Received data is checked
+ * against the data sent.
+ *
+ */
+
+#define IBLOOP_TEST_COUNT 1024
+
+#define IBLOOP_TEST_LEN 1024
+
+#define IBLOOP_TEST_NUM_WQES 32
+
+#define IBLOOP_TEST_NUM_CQES 64
+
+#define IBLOOP_TEST_QKEY 0x1b1bUL
+
+#define IBLOOP_TEST_MAX_POLLS 1000000
+
+static unsigned int ibloop_test_depths[] = { 1, 4, 16, 32 };
+
+static unsigned long ibloop_test_sent;
+static unsigned long ibloop_test_completed;
+static unsigned long ibloop_test_received;
+static unsigned long ibloop_test_errors;
+
+static void ibloop_test_complete_send ( struct ib_device *ibdev __unused,
+					struct ib_queue_pair *qp __unused,
+					struct io_buffer *iobuf, int rc ) {
+	if ( rc != 0 )
+		ibloop_test_errors++;
+	ibloop_test_completed++;
+	free_iob ( iobuf );
+}
+
+static void ibloop_test_complete_recv ( struct ib_device *ibdev __unused,
+					struct ib_queue_pair *qp __unused,
+					struct ib_address_vector *av __unused,
+					struct io_buffer *iobuf, int rc ) {
+	uint8_t *data = iobuf->data;
+	unsigned int i;
+
+	if ( ( rc != 0 ) || ( iob_len ( iobuf ) != IBLOOP_TEST_LEN ) ) {
+		ibloop_test_errors++;
+	} else {
+		for ( i = 0 ; i < IBLOOP_TEST_LEN ; i++ ) {
+			if ( data[i] != ( uint8_t ) ( i + data[0] ) ) {
+				ibloop_test_errors++;
+				break;
+			}
+		}
+	}
+	ibloop_test_received++;
+	free_iob ( iobuf );
+}
+
+static struct ib_completion_queue_operations ibloop_test_cq_op = {
+	.complete_send = ibloop_test_complete_send,
+	.complete_recv = ibloop_test_complete_recv,
+};
+
+static void ibloop_test_poll ( struct ib_device **ibdev ) {
+	ib_poll_eq ( ibdev[0] );
+	ib_poll_eq ( ibdev[1] );
+}
+
+static unsigned long ibloop_test_run ( struct ib_device **ibdev,
+				       struct ib_queue_pair **qp,
+				       unsigned int depth ) {
+	struct ib_address_vector av;
+	struct io_buffer *iobuf;
+	union profiler profiler;
+	unsigned long polls = 0;
+	unsigned int i;
+
+	memset ( &av, 0, sizeof ( av ) );
+	av.lid = ibdev[1]->lid;
+	av.qpn = qp[1]->qpn;
+	av.qkey = IBLOOP_TEST_QKEY;
+
+	ibloop_test_sent = ibloop_test_completed = ibloop_test_received = 0;
+	profile ( &profiler );
+	while ( ( ibloop_test_completed < IBLOOP_TEST_COUNT ) &&
+		( polls++ < IBLOOP_TEST_MAX_POLLS ) ) {
+		while ( ( ibloop_test_sent < IBLOOP_TEST_COUNT ) &&
+			( ( ibloop_test_sent - ibloop_test_completed ) <
+			  depth ) ) {
+			iobuf = alloc_iob ( IBLOOP_TEST_LEN );
+			if ( ! iobuf )
+				break;
+			for ( i = 0 ; i < IBLOOP_TEST_LEN ; i++ ) {
+				*( ( uint8_t * ) iob_put ( iobuf, 1 ) ) =
+					( i + ibloop_test_sent );
+			}
+			if ( ib_post_send ( ibdev[0], qp[0], &av,
+					    iobuf ) != 0 ) {
+				free_iob ( iobuf );
+				break;
+			}
+			ibloop_test_sent++;
+		}
+		ibloop_test_poll ( ibdev );
+	}
+	ibloop_test_poll ( ibdev );
+	return ( profile ( &profiler ) / IBLOOP_TEST_COUNT );
+}
+
+void ibloop_test ( void ) {
+	struct ib_device *ibdev[2];
+	struct ib_device *tmp;
+	struct ib_completion_queue *cq[2];
+	struct ib_queue_pair *qp[2];
+	unsigned long ticks;
+	unsigned long polls;
+	unsigned int found = 0;
+	unsigned int i;
+	int rc;
+
+	for_each_ibdev ( tmp ) {
+		if ( ( found < 2 ) &&
+		     ( strcmp ( tmp->dev->name, "ibloop" ) == 0 ) )
+			ibdev[found++] = tmp;
+	}
+	if ( found != 2 ) {
+		printf ( "Loopback Infiniband device not present\n" );
+		return;
+	}
+
+	/* Bring up both ports */
+	for ( i = 0 ; i < 2 ; i++ ) {
+		if ( ( rc = ib_open ( ibdev[i] ) ) != 0 ) {
+			printf ( "Could not open port %d: %s\n",
+				 ibdev[i]->port, strerror ( rc ) );
+			goto err_open;
+		}
+	}
+	for ( polls = 0 ; polls < IBLOOP_TEST_MAX_POLLS ; polls++ ) {
+		if ( ib_link_ok ( ibdev[0] ) && ib_link_ok ( ibdev[1] ) )
+			break;
+		ibloop_test_poll ( ibdev );
+	}
+	printf ( "Port 1 LID %04x, port 2 LID %04x, SM LID %04x: %s\n",
+		 ibdev[0]->lid, ibdev[1]->lid, ibdev[0]->sm_lid,
+		 ( ( ib_link_ok ( ibdev[0] ) && ib_link_ok ( ibdev[1] ) ) ?
+		   "ok" : "FAILED" ) );
+
+	/* Create queues */
+	for ( i = 0 ; i < 2 ; i++ ) {
+		cq[i] = ib_create_cq ( ibdev[i], IBLOOP_TEST_NUM_CQES,
+				       &ibloop_test_cq_op );
+		if ( ! cq[i] ) {
+			printf ( "Could not create completion queue\n" );
+			goto err_create;
+		}
+		qp[i] = ib_create_qp ( ibdev[i], IB_QPT_UD,
+				       IBLOOP_TEST_NUM_WQES, cq[i],
+				       IBLOOP_TEST_NUM_WQES, cq[i] );
+		if ( ! qp[i] ) {
+			printf ( "Could not create queue pair\n" );
+			ib_destroy_cq ( ibdev[i], cq[i] );
+			goto err_create;
+		}
+		qp[i]->qkey = IBLOOP_TEST_QKEY;
+		ib_modify_qp ( ibdev[i], qp[i] );
+		ib_refill_recv ( ibdev[i], qp[i] );
+	}
+
+	/* Measure transfers at each queue depth */
+	for ( i = 0 ; i < ( sizeof ( ibloop_test_depths ) /
+			    sizeof ( ibloop_test_depths[0] ) ) ; i++ ) {
+		ibloop_test_errors = 0;
+		ticks = ibloop_test_run ( ibdev, qp, ibloop_test_depths[i] );
+		printf ( "Depth %2d: %ld ticks per %d-byte datagram, %ld/%ld "
+			 "received, %ld errors\n", ibloop_test_depths[i],
+			 ticks, IBLOOP_TEST_LEN, ibloop_test_received,
+			 ibloop_test_sent, ibloop_test_errors );
+	}
+
+	i = 2;
+ err_create:
+	while ( i-- ) {
+		ib_destroy_qp ( ibdev[i], qp[i] );
+		ib_destroy_cq ( ibdev[i], cq[i] );
+	}
+	i = 2;
+ err_open:
+	while ( i-- )
+		ib_close ( ibdev[i] );
+}
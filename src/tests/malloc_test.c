@@ -0,0 +1,72 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <gpxe/malloc.h>
+#include <gpxe/iobuf.h>
+#include <gpxe/if_ether.h>
+#include <gpxe/profile.h>
+
+/*
+ * Allocation cost micro-benchmark
+ *
+ * Measures the cost of an MTU-sized I/O buffer allocate/free cycle
+ * against a fragmented heap, first with the size-class caches in use
+ * and then with the caches flushed after every free (which forces
+ * every allocation to walk the free block list).
+ *
+ */
+
+#define MALLOC_TEST_ITERATIONS 1024
+
+#define MALLOC_TEST_FRAGMENTS 64
+
+static unsigned long malloc_test_cycle ( int flush ) {
+	union profiler profiler;
+	struct io_buffer *iobuf;
+	unsigned long total = 0;
+	unsigned int i;
+
+	for ( i = 0 ; i < MALLOC_TEST_ITERATIONS ; i++ ) {
+		profile ( &profiler );
+		iobuf = alloc_iob ( ETH_FRAME_LEN );
+		free_iob ( iobuf );
+		total += profile ( &profiler );
+		if ( flush )
+			mcache_flush();
+	}
+	return ( total / MALLOC_TEST_ITERATIONS );
+}
+
+void malloc_test ( void ) {
+	void *fragments[MALLOC_TEST_FRAGMENTS];
+	struct heap_statistics stats;
+	struct memcache *cache;
+	unsigned int i;
+
+	/* Fragment the heap by freeing every other small allocation */
+	for ( i = 0 ; i < MALLOC_TEST_FRAGMENTS ; i++ )
+		fragments[i] = malloc ( 1200 );
+	for ( i = 0 ; i < MALLOC_TEST_FRAGMENTS ; i += 2 ) {
+		free ( fragments[i] );
+		fragments[i] = NULL;
+	}
+	mcache_flush();
+
+	printf ( "Uncached alloc/free: %lu ticks\n", malloc_test_cycle ( 1 ) );
+	printf ( "Cached alloc/free:   %lu ticks\n", malloc_test_cycle ( 0 ) );
+
+	for ( i = 0 ; i < MALLOC_TEST_FRAGMENTS ; i++ )
+		free ( fragments[i] );
+
+	mstats ( &stats );
+	printf ( "Heap: %zu free in %u blocks (largest %zu), %lu allocs, "
+		 "%lu failures\n", stats.free, stats.blocks, stats.largest,
+		 stats.allocs, stats.failures );
+	for ( i = 0 ; i < NUM_MEMCACHES ; i++ ) {
+		cache = &memcaches[i];
+		printf ( "Cache %zu/%zu: %lu allocs, %lu hits, %lu frees, "
+			 "%u cached\n", cache->size, cache->align,
+			 cache->allocs, cache->hits, cache->frees,
+			 cache->count );
+	}
+}
@@ -0,0 +1,583 @@
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <byteswap.h>
+#include <gpxe/io.h>
+#include <gpxe/iobuf.h>
+#include <gpxe/malloc.h>
+#include <gpxe/netdevice.h>
+#include <gpxe/ethernet.h>
+#include <gpxe/if_ether.h>
+#include <gpxe/pci.h>
+#include <gpxe/timer.h>
+
+/*
+ * Myri10ge driver test against a mock MCP firmware model
+ *
+ * The driver is built into this file with its PCI configuration
+ * space accesses, delays and memory barriers redirected to a software
+ * model of the NIC.  The model provides the firmware command
+ * interface and the send, receive and interrupt queues in emulated
+ * NIC SRAM, and loops every transmitted frame back to the receive
+ * side.  Since gPXE is single-threaded, the model runs whenever the
+ * driver waits for the NIC or issues a memory barrier, which is
+ * whenever real firmware could observe the driver's writes.
+ *
+ * The test checks that ring depths follow the firmware-reported ring
+ * sizes, that receive buffers are always posted in whole groups, that
+ * a full transmit ring and receive overruns are counted, and that
+ * every frame arrives intact.
+ *
+ */
+
+/* Redirect the driver's hardware accesses to the model */
+
+static void myri10ge_mock_run ( void );
+
+static int myri10ge_mock_read_config_byte ( struct pci_device *pci,
+					    unsigned int where,
+					    uint8_t *value );
+static int myri10ge_mock_read_config_word ( struct pci_device *pci,
+					    unsigned int where,
+					    uint16_t *value );
+static int myri10ge_mock_read_config_dword ( struct pci_device *pci,
+					     unsigned int where,
+					     uint32_t *value );
+static int myri10ge_mock_write_config_byte ( struct pci_device *pci,
+					     unsigned int where,
+					     uint8_t value );
+static int myri10ge_mock_write_config_word ( struct pci_device *pci,
+					     unsigned int where,
+					     uint16_t value );
+static int myri10ge_mock_write_config_dword ( struct pci_device *pci,
+					      unsigned int where,
+					      uint32_t value );
+
+#undef mb
+#define mb() myri10ge_mock_run()
+#define udelay( usecs ) myri10ge_mock_run()
+#define pci_read_config_byte myri10ge_mock_read_config_byte
+#define pci_read_config_word myri10ge_mock_read_config_word
+#define pci_read_config_dword myri10ge_mock_read_config_dword
+#define pci_write_config_byte myri10ge_mock_write_config_byte
+#define pci_write_config_word myri10ge_mock_write_config_word
+#define pci_write_config_dword myri10ge_mock_write_config_dword
+
+/* Keep the test copy of the driver out of the PCI driver table */
+#undef __pci_driver
+#define __pci_driver
+#define myri10ge_driver myri10ge_test_driver
+
+#include "drivers/net/myri10ge.c"
+
+#undef mb
+#undef udelay
+
+/* Largest rings the model can report */
+#define MYRI10GE_MOCK_MAX_SEND 128
+#define MYRI10GE_MOCK_MAX_RECV 512
+
+/* Value of an unwritten doorbell or an invalid receive descriptor */
+#define MYRI10GE_MOCK_EMPTY 0xffffffffUL
+
+/* Emulated NIC SRAM */
+struct myri10ge_mock_sram {
+	mcp_cmd_t command;
+	uint32 irq_claim[2];
+	uint32 irq_deassert;
+	uint32 intr_coal_delay;
+	mcp_kreq_ether_send_t send[MYRI10GE_MOCK_MAX_SEND];
+	mcp_kreq_ether_recv_t recv[MYRI10GE_MOCK_MAX_RECV];
+};
+
+/* Mock MCP firmware state */
+struct myri10ge_mock {
+	struct myri10ge_mock_sram sram;
+	struct pci_device pci;
+	uint16_t pci_command;
+
+	/* Ring sizes reported to the driver, in entries */
+	unsigned int send_slots;
+	unsigned int recv_slots;
+	/* Command to fail, or MXGEFW_CMD_NONE */
+	unsigned int fail_cmd;
+
+	/* Host memory given to us by the driver */
+	mcp_slot_t *intrq;
+	unsigned int intrq_slots;
+	mcp_irq_data_t *irq_data;
+
+	int up;
+	int masked;
+	unsigned int pending;
+	unsigned int send_idx;
+	unsigned int send_done;
+	unsigned int recv_idx;
+	unsigned int intrq_idx;
+	uint32 buffers[MYRI10GE_MOCK_MAX_RECV];
+	unsigned int buffers_prod;
+	unsigned int buffers_cons;
+	unsigned int dropped;
+
+	/* Driver misbehaviour seen by the model */
+	unsigned int partial_groups;
+	unsigned int intrq_overruns;
+	unsigned int bad_sends;
+	unsigned int unknown_cmds;
+};
+
+static struct myri10ge_mock myri10ge_mock;
+
+static int myri10ge_mock_read_config_byte ( struct pci_device *pci __unused,
+					    unsigned int where __unused,
+					    uint8_t *value ) {
+	*value = 0xff;
+	return 0;
+}
+
+static int myri10ge_mock_read_config_word ( struct pci_device *pci __unused,
+					    unsigned int where,
+					    uint16_t *value ) {
+	*value = ( ( where == PCI_COMMAND ) ?
+		   myri10ge_mock.pci_command : 0xffff );
+	return 0;
+}
+
+static int myri10ge_mock_read_config_dword ( struct pci_device *pci __unused,
+					     unsigned int where __unused,
+					     uint32_t *value ) {
+	*value = 0xffffffffUL;
+	return 0;
+}
+
+static int myri10ge_mock_write_config_byte ( struct pci_device *pci __unused,
+					     unsigned int where __unused,
+					     uint8_t value __unused ) {
+	return 0;
+}
+
+static int myri10ge_mock_write_config_word ( struct pci_device *pci __unused,
+					     unsigned int where,
+					     uint16_t value ) {
+	if ( where == PCI_COMMAND )
+		myri10ge_mock.pci_command = value;
+	return 0;
+}
+
+static int myri10ge_mock_write_config_dword ( struct pci_device *pci __unused,
+					      unsigned int where __unused,
+					      uint32_t value __unused ) {
+	return 0;
+}
+
+static uint32 myri10ge_mock_offset ( void *sram ) {
+	return ( virt_to_phys ( sram ) - myri10ge_mock.pci.membase );
+}
+
+static void myri10ge_mock_reset ( void ) {
+	struct myri10ge_mock *mock = &myri10ge_mock;
+	unsigned int i;
+
+	mock->up = 0;
+	mock->masked = 0;
+	mock->pending = 0;
+	mock->send_idx = 0;
+	mock->send_done = 0;
+	mock->recv_idx = 0;
+	mock->intrq_idx = 0;
+	mock->buffers_prod = 0;
+	mock->buffers_cons = 0;
+	mock->dropped = 0;
+	mock->irq_data = NULL;
+	mock->intrq = NULL;
+	mock->intrq_slots = 0;
+	for ( i = 0 ; i < MYRI10GE_MOCK_MAX_SEND ; i++ )
+		( ( uint32 * ) &mock->sram.send[i] )[3] = 0;
+	for ( i = 0 ; i < MYRI10GE_MOCK_MAX_RECV ; i++ )
+		mock->sram.recv[i].addr_low = MYRI10GE_MOCK_EMPTY;
+	mock->sram.irq_claim[0] = MYRI10GE_MOCK_EMPTY;
+	mock->sram.irq_claim[1] = MYRI10GE_MOCK_EMPTY;
+	mock->sram.irq_deassert = MYRI10GE_MOCK_EMPTY;
+}
+
+static void myri10ge_mock_init ( unsigned int send_slots,
+				 unsigned int recv_slots ) {
+	struct myri10ge_mock *mock = &myri10ge_mock;
+
+	memset ( mock, 0, sizeof ( *mock ) );
+	mock->send_slots = send_slots;
+	mock->recv_slots = recv_slots;
+	mock->fail_cmd = MXGEFW_CMD_NONE;
+	mock->pci.membase = ( virt_to_phys ( &mock->sram.command ) -
+			      MXGEFW_ETH_CMD );
+	myri10ge_mock_reset();
+}
+
+/* Raise an interrupt, unless one is already outstanding */
+static void myri10ge_mock_interrupt ( unsigned int valid, int stats ) {
+	struct myri10ge_mock *mock = &myri10ge_mock;
+	mcp_irq_data_t *irq_data = mock->irq_data;
+
+	if ( ! irq_data )
+		return;
+	if ( stats ) {
+		irq_data->link_up = htonl ( mock->up ? MXGEFW_LINK_UP :
+					    MXGEFW_LINK_DOWN );
+		irq_data->dropped_no_small_buffer = htonl ( mock->dropped );
+	}
+	irq_data->send_done_count = htonl ( mock->send_done );
+	if ( mock->masked ) {
+		mock->pending |= ( valid | ( stats ? 0x100 : 0 ) );
+		return;
+	}
+	if ( ! irq_data->valid )
+		irq_data->stats_updated = 0;
+	if ( stats )
+		irq_data->stats_updated = 1;
+	irq_data->valid |= valid;
+}
+
+static void myri10ge_mock_command ( void ) {
+	struct myri10ge_mock *mock = &myri10ge_mock;
+	mcp_cmd_t *command = &mock->sram.command;
+	mcp_cmd_response_t *response;
+	uint32 cmd = ntohl ( command->cmd );
+	uint32 data0 = ntohl ( command->data0 );
+	uint32 result = MXGEFW_CMD_OK;
+	uint32 value = 0;
+
+	response = phys_to_virt ( ntohl ( command->response_addr.low ) );
+	command->response_addr.low = 0;
+
+	switch ( cmd ) {
+	case MXGEFW_CMD_RESET:
+		myri10ge_mock_reset();
+		break;
+	case MXGEFW_CMD_SET_INTRQ_SIZE:
+		mock->intrq_slots =
+			( ( data0 &
+			    ~MXGEFW_CMD_SET_INTRQ_SIZE_FLAG_NO_STRICT_SIZE_CHECK )
+			  / sizeof ( mcp_slot_t ) );
+		break;
+	case MXGEFW_CMD_SET_INTRQ_DMA:
+		mock->intrq = phys_to_virt ( data0 );
+		break;
+	case MXGEFW_CMD_GET_IRQ_ACK_OFFSET:
+		value = myri10ge_mock_offset ( mock->sram.irq_claim );
+		break;
+	case MXGEFW_CMD_GET_IRQ_DEASSERT_OFFSET:
+		value = myri10ge_mock_offset ( &mock->sram.irq_deassert );
+		break;
+	case MXGEFW_CMD_GET_INTR_COAL_DELAY_OFFSET:
+		value = myri10ge_mock_offset ( &mock->sram.intr_coal_delay );
+		break;
+	case MXGEFW_CMD_GET_SEND_RING_SIZE:
+		value = ( mock->send_slots * sizeof ( mcp_kreq_ether_send_t ) );
+		break;
+	case MXGEFW_CMD_GET_RX_RING_SIZE:
+		value = ( mock->recv_slots * sizeof ( mcp_dma_addr_t ) );
+		break;
+	case MXGEFW_CMD_GET_SEND_OFFSET:
+		value = myri10ge_mock_offset ( mock->sram.send );
+		break;
+	case MXGEFW_CMD_GET_SMALL_RX_OFFSET:
+		value = myri10ge_mock_offset ( mock->sram.recv );
+		break;
+	case MXGEFW_CMD_SET_STATS_DMA_V2:
+		mock->irq_data = phys_to_virt ( data0 );
+		break;
+	case MXGEFW_CMD_ETHERNET_UP:
+		mock->up = 1;
+		break;
+	case MXGEFW_SET_MAC_ADDRESS:
+	case MXGEFW_ENABLE_ALLMULTI:
+	case MXGEFW_DISABLE_FLOW_CONTROL:
+	case MXGEFW_CMD_SET_MTU:
+	case MXGEFW_CMD_SET_SMALL_BUFFER_SIZE:
+	case MXGEFW_CMD_SET_BIG_BUFFER_SIZE:
+		break;
+	default:
+		mock->unknown_cmds++;
+		result = MXGEFW_CMD_UNKNOWN;
+		break;
+	}
+	if ( cmd == mock->fail_cmd ) {
+		mock->up = 0;
+		result = MXGEFW_CMD_ERROR_BUSY;
+	}
+
+	response->data = htonl ( value );
+	response->result = htonl ( result );
+
+	if ( ( cmd == MXGEFW_CMD_ETHERNET_UP ) && mock->up )
+		myri10ge_mock_interrupt ( 1, 1 );
+}
+
+/* Take any whole groups of receive buffers posted by the driver */
+static void myri10ge_mock_fetch_receives ( void ) {
+	struct myri10ge_mock *mock = &myri10ge_mock;
+	mcp_kreq_ether_recv_t *group;
+	unsigned int i;
+
+	while ( 1 ) {
+		group = &mock->sram.recv[ mock->recv_idx &
+					  ( mock->recv_slots - 1 ) ];
+		if ( group[0].addr_low == MYRI10GE_MOCK_EMPTY )
+			return;
+		for ( i = 1 ; i < MYRI10GE_RECEIVE_BATCH ; i++ ) {
+			if ( group[i].addr_low == MYRI10GE_MOCK_EMPTY ) {
+				mock->partial_groups++;
+				return;
+			}
+		}
+		for ( i = 0 ; i < MYRI10GE_RECEIVE_BATCH ; i++ ) {
+			mock->buffers[ mock->buffers_prod++ %
+				       MYRI10GE_MOCK_MAX_RECV ] =
+				ntohl ( group[i].addr_low );
+			group[i].addr_low = MYRI10GE_MOCK_EMPTY;
+		}
+		mock->recv_idx += MYRI10GE_RECEIVE_BATCH;
+	}
+}
+
+/* Deliver a frame from the wire.  The model places frames at the
+ * posted buffer address, as the driver expects.
+ */
+static void myri10ge_mock_receive ( const void *data, size_t len ) {
+	struct myri10ge_mock *mock = &myri10ge_mock;
+	mcp_slot_t *slot;
+	uint32 addr;
+
+	if ( ! ( mock->up && mock->intrq_slots ) )
+		return;
+	myri10ge_mock_fetch_receives();
+	if ( mock->buffers_cons == mock->buffers_prod ) {
+		mock->dropped++;
+		myri10ge_mock_interrupt ( 1, 1 );
+		return;
+	}
+	addr = mock->buffers[ mock->buffers_cons++ % MYRI10GE_MOCK_MAX_RECV ];
+	memcpy ( phys_to_virt ( addr ), data, len );
+	slot = &mock->intrq[ mock->intrq_idx++ % mock->intrq_slots ];
+	if ( slot->length )
+		mock->intrq_overruns++;
+	slot->length = htons ( len );
+	myri10ge_mock_interrupt ( 1, 0 );
+}
+
+static void myri10ge_mock_run ( void ) {
+	struct myri10ge_mock *mock = &myri10ge_mock;
+	mcp_kreq_ether_send_t *send;
+	uint32 *words;
+
+	/* Execute any command */
+	if ( mock->sram.command.response_addr.low )
+		myri10ge_mock_command();
+
+	/* Deassert and claim the interrupt */
+	if ( mock->sram.irq_deassert != MYRI10GE_MOCK_EMPTY ) {
+		mock->sram.irq_deassert = MYRI10GE_MOCK_EMPTY;
+		if ( mock->irq_data )
+			mock->irq_data->valid = 0;
+		mock->masked = 1;
+	}
+	mock->sram.irq_claim[0] = MYRI10GE_MOCK_EMPTY;
+	if ( mock->sram.irq_claim[1] != MYRI10GE_MOCK_EMPTY ) {
+		mock->sram.irq_claim[1] = MYRI10GE_MOCK_EMPTY;
+		mock->masked = 0;
+		if ( mock->pending ) {
+			myri10ge_mock_interrupt ( ( mock->pending & 0xff ),
+						  ( mock->pending & 0x100 ) );
+			mock->pending = 0;
+		}
+	}
+
+	/* Take receive buffers even if no frame is waiting, so that
+	 * partially written groups are caught.
+	 */
+	if ( mock->recv_slots )
+		myri10ge_mock_fetch_receives();
+
+	/* Loop back any frames posted for transmission */
+	while ( mock->send_slots ) {
+		send = &mock->sram.send[ mock->send_idx &
+					 ( mock->send_slots - 1 ) ];
+		words = ( ( uint32 * ) send );
+		if ( ! words[3] )
+			break;
+		if ( ! ( send->flags & MXGEFW_FLAGS_FIRST ) ||
+		     ( ntohs ( send->length ) < ETH_ZLEN ) )
+			mock->bad_sends++;
+		myri10ge_mock_receive ( phys_to_virt ( ntohl ( send->addr_low ) ),
+					ntohs ( send->length ) );
+		words[3] = 0;
+		mock->send_idx++;
+		mock->send_done++;
+		myri10ge_mock_interrupt ( 2, 0 );
+	}
+}
+
+/* Test harness */
+
+#define MYRI10GE_TEST_LEN 256
+
+static struct net_device_operations myri10ge_test_operations = {
+	.open		= myri10ge_net_open,
+	.close		= myri10ge_net_close,
+	.transmit	= myri10ge_net_transmit,
+	.poll		= myri10ge_net_poll,
+	.irq		= myri10ge_net_irq,
+};
+
+static const uint8_t myri10ge_test_mac[ETH_ALEN] =
+	{ 0x00, 0x60, 0xdd, 0x47, 0x10, 0x01 };
+
+static void myri10ge_test_frame ( void *data, unsigned int seq ) {
+	struct ethhdr *ethhdr = data;
+	uint8_t *payload = ( data + sizeof ( *ethhdr ) );
+	unsigned int i;
+
+	memcpy ( ethhdr->h_dest, myri10ge_test_mac, ETH_ALEN );
+	memcpy ( ethhdr->h_source, myri10ge_test_mac, ETH_ALEN );
+	ethhdr->h_protocol = htons ( 0x88b5 );
+	for ( i = 0 ; i < ( MYRI10GE_TEST_LEN - sizeof ( *ethhdr ) ) ; i++ )
+		payload[i] = ( seq + i );
+}
+
+static int myri10ge_test_transmit ( struct net_device *netdev,
+				    unsigned int count, unsigned int seq ) {
+	struct io_buffer *iobuf;
+	unsigned int sent = 0;
+
+	while ( count-- ) {
+		iobuf = alloc_iob ( MYRI10GE_TEST_LEN );
+		if ( ! iobuf )
+			break;
+		myri10ge_test_frame ( iob_put ( iobuf, MYRI10GE_TEST_LEN ),
+				      seq++ );
+		if ( netdev_tx ( netdev, iobuf ) == 0 )
+			sent++;
+	}
+	return sent;
+}
+
+static void myri10ge_test_inject ( unsigned int count, unsigned int seq ) {
+	uint8_t frame[MYRI10GE_TEST_LEN];
+
+	while ( count-- ) {
+		myri10ge_test_frame ( frame, seq++ );
+		myri10ge_mock_receive ( frame, sizeof ( frame ) );
+	}
+}
+
+/* Count received frames, checking their contents and order */
+static unsigned int myri10ge_test_receive ( struct net_device *netdev,
+					    unsigned int seq ) {
+	uint8_t expected[MYRI10GE_TEST_LEN];
+	struct io_buffer *iobuf;
+	unsigned int count = 0;
+	unsigned int bad = 0;
+
+	while ( ( iobuf = netdev_rx_dequeue ( netdev ) ) ) {
+		myri10ge_test_frame ( expected, ( seq + count ) );
+		if ( ( iob_len ( iobuf ) != sizeof ( expected ) ) ||
+		     ( memcmp ( iobuf->data, expected,
+				sizeof ( expected ) ) != 0 ) )
+			bad++;
+		free_iob ( iobuf );
+		count++;
+	}
+	return ( bad ? 0 : count );
+}
+
+static int myri10ge_test_clean ( void ) {
+	struct myri10ge_mock *mock = &myri10ge_mock;
+
+	return ( ( mock->partial_groups == 0 ) &&
+		 ( mock->intrq_overruns == 0 ) &&
+		 ( mock->bad_sends == 0 ) &&
+		 ( mock->unknown_cmds == 0 ) );
+}
+
+void myri10ge_test ( void ) {
+	struct net_device *netdev;
+	struct myri10ge_private *priv;
+	unsigned int depth;
+	unsigned int rx_bad;
+	int ok;
+
+	netdev = alloc_etherdev ( sizeof ( *priv ) );
+	if ( ! netdev ) {
+		printf ( "myri10ge: could not allocate device\n" );
+		return;
+	}
+	netdev_init ( netdev, &myri10ge_test_operations );
+	priv = myri10ge_priv ( netdev );
+	netdev->dev = &myri10ge_mock.pci.dev;
+	memcpy ( netdev->ll_addr, myri10ge_test_mac, ETH_ALEN );
+
+	/* Firmware rings larger than the driver's limits */
+	myri10ge_mock_init ( MYRI10GE_MOCK_MAX_SEND, MYRI10GE_MOCK_MAX_RECV );
+	ok = ( ( netdev_open ( netdev ) == 0 ) &&
+	       ( priv->transmit_limit == MYRI10GE_TRANSMIT_WRAP ) &&
+	       ( priv->receive_limit == MYRI10GE_RECEIVE_WRAP ) &&
+	       ( priv->receives_posted == ( MYRI10GE_RECEIVE_WRAP + 1 ) ) &&
+	       ( myri10ge_mock.pci_command & PCI_COMMAND_INTX_DISABLE ) );
+	netdev_poll ( netdev );
+	ok = ( ok && netdev_link_ok ( netdev ) && myri10ge_test_clean() );
+	printf ( "myri10ge open: %s\n", ( ok ? "ok" : "FAILED" ) );
+
+	/* Fill the transmit ring; one frame more than fits is refused */
+	depth = ( MYRI10GE_TRANSMIT_WRAP + 1 );
+	ok = ( myri10ge_test_transmit ( netdev, ( depth + 1 ), 0 ) ==
+	       ( int ) depth );
+	ok = ( ok && ( priv->transmit_ring_full == 1 ) &&
+	       ( priv->transmit_max_occupancy == depth ) );
+	netdev_poll ( netdev );
+	ok = ( ok && ( myri10ge_test_receive ( netdev, 0 ) == depth ) &&
+	       ( priv->transmits_done == depth ) &&
+	       ( netdev->tx_stats.good == depth ) &&
+	       ( ( priv->receives_posted - priv->receives_done ) ==
+		 ( MYRI10GE_RECEIVE_WRAP + 1 ) ) &&
+	       myri10ge_test_clean() );
+	printf ( "myri10ge transmit burst: %s\n", ( ok ? "ok" : "FAILED" ) );
+
+	/* Overrun the receive ring between polls */
+	depth = ( MYRI10GE_RECEIVE_WRAP + 1 );
+	rx_bad = netdev->rx_stats.bad;
+	myri10ge_test_inject ( ( depth + 8 ), 1000 );
+	netdev_poll ( netdev );
+	ok = ( ( myri10ge_test_receive ( netdev, 1000 ) == depth ) &&
+	       ( ( netdev->rx_stats.bad - rx_bad ) == 8 ) &&
+	       ( priv->receive_nic_drops == 8 ) &&
+	       ( priv->receive_min_occupancy == 0 ) &&
+	       ( ( priv->receives_posted - priv->receives_done ) == depth ) &&
+	       myri10ge_test_clean() );
+	printf ( "myri10ge receive overrun: %s\n", ( ok ? "ok" : "FAILED" ) );
+	netdev_close ( netdev );
+
+	/* Firmware rings smaller than the driver's limits */
+	myri10ge_mock_init ( 8, 16 );
+	ok = ( ( netdev_open ( netdev ) == 0 ) &&
+	       ( priv->transmit_limit == 7 ) &&
+	       ( priv->receive_limit == 15 ) &&
+	       ( priv->receives_posted == 16 ) );
+	ok = ( ok && ( myri10ge_test_transmit ( netdev, 9, 2000 ) == 8 ) );
+	netdev_poll ( netdev );
+	ok = ( ok && ( myri10ge_test_receive ( netdev, 2000 ) == 8 ) &&
+	       myri10ge_test_clean() );
+	printf ( "myri10ge firmware ring sizes: %s\n",
+		 ( ok ? "ok" : "FAILED" ) );
+	netdev_close ( netdev );
+
+	/* Failure to bring the link up leaves the device closed */
+	myri10ge_mock_init ( MYRI10GE_MOCK_MAX_SEND, MYRI10GE_MOCK_MAX_RECV );
+	myri10ge_mock.fail_cmd = MXGEFW_CMD_ETHERNET_UP;
+	ok = ( ( netdev_open ( netdev ) != 0 ) &&
+	       ( priv->dma == NULL ) && ( priv->receives_posted == 0 ) );
+	printf ( "myri10ge failed open: %s\n", ( ok ? "ok" : "FAILED" ) );
+
+	netdev_nullify ( netdev );
+	netdev_put ( netdev );
+}
@@ -0,0 +1,69 @@
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <gpxe/sha1.h>
+
+/*
+ * PBKDF2-HMAC-SHA1 known-answer tests
+ *
+ * Checks the WPA passphrase-to-PSK test vectors from IEEE 802.11i
+ * Annex H.4, the first RFC 6070 test vector, and an independently
+ * calculated vector with a passphrase longer than the SHA-1 block
+ * size (which must first be reduced to its digest).
+ *
+ */
+
+struct pbkdf2_test_vector {
+	const char *name;
+	const char *passphrase;
+	const char *salt;
+	int iterations;
+	uint8_t key[32];
+	size_t key_len;
+};
+
+static struct pbkdf2_test_vector pbkdf2_test_vectors[] = {
+	{ "IEEE 802.11i vector 1",
+	  "password", "IEEE", 4096,
+	  { 0xf4, 0x2c, 0x6f, 0xc5, 0x2d, 0xf0, 0xeb, 0xef,
+	    0x9e, 0xbb, 0x4b, 0x90, 0xb3, 0x8a, 0x5f, 0x90,
+	    0x2e, 0x83, 0xfe, 0x1b, 0x13, 0x5a, 0x70, 0xe2,
+	    0x3a, 0xed, 0x76, 0x2e, 0x97, 0x10, 0xa1, 0x2e }, 32 },
+	{ "IEEE 802.11i vector 2",
+	  "ThisIsAPassword", "ThisIsASSID", 4096,
+	  { 0x0d, 0xc0, 0xd6, 0xeb, 0x90, 0x55, 0x5e, 0xd6,
+	    0x41, 0x97, 0x56, 0xb9, 0xa1, 0x5e, 0xc3, 0xe3,
+	    0x20, 0x9b, 0x63, 0xdf, 0x70, 0x7d, 0xd5, 0x08,
+	    0xd1, 0x45, 0x81, 0xf8, 0x98, 0x27, 0x21, 0xaf }, 32 },
+	{ "RFC 6070 vector 1",
+	  "password", "salt", 1,
+	  { 0x0c, 0x60, 0xc8, 0x0f, 0x96, 0x1f, 0x0e, 0x71,
+	    0xf3, 0xa9, 0xb5, 0x24, 0xaf, 0x60, 0x12, 0x06,
+	    0x2f, 0xe0, 0x37, 0xa6 }, 20 },
+	{ "Overlength passphrase",
+	  "01234567890123456789012345678901234"
+	  "56789012345678901234567890123456789",
+	  "LongPassphrase", 2,
+	  { 0x99, 0xd2, 0x54, 0x5e, 0xad, 0x89, 0x35, 0xf9,
+	    0x76, 0xf9, 0x66, 0x4c, 0xcd, 0x6f, 0x89, 0x6a,
+	    0xbc, 0x38, 0x11, 0x16, 0xea, 0x02, 0xcf, 0x88,
+	    0x92, 0xb1, 0xdd, 0xce, 0x6a, 0x35, 0x91, 0x49 }, 32 },
+};
+
+void pbkdf2_test ( void ) {
+	struct pbkdf2_test_vector *vector;
+	uint8_t key[32];
+	unsigned int i;
+	int ok;
+
+	for ( i = 0 ; i < ( sizeof ( pbkdf2_test_vectors ) /
+			    sizeof ( pbkdf2_test_vectors[0] ) ) ; i++ ) {
+		vector = &pbkdf2_test_vectors[i];
+		pbkdf2_sha1 ( vector->passphrase, strlen ( vector->passphrase ),
+			      vector->salt, strlen ( vector->salt ),
+			      vector->iterations, key, vector->key_len );
+		ok = ( memcmp ( key, vector->key, vector->key_len ) == 0 );
+		printf ( "PBKDF2 %s: %s\n", vector->name,
+			 ( ok ? "ok" : "FAILED" ) );
+	}
+}
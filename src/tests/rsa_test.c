@@ -0,0 +1,204 @@
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <gpxe/rsa.h>
+
+/*
+ * RSA known-answer tests
+ *
+ * Checks a 2048-bit public key operation (e = 65537) and the matching
+ * private key operation against values calculated independently,
+ * using both Montgomery and classical reduction.  The private key
+ * operation exercises the windowed exponentiation with a full-length
+ * exponent.
+ *
+ */
+
+#define RSA_TEST_LEN ( 2048 / 8 )
+
+/** Modulus */
+static const uint8_t rsa_test_n[RSA_TEST_LEN] = {
+	0xbc, 0x28, 0x04, 0x30, 0x2c, 0x61, 0xb0, 0xf9,
+	0x02, 0x42, 0x00, 0xf5, 0x92, 0x8f, 0x13, 0xc6,
+	0x5c, 0xa0, 0x0d, 0x95, 0xad, 0x4a, 0x1c, 0xa6,
+	0x61, 0xc5, 0x2c, 0x6d, 0x8c, 0x31, 0xd5, 0xbc,
+	0x4c, 0x60, 0x3d, 0x7c, 0x2e, 0xd5, 0x93, 0xe5,
+	0x51, 0x4d, 0x68, 0x91, 0xd9, 0x26, 0x3b, 0x00,
+	0xca, 0x72, 0x74, 0x87, 0xd9, 0x03, 0xf4, 0x1f,
+	0x16, 0x89, 0x94, 0x5f, 0x1d, 0x1a, 0xfc, 0x69,
+	0x2f, 0x85, 0x5d, 0xf2, 0x74, 0xd1, 0x76, 0x08,
+	0x4d, 0x00, 0x12, 0x18, 0x67, 0x3a, 0x84, 0xcb,
+	0xb4, 0x8e, 0xb3, 0x3c, 0x3b, 0xfb, 0x92, 0xa8,
+	0x27, 0x21, 0xe3, 0xd1, 0xd7, 0x00, 0x58, 0xfe,
+	0x0c, 0x6a, 0x06, 0x53, 0xb0, 0x1f, 0xb9, 0x26,
+	0x95, 0x7b, 0x1e, 0x94, 0xa7, 0xb4, 0xdd, 0xfe,
+	0x7a, 0x54, 0x09, 0x96, 0x16, 0x28, 0x70, 0xe3,
+	0x1d, 0xfd, 0xc4, 0xa4, 0x87, 0xa0, 0xd0, 0xe9,
+	0x3f, 0xa8, 0xda, 0xb4, 0x04, 0xf1, 0xac, 0xee,
+	0xb9, 0xe5, 0xb1, 0xdf, 0x4f, 0xe1, 0x43, 0xae,
+	0xee, 0x80, 0xc9, 0xda, 0x1f, 0xad, 0xdc, 0x53,
+	0x33, 0x83, 0x25, 0xe5, 0x3b, 0xf4, 0xa1, 0xc7,
+	0x2c, 0x28, 0x9a, 0x1b, 0xb7, 0x0e, 0x17, 0xcf,
+	0xec, 0x21, 0xfc, 0xb3, 0x5e, 0x29, 0xe0, 0xd0,
+	0x19, 0x81, 0xa5, 0x2f, 0x05, 0xc4, 0x8c, 0x75,
+	0xd6, 0xd4, 0xf9, 0x8a, 0x70, 0xdc, 0x4b, 0x1c,
+	0x7c, 0x41, 0xa0, 0x0c, 0x70, 0x27, 0x58, 0x40,
+	0x52, 0x32, 0x34, 0xcf, 0x90, 0xa4, 0xc9, 0x58,
+	0xbe, 0x50, 0x27, 0xd7, 0x64, 0x05, 0x7b, 0x25,
+	0xd9, 0x5e, 0xc7, 0x0d, 0x4d, 0x75, 0x7c, 0xe4,
+	0xf4, 0xa5, 0x09, 0x72, 0xb3, 0x90, 0x19, 0xdf,
+	0x64, 0xfc, 0xb1, 0x89, 0x7a, 0x86, 0x00, 0xe7,
+	0x9e, 0x49, 0xe5, 0xb0, 0x54, 0x5c, 0xc4, 0xae,
+	0xd4, 0x4d, 0x39, 0x44, 0xe5, 0xd0, 0x7e, 0xed
+};
+
+/** Public exponent */
+static const uint8_t rsa_test_e[] = { 0x01, 0x00, 0x01 };
+
+/** Private exponent */
+static const uint8_t rsa_test_d[RSA_TEST_LEN] = {
+	0x13, 0x46, 0x40, 0x23, 0x95, 0x30, 0x4e, 0xba,
+	0x3b, 0x6e, 0x7a, 0x7d, 0xad, 0x8d, 0x45, 0x97,
+	0xd0, 0xde, 0x3e, 0x76, 0x02, 0x41, 0xf0, 0xcc,
+	0x64, 0x80, 0x97, 0xcc, 0x03, 0x0c, 0x09, 0xda,
+	0x97, 0xb2, 0x56, 0x2a, 0x15, 0xfc, 0x20, 0x01,
+	0xe2, 0x41, 0xbd, 0x40, 0x0f, 0x90, 0x18, 0x84,
+	0x3c, 0xb8, 0xdb, 0xd2, 0x1c, 0xbb, 0x88, 0x72,
+	0xf4, 0xd2, 0x94, 0x25, 0xe8, 0x2b, 0xdf, 0x06,
+	0x81, 0x6d, 0x36, 0x92, 0x03, 0x40, 0x7f, 0xc8,
+	0x5a, 0xe6, 0xf2, 0x73, 0x98, 0x83, 0x88, 0x9d,
+	0xfb, 0x79, 0x90, 0xc7, 0xcf, 0x57, 0x36, 0x8f,
+	0x4e, 0x2e, 0xed, 0x11, 0x0e, 0x66, 0xc5, 0x37,
+	0x05, 0x1b, 0x89, 0x59, 0x62, 0x55, 0xe5, 0x98,
+	0x1b, 0xc0, 0xf8, 0x81, 0x7e, 0xea, 0x8a, 0xc1,
+	0x2a, 0x53, 0xd8, 0x85, 0x8c, 0xf0, 0x88, 0x9b,
+	0xe3, 0x73, 0x1f, 0x05, 0x41, 0xb5, 0x8a, 0x20,
+	0xe5, 0xc2, 0x01, 0x70, 0x31, 0x50, 0x5c, 0x11,
+	0x55, 0x6a, 0xf1, 0x2e, 0x84, 0x68, 0x07, 0x71,
+	0xfe, 0xd1, 0x5e, 0xb1, 0xb9, 0x01, 0xb0, 0x46,
+	0x2e, 0xd7, 0x94, 0xd8, 0xc4, 0x75, 0x23, 0x82,
+	0xbc, 0x37, 0xdf, 0x40, 0x9b, 0x23, 0x5d, 0x86,
+	0xb3, 0x10, 0x35, 0xe6, 0x92, 0x5d, 0x45, 0x72,
+	0xec, 0x61, 0xf6, 0xee, 0xa2, 0x28, 0x65, 0x23,
+	0xdb, 0x81, 0xe5, 0x05, 0x8c, 0x07, 0x3b, 0x73,
+	0xb4, 0xe2, 0x4f, 0x47, 0x3c, 0xe2, 0x21, 0xfa,
+	0x9d, 0xe4, 0xa7, 0x57, 0xda, 0xa3, 0x4b, 0xc5,
+	0x66, 0xef, 0x3a, 0x20, 0x25, 0x34, 0x19, 0xe2,
+	0x8c, 0xec, 0xbb, 0xd2, 0x8b, 0x0c, 0x3d, 0xa5,
+	0x7e, 0x08, 0xe8, 0x6a, 0x12, 0x53, 0x6d, 0x0f,
+	0x73, 0x82, 0x2f, 0x36, 0x50, 0x21, 0x1d, 0x45,
+	0xc5, 0x11, 0x54, 0x3e, 0x19, 0x5c, 0x88, 0x6a,
+	0x42, 0x69, 0xd0, 0x3d, 0x3c, 0x5f, 0x60, 0xa1
+};
+
+/** Plaintext */
+static const uint8_t rsa_test_m[RSA_TEST_LEN] = {
+	0x24, 0xdb, 0x97, 0xbe, 0xed, 0x58, 0x20, 0x5c,
+	0x3c, 0x67, 0xed, 0x77, 0x98, 0x0e, 0x08, 0x64,
+	0xcb, 0xf3, 0xa2, 0x54, 0xf3, 0xa1, 0x3b, 0x34,
+	0x40, 0xd7, 0xb4, 0xfb, 0xec, 0xed, 0xb5, 0xd5,
+	0x94, 0xa3, 0x5e, 0x72, 0xea, 0xe4, 0x3d, 0x6f,
+	0xed, 0x5c, 0x85, 0xdb, 0x51, 0x76, 0xe1, 0x2a,
+	0x5e, 0x21, 0x3b, 0x62, 0xc7, 0xe7, 0x63, 0xbb,
+	0x8c, 0x13, 0x4d, 0x0a, 0x5c, 0x04, 0x8f, 0x28,
+	0xb1, 0x7e, 0x3d, 0xfc, 0xa4, 0xe8, 0x5b, 0x4c,
+	0xf1, 0xa9, 0xdc, 0x54, 0xc3, 0x62, 0x97, 0x5f,
+	0x74, 0x04, 0xfc, 0xae, 0x64, 0xef, 0xc5, 0x32,
+	0x7b, 0x7a, 0xfd, 0x97, 0xa2, 0x1f, 0x32, 0x93,
+	0xd4, 0x99, 0x95, 0x9b, 0x69, 0x9a, 0x18, 0x2e,
+	0xa9, 0x2e, 0xcf, 0xd8, 0x82, 0xe8, 0x3e, 0x2c,
+	0xae, 0x3f, 0xa6, 0x54, 0x8a, 0xc2, 0xe6, 0xf7,
+	0x84, 0x9f, 0x1c, 0xc4, 0xf1, 0x7e, 0xba, 0xa8,
+	0xa1, 0x5a, 0xc1, 0x3b, 0x14, 0xc8, 0x24, 0x66,
+	0x84, 0xc4, 0x3c, 0x8d, 0xda, 0xbb, 0xd8, 0x7c,
+	0x3a, 0x12, 0xe6, 0x10, 0x81, 0x3d, 0x7b, 0x87,
+	0x6f, 0x19, 0xbb, 0x84, 0x3d, 0x2a, 0xe9, 0xca,
+	0xb4, 0xdb, 0x01, 0xd3, 0x62, 0xab, 0xb9, 0x85,
+	0x52, 0x87, 0xf1, 0xb9, 0xcc, 0x73, 0x3b, 0x5b,
+	0x0f, 0x12, 0x0a, 0xbb, 0x9b, 0x26, 0xcb, 0x64,
+	0xcb, 0xc7, 0xe7, 0xdf, 0x08, 0x43, 0x40, 0x75,
+	0x64, 0xc1, 0xfb, 0xe2, 0xa9, 0x92, 0x79, 0x14,
+	0xec, 0x77, 0xb9, 0x9d, 0x99, 0xf8, 0x52, 0xd2,
+	0x6a, 0x43, 0x88, 0x13, 0x3c, 0xe5, 0xdc, 0xb4,
+	0xc9, 0x3e, 0x1a, 0x5c, 0x2b, 0xaa, 0x0e, 0xac,
+	0xec, 0x5e, 0x92, 0x7c, 0x66, 0x29, 0xb7, 0x75,
+	0xd9, 0xad, 0x3c, 0xe3, 0xb0, 0x17, 0x1b, 0x43,
+	0x8a, 0x49, 0xca, 0x3a, 0x4c, 0x8e, 0x93, 0x2b,
+	0xce, 0x4f, 0xa8, 0x24, 0x93, 0x4f, 0x0c, 0xa4
+};
+
+/** Ciphertext */
+static const uint8_t rsa_test_c[RSA_TEST_LEN] = {
+	0x04, 0x97, 0x6c, 0x82, 0x5a, 0xf9, 0xd8, 0xec,
+	0x9a, 0x0d, 0x51, 0x2c, 0x71, 0x40, 0x18, 0x6f,
+	0x61, 0xfa, 0x7f, 0x0a, 0xac, 0xc2, 0x6b, 0x83,
+	0xf6, 0x19, 0x9b, 0x6c, 0x7f, 0x50, 0xd5, 0x31,
+	0xff, 0x5c, 0x34, 0x62, 0x93, 0xcd, 0x55, 0xd9,
+	0xc6, 0xe6, 0x5c, 0xd2, 0xc9, 0x83, 0x85, 0xed,
+	0xed, 0xab, 0x4a, 0xb3, 0x23, 0xe6, 0x22, 0xaa,
+	0xdd, 0x4d, 0x7e, 0x24, 0x71, 0xdc, 0xc6, 0x3b,
+	0x58, 0xf7, 0x94, 0x5a, 0x65, 0xf0, 0xf3, 0xfb,
+	0xed, 0x4e, 0x78, 0xa3, 0xc0, 0x52, 0xf3, 0x84,
+	0xae, 0xc0, 0x83, 0xfe, 0x02, 0x2c, 0x03, 0xc0,
+	0x41, 0x2e, 0x7d, 0x83, 0x37, 0x17, 0x68, 0x75,
+	0x98, 0x0c, 0x40, 0x20, 0x6f, 0x39, 0x76, 0xd6,
+	0x99, 0xf2, 0x26, 0x19, 0x63, 0xde, 0x8d, 0x14,
+	0xe4, 0x4b, 0x60, 0x1b, 0xaf, 0x03, 0x49, 0xe1,
+	0x3f, 0x3b, 0xe3, 0x0b, 0xf0, 0x19, 0x1c, 0x8d,
+	0x27, 0x7c, 0xa1, 0x4a, 0xdd, 0x3b, 0xb0, 0xcf,
+	0x87, 0x8c, 0xe3, 0x25, 0x04, 0x3a, 0x93, 0xcc,
+	0x10, 0x6d, 0x8b, 0x70, 0xee, 0xce, 0x46, 0x17,
+	0x09, 0x00, 0xa7, 0xe9, 0x7e, 0x8d, 0x23, 0x1a,
+	0xb9, 0x5e, 0x1a, 0x73, 0x09, 0x0b, 0x73, 0x03,
+	0x8a, 0x9d, 0x55, 0x46, 0x7d, 0x1d, 0x44, 0xc1,
+	0xbf, 0x80, 0xdf, 0xef, 0xd1, 0xb7, 0x54, 0xa2,
+	0x92, 0xb3, 0xde, 0x06, 0x1b, 0xd2, 0xc8, 0x82,
+	0xf3, 0xe3, 0x79, 0x88, 0x99, 0xac, 0x07, 0x01,
+	0x81, 0xf3, 0x27, 0x2f, 0xea, 0x8b, 0xb1, 0xe6,
+	0x43, 0xf4, 0xdf, 0x59, 0x60, 0x29, 0x91, 0x55,
+	0x3c, 0xe0, 0x70, 0x2d, 0x66, 0xfa, 0x2c, 0x05,
+	0xb8, 0x67, 0x11, 0x66, 0x59, 0xec, 0xa2, 0xdb,
+	0x9f, 0x9b, 0xb0, 0xc3, 0x0f, 0xd6, 0x72, 0x94,
+	0xd5, 0xe9, 0x24, 0xd5, 0xd6, 0x73, 0x63, 0xe1,
+	0x56, 0xa6, 0x76, 0x61, 0xca, 0x3b, 0x5c, 0x26
+};
+
+static int rsa_test_run ( RSA_CTX *rsa, const uint8_t *in,
+			  const uint8_t *expected, int private,
+			  int classical ) {
+	BI_CTX *bi_ctx = rsa->bi_ctx;
+	uint8_t out[RSA_TEST_LEN];
+	bigint *bi;
+
+	bi_ctx->use_classical = classical;
+	bi = bi_import ( bi_ctx, in, RSA_TEST_LEN );
+	bi = ( private ? RSA_private ( rsa, bi ) : RSA_public ( rsa, bi ) );
+	bi_ctx->use_classical = 0;
+	if ( ! bi )
+		return 0;
+	bi_export ( bi_ctx, bi, out, sizeof ( out ) );
+
+	return ( memcmp ( out, expected, sizeof ( out ) ) == 0 );
+}
+
+void rsa_test ( void ) {
+	RSA_CTX *rsa;
+	int fast;
+	int classical;
+
+	RSA_priv_key_new ( &rsa, rsa_test_n, sizeof ( rsa_test_n ),
+			   rsa_test_e, sizeof ( rsa_test_e ),
+			   rsa_test_d, sizeof ( rsa_test_d ) );
+
+	fast = rsa_test_run ( rsa, rsa_test_m, rsa_test_c, 0, 0 );
+	classical = rsa_test_run ( rsa, rsa_test_m, rsa_test_c, 0, 1 );
+	printf ( "RSA-2048 public: %s/%s\n", ( fast ? "ok" : "FAILED" ),
+		 ( classical ? "ok" : "FAILED" ) );
+
+	fast = rsa_test_run ( rsa, rsa_test_c, rsa_test_m, 1, 0 );
+	classical = rsa_test_run ( rsa, rsa_test_c, rsa_test_m, 1, 1 );
+	printf ( "RSA-2048 private: %s/%s\n", ( fast ? "ok" : "FAILED" ),
+		 ( classical ? "ok" : "FAILED" ) );
+
+	RSA_free ( rsa );
+}
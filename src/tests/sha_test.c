@@ -0,0 +1,132 @@
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <gpxe/crypto.h>
+#include <gpxe/sha1.h>
+#include <gpxe/sha256.h>
+
+/*
+ * SHA-1 and SHA-256 known-answer tests
+ *
+ * Checks the FIPS 180-2 example vectors against both the accelerated
+ * (if present) and generic implementations.  Each message is fed to
+ * the digest in fragments which do not align with the block size, to
+ * exercise the partial block handling.
+ *
+ */
+
+#define SHA_TEST_FRAG_LEN 125
+
+struct sha_test_vector {
+	const char *name;
+	struct digest_algorithm *digest;
+	void ( * force_generic ) ( void *ctx );
+	const char *data;
+	unsigned long repeat;
+	uint8_t expected[32];
+};
+
+#define SHA_TEST_ABC "abc"
+
+#define SHA_TEST_448						\
+	"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"
+
+static struct sha_test_vector sha_test_vectors[] = {
+	{ "SHA-1 empty", &sha1_algorithm, sha1_force_generic, "", 1,
+	  { 0xda, 0x39, 0xa3, 0xee, 0x5e, 0x6b, 0x4b, 0x0d, 0x32, 0x55,
+	    0xbf, 0xef, 0x95, 0x60, 0x18, 0x90, 0xaf, 0xd8, 0x07, 0x09 } },
+	{ "SHA-1 \"abc\"", &sha1_algorithm, sha1_force_generic,
+	  SHA_TEST_ABC, 1,
+	  { 0xa9, 0x99, 0x3e, 0x36, 0x47, 0x06, 0x81, 0x6a, 0xba, 0x3e,
+	    0x25, 0x71, 0x78, 0x50, 0xc2, 0x6c, 0x9c, 0xd0, 0xd8, 0x9d } },
+	{ "SHA-1 448-bit", &sha1_algorithm, sha1_force_generic,
+	  SHA_TEST_448, 1,
+	  { 0x84, 0x98, 0x3e, 0x44, 0x1c, 0x3b, 0xd2, 0x6e, 0xba, 0xae,
+	    0x4a, 0xa1, 0xf9, 0x51, 0x29, 0xe5, 0xe5, 0x46, 0x70, 0xf1 } },
+	{ "SHA-1 million \"a\"", &sha1_algorithm, sha1_force_generic,
+	  "a", 1000000,
+	  { 0x34, 0xaa, 0x97, 0x3c, 0xd4, 0xc4, 0xda, 0xa4, 0xf6, 0x1e,
+	    0xeb, 0x2b, 0xdb, 0xad, 0x27, 0x31, 0x65, 0x34, 0x01, 0x6f } },
+	{ "SHA-256 empty", &sha256_algorithm, sha256_force_generic, "", 1,
+	  { 0xe3, 0xb0, 0xc4, 0x42, 0x98, 0xfc, 0x1c, 0x14,
+	    0x9a, 0xfb, 0xf4, 0xc8, 0x99, 0x6f, 0xb9, 0x24,
+	    0x27, 0xae, 0x41, 0xe4, 0x64, 0x9b, 0x93, 0x4c,
+	    0xa4, 0x95, 0x99, 0x1b, 0x78, 0x52, 0xb8, 0x55 } },
+	{ "SHA-256 \"abc\"", &sha256_algorithm, sha256_force_generic,
+	  SHA_TEST_ABC, 1,
+	  { 0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea,
+	    0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+	    0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
+	    0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad } },
+	{ "SHA-256 448-bit", &sha256_algorithm, sha256_force_generic,
+	  SHA_TEST_448, 1,
+	  { 0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8,
+	    0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
+	    0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67,
+	    0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1 } },
+	{ "SHA-256 million \"a\"", &sha256_algorithm, sha256_force_generic,
+	  "a", 1000000,
+	  { 0xcd, 0xc7, 0x6e, 0x5c, 0x99, 0x14, 0xfb, 0x92,
+	    0x81, 0xa1, 0xc7, 0xe2, 0x84, 0xd7, 0x3e, 0x67,
+	    0xf1, 0x80, 0x9a, 0x48, 0xa4, 0x97, 0x20, 0x0e,
+	    0x04, 0x6d, 0x39, 0xcc, 0xc7, 0x11, 0x2c, 0xd0 } },
+};
+
+static int sha_test_run ( struct sha_test_vector *vector, int generic ) {
+	struct digest_algorithm *digest = vector->digest;
+	uint8_t ctx[digest->ctxsize];
+	uint8_t out[digest->digestsize];
+	uint8_t buf[SHA_TEST_FRAG_LEN];
+	size_t data_len = strlen ( vector->data );
+	unsigned long remaining;
+	size_t frag_len;
+	unsigned int i;
+
+	digest_init ( digest, ctx );
+	if ( generic )
+		vector->force_generic ( ctx );
+
+	if ( data_len == 1 ) {
+		/* Repeated single character: feed in fragments */
+		memset ( buf, vector->data[0], sizeof ( buf ) );
+		for ( remaining = vector->repeat ; remaining ;
+		      remaining -= frag_len ) {
+			frag_len = sizeof ( buf );
+			if ( frag_len > remaining )
+				frag_len = remaining;
+			digest_update ( digest, ctx, buf, frag_len );
+		}
+	} else {
+		/* Feed one byte at a time, then the remainder */
+		for ( i = 0 ; ( i < 3 ) && ( i < data_len ) ; i++ )
+			digest_update ( digest, ctx, &vector->data[i], 1 );
+		digest_update ( digest, ctx, &vector->data[i],
+				( data_len - i ) );
+	}
+	digest_final ( digest, ctx, out );
+
+	return ( memcmp ( out, vector->expected, sizeof ( out ) ) == 0 );
+}
+
+void sha_test ( void ) {
+	struct sha_test_vector *vector;
+	uint8_t ctx[SHA256_CTX_SIZE];
+	int fast;
+	int generic;
+	unsigned int i;
+
+	digest_init ( &sha256_algorithm, ctx );
+	printf ( "SHA using %s implementation\n",
+		 ( ( ( struct sha256_ctx * ) ctx )->accelerated ?
+		   "accelerated" : "generic" ) );
+
+	for ( i = 0 ; i < ( sizeof ( sha_test_vectors ) /
+			    sizeof ( sha_test_vectors[0] ) ) ; i++ ) {
+		vector = &sha_test_vectors[i];
+		fast = sha_test_run ( vector, 0 );
+		generic = sha_test_run ( vector, 1 );
+		printf ( "%s: %s/%s\n", vector->name,
+			 ( fast ? "ok" : "FAILED" ),
+			 ( generic ? "ok" : "FAILED" ) );
+	}
+}
@@ -0,0 +1,634 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <byteswap.h>
+#include <gpxe/iobuf.h>
+#include <gpxe/xfer.h>
+#include <gpxe/process.h>
+#include <gpxe/crypto.h>
+#include <gpxe/hmac.h>
+#include <gpxe/sha256.h>
+#include <gpxe/aes.h>
+#include <gpxe/gcm.h>
+#include <gpxe/rsa.h>
+#include <gpxe/tls.h>
+
+/*
+ * TLS handshake tests
+ *
+ * Runs a full TLSv1.2 handshake using TLS_RSA_WITH_AES_128_GCM_SHA256
+ * between a TLS session and a minimal server implemented here, with
+ * a self-signed 1024-bit certificate for "tls.test".  The server
+ * decrypts the pre-master secret using its private key, checks the
+ * client's Finished record (the first record sent after the client's
+ * Change Cipher), and sends its own Change Cipher and Finished.
+ * Application data is then exchanged in each direction.
+ *
+ */
+
+/** Server certificate ("tls.test") */
+static uint8_t tls_test_cert[] = {
+	0x30, 0x82, 0x02, 0x17, 0x30, 0x82, 0x01, 0x80,
+	0xa0, 0x03, 0x02, 0x01, 0x02, 0x02, 0x14, 0x2c,
+	0xea, 0x99, 0x1b, 0x26, 0xbb, 0x82, 0x68, 0x0a,
+	0x79, 0x92, 0xac, 0x9f, 0x96, 0x70, 0x2b, 0x62,
+	0xa5, 0x4b, 0xcd, 0x30, 0x0d, 0x06, 0x09, 0x2a,
+	0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x0b,
+	0x05, 0x00, 0x30, 0x13, 0x31, 0x11, 0x30, 0x0f,
+	0x06, 0x03, 0x55, 0x04, 0x03, 0x0c, 0x08, 0x74,
+	0x6c, 0x73, 0x2e, 0x74, 0x65, 0x73, 0x74, 0x30,
+	0x1e, 0x17, 0x0d, 0x32, 0x36, 0x31, 0x30, 0x31,
+	0x38, 0x30, 0x38, 0x35, 0x36, 0x34, 0x39, 0x5a,
+	0x17, 0x0d, 0x33, 0x36, 0x31, 0x30, 0x31, 0x35,
+	0x30, 0x38, 0x35, 0x36, 0x34, 0x39, 0x5a, 0x30,
+	0x13, 0x31, 0x11, 0x30, 0x0f, 0x06, 0x03, 0x55,
+	0x04, 0x03, 0x0c, 0x08, 0x74, 0x6c, 0x73, 0x2e,
+	0x74, 0x65, 0x73, 0x74, 0x30, 0x81, 0x9f, 0x30,
+	0x0d, 0x06, 0x09, 0x2a, 0x86, 0x48, 0x86, 0xf7,
+	0x0d, 0x01, 0x01, 0x01, 0x05, 0x00, 0x03, 0x81,
+	0x8d, 0x00, 0x30, 0x81, 0x89, 0x02, 0x81, 0x81,
+	0x00, 0xa9, 0xf5, 0x61, 0xd9, 0xca, 0x5f, 0x61,
+	0x54, 0x4b, 0x71, 0x7e, 0x89, 0x1b, 0x94, 0x59,
+	0x47, 0xf3, 0xcd, 0x92, 0x2b, 0x42, 0x70, 0x30,
+	0x9e, 0x57, 0x39, 0xd6, 0x58, 0x3c, 0x66, 0xcd,
+	0x35, 0xf3, 0x8e, 0x42, 0xea, 0x82, 0xe8, 0x77,
+	0x19, 0x2e, 0x79, 0x85, 0x21, 0x2e, 0xc9, 0xd2,
+	0x1e, 0x75, 0x2e, 0x55, 0xc0, 0x57, 0x27, 0x6c,
+	0x0b, 0x6b, 0x6d, 0x58, 0x63, 0xf8, 0xaa, 0xfa,
+	0x70, 0xe4, 0x7c, 0x33, 0x31, 0x10, 0x15, 0xbd,
+	0xdc, 0x89, 0x59, 0x57, 0xbe, 0x48, 0xb6, 0x53,
+	0xba, 0x2b, 0x81, 0x06, 0xc6, 0x5f, 0xae, 0xa1,
+	0xe9, 0x3c, 0xfc, 0xc4, 0x90, 0x6c, 0xa6, 0xeb,
+	0xa3, 0x51, 0xfc, 0x9b, 0x6c, 0x32, 0xc5, 0x4e,
+	0x65, 0xdd, 0xec, 0x78, 0xec, 0xc5, 0x88, 0xad,
+	0xa0, 0x53, 0xaf, 0xc0, 0x57, 0xdf, 0x97, 0xdb,
+	0x6b, 0x93, 0xef, 0xea, 0x6c, 0x29, 0x9a, 0x28,
+	0x2f, 0x02, 0x03, 0x01, 0x00, 0x01, 0xa3, 0x68,
+	0x30, 0x66, 0x30, 0x1d, 0x06, 0x03, 0x55, 0x1d,
+	0x0e, 0x04, 0x16, 0x04, 0x14, 0x77, 0xf4, 0x1b,
+	0x88, 0x82, 0xa6, 0x0e, 0x54, 0x11, 0x68, 0xdf,
+	0x8e, 0x61, 0x70, 0x8d, 0x60, 0xfc, 0xef, 0xf7,
+	0x47, 0x30, 0x1f, 0x06, 0x03, 0x55, 0x1d, 0x23,
+	0x04, 0x18, 0x30, 0x16, 0x80, 0x14, 0x77, 0xf4,
+	0x1b, 0x88, 0x82, 0xa6, 0x0e, 0x54, 0x11, 0x68,
+	0xdf, 0x8e, 0x61, 0x70, 0x8d, 0x60, 0xfc, 0xef,
+	0xf7, 0x47, 0x30, 0x0f, 0x06, 0x03, 0x55, 0x1d,
+	0x13, 0x01, 0x01, 0xff, 0x04, 0x05, 0x30, 0x03,
+	0x01, 0x01, 0xff, 0x30, 0x13, 0x06, 0x03, 0x55,
+	0x1d, 0x11, 0x04, 0x0c, 0x30, 0x0a, 0x82, 0x08,
+	0x74, 0x6c, 0x73, 0x2e, 0x74, 0x65, 0x73, 0x74,
+	0x30, 0x0d, 0x06, 0x09, 0x2a, 0x86, 0x48, 0x86,
+	0xf7, 0x0d, 0x01, 0x01, 0x0b, 0x05, 0x00, 0x03,
+	0x81, 0x81, 0x00, 0x71, 0x40, 0x4c, 0x05, 0x01,
+	0xdc, 0x95, 0xb8, 0x30, 0xa3, 0x6f, 0x18, 0x4d,
+	0x70, 0x74, 0x92, 0x04, 0x8f, 0xe4, 0xba, 0x7b,
+	0xdf, 0x7f, 0x12, 0xd6, 0xd6, 0xb0, 0x21, 0x35,
+	0x79, 0x30, 0xf3, 0x55, 0x61, 0x8d, 0x1b, 0x3f,
+	0xfc, 0x33, 0x56, 0x8e, 0x02, 0x10, 0xef, 0x50,
+	0x06, 0x2c, 0x75, 0xe5, 0x89, 0x3d, 0x58, 0x89,
+	0xd4, 0x76, 0x25, 0x14, 0x26, 0x55, 0x37, 0xf8,
+	0xb5, 0x16, 0xa9, 0x56, 0x35, 0x32, 0x71, 0xfa,
+	0xc5, 0x03, 0x60, 0xfb, 0x30, 0xbe, 0x1e, 0x13,
+	0x3e, 0x2b, 0x80, 0x7c, 0x4a, 0xd8, 0xb3, 0x2c,
+	0xec, 0xb7, 0x31, 0xdb, 0x30, 0x2c, 0x3e, 0x15,
+	0x3b, 0x98, 0x9e, 0xff, 0xf8, 0x52, 0x2a, 0x32,
+	0x3a, 0xdb, 0xa8, 0x70, 0xe4, 0xb5, 0x3f, 0x8c,
+	0xe6, 0x5f, 0xe6, 0x71, 0x3d, 0xbd, 0x5e, 0x84,
+	0x02, 0x75, 0xe9, 0xb4, 0x84, 0x0e, 0x3d, 0x4c,
+	0xaf, 0xea, 0x44
+};
+
+/** Server RSA modulus */
+static const uint8_t tls_test_modulus[] = {
+	0xa9, 0xf5, 0x61, 0xd9, 0xca, 0x5f, 0x61, 0x54,
+	0x4b, 0x71, 0x7e, 0x89, 0x1b, 0x94, 0x59, 0x47,
+	0xf3, 0xcd, 0x92, 0x2b, 0x42, 0x70, 0x30, 0x9e,
+	0x57, 0x39, 0xd6, 0x58, 0x3c, 0x66, 0xcd, 0x35,
+	0xf3, 0x8e, 0x42, 0xea, 0x82, 0xe8, 0x77, 0x19,
+	0x2e, 0x79, 0x85, 0x21, 0x2e, 0xc9, 0xd2, 0x1e,
+	0x75, 0x2e, 0x55, 0xc0, 0x57, 0x27, 0x6c, 0x0b,
+	0x6b, 0x6d, 0x58, 0x63, 0xf8, 0xaa, 0xfa, 0x70,
+	0xe4, 0x7c, 0x33, 0x31, 0x10, 0x15, 0xbd, 0xdc,
+	0x89, 0x59, 0x57, 0xbe, 0x48, 0xb6, 0x53, 0xba,
+	0x2b, 0x81, 0x06, 0xc6, 0x5f, 0xae, 0xa1, 0xe9,
+	0x3c, 0xfc, 0xc4, 0x90, 0x6c, 0xa6, 0xeb, 0xa3,
+	0x51, 0xfc, 0x9b, 0x6c, 0x32, 0xc5, 0x4e, 0x65,
+	0xdd, 0xec, 0x78, 0xec, 0xc5, 0x88, 0xad, 0xa0,
+	0x53, 0xaf, 0xc0, 0x57, 0xdf, 0x97, 0xdb, 0x6b,
+	0x93, 0xef, 0xea, 0x6c, 0x29, 0x9a, 0x28, 0x2f
+};
+
+/** Server RSA public exponent */
+static const uint8_t tls_test_exponent[] = { 0x01, 0x00, 0x01 };
+
+/** Server RSA private exponent */
+static const uint8_t tls_test_private[] = {
+	0x39, 0x10, 0x3e, 0x4e, 0x55, 0x78, 0x38, 0xc1,
+	0x88, 0xa3, 0x0e, 0x8d, 0x12, 0x49, 0x78, 0xc0,
+	0x83, 0xc7, 0x1d, 0xb0, 0x90, 0x9a, 0x02, 0x78,
+	0xe7, 0x68, 0x6f, 0xe3, 0x28, 0x44, 0x8b, 0xd9,
+	0xf5, 0x70, 0x6a, 0x5f, 0x3a, 0x9c, 0xba, 0x80,
+	0x25, 0xee, 0x7f, 0x18, 0x69, 0x11, 0x32, 0x0f,
+	0x2f, 0xe0, 0xe2, 0xc1, 0xb5, 0x81, 0x72, 0xf1,
+	0x52, 0x9c, 0x5f, 0xf5, 0x10, 0xe4, 0xb7, 0x38,
+	0xeb, 0xc5, 0x8c, 0xfb, 0x9e, 0xa4, 0x90, 0x44,
+	0x5c, 0x5e, 0x97, 0x30, 0x45, 0x92, 0x20, 0xd5,
+	0x82, 0xa8, 0xee, 0x32, 0xcb, 0x32, 0x6e, 0xdb,
+	0x4f, 0x10, 0xc9, 0xbf, 0xbb, 0x53, 0xa0, 0x38,
+	0xcf, 0x37, 0x92, 0xf8, 0x6c, 0xb0, 0x28, 0x15,
+	0x37, 0x39, 0x6d, 0x98, 0x0b, 0x79, 0x8c, 0x7e,
+	0xd1, 0x97, 0xca, 0x24, 0x9e, 0x45, 0xc8, 0xb0,
+	0x91, 0x04, 0x90, 0x4d, 0x85, 0xb7, 0x6c, 0x61
+};
+
+/** Server session ID */
+static const uint8_t tls_test_session_id[] = {
+	0x5e, 0x55, 0x10, 0x4e, 0x1d, 0x00, 0x00, 0x01
+};
+
+/** Application data sent by the client */
+static const char tls_test_request[] = "GET / HTTP/1.1\r\n\r\n";
+
+/** Application data sent by the server */
+static const char tls_test_response[] = "HTTP/1.1 204 No Content\r\n\r\n";
+
+/** Key block (TLS_RSA_WITH_AES_128_GCM_SHA256) */
+struct tls_test_keys {
+	uint8_t client_key[16];
+	uint8_t server_key[16];
+	uint8_t client_iv[TLS_FIXED_IV_LEN];
+	uint8_t server_iv[TLS_FIXED_IV_LEN];
+} __attribute__ (( packed ));
+
+/** Test server */
+struct tls_test_server {
+	/** Ciphertext stream, plugged into the TLS session */
+	struct xfer_interface xfer;
+	/** Data received from client */
+	uint8_t rx[1024];
+	/** Length of data received from client */
+	size_t rx_len;
+	/** Client has changed cipher */
+	int rx_encrypted;
+	/** Handshake transcript hash */
+	uint8_t transcript[SHA256_CTX_SIZE];
+	/** Client random bytes */
+	uint8_t client_random[32];
+	/** Server random bytes */
+	uint8_t server_random[32];
+	/** Master secret */
+	uint8_t master_secret[48];
+	/** Key block */
+	struct tls_test_keys keys;
+	/** Receive sequence number */
+	uint64_t rx_seq;
+	/** Transmit sequence number */
+	uint64_t tx_seq;
+	/** Interface has been closed */
+	int closed;
+};
+
+/** Test application */
+struct tls_test_app {
+	/** Plaintext stream, plugged into the TLS session */
+	struct xfer_interface xfer;
+	/** Data received from server */
+	uint8_t rx[64];
+	/** Length of data received from server */
+	size_t rx_len;
+	/** Interface has been closed */
+	int closed;
+};
+
+static void tls_test_server_close ( struct xfer_interface *xfer,
+				    int rc __unused ) {
+	struct tls_test_server *server =
+		container_of ( xfer, struct tls_test_server, xfer );
+
+	server->closed = 1;
+	xfer_nullify ( xfer );
+	xfer_unplug ( xfer );
+}
+
+static int tls_test_server_deliver_raw ( struct xfer_interface *xfer,
+					 const void *data, size_t len ) {
+	struct tls_test_server *server =
+		container_of ( xfer, struct tls_test_server, xfer );
+
+	if ( len > ( sizeof ( server->rx ) - server->rx_len ) )
+		return -ENOBUFS;
+	memcpy ( &server->rx[server->rx_len], data, len );
+	server->rx_len += len;
+	return 0;
+}
+
+static struct xfer_interface_operations tls_test_server_operations = {
+	.close		= tls_test_server_close,
+	.vredirect	= ignore_xfer_vredirect,
+	.window		= unlimited_xfer_window,
+	.alloc_iob	= default_xfer_alloc_iob,
+	.deliver_iob	= xfer_deliver_as_raw,
+	.deliver_raw	= tls_test_server_deliver_raw,
+};
+
+static void tls_test_app_close ( struct xfer_interface *xfer,
+				 int rc __unused ) {
+	struct tls_test_app *app =
+		container_of ( xfer, struct tls_test_app, xfer );
+
+	app->closed = 1;
+	xfer_nullify ( xfer );
+	xfer_unplug ( xfer );
+}
+
+static int tls_test_app_deliver_raw ( struct xfer_interface *xfer,
+				      const void *data, size_t len ) {
+	struct tls_test_app *app =
+		container_of ( xfer, struct tls_test_app, xfer );
+
+	if ( len > ( sizeof ( app->rx ) - app->rx_len ) )
+		return -ENOBUFS;
+	memcpy ( &app->rx[app->rx_len], data, len );
+	app->rx_len += len;
+	return 0;
+}
+
+static struct xfer_interface_operations tls_test_app_operations = {
+	.close		= tls_test_app_close,
+	.vredirect	= ignore_xfer_vredirect,
+	.window		= unlimited_xfer_window,
+	.alloc_iob	= default_xfer_alloc_iob,
+	.deliver_iob	= xfer_deliver_as_raw,
+	.deliver_raw	= tls_test_app_deliver_raw,
+};
+
+static void tls_test_hmac ( const void *secret, size_t secret_len,
+			    const void *a, size_t a_len,
+			    const void *b, size_t b_len, void *out ) {
+	struct digest_algorithm *digest = &sha256_algorithm;
+	uint8_t ctx[SHA256_CTX_SIZE];
+	uint8_t key[secret_len];
+	size_t key_len = secret_len;
+
+	memcpy ( key, secret, secret_len );
+	hmac_init ( digest, ctx, key, &key_len );
+	hmac_update ( digest, ctx, a, a_len );
+	hmac_update ( digest, ctx, b, b_len );
+	hmac_final ( digest, ctx, key, &key_len, out );
+}
+
+static void tls_test_prf ( const void *secret, size_t secret_len,
+			   const char *label, const void *seed_a,
+			   size_t seed_a_len, const void *seed_b,
+			   size_t seed_b_len, void *out, size_t out_len ) {
+	size_t label_len = strlen ( label );
+	uint8_t seed[ label_len + seed_a_len + seed_b_len ];
+	uint8_t a[SHA256_DIGEST_SIZE];
+	uint8_t frag[SHA256_DIGEST_SIZE];
+	size_t frag_len;
+
+	memcpy ( seed, label, label_len );
+	memcpy ( &seed[label_len], seed_a, seed_a_len );
+	memcpy ( &seed[ label_len + seed_a_len ], seed_b, seed_b_len );
+
+	/* P_SHA256 ( secret, label + seed ) */
+	tls_test_hmac ( secret, secret_len, seed, sizeof ( seed ),
+			NULL, 0, a );
+	while ( out_len ) {
+		tls_test_hmac ( secret, secret_len, a, sizeof ( a ),
+				seed, sizeof ( seed ), frag );
+		frag_len = ( ( out_len < sizeof ( frag ) ) ?
+			     out_len : sizeof ( frag ) );
+		memcpy ( out, frag, frag_len );
+		out += frag_len;
+		out_len -= frag_len;
+		tls_test_hmac ( secret, secret_len, a, sizeof ( a ),
+				NULL, 0, a );
+	}
+}
+
+static void tls_test_finished ( struct tls_test_server *server,
+				const char *label, void *verify_data ) {
+	uint8_t ctx[SHA256_CTX_SIZE];
+	uint8_t hash[SHA256_DIGEST_SIZE];
+
+	memcpy ( ctx, server->transcript, sizeof ( ctx ) );
+	digest_final ( &sha256_algorithm, ctx, hash );
+	tls_test_prf ( server->master_secret, sizeof ( server->master_secret ),
+		       label, hash, sizeof ( hash ), NULL, 0, verify_data, 12 );
+}
+
+static void tls_test_gcm ( const void *key, const void *fixed_iv,
+			   uint64_t seq, unsigned int type, int decrypt,
+			   const void *src, void *dst, size_t len,
+			   void *auth ) {
+	struct cipher_algorithm *cipher = &aes_gcm_algorithm;
+	uint8_t ctx[cipher->ctxsize];
+	struct tls_auth_nonce nonce;
+	struct tls_auth_header authhdr;
+
+	memcpy ( nonce.fixed, fixed_iv, sizeof ( nonce.fixed ) );
+	nonce.record = cpu_to_be64 ( seq );
+	authhdr.seq = cpu_to_be64 ( seq );
+	authhdr.tlshdr.type = type;
+	authhdr.tlshdr.version = htons ( TLS_VERSION_TLS_1_2 );
+	authhdr.tlshdr.length = htons ( len );
+	cipher_setkey ( cipher, ctx, key, 16 );
+	cipher_setiv ( cipher, ctx, &nonce );
+	cipher_encrypt ( cipher, ctx, &authhdr, NULL, sizeof ( authhdr ) );
+	if ( decrypt ) {
+		cipher_decrypt ( cipher, ctx, src, dst, len );
+	} else {
+		cipher_encrypt ( cipher, ctx, src, dst, len );
+	}
+	cipher_auth ( cipher, ctx, auth );
+}
+
+/**
+ * Receive record from client
+ *
+ * @v server		Test server
+ * @v type		Expected record type
+ * @v data		Buffer for plaintext
+ * @v len		Length of buffer
+ * @ret len		Length of plaintext, or negative if no valid record
+ */
+static int tls_test_server_rx ( struct tls_test_server *server,
+				unsigned int type, void *data, size_t len ) {
+	struct tls_header *tlshdr = ( ( void * ) server->rx );
+	uint8_t *record = ( server->rx + sizeof ( *tlshdr ) );
+	uint8_t auth[GCM_AUTH_LEN];
+	size_t record_len;
+	int rc = -1;
+
+	/* Extract record */
+	if ( server->rx_len < sizeof ( *tlshdr ) )
+		return -1;
+	record_len = ntohs ( tlshdr->length );
+	if ( ( server->rx_len < ( sizeof ( *tlshdr ) + record_len ) ) ||
+	     ( tlshdr->type != type ) )
+		return -1;
+
+	/* Decrypt record, if applicable */
+	if ( server->rx_encrypted ) {
+		if ( record_len < ( sizeof ( uint64_t ) + sizeof ( auth ) ) )
+			return -1;
+		record += sizeof ( uint64_t );
+		record_len -= ( sizeof ( uint64_t ) + sizeof ( auth ) );
+		if ( record_len <= len ) {
+			tls_test_gcm ( server->keys.client_key,
+				       server->keys.client_iv,
+				       server->rx_seq++, type, 1, record,
+				       data, record_len, auth );
+			if ( memcmp ( auth, ( record + record_len ),
+				      sizeof ( auth ) ) == 0 )
+				rc = record_len;
+		}
+	} else {
+		if ( record_len <= len ) {
+			memcpy ( data, record, record_len );
+			rc = record_len;
+		}
+	}
+
+	/* Consume record */
+	record_len = ( sizeof ( *tlshdr ) + ntohs ( tlshdr->length ) );
+	server->rx_len -= record_len;
+	memmove ( server->rx, ( server->rx + record_len ), server->rx_len );
+	return rc;
+}
+
+/**
+ * Send record to client
+ *
+ * @v server		Test server
+ * @v type		Record type
+ * @v encrypt		Encrypt record
+ * @v data		Plaintext
+ * @v len		Length of plaintext
+ * @ret rc		Return status code
+ */
+static int tls_test_server_tx ( struct tls_test_server *server,
+				unsigned int type, int encrypt,
+				const void *data, size_t len ) {
+	struct {
+		struct tls_header tlshdr;
+		uint8_t payload[ sizeof ( uint64_t ) + len + GCM_AUTH_LEN ];
+	} __attribute__ (( packed )) record;
+	uint64_t nonce;
+	size_t payload_len = len;
+
+	if ( encrypt ) {
+		nonce = cpu_to_be64 ( server->tx_seq );
+		memcpy ( record.payload, &nonce, sizeof ( nonce ) );
+		tls_test_gcm ( server->keys.server_key, server->keys.server_iv,
+			       server->tx_seq++, type, 0, data,
+			       &record.payload[ sizeof ( nonce ) ], len,
+			       &record.payload[ sizeof ( nonce ) + len ] );
+		payload_len = sizeof ( record.payload );
+	} else {
+		memcpy ( record.payload, data, len );
+	}
+	record.tlshdr.type = type;
+	record.tlshdr.version = htons ( TLS_VERSION_TLS_1_2 );
+	record.tlshdr.length = htons ( payload_len );
+	return xfer_deliver_raw ( &server->xfer, &record,
+				  ( sizeof ( record.tlshdr ) + payload_len ) );
+}
+
+static void tls_test_handshake_msg ( struct tls_test_server *server,
+				     uint8_t **pos, unsigned int type,
+				     const void *data, size_t len ) {
+	uint8_t *msg = *pos;
+
+	msg[0] = type;
+	msg[1] = ( len >> 16 );
+	msg[2] = ( len >> 8 );
+	msg[3] = len;
+	memcpy ( &msg[4], data, len );
+	digest_update ( &sha256_algorithm, server->transcript, msg,
+			( len + 4 ) );
+	*pos += ( len + 4 );
+}
+
+static void tls_test_step ( void ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < 16 ; i++ )
+		step();
+}
+
+static int tls_test_run ( void ) {
+	struct tls_test_server server;
+	struct tls_test_app app;
+	struct xfer_interface *cipherstream;
+	uint8_t buf[ sizeof ( tls_test_cert ) + 128 ];
+	uint8_t verify_data[12];
+	uint8_t premaster[128];
+	uint8_t *pos;
+	RSA_CTX *rsa;
+	int len;
+	int ok = 0;
+
+	/* Connect client to test server */
+	memset ( &server, 0, sizeof ( server ) );
+	memset ( &app, 0, sizeof ( app ) );
+	xfer_init ( &server.xfer, &tls_test_server_operations, NULL );
+	xfer_init ( &app.xfer, &tls_test_app_operations, NULL );
+	digest_init ( &sha256_algorithm, server.transcript );
+	if ( add_tls ( &app.xfer, "tls.test", &cipherstream ) != 0 )
+		return 0;
+	xfer_plug_plug ( &server.xfer, cipherstream );
+	RSA_priv_key_new ( &rsa, tls_test_modulus, sizeof ( tls_test_modulus ),
+			   tls_test_exponent, sizeof ( tls_test_exponent ),
+			   tls_test_private, sizeof ( tls_test_private ) );
+
+	/* Receive Client Hello */
+	tls_test_step();
+	len = tls_test_server_rx ( &server, TLS_TYPE_HANDSHAKE,
+				   buf, sizeof ( buf ) );
+	if ( ( len < ( 4 + 2 + 32 ) ) || ( buf[0] != TLS_CLIENT_HELLO ) )
+		goto done;
+	memcpy ( server.client_random, &buf[ 4 + 2 ],
+		 sizeof ( server.client_random ) );
+	digest_update ( &sha256_algorithm, server.transcript, buf, len );
+
+	/* Send Server Hello, Certificate and Server Hello Done,
+	 * selecting the GCM cipher suite
+	 */
+	memset ( server.server_random, 0x5a, sizeof ( server.server_random ) );
+	pos = buf;
+	{
+		struct {
+			uint16_t version;
+			uint8_t random[32];
+			uint8_t session_id_len;
+			uint8_t session_id[ sizeof ( tls_test_session_id ) ];
+			uint16_t cipher_suite;
+			uint8_t compression_method;
+		} __attribute__ (( packed )) hello;
+
+		hello.version = htons ( TLS_VERSION_TLS_1_2 );
+		memcpy ( hello.random, server.server_random,
+			 sizeof ( hello.random ) );
+		hello.session_id_len = sizeof ( hello.session_id );
+		memcpy ( hello.session_id, tls_test_session_id,
+			 sizeof ( hello.session_id ) );
+		hello.cipher_suite = htons ( TLS_RSA_WITH_AES_128_GCM_SHA256 );
+		hello.compression_method = 0;
+		tls_test_handshake_msg ( &server, &pos, TLS_SERVER_HELLO,
+					 &hello, sizeof ( hello ) );
+	}
+	{
+		struct {
+			uint8_t length[3];
+			uint8_t cert_length[3];
+			uint8_t cert[ sizeof ( tls_test_cert ) ];
+		} __attribute__ (( packed )) certificate;
+
+		certificate.length[0] = 0;
+		certificate.length[1] = ( ( sizeof ( tls_test_cert ) + 3 ) >> 8 );
+		certificate.length[2] = ( ( sizeof ( tls_test_cert ) + 3 ) & 0xff );
+		certificate.cert_length[0] = 0;
+		certificate.cert_length[1] = ( sizeof ( tls_test_cert ) >> 8 );
+		certificate.cert_length[2] = ( sizeof ( tls_test_cert ) & 0xff );
+		memcpy ( certificate.cert, tls_test_cert,
+			 sizeof ( certificate.cert ) );
+		tls_test_handshake_msg ( &server, &pos, TLS_CERTIFICATE,
+					 &certificate, sizeof ( certificate ) );
+	}
+	tls_test_handshake_msg ( &server, &pos, TLS_SERVER_HELLO_DONE,
+				 NULL, 0 );
+	if ( tls_test_server_tx ( &server, TLS_TYPE_HANDSHAKE, 0,
+				  buf, ( pos - buf ) ) != 0 )
+		goto done;
+
+	/* Receive Client Key Exchange and derive keys */
+	tls_test_step();
+	len = tls_test_server_rx ( &server, TLS_TYPE_HANDSHAKE,
+				   buf, sizeof ( buf ) );
+	if ( ( len != ( 4 + 2 + sizeof ( tls_test_modulus ) ) ) ||
+	     ( buf[0] != TLS_CLIENT_KEY_EXCHANGE ) )
+		goto done;
+	digest_update ( &sha256_algorithm, server.transcript, buf, len );
+	if ( RSA_decrypt ( rsa, &buf[ 4 + 2 ], premaster, 1 ) != 48 )
+		goto done;
+	tls_test_prf ( premaster, 48, "master secret",
+		       server.client_random, sizeof ( server.client_random ),
+		       server.server_random, sizeof ( server.server_random ),
+		       server.master_secret, sizeof ( server.master_secret ) );
+	tls_test_prf ( server.master_secret, sizeof ( server.master_secret ),
+		       "key expansion",
+		       server.server_random, sizeof ( server.server_random ),
+		       server.client_random, sizeof ( server.client_random ),
+		       &server.keys, sizeof ( server.keys ) );
+
+	/* Receive Change Cipher and Finished */
+	len = tls_test_server_rx ( &server, TLS_TYPE_CHANGE_CIPHER,
+				   buf, sizeof ( buf ) );
+	if ( ( len != 1 ) || ( buf[0] != 1 ) )
+		goto done;
+	server.rx_encrypted = 1;
+	len = tls_test_server_rx ( &server, TLS_TYPE_HANDSHAKE,
+				   buf, sizeof ( buf ) );
+	tls_test_finished ( &server, "client finished", verify_data );
+	if ( ( len != ( 4 + sizeof ( verify_data ) ) ) ||
+	     ( buf[0] != TLS_FINISHED ) ||
+	     ( memcmp ( &buf[4], verify_data, sizeof ( verify_data ) ) != 0 ))
+		goto done;
+	digest_update ( &sha256_algorithm, server.transcript, buf, len );
+
+	/* Send Change Cipher and Finished */
+	buf[0] = 1;
+	if ( tls_test_server_tx ( &server, TLS_TYPE_CHANGE_CIPHER, 0,
+				  buf, 1 ) != 0 )
+		goto done;
+	tls_test_finished ( &server, "server finished", verify_data );
+	pos = buf;
+	tls_test_handshake_msg ( &server, &pos, TLS_FINISHED, verify_data,
+				 sizeof ( verify_data ) );
+	if ( tls_test_server_tx ( &server, TLS_TYPE_HANDSHAKE, 1,
+				  buf, ( pos - buf ) ) != 0 )
+		goto done;
+
+	/* Handshake is complete once the application may send data */
+	tls_test_step();
+	if ( ! xfer_window ( &app.xfer ) )
+		goto done;
+
+	/* Exchange application data */
+	if ( xfer_deliver_raw ( &app.xfer, tls_test_request,
+				strlen ( tls_test_request ) ) != 0 )
+		goto done;
+	len = tls_test_server_rx ( &server, TLS_TYPE_DATA,
+				   buf, sizeof ( buf ) );
+	if ( ( len != ( int ) strlen ( tls_test_request ) ) ||
+	     ( memcmp ( buf, tls_test_request, len ) != 0 ) )
+		goto done;
+	if ( tls_test_server_tx ( &server, TLS_TYPE_DATA, 1,
+				  tls_test_response,
+				  strlen ( tls_test_response ) ) != 0 )
+		goto done;
+	if ( ( app.rx_len != strlen ( tls_test_response ) ) ||
+	     ( memcmp ( app.rx, tls_test_response, app.rx_len ) != 0 ) )
+		goto done;
+
+	ok = ( ! ( server.closed || app.closed ) );
+
+ done:
+	RSA_free ( rsa );
+	xfer_close ( &app.xfer, 0 );
+	xfer_unplug ( &app.xfer );
+	xfer_unplug ( &server.xfer );
+	return ok;
+}
+
+void tls_test ( void ) {
+	int ok;
+
+	ok = tls_test_run();
+	printf ( "TLSv1.2 AES-128-GCM handshake: %s\n",
+		 ( ok ? "ok" : "FAILED" ) );
+}
@@ -0,0 +1,247 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <gpxe/iobuf.h>
+#include <gpxe/crc32.h>
+#include <gpxe/net80211.h>
+
+/*
+ * WPA data path known-answer tests
+ *
+ * Checks the CRC32 used for WEP and TKIP integrity check values, the
+ * CCMP test vector from IEEE 802.11-2007 Annex M.6.4, an
+ * independently calculated CCMP vector long enough to span several
+ * groups of counter blocks, and a TKIP frame as encrypted by the
+ * original byte-oriented TKIP implementation.  Each encrypted frame
+ * is also decrypted again.
+ *
+ */
+
+extern struct net80211_crypto ccmp_crypto;
+extern struct net80211_crypto tkip_crypto;
+
+/** CCMP temporal key */
+static const uint8_t wpa_test_ccmp_key[] = {
+	0xc9, 0x7c, 0x1f, 0x67, 0xce, 0x37, 0x11, 0x85,
+	0x51, 0x4a, 0x8a, 0x19, 0xf2, 0xbd, 0xd5, 0x2f
+};
+
+/** CCMP receive sequence counter preceding the Annex M.6.4 frame */
+static const uint8_t wpa_test_ccmp_rsc[] = {
+	0x0b, 0xe7, 0x76, 0x97, 0x03, 0xb5
+};
+
+/** CCMP Annex M.6.4 encrypted frame */
+static const uint8_t wpa_test_ccmp_spec_frame[] = {
+	0x08, 0x48, 0xc3, 0x2c, 0x0f, 0xd2, 0xe1, 0x28,
+	0xa5, 0x7c, 0x50, 0x30, 0xf1, 0x84, 0x44, 0x08,
+	0xab, 0xae, 0xa5, 0xb8, 0xfc, 0xba, 0x80, 0x33,
+	0x0c, 0xe7, 0x00, 0x20, 0x76, 0x97, 0x03, 0xb5,
+	0xf3, 0xd0, 0xa2, 0xfe, 0x9a, 0x3d, 0xbf, 0x23,
+	0x42, 0xa6, 0x43, 0xe4, 0x32, 0x46, 0xe8, 0x0c,
+	0x3c, 0x04, 0xd0, 0x19, 0x78, 0x45, 0xce, 0x0b,
+	0x16, 0xf9, 0x76, 0x23
+};
+
+/** CCMP Annex M.6.4 plaintext frame */
+static const uint8_t wpa_test_ccmp_spec_plain[] = {
+	0x08, 0x08, 0xc3, 0x2c, 0x0f, 0xd2, 0xe1, 0x28,
+	0xa5, 0x7c, 0x50, 0x30, 0xf1, 0x84, 0x44, 0x08,
+	0xab, 0xae, 0xa5, 0xb8, 0xfc, 0xba, 0x80, 0x33,
+	0xf8, 0xba, 0x1a, 0x55, 0xd0, 0x2f, 0x85, 0xae,
+	0x96, 0x7b, 0xb6, 0x2f, 0xb6, 0xcd, 0xa8, 0xeb,
+	0x7e, 0x78, 0xa0, 0x50
+};
+
+/** CCMP encrypted frame (packet number 1, 100-byte payload) */
+static const uint8_t wpa_test_ccmp_long_frame[] = {
+	0x08, 0x48, 0xc3, 0x2c, 0x0f, 0xd2, 0xe1, 0x28,
+	0xa5, 0x7c, 0x50, 0x30, 0xf1, 0x84, 0x44, 0x08,
+	0xab, 0xae, 0xa5, 0xb8, 0xfc, 0xba, 0x80, 0x33,
+	0x01, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00,
+	0x5d, 0x9c, 0xb0, 0x03, 0xee, 0xaf, 0x58, 0xf8,
+	0x9f, 0xd4, 0xdb, 0xbb, 0xe3, 0xb9, 0x92, 0x95,
+	0x7e, 0xa4, 0xab, 0x76, 0xac, 0xfb, 0x9c, 0xdf,
+	0x62, 0x4e, 0x08, 0x54, 0x6c, 0xa1, 0xf3, 0x35,
+	0xd2, 0xf4, 0x4b, 0xb0, 0x10, 0xd1, 0xb5, 0xc3,
+	0x19, 0x6c, 0xaa, 0x4b, 0xb4, 0x7b, 0x79, 0x3b,
+	0xbc, 0x50, 0xa7, 0x16, 0x44, 0xeb, 0x69, 0x47,
+	0xef, 0x02, 0x1b, 0x4f, 0x04, 0xdc, 0x7d, 0x55,
+	0x75, 0xa0, 0xe2, 0x6c, 0xd0, 0x61, 0xdc, 0xa3,
+	0x64, 0x54, 0x31, 0xe8, 0x8c, 0xde, 0xb4, 0x85,
+	0x9c, 0x72, 0x2c, 0x5f, 0xa2, 0x38, 0xf3, 0x0d,
+	0x3b, 0xc6, 0x4d, 0xc8, 0x6f, 0xd2, 0xf0, 0xcd,
+	0x18, 0xb3, 0x56, 0xc6, 0xa2, 0x6f, 0x20, 0x31,
+	0x8c, 0xfa, 0xd0, 0xd7
+};
+
+/** TKIP temporal key (with identical RX and TX MIC keys) */
+static const uint8_t wpa_test_tkip_key[] = {
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+	0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+	0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+	0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17
+};
+
+/** TKIP encrypted frame (sequence counter 1, 45-byte payload) */
+static const uint8_t wpa_test_tkip_frame[] = {
+	0x08, 0x41, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+	0x00, 0x01, 0x02, 0x00, 0x00, 0x00, 0x00, 0x01,
+	0x02, 0x00, 0x00, 0x00, 0x00, 0x01, 0x10, 0x00,
+	0x00, 0x20, 0x01, 0x20, 0x00, 0x00, 0x00, 0x00,
+	0x6b, 0x12, 0xb5, 0x58, 0xf8, 0xf5, 0x30, 0xa0,
+	0xb0, 0x1b, 0xa9, 0x8d, 0xc6, 0xc9, 0x9b, 0x17,
+	0xd9, 0x0b, 0x7a, 0x3f, 0x13, 0xc2, 0x2c, 0xf3,
+	0x99, 0x4f, 0x5d, 0x00, 0x0f, 0xb7, 0x51, 0xa3,
+	0xf7, 0x78, 0xe8, 0x1e, 0xf3, 0x8a, 0x22, 0x8c,
+	0xb1, 0x07, 0x95, 0x4f, 0xe9, 0x61, 0xb4, 0xdd,
+	0xa0, 0x2d, 0xed, 0x2a, 0x8d, 0x32, 0x03, 0x6c,
+	0x6d
+};
+
+/** TKIP plaintext frame header (all addresses identical) */
+static const uint8_t wpa_test_tkip_header[] = {
+	0x08, 0x01, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+	0x00, 0x01, 0x02, 0x00, 0x00, 0x00, 0x00, 0x01,
+	0x02, 0x00, 0x00, 0x00, 0x00, 0x01, 0x10, 0x00
+};
+
+/** Header of the long CCMP plaintext frame */
+static const uint8_t wpa_test_ccmp_long_header[] = {
+	0x08, 0x08, 0xc3, 0x2c, 0x0f, 0xd2, 0xe1, 0x28,
+	0xa5, 0x7c, 0x50, 0x30, 0xf1, 0x84, 0x44, 0x08,
+	0xab, 0xae, 0xa5, 0xb8, 0xfc, 0xba, 0x80, 0x33
+};
+
+static struct net80211_crypto *
+wpa_test_install ( struct net80211_crypto *template, const void *key,
+		   int keylen, const void *rsc ) {
+	struct net80211_crypto *crypto;
+
+	crypto = zalloc ( sizeof ( *crypto ) + template->priv_len );
+	if ( ! crypto )
+		return NULL;
+	memcpy ( crypto, template, sizeof ( *crypto ) );
+	crypto->priv = ( ( void * ) crypto + sizeof ( *crypto ) );
+	if ( crypto->init ( crypto, key, keylen, rsc ) != 0 ) {
+		free ( crypto );
+		return NULL;
+	}
+	return crypto;
+}
+
+static struct io_buffer * wpa_test_frame ( const void *header,
+					   const void *data, size_t len,
+					   uint8_t pattern ) {
+	struct io_buffer *iob;
+	uint8_t *payload;
+	size_t hdrlen = IEEE80211_TYP_FRAME_HEADER_LEN;
+	size_t i;
+
+	iob = alloc_iob ( hdrlen + len );
+	if ( ! iob )
+		return NULL;
+	memcpy ( iob_put ( iob, hdrlen ), header, hdrlen );
+	payload = iob_put ( iob, len );
+	for ( i = 0 ; i < len ; i++ )
+		payload[i] = ( data ? ( ( const uint8_t * ) data )[i] :
+			       ( i * pattern + 3 ) );
+	return iob;
+}
+
+static int wpa_test_match ( struct io_buffer *iob, const void *expected,
+			    size_t len ) {
+	int ok;
+
+	ok = ( iob && ( iob_len ( iob ) == len ) &&
+	       ( memcmp ( iob->data, expected, len ) == 0 ) );
+	free_iob ( iob );
+	return ok;
+}
+
+static int wpa_test_crypt ( struct net80211_crypto *template,
+			    const void *key, int keylen, const void *rsc,
+			    struct io_buffer *plain,
+			    const void *frame, size_t frame_len ) {
+	struct net80211_crypto *tx;
+	struct net80211_crypto *rx;
+	struct io_buffer *iob;
+	int ok = 0;
+
+	if ( ! plain )
+		return 0;
+	tx = wpa_test_install ( template, key, keylen, NULL );
+	rx = wpa_test_install ( template, key, keylen, rsc );
+	if ( ! ( tx && rx ) )
+		goto done;
+
+	/* Encrypt (unless starting from a given sequence counter) */
+	if ( ! rsc ) {
+		if ( ! wpa_test_match ( tx->encrypt ( tx, plain ),
+					frame, frame_len ) )
+			goto done;
+	}
+
+	/* Decrypt */
+	iob = alloc_iob ( frame_len );
+	if ( ! iob )
+		goto done;
+	memcpy ( iob_put ( iob, frame_len ), frame, frame_len );
+	ok = wpa_test_match ( rx->decrypt ( rx, iob ), plain->data,
+			      iob_len ( plain ) );
+
+	/* Check that a corrupted frame is rejected */
+	( ( uint8_t * ) iob->data )[ frame_len - 10 ] ^= 0x01;
+	rx->init ( rx, key, keylen, rsc );
+	if ( rx->decrypt ( rx, iob ) != NULL )
+		ok = 0;
+	free_iob ( iob );
+
+ done:
+	free ( tx );
+	free ( rx );
+	free_iob ( plain );
+	return ok;
+}
+
+void wpa_test ( void ) {
+	static const char check[] = "123456789";
+	uint8_t data[1001];
+	unsigned int i;
+	int ok;
+
+	/* CRC32 */
+	for ( i = 0 ; i < sizeof ( data ) ; i++ )
+		data[i] = ( i * 13 + 5 );
+	ok = ( ( ~crc32_le ( ~0, check, strlen ( check ) ) == 0xcbf43926 ) &&
+	       ( ~crc32_le ( ~0, &data[1], ( sizeof ( data ) - 1 ) ) ==
+		 0x054e9a69 ) );
+	printf ( "CRC32: %s\n", ( ok ? "ok" : "FAILED" ) );
+
+	/* CCMP */
+	ok = wpa_test_crypt ( &ccmp_crypto, wpa_test_ccmp_key,
+			      sizeof ( wpa_test_ccmp_key ), wpa_test_ccmp_rsc,
+			      wpa_test_frame ( wpa_test_ccmp_spec_plain,
+					       &wpa_test_ccmp_spec_plain[24],
+					       20, 0 ),
+			      wpa_test_ccmp_spec_frame,
+			      sizeof ( wpa_test_ccmp_spec_frame ) );
+	printf ( "CCMP Annex M.6.4: %s\n", ( ok ? "ok" : "FAILED" ) );
+	ok = wpa_test_crypt ( &ccmp_crypto, wpa_test_ccmp_key,
+			      sizeof ( wpa_test_ccmp_key ), NULL,
+			      wpa_test_frame ( wpa_test_ccmp_long_header,
+					       NULL, 100, 7 ),
+			      wpa_test_ccmp_long_frame,
+			      sizeof ( wpa_test_ccmp_long_frame ) );
+	printf ( "CCMP long frame: %s\n", ( ok ? "ok" : "FAILED" ) );
+
+	/* TKIP */
+	ok = wpa_test_crypt ( &tkip_crypto, wpa_test_tkip_key,
+			      sizeof ( wpa_test_tkip_key ), NULL,
+			      wpa_test_frame ( wpa_test_tkip_header,
+					       NULL, 45, 7 ),
+			      wpa_test_tkip_frame,
+			      sizeof ( wpa_test_tkip_frame ) );
+	printf ( "TKIP frame: %s\n", ( ok ? "ok" : "FAILED" ) );
+}
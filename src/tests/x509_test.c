@@ -0,0 +1,329 @@
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <gpxe/asn1.h>
+#include <gpxe/x509.h>
+
+/*
+ * X.509 certificate chain validation tests
+ *
+ * Uses a two-certificate chain (a self-signed 1024-bit root and a
+ * server certificate signed with sha256WithRSAEncryption).  Checks
+ * that the chain validates against a store containing the root, that
+ * the validated server certificate is then found in the cache, and
+ * that a tampered signature or an untrusted root is rejected.
+ *
+ */
+
+/** Root certificate ("TestCA") */
+static uint8_t x509_test_ca[] = {
+	0x30, 0x82, 0x01, 0xfe, 0x30, 0x82, 0x01, 0x67,
+	0xa0, 0x03, 0x02, 0x01, 0x02, 0x02, 0x14, 0x46,
+	0x9d, 0xe3, 0xa1, 0x74, 0x76, 0x9e, 0x3a, 0x6c,
+	0x4e, 0xf5, 0xcd, 0xfc, 0xeb, 0x0c, 0xde, 0xb6,
+	0xb4, 0x87, 0x9c, 0x30, 0x0d, 0x06, 0x09, 0x2a,
+	0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x0b,
+	0x05, 0x00, 0x30, 0x11, 0x31, 0x0f, 0x30, 0x0d,
+	0x06, 0x03, 0x55, 0x04, 0x03, 0x0c, 0x06, 0x54,
+	0x65, 0x73, 0x74, 0x43, 0x41, 0x30, 0x1e, 0x17,
+	0x0d, 0x32, 0x36, 0x31, 0x30, 0x31, 0x38, 0x30,
+	0x38, 0x32, 0x34, 0x33, 0x39, 0x5a, 0x17, 0x0d,
+	0x33, 0x36, 0x31, 0x30, 0x31, 0x35, 0x30, 0x38,
+	0x32, 0x34, 0x33, 0x39, 0x5a, 0x30, 0x11, 0x31,
+	0x0f, 0x30, 0x0d, 0x06, 0x03, 0x55, 0x04, 0x03,
+	0x0c, 0x06, 0x54, 0x65, 0x73, 0x74, 0x43, 0x41,
+	0x30, 0x81, 0x9f, 0x30, 0x0d, 0x06, 0x09, 0x2a,
+	0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x01,
+	0x05, 0x00, 0x03, 0x81, 0x8d, 0x00, 0x30, 0x81,
+	0x89, 0x02, 0x81, 0x81, 0x00, 0xa0, 0xba, 0x46,
+	0xc5, 0x1d, 0xc2, 0x4a, 0x34, 0x6f, 0xb3, 0x82,
+	0x95, 0xf8, 0x67, 0xb1, 0x1f, 0x65, 0xc5, 0x9f,
+	0xee, 0xa8, 0xcd, 0xc7, 0x77, 0xf9, 0xfa, 0xa9,
+	0xd5, 0x7d, 0x59, 0x71, 0xa4, 0x17, 0x21, 0xc0,
+	0x42, 0x55, 0xd5, 0xc4, 0x46, 0x22, 0x10, 0x4d,
+	0xbe, 0x23, 0x04, 0xa6, 0x4a, 0x0e, 0xb1, 0xa4,
+	0xed, 0xd6, 0x19, 0x07, 0xca, 0x41, 0xf0, 0x16,
+	0x13, 0x9e, 0x41, 0xf0, 0x70, 0x5e, 0x0c, 0x3c,
+	0xa9, 0x46, 0x00, 0x56, 0x84, 0xe0, 0x21, 0x4c,
+	0x2a, 0x14, 0xb0, 0x65, 0xce, 0x6c, 0x46, 0x09,
+	0x7e, 0xc2, 0x4f, 0xe5, 0x1a, 0xae, 0x54, 0x32,
+	0x99, 0x3a, 0x38, 0xe7, 0x27, 0x07, 0x56, 0x28,
+	0x73, 0x02, 0xd0, 0x8d, 0x51, 0x1b, 0x26, 0xcb,
+	0xd4, 0xc1, 0xf3, 0x75, 0x9d, 0x4f, 0xc6, 0x2b,
+	0xf3, 0x53, 0x78, 0xf1, 0xb8, 0x55, 0xad, 0x9e,
+	0x43, 0x51, 0x46, 0xf2, 0x69, 0x02, 0x03, 0x01,
+	0x00, 0x01, 0xa3, 0x53, 0x30, 0x51, 0x30, 0x1d,
+	0x06, 0x03, 0x55, 0x1d, 0x0e, 0x04, 0x16, 0x04,
+	0x14, 0x1c, 0x2b, 0xaa, 0xff, 0x30, 0x90, 0x2b,
+	0xc9, 0xed, 0xf9, 0x6a, 0xe1, 0xd5, 0x81, 0x00,
+	0x55, 0x2a, 0x13, 0xde, 0xe0, 0x30, 0x1f, 0x06,
+	0x03, 0x55, 0x1d, 0x23, 0x04, 0x18, 0x30, 0x16,
+	0x80, 0x14, 0x1c, 0x2b, 0xaa, 0xff, 0x30, 0x90,
+	0x2b, 0xc9, 0xed, 0xf9, 0x6a, 0xe1, 0xd5, 0x81,
+	0x00, 0x55, 0x2a, 0x13, 0xde, 0xe0, 0x30, 0x0f,
+	0x06, 0x03, 0x55, 0x1d, 0x13, 0x01, 0x01, 0xff,
+	0x04, 0x05, 0x30, 0x03, 0x01, 0x01, 0xff, 0x30,
+	0x0d, 0x06, 0x09, 0x2a, 0x86, 0x48, 0x86, 0xf7,
+	0x0d, 0x01, 0x01, 0x0b, 0x05, 0x00, 0x03, 0x81,
+	0x81, 0x00, 0x23, 0xad, 0xb6, 0xf5, 0xfc, 0x37,
+	0x90, 0xc1, 0x0e, 0xe4, 0xdf, 0xa5, 0xf1, 0xb8,
+	0xac, 0x16, 0xff, 0xc5, 0xe1, 0xa4, 0xdc, 0x37,
+	0xd5, 0x9d, 0xef, 0xac, 0x3f, 0xd4, 0xa2, 0xd3,
+	0x9e, 0x26, 0xa2, 0x24, 0xab, 0xb7, 0xb0, 0xdd,
+	0x2a, 0x78, 0x88, 0x66, 0xc0, 0x1f, 0x2d, 0xab,
+	0x65, 0x5c, 0x37, 0x81, 0x90, 0x28, 0xc8, 0x1a,
+	0xfd, 0xef, 0x92, 0x0d, 0x66, 0xa3, 0x9e, 0xe8,
+	0xc7, 0x01, 0x92, 0x57, 0x67, 0x52, 0xed, 0x6f,
+	0x5b, 0x5c, 0xf5, 0x14, 0x21, 0xc7, 0x07, 0xdb,
+	0xf1, 0xcf, 0x80, 0x65, 0xc5, 0x75, 0x0a, 0xf0,
+	0xad, 0x02, 0x76, 0xa0, 0xf2, 0x27, 0x94, 0xad,
+	0x77, 0xcf, 0x75, 0xe7, 0x35, 0xaa, 0x1a, 0x01,
+	0x8b, 0x64, 0x34, 0x38, 0x88, 0xb9, 0x9c, 0x27,
+	0xbd, 0xe3, 0x16, 0x8c, 0xb0, 0x71, 0xdb, 0x62,
+	0xf8, 0xbb, 0x78, 0xab, 0x42, 0x71, 0xfd, 0xfa,
+	0x1d, 0xd6
+};
+
+/** Server certificate ("leaf.example"), signed by "TestCA" */
+static uint8_t x509_test_leaf[] = {
+	0x30, 0x82, 0x01, 0xaa, 0x30, 0x82, 0x01, 0x13,
+	0x02, 0x14, 0x3e, 0x4e, 0x73, 0x72, 0x2e, 0xda,
+	0x1d, 0xcb, 0xb5, 0xb2, 0x73, 0x1f, 0x56, 0x19,
+	0xfb, 0x74, 0x97, 0x87, 0x33, 0x79, 0x30, 0x0d,
+	0x06, 0x09, 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d,
+	0x01, 0x01, 0x0b, 0x05, 0x00, 0x30, 0x11, 0x31,
+	0x0f, 0x30, 0x0d, 0x06, 0x03, 0x55, 0x04, 0x03,
+	0x0c, 0x06, 0x54, 0x65, 0x73, 0x74, 0x43, 0x41,
+	0x30, 0x1e, 0x17, 0x0d, 0x32, 0x36, 0x31, 0x30,
+	0x31, 0x38, 0x30, 0x38, 0x32, 0x34, 0x33, 0x39,
+	0x5a, 0x17, 0x0d, 0x33, 0x36, 0x31, 0x30, 0x31,
+	0x35, 0x30, 0x38, 0x32, 0x34, 0x33, 0x39, 0x5a,
+	0x30, 0x17, 0x31, 0x15, 0x30, 0x13, 0x06, 0x03,
+	0x55, 0x04, 0x03, 0x0c, 0x0c, 0x6c, 0x65, 0x61,
+	0x66, 0x2e, 0x65, 0x78, 0x61, 0x6d, 0x70, 0x6c,
+	0x65, 0x30, 0x81, 0x9f, 0x30, 0x0d, 0x06, 0x09,
+	0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01,
+	0x01, 0x05, 0x00, 0x03, 0x81, 0x8d, 0x00, 0x30,
+	0x81, 0x89, 0x02, 0x81, 0x81, 0x00, 0xc1, 0x63,
+	0x29, 0xd9, 0x9c, 0x88, 0x1f, 0x36, 0x62, 0x90,
+	0xaf, 0xcb, 0xc5, 0x19, 0x68, 0x23, 0xfa, 0x23,
+	0xa3, 0x1a, 0x4d, 0xaa, 0x74, 0xf2, 0xc1, 0xa7,
+	0x2c, 0x15, 0x2f, 0xd4, 0x55, 0x7e, 0x23, 0x96,
+	0xd0, 0x7c, 0x2d, 0xf8, 0x90, 0xde, 0x6d, 0xf3,
+	0x75, 0xe9, 0x76, 0x39, 0x9c, 0xab, 0x88, 0x14,
+	0xaa, 0x5f, 0xf2, 0x4c, 0xad, 0x65, 0xc2, 0x38,
+	0x95, 0x47, 0xdd, 0xd3, 0x9d, 0x0a, 0x0b, 0xbc,
+	0x9c, 0x8d, 0x85, 0x7b, 0xc7, 0xe8, 0xeb, 0x80,
+	0xcf, 0x2d, 0x3b, 0x38, 0x62, 0x4a, 0xaa, 0x0a,
+	0x9f, 0xdd, 0x19, 0x69, 0x79, 0x6d, 0x30, 0x10,
+	0xdf, 0x12, 0x65, 0x13, 0xfa, 0x9c, 0x93, 0x22,
+	0xb6, 0xd4, 0x24, 0xdf, 0xe0, 0x5c, 0xe5, 0x56,
+	0xb2, 0x17, 0x45, 0xb2, 0x68, 0x9b, 0x8c, 0x34,
+	0x23, 0xaa, 0x42, 0xe4, 0x89, 0x5b, 0x0f, 0x64,
+	0x12, 0xe5, 0x37, 0x4e, 0x47, 0x95, 0x02, 0x03,
+	0x01, 0x00, 0x01, 0x30, 0x0d, 0x06, 0x09, 0x2a,
+	0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x0b,
+	0x05, 0x00, 0x03, 0x81, 0x81, 0x00, 0x72, 0x0a,
+	0x3f, 0x19, 0x4e, 0xbd, 0x38, 0x9f, 0x4a, 0x5d,
+	0xac, 0x9c, 0xac, 0xe5, 0xad, 0x71, 0xb0, 0x07,
+	0x73, 0x6e, 0xd7, 0x80, 0xb2, 0xca, 0x81, 0x78,
+	0xf7, 0x64, 0xa8, 0x6a, 0x2c, 0xc4, 0xb8, 0x88,
+	0x4f, 0xa3, 0xdb, 0x7c, 0x31, 0x45, 0x73, 0xf3,
+	0x51, 0x93, 0x91, 0xf2, 0xe5, 0x35, 0xde, 0x93,
+	0x56, 0x3e, 0xc6, 0x37, 0x21, 0x66, 0x1b, 0xf0,
+	0x9b, 0x42, 0xa7, 0xde, 0xa5, 0x59, 0xd7, 0xb1,
+	0x2c, 0x35, 0x71, 0x80, 0x1c, 0x3b, 0x04, 0x39,
+	0x8c, 0x1f, 0x4c, 0xb6, 0xc3, 0x1f, 0x97, 0x67,
+	0x5c, 0x6c, 0x7d, 0x0b, 0xb9, 0xdf, 0x42, 0x75,
+	0xf2, 0x43, 0xfb, 0x7b, 0x46, 0xd9, 0x8e, 0x82,
+	0xff, 0xee, 0x0c, 0x5f, 0x68, 0x82, 0xd3, 0x5a,
+	0xd5, 0x81, 0xf6, 0xb5, 0x42, 0xaa, 0x8a, 0x5c,
+	0xb5, 0xc2, 0x97, 0x36, 0x45, 0xc3, 0x85, 0x5f,
+	0x6b, 0xf0, 0x9d, 0x34, 0x23, 0x4e
+};
+
+/** Server certificate RSA modulus */
+static const uint8_t x509_test_leaf_modulus[] = {
+	0xc1, 0x63, 0x29, 0xd9, 0x9c, 0x88, 0x1f, 0x36,
+	0x62, 0x90, 0xaf, 0xcb, 0xc5, 0x19, 0x68, 0x23,
+	0xfa, 0x23, 0xa3, 0x1a, 0x4d, 0xaa, 0x74, 0xf2,
+	0xc1, 0xa7, 0x2c, 0x15, 0x2f, 0xd4, 0x55, 0x7e,
+	0x23, 0x96, 0xd0, 0x7c, 0x2d, 0xf8, 0x90, 0xde,
+	0x6d, 0xf3, 0x75, 0xe9, 0x76, 0x39, 0x9c, 0xab,
+	0x88, 0x14, 0xaa, 0x5f, 0xf2, 0x4c, 0xad, 0x65,
+	0xc2, 0x38, 0x95, 0x47, 0xdd, 0xd3, 0x9d, 0x0a,
+	0x0b, 0xbc, 0x9c, 0x8d, 0x85, 0x7b, 0xc7, 0xe8,
+	0xeb, 0x80, 0xcf, 0x2d, 0x3b, 0x38, 0x62, 0x4a,
+	0xaa, 0x0a, 0x9f, 0xdd, 0x19, 0x69, 0x79, 0x6d,
+	0x30, 0x10, 0xdf, 0x12, 0x65, 0x13, 0xfa, 0x9c,
+	0x93, 0x22, 0xb6, 0xd4, 0x24, 0xdf, 0xe0, 0x5c,
+	0xe5, 0x56, 0xb2, 0x17, 0x45, 0xb2, 0x68, 0x9b,
+	0x8c, 0x34, 0x23, 0xaa, 0x42, 0xe4, 0x89, 0x5b,
+	0x0f, 0x64, 0x12, 0xe5, 0x37, 0x4e, 0x47, 0x95
+};
+
+/** SHA-256 fingerprint of root certificate */
+static const uint8_t x509_test_ca_fingerprint[] = {
+	0xa4, 0xd5, 0x72, 0xbb, 0xb8, 0x31, 0x77, 0x42,
+	0x8e, 0x9b, 0x70, 0x6d, 0x32, 0x4e, 0x78, 0x7a,
+	0x34, 0x97, 0x39, 0x4a, 0xf9, 0xf4, 0x42, 0x13,
+	0xd5, 0x04, 0x07, 0x5e, 0xb3, 0x1e, 0xb0, 0xb5
+};
+
+/** Trust store containing the test root certificate */
+static struct x509_root x509_test_root = {
+	.count = 1,
+	.fingerprints = x509_test_ca_fingerprint,
+};
+
+/** Trust store containing no relevant certificates */
+static const uint8_t x509_test_other_fingerprint[X509_FINGERPRINT_LEN];
+static struct x509_root x509_test_other_root = {
+	.count = 1,
+	.fingerprints = x509_test_other_fingerprint,
+};
+
+/** Certificate with subjectAltName "*.wild.test" and "exact.test"
+ *
+ * The subject commonName is "ignored.test", which must not be used
+ * since a subjectAltName is present.
+ */
+static uint8_t x509_test_alt_names[] = {
+	0x30, 0x82, 0x01, 0xab, 0x30, 0x82, 0x01, 0x55,
+	0xa0, 0x03, 0x02, 0x01, 0x02, 0x02, 0x14, 0x55,
+	0xba, 0x07, 0xc0, 0xb4, 0x55, 0x88, 0x7a, 0x11,
+	0x1b, 0x7d, 0xe0, 0x5a, 0x4f, 0x35, 0x87, 0xb4,
+	0xe8, 0xfc, 0x1f, 0x30, 0x0d, 0x06, 0x09, 0x2a,
+	0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x0b,
+	0x05, 0x00, 0x30, 0x17, 0x31, 0x15, 0x30, 0x13,
+	0x06, 0x03, 0x55, 0x04, 0x03, 0x0c, 0x0c, 0x69,
+	0x67, 0x6e, 0x6f, 0x72, 0x65, 0x64, 0x2e, 0x74,
+	0x65, 0x73, 0x74, 0x30, 0x20, 0x17, 0x0d, 0x32,
+	0x36, 0x31, 0x30, 0x31, 0x38, 0x30, 0x39, 0x30,
+	0x32, 0x31, 0x30, 0x5a, 0x18, 0x0f, 0x32, 0x31,
+	0x32, 0x36, 0x30, 0x39, 0x32, 0x34, 0x30, 0x39,
+	0x30, 0x32, 0x31, 0x30, 0x5a, 0x30, 0x17, 0x31,
+	0x15, 0x30, 0x13, 0x06, 0x03, 0x55, 0x04, 0x03,
+	0x0c, 0x0c, 0x69, 0x67, 0x6e, 0x6f, 0x72, 0x65,
+	0x64, 0x2e, 0x74, 0x65, 0x73, 0x74, 0x30, 0x5c,
+	0x30, 0x0d, 0x06, 0x09, 0x2a, 0x86, 0x48, 0x86,
+	0xf7, 0x0d, 0x01, 0x01, 0x01, 0x05, 0x00, 0x03,
+	0x4b, 0x00, 0x30, 0x48, 0x02, 0x41, 0x00, 0xcc,
+	0x5a, 0x6e, 0xe8, 0x40, 0x77, 0x65, 0x80, 0x48,
+	0x9f, 0x08, 0xa4, 0x27, 0x6d, 0x54, 0x46, 0x48,
+	0x94, 0x84, 0x02, 0x47, 0xa7, 0xed, 0xc4, 0xa7,
+	0x94, 0xa7, 0xa4, 0xa0, 0xed, 0x93, 0xdb, 0xce,
+	0x54, 0x28, 0xae, 0x5b, 0xe9, 0xc9, 0x71, 0xb6,
+	0xe3, 0xac, 0x75, 0x99, 0xdc, 0x5e, 0xda, 0x2c,
+	0x36, 0x60, 0x08, 0x2c, 0xaa, 0x03, 0xda, 0x25,
+	0xa2, 0x6c, 0x9c, 0xa1, 0xed, 0x8f, 0x4b, 0x02,
+	0x03, 0x01, 0x00, 0x01, 0xa3, 0x77, 0x30, 0x75,
+	0x30, 0x1d, 0x06, 0x03, 0x55, 0x1d, 0x0e, 0x04,
+	0x16, 0x04, 0x14, 0xec, 0xe7, 0xbf, 0xdd, 0x36,
+	0xca, 0x86, 0x45, 0x15, 0x4a, 0x39, 0x42, 0x89,
+	0x32, 0x8e, 0x19, 0x41, 0xba, 0xb7, 0xc6, 0x30,
+	0x1f, 0x06, 0x03, 0x55, 0x1d, 0x23, 0x04, 0x18,
+	0x30, 0x16, 0x80, 0x14, 0xec, 0xe7, 0xbf, 0xdd,
+	0x36, 0xca, 0x86, 0x45, 0x15, 0x4a, 0x39, 0x42,
+	0x89, 0x32, 0x8e, 0x19, 0x41, 0xba, 0xb7, 0xc6,
+	0x30, 0x0f, 0x06, 0x03, 0x55, 0x1d, 0x13, 0x01,
+	0x01, 0xff, 0x04, 0x05, 0x30, 0x03, 0x01, 0x01,
+	0xff, 0x30, 0x22, 0x06, 0x03, 0x55, 0x1d, 0x11,
+	0x04, 0x1b, 0x30, 0x19, 0x82, 0x0b, 0x2a, 0x2e,
+	0x77, 0x69, 0x6c, 0x64, 0x2e, 0x74, 0x65, 0x73,
+	0x74, 0x82, 0x0a, 0x65, 0x78, 0x61, 0x63, 0x74,
+	0x2e, 0x74, 0x65, 0x73, 0x74, 0x30, 0x0d, 0x06,
+	0x09, 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01,
+	0x01, 0x0b, 0x05, 0x00, 0x03, 0x41, 0x00, 0x0c,
+	0xfc, 0x0d, 0x99, 0xee, 0x2c, 0x01, 0x33, 0xc6,
+	0xb5, 0xda, 0x39, 0x18, 0x0a, 0xa2, 0x43, 0xdb,
+	0x8e, 0x74, 0xf4, 0x81, 0x14, 0x50, 0x55, 0x4b,
+	0xb0, 0xa1, 0xff, 0x75, 0xf7, 0x52, 0x62, 0xba,
+	0x23, 0xd7, 0xd2, 0xac, 0x6a, 0x11, 0xac, 0xca,
+	0x81, 0x20, 0x62, 0xd0, 0x2f, 0x48, 0x9a, 0xb8,
+	0x9f, 0x4e, 0x34, 0xa7, 0x89, 0x98, 0xef, 0xf3,
+	0x7f, 0xd2, 0xda, 0x49, 0x90, 0xee, 0x07
+};
+
+static int x509_test_run ( void *leaf, int include_ca,
+			   struct x509_root *root ) {
+	struct asn1_cursor chain[2];
+	struct x509_rsa_public_key rsa_pubkey;
+	const uint8_t *modulus;
+	size_t len = sizeof ( x509_test_leaf_modulus );
+	int ok;
+
+	chain[0].data = leaf;
+	chain[0].len = sizeof ( x509_test_leaf );
+	chain[1].data = x509_test_ca;
+	chain[1].len = sizeof ( x509_test_ca );
+	memset ( &rsa_pubkey, 0, sizeof ( rsa_pubkey ) );
+	if ( x509_validate_chain ( chain, ( include_ca ? 2 : 1 ), root,
+				   &rsa_pubkey ) != 0 )
+		return 0;
+
+	/* Check that the server's public key was returned */
+	modulus = ( rsa_pubkey.modulus + rsa_pubkey.modulus_len - len );
+	ok = ( ( rsa_pubkey.modulus_len >= len ) &&
+	       ( memcmp ( modulus, x509_test_leaf_modulus, len ) == 0 ) );
+	x509_free_rsa_public_key ( &rsa_pubkey );
+	return ok;
+}
+
+void x509_test ( void ) {
+	uint8_t tampered[sizeof ( x509_test_leaf )];
+	struct asn1_cursor chain[1];
+	int ok;
+
+	/* Valid chain */
+	x509_flush_cache();
+	ok = x509_test_run ( x509_test_leaf, 1, &x509_test_root );
+	printf ( "X.509 valid chain: %s\n", ( ok ? "ok" : "FAILED" ) );
+
+	/* Server certificate alone is now validated via the cache */
+	ok = x509_test_run ( x509_test_leaf, 0, &x509_test_root );
+	printf ( "X.509 cached certificate: %s\n", ( ok ? "ok" : "FAILED" ));
+
+	/* ...but not once the cache has been flushed */
+	x509_flush_cache();
+	ok = ! x509_test_run ( x509_test_leaf, 0, &x509_test_root );
+	printf ( "X.509 incomplete chain: %s\n", ( ok ? "ok" : "FAILED" ) );
+
+	/* Tampered signature */
+	memcpy ( tampered, x509_test_leaf, sizeof ( tampered ) );
+	tampered[ sizeof ( tampered ) - 1 ] ^= 0x01;
+	ok = ! x509_test_run ( tampered, 1, &x509_test_root );
+	printf ( "X.509 tampered signature: %s\n", ( ok ? "ok" : "FAILED" ) );
+
+	/* Untrusted root */
+	ok = ! x509_test_run ( x509_test_leaf, 1, &x509_test_other_root );
+	printf ( "X.509 untrusted root: %s\n", ( ok ? "ok" : "FAILED" ) );
+
+	/* Cached certificate is not trusted by a different root set */
+	x509_flush_cache();
+	x509_test_run ( x509_test_leaf, 1, &x509_test_root );
+	ok = ! x509_test_run ( x509_test_leaf, 0, &x509_test_other_root );
+	printf ( "X.509 cache root separation: %s\n",
+		 ( ok ? "ok" : "FAILED" ) );
+	x509_flush_cache();
+
+	/* Server name matching against subject commonName */
+	chain[0].data = x509_test_leaf;
+	chain[0].len = sizeof ( x509_test_leaf );
+	ok = ( ( x509_check_name ( &chain[0], "leaf.example" ) == 0 ) &&
+	       ( x509_check_name ( &chain[0], "LEAF.Example" ) == 0 ) &&
+	       ( x509_check_name ( &chain[0], "other.example" ) != 0 ) &&
+	       ( x509_check_name ( &chain[0], "leaf.example.com" ) != 0 ));
+	printf ( "X.509 common name: %s\n", ( ok ? "ok" : "FAILED" ) );
+
+	/* Server name matching against subjectAltName */
+	chain[0].data = x509_test_alt_names;
+	chain[0].len = sizeof ( x509_test_alt_names );
+	ok = ( ( x509_check_name ( &chain[0], "exact.test" ) == 0 ) &&
+	       ( x509_check_name ( &chain[0], "host.wild.test" ) == 0 ) &&
+	       ( x509_check_name ( &chain[0], "wild.test" ) != 0 ) &&
+	       ( x509_check_name ( &chain[0], "a.host.wild.test" ) != 0 ) &&
+	       ( x509_check_name ( &chain[0], "ignored.test" ) != 0 ) );
+	printf ( "X.509 subject alternative name: %s\n",
+		 ( ok ? "ok" : "FAILED" ) );
+}
@@ -32,6 +32,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <usr/dhcpmgmt.h>
 #include <usr/imgmgmt.h>
 #include <usr/autoboot.h>
+#include <config/general.h>
 
 /** @file
  *
@@ -39,6 +40,12 @@ FILE_LICENCE ( GPL2_OR_LATER );
  *
  */
 
+#ifdef AUTOBOOT_DHCP_IN_ORDER
+#define AUTOBOOT_DHCP_ORDERED 1
+#else
+#define AUTOBOOT_DHCP_ORDERED 0
+#endif
+
 /** Shutdown flags for exit */
 int shutdown_exit_flags = 0;
 
@@ -130,12 +137,12 @@ int boot_root_path ( const char *root_path ) {
 }
 
 /**
- * Boot from a network device
+ * Boot from a network device already configured via DHCP
  *
  * @v netdev		Network device
  * @ret rc		Return status code
  */
-static int netboot ( struct net_device *netdev ) {
+static int netboot_configured ( struct net_device *netdev ) {
 	struct setting vendor_class_id_setting
 		= { .tag = DHCP_VENDOR_CLASS_ID };
 	struct setting pxe_discovery_control_setting
@@ -147,14 +154,6 @@ static int netboot ( struct net_device *netdev ) {
 	unsigned int pxe_discovery_control;
 	int rc;
 
-	/* Open device and display device status */
-	if ( ( rc = ifopen ( netdev ) ) != 0 )
-		return rc;
-	ifstat ( netdev );
-
-	/* Configure device via DHCP */
-	if ( ( rc = dhcp ( netdev ) ) != 0 )
-		return rc;
 	route();
 
 	/* Try PXE menu boot, if applicable */
@@ -200,6 +199,27 @@ static int netboot ( struct net_device *netdev ) {
 	return -ENOENT;
 }
 
+/**
+ * Boot from a network device
+ *
+ * @v netdev		Network device
+ * @ret rc		Return status code
+ */
+static int netboot ( struct net_device *netdev ) {
+	int rc;
+
+	/* Open device and display device status */
+	if ( ( rc = ifopen ( netdev ) ) != 0 )
+		return rc;
+	ifstat ( netdev );
+
+	/* Configure device via DHCP */
+	if ( ( rc = dhcp ( netdev ) ) != 0 )
+		return rc;
+
+	return netboot_configured ( netdev );
+}
+
 /**
  * Close all open net devices
  *
@@ -222,19 +242,53 @@ static void close_all_netdevs ( void ) {
 void autoboot ( void ) {
 	struct net_device *boot_netdev;
 	struct net_device *netdev;
+	int *failed = NULL;
+#ifdef AUTOBOOT_PARALLEL_DHCP
+	unsigned int count;
+#endif
+	unsigned int i;
+	int tried = 0;
 
 	/* If we have an identifable boot device, try that first */
 	close_all_netdevs();
-	if ( ( boot_netdev = find_boot_netdev() ) )
+	boot_netdev = find_boot_netdev();
+#ifdef AUTOBOOT_PARALLEL_DHCP
+	/* Run DHCP on all devices at once and boot from the device
+	 * chosen.  Fall back to trying each device in turn only if
+	 * DHCP could not be run in parallel at all (e.g. for lack of
+	 * memory); devices on which parallel DHCP failed are not
+	 * retried.
+	 */
+	count = 0;
+	for_each_netdev ( netdev )
+		count++;
+	failed = zalloc ( count * sizeof ( failed[0] ) );
+	if ( failed ) {
+		if ( dhcp_any ( boot_netdev, AUTOBOOT_DHCP_ORDERED,
+				&netdev, failed ) == 0 ) {
+			boot_netdev = netdev;
+			ifstat ( boot_netdev );
+			netboot_configured ( boot_netdev );
+			tried = 1;
+		}
+		for ( i = 0 ; i < count ; i++ )
+			tried |= failed[i];
+	}
+#endif
+	if ( boot_netdev && ! tried )
 		netboot ( boot_netdev );
 
 	/* If that fails, try booting from any of the other devices */
+	i = 0;
 	for_each_netdev ( netdev ) {
+		if ( failed && failed[i++] )
+			continue;
 		if ( netdev == boot_netdev )
 			continue;
 		close_all_netdevs();
 		netboot ( netdev );
 	}
+	free ( failed );
 
 	printf ( "No more network devices\n" );
 }
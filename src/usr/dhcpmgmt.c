@@ -20,9 +20,15 @@ FILE_LICENCE ( GPL2_OR_LATER );
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <errno.h>
+#include <console.h>
+#include <gpxe/keys.h>
+#include <gpxe/timer.h>
 #include <gpxe/netdevice.h>
+#include <gpxe/settings.h>
 #include <gpxe/dhcp.h>
+#include <gpxe/job.h>
 #include <gpxe/monojob.h>
 #include <gpxe/process.h>
 #include <usr/ifmgmt.h>
@@ -66,6 +72,316 @@ int dhcp ( struct net_device *netdev ) {
 	return rc;
 }
 
+/** Top-level settings blocks which may be registered by DHCP */
+static const char *dhcp_global_settings[] = {
+	PROXYDHCP_SETTINGS_NAME,
+	PXEBS_SETTINGS_NAME,
+};
+
+/** Number of top-level settings blocks which may be registered by DHCP */
+#define DHCP_GLOBAL_SETTINGS \
+	( sizeof ( dhcp_global_settings ) / sizeof ( dhcp_global_settings[0] ) )
+
+/** A DHCP attempt on one of several network devices */
+struct dhcp_attempt {
+	/** Job control interface */
+	struct job_interface job;
+	/** Network device */
+	struct net_device *netdev;
+	/** Position of network device in registration order */
+	unsigned int index;
+	/** Time at which we started waiting for link-up */
+	unsigned long start;
+	/** DHCP has been started */
+	int started;
+	/** Return status code, or -EINPROGRESS */
+	int rc;
+	/** Most recently seen top-level settings blocks
+	 *
+	 * This array is shared between all attempts.
+	 */
+	struct settings **latest;
+	/** Top-level settings blocks registered by this attempt */
+	struct settings *globals[DHCP_GLOBAL_SETTINGS];
+};
+
+/**
+ * Replace settings block pointer
+ *
+ * @v ptr		Settings block pointer to update
+ * @v settings		New settings block, or NULL
+ */
+static void dhcp_settings_replace ( struct settings **ptr,
+				    struct settings *settings ) {
+	if ( settings )
+		ref_get ( settings->refcnt );
+	if ( *ptr )
+		ref_put ( ( *ptr )->refcnt );
+	*ptr = settings;
+}
+
+/**
+ * Handle completion of DHCP attempt
+ *
+ * @v job		Job control interface
+ * @v rc		Overall job status code
+ */
+static void dhcp_attempt_done ( struct job_interface *job, int rc ) {
+	struct dhcp_attempt *attempt =
+		container_of ( job, struct dhcp_attempt, job );
+	struct settings *settings;
+	unsigned int i;
+
+	/* A DHCP session registers any top-level settings immediately
+	 * before completing, so any block which has appeared since we
+	 * last looked must belong to this attempt.
+	 */
+	for ( i = 0 ; i < DHCP_GLOBAL_SETTINGS ; i++ ) {
+		settings = find_settings ( dhcp_global_settings[i] );
+		if ( settings && ( settings != attempt->latest[i] ) ) {
+			dhcp_settings_replace ( &attempt->globals[i],
+						settings );
+			dhcp_settings_replace ( &attempt->latest[i],
+						settings );
+		}
+	}
+
+	attempt->rc = rc;
+}
+
+/** DHCP attempt job control interface operations */
+static struct job_interface_operations dhcp_attempt_job_operations = {
+	.done		= dhcp_attempt_done,
+	.kill		= ignore_job_kill,
+	.progress	= ignore_job_progress,
+};
+
+/**
+ * Start DHCP attempt once link is up
+ *
+ * @v attempt		DHCP attempt
+ */
+static void dhcp_attempt_step ( struct dhcp_attempt *attempt ) {
+	struct net_device *netdev = attempt->netdev;
+	unsigned long elapsed;
+	int rc;
+
+	/* Do nothing unless we are still waiting for link-up */
+	if ( attempt->started || ( attempt->rc != -EINPROGRESS ) )
+		return;
+
+	/* Give up if link does not come up within the usual time */
+	if ( ! netdev_link_ok ( netdev ) ) {
+		elapsed = ( currticks() - attempt->start );
+		if ( elapsed >= ( ( LINK_WAIT_MS * TICKS_PER_SEC ) / 1000 ) )
+			attempt->rc = netdev->link_rc;
+		return;
+	}
+
+	/* Start DHCP */
+	attempt->started = 1;
+	if ( ( rc = start_dhcp ( &attempt->job, netdev ) ) != 0 )
+		attempt->rc = ( ( rc > 0 ) ? 0 : rc );
+}
+
+/**
+ * Cancel DHCP attempt
+ *
+ * @v attempt		DHCP attempt
+ *
+ * Any settings registered by the attempt are discarded, so that they
+ * cannot shadow the settings of the chosen network device.  This
+ * includes settings registered by a session which was still waiting
+ * for a ProxyDHCP response.
+ */
+static void dhcp_attempt_cancel ( struct dhcp_attempt *attempt ) {
+	struct net_device *netdev = attempt->netdev;
+	struct settings *settings;
+	char name[ sizeof ( netdev->name ) + sizeof ( DHCP_SETTINGS_NAME ) ];
+	unsigned int i;
+
+	if ( attempt->rc == -EINPROGRESS )
+		job_kill ( &attempt->job );
+	attempt->rc = -ECANCELED;
+
+	/* Discard settings registered by this attempt */
+	snprintf ( name, sizeof ( name ), "%s.%s",
+		   netdev->name, DHCP_SETTINGS_NAME );
+	if ( ( settings = find_settings ( name ) ) != NULL )
+		unregister_settings ( settings );
+	for ( i = 0 ; i < DHCP_GLOBAL_SETTINGS ; i++ ) {
+		settings = attempt->globals[i];
+		if ( settings && settings->parent )
+			unregister_settings ( settings );
+	}
+
+	ifclose ( netdev );
+}
+
+/**
+ * Restore settings registered by chosen DHCP attempt
+ *
+ * @v attempt		DHCP attempt
+ *
+ * The top-level settings blocks are shared between all network
+ * devices, and so may have been replaced by a later attempt.
+ */
+static void dhcp_attempt_restore ( struct dhcp_attempt *attempt ) {
+	struct settings *settings;
+	unsigned int i;
+
+	for ( i = 0 ; i < DHCP_GLOBAL_SETTINGS ; i++ ) {
+		settings = attempt->globals[i];
+		if ( settings && ! settings->parent )
+			register_settings ( settings, NULL );
+	}
+}
+
+/**
+ * Configure one of several network devices via DHCP
+ *
+ * @v preferred		Preferred network device, or NULL
+ * @v in_order		Prefer devices in order over the first lease
+ * @v netdev		Configured network device to fill in
+ * @v failed		Per-device failure flags to fill in, or NULL
+ * @ret rc		Return status code
+ *
+ * All network devices are opened and DHCP is run on each of them
+ * concurrently, so that a device without a DHCP server does not delay
+ * booting from one with a server by the full DHCP timeout.  If @c
+ * in_order is zero, the first device to obtain a lease is used.
+ * Otherwise, a lease is used only once every device ahead of it (the
+ * preferred device followed by all others in the order in which they
+ * were registered) has failed.  DHCP on all other devices is
+ * cancelled, any settings obtained by them are discarded, and all
+ * other devices are closed.
+ *
+ * If @c failed is not NULL, it must have an entry for each network
+ * device, in registration order.  The entry is set to non-zero if
+ * DHCP failed (or was interrupted by the user) on that device, so
+ * that the caller need not retry it.  Devices whose DHCP was
+ * cancelled only because another device was chosen are not marked.
+ *
+ * -ENOMEM indicates that DHCP could not be run at all.
+ */
+int dhcp_any ( struct net_device *preferred, int in_order,
+	       struct net_device **netdev, int *failed ) {
+	struct dhcp_attempt *attempts;
+	struct dhcp_attempt *attempt;
+	struct dhcp_attempt *chosen = NULL;
+	struct settings *latest[DHCP_GLOBAL_SETTINGS];
+	unsigned long last_progress_dot;
+	struct net_device *tmp;
+	unsigned int count = 0;
+	unsigned int pending;
+	unsigned int index;
+	unsigned int i;
+	unsigned int j;
+	int interrupted = 0;
+	int rc;
+
+	/* Allocate attempts, with preferred device first */
+	*netdev = NULL;
+	for_each_netdev ( tmp )
+		count++;
+	if ( ! count )
+		return -ENODEV;
+	attempts = zalloc ( count * sizeof ( attempts[0] ) );
+	if ( ! attempts )
+		return -ENOMEM;
+	i = ( preferred ? 1 : 0 );
+	index = 0;
+	for_each_netdev ( tmp ) {
+		attempt = ( ( tmp == preferred ) ? &attempts[0] :
+			    &attempts[i++] );
+		attempt->netdev = tmp;
+		attempt->index = index++;
+	}
+
+	/* Record pre-existing top-level settings blocks */
+	for ( i = 0 ; i < DHCP_GLOBAL_SETTINGS ; i++ ) {
+		latest[i] = NULL;
+		dhcp_settings_replace ( &latest[i],
+				find_settings ( dhcp_global_settings[i] ) );
+	}
+
+	/* Open all devices */
+	printf ( "DHCP (" );
+	for ( i = 0 ; i < count ; i++ ) {
+		attempt = &attempts[i];
+		attempt->latest = latest;
+		job_init ( &attempt->job, &dhcp_attempt_job_operations, NULL );
+		attempt->start = currticks();
+		attempt->rc = ifopen ( attempt->netdev );
+		if ( attempt->rc == 0 )
+			attempt->rc = -EINPROGRESS;
+		printf ( "%s%c", attempt->netdev->name,
+			 ( ( i == ( count - 1 ) ) ? ')' : ' ' ) );
+	}
+
+	/* Wait for a lease on an acceptable device */
+	printf ( "." );
+	last_progress_dot = currticks();
+	while ( 1 ) {
+		pending = 0;
+		for ( i = 0 ; i < count ; i++ ) {
+			attempt = &attempts[i];
+			dhcp_attempt_step ( attempt );
+			if ( attempt->rc == -EINPROGRESS ) {
+				pending++;
+			} else if ( ( attempt->rc == 0 ) &&
+				    ( ( pending == 0 ) || ! in_order ) ) {
+				chosen = attempt;
+				break;
+			}
+		}
+		if ( chosen || ( pending == 0 ) )
+			break;
+		step();
+		if ( iskey() && ( getchar() == CTRL_C ) ) {
+			interrupted = 1;
+			break;
+		}
+		if ( ( currticks() - last_progress_dot ) >= TICKS_PER_SEC ) {
+			printf ( "." );
+			last_progress_dot = currticks();
+		}
+	}
+
+	/* Cancel all other attempts and release DHCP sessions */
+	rc = ( chosen ? 0 : ( pending ? -ECANCELED : attempts[0].rc ) );
+	for ( i = 0 ; i < count ; i++ ) {
+		attempt = &attempts[i];
+		if ( failed ) {
+			failed[attempt->index] =
+				( ( attempt->rc != 0 ) &&
+				  ( ( attempt->rc != -EINPROGRESS ) ||
+				    interrupted ) );
+		}
+		if ( attempt != chosen )
+			dhcp_attempt_cancel ( attempt );
+		job_unplug ( &attempt->job );
+	}
+	if ( chosen )
+		dhcp_attempt_restore ( chosen );
+	for ( i = 0 ; i < count ; i++ ) {
+		attempt = &attempts[i];
+		for ( j = 0 ; j < DHCP_GLOBAL_SETTINGS ; j++ )
+			dhcp_settings_replace ( &attempt->globals[j], NULL );
+	}
+	for ( i = 0 ; i < DHCP_GLOBAL_SETTINGS ; i++ )
+		dhcp_settings_replace ( &latest[i], NULL );
+
+	if ( chosen ) {
+		*netdev = chosen->netdev;
+		printf ( " ok (%s)\n", chosen->netdev->name );
+	} else {
+		printf ( " %s\n", strerror ( rc ) );
+	}
+	free ( attempts );
+	return rc;
+}
+
 int pxebs ( struct net_device *netdev, unsigned int pxe_type ) {
 	int rc;
 